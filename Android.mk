@@ -21,6 +21,9 @@ exynos7580_dirs := \
 	mobicore \
 	libgatekeeper \
 	libkeymaster \
+	libdisplaymodule/bench \
+	libhwcutilsmodule/bench \
+	libvirtualdisplaymodule/bench \
 
 #ifeq ($(BOARD_BACK_CAMERA_USES_EXTERNAL_CAMERA), true)
 #exynos7580_dirs += \
@@ -14,7 +14,10 @@
 
 LOCAL_SRC_FILES += \
 	./../../$(TARGET_SOC)/libdisplaymodule/ExynosPrimaryDisplay.cpp \
-	./../../$(TARGET_SOC)/libdisplaymodule/ExynosDisplayResourceManagerModule.cpp
+	./../../$(TARGET_SOC)/libdisplaymodule/ExynosDisplayResourceManagerModule.cpp \
+	./../../$(TARGET_SOC)/libdisplaymodule/ExynosWindowUpdatePlanner.cpp \
+	./../../$(TARGET_SOC)/libdisplaymodule/ExynosIdmaSolver.cpp \
+	./../../$(TARGET_SOC)/libdisplaymodule/ExynosBandwidthModel.cpp
 
 ifeq ($(BOARD_USES_DUAL_DISPLAY), true)
 LOCAL_SRC_FILES += ./../../$(TARGET_SOC)/libdisplaymodule/ExynosSecondaryDisplayModule.cpp
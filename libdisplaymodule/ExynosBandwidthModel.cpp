@@ -0,0 +1,108 @@
+#include <string.h>
+#include "ExynosBandwidthModel.h"
+
+ExynosBandwidthModel::ExynosBandwidthModel() :
+    mYres(0),
+    mRefresh(60)
+{
+    memset(&mLimits, 0, sizeof(mLimits));
+}
+
+void ExynosBandwidthModel::setLimits(const Limits &limits)
+{
+    mLimits = limits;
+    if (mLimits.numChannels > BW_MODEL_MAX_CHANNELS)
+        mLimits.numChannels = BW_MODEL_MAX_CHANNELS;
+    if (mLimits.burstBytes == 0)
+        mLimits.burstBytes = 1;
+}
+
+void ExynosBandwidthModel::setDisplay(int yres, uint32_t refresh)
+{
+    mYres = yres;
+    mRefresh = refresh ? refresh : 60;
+}
+
+uint64_t ExynosBandwidthModel::lineBytes(uint32_t width, uint32_t bpp) const
+{
+    uint64_t bytes = ((uint64_t)width * bpp + 7) / 8;
+    uint64_t burst = mLimits.burstBytes;
+
+    return (bytes + burst - 1) / burst * burst;
+}
+
+uint64_t ExynosBandwidthModel::layerRate(const Layer &layer) const
+{
+    return lineBytes(layer.srcW, layer.bpp) * layer.srcH * mRefresh;
+}
+
+uint64_t ExynosBandwidthModel::layerPeakRate(const Layer &layer) const
+{
+    int dstH = layer.dstBottom - layer.dstTop;
+
+    if (dstH <= 0)
+        return 0;
+
+    /* srcH / dstH buffer lines per display line, mYres * mRefresh display lines per second */
+    return lineBytes(layer.srcW, layer.bpp) * layer.srcH * mYres * mRefresh / dstH;
+}
+
+bool ExynosBandwidthModel::channelFits(int channel, uint64_t usedRate, const Layer &layer) const
+{
+    if (channel < 0 || (uint32_t)channel >= mLimits.numChannels)
+        return false;
+
+    return usedRate + layerRate(layer) <= mLimits.channelBytesPerSec[channel];
+}
+
+/*
+ * The sum only changes where a layer starts, so it is enough to look at the
+ * top line of every layer.
+ */
+uint64_t ExynosBandwidthModel::peakRate(const Layer *layers, size_t numLayers) const
+{
+    uint64_t peak = 0;
+
+    for (size_t i = 0; i < numLayers; i++) {
+        int line = layers[i].dstTop;
+        uint64_t sum = 0;
+
+        for (size_t j = 0; j < numLayers; j++) {
+            if (layers[j].dstTop <= line && line < layers[j].dstBottom)
+                sum += layerPeakRate(layers[j]);
+        }
+        if (sum > peak)
+            peak = sum;
+    }
+    return peak;
+}
+
+bool ExynosBandwidthModel::fits(const Layer *layers, size_t numLayers) const
+{
+    uint64_t channelRate[BW_MODEL_MAX_CHANNELS];
+
+    if (numLayers > BW_MODEL_MAX_LAYERS)
+        return false;
+
+    memset(channelRate, 0, sizeof(channelRate));
+    for (size_t i = 0; i < numLayers; i++) {
+        const Layer &layer = layers[i];
+        uint32_t overlap = 0;
+
+        if (layer.channel < 0 || (uint32_t)layer.channel >= mLimits.numChannels ||
+                !channelFits(layer.channel, channelRate[layer.channel], layer))
+            return false;
+        channelRate[layer.channel] += layerRate(layer);
+
+        /* layers on the same channel read at the top line of this one */
+        for (size_t j = 0; j < numLayers; j++) {
+            if (layers[j].channel == layer.channel &&
+                    layers[j].dstTop <= layer.dstTop && layer.dstTop < layers[j].dstBottom)
+                overlap++;
+        }
+        if (overlap > mLimits.channelOverlap[layer.channel])
+            return false;
+    }
+
+    return peakRate(layers, numLayers) <= mLimits.totalBytesPerSec;
+}
@@ -0,0 +1,83 @@
+#ifndef EXYNOS_BANDWIDTH_MODEL_H
+#define EXYNOS_BANDWIDTH_MODEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Read bandwidth of the DECON DMA channels.
+ *
+ * A window reads its buffer one line per display line it covers, each
+ * line rounded up to whole bursts; a buffer taller than the window (a
+ * vertical downscale) reads more than one line per display line. That
+ * gives the average rate of a window over a frame, checked against its
+ * channel, and the rate while the scanout is inside it: the windows
+ * overlapping vertically read at the same time, and their sum is checked
+ * against the total the DECON can read.
+ *
+ * The limits come from the board table in ExynosHWCModule.h. The model
+ * itself has no libhwc dependency and is unit tested on the host.
+ */
+
+#define BW_MODEL_MAX_CHANNELS   8
+#define BW_MODEL_MAX_LAYERS     16
+
+class ExynosBandwidthModel {
+    public:
+        struct Limits {
+            uint32_t numChannels;
+            uint64_t channelBytesPerSec[BW_MODEL_MAX_CHANNELS];
+            /* windows a channel can serve when they overlap vertically */
+            uint32_t channelOverlap[BW_MODEL_MAX_CHANNELS];
+            uint64_t totalBytesPerSec;
+            uint32_t burstBytes;    /* burst length times word size */
+        };
+
+        struct Layer {
+            int channel;
+            uint32_t srcW;          /* size of the buffer area read */
+            uint32_t srcH;
+            int dstTop;             /* display lines covered */
+            int dstBottom;
+            uint32_t bpp;
+        };
+
+        ExynosBandwidthModel();
+
+        /*
+         * Limits are rates, so the same board entry allows fewer pixels per
+         * frame at a higher refresh rate; setDisplay() gives the panel.
+         */
+        void setLimits(const Limits &limits);
+        void setDisplay(int yres, uint32_t refresh);
+        const Limits &limits() const { return mLimits; }
+
+        /* Bytes read per buffer line, rounded up to whole bursts */
+        uint64_t lineBytes(uint32_t width, uint32_t bpp) const;
+
+        /* Average bytes per second of a layer over a frame */
+        uint64_t layerRate(const Layer &layer) const;
+
+        /* Bytes per second while the scanout is inside the layer */
+        uint64_t layerPeakRate(const Layer &layer) const;
+
+        /* Can layer go on its channel on top of what is already there */
+        bool channelFits(int channel, uint64_t usedRate, const Layer &layer) const;
+
+        /*
+         * Does the whole set fit: every channel within its rate and
+         * overlap count, and the sum of the layers read at the same time
+         * within the total at every display line.
+         */
+        bool fits(const Layer *layers, size_t numLayers) const;
+
+        /* Highest sum of the peak rates of the layers on any display line */
+        uint64_t peakRate(const Layer *layers, size_t numLayers) const;
+
+    private:
+        Limits mLimits;
+        int mYres;
+        uint32_t mRefresh;
+};
+
+#endif
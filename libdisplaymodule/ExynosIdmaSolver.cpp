@@ -0,0 +1,99 @@
+#include <string.h>
+#include "ExynosIdmaSolver.h"
+
+ExynosIdmaSolver::ExynosIdmaSolver() :
+    mLayers(NULL),
+    mNumLayers(0),
+    mNumChannels(0),
+    mFound(false),
+    mBestCost(0),
+    mBestMoves(0),
+    mBestConversions(0)
+{
+}
+
+int64_t ExynosIdmaSolver::pairCost(const Channel &channel, int channelIndex, const Layer &layer)
+{
+    if (layer.drm && !channel.secure)
+        return -1;
+    if (!(layer.fitMask & (1 << channelIndex)))
+        return -1;
+
+    if (layer.directMask & (1 << channelIndex))
+        return (int64_t)layer.pixels * layer.directBpp / 8;
+
+    return (int64_t)layer.pixels * layer.convertedBpp / 8;
+}
+
+/*
+ * Depth first over the layers, each taking a channel not used yet. With at
+ * most three windows this is six leaves; the lower bound only matters for
+ * the wider tables the host harness tries.
+ */
+void ExynosIdmaSolver::search(size_t layer, uint32_t usedMask, uint64_t cost, unsigned int moves)
+{
+    if (mFound && (cost + mMinCost[layer] > mBestCost ||
+            (cost + mMinCost[layer] == mBestCost && moves >= mBestMoves)))
+        return;
+
+    if (layer == mNumLayers) {
+        mFound = true;
+        mBestCost = cost;
+        mBestMoves = moves;
+        memcpy(mBest, mCurrent, sizeof(mBest[0]) * mNumLayers);
+        return;
+    }
+
+    for (size_t c = 0; c < mNumChannels; c++) {
+        if ((usedMask & (1 << c)) || mCost[layer][c] < 0)
+            continue;
+        mCurrent[layer] = c;
+        search(layer + 1, usedMask | (1 << c), cost + mCost[layer][c],
+                moves + (mLayers[layer].prevChannel != (int)c));
+    }
+}
+
+int ExynosIdmaSolver::solve(const Channel *channels, size_t numChannels,
+        const Layer *layers, size_t numLayers, int *assignment)
+{
+    mFound = false;
+    mBestCost = 0;
+    mBestMoves = 0;
+    mBestConversions = 0;
+
+    if (numChannels > IDMA_SOLVER_MAX_CHANNELS || numLayers > numChannels)
+        return -1;
+
+    mLayers = layers;
+    mNumLayers = numLayers;
+    mNumChannels = numChannels;
+
+    for (size_t l = 0; l < numLayers; l++) {
+        for (size_t c = 0; c < numChannels; c++)
+            mCost[l][c] = pairCost(channels[c], c, layers[l]);
+    }
+
+    /* mMinCost[l]: cheapest the layers from l on can be, ignoring sharing */
+    mMinCost[numLayers] = 0;
+    for (size_t l = numLayers; l-- > 0;) {
+        int64_t min = -1;
+        for (size_t c = 0; c < numChannels; c++) {
+            if (mCost[l][c] >= 0 && (min < 0 || mCost[l][c] < min))
+                min = mCost[l][c];
+        }
+        if (min < 0)
+            return -1;
+        mMinCost[l] = mMinCost[l + 1] + min;
+    }
+
+    search(0, 0, 0, 0);
+    if (!mFound)
+        return -1;
+
+    for (size_t l = 0; l < numLayers; l++) {
+        assignment[l] = mBest[l];
+        if (!(layers[l].directMask & (1 << mBest[l])))
+            mBestConversions++;
+    }
+    return 0;
+}
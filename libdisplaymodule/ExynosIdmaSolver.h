@@ -0,0 +1,81 @@
+#ifndef EXYNOS_IDMA_SOLVER_H
+#define EXYNOS_IDMA_SOLVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Assigns the DECON IDMA channels to the layers that got a window.
+ *
+ * Every channel/layer pairing either is not allowed (a DRM layer off a
+ * secure channel, or more than the channel can read according to
+ * ExynosBandwidthModel) or costs the
+ * bytes the channel fetches per frame: a YUV layer that a channel can read
+ * directly costs its YUV size, otherwise the MPP converts it to RGB first
+ * and it costs that. The solver searches all injective assignments for the
+ * cheapest one, so no channel is ever given to two layers. Among equally
+ * cheap ones it keeps the most layers on their previous channel.
+ *
+ * It does not depend on hwcomposer or the rest of libhwc, so the host
+ * harness can drive it with generated layer stacks.
+ */
+
+#define IDMA_SOLVER_MAX_CHANNELS    8
+#define IDMA_SOLVER_MAX_LAYERS      IDMA_SOLVER_MAX_CHANNELS
+
+class ExynosIdmaSolver {
+    public:
+        struct Channel {
+            int idma;               /* enum decon_idma_type */
+            bool secure;            /* can fetch protected buffers */
+        };
+
+        struct Layer {
+            uint32_t pixels;        /* source crop area */
+            uint32_t directBpp;     /* bits per pixel when fetched as is */
+            uint32_t convertedBpp;  /* after MPP conversion to RGB */
+            uint32_t directMask;    /* channels (by index) that can fetch it as is */
+            uint32_t fitMask;       /* channels with the bandwidth for it */
+            bool drm;
+            int prevChannel;        /* index of the previous channel, or -1 */
+        };
+
+        ExynosIdmaSolver();
+
+        /*
+         * Fills assignment[] with a channel index per layer. Returns 0, or
+         * -1 if there are more layers than channels or no assignment
+         * satisfies the constraints, leaving assignment[] untouched.
+         */
+        int solve(const Channel *channels, size_t numChannels,
+                const Layer *layers, size_t numLayers, int *assignment);
+
+        /* Bytes per frame of the last solution */
+        uint64_t cost() const { return mBestCost; }
+        /* Layers of the last solution not on their previous channel */
+        unsigned int moves() const { return mBestMoves; }
+        /* Layers of the last solution converted by the MPP */
+        unsigned int conversions() const { return mBestConversions; }
+
+        /* Bytes per frame of layer on channel, or -1 if not allowed */
+        static int64_t pairCost(const Channel &channel, int channelIndex, const Layer &layer);
+
+    private:
+        const Layer *mLayers;
+        size_t mNumLayers;
+        size_t mNumChannels;
+
+        int64_t mCost[IDMA_SOLVER_MAX_LAYERS][IDMA_SOLVER_MAX_CHANNELS];
+        int64_t mMinCost[IDMA_SOLVER_MAX_LAYERS + 1];   /* lower bound of the rest */
+
+        int mCurrent[IDMA_SOLVER_MAX_LAYERS];
+        int mBest[IDMA_SOLVER_MAX_LAYERS];
+        bool mFound;
+        uint64_t mBestCost;
+        unsigned int mBestMoves;
+        unsigned int mBestConversions;
+
+        void search(size_t layer, uint32_t usedMask, uint64_t cost, unsigned int moves);
+};
+
+#endif
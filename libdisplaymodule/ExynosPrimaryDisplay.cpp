@@ -1,7 +1,11 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
 #include "ExynosPrimaryDisplay.h"
 #include "ExynosHWCModule.h"
 #include "ExynosHWCUtils.h"
 #include "ExynosMPPModule.h"
+#include "ExynosHWCTraceLayer.h"
 
 #define DISPLAY_LOGD(msg, ...) ALOGD("[%s] " msg, mDisplayName.string(), ##__VA_ARGS__)
 #define DISPLAY_LOGV(msg, ...) ALOGV("[%s] " msg, mDisplayName.string(), ##__VA_ARGS__)
@@ -9,9 +13,46 @@
 #define DISPLAY_LOGW(msg, ...) ALOGW("[%s] " msg, mDisplayName.string(), ##__VA_ARGS__)
 #define DISPLAY_LOGE(msg, ...) ALOGE("[%s] " msg, mDisplayName.string(), ##__VA_ARGS__)
 
+/* IDMA channels of the primary display; G2 is the one reading YUV and protected buffers */
+static const enum decon_idma_type PRIMARY_IDMA_CHANNELS[] = { IDMA_G0, IDMA_G1, IDMA_G2 };
+
+static int secmemIsolated(void)
+{
+    char isolated = 0;
+    int fd = open(HDMI_RESERVE_MEM_DEV_NAME, O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+    int ret = read(fd, &isolated, 1);
+    close(fd);
+    return ret == 1 ? isolated == '1' : -1;
+}
+
+static int secmemSetVideoExt(int enable)
+{
+    int fd = open(SMEM_PATH, O_RDWR);
+
+    if (fd < 0) {
+        ALOGE("failed to open %s: %s", SMEM_PATH, strerror(errno));
+        return -1;
+    }
+    int ret = ioctl(fd, SECMEM_IOC_SET_VIDEO_EXT_PROC, &enable);
+    if (ret < 0)
+        ALOGE("SECMEM_IOC_SET_VIDEO_EXT_PROC(%d) failed: %s", enable, strerror(errno));
+    close(fd);
+    return ret;
+}
+
+static const ExynosSecmemOps secmemOps = { secmemIsolated, secmemSetVideoExt };
+
 ExynosPrimaryDisplay::ExynosPrimaryDisplay(int numGSCs, struct exynos5_hwc_composer_device_1_t *pdev) :
-    ExynosOverlayDisplay(numGSCs, pdev)
+    ExynosOverlayDisplay(numGSCs, pdev),
+    prevfbTargetIdma(IDMA_G0),
+    mSecureBuffers(&secmemOps),
+    mSecureMPP(NULL)
 {
+    memset(&mSecureFrame, 0, sizeof(mSecureFrame));
+    readWinUpdateProperty();
 }
 
 ExynosPrimaryDisplay::~ExynosPrimaryDisplay()
@@ -49,18 +90,169 @@ bool ExynosPrimaryDisplay::isYuvDmaAvailable(int format, uint32_t dma)
         dma == IDMA_G2);
 }
 
+/*
+ * The panel size and refresh rate are only known once the framebuffer is
+ * open, after the constructor; this is cheap, so just redo it per frame.
+ */
+void ExynosPrimaryDisplay::updateBandwidthModel()
+{
+#ifdef FIMD_BW_OVERLAP_CHECK
+    const struct fimd_bw_limits *table = fimd_bw_limits_find(mXres, mYres);
+    ExynosBandwidthModel::Limits limits;
+
+    memset(&limits, 0, sizeof(limits));
+    limits.numChannels = MAX_NUM_FIMD_DMA_CH;
+    for (size_t c = 0; c < MAX_NUM_FIMD_DMA_CH; c++) {
+        limits.channelBytesPerSec[c] = table->ch_bytes_per_sec[c];
+        limits.channelOverlap[c] = table->ch_overlap_cnt[c];
+    }
+    limits.totalBytesPerSec = table->total_bytes_per_sec;
+    limits.burstBytes = FIMD_BURSTLEN * FIMD_WORD_SIZE_BYTES;
+    mBwModel.setLimits(limits);
+#endif
+    mBwModel.setDisplay(mYres, mVsyncPeriod > 0 ? 1000000000 / mVsyncPeriod : 60);
+}
+
 void ExynosPrimaryDisplay::assignWindows(hwc_display_contents_1_t *contents)
 {
     // call the ExynosDisplay default implementation of assignWindows()
     ExynosDisplay::assignWindows(contents);
 
-    // allocate the max bandwidth non-rgb layer to IDMA_G2
-    // consider only non-secure dma case - secure dma is already allocated to IDMA_G2
+    mTrace.nextFrame();
+    for (size_t i = 0; i < contents->numHwLayers; i++)
+        HWC_TRACE(HWC_TRACE_PREPARE,
+                hwcTraceLayer(mTrace, HWC_TRACE_PREPARE, i, contents->hwLayers[i]));
+
+    // then choose the IDMA channel of every window in one go, see ExynosIdmaSolver.h,
+    // unless the windows are the same as in a recent frame, see ExynosCompositionCache.h
+    ExynosCompositionCache::Key key;
+    int32_t decision[COMPOSITION_CACHE_VALUE_WORDS];
+    int numWords;
+
+    windowKey(contents, key);
+    numWords = mWindowCache.lookup(key, decision);
+    if (numWords < 0) {
+        numWords = solveWindows(contents, decision);
+        mWindowCache.store(key, decision, numWords);
+    } else {
+        prevfbTargetIdma = (enum decon_idma_type)decision[0];
+        for (int w = 1; w + 1 < numWords; w += 2)
+            mLayerInfos[decision[w]]->mDmaType = decision[w + 1];
+    }
+
+    // the MSC buffers of a protected layer come before set(), see ExynosSecureBufferManager.h
+    reserveSecureBuffers(contents);
+}
+
+/*
+ * The buffer postMPPM2M() has the MPP write: the layer's own format if the
+ * window can read it, else mExternalMPPDstFormat. displayFrame is the one
+ * the window shows, after remapSecureFrame() for a protected layer.
+ */
+int ExynosPrimaryDisplay::mppDstFormat(hwc_layer_1_t &layer, int index)
+{
+    private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
+
+    if (mType != EXYNOS_VIRTUAL_DISPLAY &&
+        (isFormatRgb(handle->format) ||
+         (isYuvDmaAvailable(handle->format, mLayerInfos[index]->mDmaType) &&
+          WIDTH(layer.displayFrame) % getIDMAWidthAlign(handle->format) == 0 &&
+          HEIGHT(layer.displayFrame) % getIDMAHeightAlign(handle->format) == 0)))
+        return handle->format;
+    return mExternalMPPDstFormat;
+}
+
+/*
+ * recalculateDisplayFrame() moves a protected layer partly off screen back
+ * on screen. It only depends on the layer's frame, crop and transform and
+ * the panel, so run it when one of them changes and replay it otherwise.
+ */
+void ExynosPrimaryDisplay::remapSecureFrame(hwc_layer_1_t &layer)
+{
+    SecureFrame &f = mSecureFrame;
+
+    if (f.valid && f.xres == mXres && f.yres == mYres && f.transform == layer.transform &&
+            !memcmp(&f.inFrame, &layer.displayFrame, sizeof(f.inFrame)) &&
+            !memcmp(&f.inCrop, &layer.sourceCropf, sizeof(f.inCrop))) {
+        layer.displayFrame = f.outFrame;
+        layer.sourceCropf = f.outCrop;
+        return;
+    }
+
+    f.inFrame = layer.displayFrame;
+    f.inCrop = layer.sourceCropf;
+    f.transform = layer.transform;
+    f.xres = mXres;
+    f.yres = mYres;
+    recalculateDisplayFrame(layer, mXres, mYres);
+    f.outFrame = layer.displayFrame;
+    f.outCrop = layer.sourceCropf;
+    f.valid = true;
+}
 
-    bool videoLayerFound = 0, curDmaYuvFound = 0, hasDRMlayer = 0;
-    uint32_t videoLayerIndex = 0, curDmaYuvIndex = 0;
-    uint32_t mTemp = 0, bandWidth = 0;
-    int fbLayerIndex = -1;
+void ExynosPrimaryDisplay::reserveSecureBuffers(hwc_display_contents_1_t *contents)
+{
+    hwc_layer_1_t *secureLayer = NULL;
+    int secureIndex = -1;
+
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        hwc_layer_1_t &layer = contents->hwLayers[i];
+
+        if (layer.compositionType != HWC_OVERLAY || !layer.handle ||
+                (layer.flags & HWC_SKIP_RENDERING) || !mLayerInfos[i]->mExternalMPP)
+            continue;
+
+        private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
+        if (getDrmMode(handle->flags) == SECURE_DRM) {
+            secureLayer = &layer;
+            secureIndex = i;
+            break;
+        }
+    }
+
+    int action = mSecureBuffers.frame(secureLayer != NULL, systemTime(SYSTEM_TIME_MONOTONIC));
+    ExynosMPPModule *mpp = secureLayer ? mLayerInfos[secureIndex]->mExternalMPP : NULL;
+
+    if (mSecureMPP != NULL && (action == ExynosSecureBufferManager::ACTION_RELEASE ||
+                (mpp != NULL && mpp != mSecureMPP)))
+        mSecureMPP->releaseDstBuffers();
+    if (mpp != NULL && mpp != mSecureMPP)
+        mSecureMPP = NULL;
+
+    if (action != ExynosSecureBufferManager::ACTION_RESERVE) {
+        /* the ring gives its buffers back as the MPP goes on to other jobs */
+        if (!mSecureBuffers.reserved() &&
+                (mSecureMPP == NULL || mSecureMPP->dstBuffersReleased())) {
+            mSecureBuffers.released();
+            mSecureMPP = NULL;
+        }
+        return;
+    }
+
+    // what postMPPM2M() will ask the pool for
+    hwc_layer_1_t layer = *secureLayer;
+    uint32_t width = WIDTH(layer.displayFrame);
+    uint32_t height = HEIGHT(layer.displayFrame);
+
+    remapSecureFrame(layer);
+    if (mpp->reserveDstBuffers(mppDstFormat(layer, secureIndex), width, height,
+                private_handle_t::dynamicCast(layer.handle)) >= 0)
+        mSecureMPP = mpp;
+}
+
+/*
+ * Everything solveWindows() looks at: the panel, and of the windows what
+ * they read and where, and the channel they were on. Not the handles, a
+ * new buffer of the same format does not change the channel.
+ */
+void ExynosPrimaryDisplay::windowKey(hwc_display_contents_1_t *contents,
+        ExynosCompositionCache::Key &key)
+{
+    key.add((int32_t)mXres);
+    key.add((int32_t)mYres);
+    key.add((int32_t)mVsyncPeriod);
+    key.add((int32_t)mExternalMPPDstFormat);
+    key.add((int32_t)prevfbTargetIdma);
 
     for (size_t i = 0; i < contents->numHwLayers; i++) {
         hwc_layer_1_t &layer = contents->hwLayers[i];
@@ -68,61 +260,184 @@ void ExynosPrimaryDisplay::assignWindows(hwc_display_contents_1_t *contents)
         if (!layer.handle)
             continue;
 
+        if (layer.compositionType == HWC_FRAMEBUFFER_TARGET) {
+            if (!mFbNeeded || mFbWindow >= NUM_HW_WINDOWS)
+                continue;
+        } else if (layer.compositionType != HWC_OVERLAY) {
+            continue;
+        }
+
         private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
 
-        if (layer.compositionType == HWC_FRAMEBUFFER_TARGET)
-            fbLayerIndex = i;
-
-        // If there is DRM layer available, it has to go to IDMA_G2 channel.
-        if (layer.compositionType == HWC_OVERLAY &&
-                getDrmMode(handle->flags) == SECURE_DRM &&
-                !(layer.flags & HWC_SKIP_RENDERING)) {
-            hasDRMlayer = 1;
-            videoLayerFound = 1;
-            videoLayerIndex = i;
+        key.add((uint32_t)i);
+        key.add((int32_t)layer.compositionType);
+        key.add((int32_t)handle->format);
+        key.add((int32_t)getDrmMode(handle->flags));
+        key.add((uint32_t)(layer.flags & HWC_SKIP_RENDERING));
+        key.add(layer.displayFrame.left, layer.displayFrame.top,
+                layer.displayFrame.right, layer.displayFrame.bottom);
+        key.add(layer.sourceCropf.left);
+        key.add(layer.sourceCropf.top);
+        key.add(layer.sourceCropf.right);
+        key.add(layer.sourceCropf.bottom);
+        if (layer.compositionType != HWC_FRAMEBUFFER_TARGET)
+            key.add((int32_t)mLayerInfos[i]->mDmaType);
+    }
+}
+
+/*
+ * Assigns the channels and fills decision with what it did: the FB target
+ * channel handleStaticLayers() uses, then layer index and channel pairs.
+ * Returns the number of words.
+ */
+int ExynosPrimaryDisplay::solveWindows(hwc_display_contents_1_t *contents, int32_t *decision)
+{
+    const size_t numChannels = sizeof(PRIMARY_IDMA_CHANNELS) / sizeof(PRIMARY_IDMA_CHANNELS[0]);
+    ExynosIdmaSolver::Channel channels[numChannels];
+    ExynosIdmaSolver::Layer layers[numChannels];
+    /* what the window reads when fetched as is, and after the MPP */
+    ExynosBandwidthModel::Layer direct[numChannels], converted[numChannels];
+    size_t layerIndex[numChannels];
+    int assignment[numChannels];
+    size_t numLayers = 0;
+    int fbSlot = -1;
+    ExynosIdmaSolver solver;
+
+    updateBandwidthModel();
+
+    for (size_t c = 0; c < numChannels; c++) {
+        channels[c].idma = PRIMARY_IDMA_CHANNELS[c];
+        channels[c].secure = (PRIMARY_IDMA_CHANNELS[c] == IDMA_G2);
+    }
+
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        hwc_layer_1_t &layer = contents->hwLayers[i];
+
+        if (!layer.handle)
+            continue;
+
+        if (layer.compositionType == HWC_FRAMEBUFFER_TARGET) {
+            if (!mFbNeeded || mFbWindow >= NUM_HW_WINDOWS)
+                continue;
+        } else if (layer.compositionType != HWC_OVERLAY) {
+            continue;
+        }
+
+        if (numLayers == numChannels) {
+            DISPLAY_LOGE("assignWindows: more windows than IDMA channels, keeping the default mapping");
+            decision[0] = prevfbTargetIdma;
+            return 1;
         }
 
-        // If no DRM layer, find non-rgb overlay layer which can be supported by IDMA_G2.
-        if ((layer.compositionType == HWC_OVERLAY) &&
-                    isYuvDmaAvailable(handle->format, IDMA_G2) &&
-                    !(layer.flags & HWC_SKIP_RENDERING) &&
-                    !hasDRMlayer) {
-
-            mTemp = (layer.sourceCropf.right - layer.sourceCropf.left) *
-                (layer.sourceCropf.bottom - layer.sourceCropf.top);
-            if (mTemp > bandWidth) {
-                bandWidth = mTemp;
-                videoLayerFound = 1;
-                videoLayerIndex = i;
+        private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
+        ExynosIdmaSolver::Layer &l = layers[numLayers];
+        int prevDma = (layer.compositionType == HWC_FRAMEBUFFER_TARGET) ?
+                prevfbTargetIdma : mLayerInfos[i]->mDmaType;
+
+        // What the window fetches: the MPP output, or the buffer itself
+        l.pixels = WIDTH(layer.displayFrame) * HEIGHT(layer.displayFrame);
+        l.drm = getDrmMode(handle->flags) == SECURE_DRM &&
+                !(layer.flags & HWC_SKIP_RENDERING);
+        l.directBpp = formatToBpp(handle->format);
+        l.directMask = 0;
+        l.prevChannel = -1;
+
+        if (isFormatRgb(handle->format)) {
+            l.convertedBpp = l.directBpp;
+            l.directMask = (1 << numChannels) - 1;
+        } else {
+            l.convertedBpp = formatToBpp(mExternalMPPDstFormat);
+            for (size_t c = 0; c < numChannels; c++) {
+                if (isYuvDmaAvailable(handle->format, channels[c].idma) &&
+                        WIDTH(layer.displayFrame) % getIDMAWidthAlign(handle->format) == 0 &&
+                        HEIGHT(layer.displayFrame) % getIDMAHeightAlign(handle->format) == 0)
+                    l.directMask |= 1 << c;
             }
         }
 
-        if (((layer.compositionType == HWC_OVERLAY) ||
-            (layer.compositionType == HWC_FRAMEBUFFER_TARGET)) &&
-            (!curDmaYuvFound) &&
-            (mLayerInfos[i]->mDmaType == IDMA_G2)) {
-            curDmaYuvFound = 1;
-            curDmaYuvIndex = i;
+        // The window does not scale: RGB is read at the displayFrame size,
+        // scaled by the MPP if it had to be, YUV read as is at its crop size
+        converted[numLayers].channel = -1;
+        converted[numLayers].srcW = WIDTH(layer.displayFrame);
+        converted[numLayers].srcH = HEIGHT(layer.displayFrame);
+        converted[numLayers].dstTop = layer.displayFrame.top;
+        converted[numLayers].dstBottom = layer.displayFrame.bottom;
+        converted[numLayers].bpp = l.convertedBpp;
+        direct[numLayers] = converted[numLayers];
+        direct[numLayers].bpp = l.directBpp;
+        if (!isFormatRgb(handle->format)) {
+            direct[numLayers].srcW = (uint32_t)(layer.sourceCropf.right - layer.sourceCropf.left);
+            direct[numLayers].srcH = (uint32_t)(layer.sourceCropf.bottom - layer.sourceCropf.top);
         }
+
+        l.fitMask = 0;
+        for (size_t c = 0; c < numChannels; c++) {
+            if (channels[c].idma == prevDma)
+                l.prevChannel = c;
+#ifdef FIMD_BW_OVERLAP_CHECK
+            const ExynosBandwidthModel::Layer &read =
+                    (l.directMask & (1 << c)) ? direct[numLayers] : converted[numLayers];
+            if (c < MAX_NUM_FIMD_DMA_CH && !mBwModel.channelFits(FIMD_DMA_CH_IDX[c], 0, read))
+                continue;
+#endif
+            l.fitMask |= 1 << c;
+        }
+
+        if (layer.compositionType == HWC_FRAMEBUFFER_TARGET)
+            fbSlot = numLayers;
+        layerIndex[numLayers++] = i;
+    }
+
+    decision[0] = prevfbTargetIdma;
+    if (numLayers == 0)
+        return 1;
+
+    if (solver.solve(channels, numChannels, layers, numLayers, assignment) < 0) {
+        DISPLAY_LOGE("assignWindows: no IDMA mapping for %zu windows, keeping the default mapping",
+                numLayers);
+        return 1;
     }
 
-    if (curDmaYuvFound && videoLayerFound) {
-        mTemp = mLayerInfos[videoLayerIndex]->mDmaType;
-        mLayerInfos[videoLayerIndex]->mDmaType = mLayerInfos[curDmaYuvIndex]->mDmaType;
-        mLayerInfos[curDmaYuvIndex]->mDmaType = mTemp;
+    uint32_t usedMask = 0;
+    int numWords = 1;
+    for (size_t l = 0; l < numLayers; l++) {
+        mLayerInfos[layerIndex[l]]->mDmaType = channels[assignment[l]].idma;
+        usedMask |= 1 << assignment[l];
+        decision[numWords++] = layerIndex[l];
+        decision[numWords++] = channels[assignment[l]].idma;
     }
 
-    if (videoLayerFound && !curDmaYuvFound) {
-        if (prevfbTargetIdma == IDMA_G2) {
-            prevfbTargetIdma = (enum decon_idma_type) mLayerInfos[videoLayerIndex]->mDmaType;
-            mLayerInfos[videoLayerIndex]->mDmaType = IDMA_G2;
-            return;
+#ifdef FIMD_BW_OVERLAP_CHECK
+    // Each window fits its channel; check what they read together
+    ExynosBandwidthModel::Layer reads[numChannels];
+    for (size_t l = 0; l < numLayers; l++) {
+        reads[l] = (layers[l].directMask & (1 << assignment[l])) ? direct[l] : converted[l];
+        reads[l].channel = FIMD_DMA_CH_IDX[assignment[l]];
+    }
+    if (!mBwModel.fits(reads, numLayers))
+        DISPLAY_LOGW("assignWindows: %zu windows read %llu bytes/s at peak, over the DECON total",
+                numLayers, (unsigned long long)mBwModel.peakRate(reads, numLayers));
+#endif
+
+    // handleStaticLayers() reposts the FB target on prevfbTargetIdma, keep it off the others
+    if (fbSlot >= 0) {
+        prevfbTargetIdma = (enum decon_idma_type)channels[assignment[fbSlot]].idma;
+    } else {
+        for (size_t c = 0; c < numChannels; c++) {
+            if (channels[c].idma == prevfbTargetIdma && (usedMask & (1 << c))) {
+                for (size_t free = 0; free < numChannels; free++) {
+                    if (!(usedMask & (1 << free))) {
+                        prevfbTargetIdma = (enum decon_idma_type)channels[free].idma;
+                        break;
+                    }
+                }
+                break;
+            }
         }
-        mLayerInfos[videoLayerIndex]->mDmaType = IDMA_G2;
     }
 
-    if (mFbNeeded && mFbWindow < NUM_HW_WINDOWS && fbLayerIndex >= 0)
-       prevfbTargetIdma = (enum decon_idma_type) mLayerInfos[fbLayerIndex]->mDmaType;
+    decision[0] = prevfbTargetIdma;
+    return numWords;
 }
 
 int ExynosPrimaryDisplay::postMPPM2M(hwc_layer_1_t &layer, struct decon_win_config *config, int win_map, int index)
@@ -147,16 +462,20 @@ int ExynosPrimaryDisplay::postMPPM2M(hwc_layer_1_t &layer, struct decon_win_conf
 
     /* OFF_Screen to ON_Screen changes */
     if (getDrmMode(handle->flags) == SECURE_DRM)
-        recalculateDisplayFrame(layer, mXres, mYres);
+        remapSecureFrame(layer);
 
-    if (mType != EXYNOS_VIRTUAL_DISPLAY &&
-        (isFormatRgb(handle->format) ||
-         (isYuvDmaAvailable(handle->format, mLayerInfos[index]->mDmaType) &&
-          WIDTH(layer.displayFrame) % getIDMAWidthAlign(handle->format) == 0 &&
-          HEIGHT(layer.displayFrame) % getIDMAHeightAlign(handle->format) == 0)))
-        dst_format = handle->format;
+    dst_format = mppDstFormat(layer, index);
 
-    int err = exynosMPP->processM2M(layer, dst_format, &sourceCrop);
+    // Reuse a buffer of this format and size if the MPP had one, see ExynosMPPDstPool.h
+    bool needBufferAlloc = exynosMPP->prepareDstBuffer(dst_format,
+            (uint32_t)sourceCrop.right, (uint32_t)sourceCrop.bottom, handle) < 0;
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int err = exynosMPP->processM2M(layer, dst_format, &sourceCrop, needBufferAlloc);
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
+    exynosMPP->recordJob(end - start, err >= 0);
+    if (getDrmMode(handle->flags) == SECURE_DRM)
+        mSecureBuffers.jobDone(needBufferAlloc || exynosMPP->dstAllocated(), end);
 
     /* Restore displayFrame*/
     layer.displayFrame = originalDisplayFrame;
@@ -222,6 +541,13 @@ void ExynosPrimaryDisplay::handleStaticLayers(hwc_display_contents_1_t *contents
         ALOGE("%s", result.string());
         ALOGE("Display Config:");
         dump_win_config(&win_data.config[0]);
+        for (size_t i = 0; i < contents->numHwLayers; i++) {
+            if (mLayerInfos[i]->mExternalMPP != NULL) {
+                result.clear();
+                mLayerInfos[i]->mExternalMPP->dumpJobStats(result);
+                ALOGE("%s", result.string());
+            }
+        }
     }
 }
 
@@ -266,24 +592,64 @@ void ExynosPrimaryDisplay::dump_win_config(struct decon_win_config *config)
     }
 }
 
+void ExynosPrimaryDisplay::readWinUpdateProperty()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.hwc.winupdate", value, NULL);
+
+    mWinUpdateEnabled = !strcmp(value, "1") || !strcmp(value, "true");
+}
+
+void ExynosPrimaryDisplay::traceWinUpdate(uint8_t event, int window, int layer,
+        const hwc_rect &rect, uint32_t width, uint32_t height, int32_t count)
+{
+    ExynosHWCTrace::Record *r = mTrace.begin(event);
+
+    r->window = window;
+    r->layer = layer;
+    r->rect[0] = rect.left;
+    r->rect[1] = rect.top;
+    r->rect[2] = rect.right;
+    r->rect[3] = rect.bottom;
+    r->width = width;
+    r->height = height;
+    r->type = count;
+    mTrace.commit(r);
+}
+
+void ExynosPrimaryDisplay::dump(android::String8& result)
+{
+    const ExynosCompositionCache::Stats &cache = mWindowCache.stats();
+
+    ExynosOverlayDisplay::dump(result);
+    const ExynosSecureBufferManager::Stats &secure = mSecureBuffers.stats();
+
+    result.appendFormat("  IDMA assignment: %u frames, %u from the cache, %u evicted, %u uncacheable\n",
+            cache.lookups, cache.hits, cache.evictions, cache.uncacheable);
+    result.appendFormat("  protected playback: %u sessions (%u resumed), startup %llu us (max %llu us), "
+            "%u buffers allocated by jobs, %u protect failures, buffers %s\n",
+            secure.sessions, secure.resumed, (unsigned long long)(secure.lastStartupNs / 1000),
+            (unsigned long long)(secure.maxStartupNs / 1000), secure.lateAllocations,
+            secure.protectFailures, mSecureBuffers.reserved() ? "reserved" : "released");
+    mTrace.dump(result);
+}
+
 int ExynosPrimaryDisplay::handleWindowUpdate(hwc_display_contents_1_t __unused *contents,
     struct decon_win_config __unused *config)
 {
-    int layerIdx = -1;
     int updatedWinCnt = 0;
-    int totalWinCnt = 0;
-    int bitsPerPixel = 0;
     size_t winUpdateInfoIdx;
-    hwc_rect updateRect = {this->mXres, this->mYres, 0, 0};
     hwc_rect currentRect = {0, 0, 0, 0};
-    bool burstLengthCheckDone = false;
-    int alignAdjustment = 0;
-    int intersectionWidth = 0;
+    struct decon_win_rect updateRect;
+    uint32_t windowMask = 0;
+    int ret;
 
-    char value[PROPERTY_VALUE_MAX];
-    property_get("debug.hwc.winupdate", value, NULL);
+    if (contents->flags & HWC_GEOMETRY_CHANGED) {
+        readWinUpdateProperty();
+        mWinUpdatePlanner.reset();
+    }
 
-    if (!(!strcmp(value, "1") || !strcmp(value, "true")))
+    if (!mWinUpdateEnabled)
         return -eWindowUpdateDisabled;
 
     if (DECON_WIN_UPDATE_IDX < 0)
@@ -293,6 +659,23 @@ int ExynosPrimaryDisplay::handleWindowUpdate(hwc_display_contents_1_t __unused *
     if (contents->flags & HWC_GEOMETRY_CHANGED)
         return -eWindowUpdateGeometryChanged;
 
+    ExynosWindowUpdatePlanner::Params params = {
+        this->mXres, this->mYres,
+        WINUPDATE_X_ALIGNMENT, WINUPDATE_W_ALIGNMENT,
+        WINUPDATE_MIN_HEIGHT, WINUPDATE_THRESHOLD, BURSTLEN_BYTES };
+    mWinUpdatePlanner.setParams(params);
+
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        if (contents->hwLayers[i].compositionType == HWC_FRAMEBUFFER)
+            continue;
+        if (!mFbNeeded && contents->hwLayers[i].compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+        int32_t windowIndex = mLayerInfos[i]->mWindowIndex;
+        if (windowIndex >= 0 && windowIndex < MAX_DECON_WIN)
+            windowMask |= 1 << windowIndex;
+    }
+    mWinUpdatePlanner.begin(config, windowMask);
+
     for (size_t i = 0; i < contents->numHwLayers; i++) {
         if (contents->hwLayers[i].compositionType == HWC_FRAMEBUFFER)
             continue;
@@ -301,8 +684,6 @@ int ExynosPrimaryDisplay::handleWindowUpdate(hwc_display_contents_1_t __unused *
             continue;
         int32_t windowIndex = mLayerInfos[i]->mWindowIndex;
         if (config[windowIndex].state != config[windowIndex].DECON_WIN_STATE_DISABLED) {
-            totalWinCnt++;
-
             if (winConfigChanged(&config[windowIndex], &this->mLastConfigData.config[windowIndex])) {
                 updatedWinCnt++;
 
@@ -322,8 +703,8 @@ int ExynosPrimaryDisplay::handleWindowUpdate(hwc_display_contents_1_t __unused *
 
                     if (handle && !isScaled(layer) && !isRotated(layer)
                             && !(!(damageRect.left) && !(damageRect.top) && !(damageRect.right) && !(damageRect.bottom))) {
-                        HLOGD("[WIN_UPDATE][surfaceDamage]  layer w(%4d) h(%4d),  dirty (%4d, %4d) - (%4d, %4d)",
-                                handle->width, handle->height, damageRect.left, damageRect.top, damageRect.right, damageRect.bottom);
+                        HWC_TRACE(HWC_TRACE_WIN_DAMAGE, traceWinUpdate(HWC_TRACE_WIN_DAMAGE,
+                                windowIndex, i, damageRect, handle->width, handle->height, 0));
 
                         currentRect.left   = config[windowIndex].dst.x - (int32_t)layer.sourceCropf.left + damageRect.left;
                         currentRect.right  = config[windowIndex].dst.x - (int32_t)layer.sourceCropf.left + damageRect.right;
@@ -333,97 +714,50 @@ int ExynosPrimaryDisplay::handleWindowUpdate(hwc_display_contents_1_t __unused *
                     }
                 }
 
-                if ((currentRect.left > currentRect.right) || (currentRect.top > currentRect.bottom)) {
-                    HLOGD("[WIN_UPDATE] window(%d) layer(%d) invalid region (%4d, %4d) - (%4d, %4d)",
-                        i, layerIdx, currentRect.left, currentRect.top, currentRect.right, currentRect.bottom);
+                struct decon_rect dirty = {
+                    currentRect.left, currentRect.top, currentRect.right, currentRect.bottom };
+                if (mWinUpdatePlanner.addDirty(windowIndex, dirty) != ExynosWindowUpdatePlanner::PLAN_OK) {
+                    HWC_TRACE(HWC_TRACE_WIN_INVALID, traceWinUpdate(HWC_TRACE_WIN_INVALID,
+                            windowIndex, i, currentRect, 0, 0, 0));
+                    mWinUpdatePlanner.reset();
                     return -eWindowUpdateInvalidRegion;
                 }
-                HLOGD("[WIN_UPDATE] Updated Window(%d) Layer(%d)  (%4d, %4d) - (%4d, %4d)",
-                    windowIndex, i, currentRect.left, currentRect.top, currentRect.right, currentRect.bottom);
-                updateRect = expand(updateRect, currentRect);
+                HWC_TRACE(HWC_TRACE_WIN_DIRTY, traceWinUpdate(HWC_TRACE_WIN_DIRTY,
+                        windowIndex, i, currentRect, 0, 0, 0));
             }
         }
     }
-    if (updatedWinCnt == 0)
-        return -eWindowUpdateNotUpdated;
-
-    updateRect.left  = ALIGN_DOWN(updateRect.left, WINUPDATE_X_ALIGNMENT);
-    updateRect.right = updateRect.left + ALIGN_UP(WIDTH(updateRect), WINUPDATE_W_ALIGNMENT);
-
-    if (HEIGHT(updateRect) < WINUPDATE_MIN_HEIGHT) {
-        if (updateRect.top + WINUPDATE_MIN_HEIGHT <= mYres)
-            updateRect.bottom = updateRect.top + WINUPDATE_MIN_HEIGHT;
-        else
-            updateRect.top = updateRect.bottom - WINUPDATE_MIN_HEIGHT;
-    }
 
-    if ((100 * (WIDTH(updateRect) * HEIGHT(updateRect)) / (this->mXres * this->mYres)) > WINUPDATE_THRESHOLD)
+    ret = mWinUpdatePlanner.plan(&updateRect);
+    switch (ret) {
+    case ExynosWindowUpdatePlanner::PLAN_OK:
+        break;
+    case ExynosWindowUpdatePlanner::PLAN_NOT_UPDATED:
+        return -eWindowUpdateNotUpdated;
+    case ExynosWindowUpdatePlanner::PLAN_OVER_THRESHOLD:
         return -eWindowUpdateOverThreshold;
-
-    alignAdjustment = max(WINUPDATE_X_ALIGNMENT, WINUPDATE_W_ALIGNMENT);
-
-    while (1) {
-        burstLengthCheckDone = true;
-
-        for (size_t i = 0; i < contents->numHwLayers; i++) {
-            if (contents->hwLayers[i].compositionType == HWC_FRAMEBUFFER)
-                continue;
-            if (!mFbNeeded && contents->hwLayers[i].compositionType == HWC_FRAMEBUFFER_TARGET)
-                continue;
-            int32_t windowIndex = mLayerInfos[i]->mWindowIndex;
-            if (config[windowIndex].state != config[windowIndex].DECON_WIN_STATE_DISABLED) {
-                enum decon_pixel_format fmt = config[windowIndex].format;
-
-                if (fmt == DECON_PIXEL_FORMAT_RGBA_5551 || fmt == DECON_PIXEL_FORMAT_RGB_565 )
-                        bitsPerPixel = 16;
-                else if (fmt == DECON_PIXEL_FORMAT_NV12 || fmt == DECON_PIXEL_FORMAT_NV21 ||
-                    fmt == DECON_PIXEL_FORMAT_NV12M || fmt == DECON_PIXEL_FORMAT_NV21M)
-                        bitsPerPixel = 12;
-                else
-                        bitsPerPixel = 32;
-
-                currentRect.left   = config[windowIndex].dst.x;
-                currentRect.right  = config[windowIndex].dst.x + config[windowIndex].dst.w;
-                currentRect.top    = config[windowIndex].dst.y;
-                currentRect.bottom = config[windowIndex].dst.y + config[windowIndex].dst.h;
-
-                intersectionWidth = WIDTH(intersection(currentRect, updateRect));
-
-                HLOGV("[WIN_UPDATE] win[%d] left(%d) right(%d) intersection(%d)", windowIndex, currentRect.left, currentRect.right, intersectionWidth);
-
-                if (intersectionWidth != 0 && (size_t)((intersectionWidth * bitsPerPixel) / 8) < BURSTLEN_BYTES) {
-                    HLOGV("[WIN_UPDATE] win[%d] insufficient burst length ((%d)*(%d)/8) < %d", windowIndex, intersectionWidth, bitsPerPixel, BURSTLEN_BYTES);
-                    burstLengthCheckDone = false;
-                    break;
-                }
-            }
-        }
-
-        if (burstLengthCheckDone)
-            break;
-        HLOGD("[WIN_UPDATE] Adjusting update width. current left(%d) right(%d)", updateRect.left, updateRect.right);
-        if (updateRect.left >= alignAdjustment) {
-            updateRect.left -= alignAdjustment;
-        } else if (updateRect.right + alignAdjustment <= this->mXres) {
-            updateRect.right += alignAdjustment;
-        } else {
-            DISPLAY_LOGD("[WIN_UPDATE] Error during update width adjustment");
-            return -eWindowUpdateAdjustmentFail;
-        }
+    case ExynosWindowUpdatePlanner::PLAN_ADJUSTMENT_FAIL:
+        DISPLAY_LOGD("[WIN_UPDATE] Error during update width adjustment");
+        return -eWindowUpdateAdjustmentFail;
+    default:
+        return -eWindowUpdateInvalidRegion;
     }
 
     config[winUpdateInfoIdx].state = config[winUpdateInfoIdx].DECON_WIN_STATE_UPDATE;
-    config[winUpdateInfoIdx].dst.x = updateRect.left;
-    config[winUpdateInfoIdx].dst.y = updateRect.top;
-    config[winUpdateInfoIdx].dst.w = ALIGN_UP(WIDTH(updateRect), WINUPDATE_W_ALIGNMENT);
-    config[winUpdateInfoIdx].dst.h = HEIGHT(updateRect);
-
-    HLOGD("[WIN_UPDATE] UpdateRegion cfg  (%4d, %4d) w(%4d) h(%4d) updatedWindowCnt(%d)",
-        config[winUpdateInfoIdx].dst.x, config[winUpdateInfoIdx].dst.y, config[winUpdateInfoIdx].dst.w, config[winUpdateInfoIdx].dst.h, updatedWinCnt);
+    config[winUpdateInfoIdx].dst.x = updateRect.x;
+    config[winUpdateInfoIdx].dst.y = updateRect.y;
+    config[winUpdateInfoIdx].dst.w = updateRect.w;
+    config[winUpdateInfoIdx].dst.h = updateRect.h;
+
+    if (HWC_TRACE_ENABLED(HWC_TRACE_WIN_REGION)) {
+        hwc_rect regionRect = { (int)updateRect.x, (int)updateRect.y,
+            (int)(updateRect.x + updateRect.w), (int)(updateRect.y + updateRect.h) };
+        traceWinUpdate(HWC_TRACE_WIN_REGION, -1, -1, regionRect, 0, 0, updatedWinCnt);
+    }
 
     /* Disable block mode if window update region is not full screen */
     if ((config[winUpdateInfoIdx].dst.x != 0) || (config[winUpdateInfoIdx].dst.y != 0) ||
-        (config[winUpdateInfoIdx].dst.w != (uint32_t)mXres) || (config[winUpdateInfoIdx].dst.h != (uint32_t)mXres)) {
+        (config[winUpdateInfoIdx].dst.w != (uint32_t)mXres) || (config[winUpdateInfoIdx].dst.h != (uint32_t)mYres)) {
         for (size_t i = 0; i < NUM_HW_WINDOWS; i++) {
             memset(&config[i].transparent_area, 0, sizeof(config[i].transparent_area));
             //memset(&config[i].covered_opaque_area, 0, sizeof(config[i].covered_opaque_area));
@@ -2,9 +2,51 @@
 #define EXYNOS_DISPLAY_MODULE_H
 
 #include "ExynosOverlayDisplay.h"
+#include "ExynosWindowUpdatePlanner.h"
+#include "ExynosIdmaSolver.h"
+#include "ExynosBandwidthModel.h"
+#include "ExynosHWCTrace.h"
+#include "ExynosCompositionCache.h"
+#include "ExynosSecureBufferManager.h"
 
 class ExynosPrimaryDisplay : public ExynosOverlayDisplay {
         enum decon_idma_type prevfbTargetIdma;
+        ExynosWindowUpdatePlanner mWinUpdatePlanner;
+        /* debug.hwc.winupdate, read again on geometry changes */
+        bool mWinUpdateEnabled;
+
+        /* limits of the board table entry for the panel, see ExynosHWCModule.h */
+        ExynosBandwidthModel mBwModel;
+        /* IDMA channels of the last few window stacks */
+        ExynosCompositionCache mWindowCache;
+
+        /* protected playback sessions and the MPP holding their buffers */
+        ExynosSecureBufferManager mSecureBuffers;
+        ExynosMPPModule *mSecureMPP;
+        /* the last recalculateDisplayFrame() of a protected layer */
+        struct SecureFrame {
+            hwc_rect_t inFrame;
+            hwc_frect_t inCrop;
+            uint32_t transform;
+            int xres;
+            int yres;
+            hwc_rect_t outFrame;
+            hwc_frect_t outCrop;
+            bool valid;
+        } mSecureFrame;
+
+        /* layers at assignWindows() and window update decisions, decoded by dump() */
+        ExynosHWCTrace mTrace;
+
+        void readWinUpdateProperty();
+        void updateBandwidthModel();
+        void windowKey(hwc_display_contents_1_t *contents, ExynosCompositionCache::Key &key);
+        int solveWindows(hwc_display_contents_1_t *contents, int32_t *decision);
+        int mppDstFormat(hwc_layer_1_t &layer, int index);
+        void remapSecureFrame(hwc_layer_1_t &layer);
+        void reserveSecureBuffers(hwc_display_contents_1_t *contents);
+        void traceWinUpdate(uint8_t event, int window, int layer, const hwc_rect &rect,
+                uint32_t width, uint32_t height, int32_t count);
 
     public:
         ExynosPrimaryDisplay(int numGSCs, struct exynos5_hwc_composer_device_1_t *pdev);
@@ -28,6 +70,7 @@ class ExynosPrimaryDisplay : public ExynosOverlayDisplay {
         int handleWindowUpdate(hwc_display_contents_1_t __unused *contents,
                 struct decon_win_config __unused *config);
         void dump_win_config(struct decon_win_config *config);
+        virtual void dump(android::String8& result);
         int getIDMAWidthAlign(int format);
         int getIDMAHeightAlign(int format);
 };
@@ -0,0 +1,290 @@
+#include <string.h>
+#include "ExynosWindowUpdatePlanner.h"
+
+#define PLANNER_NEVER   0x7fffffff
+
+static inline int alignDown(int value, int align)
+{
+    return value - (value % align);
+}
+
+static inline int alignUp(int value, int align)
+{
+    return ((value + align - 1) / align) * align;
+}
+
+static inline int ceilSteps(int distance, int step)
+{
+    return distance <= 0 ? 0 : (distance + step - 1) / step;
+}
+
+static inline int minInt(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+static inline int maxInt(int a, int b)
+{
+    return a > b ? a : b;
+}
+
+ExynosWindowUpdatePlanner::ExynosWindowUpdatePlanner()
+{
+    memset(&mParams, 0, sizeof(mParams));
+    mParams.xAlign = 1;
+    mParams.wAlign = 1;
+    reset();
+    mWindowMask = 0;
+    mNumDirty = 0;
+    mInvalid = false;
+}
+
+void ExynosWindowUpdatePlanner::setParams(const Params &params)
+{
+    if (memcmp(&params, &mParams, sizeof(params)) == 0)
+        return;
+
+    mParams = params;
+    if (mParams.xAlign < 1)
+        mParams.xAlign = 1;
+    if (mParams.wAlign < 1)
+        mParams.wAlign = 1;
+    reset();
+}
+
+void ExynosWindowUpdatePlanner::reset()
+{
+    memset(mWindows, 0, sizeof(mWindows));
+    memset(mPrevWindows, 0, sizeof(mPrevWindows));
+    mPrevValid = false;
+    mMovedMask = 0;
+}
+
+int ExynosWindowUpdatePlanner::bitsPerPixel(enum decon_pixel_format format)
+{
+    switch (format) {
+    case DECON_PIXEL_FORMAT_RGBA_5551:
+    case DECON_PIXEL_FORMAT_RGB_565:
+        return 16;
+    case DECON_PIXEL_FORMAT_NV12:
+    case DECON_PIXEL_FORMAT_NV21:
+    case DECON_PIXEL_FORMAT_NV12M:
+    case DECON_PIXEL_FORMAT_NV21M:
+        return 12;
+    default:
+        return 32;
+    }
+}
+
+void ExynosWindowUpdatePlanner::begin(const struct decon_win_config *config, uint32_t windowMask)
+{
+    mWindowMask = windowMask;
+    mMovedMask = 0;
+    mNumDirty = 0;
+    mInvalid = false;
+    mDirtyBounds.left = mParams.xres;
+    mDirtyBounds.top = mParams.yres;
+    mDirtyBounds.right = 0;
+    mDirtyBounds.bottom = 0;
+
+    for (int win = 0; win < MAX_DECON_WIN; win++) {
+        Window &w = mWindows[win];
+        const Window &prev = mPrevWindows[win];
+        const struct decon_win_config &cfg = config[win];
+
+        w.enabled = (windowMask & (1 << win)) &&
+                cfg.state != cfg.DECON_WIN_STATE_DISABLED;
+        if (!w.enabled)
+            continue;
+
+        w.rect.left = cfg.dst.x;
+        w.rect.top = cfg.dst.y;
+        w.rect.right = cfg.dst.x + cfg.dst.w;
+        w.rect.bottom = cfg.dst.y + cfg.dst.h;
+
+        /* A color window has no format, the DMA does not fetch it */
+        enum decon_pixel_format format = cfg.state == cfg.DECON_WIN_STATE_BUFFER ?
+                cfg.format : DECON_PIXEL_FORMAT_ARGB_8888;
+        if (mPrevValid && prev.enabled && prev.format == format) {
+            w.format = format;
+            w.bpp = prev.bpp;
+            w.minWidth = prev.minWidth;
+        } else {
+            w.format = format;
+            w.bpp = bitsPerPixel(format);
+            w.minWidth = ceilSteps(mParams.burstLenBytes * 8, w.bpp);
+        }
+    }
+}
+
+void ExynosWindowUpdatePlanner::addRect(const struct decon_rect &rect)
+{
+    mDirtyBounds.left = minInt(mDirtyBounds.left, rect.left);
+    mDirtyBounds.top = minInt(mDirtyBounds.top, rect.top);
+    mDirtyBounds.right = maxInt(mDirtyBounds.right, rect.right);
+    mDirtyBounds.bottom = maxInt(mDirtyBounds.bottom, rect.bottom);
+    mNumDirty++;
+}
+
+int ExynosWindowUpdatePlanner::addDirty(int win, const struct decon_rect &rect)
+{
+    if (win < 0 || win >= MAX_DECON_WIN || !mWindows[win].enabled)
+        return PLAN_OK;
+
+    if (rect.left > rect.right || rect.top > rect.bottom) {
+        mInvalid = true;
+        return PLAN_INVALID_REGION;
+    }
+    addRect(rect);
+
+    const Window &prev = mPrevWindows[win];
+    const struct decon_rect &cur = mWindows[win].rect;
+    if (mPrevValid && prev.enabled && !(mMovedMask & (1 << win)) &&
+            (prev.rect.left != cur.left || prev.rect.top != cur.top ||
+             prev.rect.right != cur.right || prev.rect.bottom != cur.bottom)) {
+        mMovedMask |= 1 << win;
+        addRect(prev.rect);
+    }
+
+    return PLAN_OK;
+}
+
+int ExynosWindowUpdatePlanner::addDirtyWindow(int win)
+{
+    if (win < 0 || win >= MAX_DECON_WIN || !mWindows[win].enabled)
+        return PLAN_OK;
+
+    return addDirty(win, mWindows[win].rect);
+}
+
+/*
+ * The adjustment widens [left, right) by step to the left leftSteps times,
+ * then to the right rightSteps times. The visible width of a window is
+ * non-decreasing over the steps, so the first step at which it reaches a
+ * given width can be solved for in each of the two phases.
+ */
+static int firstStepWithWidth(int left, int right, int step,
+        int leftSteps, int rightSteps,
+        const struct decon_rect &win, int width)
+{
+    /* Growing to the left: right edge fixed at min(right, win.right) */
+    int limit = minInt(right, win.right) - width;
+    if (win.left <= limit) {
+        int k = ceilSteps(left - limit, step);
+        if (k <= leftSteps)
+            return k;
+    }
+
+    /* Growing to the right from the final left edge */
+    int edge = maxInt(left - step * leftSteps, win.left) + width;
+    if (win.right >= edge) {
+        int k = ceilSteps(edge - right, step);
+        if (k <= rightSteps)
+            return leftSteps + k;
+    }
+
+    return PLANNER_NEVER;
+}
+
+int ExynosWindowUpdatePlanner::adjustmentSteps(int left, int right, int step) const
+{
+    int leftSteps = left > 0 ? left / step : 0;
+    int rightSteps = right < mParams.xres ? (mParams.xres - right) / step : 0;
+    int enter[MAX_DECON_WIN];
+    int ok[MAX_DECON_WIN];
+    int n = 0;
+
+    /*
+     * A window fails while it is visible in the region but narrower there
+     * than a burst: from the step it becomes visible until the one it
+     * becomes wide enough.
+     */
+    for (int win = 0; win < MAX_DECON_WIN; win++) {
+        const Window &w = mWindows[win];
+
+        if (!w.enabled)
+            continue;
+        int e = firstStepWithWidth(left, right, step, leftSteps, rightSteps, w.rect, 1);
+        if (e == PLANNER_NEVER)
+            continue;
+        int o = firstStepWithWidth(left, right, step, leftSteps, rightSteps, w.rect, w.minWidth);
+        if (o <= e)
+            continue;
+        enter[n] = e;
+        ok[n] = o;
+        n++;
+    }
+
+    int k = 0;
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (int i = 0; i < n; i++) {
+            if (enter[i] <= k && k < ok[i]) {
+                k = ok[i];
+                moved = true;
+            }
+        }
+        if (k == PLANNER_NEVER)
+            return -1;
+    }
+
+    return k;
+}
+
+void ExynosWindowUpdatePlanner::commit()
+{
+    memcpy(mPrevWindows, mWindows, sizeof(mPrevWindows));
+    mPrevValid = true;
+}
+
+int ExynosWindowUpdatePlanner::plan(struct decon_win_rect *update)
+{
+    struct decon_rect r = mDirtyBounds;
+    int ret = PLAN_OK;
+
+    do {
+        if (mInvalid) {
+            ret = PLAN_INVALID_REGION;
+            break;
+        }
+        if (mNumDirty == 0) {
+            ret = PLAN_NOT_UPDATED;
+            break;
+        }
+
+        r.left = alignDown(r.left, mParams.xAlign);
+        r.right = r.left + alignUp(r.right - r.left, mParams.wAlign);
+
+        if (r.bottom - r.top < mParams.minHeight) {
+            if (r.top + mParams.minHeight <= mParams.yres)
+                r.bottom = r.top + mParams.minHeight;
+            else
+                r.top = r.bottom - mParams.minHeight;
+        }
+
+        int64_t area = (int64_t)(r.right - r.left) * (r.bottom - r.top);
+        if (100 * area / ((int64_t)mParams.xres * mParams.yres) > mParams.thresholdPercent) {
+            ret = PLAN_OVER_THRESHOLD;
+            break;
+        }
+
+        int step = maxInt(mParams.xAlign, mParams.wAlign);
+        int k = adjustmentSteps(r.left, r.right, step);
+        if (k < 0) {
+            ret = PLAN_ADJUSTMENT_FAIL;
+            break;
+        }
+        int leftSteps = minInt(k, r.left > 0 ? r.left / step : 0);
+        r.left -= step * leftSteps;
+        r.right += step * (k - leftSteps);
+
+        update->x = r.left;
+        update->y = r.top;
+        update->w = alignUp(r.right - r.left, mParams.wAlign);
+        update->h = r.bottom - r.top;
+    } while (0);
+
+    commit();
+    return ret;
+}
@@ -0,0 +1,115 @@
+#ifndef EXYNOS_WINDOW_UPDATE_PLANNER_H
+#define EXYNOS_WINDOW_UPDATE_PLANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/types.h>
+#include "decon-fb.h"
+
+/*
+ * Plans the DECON partial update (window update) region of a frame.
+ *
+ * Only depends on decon_win_config, so it can be driven with synthetic
+ * window configurations off target. The planner remembers the format and
+ * destination of every window from the previous frame: a window that moved
+ * also dirties the area it left.
+ *
+ * The burst length adjustment is computed directly instead of widening the
+ * region one alignment step at a time. For every window the steps at which
+ * its visible width is too short for a DMA burst form one interval, and the
+ * smallest step outside all of them is the answer.
+ */
+
+class ExynosWindowUpdatePlanner {
+    public:
+        enum {
+            PLAN_OK = 0,
+            PLAN_NOT_UPDATED,
+            PLAN_INVALID_REGION,
+            PLAN_OVER_THRESHOLD,
+            PLAN_ADJUSTMENT_FAIL,
+        };
+
+        struct Params {
+            int xres;
+            int yres;
+            int xAlign;             /* alignment of the left edge */
+            int wAlign;             /* alignment of the width */
+            int minHeight;
+            int thresholdPercent;   /* larger regions are not worth it */
+            int burstLenBytes;
+        };
+
+        ExynosWindowUpdatePlanner();
+
+        /* Resets the per-window state if the parameters changed */
+        void setParams(const Params &params);
+        const Params &params() const { return mParams; }
+
+        /* Forget the previous frame, for example after a geometry change */
+        void reset();
+
+        /*
+         * Start planning a frame. Windows in windowMask are the ones that
+         * will be scanned out, the others are ignored.
+         */
+        void begin(const struct decon_win_config *config, uint32_t windowMask);
+
+        /*
+         * Mark a region of the screen dirty on behalf of window win, for
+         * example its damage. If the window moved since the previous
+         * frame the area it covered is marked dirty as well. Regions need
+         * not touch: DECON takes a single update region, which covers all
+         * of them.
+         */
+        int addDirty(int win, const struct decon_rect &rect);
+
+        /* Mark all of window win dirty */
+        int addDirtyWindow(int win);
+
+        /*
+         * Compute the update region from the dirty regions. The region is
+         * aligned and wide enough in every window it crosses for a full
+         * DMA burst. Returns PLAN_OK and the region, or why there is none.
+         *
+         * The per-window state is always committed, whether a region was
+         * found or not.
+         */
+        int plan(struct decon_win_rect *update);
+
+        /* Bits per pixel of a DECON format as the DMA fetches it */
+        static int bitsPerPixel(enum decon_pixel_format format);
+
+        /*
+         * Fewest steps of the burst length adjustment needed, starting from
+         * [left, right) and widening by step to the left while possible,
+         * then to the right. Returns -1 if the screen edge is hit first.
+         */
+        int adjustmentSteps(int left, int right, int step) const;
+
+    private:
+        struct Window {
+            bool enabled;
+            enum decon_pixel_format format;
+            int bpp;
+            int minWidth;           /* narrowest visible width for a burst */
+            struct decon_rect rect;
+        };
+
+        Params mParams;
+        uint32_t mWindowMask;
+        uint32_t mMovedMask;
+
+        Window mWindows[MAX_DECON_WIN];
+        Window mPrevWindows[MAX_DECON_WIN];
+        bool mPrevValid;
+
+        struct decon_rect mDirtyBounds;
+        size_t mNumDirty;
+        bool mInvalid;
+
+        void addRect(const struct decon_rect &rect);
+        void commit();
+};
+
+#endif
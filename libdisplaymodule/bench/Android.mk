@@ -0,0 +1,93 @@
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Host checks and benchmarks of the display module code that does not
+# depend on the rest of libhwc. libdisplaymodule/Android.mk itself is
+# included into the libhwc module and cannot define modules of its own.
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+# see benchWindowUpdate.cpp for options
+LOCAL_MODULE := hwc_winupdate_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	benchWindowUpdate.cpp \
+	../ExynosWindowUpdatePlanner.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# see benchIdmaSolver.cpp for options
+LOCAL_MODULE := hwc_idma_solver_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	benchIdmaSolver.cpp \
+	../ExynosIdmaSolver.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# table-driven, exits non-zero on a failed case
+LOCAL_MODULE := hwc_bandwidth_model_test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	testBandwidthModel.cpp \
+	../ExynosBandwidthModel.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# see replayComposition.cpp for options
+LOCAL_MODULE := hwc_composition_replay
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	replayComposition.cpp \
+	../ExynosIdmaSolver.cpp \
+	../ExynosBandwidthModel.cpp \
+	../ExynosWindowUpdatePlanner.cpp \
+	../../libhwcutilsmodule/ExynosMPPDstPool.cpp \
+	../../libhwcutilsmodule/ExynosHWCTrace.cpp \
+	../../libhwcutilsmodule/ExynosCompositionCache.cpp \
+	../../libvirtualdisplaymodule/ExynosWfdBlendPlanner.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include \
+	$(LOCAL_PATH)/../../libhwcutilsmodule \
+	$(LOCAL_PATH)/../../libvirtualdisplaymodule
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check and benchmark of ExynosIdmaSolver over generated layer stacks.
+ *
+ * Every solution is checked for a channel given to two layers, a DRM layer
+ * off the secure channel and a layer on a channel without the bandwidth
+ * for it, and
+ * compared with an exhaustive search over all channel permutations. On the
+ * primary display table (G0, G1 and the YUV/secure G2) it is also compared
+ * with the swap rules assignWindows() used before: the largest YUV layer or
+ * the DRM layer moves to G2, whether or not it can be fetched from there.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "ExynosIdmaSolver.h"
+
+#define FULL_HD     (1920 * 1080)
+
+struct Stack {
+    ExynosIdmaSolver::Channel channels[IDMA_SOLVER_MAX_CHANNELS];
+    size_t numChannels;
+    ExynosIdmaSolver::Layer layers[IDMA_SOLVER_MAX_LAYERS];
+    size_t numLayers;
+    /* YUV in the one format the secure channel reads, aligned or not */
+    bool yuvCandidate[IDMA_SOLVER_MAX_LAYERS];
+};
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Channels: the first numChannels - 1 are RGB only, the last one reads YUV
+ * and protected buffers, like IDMA_G2 on the primary display.
+ */
+static void generateStack(Stack &s, size_t numChannels)
+{
+    int order[IDMA_SOLVER_MAX_CHANNELS];
+
+    memset(&s, 0, sizeof(s));
+    s.numChannels = numChannels;
+    for (size_t c = 0; c < numChannels; c++) {
+        s.channels[c].idma = c;
+        s.channels[c].secure = (c == numChannels - 1);
+        order[c] = c;
+    }
+    std::random_shuffle(order, order + numChannels);
+
+    s.numLayers = 1 + rand() % numChannels;
+    for (size_t l = 0; l < s.numLayers; l++) {
+        ExynosIdmaSolver::Layer &layer = s.layers[l];
+        int kind = rand() % 8;
+
+        layer.pixels = 1 + rand() % FULL_HD;
+        layer.fitMask = (1 << numChannels) - 1;
+        /* too much for some channels, or for all of them */
+        if (rand() % 50 == 0)
+            layer.fitMask &= rand();
+        /* What the common code assigned, distinct channels */
+        layer.prevChannel = order[l];
+
+        if (kind < 4) {
+            /* RGB, fetched as is from anywhere */
+            layer.directBpp = (kind == 0) ? 16 : 32;
+            layer.convertedBpp = layer.directBpp;
+            layer.directMask = (1 << numChannels) - 1;
+        } else {
+            layer.directBpp = 12;
+            layer.convertedBpp = 32;
+            /* kind 4: another YUV format, 5: unaligned, 6/7: readable by the last channel */
+            s.yuvCandidate[l] = (kind != 4);
+            if (kind >= 6)
+                layer.directMask = 1 << (numChannels - 1);
+            layer.drm = (kind == 7 && rand() % 2);
+        }
+    }
+}
+
+struct Result {
+    bool found;
+    uint64_t cost;
+    unsigned int moves;
+};
+
+static Result exhaustive(const Stack &s)
+{
+    int perm[IDMA_SOLVER_MAX_CHANNELS];
+    Result best = { false, 0, 0 };
+
+    for (size_t c = 0; c < s.numChannels; c++)
+        perm[c] = c;
+
+    /* All orders of the channels, the first numLayers go to the layers */
+    do {
+        uint64_t cost = 0;
+        unsigned int moves = 0;
+        bool ok = true;
+
+        for (size_t l = 0; l < s.numLayers && ok; l++) {
+            int64_t c = ExynosIdmaSolver::pairCost(s.channels[perm[l]], perm[l], s.layers[l]);
+            if (c < 0)
+                ok = false;
+            cost += c;
+            moves += s.layers[l].prevChannel != perm[l];
+        }
+        if (ok && (!best.found || cost < best.cost || (cost == best.cost && moves < best.moves))) {
+            best.found = true;
+            best.cost = cost;
+            best.moves = moves;
+        }
+    } while (std::next_permutation(perm, perm + s.numChannels));
+
+    return best;
+}
+
+/* Cost of the swap rules of the old assignWindows(), -1 if not allowed */
+static int64_t legacyCost(const Stack &s)
+{
+    int channel[IDMA_SOLVER_MAX_LAYERS];
+    int g2 = s.numChannels - 1;
+    int video = -1, holder = -1;
+    uint32_t bandwidth = 0;
+    bool drm = false;
+
+    for (size_t l = 0; l < s.numLayers; l++) {
+        const ExynosIdmaSolver::Layer &layer = s.layers[l];
+
+        channel[l] = layer.prevChannel;
+        if (layer.drm) {
+            drm = true;
+            video = l;
+        }
+        if (s.yuvCandidate[l] && !drm && layer.pixels > bandwidth) {
+            bandwidth = layer.pixels;
+            video = l;
+        }
+        if (holder < 0 && channel[l] == g2)
+            holder = l;
+    }
+
+    if (holder >= 0 && video >= 0) {
+        channel[holder] = channel[video];
+        channel[video] = g2;
+    } else if (video >= 0) {
+        channel[video] = g2;
+    }
+
+    int64_t cost = 0;
+    for (size_t l = 0; l < s.numLayers; l++) {
+        int64_t c = ExynosIdmaSolver::pairCost(s.channels[channel[l]], channel[l], s.layers[l]);
+        if (c < 0)
+            return -1;
+        cost += c;
+    }
+    return cost;
+}
+
+static int check(size_t numChannels, int stacks, bool compareLegacy)
+{
+    ExynosIdmaSolver solver;
+    int assignment[IDMA_SOLVER_MAX_LAYERS];
+    int errors = 0, solved = 0, better = 0, legacyFailed = 0;
+    uint64_t savedBytes = 0, legacyBytes = 0, ns = 0;
+
+    for (int i = 0; i < stacks; i++) {
+        Stack s;
+
+        generateStack(s, numChannels);
+        Result ref = exhaustive(s);
+
+        uint64_t start = nowNs();
+        int ret = solver.solve(s.channels, s.numChannels, s.layers, s.numLayers, assignment);
+        ns += nowNs() - start;
+
+        if ((ret == 0) != ref.found) {
+            if (errors++ < 5)
+                fprintf(stderr, "stack %d: solver %s, exhaustive search %s\n", i,
+                        ret == 0 ? "solved" : "failed", ref.found ? "solved" : "failed");
+            continue;
+        }
+        if (ret != 0)
+            continue;
+        solved++;
+
+        uint32_t used = 0;
+        for (size_t l = 0; l < s.numLayers; l++) {
+            const ExynosIdmaSolver::Channel &ch = s.channels[assignment[l]];
+            const ExynosIdmaSolver::Layer &layer = s.layers[l];
+
+            if ((used & (1 << assignment[l])) ||
+                    (layer.drm && !ch.secure) || !(layer.fitMask & (1 << assignment[l]))) {
+                if (errors++ < 5)
+                    fprintf(stderr, "stack %d: layer %zu on channel %d breaks a constraint\n",
+                            i, l, assignment[l]);
+            }
+            used |= 1 << assignment[l];
+        }
+        if (solver.cost() != ref.cost || solver.moves() != ref.moves) {
+            if (errors++ < 5)
+                fprintf(stderr, "stack %d: cost %llu moves %u, exhaustive %llu moves %u\n", i,
+                        (unsigned long long)solver.cost(), solver.moves(),
+                        (unsigned long long)ref.cost, ref.moves);
+        }
+
+        if (compareLegacy) {
+            int64_t legacy = legacyCost(s);
+            if (legacy < 0) {
+                legacyFailed++;
+            } else {
+                legacyBytes += legacy;
+                if ((uint64_t)legacy > solver.cost()) {
+                    better++;
+                    savedBytes += legacy - solver.cost();
+                }
+            }
+        }
+    }
+
+    printf("%zu channels: %d stacks, %d solvable, %d errors, %.0f ns/solve\n",
+            numChannels, stacks, solved, errors, (double)ns / stacks);
+    if (compareLegacy)
+        printf("  vs swap rules: %d mappings the rules got wrong, %d cheaper (%.1f%% of fetched bytes)\n",
+                legacyFailed, better, legacyBytes ? 100.0 * savedBytes / legacyBytes : 0.0);
+
+    return errors ? -1 : 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n stacks] [-c channels]\n"
+            "  -n  layer stacks per channel count (default 100000)\n"
+            "  -c  widest channel table to try, 3 to %d (default 6)\n",
+            name, IDMA_SOLVER_MAX_CHANNELS);
+}
+
+int main(int argc, char *argv[])
+{
+    int stacks = 100000;
+    int maxChannels = 6;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            stacks = atoi(optarg);
+            break;
+        case 'c':
+            maxChannels = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (stacks < 1 || maxChannels < 3 || maxChannels > IDMA_SOLVER_MAX_CHANNELS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    for (int c = 3; c <= maxChannels; c++) {
+        if (check(c, c == 3 ? stacks : stacks / 10, c == 3) != 0)
+            ret = 1;
+    }
+    return ret;
+}
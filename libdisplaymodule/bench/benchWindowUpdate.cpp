@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check and benchmark of ExynosWindowUpdatePlanner.
+ *
+ * The planner is checked against the window update code it replaced,
+ * kept below as legacyPlan(), on random window configurations, and for
+ * the area left by a moved window. Then both are timed over frame traces:
+ * built-in synthetic ones, or recorded ones given with -r. A trace file
+ * holds one frame per line, each window as x,y,w,h,format with a leading
+ * '*' if it changed; lines starting with '#' are ignored.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "ExynosWindowUpdatePlanner.h"
+
+struct Frame {
+    struct decon_win_config config[MAX_DECON_WIN];
+    uint32_t windowMask;
+    uint32_t dirtyMask;
+};
+
+struct Trace {
+    const char *name;
+    std::vector<Frame> frames;
+};
+
+static ExynosWindowUpdatePlanner::Params params = {
+    1080, 1920,     /* xres, yres */
+    1, 1,           /* xAlign, wAlign */
+    1,              /* minHeight */
+    75,             /* thresholdPercent */
+    128,            /* burstLenBytes */
+};
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void setWindow(Frame &f, int win, int x, int y, int w, int h,
+        enum decon_pixel_format format, bool dirty)
+{
+    struct decon_win_config &cfg = f.config[win];
+
+    cfg.state = cfg.DECON_WIN_STATE_BUFFER;
+    cfg.format = format;
+    cfg.dst.x = x;
+    cfg.dst.y = y;
+    cfg.dst.w = w;
+    cfg.dst.h = h;
+    f.windowMask |= 1 << win;
+    if (dirty)
+        f.dirtyMask |= 1 << win;
+}
+
+/*
+ * The update region computation of ExynosPrimaryDisplay::handleWindowUpdate()
+ * before the planner, with the layers replaced by the window mask: union of
+ * the dirty windows, alignment, minimum height, threshold, then widening by
+ * one step until every window sees a full burst.
+ */
+static int legacyPlan(const Frame &f, struct decon_win_rect *update)
+{
+    const ExynosWindowUpdatePlanner::Params &p = params;
+    struct decon_rect r = { p.xres, p.yres, 0, 0 };
+    int updated = 0;
+
+    for (int win = 0; win < MAX_DECON_WIN; win++) {
+        const struct decon_win_config &cfg = f.config[win];
+
+        if (!(f.windowMask & (1 << win)) || !(f.dirtyMask & (1 << win)) ||
+                cfg.state == cfg.DECON_WIN_STATE_DISABLED)
+            continue;
+        updated++;
+        if (cfg.dst.x < r.left) r.left = cfg.dst.x;
+        if (cfg.dst.y < r.top) r.top = cfg.dst.y;
+        if (cfg.dst.x + (int)cfg.dst.w > r.right) r.right = cfg.dst.x + cfg.dst.w;
+        if (cfg.dst.y + (int)cfg.dst.h > r.bottom) r.bottom = cfg.dst.y + cfg.dst.h;
+    }
+    if (updated == 0)
+        return ExynosWindowUpdatePlanner::PLAN_NOT_UPDATED;
+
+    r.left = r.left - r.left % p.xAlign;
+    r.right = r.left + ((r.right - r.left + p.wAlign - 1) / p.wAlign) * p.wAlign;
+
+    if (r.bottom - r.top < p.minHeight) {
+        if (r.top + p.minHeight <= p.yres)
+            r.bottom = r.top + p.minHeight;
+        else
+            r.top = r.bottom - p.minHeight;
+    }
+
+    if ((100 * ((r.right - r.left) * (r.bottom - r.top)) / (p.xres * p.yres)) > p.thresholdPercent)
+        return ExynosWindowUpdatePlanner::PLAN_OVER_THRESHOLD;
+
+    int alignAdjustment = p.xAlign > p.wAlign ? p.xAlign : p.wAlign;
+
+    while (1) {
+        bool burstLengthCheckDone = true;
+
+        for (int win = 0; win < MAX_DECON_WIN; win++) {
+            const struct decon_win_config &cfg = f.config[win];
+
+            if (!(f.windowMask & (1 << win)) || cfg.state == cfg.DECON_WIN_STATE_DISABLED)
+                continue;
+            int bitsPerPixel = ExynosWindowUpdatePlanner::bitsPerPixel(cfg.format);
+            int left = cfg.dst.x > r.left ? cfg.dst.x : r.left;
+            int right = cfg.dst.x + (int)cfg.dst.w < r.right ? cfg.dst.x + (int)cfg.dst.w : r.right;
+            int intersectionWidth = right - left;
+
+            if (intersectionWidth != 0 &&
+                    (size_t)((intersectionWidth * bitsPerPixel) / 8) < (size_t)p.burstLenBytes) {
+                burstLengthCheckDone = false;
+                break;
+            }
+        }
+
+        if (burstLengthCheckDone)
+            break;
+        if (r.left >= alignAdjustment)
+            r.left -= alignAdjustment;
+        else if (r.right + alignAdjustment <= p.xres)
+            r.right += alignAdjustment;
+        else
+            return ExynosWindowUpdatePlanner::PLAN_ADJUSTMENT_FAIL;
+    }
+
+    update->x = r.left;
+    update->y = r.top;
+    update->w = ((r.right - r.left + p.wAlign - 1) / p.wAlign) * p.wAlign;
+    update->h = r.bottom - r.top;
+    return ExynosWindowUpdatePlanner::PLAN_OK;
+}
+
+static int plannerPlan(ExynosWindowUpdatePlanner &planner, const Frame &f,
+        struct decon_win_rect *update)
+{
+    planner.begin(f.config, f.windowMask);
+    for (int win = 0; win < MAX_DECON_WIN; win++) {
+        if (f.dirtyMask & (1 << win))
+            planner.addDirtyWindow(win);
+    }
+    return planner.plan(update);
+}
+
+static const enum decon_pixel_format randomFormats[] = {
+    DECON_PIXEL_FORMAT_RGBA_8888,
+    DECON_PIXEL_FORMAT_RGB_565,
+    DECON_PIXEL_FORMAT_NV12M,
+    DECON_PIXEL_FORMAT_BGRA_8888,
+};
+
+static void randomFrame(Frame &f)
+{
+    memset(&f, 0, sizeof(f));
+
+    int windows = 1 + rand() % 5;
+    for (int win = 0; win < windows; win++) {
+        int w = 1 + rand() % params.xres;
+        int h = 1 + rand() % params.yres;
+        /* Mostly narrow windows, where the burst length matters */
+        if (rand() % 2)
+            w = 1 + rand() % 64;
+        int x = rand() % (params.xres - w + 1);
+        int y = rand() % (params.yres - h + 1);
+
+        setWindow(f, win, x, y, w, h, randomFormats[rand() % 4], rand() % 3 == 0);
+    }
+}
+
+static int checkEquivalence(int frames)
+{
+    ExynosWindowUpdatePlanner planner;
+    int mismatches = 0;
+
+    planner.setParams(params);
+    for (int i = 0; i < frames; i++) {
+        struct decon_win_rect a = { 0, 0, 0, 0 };
+        struct decon_win_rect b = { 0, 0, 0, 0 };
+        Frame f;
+
+        randomFrame(f);
+        /* Without history, moved windows add nothing */
+        planner.reset();
+        int ra = legacyPlan(f, &a);
+        int rb = plannerPlan(planner, f, &b);
+        if (ra != rb || (ra == ExynosWindowUpdatePlanner::PLAN_OK && memcmp(&a, &b, sizeof(a)))) {
+            if (mismatches++ < 5)
+                fprintf(stderr, "mismatch in frame %d: legacy %d (%d,%d %ux%u) planner %d (%d,%d %ux%u)\n",
+                        i, ra, a.x, a.y, a.w, a.h, rb, b.x, b.y, b.w, b.h);
+        }
+    }
+
+    printf("equivalence: %d random frames, %d mismatches\n", frames, mismatches);
+    return mismatches ? -1 : 0;
+}
+
+static int checkMovedWindow(void)
+{
+    ExynosWindowUpdatePlanner planner;
+    struct decon_win_rect update;
+    Frame f;
+
+    planner.setParams(params);
+
+    memset(&f, 0, sizeof(f));
+    setWindow(f, 0, 0, 0, params.xres, params.yres, DECON_PIXEL_FORMAT_RGBA_8888, false);
+    setWindow(f, 1, 100, 200, 300, 100, DECON_PIXEL_FORMAT_RGBA_8888, true);
+    plannerPlan(planner, f, &update);
+
+    /* The window moves down: both its old and new place need an update */
+    setWindow(f, 1, 100, 400, 300, 100, DECON_PIXEL_FORMAT_RGBA_8888, true);
+    f.dirtyMask = 1 << 1;
+    int ret = plannerPlan(planner, f, &update);
+    if (ret != ExynosWindowUpdatePlanner::PLAN_OK || update.y > 200 || update.y + (int)update.h < 500) {
+        fprintf(stderr, "moved window: got %d (%d,%d %ux%u), expected 200..500 covered\n",
+                ret, update.x, update.y, update.w, update.h);
+        return -1;
+    }
+
+    printf("moved window: old and new area covered\n");
+    return 0;
+}
+
+static void syntheticTraces(std::vector<Trace> &traces, int frames)
+{
+    const int xres = params.xres;
+    const int yres = params.yres;
+    Trace clock = { "clock", std::vector<Frame>() };
+    Trace video = { "video+ui", std::vector<Frame>() };
+    Trace column = { "narrow column", std::vector<Frame>() };
+    Trace cursor = { "cursor", std::vector<Frame>() };
+
+    for (int i = 0; i < frames; i++) {
+        Frame f;
+
+        /* Status bar clock ticking over a static app */
+        memset(&f, 0, sizeof(f));
+        setWindow(f, 0, 0, 72, xres, yres - 72, DECON_PIXEL_FORMAT_RGBA_8888, false);
+        setWindow(f, 1, 0, 0, xres, 72, DECON_PIXEL_FORMAT_RGBA_8888, true);
+        clock.frames.push_back(f);
+
+        /* Video under static controls */
+        memset(&f, 0, sizeof(f));
+        setWindow(f, 0, 0, 0, xres, 608, DECON_PIXEL_FORMAT_NV12M, true);
+        setWindow(f, 1, 0, 1700, xres, 220, DECON_PIXEL_FORMAT_RGBA_8888, false);
+        video.frames.push_back(f);
+
+        /* A progress bar narrower than a burst next to static windows */
+        memset(&f, 0, sizeof(f));
+        setWindow(f, 0, 0, 0, xres, yres, DECON_PIXEL_FORMAT_RGBA_8888, false);
+        setWindow(f, 1, xres / 2, 300, 24, 600, DECON_PIXEL_FORMAT_RGB_565, false);
+        setWindow(f, 2, xres / 2 + 20, 900, 8, 8, DECON_PIXEL_FORMAT_RGBA_8888, true);
+        column.frames.push_back(f);
+
+        /* A text cursor blinking in an editor */
+        memset(&f, 0, sizeof(f));
+        setWindow(f, 0, 0, 0, xres, yres, DECON_PIXEL_FORMAT_RGBA_8888, false);
+        setWindow(f, 1, 40 + (i % 100) * 9, 800, 4, 48, DECON_PIXEL_FORMAT_RGBA_8888, true);
+        cursor.frames.push_back(f);
+    }
+
+    traces.push_back(clock);
+    traces.push_back(video);
+    traces.push_back(column);
+    traces.push_back(cursor);
+}
+
+static int loadTrace(const char *path, std::vector<Trace> &traces)
+{
+    Trace trace = { path, std::vector<Frame>() };
+    char line[1024];
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        Frame f;
+        int win = 0;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        memset(&f, 0, sizeof(f));
+        for (char *tok = strtok(line, " \t\n"); tok != NULL && win < MAX_DECON_WIN;
+                tok = strtok(NULL, " \t\n")) {
+            bool dirty = tok[0] == '*';
+            int x, y, w, h, format;
+
+            if (sscanf(tok + dirty, "%d,%d,%d,%d,%d", &x, &y, &w, &h, &format) != 5 ||
+                    format < 0 || format >= DECON_PIXEL_FORMAT_MAX) {
+                fprintf(stderr, "%s: bad window '%s'\n", path, tok);
+                fclose(file);
+                return -1;
+            }
+            setWindow(f, win++, x, y, w, h, (enum decon_pixel_format)format, dirty);
+        }
+        trace.frames.push_back(f);
+    }
+    fclose(file);
+
+    traces.push_back(trace);
+    return 0;
+}
+
+static void benchmark(const Trace &trace, int rounds)
+{
+    ExynosWindowUpdatePlanner planner;
+    struct decon_win_rect update;
+    size_t frames = trace.frames.size();
+    uint64_t start, legacyNs, plannerNs;
+    unsigned int sink = 0;
+
+    if (frames == 0)
+        return;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < frames; i++)
+            sink += legacyPlan(trace.frames[i], &update) + update.w;
+    }
+    legacyNs = nowNs() - start;
+
+    planner.setParams(params);
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < frames; i++)
+            sink += plannerPlan(planner, trace.frames[i], &update) + update.w;
+    }
+    plannerNs = nowNs() - start;
+
+    printf("%-16s %6zu frames  legacy %8.1f ns/frame  planner %8.1f ns/frame  (%u)\n",
+            trace.name, frames,
+            (double)legacyNs / (rounds * frames),
+            (double)plannerNs / (rounds * frames), sink & 1);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-r trace] [-n frames] [-x xalign] [-w walign] [-b burst]\n"
+            "  -r  replay a recorded trace instead of the synthetic ones\n"
+            "  -n  random frames to check and frames per synthetic trace (default 10000)\n"
+            "  -x  left edge alignment (default %d)\n"
+            "  -w  width alignment (default %d)\n"
+            "  -b  DMA burst length in bytes (default %d)\n",
+            name, params.xAlign, params.wAlign, params.burstLenBytes);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<Trace> traces;
+    const char *tracePath = NULL;
+    int frames = 10000;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:n:x:w:b:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            tracePath = optarg;
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'x':
+            params.xAlign = atoi(optarg);
+            break;
+        case 'w':
+            params.wAlign = atoi(optarg);
+            break;
+        case 'b':
+            params.burstLenBytes = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (frames < 1 || params.xAlign < 1 || params.wAlign < 1 || params.burstLenBytes < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    if (checkEquivalence(frames) != 0)
+        ret = 1;
+    if (checkMovedWindow() != 0)
+        ret = 1;
+
+    if (tracePath != NULL) {
+        if (loadTrace(tracePath, traces) != 0)
+            return 1;
+    } else {
+        syntheticTraces(traces, 1000);
+    }
+    for (size_t i = 0; i < traces.size(); i++)
+        benchmark(traces[i], tracePath != NULL ? 1 : frames / 1000 + 1);
+
+    return ret;
+}
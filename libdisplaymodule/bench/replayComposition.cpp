@@ -0,0 +1,1104 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host replay of recorded composition through the display module code.
+ *
+ * The recording is the ExynosHWCTrace part of dumpsys SurfaceFlinger,
+ * given with -f; several dumps can be concatenated, frames seen before are
+ * skipped. Without -f a built-in synthetic recording is replayed, and -w
+ * writes it out in the same form. The primary display records its layers
+ * at assignWindows(), the virtual display at set() together with its sink
+ * buffer. Handle, format, size, crop, frame, transform and DRM mode of the
+ * records stand in for the gralloc handles.
+ *
+ * Which layers are overlays is decided by the common ExynosDisplay code,
+ * which is not part of this tree and does not build off target, so the
+ * replay takes those decisions from the recording. It runs what the
+ * display modules do with them, against mock gralloc buffers and a fake
+ * DECON and MSC:
+ *   primary  the IDMA channel solve and bandwidth check of assignWindows(),
+ *            through ExynosCompositionCache like the display (-n without),
+ *            the window update region of handleWindowUpdate() for the
+ *            windows whose buffer or position changed, and the MSC
+ *            destination buffers of postMPPM2M() for the layers the DECON
+ *            cannot read as they are
+ *   virtual  the MSC jobs postToMPP() runs, planned by ExynosWfdBlendPlanner
+ * and reports, per frame, the CPU time of that work, overlay and GLES
+ * layers, the bytes the DECON reads and the MSC moves, and the window
+ * update area. -t, -b and -o set limits that make it exit non-zero.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ExynosIdmaSolver.h"
+#include "ExynosBandwidthModel.h"
+#include "ExynosWindowUpdatePlanner.h"
+#include "ExynosMPPDstPool.h"
+#include "ExynosHWCTrace.h"
+#include "ExynosWfdBlendPlanner.h"
+#include "ExynosCompositionCache.h"
+
+#define MAX_LAYERS          32
+#define NUM_CHANNELS        3       /* IDMA_G0, IDMA_G1, IDMA_G2 */
+#define SECURE_CHANNEL      2
+#define NUM_MSC_SLOTS       3
+
+/* hwc_layer_1_t compositionType */
+#define HWC_FRAMEBUFFER         0
+#define HWC_OVERLAY             1
+#define HWC_FRAMEBUFFER_TARGET  3
+
+/* getDrmMode() of ExynosHWCUtils.h */
+enum { NO_DRM, NORMAL_DRM, SECURE_DRM };
+
+/* HAL formats told apart; anything else is taken for 12bpp YUV */
+#define FMT_RGBA_8888       1
+#define FMT_RGBX_8888       2
+#define FMT_RGB_888         3
+#define FMT_RGB_565         4
+#define FMT_BGRA_8888       5
+
+/* Formats of the built-in recording */
+#define SYNTH_NV12M         0x105
+#define SYNTH_NV21M_FULL    0x11e
+
+#define USAGE_PROTECTED     0x4000
+
+typedef ExynosHWCTrace::Record Record;
+
+struct Frame {
+    uint32_t number;
+    bool isVirtual;
+    bool hasOutbuf;
+    Record outbuf;
+    Record layers[MAX_LAYERS];
+    size_t numLayers;
+};
+
+struct Result {
+    uint64_t cpuNs;
+    unsigned int overlays;
+    unsigned int gles;
+    uint64_t deconBytes;        /* read by the DECON for the frame */
+    bool overTotal;
+    bool solveFailed;
+    int updatePercent;          /* window update region, 100 for a full update */
+    unsigned int mscJobs;
+    uint64_t mscBytes;
+};
+
+static int gXres = 1080;
+static int gYres = 1920;
+static int gRefresh = 60;
+static int gG2Format = -1;
+static bool gCache = true;
+static uint32_t gFirst, gLast = UINT32_MAX;
+static int gRepeat = 1;
+static int gVerbose;
+static int gErrors;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool isRgb(int format)
+{
+    return format >= FMT_RGBA_8888 && format <= FMT_BGRA_8888;
+}
+
+static uint32_t formatBpp(int format)
+{
+    switch (format) {
+    case FMT_RGB_888:
+        return 24;
+    case FMT_RGB_565:
+        return 16;
+    default:
+        return isRgb(format) ? 32 : 12;
+    }
+}
+
+static enum decon_pixel_format deconFormat(int format)
+{
+    switch (format) {
+    case FMT_RGBA_8888:
+        return DECON_PIXEL_FORMAT_RGBA_8888;
+    case FMT_BGRA_8888:
+        return DECON_PIXEL_FORMAT_BGRA_8888;
+    case FMT_RGB_565:
+        return DECON_PIXEL_FORMAT_RGB_565;
+    case FMT_RGBX_8888:
+    case FMT_RGB_888:
+        return DECON_PIXEL_FORMAT_RGBX_8888;
+    default:
+        return DECON_PIXEL_FORMAT_NV21M_FULL;
+    }
+}
+
+static int rectWidth(const Record &r)
+{
+    return r.rect[2] - r.rect[0];
+}
+
+static int rectHeight(const Record &r)
+{
+    return r.rect[3] - r.rect[1];
+}
+
+static uint32_t cropWidth(const Record &r)
+{
+    return (uint32_t)(r.crop[2] - r.crop[0]);
+}
+
+static uint32_t cropHeight(const Record &r)
+{
+    return (uint32_t)(r.crop[3] - r.crop[1]);
+}
+
+/****************************************************************************
+ * Mock gralloc for the MSC destination buffers
+ */
+
+class MockAllocator : public ExynosMPPDstPool::Allocator {
+    typedef ExynosMPPDstPool::Buffer Buffer;
+    typedef ExynosMPPDstPool::Key Key;
+
+    public:
+        ~MockAllocator() {
+            for (std::map<Buffer, Key>::iterator it = mLive.begin(); it != mLive.end(); ++it)
+                free((void *)it->first);
+            for (size_t i = 0; i < mFreed.size(); i++)
+                free(mFreed[i]);
+        }
+
+        virtual int allocDstBuffer(const Key &key, Buffer *buf) {
+            native_handle_t *h = (native_handle_t *)calloc(1, sizeof(native_handle_t));
+
+            h->version = sizeof(native_handle_t);
+            mLive[h] = key;
+            *buf = h;
+            return 0;
+        }
+
+        virtual void freeDstBuffer(Buffer buf) {
+            if (mLive.erase(buf) != 1) {
+                fprintf(stderr, "freeing a buffer that is not allocated\n");
+                gErrors++;
+                return;
+            }
+            mFreed.push_back((void *)buf);
+        }
+
+        virtual bool describeDstBuffer(Buffer buf, Key *key) {
+            std::map<Buffer, Key>::iterator it = mLive.find(buf);
+
+            if (it == mLive.end())
+                return false;
+            *key = it->second;
+            return true;
+        }
+
+    private:
+        std::map<Buffer, Key> mLive;
+        std::vector<void *> mFreed;
+};
+
+/****************************************************************************
+ * Primary display: assignWindows(), handleWindowUpdate(), postMPPM2M()
+ */
+
+class PrimaryReplay {
+    public:
+        PrimaryReplay();
+        ~PrimaryReplay();
+
+        void run(const Frame &frame, Result &result);
+
+        ExynosBandwidthModel model;
+        ExynosMPPDstPool pool;
+        ExynosCompositionCache cache;
+        unsigned int moves;
+
+    private:
+        ExynosIdmaSolver::Channel mChannels[NUM_CHANNELS];
+        ExynosWindowUpdatePlanner mPlanner;
+        MockAllocator mAllocator;
+        /* previous channel by layer index, like mLayerInfos[i]->mDmaType */
+        int mPrevChannel[MAX_LAYERS];
+        struct decon_win_config mLastConfig[MAX_DECON_WIN];
+        uint64_t mLastHandle[MAX_DECON_WIN];
+        uint32_t mLastWindowMask;
+        ExynosMPPDstPool::Buffer mSlots[NUM_MSC_SLOTS];
+        int mSlotFences[NUM_MSC_SLOTS];
+        size_t mCurrentSlot;
+
+        bool needsMsc(const Record &layer, bool direct) const;
+};
+
+PrimaryReplay::PrimaryReplay() :
+    moves(0),
+    mLastWindowMask(0),
+    mCurrentSlot(0)
+{
+    ExynosBandwidthModel::Limits limits;
+    ExynosWindowUpdatePlanner::Params params = {
+        gXres, gYres, 1, 1, 1, 75, 128 };
+
+    memset(&limits, 0, sizeof(limits));
+    limits.burstBytes = 16 * 16;
+    model.setLimits(limits);
+
+    /* FIMD_BW_FRAME_RATE(1920, 1080) of the board table in ExynosHWCModule.h */
+    uint64_t landscape = model.lineBytes(1920, 32) * 1080;
+    uint64_t portrait = model.lineBytes(1080, 32) * 1920;
+    uint64_t frameRate = std::max(landscape, portrait) * 60;
+
+    limits.numChannels = NUM_CHANNELS;
+    for (size_t c = 0; c < NUM_CHANNELS; c++) {
+        limits.channelBytesPerSec[c] = frameRate;
+        limits.channelOverlap[c] = 1;
+        mChannels[c].idma = c;
+        mChannels[c].secure = (c == SECURE_CHANNEL);
+    }
+    limits.totalBytesPerSec = 3 * frameRate;
+    model.setLimits(limits);
+    model.setDisplay(gYres, gRefresh);
+
+    mPlanner.setParams(params);
+    pool.setAllocator(&mAllocator);
+
+    for (size_t i = 0; i < MAX_LAYERS; i++)
+        mPrevChannel[i] = -1;
+    memset(mLastConfig, 0, sizeof(mLastConfig));
+    memset(mLastHandle, 0, sizeof(mLastHandle));
+    memset(mSlots, 0, sizeof(mSlots));
+    for (size_t s = 0; s < NUM_MSC_SLOTS; s++)
+        mSlotFences[s] = -1;
+}
+
+PrimaryReplay::~PrimaryReplay()
+{
+    pool.clear();
+}
+
+/* What ExynosDisplay hands to the MSC before the DECON */
+bool PrimaryReplay::needsMsc(const Record &layer, bool direct) const
+{
+    if (layer.type != HWC_OVERLAY)
+        return false;
+    if (!isRgb(layer.format) && !direct)
+        return true;
+    return layer.transform != 0 ||
+            cropWidth(layer) != (uint32_t)rectWidth(layer) ||
+            cropHeight(layer) != (uint32_t)rectHeight(layer);
+}
+
+void PrimaryReplay::run(const Frame &frame, Result &result)
+{
+    ExynosIdmaSolver::Layer layers[NUM_CHANNELS];
+    ExynosBandwidthModel::Layer direct[NUM_CHANNELS], converted[NUM_CHANNELS];
+    ExynosBandwidthModel::Layer reads[NUM_CHANNELS];
+    size_t layerIndex[NUM_CHANNELS];
+    int assignment[NUM_CHANNELS];
+    size_t numWindows = 0;
+    bool fbNeeded = false;
+    ExynosIdmaSolver solver;
+
+    for (size_t i = 0; i < frame.numLayers; i++) {
+        if (frame.layers[i].type == HWC_FRAMEBUFFER) {
+            result.gles++;
+            fbNeeded = true;
+        } else if (frame.layers[i].type == HWC_OVERLAY) {
+            result.overlays++;
+        }
+    }
+
+    /* assignWindows() */
+    ExynosCompositionCache::Key key;
+    size_t numCandidates = 0;
+
+    key.add((int32_t)gXres);
+    key.add((int32_t)gYres);
+    key.add((int32_t)gRefresh);
+    key.add((int32_t)gG2Format);
+
+    for (size_t i = 0; i < frame.numLayers; i++) {
+        const Record &layer = frame.layers[i];
+
+        if (layer.type == HWC_FRAMEBUFFER_TARGET ? !fbNeeded : layer.type != HWC_OVERLAY)
+            continue;
+        if (numCandidates++ == NUM_CHANNELS) {
+            result.solveFailed = true;
+            break;
+        }
+
+        ExynosIdmaSolver::Layer &l = layers[numWindows];
+
+        l.pixels = rectWidth(layer) * rectHeight(layer);
+        l.drm = layer.drm == SECURE_DRM;
+        l.directBpp = formatBpp(layer.format);
+        l.directMask = 0;
+        l.prevChannel = layer.layer < MAX_LAYERS ? mPrevChannel[layer.layer] : -1;
+        if (isRgb(layer.format)) {
+            l.convertedBpp = l.directBpp;
+            l.directMask = (1 << NUM_CHANNELS) - 1;
+        } else {
+            l.convertedBpp = 32;
+            if (layer.format == gG2Format && rectWidth(layer) % 2 == 0 &&
+                    rectHeight(layer) % 2 == 0)
+                l.directMask = 1 << SECURE_CHANNEL;
+        }
+
+        converted[numWindows].channel = -1;
+        converted[numWindows].srcW = rectWidth(layer);
+        converted[numWindows].srcH = rectHeight(layer);
+        converted[numWindows].dstTop = layer.rect[1];
+        converted[numWindows].dstBottom = layer.rect[3];
+        converted[numWindows].bpp = l.convertedBpp;
+        direct[numWindows] = converted[numWindows];
+        direct[numWindows].bpp = l.directBpp;
+        if (!isRgb(layer.format)) {
+            direct[numWindows].srcW = cropWidth(layer);
+            direct[numWindows].srcH = cropHeight(layer);
+        }
+
+        /* windowKey() */
+        key.add((uint32_t)layer.layer);
+        key.add((int32_t)layer.type);
+        key.add((int32_t)layer.format);
+        key.add((int32_t)layer.drm);
+        key.add(layer.rect[0], layer.rect[1], layer.rect[2], layer.rect[3]);
+        for (size_t k = 0; k < 4; k++)
+            key.add(layer.crop[k]);
+        key.add((int32_t)l.prevChannel);
+        layerIndex[numWindows++] = i;
+    }
+    key.add((uint32_t)numCandidates);
+
+    int32_t decision[COMPOSITION_CACHE_VALUE_WORDS];
+    bool cached = gCache && cache.lookup(key, decision) >= 0;
+
+    if (cached) {
+        result.solveFailed = decision[0];
+        result.overTotal = decision[1];
+        for (size_t w = 0; w < numWindows; w++)
+            assignment[w] = decision[2 + w];
+    } else {
+        /* solveWindows() */
+        for (size_t w = 0; w < numWindows; w++) {
+            ExynosIdmaSolver::Layer &l = layers[w];
+
+            l.fitMask = 0;
+            for (size_t c = 0; c < NUM_CHANNELS; c++) {
+                const ExynosBandwidthModel::Layer &read =
+                        (l.directMask & (1 << c)) ? direct[w] : converted[w];
+                if (model.channelFits(c, 0, read))
+                    l.fitMask |= 1 << c;
+            }
+        }
+
+        if (!result.solveFailed && numWindows &&
+                solver.solve(mChannels, NUM_CHANNELS, layers, numWindows, assignment) < 0)
+            result.solveFailed = true;
+
+        if (result.solveFailed) {
+            /* the common code keeps its default mapping, read as converted */
+            for (size_t w = 0; w < numWindows; w++)
+                assignment[w] = w;
+        } else {
+            moves += solver.moves();
+        }
+
+        for (size_t w = 0; w < numWindows; w++) {
+            bool isDirect = layers[w].directMask & (1 << assignment[w]);
+
+            reads[w] = isDirect ? direct[w] : converted[w];
+            reads[w].channel = assignment[w];
+        }
+        result.overTotal = numWindows && !model.fits(reads, numWindows);
+
+        decision[0] = result.solveFailed;
+        decision[1] = result.overTotal;
+        for (size_t w = 0; w < numWindows; w++)
+            decision[2 + w] = assignment[w];
+        if (gCache)
+            cache.store(key, decision, 2 + numWindows);
+    }
+
+    for (size_t w = 0; w < numWindows; w++) {
+        const Record &layer = frame.layers[layerIndex[w]];
+        bool isDirect = layers[w].directMask & (1 << assignment[w]);
+
+        reads[w] = isDirect ? direct[w] : converted[w];
+        reads[w].channel = assignment[w];
+        result.deconBytes += model.layerRate(reads[w]) / gRefresh;
+        if (layer.layer < MAX_LAYERS)
+            mPrevChannel[layer.layer] = assignment[w];
+
+        /* postMPPM2M(): the MSC writes the buffer the window reads */
+        if (needsMsc(layer, isDirect)) {
+            ExynosMPPDstPool::Key key = { FMT_RGBX_8888,
+                (uint32_t)rectWidth(layer), (uint32_t)rectHeight(layer),
+                layer.drm == SECURE_DRM ? USAGE_PROTECTED : 0 };
+
+            if (pool.fillSlot(mSlots, mSlotFences, NUM_MSC_SLOTS, mCurrentSlot, key) < 0)
+                gErrors++;
+            mCurrentSlot = (mCurrentSlot + 1) % NUM_MSC_SLOTS;
+            result.mscJobs++;
+            result.mscBytes += (uint64_t)cropWidth(layer) * cropHeight(layer) *
+                    formatBpp(layer.format) / 8 + (uint64_t)rectWidth(layer) * rectHeight(layer) * 4;
+        }
+    }
+
+    /* handleWindowUpdate(): windows with a new buffer or place are dirty */
+    struct decon_win_config config[MAX_DECON_WIN];
+    uint32_t windowMask = 0;
+
+    memset(config, 0, sizeof(config));
+    for (size_t w = 0; w < numWindows; w++) {
+        const Record &layer = frame.layers[layerIndex[w]];
+
+        config[w].state = config[w].DECON_WIN_STATE_BUFFER;
+        config[w].format = deconFormat(reads[w].bpp == 32 && !isRgb(layer.format) ?
+                FMT_RGBX_8888 : layer.format);
+        config[w].dst.x = layer.rect[0];
+        config[w].dst.y = layer.rect[1];
+        config[w].dst.w = rectWidth(layer);
+        config[w].dst.h = rectHeight(layer);
+        windowMask |= 1 << w;
+    }
+
+    if (windowMask != mLastWindowMask || result.solveFailed) {
+        mPlanner.reset();
+        result.updatePercent = 100;
+    } else {
+        struct decon_win_rect update;
+        int ret;
+
+        mPlanner.begin(config, windowMask);
+        for (size_t w = 0; w < numWindows; w++) {
+            const Record &layer = frame.layers[layerIndex[w]];
+
+            /* the FB target has no buffer yet at assignWindows() */
+            if ((layer.type == HWC_FRAMEBUFFER_TARGET && !layer.handle) ||
+                    layer.handle != mLastHandle[w] ||
+                    memcmp(&config[w].dst, &mLastConfig[w].dst, sizeof(config[w].dst)) ||
+                    config[w].format != mLastConfig[w].format)
+                mPlanner.addDirtyWindow(w);
+        }
+        ret = mPlanner.plan(&update);
+        if (ret == ExynosWindowUpdatePlanner::PLAN_OK)
+            result.updatePercent = (int)((uint64_t)update.w * update.h * 100 /
+                    ((uint64_t)gXres * gYres));
+        else if (ret == ExynosWindowUpdatePlanner::PLAN_NOT_UPDATED)
+            result.updatePercent = 0;
+        else
+            result.updatePercent = 100;
+    }
+
+    for (size_t w = 0; w < numWindows; w++) {
+        mLastConfig[w] = config[w];
+        mLastHandle[w] = frame.layers[layerIndex[w]].handle;
+    }
+    mLastWindowMask = windowMask;
+}
+
+/****************************************************************************
+ * Virtual display: the MSC jobs of postToMPP()
+ */
+
+class VirtualReplay {
+    public:
+        void run(const Frame &frame, Result &result);
+
+        ExynosWfdBlendPlanner planner;
+};
+
+void VirtualReplay::run(const Frame &frame, Result &result)
+{
+    const Record *video = NULL, *fbTarget = NULL;
+    bool fbNeeded = false;
+
+    for (size_t i = 0; i < frame.numLayers; i++) {
+        const Record &layer = frame.layers[i];
+
+        if (layer.type == HWC_OVERLAY && !video) {
+            video = &layer;
+            result.overlays++;
+        } else if (layer.type == HWC_OVERLAY) {
+            result.overlays++;
+        } else if (layer.type == HWC_FRAMEBUFFER) {
+            fbNeeded = true;
+            result.gles++;
+        } else if (layer.type == HWC_FRAMEBUFFER_TARGET && layer.handle) {
+            fbTarget = &layer;
+        }
+    }
+
+    const Record &out = frame.outbuf;
+    uint64_t outBytes = (uint64_t)out.width * out.height * formatBpp(out.format) / 8;
+
+    if (!video || !frame.hasOutbuf) {
+        /* GLES writes the outbuf */
+        if (frame.hasOutbuf)
+            planner.invalidate((const void *)(uintptr_t)out.handle);
+        return;
+    }
+
+    ExynosWfdBlendPlanner::Frame f;
+    uint64_t videoBytes = (uint64_t)cropWidth(*video) * cropHeight(*video) *
+            formatBpp(video->format) / 8;
+    uint64_t videoRectBytes = (uint64_t)rectWidth(*video) * rectHeight(*video) *
+            formatBpp(out.format) / 8;
+
+    f.outbuf = (const void *)(uintptr_t)out.handle;
+    f.outWidth = out.width;
+    f.outHeight = out.height;
+    /* SurfaceFlinger keeps passing the last FB target when GLES has nothing to draw */
+    f.fbTarget = fbTarget ? (const void *)(uintptr_t)fbTarget->handle : NULL;
+    f.fbRendered = fbNeeded;
+    if (fbTarget) {
+        f.fbCrop.left = (int)fbTarget->crop[0];
+        f.fbCrop.top = (int)fbTarget->crop[1];
+        f.fbCrop.right = (int)fbTarget->crop[2];
+        f.fbCrop.bottom = (int)fbTarget->crop[3];
+    } else {
+        memset(&f.fbCrop, 0, sizeof(f.fbCrop));
+    }
+    f.videoFrame.left = video->rect[0];
+    f.videoFrame.top = video->rect[1];
+    f.videoFrame.right = video->rect[2];
+    f.videoFrame.bottom = video->rect[3];
+    f.videoCovers = rectWidth(*video) == (int)out.width && rectHeight(*video) == (int)out.height;
+
+    switch (planner.plan(f)) {
+    case ExynosWfdBlendPlanner::PLAN_SCALE:
+        result.mscJobs = 1;
+        result.mscBytes = videoBytes + videoRectBytes;
+        break;
+    case ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND:
+        /* the FB target scaled into the whole outbuf first */
+        planner.filled(f);
+        result.mscJobs = 2;
+        result.mscBytes = (uint64_t)(f.fbCrop.right - f.fbCrop.left) *
+                (f.fbCrop.bottom - f.fbCrop.top) * 4 + outBytes;
+        result.mscBytes += videoBytes + 2 * videoRectBytes;
+        break;
+    default:
+        /* the video blended over the FB target inside its rect */
+        result.mscJobs = 1;
+        result.mscBytes = videoBytes + 2 * videoRectBytes;
+        break;
+    }
+}
+
+/****************************************************************************
+ * Recordings
+ */
+
+struct Section {
+    std::vector<Frame> frames;
+    bool isVirtual;
+    bool wrapped;           /* the ring lost records, the first frame may be partial */
+};
+
+static Frame *frameOf(Section &section, uint32_t number)
+{
+    if (section.frames.empty() || section.frames.back().number != number) {
+        section.frames.push_back(Frame());
+        Frame &f = section.frames.back();
+        memset(&f, 0, sizeof(f));
+        f.number = number;
+    }
+    return &section.frames.back();
+}
+
+/*
+ * Virtual display frames take the layers at set(), after the composition
+ * was decided; the primary only records them at assignWindows(). Frames
+ * before the last one of the same display in an earlier dump are skipped.
+ */
+static void addSection(Section &section, std::vector<Frame> &frames,
+        std::vector<Frame> &setLayers, uint32_t *lastNumber)
+{
+    size_t first = section.wrapped ? 1 : 0;
+    uint32_t &last = lastNumber[section.isVirtual];
+
+    for (size_t i = first; i < section.frames.size(); i++) {
+        Frame &f = section.frames[i];
+
+        if (last && f.number <= last)
+            continue;
+        if (section.isVirtual && setLayers[i].numLayers) {
+            memcpy(f.layers, setLayers[i].layers, sizeof(f.layers));
+            f.numLayers = setLayers[i].numLayers;
+        }
+        f.isVirtual = section.isVirtual;
+        frames.push_back(f);
+        last = f.number;
+    }
+    section.frames.clear();
+    setLayers.clear();
+}
+
+static int loadRecording(FILE *file, std::vector<Frame> &frames)
+{
+    Section section;
+    std::vector<Frame> setLayers;
+    uint32_t lastNumber[2] = { 0, 0 };
+    char line[512];
+    unsigned int parsed = 0;
+
+    section.isVirtual = false;
+    section.wrapped = false;
+
+    while (fgets(line, sizeof(line), file)) {
+        unsigned int shown, written;
+        Record r;
+
+        if (sscanf(line, " trace: %u of %u records", &shown, &written) == 2) {
+            addSection(section, frames, setLayers, lastNumber);
+            section.isVirtual = false;
+            section.wrapped = written > shown;
+            continue;
+        }
+        if (!ExynosHWCTrace::parse(line, &r))
+            continue;
+        parsed++;
+
+        Frame *f = frameOf(section, r.frame);
+        if (setLayers.size() < section.frames.size()) {
+            setLayers.push_back(Frame());
+            setLayers.back().numLayers = 0;
+        }
+
+        switch (r.event) {
+        case HWC_TRACE_OUTBUF:
+            f->outbuf = r;
+            f->hasOutbuf = true;
+            section.isVirtual = true;
+            break;
+        case HWC_TRACE_PREPARE:
+            if (f->numLayers < MAX_LAYERS)
+                f->layers[f->numLayers++] = r;
+            break;
+        case HWC_TRACE_SET: {
+            Frame &s = setLayers.back();
+            if (s.numLayers < MAX_LAYERS)
+                s.layers[s.numLayers++] = r;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    addSection(section, frames, setLayers, lastNumber);
+
+    if (parsed == 0) {
+        fprintf(stderr, "no trace records found\n");
+        return -1;
+    }
+    return 0;
+}
+
+/****************************************************************************
+ * Built-in recording, written through ExynosHWCTrace and dumped every few
+ * frames the way periodic dumpsys calls would
+ */
+
+struct Dump {
+    std::string text;
+
+    void append(const char *s) { text += s; }
+};
+
+static void synthLayer(ExynosHWCTrace &trace, uint8_t event, size_t index, int type,
+        int format, uint64_t handle, int w, int h, int l, int t, int r, int b,
+        int transform, int drm)
+{
+    Record *rec = trace.begin(event);
+
+    rec->layer = index;
+    rec->type = type;
+    rec->format = format;
+    rec->handle = handle;
+    rec->width = w;
+    rec->height = h;
+    rec->stride = w;
+    rec->vstride = h;
+    rec->crop[2] = w;
+    rec->crop[3] = h;
+    rec->rect[0] = l;
+    rec->rect[1] = t;
+    rec->rect[2] = r;
+    rec->rect[3] = b;
+    rec->transform = transform;
+    rec->blending = type == HWC_FRAMEBUFFER_TARGET ? 0x105 : 0x100;
+    rec->drm = drm;
+    trace.commit(rec);
+}
+
+static void synthPrimaryFrame(ExynosHWCTrace &trace, int n)
+{
+    const int W = 1080, H = 1920, STATUS = 75, NAV = 144;
+    size_t i = 0;
+
+    trace.nextFrame();
+    if (n < 60) {
+        /* home screen, the clock ticks twice a second */
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, FMT_RGBX_8888, 0xa000,
+                W, H, 0, 0, W, H, 0, NO_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, FMT_RGBA_8888, 0xa100,
+                W, H - STATUS - NAV, 0, STATUS, W, H - NAV, 0, NO_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, FMT_RGBA_8888,
+                0xa200 + ((n / 30) & 1) * 0x10, W, STATUS, 0, 0, W, STATUS, 0, NO_DRM);
+    } else if (n < 150) {
+        /* scrolling a list: a new app buffer every frame, bars in GLES */
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, FMT_RGBA_8888,
+                0xb000 + (n % 3) * 0x10, W, H - STATUS - NAV, 0, STATUS, W, H - NAV, 0, NO_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_FRAMEBUFFER, FMT_RGBA_8888, 0xb100,
+                W, STATUS, 0, 0, W, STATUS, 0, NO_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_FRAMEBUFFER, FMT_RGBA_8888, 0xb200,
+                W, NAV, 0, H - NAV, W, H, 0, NO_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_FRAMEBUFFER_TARGET, FMT_RGBA_8888,
+                0, W, H, 0, 0, W, H, 0, NO_DRM);
+    } else if (n < 240) {
+        /* landscape video scaled by the MSC, controls in GLES now and then */
+        bool controls = (n / 45) & 1;
+
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, SYNTH_NV12M,
+                0xc000 + (n % 4) * 0x10, 1920, 1080, 0, 656, W, 1264, 0, NO_DRM);
+        if (controls) {
+            synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_FRAMEBUFFER, FMT_RGBA_8888, 0xc100,
+                    W, 300, 0, 1264, W, 1564, 0, NO_DRM);
+            synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_FRAMEBUFFER_TARGET, FMT_RGBA_8888,
+                    0, W, H, 0, 0, W, H, 0, NO_DRM);
+        }
+    } else {
+        /* protected video the secure channel reads as is, status bar on top */
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, SYNTH_NV21M_FULL,
+                0xd000 + (n % 4) * 0x10, W, 608, 0, 656, W, 1264, 0, SECURE_DRM);
+        synthLayer(trace, HWC_TRACE_PREPARE, i++, HWC_OVERLAY, FMT_RGBA_8888,
+                0xd100, W, STATUS, 0, 0, W, STATUS, 0, NO_DRM);
+    }
+}
+
+static void synthVirtualFrame(ExynosHWCTrace &trace, int n)
+{
+    const int W = 1280, H = 720;
+    uint64_t outbuf = 0xe000 + (n % 3) * 0x10;
+    /* subtitles show for 1s every 2s, GLES draws the next of three FB targets
+     * every frame they do and leaves the last one otherwise */
+    bool subtitles = n % 120 < 60;
+    uint64_t fbTarget = 0xe800 + ((subtitles ? n : n - n % 120 + 59) % 3) * 0x10;
+    Record *out;
+
+    trace.nextFrame();
+    out = trace.begin(HWC_TRACE_OUTBUF);
+    out->format = FMT_RGBA_8888;
+    out->handle = outbuf;
+    out->width = W;
+    out->height = H;
+    out->stride = W;
+    trace.commit(out);
+
+    /* a 2.39:1 movie letterboxed into the sink */
+    synthLayer(trace, HWC_TRACE_SET, 0, HWC_OVERLAY, SYNTH_NV12M, 0xe100 + (n % 4) * 0x10,
+            1920, 804, 0, 92, W, 628, 0, NO_DRM);
+    if (subtitles)
+        synthLayer(trace, HWC_TRACE_SET, 1, HWC_FRAMEBUFFER, FMT_RGBA_8888, 0xe200,
+                W, 100, 0, 600, W, 700, 0, NO_DRM);
+    synthLayer(trace, HWC_TRACE_SET, subtitles ? 2 : 1, HWC_FRAMEBUFFER_TARGET, FMT_RGBA_8888,
+            fbTarget, W, H, 0, 0, W, H, 0, NO_DRM);
+}
+
+static std::string synthRecording(int frames)
+{
+    ExynosHWCTrace *primary = new ExynosHWCTrace();
+    ExynosHWCTrace *virt = new ExynosHWCTrace();
+    Dump dump;
+
+    for (int n = 0; n < frames; n++) {
+        synthPrimaryFrame(*primary, n);
+        synthVirtualFrame(*virt, n);
+        if (n % 40 == 39 || n == frames - 1) {
+            dump.append("Display 0:\n");
+            primary->dump(dump);
+            dump.append("Display 2:\n");
+            virt->dump(dump);
+        }
+    }
+
+    delete primary;
+    delete virt;
+    return dump.text;
+}
+
+/****************************************************************************/
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-f recording] [-w file] [-d WxH] [-r hz] [-y fmt] [-s first-last]\n"
+            "          [-i count] [-n] [-v] [-t us] [-b MB] [-o]\n"
+            "  -f  replay dumpsys output holding ExynosHWCTrace records\n"
+            "  -w  write the built-in recording to file and exit\n"
+            "  -d  primary panel size (%dx%d)\n"
+            "  -r  refresh rate (%d)\n"
+            "  -y  HAL format IDMA_G2 reads as is, the platform's\n"
+            "      HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL\n"
+            "      (%#x for the built-in recording)\n"
+            "  -s  replay only these frames\n"
+            "  -i  replay the recording count times over, for steadier times\n"
+            "  -n  solve the IDMA channels of every frame, without the cache\n"
+            "  -v  one line per frame\n"
+            "  -t  fail if the 99th percentile CPU time per frame is above us\n"
+            "  -b  fail if the DECON reads more than MB per frame on average\n"
+            "  -o  fail if a frame reads more than the DECON total\n",
+            name, gXres, gYres, gRefresh, SYNTH_NV21M_FULL);
+}
+
+int main(int argc, char **argv)
+{
+    const char *recording = NULL, *out = NULL;
+    double maxP99Us = 0, maxMB = 0;
+    bool failOverTotal = false;
+    std::vector<Frame> frames;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:w:d:r:y:s:i:nvt:b:oh")) != -1) {
+        switch (opt) {
+        case 'f':
+            recording = optarg;
+            break;
+        case 'w':
+            out = optarg;
+            break;
+        case 'd':
+            if (sscanf(optarg, "%dx%d", &gXres, &gYres) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'r':
+            gRefresh = atoi(optarg);
+            break;
+        case 'y':
+            gG2Format = strtol(optarg, NULL, 0);
+            break;
+        case 's':
+            if (sscanf(optarg, "%u-%u", &gFirst, &gLast) < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'i':
+            gRepeat = atoi(optarg);
+            break;
+        case 'n':
+            gCache = false;
+            break;
+        case 'v':
+            gVerbose = 1;
+            break;
+        case 't':
+            maxP99Us = atof(optarg);
+            break;
+        case 'b':
+            maxMB = atof(optarg);
+            break;
+        case 'o':
+            failOverTotal = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (gXres <= 0 || gYres <= 0 || gRefresh <= 0 || gRepeat <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (recording) {
+        FILE *file = fopen(recording, "r");
+
+        if (!file) {
+            perror(recording);
+            return 1;
+        }
+        int ret = loadRecording(file, frames);
+        fclose(file);
+        if (ret < 0)
+            return 1;
+    } else {
+        std::string text = synthRecording(300);
+
+        if (gG2Format < 0)
+            gG2Format = SYNTH_NV21M_FULL;
+        if (out) {
+            FILE *file = fopen(out, "w");
+
+            if (!file || fputs(text.c_str(), file) < 0) {
+                perror(out);
+                return 1;
+            }
+            fclose(file);
+            return 0;
+        }
+
+        FILE *file = fmemopen((void *)text.data(), text.size(), "r");
+        if (!file || loadRecording(file, frames) < 0)
+            return 1;
+        fclose(file);
+    }
+
+    PrimaryReplay primary;
+    VirtualReplay virt;
+    std::vector<uint64_t> cpu;
+    uint64_t cpuNs[2] = { 0, 0 };
+    unsigned int numFrames[2] = { 0, 0 }, overlays[2] = { 0, 0 }, gles[2] = { 0, 0 };
+    unsigned int glesOnly = 0, solveFailed = 0, overTotal = 0, partial = 0, skipped = 0;
+    unsigned int mscJobs[2] = { 0, 0 };
+    uint64_t deconBytes = 0, mscBytes[2] = { 0, 0 }, updateArea = 0;
+
+    if (gVerbose)
+        printf("%6s %4s %4s %4s %9s %5s %6s %4s %9s %8s\n", "frame", "disp", "ovl",
+                "gles", "decon KB", "over", "upd %", "msc", "msc KB", "cpu ns");
+
+    for (size_t i = 0; i < frames.size() * gRepeat; i++) {
+        const Frame &f = frames[i % frames.size()];
+        Result r;
+        uint64_t start;
+
+        if (f.number < gFirst || f.number > gLast)
+            continue;
+
+        memset(&r, 0, sizeof(r));
+        start = nowNs();
+        if (f.isVirtual)
+            virt.run(f, r);
+        else
+            primary.run(f, r);
+        r.cpuNs = nowNs() - start;
+        cpu.push_back(r.cpuNs);
+        cpuNs[f.isVirtual] += r.cpuNs;
+
+        numFrames[f.isVirtual]++;
+        overlays[f.isVirtual] += r.overlays;
+        gles[f.isVirtual] += r.gles;
+        mscJobs[f.isVirtual] += r.mscJobs;
+        mscBytes[f.isVirtual] += r.mscBytes;
+        if (!f.isVirtual) {
+            deconBytes += r.deconBytes;
+            glesOnly += r.overlays == 0;
+            solveFailed += r.solveFailed;
+            overTotal += r.overTotal;
+            if (r.updatePercent < 100) {
+                partial++;
+                if (r.updatePercent == 0)
+                    skipped++;
+            }
+            updateArea += r.updatePercent;
+        }
+
+        if (gVerbose)
+            printf("%6u %4s %4u %4u %9llu %5s %6d %4u %9llu %8llu\n", f.number,
+                    f.isVirtual ? "virt" : "prim", r.overlays, r.gles,
+                    (unsigned long long)(r.deconBytes / 1024), r.overTotal ? "yes" : "",
+                    f.isVirtual ? -1 : r.updatePercent, r.mscJobs,
+                    (unsigned long long)(r.mscBytes / 1024), (unsigned long long)r.cpuNs);
+    }
+
+    if (cpu.empty()) {
+        fprintf(stderr, "no frames to replay\n");
+        return 1;
+    }
+
+    const ExynosMPPDstPool::Stats &pool = primary.pool.stats();
+    const ExynosWfdBlendPlanner::Stats &blend = virt.planner.stats();
+    uint64_t totalCpu = 0;
+
+    for (size_t i = 0; i < cpu.size(); i++)
+        totalCpu += cpu[i];
+    std::sort(cpu.begin(), cpu.end());
+    uint64_t p99 = cpu[cpu.size() * 99 / 100];
+    double avgMB = numFrames[0] ? (double)deconBytes / numFrames[0] / 1e6 : 0;
+
+    if (gVerbose)
+        printf("\n");
+    printf("primary %ux%u@%d: %u frames\n", gXres, gYres, gRefresh, numFrames[0]);
+    if (numFrames[0]) {
+        printf("  CPU:           %llu ns per frame\n",
+                (unsigned long long)(cpuNs[0] / numFrames[0]));
+        printf("  layers:        %u overlay, %u GLES; %u frames without overlays\n",
+                overlays[0], gles[0], glesOnly);
+        printf("  IDMA channels: %u frames without a mapping, %u layers moved channel, "
+                "%u frames from the cache\n", solveFailed, primary.moves,
+                primary.cache.stats().hits);
+        printf("  DECON reads:   %.2f MB per frame, %u frames over the total\n",
+                avgMB, overTotal);
+        printf("  window update: %u partial frames (%u with nothing to update), "
+                "%.0f%% of the screen on average\n",
+                partial, skipped, (double)updateArea / numFrames[0]);
+        printf("  MSC:           %u jobs, %.2f MB per frame, %u dst allocations, "
+                "%u reuses\n", mscJobs[0], (double)mscBytes[0] / numFrames[0] / 1e6,
+                pool.allocations, pool.reuses);
+    }
+    printf("virtual: %u frames\n", numFrames[1]);
+    if (numFrames[1]) {
+        printf("  CPU:           %llu ns per frame\n",
+                (unsigned long long)(cpuNs[1] / numFrames[1]));
+        printf("  layers:        %u overlay, %u GLES\n", overlays[1], gles[1]);
+        printf("  MSC:           %u jobs, %.2f MB per frame, %u fills kept\n",
+                mscJobs[1], (double)mscBytes[1] / numFrames[1] / 1e6, blend.fillsKept);
+    }
+    printf("CPU per frame:   %llu ns average, %llu ns median, %llu ns 99th percentile\n",
+            (unsigned long long)(totalCpu / cpu.size()),
+            (unsigned long long)cpu[cpu.size() / 2], (unsigned long long)p99);
+
+    int failed = 0;
+    if (maxP99Us > 0 && p99 > maxP99Us * 1000) {
+        printf("FAIL CPU time %.1f us over %.1f us\n", p99 / 1000.0, maxP99Us);
+        failed++;
+    }
+    if (maxMB > 0 && avgMB > maxMB) {
+        printf("FAIL DECON reads %.2f MB per frame, over %.2f MB\n", avgMB, maxMB);
+        failed++;
+    }
+    if (failOverTotal && overTotal) {
+        printf("FAIL %u frames over the DECON total\n", overTotal);
+        failed++;
+    }
+    if (gErrors) {
+        printf("%d errors\n", gErrors);
+        failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Table-driven host test of ExynosBandwidthModel, with limits like the
+ * 1920x1080 entry of the board table in ExynosHWCModule.h: three channels
+ * of one full landscape 32bpp frame at 60Hz each, one window per channel
+ * at a time, 16 x 16 byte bursts.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ExynosBandwidthModel.h"
+
+#define XRES        1920
+#define YRES        1080
+/* one full 32bpp frame at 60Hz, a channel's limit */
+#define FRAME       ((uint64_t)XRES * YRES * 4 * 60)
+
+struct LineCase {
+    uint32_t width;
+    uint32_t bpp;
+    uint64_t bytes;
+};
+
+static const LineCase lineCases[] = {
+    { 1920, 32, 7680 },     /* already 30 bursts */
+    { 1920, 12, 3072 },     /* 2880 bytes, 12 bursts */
+    { 720,  16, 1536 },
+    { 1,    32, 256 },
+    { 0,    32, 0 },
+};
+
+struct FitCase {
+    const char *name;
+    uint32_t refresh;
+    size_t numLayers;
+    ExynosBandwidthModel::Layer layers[4];
+    uint64_t peak;          /* expected peakRate() */
+    bool fits;
+};
+
+/* channel, srcW, srcH, dstTop, dstBottom, bpp */
+static const FitCase fitCases[] = {
+    { "nothing", 60, 0, { }, 0, true },
+    { "full screen RGB on every channel", 60, 3, {
+            { 0, XRES, YRES, 0, YRES, 32 },
+            { 1, XRES, YRES, 0, YRES, 32 },
+            { 2, XRES, YRES, 0, YRES, 32 } },
+        3 * FRAME, true },
+    { "same at 90Hz", 90, 1, {
+            { 0, XRES, YRES, 0, YRES, 32 } },
+        FRAME * 3 / 2, false },
+    { "NV12 video next to two RGB windows", 60, 3, {
+            { 0, XRES, YRES, 0, YRES, 32 },
+            { 1, XRES, YRES, 0, YRES, 32 },
+            { 2, XRES, YRES, 0, YRES, 12 } },
+        2 * FRAME + (uint64_t)3072 * YRES * 60, true },
+    { "two windows one above the other on one channel", 60, 2, {
+            { 0, XRES, YRES / 2, 0, YRES / 2, 32 },
+            { 0, XRES, YRES / 2, YRES / 2, YRES, 32 } },
+        FRAME, true },
+    { "two overlapping windows on one channel", 60, 2, {
+            { 0, XRES, 100, 0, 100, 32 },
+            { 0, XRES, 100, 50, 150, 32 } },
+        2 * FRAME, false },
+    { "vertical 2:1 downscale over a full channel", 60, 1, {
+            { 0, XRES, 2 * YRES, 0, YRES, 32 } },
+        2 * FRAME, false },
+    { "2:1 downscaled halves side by side in time", 60, 3, {
+            { 0, XRES, YRES, 0, YRES / 2, 32 },
+            { 1, XRES, YRES, YRES / 2, YRES, 32 },
+            { 2, XRES, YRES, 0, YRES, 32 } },
+        3 * FRAME, true },
+    { "2:1 downscaled halves on the same lines", 60, 3, {
+            { 0, XRES, YRES, 0, YRES / 2, 32 },
+            { 1, XRES, YRES, 0, YRES / 2, 32 },
+            { 2, XRES, YRES, 0, YRES, 32 } },
+        5 * FRAME, false },
+    { "one pixel wide still reads a burst per line", 60, 1, {
+            { 0, 1, YRES, 0, YRES, 32 } },
+        (uint64_t)256 * YRES * 60, true },
+    { "no such channel", 60, 1, {
+            { 3, 64, 64, 0, 64, 32 } },
+        (uint64_t)256 * 64 * YRES * 60 / 64, false },
+};
+
+static ExynosBandwidthModel::Limits boardLimits(void)
+{
+    ExynosBandwidthModel::Limits limits;
+
+    memset(&limits, 0, sizeof(limits));
+    limits.numChannels = 3;
+    for (size_t c = 0; c < limits.numChannels; c++) {
+        limits.channelBytesPerSec[c] = FRAME;
+        limits.channelOverlap[c] = 1;
+    }
+    limits.totalBytesPerSec = 3 * FRAME;
+    limits.burstBytes = 16 * 16;
+    return limits;
+}
+
+int main(void)
+{
+    ExynosBandwidthModel model;
+    int failed = 0, total = 0;
+
+    model.setLimits(boardLimits());
+    model.setDisplay(YRES, 60);
+
+    for (size_t i = 0; i < sizeof(lineCases) / sizeof(lineCases[0]); i++) {
+        const LineCase &t = lineCases[i];
+        uint64_t bytes = model.lineBytes(t.width, t.bpp);
+
+        total++;
+        if (bytes != t.bytes) {
+            printf("FAIL lineBytes(%u, %u) = %llu, expected %llu\n", t.width, t.bpp,
+                    (unsigned long long)bytes, (unsigned long long)t.bytes);
+            failed++;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(fitCases) / sizeof(fitCases[0]); i++) {
+        const FitCase &t = fitCases[i];
+
+        model.setDisplay(YRES, t.refresh);
+        uint64_t peak = model.peakRate(t.layers, t.numLayers);
+        bool fits = model.fits(t.layers, t.numLayers);
+
+        total++;
+        if (peak != t.peak || fits != t.fits) {
+            printf("FAIL %s: peak %llu fits %d, expected %llu fits %d\n", t.name,
+                    (unsigned long long)peak, fits, (unsigned long long)t.peak, t.fits);
+            failed++;
+        } else {
+            printf("ok   %s\n", t.name);
+        }
+    }
+
+    printf("%d/%d passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -44,3 +44,32 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_CLASS := SHARED_LIBRARIES
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+# Host stress benchmark of verify() over libMcClientMock,
+# see benchGatekeeper.cpp for options
+LOCAL_MODULE := gatekeeper_benchmark
+LOCAL_MODULE_HOST_OS := linux
+# The TLC hands 32 bit secure virtual addresses to the TA
+LOCAL_MULTILIB := 32
+
+LOCAL_SRC_FILES := exynos_gatekeeper.cpp \
+		   tlcTeeGatekeeper_if.cpp \
+		   benchGatekeeper.cpp
+
+LOCAL_C_INCLUDES := \
+	$(CURRENT_PATH)/include \
+	$(MOBICORE_PATH)/daemon/ClientLib/public \
+	$(MOBICORE_PATH)/daemon/ClientLib/Mock \
+	$(MOBICORE_PATH)/common/MobiCore/inc/
+
+LOCAL_CFLAGS := -Wall
+LOCAL_CFLAGS += -DGK_CONTEXT_DIR=\"/tmp/gk_bench/\"
+LOCAL_CFLAGS += -DGK_TA_PATH=\"/tmp/gk_bench/gatekeeper.tlbin\"
+
+LOCAL_SHARED_LIBRARIES := libMcClientMock liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2015, Samsung Electronics Co., LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed toggle an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host stress benchmark of gatekeeper verify().
+ *
+ * Runs the HAL and the TLC against libMcClientMock with a simulated TA
+ * which checks passwords after a configurable compute time and throttles a
+ * uid after a number of wrong passwords. Each scenario is run by several
+ * threads at once, first straight through TEE_Verify() as the HAL did
+ * before calls were coalesced, then through verify():
+ *
+ *   same      all threads verify the right password of one uid
+ *   distinct  every thread verifies its own uid
+ *   storm     all threads verify a wrong password of one uid
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <hardware/hardware.h>
+#include <hardware/gatekeeper.h>
+#include <hardware/hw_auth_token.h>
+
+#include "McClientMock.h"
+#include "mcLoadFormat.h"
+#include "mcVersionHelper.h"
+#include "tlTeeGatekeeper_Api.h"
+#include "tlcTeeGatekeeper_if.h"
+#include "password_handle.h"
+#include "exynos_gatekeeper.h"
+
+#define BENCH_MAX_THREADS	64
+#define BENCH_MAX_UIDS		BENCH_MAX_THREADS
+#define BENCH_UID_BASE		10
+
+/* Wrong passwords the simulated TA accepts before it throttles a uid */
+#define BENCH_FAILURE_LIMIT	5
+#define BENCH_RETRY_TIMEOUT	30000
+
+extern struct gatekeeper_module HAL_MODULE_INFO_SYM;
+
+static const mcUuid_t gk_uuid = TEE_GATEKEEPER_TL_UUID;
+
+static const uint8_t good_password[] = "1234";
+static const uint8_t bad_password[] = "4321";
+
+static uint32_t compute_us = 2000;
+static int threads = 8;
+static int iterations = 50;
+
+/* State of the simulated TA */
+static struct {
+	pthread_mutex_t lock;
+	uint32_t failures[BENCH_MAX_UIDS];
+	uint64_t throttled_until[BENCH_MAX_UIDS];
+} ta = { PTHREAD_MUTEX_INITIALIZER, {0}, {0} };
+
+/* Password handles returned by enroll(), by uid - BENCH_UID_BASE */
+static password_handle_t handles[BENCH_MAX_UIDS];
+
+static const gatekeeper_device_t *device;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void password_digest(const uint8_t *password, uint32_t length,
+		uint8_t digest[32])
+{
+	uint32_t i;
+
+	memset(digest, 0, 32);
+	for (i = 0; i < length; i++)
+		digest[i % 32] = (uint8_t)(digest[i % 32] * 31 + password[i] + 1);
+}
+
+static mcResult_t ta_enroll(uint32_t sessionId, gk_enroll_t *req,
+		tciResponseHeader_t *rsp)
+{
+	uint32_t slot = req->uid - BENCH_UID_BASE;
+	password_handle_t *handle;
+	uint8_t *desired;
+
+	desired = (uint8_t *)mcMockResolve(sessionId, req->desired_password_va,
+			req->desired_password_length);
+	handle = (password_handle_t *)mcMockResolve(sessionId,
+			req->enrolled_password_handle_va, sizeof(*handle));
+	if (slot >= BENCH_MAX_UIDS || desired == NULL || handle == NULL) {
+		rsp->returnCode = RET_ERR_INTERNAL_ERROR;
+		return MC_DRV_OK;
+	}
+
+	memset(handle, 0, sizeof(*handle));
+	handle->version = 2;
+	handle->user_id = req->uid;
+	handle->hardware_backed = true;
+	password_digest(desired, req->desired_password_length, handle->signature);
+	req->enrolled_password_handle_length = sizeof(*handle);
+
+	pthread_mutex_lock(&ta.lock);
+	ta.failures[slot] = 0;
+	ta.throttled_until[slot] = 0;
+	pthread_mutex_unlock(&ta.lock);
+
+	rsp->returnCode = RET_OK;
+	return MC_DRV_OK;
+}
+
+static mcResult_t ta_verify(uint32_t sessionId, gk_verify_t *req,
+		tciResponseHeader_t *rsp)
+{
+	uint32_t slot = req->uid - BENCH_UID_BASE;
+	const password_handle_t *handle;
+	hw_auth_token_t *token;
+	uint8_t *password;
+	uint8_t digest[32];
+	uint64_t now = now_us() / 1000;
+
+	handle = (const password_handle_t *)mcMockResolve(sessionId,
+			req->enrolled_password_handle_va, sizeof(*handle));
+	password = (uint8_t *)mcMockResolve(sessionId, req->provided_password_va,
+			req->provided_password_length);
+	token = (hw_auth_token_t *)mcMockResolve(sessionId, req->auth_token_va,
+			sizeof(*token));
+	if (slot >= BENCH_MAX_UIDS || handle == NULL || password == NULL ||
+			token == NULL) {
+		rsp->returnCode = RET_ERR_INTERNAL_ERROR;
+		return MC_DRV_OK;
+	}
+
+	pthread_mutex_lock(&ta.lock);
+	if (ta.throttled_until[slot] > now) {
+		req->retry_timeout = (int32_t)(ta.throttled_until[slot] - now);
+		pthread_mutex_unlock(&ta.lock);
+		rsp->returnCode = RET_ERR_WRONG_PASSWORD;
+		return MC_DRV_OK;
+	}
+	pthread_mutex_unlock(&ta.lock);
+
+	/* Key derivation, the bulk of the time the TA spends on a verify */
+	usleep(compute_us);
+	password_digest(password, req->provided_password_length, digest);
+
+	pthread_mutex_lock(&ta.lock);
+	if (memcmp(digest, handle->signature, sizeof(digest)) != 0) {
+		req->retry_timeout = 0;
+		if (++ta.failures[slot] >= BENCH_FAILURE_LIMIT) {
+			ta.throttled_until[slot] = now + BENCH_RETRY_TIMEOUT;
+			req->retry_timeout = BENCH_RETRY_TIMEOUT;
+		}
+		pthread_mutex_unlock(&ta.lock);
+		rsp->returnCode = RET_ERR_WRONG_PASSWORD;
+		return MC_DRV_OK;
+	}
+	ta.failures[slot] = 0;
+	pthread_mutex_unlock(&ta.lock);
+
+	memset(token, 0, sizeof(*token));
+	token->version = HW_AUTH_TOKEN_VERSION;
+	token->challenge = req->challenge;
+	token->user_id = handle->user_id;
+	token->timestamp = now;
+	req->auth_token_length = sizeof(*token);
+	req->request_reenroll = false;
+
+	rsp->returnCode = RET_OK;
+	return MC_DRV_OK;
+}
+
+static mcResult_t ta_notify(void *ctx, uint32_t sessionId, uint8_t *tci,
+		uint32_t tciLen)
+{
+	tciMessage_t *msg = (tciMessage_t *)tci;
+	uint32_t commandId = msg->command.header.commandId;
+
+	(void)ctx;
+	if (tciLen < sizeof(*msg))
+		return MC_DRV_ERR_INVALID_PARAMETER;
+
+	msg->response.header.responseId = RSP_ID(commandId);
+	switch (commandId) {
+	case CMD_ID_TEE_ENROLL:
+		return ta_enroll(sessionId, &msg->gk_enroll, &msg->response.header);
+	case CMD_ID_TEE_VERIFY:
+		return ta_verify(sessionId, &msg->gk_verify, &msg->response.header);
+	default:
+		msg->response.header.returnCode = RET_ERR_UNKNOWN_CMD;
+		return MC_DRV_OK;
+	}
+}
+
+/* The TLC loads the TA from a file, only the UUID in its header matters */
+static int install_ta(void)
+{
+	mclfHeaderV2_t header;
+	FILE *f;
+
+	mkdir(GK_CONTEXT_DIR, 0700);
+	memset(&header, 0, sizeof(header));
+	header.intro.magic = MC_SERVICE_HEADER_MAGIC_BE;
+	header.intro.version = MC_MAKE_VERSION(MCLF_VERSION_MAJOR, MCLF_VERSION_MINOR_CURRENT);
+	header.uuid = gk_uuid;
+
+	f = fopen(GK_TA_PATH, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "cannot create %s: %s\n", GK_TA_PATH, strerror(errno));
+		return -1;
+	}
+	fwrite(&header, sizeof(header), 1, f);
+	fclose(f);
+	return 0;
+}
+
+static int enroll_uid(uint32_t uid)
+{
+	uint8_t *handle = NULL;
+	uint32_t length = 0;
+	int ret;
+
+	ret = device->enroll(device, uid, NULL, 0, NULL, 0,
+			good_password, sizeof(good_password) - 1,
+			&handle, &length);
+	if (ret != 0 || length != sizeof(password_handle_t)) {
+		fprintf(stderr, "enroll of uid %u failed: %d\n", uid, ret);
+		delete (password_handle_t *)handle;
+		return -1;
+	}
+	memcpy(&handles[uid - BENCH_UID_BASE], handle, length);
+	delete (password_handle_t *)handle;
+	return 0;
+}
+
+enum scenario {
+	SCENARIO_SAME,
+	SCENARIO_DISTINCT,
+	SCENARIO_STORM,
+};
+
+static const char *scenario_names[] = { "same", "distinct", "storm" };
+
+struct worker {
+	pthread_t thread;
+	enum scenario scenario;
+	bool through_hal;
+	int index;
+	uint64_t *latencies;
+	int errors;
+};
+
+static pthread_barrier_t start_barrier;
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = (struct worker *)arg;
+	uint32_t uid = BENCH_UID_BASE;
+	const uint8_t *password = good_password;
+	uint32_t password_length = sizeof(good_password) - 1;
+	int i;
+
+	if (w->scenario == SCENARIO_DISTINCT)
+		uid += w->index;
+	if (w->scenario == SCENARIO_STORM) {
+		password = bad_password;
+		password_length = sizeof(bad_password) - 1;
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < iterations; i++) {
+		const password_handle_t *handle = &handles[uid - BENCH_UID_BASE];
+		uint8_t *token = NULL;
+		uint32_t token_length = 0;
+		bool reenroll = false;
+		uint64_t start = now_us();
+		int ret;
+
+		if (w->through_hal) {
+			ret = device->verify(device, uid, 0,
+					(const uint8_t *)handle, sizeof(*handle),
+					password, password_length,
+					&token, &token_length, &reenroll);
+			delete (hw_auth_token_t *)token;
+		} else {
+			hw_auth_token_t tee_token;
+			int32_t retry_timeout = 0;
+
+			token = (uint8_t *)&tee_token;
+			token_length = sizeof(tee_token);
+			ret = TEE_Verify(uid, 0, (const uint8_t *)handle,
+					sizeof(*handle), password, password_length,
+					&token, &token_length, &reenroll,
+					&retry_timeout, device) == TEE_ERR_NONE ?
+				0 : (retry_timeout ? retry_timeout : -1);
+		}
+		w->latencies[i] = now_us() - start;
+
+		if ((w->scenario == SCENARIO_STORM) ? ret == 0 : ret != 0)
+			w->errors++;
+	}
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int run(enum scenario scenario, bool through_hal)
+{
+	struct worker workers[BENCH_MAX_THREADS];
+	uint64_t *latencies;
+	exynos_gk_stats_t gk;
+	mcMockStats_t mc;
+	uint64_t start, elapsed;
+	int calls = threads * iterations;
+	int errors = 0;
+	int i;
+
+	/* Every run starts with unthrottled uids, on the TA and in the HAL */
+	for (i = 0; i < threads; i++) {
+		if (enroll_uid(BENCH_UID_BASE + i) != 0)
+			return -1;
+	}
+	exynos_gk_reset_stats();
+	mcMockResetStats();
+
+	latencies = new uint64_t[calls];
+	pthread_barrier_init(&start_barrier, NULL, threads + 1);
+	for (i = 0; i < threads; i++) {
+		workers[i].scenario = scenario;
+		workers[i].through_hal = through_hal;
+		workers[i].index = i;
+		workers[i].latencies = latencies + i * iterations;
+		workers[i].errors = 0;
+		pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+	}
+	pthread_barrier_wait(&start_barrier);
+	start = now_us();
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		errors += workers[i].errors;
+	}
+	elapsed = now_us() - start;
+	pthread_barrier_destroy(&start_barrier);
+
+	exynos_gk_get_stats(&gk);
+	mcMockGetStats(&mc);
+	qsort(latencies, calls, sizeof(*latencies), compare_u64);
+
+	printf("%-9s %-4s %8.0f/s  p50 %7llu us  p99 %7llu us  TA %5llu  coalesced %5llu  throttled %5llu%s\n",
+			scenario_names[scenario], through_hal ? "hal" : "tee",
+			calls * 1e6 / (elapsed ? elapsed : 1),
+			(unsigned long long)latencies[calls / 2],
+			(unsigned long long)latencies[calls * 99 / 100],
+			(unsigned long long)mc.notifications,
+			(unsigned long long)gk.coalesced,
+			(unsigned long long)gk.throttled,
+			errors ? "  UNEXPECTED RESULTS" : "");
+	delete [] latencies;
+	return errors ? -1 : 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] [-n iterations] [-c compute_us] [-d]\n"
+		"  -t  concurrent callers, at most %d (default %d)\n"
+		"  -n  verify calls per caller (default %d)\n"
+		"  -c  time the simulated TA takes for a verify (default %u)\n"
+		"  -d  dump the HAL statistics after the last run\n",
+		name, BENCH_MAX_THREADS, threads, iterations, compute_us);
+}
+
+int main(int argc, char *argv[])
+{
+	mcMockTa_t ta_ops;
+	hw_device_t *hw_device;
+	bool dump = false;
+	int ret = 0;
+	int opt;
+	int s;
+
+	while ((opt = getopt(argc, argv, "t:n:c:dh")) != -1) {
+		switch (opt) {
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'c':
+			compute_us = (uint32_t)atoi(optarg);
+			break;
+		case 'd':
+			dump = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (threads < 1 || threads > BENCH_MAX_THREADS || iterations < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	memset(&ta_ops, 0, sizeof(ta_ops));
+	ta_ops.onNotify = ta_notify;
+	if (install_ta() != 0 || mcMockRegisterTa(&gk_uuid, &ta_ops) != MC_DRV_OK)
+		return 1;
+
+	if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+				HARDWARE_GATEKEEPER, &hw_device) != 0) {
+		fprintf(stderr, "cannot open the gatekeeper HAL\n");
+		return 1;
+	}
+	device = (const gatekeeper_device_t *)hw_device;
+
+	printf("%d threads x %d verify calls, TA compute time %u us\n",
+			threads, iterations, compute_us);
+	for (s = SCENARIO_SAME; s <= SCENARIO_STORM; s++) {
+		if (run((enum scenario)s, false) != 0 ||
+				run((enum scenario)s, true) != 0)
+			ret = 1;
+	}
+
+	if (dump) {
+		fflush(stdout);
+		exynos_gk_dump_stats(STDOUT_FILENO);
+	}
+
+	hw_device->close(hw_device);
+	return ret;
+}
@@ -15,8 +15,12 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <hardware/hardware.h>
 #include <hardware/gatekeeper.h>
@@ -26,6 +30,7 @@
 
 #include "tlcTeeGatekeeper_if.h"
 #include "password_handle.h"
+#include "exynos_gatekeeper.h"
 
 #include <utils/Log.h>
 #include <cutils/log.h>
@@ -34,6 +39,9 @@ typedef UniquePtr<gatekeeper_device_t> Unique_gatekeeper_device_t;
 
 #define MAX_PASSWORD_LEN 100
 
+/* uids whose throttle timeout is remembered at the same time */
+#define MAX_THROTTLED_UIDS 16
+
 #undef GATEKEEPER_DEBUG
 
 #ifdef GATEKEEPER_DEBUG
@@ -61,6 +69,170 @@ void dump(const uint8_t *ptr, uint32_t size)
 }
 #endif
 
+/*
+ * Concurrent verify() calls for the same uid are coalesced: while one is
+ * with the TA, the others wait for it rather than queue for the session.
+ * If the TA answered with a retry timeout, the waiters, and any caller
+ * until the timeout expires, get the remaining time without a round trip
+ * to the TA, which would refuse them as well. A waiter that made the same
+ * request (challenge, password handle and password) gets a copy of the
+ * answer; any other goes to the TA once the in-flight call is done.
+ */
+struct gk_inflight {
+	uint32_t uid;
+	uint64_t challenge;
+	uint8_t handle[sizeof(struct password_handle_t)];
+	uint32_t handle_length;
+	uint8_t password[MAX_PASSWORD_LEN];
+	uint32_t password_length;
+
+	bool done;
+	int result;
+	hw_auth_token_t token;
+	uint32_t token_length;
+	bool request_reenroll;
+
+	uint32_t refs;
+	struct gk_inflight *next;
+};
+
+struct gk_throttle {
+	uint32_t uid;
+	uint64_t until_ms;	/* 0 if the slot is free */
+};
+
+static pthread_mutex_t gk_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gk_cond = PTHREAD_COND_INITIALIZER;
+static struct gk_inflight *gk_inflight_list = NULL;
+static struct gk_throttle gk_throttled[MAX_THROTTLED_UIDS];
+static exynos_gk_stats_t gk_stats;
+
+static uint64_t gk_now_us(void)
+{
+	struct timespec ts;
+
+	/* Same clock as the nw_timestamp the TA throttles against */
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Remaining throttle timeout of uid in milliseconds, 0 if there is none */
+static int gk_throttle_remaining(uint32_t uid)
+{
+	uint64_t now = gk_now_us() / 1000;
+	int i;
+
+	for (i = 0; i < MAX_THROTTLED_UIDS; i++) {
+		struct gk_throttle *t = &gk_throttled[i];
+
+		if (t->until_ms == 0 || t->uid != uid)
+			continue;
+		if (t->until_ms > now)
+			return (int)(t->until_ms - now);
+		t->until_ms = 0;
+	}
+	return 0;
+}
+
+static void gk_throttle_set(uint32_t uid, int32_t timeout_ms)
+{
+	struct gk_throttle *slot = &gk_throttled[0];
+	int i;
+
+	/* Reuse the uid's slot, else a free one, else the soonest to expire */
+	for (i = 0; i < MAX_THROTTLED_UIDS; i++) {
+		struct gk_throttle *t = &gk_throttled[i];
+
+		if (t->until_ms != 0 && t->uid == uid) {
+			slot = t;
+			break;
+		}
+		if (slot->until_ms != 0 && t->until_ms < slot->until_ms)
+			slot = t;
+	}
+	slot->uid = uid;
+	slot->until_ms = gk_now_us() / 1000 + timeout_ms;
+}
+
+static void gk_throttle_clear(uint32_t uid)
+{
+	int i;
+
+	for (i = 0; i < MAX_THROTTLED_UIDS; i++) {
+		if (gk_throttled[i].uid == uid)
+			gk_throttled[i].until_ms = 0;
+	}
+}
+
+static bool gk_same_request(const struct gk_inflight *e, uint64_t challenge,
+		const uint8_t *handle, uint32_t handle_length,
+		const uint8_t *password, uint32_t password_length)
+{
+	return e->challenge == challenge &&
+		e->handle_length == handle_length &&
+		e->password_length == password_length &&
+		memcmp(e->handle, handle, handle_length) == 0 &&
+		memcmp(e->password, password, password_length) == 0;
+}
+
+/* Drop a reference to an in-flight record, called with gk_lock held */
+static void gk_inflight_put(struct gk_inflight *e)
+{
+	if (--e->refs == 0) {
+		memset(e, 0, sizeof(*e));
+		delete e;
+	}
+}
+
+__attribute__ ((visibility ("default")))
+void exynos_gk_get_stats(exynos_gk_stats_t *stats)
+{
+	if (stats == NULL)
+		return;
+
+	pthread_mutex_lock(&gk_lock);
+	*stats = gk_stats;
+	pthread_mutex_unlock(&gk_lock);
+}
+
+__attribute__ ((visibility ("default")))
+void exynos_gk_reset_stats(void)
+{
+	pthread_mutex_lock(&gk_lock);
+	memset(&gk_stats, 0, sizeof(gk_stats));
+	pthread_mutex_unlock(&gk_lock);
+	TEE_ResetStats();
+}
+
+__attribute__ ((visibility ("default")))
+void exynos_gk_dump_stats(int fd)
+{
+	exynos_gk_stats_t gk;
+	teeStats_t tee;
+	int i;
+
+	exynos_gk_get_stats(&gk);
+	TEE_GetStats(&tee);
+
+	dprintf(fd, "verify: %llu calls, %llu to the TA, %llu coalesced, %llu throttled, %llu us waiting\n",
+			(unsigned long long)gk.verify, (unsigned long long)gk.ta_calls,
+			(unsigned long long)gk.coalesced, (unsigned long long)gk.throttled,
+			(unsigned long long)gk.wait_us);
+	dprintf(fd, "TEE: %llu enroll, %llu verify, %llu failed, %llu throttled, %llu us waiting for the session\n",
+			(unsigned long long)tee.enroll, (unsigned long long)tee.verify,
+			(unsigned long long)tee.failed, (unsigned long long)tee.throttled,
+			(unsigned long long)tee.lock_wait_us);
+	for (i = 0; i < TEE_STAGE_MAX; i++) {
+		const teeStageStats_t *s = &tee.stage[i];
+
+		dprintf(fd, "  %-8s %8llu x  avg %8llu us  max %8llu us\n",
+				TEE_StageName((teeStage_t)i),
+				(unsigned long long)s->count,
+				(unsigned long long)(s->count ? s->total_us / s->count : 0),
+				(unsigned long long)s->max_us);
+	}
+}
+
 int enroll(const struct gatekeeper_device *dev, uint32_t uid,
 		const uint8_t *current_password_handle,
 		uint32_t current_password_handle_length,
@@ -150,6 +322,11 @@ int enroll(const struct gatekeeper_device *dev, uint32_t uid,
 		return (retry_timeout ? retry_timeout : -1);
 	}
 
+	/* A new password starts over without a throttle */
+	pthread_mutex_lock(&gk_lock);
+	gk_throttle_clear(uid);
+	pthread_mutex_unlock(&gk_lock);
+
 #ifdef GATEKEEPER_DEBUG
 	ALOGE("[exy_gk] Dump new_handle");
 	dump(*enrolled_password_handle, *enrolled_password_handle_length);
@@ -159,7 +336,8 @@ int enroll(const struct gatekeeper_device *dev, uint32_t uid,
 	return 0;
 }
 
-int verify(const struct gatekeeper_device *dev, uint32_t uid,
+/* Send a verify request to the TA */
+static int verify_tee(const struct gatekeeper_device *dev, uint32_t uid,
 		uint64_t challenge, const uint8_t *enrolled_password_handle,
 		uint32_t enrolled_password_handle_length,
 		const uint8_t *provided_password,
@@ -170,6 +348,133 @@ int verify(const struct gatekeeper_device *dev, uint32_t uid,
 	int32_t retry_timeout = 0;
 	hw_auth_token_t *token;
 
+	// the handle will be removed in the return process of keymaster.
+	token = new hw_auth_token_t;
+
+	*auth_token = (uint8_t*)token;
+	*auth_token_length = sizeof(hw_auth_token_t);
+
+	teeRet = TEE_Verify(uid, challenge,
+				enrolled_password_handle,
+				enrolled_password_handle_length,
+				provided_password, provided_password_length,
+				auth_token, auth_token_length, request_reenroll,
+				&retry_timeout,	dev);
+
+	if (teeRet != TEE_ERR_NONE) {
+		return (retry_timeout ? retry_timeout : -1);
+	}
+
+	return 0;
+}
+
+static int verify_coalesced(const struct gatekeeper_device *dev, uint32_t uid,
+		uint64_t challenge, const uint8_t *enrolled_password_handle,
+		uint32_t enrolled_password_handle_length,
+		const uint8_t *provided_password,
+		uint32_t provided_password_length, uint8_t **auth_token,
+		uint32_t *auth_token_length, bool *request_reenroll)
+{
+	struct gk_inflight *e;
+	uint64_t start;
+	int ret;
+
+	pthread_mutex_lock(&gk_lock);
+	gk_stats.verify++;
+
+	for (;;) {
+		ret = gk_throttle_remaining(uid);
+		if (ret > 0) {
+			gk_stats.throttled++;
+			pthread_mutex_unlock(&gk_lock);
+			return ret;
+		}
+
+		for (e = gk_inflight_list; e != NULL && e->uid != uid; e = e->next)
+			;
+		if (e == NULL)
+			break;
+
+		e->refs++;
+		start = gk_now_us();
+		while (!e->done)
+			pthread_cond_wait(&gk_cond, &gk_lock);
+		gk_stats.wait_us += gk_now_us() - start;
+
+		if (e->result <= 0 &&
+				gk_same_request(e, challenge, enrolled_password_handle,
+					enrolled_password_handle_length,
+					provided_password, provided_password_length)) {
+			ret = e->result;
+			if (ret == 0) {
+				hw_auth_token_t *token = new hw_auth_token_t;
+
+				memcpy(token, &e->token, sizeof(*token));
+				*auth_token = (uint8_t*)token;
+				*auth_token_length = e->token_length;
+				*request_reenroll = e->request_reenroll;
+			}
+			gk_inflight_put(e);
+			gk_stats.coalesced++;
+			pthread_mutex_unlock(&gk_lock);
+			return ret;
+		}
+		gk_inflight_put(e);
+	}
+
+	/* No call for this uid in flight, this one goes to the TA */
+	e = new gk_inflight;
+	memset(e, 0, sizeof(*e));
+	e->uid = uid;
+	e->challenge = challenge;
+	memcpy(e->handle, enrolled_password_handle, enrolled_password_handle_length);
+	e->handle_length = enrolled_password_handle_length;
+	memcpy(e->password, provided_password, provided_password_length);
+	e->password_length = provided_password_length;
+	e->refs = 1;
+	e->next = gk_inflight_list;
+	gk_inflight_list = e;
+	gk_stats.ta_calls++;
+	pthread_mutex_unlock(&gk_lock);
+
+	ret = verify_tee(dev, uid, challenge, enrolled_password_handle,
+			enrolled_password_handle_length,
+			provided_password, provided_password_length,
+			auth_token, auth_token_length, request_reenroll);
+
+	pthread_mutex_lock(&gk_lock);
+	if (ret > 0)
+		gk_throttle_set(uid, ret);
+	e->result = ret;
+	if (ret == 0 && *auth_token_length <= sizeof(e->token)) {
+		memcpy(&e->token, *auth_token, *auth_token_length);
+		e->token_length = *auth_token_length;
+		e->request_reenroll = *request_reenroll;
+	} else if (ret == 0) {
+		/* Not something a waiter can be given a copy of */
+		e->result = -1;
+	}
+	e->done = true;
+
+	struct gk_inflight **pp;
+	for (pp = &gk_inflight_list; *pp != e; pp = &(*pp)->next)
+		;
+	*pp = e->next;
+
+	pthread_cond_broadcast(&gk_cond);
+	gk_inflight_put(e);
+	pthread_mutex_unlock(&gk_lock);
+
+	return ret;
+}
+
+int verify(const struct gatekeeper_device *dev, uint32_t uid,
+		uint64_t challenge, const uint8_t *enrolled_password_handle,
+		uint32_t enrolled_password_handle_length,
+		const uint8_t *provided_password,
+		uint32_t provided_password_length, uint8_t **auth_token,
+		uint32_t *auth_token_length, bool *request_reenroll)
+{
 	if (dev == NULL ||
 			enrolled_password_handle == NULL ||
 			provided_password == NULL ||
@@ -207,24 +512,10 @@ int verify(const struct gatekeeper_device *dev, uint32_t uid,
 		return -1;
 	}
 
-	// the handle will be removed in the return process of keymaster.
-	token = new hw_auth_token_t;
-
-	*auth_token = (uint8_t*)token;
-	*auth_token_length = sizeof(hw_auth_token_t);
-
-	teeRet = TEE_Verify(uid, challenge,
-				enrolled_password_handle,
+	return verify_coalesced(dev, uid, challenge, enrolled_password_handle,
 				enrolled_password_handle_length,
 				provided_password, provided_password_length,
-				auth_token, auth_token_length, request_reenroll,
-				&retry_timeout,	dev);
-
-	if (teeRet != TEE_ERR_NONE) {
-		return (retry_timeout ? retry_timeout : -1);
-	}
-
-	return 0;
+				auth_token, auth_token_length, request_reenroll);
 }
 
 /* Close an opened Exynos GK instance */
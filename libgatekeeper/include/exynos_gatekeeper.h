@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015, Samsung Electronics Co., LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed toggle an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef EXYNOS_GATEKEEPER_H_
+#define EXYNOS_GATEKEEPER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* verify() counters since the last exynos_gk_reset_stats() */
+typedef struct {
+	uint64_t verify;	/* verify() calls */
+	uint64_t ta_calls;	/* of which were sent to the TA */
+	uint64_t coalesced;	/* answered with the result of an identical in-flight call */
+	uint64_t throttled;	/* answered with the remaining throttle timeout of the uid */
+	uint64_t wait_us;	/* time spent waiting for in-flight calls of the same uid */
+} exynos_gk_stats_t;
+
+void exynos_gk_get_stats(exynos_gk_stats_t *stats);
+
+/* Resets the HAL and the TLC counters */
+void exynos_gk_reset_stats(void);
+
+/*
+ * Write the verify() counters and the per-stage TLC timings to fd.
+ * Exported for debugging tools that dlopen() the HAL.
+ */
+void exynos_gk_dump_stats(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXYNOS_GATEKEEPER_H_
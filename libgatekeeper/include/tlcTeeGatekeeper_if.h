@@ -57,6 +57,36 @@ typedef enum
     /* more can be added as required */
 } teeResult_t;
 
+/* Stages of TEE_Enroll() and TEE_Verify() timed by the TLC */
+typedef enum
+{
+    TEE_STAGE_OPEN      = 0, /* mcOpenDevice() and TCI allocation */
+    TEE_STAGE_LOAD      = 1, /* reading the TA binary and mcOpenTrustlet() */
+    TEE_STAGE_MAP       = 2, /* mcMap() and mcUnmap() of the bulk buffer */
+    TEE_STAGE_TRANSACT  = 3, /* mcNotify() until the TA has answered */
+    TEE_STAGE_PERSIST   = 4, /* reading and writing the secure object files */
+    TEE_STAGE_CLOSE     = 5, /* mcCloseSession() and mcCloseDevice() */
+    TEE_STAGE_MAX       = 6
+} teeStage_t;
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+} teeStageStats_t;
+
+/* Counters since the last TEE_ResetStats() */
+typedef struct
+{
+    teeStageStats_t stage[TEE_STAGE_MAX];
+    uint64_t enroll;        /* TEE_Enroll() calls */
+    uint64_t verify;        /* TEE_Verify() calls */
+    uint64_t failed;        /* calls that did not return TEE_ERR_NONE */
+    uint64_t throttled;     /* failed calls the TA gave a retry timeout */
+    uint64_t lock_wait_us;  /* time callers queued for the session */
+} teeStats_t;
+
 teeResult_t TEE_Enroll(uint32_t uid,
 		const uint8_t *current_password_handle,
 		uint32_t current_password_handle_length,
@@ -78,6 +108,12 @@ teeResult_t TEE_Verify(uint32_t uid,
 		bool *request_reenroll, int32_t *retry_timeout,
 		const struct gatekeeper_device * /* not used */);
 
+void TEE_GetStats(teeStats_t *stats);
+
+void TEE_ResetStats(void);
+
+const char *TEE_StageName(teeStage_t stage);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <hardware/hw_auth_token.h>
 
@@ -36,17 +37,26 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+/* Both can be overridden by the build, as the host benchmark does */
+#ifndef GK_CONTEXT_DIR
 #ifdef ACCESS_EFS_POSSIBLE
-#define FNAME	"/efs/TEE/gk_context_"
-#define FNAME_SUB	"/efs/TEE/gk_context_sub_"
+#define GK_CONTEXT_DIR	"/efs/TEE/"
 #else
-#define FNAME	"/data/app/gk_context_"
-#define FNAME_SUB	"/data/app/gk_context_sub_"
+#define GK_CONTEXT_DIR	"/data/app/"
 #endif
+#endif
+#ifndef GK_TA_PATH
+#define GK_TA_PATH	"/system/app/mcRegistry/08130000000000000000000000000000.tlbin"
+#endif
+
+#define FNAME	GK_CONTEXT_DIR "gk_context_"
+#define FNAME_SUB	GK_CONTEXT_DIR "gk_context_sub_"
 #define SECURE_OBJECT_SIZE 108
 
 #define SEC_TO_MS (1000)
 #define NS_TO_MS (1000*1000)
+#define SEC_TO_US (1000*1000)
+#define NS_TO_US (1000)
 
 /* Global definitions */
 static const uint32_t gDeviceId = MC_DEVICE_ID_DEFAULT;
@@ -54,7 +64,7 @@ tciMessage_ptr     pTci = NULL;
 mcSessionHandle_t  sessionHandle;
 
 /** File path for Trusted Application */
-char secureSecDispTrustedApp[] = "/system/app/mcRegistry/08130000000000000000000000000000.tlbin";
+char secureSecDispTrustedApp[] = GK_TA_PATH;
 
 #define TEE_SESSION_CLOSED 0
 #define TEE_SESSION_OPENED 1
@@ -72,6 +82,16 @@ char secureSecDispTrustedApp[] = "/system/app/mcRegistry/08130000000000000000000
 
 static uint32_t session_status = TEE_SESSION_CLOSED;
 
+/* Serialises the use of the session, pTci and the secure object files */
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static teeStats_t stats;
+
+static const char *stage_names[TEE_STAGE_MAX] = {
+	"open", "load", "map", "transact", "persist", "close",
+};
+
 uint64_t clock_gettime_millisec(void)
 {
 	struct timespec time;
@@ -89,6 +109,80 @@ uint64_t clock_gettime_millisec(void)
 	return (sec * SEC_TO_MS) + (ns / NS_TO_MS);
 }
 
+static uint64_t clock_gettime_microsec(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+
+	if (time.tv_sec < 0)
+		return 0;
+
+	return ((uint64_t)time.tv_sec * SEC_TO_US) + (time.tv_nsec / NS_TO_US);
+}
+
+/* Account one occurrence of a stage that took elapsed microseconds */
+static void TEE_AddStage(teeStage_t stage, uint64_t elapsed)
+{
+	teeStageStats_t *s = &stats.stage[stage];
+
+	pthread_mutex_lock(&stats_lock);
+	s->count++;
+	s->total_us += elapsed;
+	if (elapsed > s->max_us)
+		s->max_us = elapsed;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void TEE_GetStats(teeStats_t *out)
+{
+	if (out == NULL)
+		return;
+
+	pthread_mutex_lock(&stats_lock);
+	*out = stats;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void TEE_ResetStats(void)
+{
+	pthread_mutex_lock(&stats_lock);
+	memset(&stats, 0, sizeof(stats));
+	pthread_mutex_unlock(&stats_lock);
+}
+
+const char *TEE_StageName(teeStage_t stage)
+{
+	if (stage >= TEE_STAGE_MAX)
+		return "unknown";
+
+	return stage_names[stage];
+}
+
+/* Count a call and, if the TA refused it, whether it was throttled */
+static void TEE_CountCall(uint64_t *calls, teeResult_t ret, int32_t retry_timeout)
+{
+	pthread_mutex_lock(&stats_lock);
+	(*calls)++;
+	if (ret != TEE_ERR_NONE)
+		stats.failed++;
+	if (retry_timeout > 0)
+		stats.throttled++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static void TEE_Lock(void)
+{
+	uint64_t start = clock_gettime_microsec();
+
+	pthread_mutex_lock(&session_lock);
+
+	start = clock_gettime_microsec() - start;
+	pthread_mutex_lock(&stats_lock);
+	stats.lock_wait_us += start;
+	pthread_mutex_unlock(&stats_lock);
+}
+
 static size_t getFileContent(const char *pPath, uint8_t **ppContent)
 {
 	FILE	*pStream;
@@ -165,12 +259,13 @@ static tciMessage_ptr TEE_Open(mcSessionHandle_t *SessionHandle)
 	uint32_t nTrustedAppLength;
 	uint8_t* pTrustedAppData;
 	tciMessage_t *tci = NULL;
+	uint64_t start = clock_gettime_microsec();
 
 	LOG_I("Opening <t-base device");
 	mcRet = mcOpenDevice(gDeviceId);
 	if (mcRet != MC_DRV_OK) {
 		LOG_E("Error opening device: %d", mcRet);
-		return false;
+		return NULL;
 	}
 
 	LOG_I("Allocating buffer for TCI");
@@ -179,9 +274,12 @@ static tciMessage_ptr TEE_Open(mcSessionHandle_t *SessionHandle)
 	if (tci == NULL) {
 		LOG_I("Allocation of TCI failed");
 		//LOG_ERRNO("Allocation of TCI failed");
-		return false;
+		return NULL;
 	}
 	memset(tci, 0x00, sizeof(tciMessage_t));
+	TEE_AddStage(TEE_STAGE_OPEN, clock_gettime_microsec() - start);
+
+	start = clock_gettime_microsec();
 	nTrustedAppLength = getFileContent(secureSecDispTrustedApp,
 						&pTrustedAppData);
 
@@ -189,7 +287,7 @@ static tciMessage_ptr TEE_Open(mcSessionHandle_t *SessionHandle)
 		LOG_E("Trusted Application not found");
 		free(tci);
 		tci = NULL;
-		return false;
+		return NULL;
 	}
 
 	LOG_I("Opening the Trusted Application session");
@@ -206,9 +304,10 @@ static tciMessage_ptr TEE_Open(mcSessionHandle_t *SessionHandle)
 		LOG_E("Open session failed: %d", mcRet);
 		free(tci);
 		tci= NULL;
-		return false;
+		return NULL;
 	}
 
+	TEE_AddStage(TEE_STAGE_LOAD, clock_gettime_microsec() - start);
 	LOG_I("mcOpenTrustlet() succeeded");
 	return (tciMessage_ptr)tci;
 }
@@ -224,6 +323,7 @@ static tciMessage_ptr TEE_Open(mcSessionHandle_t *SessionHandle)
 static void TEE_Close(mcSessionHandle_t *pSessionHandle)
 {
 	mcResult_t    mcRet;
+	uint64_t      start = clock_gettime_microsec();
 
 	do {
 		/* Validate session handle */
@@ -244,8 +344,28 @@ static void TEE_Close(mcSessionHandle_t *pSessionHandle)
 		if (MC_DRV_OK != mcRet)
 			LOG_E("TEE_Close(): mcCloseDevice returned: %d\n", mcRet);
 
+		TEE_AddStage(TEE_STAGE_CLOSE, clock_gettime_microsec() - start);
 	} while (false);
 }
+
+/**
+ * TEE_DropSession
+ *
+ * Close the cached session after a failed notification, so that the next
+ * call opens a fresh one instead of reusing a session that may be dead.
+ * Called with session_lock held.
+ */
+static void TEE_DropSession(void)
+{
+	if (session_status == TEE_SESSION_CLOSED)
+		return;
+
+	LOG_E("Dropping the session after a notification failure");
+	TEE_Close(&sessionHandle);
+	free(pTci);
+	pTci = NULL;
+	session_status = TEE_SESSION_CLOSED;
+}
 #if 0
 teeResult_t TEE_SessionTest()
 {
@@ -270,7 +390,7 @@ teeResult_t TEE_SessionTest()
 }
 #endif
 
-teeResult_t TEE_Enroll(uint32_t uid,
+static teeResult_t TEE_EnrollLocked(uint32_t uid,
 		const uint8_t *current_password_handle,
 		uint32_t current_password_handle_length,
 		const uint8_t *current_password,
@@ -279,8 +399,7 @@ teeResult_t TEE_Enroll(uint32_t uid,
 		uint32_t desired_password_length,
 		uint8_t *enrolled_password_handle,
 		uint32_t *enrolled_password_handle_length,
-		int32_t *retry_timeout,
-		const struct gatekeeper_device * /* not used */)
+		int32_t *retry_timeout)
 {
 	teeResult_t	ret  = TEE_ERR_NONE;
 	mcResult_t	mcRet;
@@ -288,6 +407,8 @@ teeResult_t TEE_Enroll(uint32_t uid,
 	uint8_t	va_mapping[1024 * 5] = {0,};
 	int	fd = 0;
 	char	buf[100];
+	uint64_t	start;
+	uint64_t	map_us = 0;
 
 	if (enrolled_password_handle_length == NULL || *enrolled_password_handle_length == 0) {
 		LOG_E("enrolled_password_handle_length is NULL, or the size is zero.");
@@ -314,10 +435,12 @@ teeResult_t TEE_Enroll(uint32_t uid,
 		}
 
 		LOG_I("%s:%d mcMap - current_password_handle\n", __func__, __LINE__);
+		start = clock_gettime_microsec();
 		mcRet = mcMap(&sessionHandle,
 				(void*)va_mapping,
 				sizeof(va_mapping),
 				&mapinfo_va_mapping);
+		map_us = clock_gettime_microsec() - start;
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_MAP;
 			break;
@@ -340,6 +463,7 @@ teeResult_t TEE_Enroll(uint32_t uid,
 		pTci->gk_enroll.secure_object_va = (uint32_t)mapinfo_va_mapping.sVirtualAddr + vagap_secure_object;
 
 		/* Notify the trusted application */
+		start = clock_gettime_microsec();
 		mcRet = mcNotify(&sessionHandle);
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_NOTIFICATION;
@@ -354,6 +478,7 @@ teeResult_t TEE_Enroll(uint32_t uid,
 			ret = TEE_ERR_NOTIFICATION;
 			break;
 		}
+		TEE_AddStage(TEE_STAGE_TRANSACT, clock_gettime_microsec() - start);
 
 		if (RET_OK != pTci->response.header.returnCode) {
 			LOG_E("TEE_GetKeyInfo(): TEE Gatekeeper trusted application returned: 0x%08x\n",
@@ -369,6 +494,7 @@ teeResult_t TEE_Enroll(uint32_t uid,
 			*enrolled_password_handle_length =
 				pTci->gk_enroll.enrolled_password_handle_length;
 
+			start = clock_gettime_microsec();
 			snprintf(buf, sizeof(buf), FNAME"%x", uid);
 			if ((fd = open(buf, O_WRONLY | O_CREAT, 0600)) == -1) {
 				LOG_E("Error: Cannot open file : %s\n", buf);
@@ -390,6 +516,7 @@ teeResult_t TEE_Enroll(uint32_t uid,
 				fsync(fd);
 				close(fd);
 			}
+			TEE_AddStage(TEE_STAGE_PERSIST, clock_gettime_microsec() - start);
 		}
 	} while (false);
 
@@ -397,25 +524,29 @@ teeResult_t TEE_Enroll(uint32_t uid,
 	memset(va_mapping, 0x00, sizeof(va_mapping));
 
 	if (mapinfo_va_mapping.sVirtualAddr != 0) {
+		start = clock_gettime_microsec();
 		mcRet = mcUnmap(&sessionHandle,
 				(void*)va_mapping,
 				&mapinfo_va_mapping);
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_MAP;
 		}
+		TEE_AddStage(TEE_STAGE_MAP, map_us + clock_gettime_microsec() - start);
 	}
 
+	if (ret == TEE_ERR_NOTIFICATION)
+		TEE_DropSession();
+
 	return ret;
 }
 
-teeResult_t TEE_Verify(uint32_t uid,
+static teeResult_t TEE_VerifyLocked(uint32_t uid,
 		uint64_t challenge, const uint8_t *enrolled_password_handle,
 		uint32_t enrolled_password_handle_length,
 		const uint8_t *provided_password,
 		uint32_t provided_password_length,
 		uint8_t **auth_token, uint32_t *auth_token_length,
-		bool *request_reenroll, int32_t *retry_timeout,
-		const struct gatekeeper_device * /* not used */)
+		bool *request_reenroll, int32_t *retry_timeout)
 {
 	teeResult_t	ret  = TEE_ERR_NONE;
 	mcResult_t	mcRet;
@@ -424,6 +555,9 @@ teeResult_t TEE_Verify(uint32_t uid,
 	int	fd = 0;
 	char	buf[100];
 	ssize_t rd_size;
+	uint64_t	start;
+	uint64_t	map_us = 0;
+	uint64_t	persist_us;
 
 	if (auth_token_length == NULL) {
 		LOG_E("auth_token_length is NULL.");
@@ -437,6 +571,7 @@ teeResult_t TEE_Verify(uint32_t uid,
 	if((enrolled_password_handle_length > (0x400)) || (provided_password_length > (0x400)))
 		return TEE_ERR_INVALID_INPUT;
 
+	start = clock_gettime_microsec();
 	snprintf(buf, sizeof(buf), FNAME"%x", uid);
 	if ((fd = open(buf, O_RDONLY)) == -1) {
 		LOG_E("Error: Cannot open file : %s\n", buf);
@@ -460,6 +595,7 @@ teeResult_t TEE_Verify(uint32_t uid,
 		}
 		close(fd);
 	}
+	persist_us = clock_gettime_microsec() - start;
 
 	do {
 		if (session_status == TEE_SESSION_CLOSED ) {
@@ -473,10 +609,12 @@ teeResult_t TEE_Verify(uint32_t uid,
 		}
 
 		LOG_I("%s:%d mcMap - current_password_handle\n", __func__, __LINE__);
+		start = clock_gettime_microsec();
 		mcRet = mcMap(&sessionHandle,
 				(void*)va_mapping,
 				sizeof(va_mapping),
 				&mapinfo_va_mapping);
+		map_us = clock_gettime_microsec() - start;
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_MAP;
 			break;
@@ -511,6 +649,7 @@ teeResult_t TEE_Verify(uint32_t uid,
 		pTci->gk_verify.nw_timestamp = clock_gettime_millisec();
 
 		/* Notify the trusted application */
+		start = clock_gettime_microsec();
 		mcRet = mcNotify(&sessionHandle);
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_NOTIFICATION;
@@ -523,6 +662,7 @@ teeResult_t TEE_Verify(uint32_t uid,
 			ret = TEE_ERR_NOTIFICATION;
 			break;
 		}
+		TEE_AddStage(TEE_STAGE_TRANSACT, clock_gettime_microsec() - start);
 
 		if (RET_OK != pTci->response.header.returnCode) {
 			LOG_E("TEE_GetKeyInfo(): TEE Gatekeeper trusted application returned: 0x%08x\n",
@@ -543,6 +683,7 @@ teeResult_t TEE_Verify(uint32_t uid,
 		*request_reenroll = pTci->gk_verify.request_reenroll;
 	} while (false);
 
+	start = clock_gettime_microsec();
 	snprintf(buf, sizeof(buf), FNAME"%x", uid);
 	if ((fd = open(buf, O_WRONLY | O_CREAT, 0600)) == -1) {
 		LOG_E("Error: Cannot open file : %s\n", buf);
@@ -562,17 +703,73 @@ teeResult_t TEE_Verify(uint32_t uid,
 		fsync(fd);
 		close(fd);
 	}
+	TEE_AddStage(TEE_STAGE_PERSIST, persist_us + clock_gettime_microsec() - start);
 
 	/* Removing to mapped buffer */
 	memset(va_mapping, 0x00, sizeof(va_mapping));
 
 	if (mapinfo_va_mapping.sVirtualAddr != 0) {
+		start = clock_gettime_microsec();
 		mcRet = mcUnmap(&sessionHandle,
 				(void*)va_mapping,
 				&mapinfo_va_mapping);
 		if (MC_DRV_OK != mcRet) {
 			ret = TEE_ERR_MAP;
 		}
+		TEE_AddStage(TEE_STAGE_MAP, map_us + clock_gettime_microsec() - start);
 	}
+
+	if (ret == TEE_ERR_NOTIFICATION)
+		TEE_DropSession();
+	return ret;
+}
+
+teeResult_t TEE_Enroll(uint32_t uid,
+		const uint8_t *current_password_handle,
+		uint32_t current_password_handle_length,
+		const uint8_t *current_password,
+		uint32_t current_password_length,
+		const uint8_t *desired_password,
+		uint32_t desired_password_length,
+		uint8_t *enrolled_password_handle,
+		uint32_t *enrolled_password_handle_length,
+		int32_t *retry_timeout,
+		const struct gatekeeper_device * /* not used */)
+{
+	teeResult_t ret;
+
+	TEE_Lock();
+	ret = TEE_EnrollLocked(uid, current_password_handle,
+				current_password_handle_length,
+				current_password, current_password_length,
+				desired_password, desired_password_length,
+				enrolled_password_handle,
+				enrolled_password_handle_length, retry_timeout);
+	pthread_mutex_unlock(&session_lock);
+
+	TEE_CountCall(&stats.enroll, ret, retry_timeout ? *retry_timeout : 0);
+	return ret;
+}
+
+teeResult_t TEE_Verify(uint32_t uid,
+		uint64_t challenge, const uint8_t *enrolled_password_handle,
+		uint32_t enrolled_password_handle_length,
+		const uint8_t *provided_password,
+		uint32_t provided_password_length,
+		uint8_t **auth_token, uint32_t *auth_token_length,
+		bool *request_reenroll, int32_t *retry_timeout,
+		const struct gatekeeper_device * /* not used */)
+{
+	teeResult_t ret;
+
+	TEE_Lock();
+	ret = TEE_VerifyLocked(uid, challenge, enrolled_password_handle,
+				enrolled_password_handle_length,
+				provided_password, provided_password_length,
+				auth_token, auth_token_length, request_reenroll,
+				retry_timeout);
+	pthread_mutex_unlock(&session_lock);
+
+	TEE_CountCall(&stats.verify, ret, retry_timeout ? *retry_timeout : 0);
 	return ret;
 }
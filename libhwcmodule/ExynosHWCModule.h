@@ -46,29 +46,62 @@
 #ifdef FIMD_BW_OVERLAP_CHECK
 const size_t MAX_NUM_FIMD_DMA_CH = 3;
 const uint32_t FIMD_DMA_CH_IDX[] = {0, 1, 2};
-const uint32_t FIMD_DMA_CH_BW_SET1[MAX_NUM_FIMD_DMA_CH] = {1920 * 1080, 1920 * 1080, 1920 * 1080};
-const uint32_t FIMD_DMA_CH_BW_SET2[MAX_NUM_FIMD_DMA_CH] = {1920 * 1200, 1920 * 1200, 1920 * 1200};
-const uint32_t FIMD_DMA_CH_OVERLAP_CNT_SET1[MAX_NUM_FIMD_DMA_CH] = {1, 1, 1};
-const uint32_t FIMD_DMA_CH_OVERLAP_CNT_SET2[MAX_NUM_FIMD_DMA_CH] = {1, 1, 1};
 
 /*
- * TODO: All channels are enabled for WUXGA channels. Need to check
- * if this is supported. If yes disable BW CHK else fine tune.
+ * Read bandwidth limits of the DECON DMA channels, by panel size. An entry
+ * applies to panels of up to max_panel_pixels; rates are in bytes per
+ * second at the given refresh rate, line reads rounded up to whole bursts.
+ *
+ * TODO: the rates are the former flat limits (a full 32bpp frame per
+ * channel at 60Hz, 1920x1080 or 1920x1200) with lines rounded up to bursts
+ * in the wider of both orientations. Replace them with measured numbers
+ * for the board.
  */
+struct fimd_bw_limits {
+    uint32_t max_panel_pixels;
+    uint32_t refresh;
+    uint64_t ch_bytes_per_sec[MAX_NUM_FIMD_DMA_CH];
+    uint32_t ch_overlap_cnt[MAX_NUM_FIMD_DMA_CH];
+    uint64_t total_bytes_per_sec;
+};
+
+/* A full 32bpp frame with lines rounded up to bursts, in either orientation */
+#define FIMD_BW_LINE_BYTES(w)       (((uint64_t)(w) * 4 + FIMD_BURSTLEN * FIMD_WORD_SIZE_BYTES - 1) / \
+                                     (FIMD_BURSTLEN * FIMD_WORD_SIZE_BYTES) * (FIMD_BURSTLEN * FIMD_WORD_SIZE_BYTES))
+#define FIMD_BW_FRAME_RATE(w, h)    ((FIMD_BW_LINE_BYTES(w) * (h) > FIMD_BW_LINE_BYTES(h) * (w) ? \
+                                      FIMD_BW_LINE_BYTES(w) * (h) : FIMD_BW_LINE_BYTES(h) * (w)) * 60)
+
+const struct fimd_bw_limits FIMD_BW_LIMITS[] = {
+    { 1920 * 1080, 60,
+        {FIMD_BW_FRAME_RATE(1920, 1080), FIMD_BW_FRAME_RATE(1920, 1080), FIMD_BW_FRAME_RATE(1920, 1080)},
+        {1, 1, 1},
+        3 * FIMD_BW_FRAME_RATE(1920, 1080) },
+    { 0xffffffff, 60,
+        {FIMD_BW_FRAME_RATE(1920, 1200), FIMD_BW_FRAME_RATE(1920, 1200), FIMD_BW_FRAME_RATE(1920, 1200)},
+        {1, 1, 1},
+        3 * FIMD_BW_FRAME_RATE(1920, 1200) },
+};
+
+inline const struct fimd_bw_limits *fimd_bw_limits_find(int xres, int yres)
+{
+    const size_t n = sizeof(FIMD_BW_LIMITS) / sizeof(FIMD_BW_LIMITS[0]);
 
+    for (size_t i = 0; i < n - 1; i++) {
+        if ((uint32_t)(xres * yres) <= FIMD_BW_LIMITS[i].max_panel_pixels)
+            return &FIMD_BW_LIMITS[i];
+    }
+    return &FIMD_BW_LIMITS[n - 1];
+}
+
+/* Per-channel limits in 32bpp pixels per frame, for the generic window assignment */
 inline void fimd_bw_overlap_limits_init(int xres, int yres,
             uint32_t *fimd_dma_chan_max_bw, uint32_t *fimd_dma_chan_max_overlap_cnt)
 {
-    if (xres * yres > 1920 * 1080) {
-        for (size_t i = 0; i < MAX_NUM_FIMD_DMA_CH; i++) {
-            fimd_dma_chan_max_bw[i] = FIMD_DMA_CH_BW_SET2[i];
-            fimd_dma_chan_max_overlap_cnt[i] = FIMD_DMA_CH_OVERLAP_CNT_SET2[i];
-        }
-    } else {
-        for (size_t i = 0; i < MAX_NUM_FIMD_DMA_CH; i++) {
-            fimd_dma_chan_max_bw[i] = FIMD_DMA_CH_BW_SET1[i];
-            fimd_dma_chan_max_overlap_cnt[i] = FIMD_DMA_CH_OVERLAP_CNT_SET1[i];
-        }
+    const struct fimd_bw_limits *limits = fimd_bw_limits_find(xres, yres);
+
+    for (size_t i = 0; i < MAX_NUM_FIMD_DMA_CH; i++) {
+        fimd_dma_chan_max_bw[i] = limits->ch_bytes_per_sec[i] / (4 * limits->refresh);
+        fimd_dma_chan_max_overlap_cnt[i] = limits->ch_overlap_cnt[i];
     }
 }
 #endif
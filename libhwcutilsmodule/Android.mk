@@ -13,4 +13,9 @@
 # limitations under the License.
 
 LOCAL_SRC_FILES += \
-	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosMPPModule.cpp
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosMPPModule.cpp \
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosMPPDstPool.cpp \
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosHWCTrace.cpp \
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosFenceSet.cpp \
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosCompositionCache.cpp \
+	./../../$(TARGET_SOC)/libhwcutilsmodule/ExynosSecureBufferManager.cpp
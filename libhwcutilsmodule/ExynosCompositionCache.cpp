@@ -0,0 +1,114 @@
+#include <string.h>
+#include "ExynosCompositionCache.h"
+
+/* FNV-1a, over the bytes of each word */
+#define FNV_OFFSET  2166136261u
+#define FNV_PRIME   16777619u
+
+ExynosCompositionCache::Key::Key() :
+    mNumWords(0),
+    mHash(FNV_OFFSET),
+    mOverflow(false)
+{
+}
+
+void ExynosCompositionCache::Key::add(uint32_t word)
+{
+    if (mNumWords == COMPOSITION_CACHE_KEY_WORDS) {
+        mOverflow = true;
+        return;
+    }
+
+    mWords[mNumWords++] = word;
+    for (size_t i = 0; i < 4; i++) {
+        mHash ^= (word >> (i * 8)) & 0xff;
+        mHash *= FNV_PRIME;
+    }
+}
+
+void ExynosCompositionCache::Key::add(float word)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &word, sizeof(bits));
+    add(bits);
+}
+
+void ExynosCompositionCache::Key::add(int left, int top, int right, int bottom)
+{
+    add((int32_t)left);
+    add((int32_t)top);
+    add((int32_t)right);
+    add((int32_t)bottom);
+}
+
+bool ExynosCompositionCache::Key::operator==(const Key &other) const
+{
+    return mHash == other.mHash && mNumWords == other.mNumWords &&
+            !mOverflow && !other.mOverflow &&
+            memcmp(mWords, other.mWords, mNumWords * sizeof(mWords[0])) == 0;
+}
+
+ExynosCompositionCache::ExynosCompositionCache() :
+    mClock(0)
+{
+    clear();
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+void ExynosCompositionCache::clear()
+{
+    for (size_t i = 0; i < COMPOSITION_CACHE_ENTRIES; i++)
+        mEntries[i].valid = false;
+}
+
+int ExynosCompositionCache::lookup(const Key &key, int32_t *value)
+{
+    mStats.lookups++;
+    if (key.overflow())
+        return -1;
+
+    for (size_t i = 0; i < COMPOSITION_CACHE_ENTRIES; i++) {
+        Entry &entry = mEntries[i];
+
+        if (!entry.valid || !(entry.key == key))
+            continue;
+
+        entry.lastUse = ++mClock;
+        memcpy(value, entry.value, entry.numWords * sizeof(entry.value[0]));
+        mStats.hits++;
+        return entry.numWords;
+    }
+    return -1;
+}
+
+void ExynosCompositionCache::store(const Key &key, const int32_t *value, size_t numWords)
+{
+    int slot = -1;
+
+    if (key.overflow() || numWords > COMPOSITION_CACHE_VALUE_WORDS) {
+        mStats.uncacheable++;
+        return;
+    }
+
+    /* the same key again, a free entry, or the least recently used one */
+    for (size_t i = 0; i < COMPOSITION_CACHE_ENTRIES; i++) {
+        if (mEntries[i].valid && mEntries[i].key == key) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || !mEntries[i].valid ||
+                (mEntries[slot].valid && mEntries[i].lastUse < mEntries[slot].lastUse))
+            slot = i;
+    }
+
+    Entry &entry = mEntries[slot];
+    if (entry.valid && !(entry.key == key))
+        mStats.evictions++;
+
+    entry.key = key;
+    memcpy(entry.value, value, numWords * sizeof(value[0]));
+    entry.numWords = numWords;
+    entry.lastUse = ++mClock;
+    entry.valid = true;
+}
@@ -0,0 +1,89 @@
+#ifndef EXYNOS_COMPOSITION_CACHE_H
+#define EXYNOS_COMPOSITION_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Decisions a display took for the last few layer stacks it saw.
+ *
+ * A display puts everything a decision depends on into a Key, word by
+ * word, and asks lookup() for it before deciding. On a hit it applies the
+ * stored words instead of working them out again; on a miss it decides as
+ * before and store()s what it did. Keys are compared in full, the hash only
+ * picks the candidates, so a hit is always the same input and the stored
+ * decision is the one the display would take again. What goes into the key
+ * is up to the display: it has to be complete, but gralloc handles that
+ * only stand for a BufferQueue slot should stay out of it, or a scrolling
+ * list misses on every frame.
+ *
+ * Entries are replaced least recently used first, so a UI toggling between
+ * two stacks, video with and without controls say, hits on both. No libhwc
+ * dependency, see bench/testCompositionCache.cpp.
+ */
+
+#define COMPOSITION_CACHE_ENTRIES       4
+#define COMPOSITION_CACHE_KEY_WORDS     96
+#define COMPOSITION_CACHE_VALUE_WORDS   32
+
+class ExynosCompositionCache {
+    public:
+        class Key {
+            public:
+                Key();
+
+                void add(uint32_t word);
+                void add(int32_t word) { add((uint32_t)word); }
+                void add(float word);
+                void add(int left, int top, int right, int bottom);
+
+                /* More words than fit: lookup() misses, store() drops it */
+                bool overflow() const { return mOverflow; }
+                uint32_t hash() const { return mHash; }
+                size_t size() const { return mNumWords; }
+                bool operator==(const Key &other) const;
+
+            private:
+                uint32_t mWords[COMPOSITION_CACHE_KEY_WORDS];
+                size_t mNumWords;
+                uint32_t mHash;
+                bool mOverflow;
+        };
+
+        struct Stats {
+            uint32_t lookups;
+            uint32_t hits;
+            uint32_t evictions;
+            uint32_t uncacheable;   /* key or value too long */
+        };
+
+        ExynosCompositionCache();
+
+        /*
+         * Copies the words stored for key to value, which has room for
+         * COMPOSITION_CACHE_VALUE_WORDS, and returns how many there are, or
+         * -1 if key is not cached.
+         */
+        int lookup(const Key &key, int32_t *value);
+        void store(const Key &key, const int32_t *value, size_t numWords);
+
+        /* Forget everything, for example when the display is blanked */
+        void clear();
+
+        const Stats &stats() const { return mStats; }
+
+    private:
+        struct Entry {
+            Key key;
+            int32_t value[COMPOSITION_CACHE_VALUE_WORDS];
+            size_t numWords;
+            uint64_t lastUse;
+            bool valid;
+        };
+
+        Entry mEntries[COMPOSITION_CACHE_ENTRIES];
+        uint64_t mClock;
+        Stats mStats;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+#include "ExynosFenceSet.h"
+
+ExynosFenceSet::ExynosFenceSet(const ExynosFenceOps *ops) :
+    mOps(ops),
+    mNumFences(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+ExynosFenceSet::~ExynosFenceSet()
+{
+    closeAll();
+}
+
+int ExynosFenceSet::find(int fd) const
+{
+    for (size_t i = 0; i < mNumFences; i++) {
+        if (mFences[i] == fd)
+            return i;
+    }
+    return -1;
+}
+
+void ExynosFenceSet::remove(int i)
+{
+    mFences[i] = mFences[--mNumFences];
+}
+
+int ExynosFenceSet::own(int fd)
+{
+    if (fd < 0)
+        return -1;
+    if (find(fd) >= 0)
+        return fd;
+    if (mNumFences == FENCE_SET_MAX_FENCES) {
+        mStats.full++;
+        return -1;
+    }
+
+    mFences[mNumFences++] = fd;
+    return fd;
+}
+
+bool ExynosFenceSet::owns(int fd) const
+{
+    return fd >= 0 && find(fd) >= 0;
+}
+
+int ExynosFenceSet::merge(const char *name, int fd1, int fd2)
+{
+    if (fd1 < 0)
+        return fd2;
+    if (fd2 < 0)
+        return fd1;
+
+    int merged = mOps->merge(name, fd1, fd2);
+    mStats.merges++;
+
+    if (merged < 0) {
+        /* Whatever waits on fd2 must not run ahead of fd1 */
+        mOps->wait(fd1, FENCE_MERGE_WAIT_MS);
+        mStats.mergeWaits++;
+        close(fd1);
+        return fd2;
+    }
+
+    /* Frees the room the merged fence takes */
+    close(fd1);
+    close(fd2);
+    return own(merged);
+}
+
+int ExynosFenceSet::dup(int fd)
+{
+    if (fd < 0)
+        return -1;
+
+    mStats.dups++;
+    return mOps->dup(fd);
+}
+
+int ExynosFenceSet::release(int fd)
+{
+    int i = find(fd);
+
+    if (i >= 0)
+        remove(i);
+    return fd;
+}
+
+void ExynosFenceSet::close(int fd)
+{
+    int i = find(fd);
+
+    if (i < 0)
+        return;
+    mOps->close(fd);
+    mStats.closes++;
+    remove(i);
+}
+
+void ExynosFenceSet::closeAll()
+{
+    for (size_t i = 0; i < mNumFences; i++)
+        mOps->close(mFences[i]);
+    mStats.closes += mNumFences;
+    mNumFences = 0;
+}
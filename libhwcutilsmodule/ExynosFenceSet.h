@@ -0,0 +1,78 @@
+#ifndef EXYNOS_FENCE_SET_H
+#define EXYNOS_FENCE_SET_H
+
+#include <stddef.h>
+
+/*
+ * The fences one set() call is responsible for.
+ *
+ * A display owns a fence by handing it to own(); from then on the number
+ * can be passed around, to an MPP job or a layer field, but only the set
+ * closes it, once, when it goes out of scope. Fences that leave the
+ * display, the retire fence and the per layer release fences, leave it
+ * through release() and dup(). So whichever way set() returns, every
+ * fence it was given is closed or handed on exactly once.
+ *
+ * The syscalls go through ExynosFenceOps, so the host test can count them
+ * against eventfd stand-ins.
+ */
+
+#define FENCE_SET_MAX_FENCES    16
+#define FENCE_MERGE_WAIT_MS     1000
+
+struct ExynosFenceOps {
+    int (*dup)(int fd);
+    int (*close)(int fd);
+    int (*merge)(const char *name, int fd1, int fd2);
+    int (*wait)(int fd, int timeout);
+};
+
+class ExynosFenceSet {
+    public:
+        struct Stats {
+            unsigned int dups;
+            unsigned int closes;
+            unsigned int merges;
+            unsigned int mergeWaits;    /* merge failed, waited for fd1 instead */
+            unsigned int full;          /* own() refused, the set was full */
+        };
+
+        ExynosFenceSet(const ExynosFenceOps *ops);
+        ~ExynosFenceSet();
+
+        /* Takes fd over and returns it; -1 if fd is -1 or the set is full */
+        int own(int fd);
+        bool owns(int fd) const;
+
+        /* One owned fence signalling after both owned fences, which are
+         * closed. If the merge fails, waits for fd1 and returns fd2. */
+        int merge(const char *name, int fd1, int fd2);
+
+        /* A copy of an owned fence for someone else, -1 if fd is -1 */
+        int dup(int fd);
+
+        /* Hands an owned fence on to someone else and returns it */
+        int release(int fd);
+
+        /* Closes an owned fence now rather than at the end */
+        void close(int fd);
+        void closeAll();
+
+        size_t size() const { return mNumFences; }
+        const Stats &stats() const { return mStats; }
+
+    private:
+        /* Not copyable, a copy would close the same fences again */
+        ExynosFenceSet(const ExynosFenceSet &);
+        ExynosFenceSet &operator=(const ExynosFenceSet &);
+
+        const ExynosFenceOps *mOps;
+        int mFences[FENCE_SET_MAX_FENCES];
+        size_t mNumFences;
+        Stats mStats;
+
+        int find(int fd) const;
+        void remove(int i);
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include <string.h>
+#include <time.h>
+#include "ExynosHWCTrace.h"
+
+#define HWC_TRACE_MASK  (HWC_TRACE_RECORDS - 1)
+
+ExynosHWCTrace::ExynosHWCTrace() :
+    mHead(0),
+    mPending(0),
+    mFrame(0)
+{
+    memset(mRecords, 0, sizeof(mRecords));
+}
+
+ExynosHWCTrace::Record *ExynosHWCTrace::begin(uint8_t event)
+{
+    uint32_t pos = __atomic_fetch_add(&mHead, 1, __ATOMIC_RELAXED);
+    Record *record = &mRecords[pos & HWC_TRACE_MASK];
+    struct timespec ts;
+
+    /* Readers that already checked seq see it change under their copy */
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    memset((char *)record + sizeof(record->seq), 0, sizeof(*record) - sizeof(record->seq));
+    record->frame = mFrame;
+    record->timestamp = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    record->event = event;
+    record->window = 0xff;
+    record->acquireFence = -1;
+    record->releaseFence = -1;
+
+    mPending = pos;
+    return record;
+}
+
+void ExynosHWCTrace::commit(Record *record)
+{
+    if (record != &mRecords[mPending & HWC_TRACE_MASK])
+        return;
+    __atomic_store_n(&record->seq, mPending + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t ExynosHWCTrace::written() const
+{
+    return __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+}
+
+size_t ExynosHWCTrace::snapshot(Record *records, size_t max) const
+{
+    uint32_t head = written();
+    uint32_t pos = head > HWC_TRACE_RECORDS ? head - HWC_TRACE_RECORDS : 0;
+    size_t n = 0;
+
+    if (head - pos > max)
+        pos = head - max;
+
+    for (; pos != head; pos++) {
+        const Record *record = &mRecords[pos & HWC_TRACE_MASK];
+        uint32_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+
+        if (seq != pos + 1)
+            continue;
+        memcpy(&records[n], record, sizeof(*record));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&record->seq, __ATOMIC_RELAXED) != seq)
+            continue;
+        n++;
+    }
+
+    return n;
+}
+
+const char *ExynosHWCTrace::eventName(uint8_t event)
+{
+    switch (event) {
+    case HWC_TRACE_PREPARE:
+        return "PREP";
+    case HWC_TRACE_SET:
+        return "SET";
+    case HWC_TRACE_FENCES:
+        return "CLEAN";
+    case HWC_TRACE_OUTBUF:
+        return "OUTBUF";
+    case HWC_TRACE_WIN_DAMAGE:
+        return "WIN_DAMAGE";
+    case HWC_TRACE_WIN_DIRTY:
+        return "WIN_DIRTY";
+    case HWC_TRACE_WIN_INVALID:
+        return "WIN_INVALID";
+    case HWC_TRACE_WIN_REGION:
+        return "WIN_REGION";
+    default:
+        return "?";
+    }
+}
+
+int ExynosHWCTrace::format(const Record &r, char *buf, size_t len)
+{
+    unsigned long long ms = r.timestamp / 1000000ULL;
+    unsigned int us = (r.timestamp / 1000ULL) % 1000;
+
+    switch (r.event) {
+    case HWC_TRACE_PREPARE:
+    case HWC_TRACE_SET:
+    case HWC_TRACE_FENCES:
+        return snprintf(buf, len, "%llu.%03u #%u %s: layer %u type=%d, f=%x, w=%u, h=%u, s=%u, vs=%u, "
+                "{%.1f, %.1f, %.1f, %.1f}, {%d, %d, %d, %d} "
+                "fl=%08x, hdl=%#llx, trf=%02x, bl=%04x, Af=%d, Rf=%d, P=%u",
+                ms, us, r.frame, eventName(r.event), r.layer, r.type, r.format,
+                r.width, r.height, r.stride, r.vstride,
+                r.crop[0], r.crop[1], r.crop[2], r.crop[3],
+                r.rect[0], r.rect[1], r.rect[2], r.rect[3],
+                r.flags, (unsigned long long)r.handle, r.transform, r.blending,
+                r.acquireFence, r.releaseFence, r.drm);
+    case HWC_TRACE_OUTBUF:
+        return snprintf(buf, len, "%llu.%03u #%u %s: f=%x, wxh(%ux%u) stride(%u) "
+                "hdl=%#llx, Af=%d, P=%u",
+                ms, us, r.frame, eventName(r.event), r.format, r.width, r.height,
+                r.stride, (unsigned long long)r.handle, r.acquireFence, r.drm);
+    case HWC_TRACE_WIN_DAMAGE:
+        return snprintf(buf, len, "%llu.%03u #%u %s: window %u layer %u w(%4u) h(%4u), "
+                "dirty (%4d, %4d) - (%4d, %4d)",
+                ms, us, r.frame, eventName(r.event), r.window, r.layer, r.width, r.height,
+                r.rect[0], r.rect[1], r.rect[2], r.rect[3]);
+    case HWC_TRACE_WIN_DIRTY:
+    case HWC_TRACE_WIN_INVALID:
+        return snprintf(buf, len, "%llu.%03u #%u %s: window %u layer %u (%4d, %4d) - (%4d, %4d)",
+                ms, us, r.frame, eventName(r.event), r.window, r.layer,
+                r.rect[0], r.rect[1], r.rect[2], r.rect[3]);
+    case HWC_TRACE_WIN_REGION:
+        return snprintf(buf, len, "%llu.%03u #%u %s: (%4d, %4d) - (%4d, %4d) updatedWindowCnt(%d)",
+                ms, us, r.frame, eventName(r.event),
+                r.rect[0], r.rect[1], r.rect[2], r.rect[3], r.type);
+    default:
+        return snprintf(buf, len, "%llu.%03u #%u event %u", ms, us, r.frame, r.event);
+    }
+}
+
+bool ExynosHWCTrace::parse(const char *line, Record *r)
+{
+    unsigned long long ms, handle;
+    unsigned int us, frame, layer, format, width, height, stride, vstride, flags, transform, drm;
+    int blending, n = 0;
+    char name[16];
+    uint8_t event;
+
+    if (sscanf(line, " %llu.%u #%u %15[A-Z_]: %n", &ms, &us, &frame, name, &n) != 4 || n == 0)
+        return false;
+    for (event = 0; event < HWC_TRACE_NUM_EVENTS; event++) {
+        if (!strcmp(name, eventName(event)))
+            break;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->timestamp = ms * 1000000ULL + us * 1000ULL;
+    r->frame = frame;
+    r->event = event;
+    r->window = 0xff;
+    line += n;
+
+    switch (event) {
+    case HWC_TRACE_PREPARE:
+    case HWC_TRACE_SET:
+    case HWC_TRACE_FENCES:
+        if (sscanf(line, "layer %u type=%d, f=%x, w=%u, h=%u, s=%u, vs=%u, "
+                    "{%f, %f, %f, %f}, {%d, %d, %d, %d} "
+                    "fl=%x, hdl=%llx, trf=%x, bl=%x, Af=%d, Rf=%d, P=%u",
+                    &layer, &r->type, &format, &width, &height, &stride, &vstride,
+                    &r->crop[0], &r->crop[1], &r->crop[2], &r->crop[3],
+                    &r->rect[0], &r->rect[1], &r->rect[2], &r->rect[3],
+                    &flags, &handle, &transform, &blending,
+                    &r->acquireFence, &r->releaseFence, &drm) != 22)
+            return false;
+        r->layer = layer;
+        r->flags = flags;
+        r->transform = transform;
+        r->blending = blending;
+        break;
+    case HWC_TRACE_OUTBUF:
+        if (sscanf(line, "f=%x, wxh(%ux%u) stride(%u) hdl=%llx, Af=%d, P=%u",
+                    &format, &width, &height, &stride, &handle,
+                    &r->acquireFence, &drm) != 7)
+            return false;
+        vstride = 0;
+        break;
+    default:
+        return false;
+    }
+
+    r->format = format;
+    r->width = width;
+    r->height = height;
+    r->stride = stride;
+    r->vstride = vstride;
+    r->handle = handle;
+    r->drm = drm;
+    return true;
+}
@@ -0,0 +1,132 @@
+#ifndef EXYNOS_HWC_TRACE_H
+#define EXYNOS_HWC_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Composition history of one display: a ring of fixed size records, one
+ * per layer and event, written on the composition path and decoded only
+ * when someone reads it (dumpsys, or the raw ring copied off a device).
+ *
+ * Writing a record takes a slot, stores the fields and publishes it; no
+ * formatting, no lock. Readers copy the ring and drop the records that
+ * were overwritten while they copied them, so dumpsys never holds up
+ * prepare or set. There is one writer per display.
+ *
+ * Events outside HWC_TRACE_EVENTS are compiled out at the call sites,
+ * see HWC_TRACE(). No libhwc dependency, so the host benchmark drives it.
+ */
+
+#define HWC_TRACE_RECORDS   1024    /* power of two */
+
+enum {
+    HWC_TRACE_PREPARE,      /* layer as seen by prepare */
+    HWC_TRACE_SET,          /* layer as seen by set */
+    HWC_TRACE_FENCES,       /* layer fences handed back by set */
+    HWC_TRACE_OUTBUF,       /* virtual display sink buffer */
+    HWC_TRACE_WIN_DAMAGE,   /* window update: surface damage of a layer */
+    HWC_TRACE_WIN_DIRTY,    /* window update: dirty rect of a window */
+    HWC_TRACE_WIN_INVALID,  /* window update: rejected dirty rect */
+    HWC_TRACE_WIN_REGION,   /* window update: region sent to DECON */
+    HWC_TRACE_NUM_EVENTS,
+};
+
+#define HWC_TRACE_ALL   ((1 << HWC_TRACE_NUM_EVENTS) - 1)
+
+/* Boards can trim this with LOCAL_CFLAGS, 0 compiles tracing out */
+#ifndef HWC_TRACE_EVENTS
+#define HWC_TRACE_EVENTS    HWC_TRACE_ALL
+#endif
+
+#define HWC_TRACE_ENABLED(event)    (((HWC_TRACE_EVENTS) >> (event)) & 1)
+
+/* Evaluates its arguments only for compiled in events */
+#define HWC_TRACE(event, call)                  \
+    do {                                        \
+        if (HWC_TRACE_ENABLED(event)) {         \
+            call;                               \
+        }                                       \
+    } while (0)
+
+class ExynosHWCTrace {
+    public:
+        struct Record {
+            uint32_t seq;           /* position + 1 once published, 0 while written */
+            uint32_t frame;
+            uint64_t timestamp;     /* CLOCK_MONOTONIC, ns */
+            uint64_t handle;
+            uint8_t event;
+            uint8_t layer;
+            uint8_t window;
+            uint8_t drm;
+            int32_t type;           /* compositionType; WIN_REGION: updated windows */
+            int32_t format;
+            uint16_t width;
+            uint16_t height;
+            uint16_t stride;
+            uint16_t vstride;
+            float crop[4];          /* left, top, right, bottom */
+            int32_t rect[4];        /* displayFrame, or the window update rect */
+            uint32_t flags;
+            uint32_t transform;
+            int32_t blending;
+            int32_t acquireFence;
+            int32_t releaseFence;
+        };
+
+        ExynosHWCTrace();
+
+        void nextFrame() { mFrame++; }
+        uint32_t frame() const { return mFrame; }
+
+        /* Slot for the next record, filled in by the caller and published
+         * by commit(); one record at a time */
+        Record *begin(uint8_t event);
+        void commit(Record *record);
+
+        /* Published records, oldest first; returns how many were copied */
+        size_t snapshot(Record *records, size_t max) const;
+
+        /* Records ever written, so readers can tell how many were lost */
+        uint32_t written() const;
+
+        static const char *eventName(uint8_t event);
+        static int format(const Record &record, char *buf, size_t len);
+
+        /* Reads a line of format() back, for the layer and sink buffer
+         * events; false for anything else */
+        static bool parse(const char *line, Record *record);
+
+        /* Appends the decoded ring to anything with append(const char *) */
+        template <class Out>
+        void dump(Out &out) const;
+
+    private:
+        Record mRecords[HWC_TRACE_RECORDS];
+        uint32_t mHead;
+        uint32_t mPending;      /* position of the record between begin and commit */
+        uint32_t mFrame;
+};
+
+template <class Out>
+void ExynosHWCTrace::dump(Out &out) const
+{
+    Record *records = new Record[HWC_TRACE_RECORDS];
+    size_t n = snapshot(records, HWC_TRACE_RECORDS);
+    char line[256];
+
+    snprintf(line, sizeof(line), "  trace: %zu of %u records, frame %u\n",
+            n, written(), mFrame);
+    out.append(line);
+    for (size_t i = 0; i < n; i++) {
+        format(records[i], line, sizeof(line));
+        out.append("    ");
+        out.append(line);
+        out.append("\n");
+    }
+    delete[] records;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef EXYNOS_HWC_TRACE_LAYER_H
+#define EXYNOS_HWC_TRACE_LAYER_H
+
+#include "ExynosHWCUtils.h"
+#include "ExynosHWCTrace.h"
+
+/*
+ * ExynosHWCTrace records of HWC layers, for the displays to call through
+ * HWC_TRACE(). hwc_composition_replay reads them back from dumpsys.
+ */
+
+static inline void hwcTraceLayer(ExynosHWCTrace &trace, uint8_t event, size_t index, hwc_layer_1_t &layer)
+{
+    private_handle_t *h = private_handle_t::dynamicCast(layer.handle);
+    ExynosHWCTrace::Record *r = trace.begin(event);
+
+    r->layer = index;
+    r->type = layer.compositionType;
+    r->handle = (uintptr_t)layer.handle;
+    if (h) {
+        r->format = h->format;
+        r->width = h->width;
+        r->height = h->height;
+        r->stride = h->stride;
+        r->vstride = h->vstride;
+    }
+    r->crop[0] = layer.sourceCropf.left;
+    r->crop[1] = layer.sourceCropf.top;
+    r->crop[2] = layer.sourceCropf.right;
+    r->crop[3] = layer.sourceCropf.bottom;
+    r->rect[0] = layer.displayFrame.left;
+    r->rect[1] = layer.displayFrame.top;
+    r->rect[2] = layer.displayFrame.right;
+    r->rect[3] = layer.displayFrame.bottom;
+    r->flags = layer.flags;
+    r->transform = layer.transform;
+    r->blending = layer.blending;
+    r->acquireFence = layer.acquireFenceFd;
+    r->releaseFence = layer.releaseFenceFd;
+    r->drm = getDrmMode(layer.flags);
+    trace.commit(r);
+}
+
+static inline void hwcTraceOutbuf(ExynosHWCTrace &trace, hwc_display_contents_1_t *contents)
+{
+    private_handle_t *h = private_handle_t::dynamicCast(contents->outbuf);
+    ExynosHWCTrace::Record *r = trace.begin(HWC_TRACE_OUTBUF);
+
+    r->handle = (uintptr_t)contents->outbuf;
+    r->format = h->format;
+    r->width = h->width;
+    r->height = h->height;
+    r->stride = h->stride;
+    r->acquireFence = contents->outbufAcquireFenceFd;
+    r->drm = getDrmMode(h->flags);
+    trace.commit(r);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include <string.h>
+#include <unistd.h>
+#include "ExynosMPPDstPool.h"
+
+ExynosMPPDstPool::ExynosMPPDstPool(size_t capacity) :
+    mAllocator(NULL),
+    mCapacity(capacity),
+    mNumEntries(0),
+    mClock(0)
+{
+    if (mCapacity > MPP_DST_POOL_MAX_BUFFERS)
+        mCapacity = MPP_DST_POOL_MAX_BUFFERS;
+    memset(mEntries, 0, sizeof(mEntries));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+ExynosMPPDstPool::~ExynosMPPDstPool()
+{
+    clear();
+}
+
+size_t ExynosMPPDstPool::idle() const
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < mNumEntries; i++) {
+        if (mEntries[i].slot < 0)
+            n++;
+    }
+    return n;
+}
+
+void ExynosMPPDstPool::remove(size_t index, bool free)
+{
+    Entry &entry = mEntries[index];
+
+    if (entry.fence >= 0)
+        close(entry.fence);
+    if (free && mAllocator)
+        mAllocator->freeDstBuffer(entry.buf);
+
+    mEntries[index] = mEntries[--mNumEntries];
+}
+
+void ExynosMPPDstPool::clear()
+{
+    for (size_t i = mNumEntries; i-- > 0;) {
+        if (mEntries[i].slot < 0)
+            remove(i, true);
+    }
+}
+
+/* Drops the entries whose slot no longer holds their buffer */
+void ExynosMPPDstPool::reconcile(Buffer *slots, size_t numSlots)
+{
+    for (size_t i = mNumEntries; i-- > 0;) {
+        const Entry &entry = mEntries[i];
+
+        if (entry.slot < 0)
+            continue;
+        if ((size_t)entry.slot >= numSlots || slots[entry.slot] != entry.buf) {
+            remove(i, false);
+            mStats.lost++;
+        }
+    }
+}
+
+/* Frees the least recently used idle buffer if the pool is full */
+bool ExynosMPPDstPool::makeRoom()
+{
+    while (mNumEntries >= mCapacity) {
+        int lru = -1;
+
+        for (size_t i = 0; i < mNumEntries; i++) {
+            if (mEntries[i].slot < 0 && !mEntries[i].reserved &&
+                    (lru < 0 || mEntries[i].lastUse < mEntries[lru].lastUse))
+                lru = i;
+        }
+        if (lru < 0)
+            return false;
+        remove(lru, true);
+        mStats.evictions++;
+    }
+    return true;
+}
+
+void ExynosMPPDstPool::takeBack(Buffer buf, int fence, int slot)
+{
+    for (size_t i = 0; i < mNumEntries; i++) {
+        Entry &entry = mEntries[i];
+
+        if (entry.buf == buf && entry.slot == slot) {
+            if (entry.drop) {
+                entry.fence = fence;
+                remove(i, true);
+                return;
+            }
+            entry.slot = -1;
+            entry.fence = fence;
+            entry.lastUse = mClock;
+            return;
+        }
+    }
+
+    /* Put there by the MPP itself, e.g. when the pool could not allocate */
+    Key key;
+    if (!mAllocator || !mAllocator->describeDstBuffer(buf, &key) || !makeRoom()) {
+        if (fence >= 0)
+            close(fence);
+        if (mAllocator)
+            mAllocator->freeDstBuffer(buf);
+        return;
+    }
+
+    add(key, buf, -1, false);
+    mEntries[mNumEntries - 1].fence = fence;
+    mStats.adopted++;
+}
+
+void ExynosMPPDstPool::add(const Key &key, Buffer buf, int slot, bool reserved)
+{
+    Entry &entry = mEntries[mNumEntries++];
+
+    entry.key = key;
+    entry.buf = buf;
+    entry.fence = -1;
+    entry.slot = slot;
+    entry.lastUse = mClock;
+    entry.reserved = reserved;
+    entry.drop = false;
+}
+
+int ExynosMPPDstPool::fillSlot(Buffer *slots, int *fences, size_t numSlots, size_t slot,
+        const Key &key)
+{
+    if (slot >= numSlots)
+        return -1;
+
+    mClock++;
+    reconcile(slots, numSlots);
+
+    if (slots[slot] != NULL) {
+        takeBack(slots[slot], fences[slot], slot);
+        slots[slot] = NULL;
+        fences[slot] = -1;
+    } else if (fences[slot] >= 0) {
+        close(fences[slot]);
+        fences[slot] = -1;
+    }
+
+    /* The oldest idle buffer of the key is the one longest off screen */
+    int best = -1;
+    for (size_t i = 0; i < mNumEntries; i++) {
+        const Entry &entry = mEntries[i];
+
+        if (entry.slot < 0 && entry.key == key &&
+                (best < 0 || entry.lastUse < mEntries[best].lastUse))
+            best = i;
+    }
+
+    if (best >= 0) {
+        Entry &entry = mEntries[best];
+
+        slots[slot] = entry.buf;
+        fences[slot] = entry.fence;
+        entry.fence = -1;
+        entry.slot = slot;
+        entry.lastUse = mClock;
+        mStats.reuses++;
+        return 0;
+    }
+
+    Buffer buf = NULL;
+    if (!mAllocator || !makeRoom() || mAllocator->allocDstBuffer(key, &buf) < 0 || !buf)
+        return -1;
+
+    add(key, buf, slot, false);
+    mStats.allocations++;
+
+    slots[slot] = buf;
+    return 0;
+}
+
+int ExynosMPPDstPool::reserve(const Key &key, size_t count)
+{
+    size_t have = 0;
+    int allocated = 0;
+
+    mClock++;
+    for (size_t i = 0; i < mNumEntries; i++) {
+        mEntries[i].reserved = mEntries[i].key == key;
+        if (mEntries[i].reserved) {
+            mEntries[i].drop = false;
+            have++;
+        }
+    }
+
+    for (; have < count; have++) {
+        Buffer buf = NULL;
+
+        if (!mAllocator || !makeRoom() || mAllocator->allocDstBuffer(key, &buf) < 0 || !buf)
+            return -1;
+        add(key, buf, -1, true);
+        mStats.reserved++;
+        allocated++;
+    }
+    return allocated;
+}
+
+void ExynosMPPDstPool::unreserve(bool free)
+{
+    for (size_t i = mNumEntries; i-- > 0;) {
+        if (!mEntries[i].reserved)
+            continue;
+        mEntries[i].reserved = false;
+        if (!free)
+            continue;
+        if (mEntries[i].slot < 0)
+            remove(i, true);
+        else
+            mEntries[i].drop = true;
+    }
+}
+
+size_t ExynosMPPDstPool::dropping() const
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < mNumEntries; i++) {
+        if (mEntries[i].drop)
+            n++;
+    }
+    return n;
+}
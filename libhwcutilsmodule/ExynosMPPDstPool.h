@@ -0,0 +1,126 @@
+#ifndef EXYNOS_MPP_DST_POOL_H
+#define EXYNOS_MPP_DST_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cutils/native_handle.h>
+
+/*
+ * Destination buffers of one M2M MPP unit, kept by (format, size, usage).
+ *
+ * The MPP still writes into its ring of mNumAvailableDstBuffers slots, and
+ * the display still stores the DECON release fence of a slot's buffer in
+ * mDstBufFence once it is posted. What changes is where the buffer in a
+ * slot comes from: when the slot comes round again, its buffer goes back
+ * to the pool together with that fence, and the pool hands the slot the
+ * least recently used idle buffer of the wanted key, allocating only if it
+ * has none. Switching between a few geometries or DRM modes therefore
+ * stops reallocating the whole ring, and the buffer a slot gets is never
+ * the one on screen: the MSC waits on its release fence, not the CPU.
+ *
+ * Idle buffers beyond the capacity are freed least recently used first,
+ * except the ones of a key reserve()d ahead of its jobs, which stay until
+ * unreserve(). unreserve(true) frees them, the ones in slots when their
+ * slot comes round.
+ * Buffers in a slot belong to the slot; if something else frees or
+ * replaces one, the pool forgets it, and a buffer it finds in a slot but
+ * did not allocate is taken over.
+ */
+
+#define MPP_DST_POOL_MAX_BUFFERS    12
+
+class ExynosMPPDstPool {
+    public:
+        typedef const native_handle_t *Buffer;
+
+        struct Key {
+            int format;
+            uint32_t width;
+            uint32_t height;
+            int usage;
+
+            bool operator==(const Key &other) const {
+                return format == other.format && width == other.width &&
+                        height == other.height && usage == other.usage;
+            }
+        };
+
+        class Allocator {
+            public:
+                virtual ~Allocator() {}
+                virtual int allocDstBuffer(const Key &key, Buffer *buf) = 0;
+                virtual void freeDstBuffer(Buffer buf) = 0;
+                /* key of a buffer the pool did not allocate, false if unknown */
+                virtual bool describeDstBuffer(Buffer buf, Key *key) = 0;
+        };
+
+        struct Stats {
+            uint32_t allocations;
+            uint32_t reuses;
+            uint32_t evictions;
+            uint32_t adopted;       /* found in a slot, allocated by someone else */
+            uint32_t lost;          /* freed or replaced behind the pool's back */
+            uint32_t reserved;      /* allocated by reserve(), ahead of a job */
+        };
+
+        ExynosMPPDstPool(size_t capacity = 9);
+        ~ExynosMPPDstPool();
+
+        void setAllocator(Allocator *allocator) { mAllocator = allocator; }
+
+        /*
+         * Returns the buffer in slots[slot], with the fence in fences[slot],
+         * to the pool and puts a buffer of key there, with the fence to wait
+         * for before writing it (or -1). Returns 0, or -1 with slots[slot]
+         * left NULL if there is no buffer for key and none can be allocated.
+         */
+        int fillSlot(Buffer *slots, int *fences, size_t numSlots, size_t slot, const Key &key);
+
+        /*
+         * Makes sure the pool holds count buffers of key, allocating the
+         * missing ones now, and keeps them from being evicted. Only one key
+         * is reserved at a time; the previous one becomes evictable again.
+         * Returns the number allocated, or -1 if an allocation failed.
+         */
+        int reserve(const Key &key, size_t count);
+        /*
+         * Drops the reservation. If free is set, its idle buffers are freed
+         * now and the ones in slots instead of going back to the pool.
+         */
+        void unreserve(bool free);
+        /* Buffers unreserve(true) has yet to free */
+        size_t dropping() const;
+
+        /* Frees the idle buffers; the ones in slots stay */
+        void clear();
+
+        size_t size() const { return mNumEntries; }
+        size_t idle() const;
+        const Stats &stats() const { return mStats; }
+
+    private:
+        struct Entry {
+            Key key;
+            Buffer buf;
+            int fence;              /* release fence of the last reader, idle only */
+            int slot;               /* -1 when idle */
+            uint64_t lastUse;
+            bool reserved;
+            bool drop;              /* freed when its slot comes round */
+        };
+
+        Allocator *mAllocator;
+        size_t mCapacity;
+        Entry mEntries[MPP_DST_POOL_MAX_BUFFERS];
+        size_t mNumEntries;
+        uint64_t mClock;
+        Stats mStats;
+
+        void reconcile(Buffer *slots, size_t numSlots);
+        void takeBack(Buffer buf, int fence, int slot);
+        bool makeRoom();
+        void remove(size_t index, bool free);
+        void add(const Key &key, Buffer buf, int slot, bool reserved);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef EXYNOS_MPP_JOB_STATS_H
+#define EXYNOS_MPP_JOB_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Time the display spends submitting M2M jobs to an MPP unit, and how
+ * often a job had to wait for DECON to release its destination buffer.
+ * Buckets are powers of two from 250us: <250us, <500us, ... , >=16ms.
+ */
+
+#define MPP_JOB_STATS_BUCKETS   8
+
+struct ExynosMPPJobStats {
+    uint32_t jobs;
+    uint32_t failed;
+    uint32_t dstWaits;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint32_t buckets[MPP_JOB_STATS_BUCKETS];
+
+    ExynosMPPJobStats() { reset(); }
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    void add(uint64_t ns, bool ok, bool dstWait) {
+        uint64_t limit = 250000;
+        size_t b = 0;
+
+        jobs++;
+        if (!ok)
+            failed++;
+        if (dstWait)
+            dstWaits++;
+        totalNs += ns;
+        if (ns > maxNs)
+            maxNs = ns;
+        while (b < MPP_JOB_STATS_BUCKETS - 1 && ns >= limit) {
+            limit *= 2;
+            b++;
+        }
+        buckets[b]++;
+    }
+
+    uint64_t averageNs() const { return jobs ? totalNs / jobs : 0; }
+
+    /* Upper bound of the bucket holding the given percentile, in ns */
+    uint64_t percentileNs(unsigned int percent) const {
+        uint64_t want = ((uint64_t)jobs * percent + 99) / 100;
+        uint64_t seen = 0, limit = 250000;
+
+        for (size_t b = 0; b < MPP_JOB_STATS_BUCKETS - 1; b++, limit *= 2) {
+            seen += buckets[b];
+            if (seen >= want)
+                return limit;
+        }
+        return maxNs;
+    }
+};
+
+#endif
@@ -1,19 +1,35 @@
+#include <sync/sync.h>
 #include "ExynosMPPModule.h"
 #include "ExynosHWCUtils.h"
 
 ExynosMPPModule::ExynosMPPModule()
-    : ExynosMPP()
+    : ExynosMPP(),
+    mDstWait(false),
+    mDstAllocated(false)
 {
+    mDstPool.setAllocator(this);
 }
 
 ExynosMPPModule::ExynosMPPModule(ExynosDisplay *display, int gscIndex)
-    : ExynosMPP(display, gscIndex)
+    : ExynosMPP(display, gscIndex),
+    mDstWait(false),
+    mDstAllocated(false)
 {
+    mDstPool.setAllocator(this);
 }
 
 ExynosMPPModule::ExynosMPPModule(ExynosDisplay *display, unsigned int mppType, unsigned int mppIndex)
-    : ExynosMPP(display, mppType, mppIndex)
+    : ExynosMPP(display, mppType, mppIndex),
+    mDstWait(false),
+    mDstAllocated(false)
 {
+    mDstPool.setAllocator(this);
+}
+
+ExynosMPPModule::~ExynosMPPModule()
+{
+    /* the buffers still in mDstBuffers are freed with the ring */
+    mDstPool.clear();
 }
 
 int ExynosMPPModule::getBufferUsage(private_handle_t *srcHandle)
@@ -55,3 +71,105 @@ bool ExynosMPPModule::isFormatSupportedByMPP(int format)
     }
     return ExynosMPP::isFormatSupportedByMPP(format);
 }
+
+int ExynosMPPModule::allocDstBuffer(const ExynosMPPDstPool::Key &key, ExynosMPPDstPool::Buffer *buf)
+{
+    buffer_handle_t handle = NULL;
+    int stride;
+
+    if (mAllocDevice == NULL)
+        return -1;
+
+    int ret = mAllocDevice->alloc(mAllocDevice, key.width, key.height, key.format,
+            key.usage, &handle, &stride);
+    if (ret < 0) {
+        ALOGE("MPP(%u, %u): failed to allocate %ux%u dst buffer, format %d: %d",
+                mType, mIndex, key.width, key.height, key.format, ret);
+        return ret;
+    }
+
+    *buf = handle;
+    return 0;
+}
+
+void ExynosMPPModule::freeDstBuffer(ExynosMPPDstPool::Buffer buf)
+{
+    if (mAllocDevice != NULL)
+        mAllocDevice->free(mAllocDevice, buf);
+}
+
+bool ExynosMPPModule::describeDstBuffer(ExynosMPPDstPool::Buffer buf, ExynosMPPDstPool::Key *key)
+{
+    private_handle_t *handle = private_handle_t::dynamicCast(buf);
+
+    if (handle == NULL)
+        return false;
+
+    /* gralloc keeps the allocation usage in flags */
+    key->format = handle->format;
+    key->width = handle->width;
+    key->height = handle->height;
+    key->usage = handle->flags;
+    return true;
+}
+
+int ExynosMPPModule::prepareDstBuffer(int format, uint32_t width, uint32_t height,
+        private_handle_t *srcHandle)
+{
+    ExynosMPPDstPool::Key key = { format, width, height, getBufferUsage(srcHandle) };
+    uint32_t allocations = mDstPool.stats().allocations;
+
+    mDstWait = false;
+    mDstAllocated = true;
+    if (mDstPool.fillSlot(mDstBuffers, mDstBufFence, mNumAvailableDstBuffers,
+                mCurrentBuf, key) < 0)
+        return -1;
+    mDstAllocated = mDstPool.stats().allocations != allocations;
+
+    /* The MSC will wait for DECON to let go of this buffer first */
+    int fence = mDstBufFence[mCurrentBuf];
+    mDstWait = fence >= 0 && sync_wait(fence, 0) < 0;
+    return 0;
+}
+
+int ExynosMPPModule::reserveDstBuffers(int format, uint32_t width, uint32_t height,
+        private_handle_t *srcHandle)
+{
+    ExynosMPPDstPool::Key key = { format, width, height, getBufferUsage(srcHandle) };
+    int ret = mDstPool.reserve(key, mNumAvailableDstBuffers);
+
+    if (ret < 0)
+        ALOGE("MPP(%u, %u): failed to reserve %ux%u dst buffers, format %d",
+                mType, mIndex, width, height, format);
+    else if (ret > 0)
+        ALOGI("MPP(%u, %u): reserved %d %ux%u dst buffers, format %d",
+                mType, mIndex, ret, width, height, format);
+    return ret;
+}
+
+void ExynosMPPModule::releaseDstBuffers()
+{
+    mDstPool.unreserve(true);
+}
+
+void ExynosMPPModule::recordJob(nsecs_t submitTime, bool ok)
+{
+    mJobStats.add(submitTime, ok, mDstWait);
+    ALOGV("MPP(%u, %u): job %u took %lld us%s", mType, mIndex, mJobStats.jobs,
+            (long long)(submitTime / 1000), mDstWait ? ", dst buffer still on screen" : "");
+    mDstWait = false;
+}
+
+void ExynosMPPModule::dumpJobStats(android::String8 &result)
+{
+    const ExynosMPPDstPool::Stats &pool = mDstPool.stats();
+
+    result.appendFormat("MPP(%u, %u): %u jobs, %u failed, avg %llu us, p99 < %llu us, max %llu us, "
+            "%u waited for DECON\n", mType, mIndex, mJobStats.jobs, mJobStats.failed,
+            (unsigned long long)(mJobStats.averageNs() / 1000),
+            (unsigned long long)(mJobStats.percentileNs(99) / 1000),
+            (unsigned long long)(mJobStats.maxNs / 1000), mJobStats.dstWaits);
+    result.appendFormat("  dst pool: %zu buffers (%zu idle), %u allocated, %u reserved, %u reused, "
+            "%u evicted, %u adopted, %u lost\n", mDstPool.size(), mDstPool.idle(),
+            pool.allocations, pool.reserved, pool.reuses, pool.evictions, pool.adopted, pool.lost);
+}
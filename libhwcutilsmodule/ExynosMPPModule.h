@@ -2,17 +2,57 @@
 #define EXYNOS_GSC_MODULE_H
 
 #include "ExynosMPPv2.h"
+#include "ExynosMPPDstPool.h"
+#include "ExynosMPPJobStats.h"
 
 class ExynosDisplay;
 
-class ExynosMPPModule : public ExynosMPP {
+class ExynosMPPModule : public ExynosMPP, public ExynosMPPDstPool::Allocator {
     public:
         ExynosMPPModule();
         ExynosMPPModule(ExynosDisplay *display, int gscIndex);
         ExynosMPPModule(ExynosDisplay *display, unsigned int mppType, unsigned int mppIndex);
+        virtual ~ExynosMPPModule();
         virtual bool isFormatSupportedByMPP(int format);
+
+        /*
+         * Puts a pooled buffer for the next job in mDstBuffers[mCurrentBuf].
+         * Returns 0 if processM2M() can then be told not to allocate, or -1
+         * to let it allocate as before.
+         */
+        int prepareDstBuffer(int format, uint32_t width, uint32_t height,
+                private_handle_t *srcHandle);
+        /*
+         * Keeps mNumAvailableDstBuffers pool buffers of what
+         * prepareDstBuffer() would ask for, allocating them now rather than
+         * in the jobs; see ExynosSecureBufferManager.h. Returns the number
+         * allocated, or -1.
+         */
+        int reserveDstBuffers(int format, uint32_t width, uint32_t height,
+                private_handle_t *srcHandle);
+        /* Frees the reserved buffers, the ones in the ring as it comes round */
+        void releaseDstBuffers();
+        bool dstBuffersReleased() const { return mDstPool.dropping() == 0; }
+        /* prepareDstBuffer() had to allocate for the job prepared last */
+        bool dstAllocated() const { return mDstAllocated; }
+        /* Time spent in processM2M() for the job prepared last */
+        void recordJob(nsecs_t submitTime, bool ok);
+        const ExynosMPPJobStats &getJobStats() const { return mJobStats; }
+        void dumpJobStats(android::String8 &result);
+
     protected:
         virtual int getBufferUsage(private_handle_t *srcHandle);
+
+        virtual int allocDstBuffer(const ExynosMPPDstPool::Key &key, ExynosMPPDstPool::Buffer *buf);
+        virtual void freeDstBuffer(ExynosMPPDstPool::Buffer buf);
+        virtual bool describeDstBuffer(ExynosMPPDstPool::Buffer buf, ExynosMPPDstPool::Key *key);
+
+    private:
+        ExynosMPPDstPool mDstPool;
+        ExynosMPPJobStats mJobStats;
+        /* DECON had not released the buffer of the job prepared last */
+        bool mDstWait;
+        bool mDstAllocated;
 };
 
 #endif
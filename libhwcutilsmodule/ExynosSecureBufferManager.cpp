@@ -0,0 +1,90 @@
+#include <string.h>
+#include "ExynosSecureBufferManager.h"
+
+ExynosSecureBufferManager::ExynosSecureBufferManager(const ExynosSecmemOps *ops) :
+    mOps(ops),
+    mActive(false),
+    mReserved(false),
+    mProtected(false),
+    mIdleFrames(0),
+    mStarting(false),
+    mStartTime(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+ExynosSecureBufferManager::~ExynosSecureBufferManager()
+{
+    unprotect();
+}
+
+void ExynosSecureBufferManager::protect()
+{
+    if (mProtected || mOps->isolated() == 1)
+        return;
+
+    if (mOps->setVideoExt(1) < 0) {
+        /* the allocations may still succeed, or fail as they did before */
+        mStats.protectFailures++;
+        return;
+    }
+    mProtected = true;
+}
+
+void ExynosSecureBufferManager::unprotect()
+{
+    if (!mProtected)
+        return;
+
+    mOps->setVideoExt(0);
+    mProtected = false;
+}
+
+int ExynosSecureBufferManager::frame(bool secure, uint64_t now)
+{
+    if (secure) {
+        if (!mActive) {
+            if (mReserved) {
+                mStats.resumed++;
+            } else {
+                mStats.sessions++;
+                protect();
+            }
+            mStarting = true;
+            mStartTime = now;
+            mActive = true;
+        }
+        mIdleFrames = 0;
+        mReserved = true;
+        return ACTION_RESERVE;
+    }
+
+    mActive = false;
+    if (!mReserved || ++mIdleFrames < SECURE_LINGER_FRAMES)
+        return ACTION_NONE;
+
+    mReserved = false;
+    mStarting = false;
+    return ACTION_RELEASE;
+}
+
+void ExynosSecureBufferManager::released()
+{
+    /* a session may have started again while the buffers went */
+    if (!mReserved)
+        unprotect();
+}
+
+void ExynosSecureBufferManager::jobDone(bool allocated, uint64_t now)
+{
+    if (allocated)
+        mStats.lateAllocations++;
+
+    if (!mStarting)
+        return;
+
+    mStats.lastStartupNs = now - mStartTime;
+    if (mStats.lastStartupNs > mStats.maxStartupNs)
+        mStats.maxStartupNs = mStats.lastStartupNs;
+    mStarting = false;
+}
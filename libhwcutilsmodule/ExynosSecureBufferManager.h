@@ -0,0 +1,82 @@
+#ifndef EXYNOS_SECURE_BUFFER_MANAGER_H
+#define EXYNOS_SECURE_BUFFER_MANAGER_H
+
+#include <stdint.h>
+
+/*
+ * Protected playback sessions of a display, for the MSC destination
+ * buffers of its SECURE_DRM layer.
+ *
+ * Left to postMPPM2M(), those buffers come out of the secure carve-out one
+ * per frame until the MPP ring is full, each on the set() path, and the
+ * first one also waits for the carve-out to be set up. Instead the display
+ * calls frame() from prepare with whether the frame has a protected layer.
+ * When a session starts, the manager sets up the video_ext carve-out
+ * unless it already is (SECMEM_IOC_SET_VIDEO_EXT_PROC). While the session
+ * lasts, frame() asks the display to reserve the whole ring with
+ * ExynosMPPModule::reserveDstBuffers(), which is a no-op once the buffers
+ * are there. After SECURE_LINGER_FRAMES frames without a protected layer
+ * it asks for them back, and turns the protection off once released()
+ * says they are all freed, the ones in the MPP ring included; only
+ * protection it turned on itself. A seek or a pause that drops the layer
+ * for a moment finds the buffers still there.
+ *
+ * The secmem calls go through ExynosSecmemOps and times are passed in, so
+ * bench/testSecureBuffers.cpp runs it against a mock device and clock.
+ */
+
+#define SECURE_LINGER_FRAMES    120
+
+struct ExynosSecmemOps {
+    /* 1 if the video_ext carve-out is set up already, 0 if not, -1 on error */
+    int (*isolated)(void);
+    /* SECMEM_IOC_SET_VIDEO_EXT_PROC */
+    int (*setVideoExt)(int enable);
+};
+
+class ExynosSecureBufferManager {
+    public:
+        enum {
+            ACTION_NONE,
+            ACTION_RESERVE,         /* reserve the MPP ring of the protected layer */
+            ACTION_RELEASE,         /* give the reserved buffers back */
+        };
+
+        struct Stats {
+            uint32_t sessions;
+            uint32_t resumed;           /* started again before the buffers went back */
+            uint32_t protectFailures;
+            uint32_t lateAllocations;   /* protected buffers a job had to allocate */
+            uint64_t lastStartupNs;     /* first protected frame to its first MSC job */
+            uint64_t maxStartupNs;
+        };
+
+        ExynosSecureBufferManager(const ExynosSecmemOps *ops);
+        ~ExynosSecureBufferManager();
+
+        /* Once per prepare; returns what to do with the buffers */
+        int frame(bool secure, uint64_t now);
+        /* The buffers of ACTION_RELEASE are all freed, the carve-out can go */
+        void released();
+
+        /* The protected MSC job was prepared, allocated if it had to allocate */
+        void jobDone(bool allocated, uint64_t now);
+
+        bool reserved() const { return mReserved; }
+        const Stats &stats() const { return mStats; }
+
+    private:
+        const ExynosSecmemOps *mOps;
+        bool mActive;               /* the last frame had a protected layer */
+        bool mReserved;             /* the display holds reserved buffers */
+        bool mProtected;            /* protection turned on here */
+        uint32_t mIdleFrames;
+        bool mStarting;             /* no MSC job since the session started */
+        uint64_t mStartTime;
+        Stats mStats;
+
+        void protect();
+        void unprotect();
+};
+
+#endif
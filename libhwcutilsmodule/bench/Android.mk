@@ -0,0 +1,100 @@
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Host benchmarks and checks of the MPP, trace and fence code that does not
+# depend on the rest of libhwc, see libdisplaymodule/bench/Android.mk.
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+# see benchMPPDstPool.cpp for options
+LOCAL_MODULE := hwc_mpp_dst_pool_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	benchMPPDstPool.cpp \
+	../ExynosMPPDstPool.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# see benchHWCTrace.cpp for options
+LOCAL_MODULE := hwc_trace_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	benchHWCTrace.cpp \
+	../ExynosHWCTrace.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := hwc_fence_set_test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	testFenceSet.cpp \
+	../ExynosFenceSet.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# table-driven, exits non-zero on a failed case
+LOCAL_MODULE := hwc_composition_cache_test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	testCompositionCache.cpp \
+	../ExynosCompositionCache.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# table-driven, exits non-zero on a failed case
+LOCAL_MODULE := hwc_secure_buffers_test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	testSecureBuffers.cpp \
+	../ExynosSecureBufferManager.cpp \
+	../ExynosMPPDstPool.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark of the per layer composition trace.
+ *
+ * A mock virtual display runs prepare and set over the same layers, doing
+ * roughly the per layer checks determineSupportedOverlays() does, and
+ * records each layer at the three places the display module does: prepare,
+ * set and the fence hand back. Each mode runs the same frames:
+ *   off     HWC_TRACE_EVENTS 0, the calls compiled out
+ *   trace   ExynosHWCTrace records
+ *   format  the old DISPLAY_LOGD lines formatted into a buffer, what
+ *           EVD_DBUG costs before the log write
+ *   log     the same lines written to /dev/null, a lower bound for logd
+ * and reports the time per frame. With -d a reader thread dumps the ring
+ * every few ms, as dumpsys would, and checks every record it gets back
+ * against the frame and layer it claims to be.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ExynosHWCTrace.h"
+
+#define MAX_LAYERS      16
+
+enum {
+    MODE_OFF,
+    MODE_TRACE,
+    MODE_FORMAT,
+    MODE_LOG,
+    NUM_MODES,
+};
+
+static const char *modeNames[NUM_MODES] = { "off", "trace", "format", "log" };
+
+/* The fields of hwc_layer_1_t and private_handle_t the display logs */
+struct MockLayer {
+    int compositionType;
+    int format;
+    int width;
+    int height;
+    int stride;
+    int vstride;
+    float crop[4];
+    int frame[4];
+    uint32_t flags;
+    uintptr_t handle;
+    uint32_t transform;
+    int32_t blending;
+    int acquireFenceFd;
+    int releaseFenceFd;
+};
+
+static int gFrames = 20000;
+static int gLayers = 6;
+static int gDumpMs;
+static int gErrors;
+
+static ExynosHWCTrace gTrace;
+static volatile bool gStop;
+static int gNullFd = -1;
+static char gLine[512];
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* What the reader checks records against */
+static uint32_t layerTag(uint32_t frame, uint32_t layer)
+{
+    return frame * 2654435761U + layer;
+}
+
+static void setupLayers(MockLayer *layers, uint32_t frame)
+{
+    for (int i = 0; i < gLayers; i++) {
+        MockLayer &l = layers[i];
+        int w = 1920 >> (i & 1);
+        int h = 1080 >> (i & 1);
+
+        l.compositionType = i == gLayers - 1 ? 3 : (i == 0 ? 1 : 0);
+        l.format = i == 0 ? 0x105 : 1;
+        l.width = w;
+        l.height = h;
+        l.stride = w;
+        l.vstride = h;
+        l.crop[0] = 0;
+        l.crop[1] = (float)(frame & 7);
+        l.crop[2] = (float)w;
+        l.crop[3] = (float)h;
+        l.frame[0] = i * 8;
+        l.frame[1] = i * 8 + (frame & 7);
+        l.frame[2] = 1920 - i * 8;
+        l.frame[3] = 1080 - i * 8;
+        l.flags = layerTag(frame, i);
+        l.handle = 0xb4000000 + i * 0x1000;
+        l.transform = (i == 0) ? 4 : 0;
+        l.blending = (i == 0) ? 0x100 : 0x105;
+        l.acquireFenceFd = 40 + i;
+        l.releaseFenceFd = -1;
+    }
+}
+
+static void traceLayer(uint8_t event, size_t index, const MockLayer &l)
+{
+    ExynosHWCTrace::Record *r = gTrace.begin(event);
+
+    r->layer = index;
+    r->type = l.compositionType;
+    r->handle = l.handle;
+    r->format = l.format;
+    r->width = l.width;
+    r->height = l.height;
+    r->stride = l.stride;
+    r->vstride = l.vstride;
+    memcpy(r->crop, l.crop, sizeof(r->crop));
+    memcpy(r->rect, l.frame, sizeof(r->rect));
+    r->flags = l.flags;
+    r->transform = l.transform;
+    r->blending = l.blending;
+    r->acquireFence = l.acquireFenceFd;
+    r->releaseFence = l.releaseFenceFd;
+    gTrace.commit(r);
+}
+
+static void logLayer(int mode, const char *tag, size_t index, const MockLayer &l)
+{
+    int len = snprintf(gLine, sizeof(gLine), "[%s] %s: layer %zu type=%d, f=%x, w=%d, h=%d, s=%d, vs=%d, "
+            "{%.1f, %.1f, %.1f, %.1f}, {%d, %d, %d, %d}"
+            "fl=%08x, hdl=%p, trf=%02x, bl=%04x, Af=%d, Rf=%d, P=%d",
+            "Virtual", tag, index, l.compositionType, l.format, l.width, l.height, l.stride,
+            l.vstride, l.crop[0], l.crop[1], l.crop[2], l.crop[3],
+            l.frame[0], l.frame[1], l.frame[2], l.frame[3],
+            l.flags, (void *)l.handle, l.transform, l.blending,
+            l.acquireFenceFd, l.releaseFenceFd, 0);
+
+    if (mode == MODE_LOG && write(gNullFd, gLine, len) != len)
+        gErrors++;
+}
+
+/* HWC_TRACE() with the event mask of the mode instead of HWC_TRACE_EVENTS */
+template <int Mode>
+static void record(uint8_t event, const char *tag, size_t index, const MockLayer &l)
+{
+    if (Mode == MODE_TRACE)
+        traceLayer(event, index, l);
+    else if (Mode == MODE_FORMAT || Mode == MODE_LOG)
+        logLayer(Mode, tag, index, l);
+}
+
+/* Roughly the checks of determineSupportedOverlays() and set() */
+template <int Mode>
+static int prepareAndSet(MockLayer *layers, uint32_t frame)
+{
+    int overlays = 0;
+
+    gTrace.nextFrame();
+    setupLayers(layers, frame);
+
+    for (int i = 0; i < gLayers; i++) {
+        MockLayer &l = layers[i];
+        float srcW = l.crop[2] - l.crop[0];
+        float srcH = l.crop[3] - l.crop[1];
+        int dstW = l.frame[2] - l.frame[0];
+        int dstH = l.frame[3] - l.frame[1];
+
+        record<Mode>(HWC_TRACE_PREPARE, "DSO", i, l);
+        if (l.compositionType == 3)
+            continue;
+        if (srcW <= dstW * 4 && srcH <= dstH * 4 && dstW <= srcW * 16 &&
+                (l.format == 0x105 || !(l.transform & 4))) {
+            l.compositionType = 1;
+            overlays++;
+        } else {
+            l.compositionType = 0;
+        }
+    }
+
+    for (int i = 0; i < gLayers; i++)
+        record<Mode>(HWC_TRACE_SET, "SET", i, layers[i]);
+
+    for (int i = 0; i < gLayers; i++) {
+        MockLayer &l = layers[i];
+
+        l.acquireFenceFd = -1;
+        if (l.compositionType == 1 || l.compositionType == 3)
+            l.releaseFenceFd = 60 + i;
+        record<Mode>(HWC_TRACE_FENCES, "CLEAN", i, l);
+    }
+
+    return overlays;
+}
+
+struct Dumper {
+    std::string out;
+
+    void append(const char *s) { out += s; }
+};
+
+static void *dumpThread(void *)
+{
+    ExynosHWCTrace::Record *records = new ExynosHWCTrace::Record[HWC_TRACE_RECORDS];
+    unsigned long dumps = 0, checked = 0;
+
+    while (!gStop) {
+        size_t n = gTrace.snapshot(records, HWC_TRACE_RECORDS);
+        Dumper dumper;
+
+        for (size_t i = 0; i < n; i++) {
+            const ExynosHWCTrace::Record &r = records[i];
+            uint32_t frame = r.flags / 2654435761U;
+
+            /* the tag is set up by frame - 1 of the trace, see run() */
+            if (r.flags != layerTag(r.frame - 1, r.layer) ||
+                    r.rect[1] != (int)(r.layer * 8 + ((r.frame - 1) & 7)) ||
+                    r.crop[1] != (float)((r.frame - 1) & 7)) {
+                fprintf(stderr, "torn record: frame %u layer %u tag frame %u\n",
+                        r.frame, r.layer, frame);
+                gErrors++;
+            }
+            if (i > 0 && records[i].timestamp < records[i - 1].timestamp) {
+                fprintf(stderr, "records out of order at %zu\n", i);
+                gErrors++;
+            }
+            checked++;
+        }
+        gTrace.dump(dumper);
+        dumps++;
+        usleep(gDumpMs * 1000);
+    }
+
+    printf("dumper: %lu dumps, %lu records checked\n", dumps, checked);
+    delete[] records;
+    return NULL;
+}
+
+template <int Mode>
+static void run(std::vector<uint64_t> &times)
+{
+    MockLayer layers[MAX_LAYERS];
+    int overlays = 0;
+
+    for (int f = 0; f < gFrames; f++) {
+        /* gTrace.frame() is f + 1 once prepareAndSet() advanced it */
+        uint32_t frame = gTrace.frame();
+        uint64_t start = nowNs();
+
+        overlays += prepareAndSet<Mode>(layers, frame);
+        times.push_back(nowNs() - start);
+    }
+    if (overlays == 0)
+        gErrors++;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-l layers] [-d ms]\n"
+            "  -n  frames per mode (%d)\n"
+            "  -l  layers per frame, at most %d (%d)\n"
+            "  -d  dump the ring every ms milliseconds while running\n",
+            name, gFrames, MAX_LAYERS, gLayers);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t dumper;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:l:d:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            gFrames = atoi(optarg);
+            break;
+        case 'l':
+            gLayers = atoi(optarg);
+            break;
+        case 'd':
+            gDumpMs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (gFrames <= 0 || gLayers <= 1 || gLayers > MAX_LAYERS || gDumpMs < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    gNullFd = open("/dev/null", O_WRONLY);
+    if (gNullFd < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+    if (gDumpMs && pthread_create(&dumper, NULL, dumpThread, NULL)) {
+        perror("pthread_create");
+        return 1;
+    }
+
+    printf("%d frames of %d layers, %d records per frame\n\n",
+            gFrames, gLayers, gLayers * 3);
+    printf("%-8s %10s %10s %10s %10s\n", "mode", "avg ns", "p50 ns", "p99 ns", "ns/layer");
+
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+        std::vector<uint64_t> times;
+        uint64_t total = 0;
+
+        times.reserve(gFrames);
+        switch (mode) {
+        case MODE_OFF:
+            run<MODE_OFF>(times);
+            break;
+        case MODE_TRACE:
+            run<MODE_TRACE>(times);
+            break;
+        case MODE_FORMAT:
+            run<MODE_FORMAT>(times);
+            break;
+        case MODE_LOG:
+            run<MODE_LOG>(times);
+            break;
+        }
+        for (size_t i = 0; i < times.size(); i++)
+            total += times[i];
+        std::sort(times.begin(), times.end());
+        printf("%-8s %10llu %10llu %10llu %10llu\n", modeNames[mode],
+                (unsigned long long)(total / times.size()),
+                (unsigned long long)times[times.size() / 2],
+                (unsigned long long)times[times.size() * 99 / 100],
+                (unsigned long long)(total / times.size() / gLayers));
+    }
+
+    if (gDumpMs) {
+        gStop = true;
+        pthread_join(dumper, NULL);
+    }
+    close(gNullFd);
+
+    Dumper last;
+    gTrace.dump(last);
+    printf("\nlast records:\n%s", last.out.substr(last.out.size() > 600 ?
+            last.out.rfind('\n', last.out.size() - 600) + 1 : 0).c_str());
+
+    if (gErrors) {
+        printf("%d errors\n", gErrors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark of the MPP destination buffers against a mock M2M device.
+ *
+ * Two mock MSC units, like AVAILABLE_EXTERNAL_MPP_UNITS, each run their
+ * jobs on a thread: a job waits for the fence of its destination buffer,
+ * takes time in proportion to the pixels and then signals its own fence.
+ * Submitting returns at once, as the driver does. The mock display latches
+ * a frame on every vsync and releases the buffers of the frame it replaces,
+ * so frame N+1 is scaled while frame N is scanned out.
+ *
+ * Unit 0 scales a video that switches between 720p and 1080p, unit 1 one
+ * that switches in and out of DRM. Each mode runs the same frames:
+ *   ring  what ExynosMPP does by itself: a new dst format, size or usage
+ *         frees and reallocates every buffer of the ring, in processM2M()
+ *   pool  ExynosMPPDstPool filling the ring slots
+ * and reports the submit time of every job (the allocations happen there),
+ * how many allocations it took, how often the MSC had to wait for DECON and
+ * how many frames were not scaled by their vsync.
+ *
+ * The pool mode also checks every slot it fills, and twice frees a ring
+ * behind the pool's back and puts a buffer of its own in a slot, the way
+ * cleanupM2M() and a processM2M() that allocated by itself would.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <map>
+#include <vector>
+
+#include "ExynosMPPDstPool.h"
+#include "ExynosMPPJobStats.h"
+
+#define NUM_UNITS       2
+#define NUM_SLOTS       3
+#define QUEUE_DEPTH     8
+
+#define FORMAT_NV12     0x100
+#define USAGE_HWC       0x1
+#define USAGE_PROTECTED 0x4000
+
+typedef ExynosMPPDstPool::Buffer Buffer;
+typedef ExynosMPPDstPool::Key Key;
+
+static int gAllocUs = 3000;
+static int gSetupUs = 200;
+static int gMpixPerSec = 400;
+static int gVsyncUs = 16667;
+static int gErrors;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleepUs(uint64_t us)
+{
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/* Fences are eventfds: signalled once written, every dup sees it */
+static int fenceCreate(void)
+{
+    return eventfd(0, 0);
+}
+
+static void fenceSignal(int fd)
+{
+    uint64_t one = 1;
+
+    if (write(fd, &one, sizeof(one)) != sizeof(one))
+        gErrors++;
+}
+
+static bool fenceWait(int fd, int timeoutMs)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    return fd < 0 || poll(&pfd, 1, timeoutMs) == 1;
+}
+
+class MockAllocator : public ExynosMPPDstPool::Allocator {
+    public:
+        uint32_t allocations;
+        uint32_t frees;
+
+        MockAllocator() : allocations(0), frees(0) {}
+
+        ~MockAllocator() {
+            for (size_t i = 0; i < mFreed.size(); i++)
+                free(mFreed[i]);
+        }
+
+        virtual int allocDstBuffer(const Key &key, Buffer *buf) {
+            native_handle_t *h = (native_handle_t *)calloc(1, sizeof(native_handle_t));
+
+            sleepUs(gAllocUs);
+            h->version = sizeof(native_handle_t);
+            mLive[h] = key;
+            allocations++;
+            *buf = h;
+            return 0;
+        }
+
+        virtual void freeDstBuffer(Buffer buf) {
+            if (mLive.erase(buf) != 1) {
+                fprintf(stderr, "freeing a buffer that is not allocated\n");
+                gErrors++;
+                return;
+            }
+            /* not reused, so a stale handle is never mistaken for a new one */
+            mFreed.push_back((void *)buf);
+            frees++;
+        }
+
+        virtual bool describeDstBuffer(Buffer buf, Key *key) {
+            std::map<Buffer, Key>::iterator it = mLive.find(buf);
+
+            if (it == mLive.end())
+                return false;
+            *key = it->second;
+            return true;
+        }
+
+        bool keyOf(Buffer buf, Key *key) { return describeDstBuffer(buf, key); }
+        size_t live() const { return mLive.size(); }
+
+    private:
+        std::map<Buffer, Key> mLive;
+        std::vector<void *> mFreed;
+};
+
+/* One MSC: jobs run in order on their own thread */
+class MockM2M {
+    public:
+        MockM2M() : mHead(0), mTail(0), mStop(false) {
+            pthread_mutex_init(&mLock, NULL);
+            pthread_cond_init(&mCond, NULL);
+            pthread_create(&mThread, NULL, run, this);
+        }
+
+        ~MockM2M() {
+            pthread_mutex_lock(&mLock);
+            mStop = true;
+            pthread_cond_broadcast(&mCond);
+            pthread_mutex_unlock(&mLock);
+            pthread_join(mThread, NULL);
+        }
+
+        /* Takes dstFence, returns the fence of the job */
+        int submit(int dstFence, uint32_t pixels) {
+            Job job;
+
+            sleepUs(gSetupUs);
+            job.dstFence = dstFence;
+            job.us = (uint64_t)pixels / gMpixPerSec;
+            job.done = fenceCreate();
+            int fence = dup(job.done);
+
+            pthread_mutex_lock(&mLock);
+            while (mTail - mHead == QUEUE_DEPTH)
+                pthread_cond_wait(&mCond, &mLock);
+            mJobs[mTail++ % QUEUE_DEPTH] = job;
+            pthread_cond_broadcast(&mCond);
+            pthread_mutex_unlock(&mLock);
+            return fence;
+        }
+
+    private:
+        struct Job {
+            int dstFence;
+            uint64_t us;
+            int done;
+        };
+
+        Job mJobs[QUEUE_DEPTH];
+        unsigned int mHead, mTail;
+        bool mStop;
+        pthread_mutex_t mLock;
+        pthread_cond_t mCond;
+        pthread_t mThread;
+
+        static void *run(void *arg) {
+            MockM2M *m2m = (MockM2M *)arg;
+
+            pthread_mutex_lock(&m2m->mLock);
+            for (;;) {
+                while (m2m->mHead == m2m->mTail && !m2m->mStop)
+                    pthread_cond_wait(&m2m->mCond, &m2m->mLock);
+                if (m2m->mHead == m2m->mTail)
+                    break;
+                Job job = m2m->mJobs[m2m->mHead % QUEUE_DEPTH];
+                pthread_mutex_unlock(&m2m->mLock);
+
+                fenceWait(job.dstFence, -1);
+                if (job.dstFence >= 0)
+                    close(job.dstFence);
+                sleepUs(job.us);
+                fenceSignal(job.done);
+                close(job.done);
+
+                pthread_mutex_lock(&m2m->mLock);
+                m2m->mHead++;
+                pthread_cond_broadcast(&m2m->mCond);
+            }
+            pthread_mutex_unlock(&m2m->mLock);
+            return NULL;
+        }
+};
+
+struct Unit {
+    MockM2M m2m;
+    Buffer slots[NUM_SLOTS];
+    int fences[NUM_SLOTS];
+    size_t current;
+    ExynosMPPDstPool pool;
+    Key ringKey;            /* ring mode: what the ring was allocated for */
+    bool ringValid;
+    ExynosMPPJobStats stats;
+
+    Unit() : current(0), ringValid(false) {
+        memset(slots, 0, sizeof(slots));
+        for (size_t s = 0; s < NUM_SLOTS; s++)
+            fences[s] = -1;
+    }
+};
+
+/* The destination of each unit in a frame */
+static Key scenario(size_t unit, int frame, int period)
+{
+    Key key = { FORMAT_NV12, 1920, 1080, USAGE_HWC };
+
+    if (unit == 0) {
+        if ((frame / period) % 2) {
+            key.width = 1280;
+            key.height = 720;
+        }
+    } else if ((frame / (period * 3 / 2)) % 2) {
+        key.usage |= USAGE_PROTECTED;
+    }
+    return key;
+}
+
+/* What processM2M() does when it allocates: the whole ring for a new key */
+static void ringRealloc(Unit &u, MockAllocator &alloc, const Key &key)
+{
+    if (u.ringValid && u.ringKey == key)
+        return;
+
+    for (size_t s = 0; s < NUM_SLOTS; s++) {
+        if (u.slots[s])
+            alloc.freeDstBuffer(u.slots[s]);
+        alloc.allocDstBuffer(key, &u.slots[s]);
+    }
+    u.ringKey = key;
+    u.ringValid = true;
+}
+
+static void checkSlots(Unit &u, MockAllocator &alloc, const Key &key, int frame)
+{
+    Key got;
+
+    if (!u.slots[u.current] || !alloc.keyOf(u.slots[u.current], &got) || !(got == key)) {
+        if (gErrors++ < 5)
+            fprintf(stderr, "frame %d: slot %zu holds no buffer of the wanted key\n",
+                    frame, u.current);
+    }
+    for (size_t s = 0; s < NUM_SLOTS; s++) {
+        if (s != u.current && u.slots[s] == u.slots[u.current]) {
+            if (gErrors++ < 5)
+                fprintf(stderr, "frame %d: slots %zu and %zu share a buffer\n",
+                        frame, s, u.current);
+        }
+    }
+}
+
+struct Frame {
+    int done[NUM_UNITS];
+    int release[NUM_UNITS];
+};
+
+static void closeFrame(Frame &f, bool signal)
+{
+    for (size_t u = 0; u < NUM_UNITS; u++) {
+        if (f.done[u] >= 0)
+            close(f.done[u]);
+        if (f.release[u] >= 0) {
+            if (signal)
+                fenceSignal(f.release[u]);
+            close(f.release[u]);
+        }
+        f.done[u] = f.release[u] = -1;
+    }
+}
+
+static int runMode(bool usePool, int frames, int period)
+{
+    MockAllocator alloc;
+    Unit units[NUM_UNITS];
+    Frame pending, shown;
+    int late = 0;
+    uint64_t start = nowNs();
+
+    memset(&pending, -1, sizeof(pending));
+    memset(&shown, -1, sizeof(shown));
+    for (size_t u = 0; u < NUM_UNITS; u++)
+        units[u].pool.setAllocator(&alloc);
+
+    for (int f = 0; f < frames; f++) {
+        uint64_t vsync = start + (uint64_t)f * gVsyncUs * 1000;
+        uint64_t now = nowNs();
+
+        if (now < vsync)
+            sleepUs((vsync - now) / 1000);
+
+        /* DECON latches the frame composed last, and lets go of the one before */
+        if (f > 0) {
+            bool ready = true;
+            for (size_t u = 0; u < NUM_UNITS; u++)
+                ready = ready && fenceWait(pending.done[u], 0);
+            if (!ready) {
+                late++;
+                for (size_t u = 0; u < NUM_UNITS; u++)
+                    fenceWait(pending.done[u], -1);
+            }
+            closeFrame(shown, true);
+            shown = pending;
+            memset(&pending, -1, sizeof(pending));
+        }
+
+        if (usePool && (f == frames / 3 || f == 2 * frames / 3)) {
+            Unit &u = units[1];
+
+            /* cleanupM2M(): the ring is freed under the pool */
+            for (size_t s = 0; s < NUM_SLOTS; s++) {
+                if (u.slots[s])
+                    alloc.freeDstBuffer(u.slots[s]);
+                u.slots[s] = NULL;
+            }
+            /* a processM2M() that allocated for itself */
+            alloc.allocDstBuffer(scenario(1, f, period), &u.slots[(u.current + 1) % NUM_SLOTS]);
+        }
+
+        for (size_t i = 0; i < NUM_UNITS; i++) {
+            Unit &u = units[i];
+            Key key = scenario(i, f, period);
+            uint64_t t0 = nowNs();
+            bool ok = true;
+
+            if (usePool) {
+                ok = u.pool.fillSlot(u.slots, u.fences, NUM_SLOTS, u.current, key) == 0;
+                if (ok)
+                    checkSlots(u, alloc, key, f);
+            } else {
+                ringRealloc(u, alloc, key);
+            }
+
+            int dstFence = u.fences[u.current];
+            bool dstWait = dstFence >= 0 && !fenceWait(dstFence, 0);
+            u.fences[u.current] = -1;
+            pending.done[i] = u.m2m.submit(dstFence, key.width * key.height);
+            u.stats.add(nowNs() - t0, ok, dstWait);
+
+            /* After posting, the display keeps DECON's release fence in the slot */
+            pending.release[i] = fenceCreate();
+            u.fences[u.current] = dup(pending.release[i]);
+            u.current = (u.current + 1) % NUM_SLOTS;
+        }
+    }
+
+    for (size_t u = 0; u < NUM_UNITS; u++)
+        fenceWait(pending.done[u], -1);
+    closeFrame(shown, true);
+    closeFrame(pending, true);
+
+    printf("%s:\n", usePool ? "pool" : "ring");
+    for (size_t i = 0; i < NUM_UNITS; i++) {
+        const ExynosMPPJobStats &s = units[i].stats;
+
+        printf("  MSC%zu  %u jobs, submit avg %4llu us, p99 < %5llu us, max %5llu us, %u waited for DECON\n",
+                i, s.jobs, (unsigned long long)(s.averageNs() / 1000),
+                (unsigned long long)(s.percentileNs(99) / 1000),
+                (unsigned long long)(s.maxNs / 1000), s.dstWaits);
+        if (usePool) {
+            const ExynosMPPDstPool::Stats &p = units[i].pool.stats();
+            printf("        pool: %zu buffers, %u reused, %u evicted, %u adopted, %u lost\n",
+                    units[i].pool.size(), p.reuses, p.evictions, p.adopted, p.lost);
+        }
+    }
+    printf("  %u allocations, %d of %d frames not scaled by their vsync\n",
+            alloc.allocations, late, frames);
+
+    for (size_t i = 0; i < NUM_UNITS; i++) {
+        Unit &u = units[i];
+
+        if (usePool)
+            u.pool.clear();
+        for (size_t s = 0; s < NUM_SLOTS; s++) {
+            if (u.slots[s])
+                alloc.freeDstBuffer(u.slots[s]);
+            if (u.fences[s] >= 0)
+                close(u.fences[s]);
+        }
+    }
+    if (alloc.live() != 0) {
+        fprintf(stderr, "%zu buffers leaked\n", alloc.live());
+        gErrors++;
+    }
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-g frames] [-a us] [-v us]\n"
+            "  -n  frames per mode (default 240)\n"
+            "  -g  frames between geometry changes of unit 0 (default 20)\n"
+            "  -a  time of one buffer allocation (default %d)\n"
+            "  -v  vsync period (default %d)\n",
+            name, gAllocUs, gVsyncUs);
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = 240;
+    int period = 20;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:g:a:v:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'g':
+            period = atoi(optarg);
+            break;
+        case 'a':
+            gAllocUs = atoi(optarg);
+            break;
+        case 'v':
+            gVsyncUs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (frames < 3 || period < 2 || gAllocUs < 0 || gVsyncUs < 1000) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    runMode(false, frames, period);
+    runMode(true, frames, period);
+
+    if (gErrors)
+        printf("%d errors\n", gErrors);
+    return gErrors ? 1 : 0;
+}
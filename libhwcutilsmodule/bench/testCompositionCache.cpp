@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Table-driven host test of ExynosCompositionCache.
+ *
+ * Each case is a sequence of stores and lookups on a fresh cache. Keys are
+ * numbered: key n is the words n, n + 1, ..., with a few special ones that
+ * differ from key 1 in a single way. A stored value is the key number
+ * followed by zeros, so a hit also shows which entry answered.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ExynosCompositionCache.h"
+
+enum {
+    KEY_SWAPPED = 100,      /* key 1 with two words swapped */
+    KEY_LONGER,             /* key 1 and one more word */
+    KEY_FLOAT,              /* key 1 with -0.0f in place of 0.0f */
+    KEY_OVERFLOW,           /* more words than a key holds */
+};
+
+enum {
+    STORE,
+    STORE_LONG,             /* a value longer than an entry holds */
+    LOOKUP,                 /* expect: the key number of the hit, or -1 */
+    CLEAR,
+};
+
+struct Step {
+    int op;
+    int key;
+    int expect;
+};
+
+#define MAX_STEPS   12
+
+struct Case {
+    const char *name;
+    Step steps[MAX_STEPS];
+    size_t numSteps;
+    uint32_t hits;
+    uint32_t evictions;
+    uint32_t uncacheable;
+};
+
+static const Case cases[] = {
+    { "miss, store, hit", {
+            { LOOKUP, 1, -1 }, { STORE, 1, 0 }, { LOOKUP, 1, 1 } }, 3, 1, 0, 0 },
+    { "other keys miss", {
+            { STORE, 1, 0 }, { LOOKUP, 2, -1 }, { LOOKUP, KEY_SWAPPED, -1 },
+            { LOOKUP, KEY_LONGER, -1 }, { LOOKUP, KEY_FLOAT, -1 } }, 5, 0, 0, 0 },
+    { "store again replaces", {
+            { STORE, 1, 0 }, { STORE, 1, 0 }, { LOOKUP, 1, 1 } }, 3, 1, 0, 0 },
+    { "all entries in use", {
+            { STORE, 1, 0 }, { STORE, 2, 0 }, { STORE, 3, 0 }, { STORE, 4, 0 },
+            { LOOKUP, 1, 1 }, { LOOKUP, 2, 2 }, { LOOKUP, 3, 3 }, { LOOKUP, 4, 4 } },
+            8, 4, 0, 0 },
+    { "least recently used goes", {
+            { STORE, 1, 0 }, { STORE, 2, 0 }, { STORE, 3, 0 }, { STORE, 4, 0 },
+            { LOOKUP, 1, 1 }, { STORE, 5, 0 }, { LOOKUP, 2, -1 }, { LOOKUP, 1, 1 },
+            { LOOKUP, 5, 5 } }, 9, 3, 1, 0 },
+    { "two stacks toggling", {
+            { STORE, 1, 0 }, { STORE, 2, 0 }, { LOOKUP, 1, 1 }, { LOOKUP, 2, 2 },
+            { LOOKUP, 1, 1 }, { LOOKUP, 2, 2 } }, 6, 4, 0, 0 },
+    { "key too long", {
+            { STORE, KEY_OVERFLOW, 0 }, { LOOKUP, KEY_OVERFLOW, -1 } }, 2, 0, 0, 1 },
+    { "value too long", {
+            { STORE_LONG, 1, 0 }, { LOOKUP, 1, -1 } }, 2, 0, 0, 1 },
+    { "clear", {
+            { STORE, 1, 0 }, { STORE, 2, 0 }, { CLEAR, 0, 0 }, { LOOKUP, 1, -1 },
+            { LOOKUP, 2, -1 } }, 5, 0, 0, 0 },
+};
+
+static void makeKey(int n, ExynosCompositionCache::Key &key)
+{
+    switch (n) {
+    case KEY_SWAPPED:
+        key.add((uint32_t)2);
+        key.add((uint32_t)1);
+        for (uint32_t w = 3; w <= 8; w++)
+            key.add(w);
+        key.add(0.0f);
+        return;
+    case KEY_OVERFLOW:
+        for (uint32_t w = 0; w <= COMPOSITION_CACHE_KEY_WORDS; w++)
+            key.add(w);
+        return;
+    }
+
+    int first = (n >= KEY_SWAPPED) ? 1 : n;
+    for (uint32_t w = first; w < (uint32_t)first + 8; w++)
+        key.add(w);
+    key.add(n == KEY_FLOAT ? -0.0f : 0.0f);
+    if (n == KEY_LONGER)
+        key.add((uint32_t)0);
+}
+
+static bool runCase(const Case &t)
+{
+    ExynosCompositionCache cache;
+    int32_t value[COMPOSITION_CACHE_VALUE_WORDS + 1];
+    bool ok = true;
+
+    for (size_t s = 0; s < t.numSteps; s++) {
+        const Step &step = t.steps[s];
+        ExynosCompositionCache::Key key;
+        int ret;
+
+        makeKey(step.key, key);
+        memset(value, 0, sizeof(value));
+
+        switch (step.op) {
+        case STORE:
+        case STORE_LONG:
+            value[0] = step.key;
+            cache.store(key, value, step.op == STORE_LONG ?
+                    COMPOSITION_CACHE_VALUE_WORDS + 1 : COMPOSITION_CACHE_VALUE_WORDS);
+            break;
+        case LOOKUP:
+            ret = cache.lookup(key, value);
+            if (ret < 0 ? step.expect != -1 :
+                    (ret != COMPOSITION_CACHE_VALUE_WORDS || value[0] != step.expect)) {
+                printf("  step %zu: lookup of key %d returned %d, value %d, expected %d\n",
+                        s, step.key, ret, value[0], step.expect);
+                ok = false;
+            }
+            break;
+        case CLEAR:
+            cache.clear();
+            break;
+        }
+    }
+
+    const ExynosCompositionCache::Stats &stats = cache.stats();
+    if (stats.hits != t.hits || stats.evictions != t.evictions ||
+            stats.uncacheable != t.uncacheable) {
+        printf("  hits %u evictions %u uncacheable %u, expected %u %u %u\n",
+                stats.hits, stats.evictions, stats.uncacheable,
+                t.hits, t.evictions, t.uncacheable);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    size_t total = sizeof(cases) / sizeof(cases[0]);
+    size_t failed = 0;
+
+    for (size_t i = 0; i < total; i++) {
+        bool ok = runCase(cases[i]);
+
+        printf("%s %s\n", ok ? "ok  " : "FAIL", cases[i].name);
+        if (!ok)
+            failed++;
+    }
+
+    printf("%zu/%zu passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Table-driven host test of ExynosFenceSet, with eventfds standing in for
+ * sync fences.
+ *
+ * Each case runs one set() of the virtual display the way
+ * ExynosVirtualDisplayModule does it: ownFences(), postToMPP() with a mock
+ * MSC job, then manageFences(), and plays SurfaceFlinger afterwards by
+ * closing the retire and release fences it was given. The fence ops count
+ * the dup, close and merge calls the display made and refuse to close an
+ * fd that is not open, so a double close fails the case. Every fd the test
+ * created must be closed at the end of the case, and the process must have
+ * as many fds open after the test as before.
+ */
+
+#include <dirent.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <set>
+
+#include "ExynosFenceSet.h"
+
+#define HWC_OVERLAY                 1
+#define HWC_FRAMEBUFFER_TARGET      3
+
+enum {
+    PLAN_SCALE,
+    PLAN_BLEND,
+    PLAN_FILL_AND_BLEND,
+};
+
+enum {
+    FAIL_NONE,
+    FAIL_MERGE,         /* sync_merge() fails */
+    FAIL_FILL,          /* processM2M() of the fill fails */
+    FAIL_JOB,           /* the scaling or blending job fails */
+};
+
+enum {
+    SKIP_NONE,
+    SKIP,               /* plus an overlay with HWC_SKIP_RENDERING */
+    SKIP_RELEASED,      /* the same, with a release fence already set */
+};
+
+struct Layer {
+    int compositionType;
+    bool skipRendering;
+    int acquireFenceFd;
+    int releaseFenceFd;
+};
+
+struct Case {
+    const char *name;
+    int plan;
+    int fail;
+    int skip;
+    unsigned int dups;
+    unsigned int closes;
+    unsigned int merges;
+    unsigned int waits;
+    bool retire;            /* a retire fence is handed back */
+};
+
+static const Case cases[] = {
+    /* name                          plan                 fail        skip           dup cls mrg wait retire */
+    { "scale",                       PLAN_SCALE,          FAIL_NONE,  SKIP_NONE,     1, 2, 0, 0, true },
+    { "scale, skipped layer",        PLAN_SCALE,          FAIL_NONE,  SKIP,          1, 2, 0, 0, true },
+    { "scale, skipped and released", PLAN_SCALE,          FAIL_NONE,  SKIP_RELEASED, 1, 3, 0, 0, true },
+    { "blend",                       PLAN_BLEND,          FAIL_NONE,  SKIP_NONE,     2, 4, 1, 0, true },
+    { "blend, merge fails",          PLAN_BLEND,          FAIL_MERGE, SKIP_NONE,     2, 3, 1, 1, true },
+    { "blend, job fails",            PLAN_BLEND,          FAIL_JOB,   SKIP_NONE,     0, 4, 1, 0, false },
+    { "fill and blend",              PLAN_FILL_AND_BLEND, FAIL_NONE,  SKIP_NONE,     2, 4, 0, 0, true },
+    { "fill and blend, fill fails",  PLAN_FILL_AND_BLEND, FAIL_FILL,  SKIP_NONE,     0, 3, 0, 0, false },
+    { "fill and blend, job fails",   PLAN_FILL_AND_BLEND, FAIL_JOB,   SKIP_NONE,     0, 4, 0, 0, false },
+    { "scale, job fails",            PLAN_SCALE,          FAIL_JOB,   SKIP_NONE,     0, 2, 0, 0, false },
+};
+
+static std::set<int> gOpen;
+static unsigned int gDups, gCloses, gMerges, gWaits;
+static bool gMergeFails;
+static int gErrors;
+
+/* A signalled fence */
+static int newFence(void)
+{
+    int fd = eventfd(1, EFD_CLOEXEC);
+
+    if (fd >= 0)
+        gOpen.insert(fd);
+    return fd;
+}
+
+static int countingDup(int fd)
+{
+    gDups++;
+    if (!gOpen.count(fd)) {
+        printf("  dup of fd %d, not open\n", fd);
+        gErrors++;
+        return -1;
+    }
+
+    int copy = dup(fd);
+    if (copy >= 0)
+        gOpen.insert(copy);
+    return copy;
+}
+
+static int checkedClose(int fd)
+{
+    if (!gOpen.erase(fd)) {
+        printf("  close of fd %d, not open\n", fd);
+        gErrors++;
+        return -1;
+    }
+    return close(fd);
+}
+
+static int countingClose(int fd)
+{
+    gCloses++;
+    return checkedClose(fd);
+}
+
+static int countingMerge(const char *, int fd1, int fd2)
+{
+    gMerges++;
+    if (!gOpen.count(fd1) || !gOpen.count(fd2)) {
+        printf("  merge of fds %d and %d, not open\n", fd1, fd2);
+        gErrors++;
+        return -1;
+    }
+    return gMergeFails ? -1 : newFence();
+}
+
+static int countingWait(int fd, int timeout)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    gWaits++;
+    return poll(&pfd, 1, timeout) == 1 ? 0 : -1;
+}
+
+static const ExynosFenceOps countingOps = {
+    countingDup, countingClose, countingMerge, countingWait
+};
+
+static size_t openFds(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    size_t n = 0;
+
+    if (dir == NULL)
+        return 0;
+    while (readdir(dir) != NULL)
+        n++;
+    closedir(dir);
+    return n;
+}
+
+/* The mock MSC job: a new release fence, or -1 if it fails */
+static int runJob(ExynosFenceSet &fences, int dstFence, int srcFence, bool fails)
+{
+    if (!fences.owns(dstFence) || (srcFence >= 0 && !fences.owns(srcFence))) {
+        printf("  job borrows fences %d and %d the set does not own\n", dstFence, srcFence);
+        gErrors++;
+    }
+    return fails ? -1 : newFence();
+}
+
+/* ExynosVirtualDisplayModule::postToMPP() */
+static int postToMPP(const Case &t, Layer &video, Layer &fbTarget, int outbufFence,
+        ExynosFenceSet &fences)
+{
+    int dstFence = outbufFence;
+
+    if (t.plan == PLAN_FILL_AND_BLEND) {
+        int fill = runJob(fences, dstFence, fbTarget.acquireFenceFd, t.fail == FAIL_FILL);
+
+        if (fill < 0)
+            return -1;
+        dstFence = fences.own(fill);
+    } else if (t.plan == PLAN_BLEND) {
+        video.acquireFenceFd = fences.merge("scaler_blend", fbTarget.acquireFenceFd,
+                video.acquireFenceFd);
+        fbTarget.acquireFenceFd = -1;
+    }
+
+    int fence = runJob(fences, dstFence, video.acquireFenceFd, t.fail == FAIL_JOB);
+    return fences.own(fence);
+}
+
+static bool runCase(const Case &t)
+{
+    Layer layers[3];
+    size_t numLayers = 0;
+    int outbufFence = newFence();
+    int retireFence;
+
+    gDups = gCloses = gMerges = gWaits = 0;
+    gMergeFails = t.fail == FAIL_MERGE;
+
+    Layer &video = layers[numLayers++];
+    video.compositionType = HWC_OVERLAY;
+    video.skipRendering = false;
+    video.acquireFenceFd = newFence();
+    video.releaseFenceFd = -1;
+
+    Layer &fbTarget = layers[numLayers++];
+    fbTarget.compositionType = HWC_FRAMEBUFFER_TARGET;
+    fbTarget.skipRendering = false;
+    fbTarget.acquireFenceFd = t.plan == PLAN_SCALE ? -1 : newFence();
+    fbTarget.releaseFenceFd = -1;
+    bool fbNeeded = t.plan != PLAN_SCALE;
+
+    if (t.skip != SKIP_NONE) {
+        Layer &skipped = layers[numLayers++];
+        skipped.compositionType = HWC_OVERLAY;
+        skipped.skipRendering = true;
+        skipped.acquireFenceFd = newFence();
+        skipped.releaseFenceFd = t.skip == SKIP_RELEASED ? newFence() : -1;
+    }
+
+    {
+        ExynosFenceSet fences(&countingOps);
+
+        /* ownFences() */
+        for (size_t i = 0; i < numLayers; i++) {
+            Layer &layer = layers[i];
+
+            if (layer.skipRendering && layer.releaseFenceFd < 0) {
+                layer.releaseFenceFd = layer.acquireFenceFd;
+                layer.acquireFenceFd = -1;
+            } else {
+                fences.own(layer.acquireFenceFd);
+            }
+        }
+        fences.own(outbufFence);
+
+        int fence = postToMPP(t, video, fbTarget, outbufFence, fences);
+
+        /* manageFences() */
+        for (size_t i = 0; i < numLayers; i++) {
+            Layer &layer = layers[i];
+
+            layer.acquireFenceFd = -1;
+            if (!layer.skipRendering && layer.releaseFenceFd < 0 &&
+                    (layer.compositionType == HWC_OVERLAY ||
+                     (fbNeeded && layer.compositionType == HWC_FRAMEBUFFER_TARGET)))
+                layer.releaseFenceFd = fences.dup(fence);
+        }
+        retireFence = fences.release(fence);
+    }
+
+    bool ok = gDups == t.dups && gCloses == t.closes && gMerges == t.merges &&
+            gWaits == t.waits && (retireFence >= 0) == t.retire;
+    if (!ok)
+        printf("  dup %u close %u merge %u wait %u retire %d, expected %u %u %u %u %s\n",
+                gDups, gCloses, gMerges, gWaits, retireFence,
+                t.dups, t.closes, t.merges, t.waits, t.retire ? "a fence" : "-1");
+
+    /* SurfaceFlinger */
+    if (retireFence >= 0)
+        checkedClose(retireFence);
+    for (size_t i = 0; i < numLayers; i++) {
+        if (layers[i].releaseFenceFd >= 0)
+            checkedClose(layers[i].releaseFenceFd);
+    }
+
+    if (!gOpen.empty()) {
+        printf("  %zu fds leaked\n", gOpen.size());
+        while (!gOpen.empty())
+            checkedClose(*gOpen.begin());
+        ok = false;
+    }
+    return ok;
+}
+
+/* More fences than the set holds: the rest stays with the caller */
+static bool runFull(void)
+{
+    int fds[FENCE_SET_MAX_FENCES + 1];
+    bool ok = true;
+
+    gCloses = 0;
+    {
+        ExynosFenceSet fences(&countingOps);
+
+        for (size_t i = 0; i <= FENCE_SET_MAX_FENCES; i++)
+            fds[i] = newFence();
+        for (size_t i = 0; i <= FENCE_SET_MAX_FENCES; i++)
+            fences.own(fds[i]);
+        fences.own(fds[0]);
+        ok = fences.size() == FENCE_SET_MAX_FENCES && fences.stats().full == 1;
+    }
+
+    ok = ok && gCloses == FENCE_SET_MAX_FENCES && gOpen.size() == 1;
+    checkedClose(fds[FENCE_SET_MAX_FENCES]);
+    return ok && gOpen.empty();
+}
+
+int main(void)
+{
+    size_t total = sizeof(cases) / sizeof(cases[0]) + 1;
+    size_t failed = 0;
+    size_t fdsBefore = openFds();
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int errors = gErrors;
+        bool ok = runCase(cases[i]) && gErrors == errors;
+
+        printf("%s %s\n", ok ? "ok  " : "FAIL", cases[i].name);
+        if (!ok)
+            failed++;
+    }
+
+    bool ok = runFull();
+    printf("%s more than %d fences\n", ok ? "ok  " : "FAIL", FENCE_SET_MAX_FENCES);
+    if (!ok)
+        failed++;
+
+    if (openFds() != fdsBefore) {
+        printf("FAIL %zu fds open before, %zu after\n", fdsBefore, openFds());
+        failed++;
+        total++;
+    }
+
+    printf("%zu/%zu passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
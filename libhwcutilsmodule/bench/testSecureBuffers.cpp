@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Table-driven host test of ExynosSecureBufferManager with the
+ * ExynosMPPDstPool of one MSC.
+ *
+ * Each case runs a few stretches of frames through a mock display that
+ * does what ExynosPrimaryDisplay::reserveSecureBuffers() and postMPPM2M()
+ * do: frame() in prepare, then reserve or release the pool buffers of the
+ * protected layer, then one MSC job per frame that has a video layer. The
+ * secmem device and the allocator are mocks; they count what happens and
+ * move a fake clock, so the startup times in the output are the ones of
+ * the mock costs below, not measurements.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+#include "ExynosMPPDstPool.h"
+#include "ExynosSecureBufferManager.h"
+
+#define NUM_SLOTS           3
+#define FRAME_NS            16666667ULL
+#define ALLOC_NS            3000000ULL      /* one dst buffer */
+#define ALLOC_PROTECTED_NS  8000000ULL      /* one from the carve-out */
+#define PROTECT_NS          20000000ULL     /* isolating the carve-out */
+
+#define FORMAT_RGBX         1
+#define USAGE_HWC           0x1
+#define USAGE_PROTECTED     0x4000
+
+typedef ExynosMPPDstPool::Buffer Buffer;
+typedef ExynosMPPDstPool::Key Key;
+
+static const Key KEY_1080 = { FORMAT_RGBX, 1920, 1080, USAGE_HWC | USAGE_PROTECTED };
+static const Key KEY_720 = { FORMAT_RGBX, 1280, 720, USAGE_HWC | USAGE_PROTECTED };
+static const Key KEY_VIDEO = { FORMAT_RGBX, 1920, 1080, USAGE_HWC };
+
+static uint64_t gNow;
+
+static struct {
+    int isolated;
+    bool fail;
+    bool on;
+    uint32_t onCalls;
+    uint32_t offCalls;
+} gSecmem;
+
+static int mockIsolated(void)
+{
+    return gSecmem.isolated;
+}
+
+static int mockSetVideoExt(int enable)
+{
+    if (enable) {
+        gSecmem.onCalls++;
+        if (gSecmem.fail)
+            return -1;
+        gNow += PROTECT_NS;
+    } else {
+        gSecmem.offCalls++;
+    }
+    gSecmem.on = enable;
+    return 0;
+}
+
+static const ExynosSecmemOps mockOps = { mockIsolated, mockSetVideoExt };
+
+class MockAllocator : public ExynosMPPDstPool::Allocator {
+    public:
+        virtual int allocDstBuffer(const Key &key, Buffer *buf) {
+            native_handle_t *h = (native_handle_t *)calloc(1, sizeof(native_handle_t));
+
+            gNow += (key.usage & USAGE_PROTECTED) ? ALLOC_PROTECTED_NS : ALLOC_NS;
+            mLive[h] = key;
+            *buf = h;
+            return 0;
+        }
+
+        virtual void freeDstBuffer(Buffer buf) {
+            if (mLive.erase(buf) == 1)
+                free((void *)buf);
+        }
+
+        virtual bool describeDstBuffer(Buffer buf, Key *key) {
+            std::map<Buffer, Key>::iterator it = mLive.find(buf);
+
+            if (it == mLive.end())
+                return false;
+            *key = it->second;
+            return true;
+        }
+
+        size_t live() const { return mLive.size(); }
+
+    private:
+        std::map<Buffer, Key> mLive;
+};
+
+enum {
+    UI,                     /* no video layer */
+    SECURE_1080,            /* a protected video layer, scaled to 1080p */
+    SECURE_720,
+    VIDEO,                  /* an ordinary video layer on the same MSC */
+};
+
+struct Stretch {
+    int kind;
+    int frames;
+};
+
+#define MAX_STRETCHES   4
+
+struct Case {
+    const char *name;
+    int isolated;
+    bool failProtect;
+    bool noReserve;         /* the jobs allocate, as before */
+    Stretch stretches[MAX_STRETCHES];
+    size_t numStretches;
+    /* expected */
+    uint32_t sessions;
+    uint32_t resumed;
+    uint32_t lateAllocations;
+    uint32_t reservedBuffers;
+    uint32_t onCalls;
+    uint32_t offCalls;
+    size_t live;
+};
+
+static const Case cases[] = {
+    { "session reserves the ring up front", 0, false, false,
+            { { UI, 10 }, { SECURE_1080, 100 } }, 2,
+            1, 0, 0, 3, 1, 0, 3 },
+    { "without reserve the jobs allocate", 0, false, true,
+            { { UI, 10 }, { SECURE_1080, 100 } }, 2,
+            1, 0, 3, 0, 1, 0, 3 },
+    { "pause within the linger resumes", 0, false, false,
+            { { SECURE_1080, 50 }, { UI, 60 }, { SECURE_1080, 50 } }, 3,
+            1, 1, 0, 3, 1, 0, 3 },
+    { "released buffers wait for the ring", 0, false, false,
+            { { SECURE_1080, 50 }, { UI, 200 } }, 2,
+            1, 0, 0, 3, 1, 0, 3 },
+    { "ring moving on frees them", 0, false, false,
+            { { SECURE_1080, 50 }, { UI, 130 }, { VIDEO, 5 } }, 3,
+            1, 0, 0, 3, 1, 1, 3 },
+    { "new session while they go", 0, false, false,
+            { { SECURE_1080, 50 }, { UI, 125 }, { SECURE_1080, 10 } }, 3,
+            2, 0, 0, 3, 1, 0, 3 },
+    { "geometry change reserves again", 0, false, false,
+            { { SECURE_1080, 30 }, { SECURE_720, 30 } }, 2,
+            1, 0, 0, 6, 1, 0, 6 },
+    { "carve-out already isolated", 1, false, false,
+            { { SECURE_1080, 50 }, { UI, 130 }, { VIDEO, 5 } }, 3,
+            1, 0, 0, 3, 0, 0, 3 },
+    { "protect failure", 0, true, false,
+            { { SECURE_1080, 50 }, { UI, 130 }, { VIDEO, 5 } }, 3,
+            1, 0, 0, 3, 1, 0, 3 },
+};
+
+static bool runCase(const Case &t)
+{
+    MockAllocator alloc;
+    ExynosMPPDstPool pool;
+    Buffer slots[NUM_SLOTS];
+    int fences[NUM_SLOTS];
+    size_t cur = 0;
+    bool held = false;
+    bool ok = true;
+
+    memset(&gSecmem, 0, sizeof(gSecmem));
+    gSecmem.isolated = t.isolated;
+    gSecmem.fail = t.failProtect;
+    gNow = 0;
+
+    memset(slots, 0, sizeof(slots));
+    for (size_t s = 0; s < NUM_SLOTS; s++)
+        fences[s] = -1;
+    pool.setAllocator(&alloc);
+
+    {
+        ExynosSecureBufferManager manager(&mockOps);
+
+        for (size_t s = 0; s < t.numStretches; s++) {
+            const Stretch &stretch = t.stretches[s];
+            bool secure = stretch.kind == SECURE_1080 || stretch.kind == SECURE_720;
+            const Key &key = stretch.kind == SECURE_720 ? KEY_720 :
+                    stretch.kind == VIDEO ? KEY_VIDEO : KEY_1080;
+
+            for (int f = 0; f < stretch.frames; f++) {
+                uint64_t frameStart = gNow;
+
+                /* prepare */
+                int action = manager.frame(secure, gNow);
+                if (held && action == ExynosSecureBufferManager::ACTION_RELEASE)
+                    pool.unreserve(true);
+                if (action != ExynosSecureBufferManager::ACTION_RESERVE) {
+                    if (!manager.reserved() && (!held || pool.dropping() == 0)) {
+                        manager.released();
+                        held = false;
+                    }
+                } else if (!t.noReserve && pool.reserve(key, NUM_SLOTS) >= 0) {
+                    held = true;
+                }
+
+                /* set */
+                if (stretch.kind != UI) {
+                    uint32_t allocations = pool.stats().allocations;
+                    bool failed = pool.fillSlot(slots, fences, NUM_SLOTS, cur, key) < 0;
+
+                    cur = (cur + 1) % NUM_SLOTS;
+                    if (secure)
+                        manager.jobDone(failed || pool.stats().allocations != allocations, gNow);
+                }
+
+                gNow = frameStart + FRAME_NS > gNow ? frameStart + FRAME_NS : gNow;
+            }
+        }
+
+        const ExynosSecureBufferManager::Stats &stats = manager.stats();
+        if (stats.sessions != t.sessions || stats.resumed != t.resumed ||
+                stats.lateAllocations != t.lateAllocations ||
+                pool.stats().reserved != t.reservedBuffers) {
+            printf("  sessions %u resumed %u late %u reserved %u, expected %u %u %u %u\n",
+                    stats.sessions, stats.resumed, stats.lateAllocations,
+                    pool.stats().reserved, t.sessions, t.resumed,
+                    t.lateAllocations, t.reservedBuffers);
+            ok = false;
+        }
+        if (stats.protectFailures != (t.failProtect ? 1u : 0u)) {
+            printf("  %u protect failures\n", stats.protectFailures);
+            ok = false;
+        }
+        if (gSecmem.onCalls != t.onCalls || gSecmem.offCalls != t.offCalls) {
+            printf("  protection on %u off %u, expected %u %u\n",
+                    gSecmem.onCalls, gSecmem.offCalls, t.onCalls, t.offCalls);
+            ok = false;
+        }
+        if (alloc.live() != t.live) {
+            printf("  %zu buffers live, expected %zu\n", alloc.live(), t.live);
+            ok = false;
+        }
+        if (stats.maxStartupNs)
+            printf("  startup %llu us\n", (unsigned long long)(stats.maxStartupNs / 1000));
+    }
+
+    /* whatever the manager turned on, it turned off */
+    if (gSecmem.on) {
+        printf("  protection left on\n");
+        ok = false;
+    }
+
+    pool.clear();
+    for (size_t s = 0; s < NUM_SLOTS; s++)
+        alloc.freeDstBuffer(slots[s]);
+    return ok;
+}
+
+int main(void)
+{
+    size_t total = sizeof(cases) / sizeof(cases[0]);
+    size_t failed = 0;
+
+    for (size_t i = 0; i < total; i++) {
+        bool ok = runCase(cases[i]);
+
+        printf("%s %s\n", ok ? "ok  " : "FAIL", cases[i].name);
+        if (!ok)
+            failed++;
+    }
+
+    printf("%zu/%zu passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -51,3 +51,113 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_CLASS := SHARED_LIBRARIES
 
 include $(BUILD_SHARED_LIBRARY)
+
+ifeq ($(BOARD_USES_KEYMASTER_VER1), true)
+include $(CLEAR_VARS)
+
+# Benchmark of the ver1 HAL, see ver1/test/benchTeeKeymaster.cpp for options
+LOCAL_MODULE := keymaster1_benchmark
+
+LOCAL_CPPFLAGS := -Wall
+LOCAL_CPPFLAGS += -Wextra
+LOCAL_CPPFLAGS += -Werror
+
+BENCH_SRC_FILES := $(wildcard ${LOCAL_PATH}/ver1/src/*.cpp \
+                              ${LOCAL_PATH}/ver1/src/*.c)
+LOCAL_SRC_FILES := $(BENCH_SRC_FILES:$(LOCAL_PATH)/ver1/%=ver1/%) \
+	ver1/test/benchTeeKeymaster.cpp \
+	ver1/test/test_km_bench.cpp \
+	ver1/test/test_km_util.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/ver1/include
+
+LOCAL_SHARED_LIBRARIES := libcrypto liblog libMcClient libcutils
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# Host run of the ver1 HAL tests against the Keymaster TA model in
+# ver1/test/test_km_ta_mock.cpp over libMcClientMock, exits non-zero if a
+# test fails
+LOCAL_MODULE := keymaster1_test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_CPPFLAGS := -Wall
+LOCAL_CPPFLAGS += -Wextra
+LOCAL_CPPFLAGS += -Werror
+LOCAL_CPPFLAGS += -DKM_TA_MOCK
+
+TEST_SRC_FILES := $(wildcard ${LOCAL_PATH}/ver1/src/*.cpp \
+                             ${LOCAL_PATH}/ver1/src/*.c \
+                             ${LOCAL_PATH}/ver1/test/test_km_*.cpp)
+TEST_SRC_FILES := $(filter-out %/test_km_bench.cpp,$(TEST_SRC_FILES))
+LOCAL_SRC_FILES := $(TEST_SRC_FILES:$(LOCAL_PATH)/ver1/%=ver1/%) \
+	ver1/test/testTeeKeymaster.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/ver1/include \
+	$(LOCAL_PATH)/ver1/test
+
+LOCAL_SHARED_LIBRARIES := libcrypto-host libMcClientMock liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# keymaster1_benchmark on the host, against the Keymaster TA model over
+# libMcClientMock; reports are labelled "mock" and -l sets the simulated
+# world switch time
+LOCAL_MODULE := keymaster1_benchmark_mock
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_CPPFLAGS := -Wall
+LOCAL_CPPFLAGS += -Wextra
+LOCAL_CPPFLAGS += -Werror
+LOCAL_CPPFLAGS += -DKM_TA_MOCK
+
+BENCH_SRC_FILES := $(wildcard ${LOCAL_PATH}/ver1/src/*.cpp \
+                              ${LOCAL_PATH}/ver1/src/*.c)
+LOCAL_SRC_FILES := $(BENCH_SRC_FILES:$(LOCAL_PATH)/ver1/%=ver1/%) \
+	ver1/test/benchTeeKeymaster.cpp \
+	ver1/test/test_km_bench.cpp \
+	ver1/test/test_km_ta_mock.cpp \
+	ver1/test/test_km_util.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/ver1/include \
+	$(LOCAL_PATH)/ver1/test
+
+LOCAL_SHARED_LIBRARIES := libcrypto-host libMcClientMock liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+ifneq ($(BOARD_USES_KEYMASTER_VER1), true)
+include $(CLEAR_VARS)
+
+MOBICORE_PATH := hardware/samsung_slsi/$(TARGET_SOC)/mobicore
+
+# Host benchmark of ver0 TLC signs per second and bulk buffer transport over
+# libMcClientMock, exits non-zero if a call fails or a key is left in the staging WSM;
+# see ver0/benchTlcTeeKeymaster.c for options
+LOCAL_MODULE := keymaster0_tlc_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	ver0/benchTlcTeeKeymaster.c \
+	ver0/tlcTeeKeymaster_if.c
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/ver0 \
+	$(MOBICORE_PATH)/common/MobiCore/inc/ \
+	$(MOBICORE_PATH)/common/LogWrapper
+LOCAL_CFLAGS := -Wall
+
+LOCAL_SHARED_LIBRARIES := libMcClientMock liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+endif
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2013-2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Host benchmark of the bulk buffer transport of the keymaster0 TLC.
+ *
+ * First measures signs per second of TEE_RSASign() with a key blob and a
+ * digest, once with a session, TCI and mappings set up and torn down
+ * around every sign as the TLC used to, and once through the TLC's
+ * persistent session and staging WSM. The simulated TA load time per
+ * session open is the one given with -o, not a measurement. The second
+ * run also checks that no key blob is left in the staging WSM.
+ *
+ * Then runs TEE_RSAVerify() against libMcClientMock with inputs of 1 KiB to
+ * 8 MiB held in read-only memory, as binder hands them in. Each size is
+ * timed with input mappings (mcMapInput()) and then with the copying
+ * fallback taken when the kernel module cannot register read-only pages.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "McClientMock.h"
+#include "tlTeeKeymaster_Api.h"
+#include "tlcTeeKeymaster_if.h"
+
+#define BENCH_MIN_SIZE      1024
+#define BENCH_MAX_SIZE      (8 * 1024 * 1024)
+#define BENCH_KEY_SIZE      1024
+#define BENCH_SIG_SIZE      256
+#define BENCH_DIGEST_SIZE   32
+#define BENCH_SIGNS         2000
+#define BENCH_OPEN_US       3000
+
+static const mcUuid_t gUuid = TEE_KEYMASTER_TL_UUID;
+
+/* Checksum the simulated TA computes over the plain data it is given */
+static uint32_t gExpected;
+/* Simulated TA load time per session open, in microseconds */
+static uint32_t gOpenUs = BENCH_OPEN_US;
+/* Secure world view of the key blob of the last sign */
+static const uint8_t* gSignKey;
+
+
+static uint32_t checksum(
+    const uint8_t*  buf,
+    uint32_t        len
+){
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        sum = (sum << 1 | sum >> 31) ^ buf[i];
+    }
+    return sum;
+}
+
+
+static mcResult_t onOpen(
+    void*       ctx,
+    uint32_t    sessionId,
+    uint8_t*    tci,
+    uint32_t    tciLen
+){
+    (void)ctx;
+    (void)sessionId;
+    (void)tci;
+    (void)tciLen;
+
+    usleep(gOpenUs);
+    return MC_DRV_OK;
+}
+
+
+/**
+ * Simulated RSA sign: the signature is the checksum of key blob and digest
+ * repeated over the signature buffer.
+ */
+static uint32_t onSign(
+    uint32_t        sessionId,
+    tciMessage_ptr  pTci
+){
+    const uint8_t*  key;
+    const uint8_t*  plain;
+    uint8_t*        sig;
+    uint32_t        sum;
+    uint32_t        i;
+
+    key = mcMockResolve(sessionId, pTci->rsa_sign.key_data, pTci->rsa_sign.key_data_len);
+    plain = mcMockResolve(sessionId, pTci->rsa_sign.plain_data, pTci->rsa_sign.plain_data_len);
+    sig = mcMockResolve(sessionId, pTci->rsa_sign.signature_data, BENCH_SIG_SIZE);
+    if ((key == NULL) || (plain == NULL) || (sig == NULL) ||
+        (pTci->rsa_sign.signature_data_len < BENCH_SIG_SIZE))
+    {
+        return RET_ERR_SIGN;
+    }
+
+    sum = checksum(key, pTci->rsa_sign.key_data_len) ^
+          checksum(plain, pTci->rsa_sign.plain_data_len);
+    for (i = 0; i < BENCH_SIG_SIZE; i += sizeof(sum))
+    {
+        memcpy(sig + i, &sum, sizeof(sum));
+    }
+    pTci->rsa_sign.signature_data_len = BENCH_SIG_SIZE;
+    gSignKey = key;
+    return RET_OK;
+}
+
+
+/**
+ * Simulated trusted application: signs as onSign() does, and reads the
+ * whole plain data buffer of an RSA verify, as the real one does while
+ * hashing it.
+ */
+static mcResult_t onNotify(
+    void*       ctx,
+    uint32_t    sessionId,
+    uint8_t*    tci,
+    uint32_t    tciLen
+){
+    tciMessage_ptr  pTci = (tciMessage_ptr)tci;
+    const uint8_t*  plain;
+
+    (void)ctx;
+    (void)tciLen;
+
+    if (pTci->command.header.commandId == CMD_ID_TEE_RSA_SIGN)
+    {
+        pTci->response.header.responseId = RSP_ID(CMD_ID_TEE_RSA_SIGN);
+        pTci->response.header.returnCode = onSign(sessionId, pTci);
+        return MC_DRV_OK;
+    }
+
+    if (pTci->command.header.commandId != CMD_ID_TEE_RSA_VERIFY)
+    {
+        pTci->response.header.responseId = RSP_ID(pTci->command.header.commandId);
+        pTci->response.header.returnCode = RET_ERR_UNKNOWN_CMD;
+        return MC_DRV_OK;
+    }
+
+    plain = mcMockResolve(sessionId, pTci->rsa_verify.plain_data,
+                          pTci->rsa_verify.plain_data_len);
+    pTci->rsa_verify.validity = (plain != NULL) &&
+            (checksum(plain, pTci->rsa_verify.plain_data_len) == gExpected);
+
+    pTci->response.header.responseId = RSP_ID(CMD_ID_TEE_RSA_VERIFY);
+    pTci->response.header.returnCode = RET_OK;
+    return MC_DRV_OK;
+}
+
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/**
+ * One RSA sign the way the TLC did it before the session was kept: open
+ * the device and a session, map every buffer, notify, then undo it all.
+ */
+static bool sign_own_session(
+    uint8_t*    key,
+    uint32_t    keyLen,
+    uint8_t*    digest,
+    uint8_t*    sig,
+    uint32_t*   sigLen
+){
+    mcSessionHandle_t   session;
+    tciMessage_ptr      pTci = NULL;
+    mcBulkMap_t         keyMap = {0};
+    mcBulkMap_t         digestMap = {0};
+    mcBulkMap_t         sigMap = {0};
+    bool                ok = false;
+
+    memset(&session, 0, sizeof(session));
+    session.deviceId = MC_DEVICE_ID_DEFAULT;
+    if (mcOpenDevice(MC_DEVICE_ID_DEFAULT) != MC_DRV_OK)
+    {
+        return false;
+    }
+
+    if ((mcMallocWsm(MC_DEVICE_ID_DEFAULT, 0, sizeof(tciMessage_t), (uint8_t**)&pTci, 0) == MC_DRV_OK) &&
+        (mcOpenSession(&session, &gUuid, (uint8_t*)pTci, sizeof(tciMessage_t)) == MC_DRV_OK))
+    {
+        if ((mcMap(&session, key, keyLen, &keyMap) == MC_DRV_OK) &&
+            (mcMap(&session, digest, BENCH_DIGEST_SIZE, &digestMap) == MC_DRV_OK) &&
+            (mcMap(&session, sig, *sigLen, &sigMap) == MC_DRV_OK))
+        {
+            pTci->command.header.commandId    = CMD_ID_TEE_RSA_SIGN;
+            pTci->rsa_sign.key_data           = (uint32_t)keyMap.sVirtualAddr;
+            pTci->rsa_sign.plain_data         = (uint32_t)digestMap.sVirtualAddr;
+            pTci->rsa_sign.signature_data     = (uint32_t)sigMap.sVirtualAddr;
+            pTci->rsa_sign.key_data_len       = keyLen;
+            pTci->rsa_sign.plain_data_len     = BENCH_DIGEST_SIZE;
+            pTci->rsa_sign.signature_data_len = *sigLen;
+            pTci->rsa_sign.algorithm          = TEE_RSA_NODIGEST_NOPADDING;
+
+            ok = (mcNotify(&session) == MC_DRV_OK) &&
+                 (mcWaitNotification(&session, MC_INFINITE_TIMEOUT) == MC_DRV_OK) &&
+                 (pTci->response.header.returnCode == RET_OK);
+            *sigLen = pTci->rsa_sign.signature_data_len;
+        }
+        if (sigMap.sVirtualAddr != 0)
+        {
+            mcUnmap(&session, sig, &sigMap);
+        }
+        if (digestMap.sVirtualAddr != 0)
+        {
+            mcUnmap(&session, digest, &digestMap);
+        }
+        if (keyMap.sVirtualAddr != 0)
+        {
+            mcUnmap(&session, key, &keyMap);
+        }
+        mcCloseSession(&session);
+    }
+    if (pTci != NULL)
+    {
+        mcFreeWsm(MC_DEVICE_ID_DEFAULT, (uint8_t*)pTci);
+    }
+    mcCloseDevice(MC_DEVICE_ID_DEFAULT);
+
+    return ok;
+}
+
+
+/**
+ * Time iterations of an RSA sign of a digest with a key blob.
+ *
+ * @return signs per second, or -1 on failure
+ */
+static double bench_sign(
+    uint32_t    iterations,
+    bool        ownSession
+){
+    static uint8_t  key[BENCH_KEY_SIZE];
+    static uint8_t  digest[BENCH_DIGEST_SIZE];
+    static uint8_t  sig[BENCH_SIG_SIZE];
+    mcMockStats_t   stats;
+    uint32_t        sigLen;
+    uint64_t        start;
+    uint64_t        elapsed;
+    double          rate = -1;
+    bool            ok = true;
+    uint32_t        i;
+
+    for (i = 0; i < sizeof(key); i++)
+    {
+        key[i] = (uint8_t)(i * 13 + 1);
+    }
+
+    mcMockResetStats();
+    start = now_us();
+    for (i = 0; (i < iterations) && ok; i++)
+    {
+        digest[0] = (uint8_t)i;
+        sigLen = sizeof(sig);
+        if (ownSession)
+        {
+            ok = sign_own_session(key, sizeof(key), digest, sig, &sigLen);
+        }
+        else
+        {
+            ok = TEE_RSASign(key, sizeof(key), digest, sizeof(digest), sig, &sigLen,
+                             TEE_RSA_NODIGEST_NOPADDING) == TEE_ERR_NONE;
+        }
+        ok = ok && (sigLen == BENCH_SIG_SIZE);
+    }
+    elapsed = now_us() - start;
+    mcMockGetStats(&stats);
+
+    if (!ok)
+    {
+        fprintf(stderr, "RSA sign %u failed\n", i);
+        return -1;
+    }
+
+    /* The staging WSM stays mapped after the sign, and must not hold the key */
+    if (!ownSession)
+    {
+        for (i = 0; i < sizeof(key); i++)
+        {
+            if (gSignKey[i] != 0)
+            {
+                fprintf(stderr, "key blob left in the staging WSM\n");
+                return -1;
+            }
+        }
+    }
+
+    rate = elapsed > 0 ? iterations * 1e6 / elapsed : 0.0;
+    printf("%-16s %8u %12.1f %10.1f %8llu %8llu\n",
+           ownSession ? "session per sign" : "kept session", iterations,
+           (double)elapsed / iterations, rate,
+           (unsigned long long)stats.sessionsOpened, (unsigned long long)stats.maps);
+    return rate;
+}
+
+
+/**
+ * Time iterations of TEE_RSAVerify() over len bytes of read-only memory.
+ *
+ * @return mean time per call in microseconds, or -1 on failure
+ */
+static double bench_verify(
+    uint32_t    len,
+    uint32_t    iterations,
+    bool        inputMaps
+){
+    static uint8_t  key[BENCH_KEY_SIZE];
+    static uint8_t  sig[BENCH_SIG_SIZE];
+    mcMockStats_t   stats;
+    uint8_t*        plain;
+    uint64_t        start;
+    uint64_t        elapsed;
+    bool            validity = false;
+    double          mean = -1;
+    uint32_t        i;
+
+    plain = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (plain == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap of %u bytes failed: %s\n", len, strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < len; i++)
+    {
+        plain[i] = (uint8_t)(i * 31 + 7);
+    }
+    gExpected = checksum(plain, len);
+    mprotect(plain, len, PROT_READ);
+
+    mcMockResetStats();
+    start = now_us();
+    for (i = 0; i < iterations; i++)
+    {
+        if ((TEE_RSAVerify(key, sizeof(key), plain, len, sig, sizeof(sig),
+                           TEE_RSA_NODIGEST_NOPADDING, &validity) != TEE_ERR_NONE) ||
+            !validity)
+        {
+            fprintf(stderr, "TEE_RSAVerify() of %u bytes failed\n", len);
+            break;
+        }
+    }
+    elapsed = now_us() - start;
+    mcMockGetStats(&stats);
+
+    if (i == iterations)
+    {
+        mean = (double)elapsed / iterations;
+        printf("%-6s %9u %12.1f %10.1f %8llu\n",
+               inputMaps ? "map" : "copy", len, mean,
+               mean > 0 ? len / mean : 0.0,
+               (unsigned long long)stats.inputMaps);
+    }
+
+    munmap(plain, len);
+    return mean;
+}
+
+
+static void usage(
+    const char* prog
+){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -k <n>      timed signs (default %d)\n"
+        "  -o <us>     simulated TA load time per session open (default %d)\n"
+        "  -n <n>      timed calls per size (default 20)\n"
+        "  -s <bytes>  smallest input (default %d)\n"
+        "  -S <bytes>  largest input (default %d)\n"
+        "  -h          this help\n",
+        prog, BENCH_SIGNS, BENCH_OPEN_US, BENCH_MIN_SIZE, BENCH_MAX_SIZE);
+}
+
+
+int main(
+    int     argc,
+    char*   argv[]
+){
+    mcMockTa_t  ta;
+    uint32_t    signs = BENCH_SIGNS;
+    uint32_t    iterations = 20;
+    uint32_t    minSize = BENCH_MIN_SIZE;
+    uint32_t    maxSize = BENCH_MAX_SIZE;
+    uint32_t    len;
+    int         pass;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "k:o:n:s:S:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'k':
+                signs = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                gOpenUs = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                minSize = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                maxSize = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if ((signs == 0) || (iterations == 0) || (minSize == 0) || (minSize > maxSize))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&ta, 0, sizeof(ta));
+    ta.onNotify = onNotify;
+    ta.onOpen = onOpen;
+    if (mcMockRegisterTa(&gUuid, &ta) != MC_DRV_OK)
+    {
+        fprintf(stderr, "mcMockRegisterTa() failed\n");
+        return 1;
+    }
+
+    /* Before the TLC opens its session, which stays open to the end */
+    printf("%-16s %8s %12s %10s %8s %8s\n", "mode", "signs", "us/sign", "signs/s", "sessions", "maps");
+    if ((bench_sign(signs, true) < 0) || (bench_sign(signs, false) < 0))
+    {
+        return 1;
+    }
+    printf("\n");
+
+    printf("%-6s %9s %12s %10s %8s\n", "mode", "bytes", "us/call", "MB/s", "inputs");
+
+    /* The TLC stops trying input mappings once they fail, so copy comes last */
+    for (pass = 0; pass < 2; pass++)
+    {
+        mcMockSetInputMaps(pass == 0);
+        for (len = minSize; len <= maxSize; len *= 2)
+        {
+            if (bench_verify(len, iterations, pass == 0) < 0)
+            {
+                return 1;
+            }
+            if (len > maxSize / 2)
+            {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
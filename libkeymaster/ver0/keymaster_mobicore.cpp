@@ -898,13 +898,10 @@ static int km_rsa_sign_data(const void* params, const uint8_t* keyBlob,
 
     *signedDataLength = RSA_SIG_MAX_SIZE;
 
-    /* binder gives us read-only mappings we can't use with mobicore */
-    void *tmpData = malloc(dataLength);
-    memcpy(tmpData, data, dataLength);
-    ret = TEE_RSASign(keyBlob, (uint32_t)keyBlobLength, (const uint8_t *)tmpData,
+    /* the TLC stages read-only binder input into WSM itself */
+    ret = TEE_RSASign(keyBlob, (uint32_t)keyBlobLength, data,
 		dataLength, signedDataPtr.get(), (uint32_t *)signedDataLength,
 		TEE_RSA_NODIGEST_NOPADDING);
-    free(tmpData);
     if (ret != TEE_ERR_NONE) {
         ALOGE("TEE_RSASign() is failed: %d", ret);
         return -1;
@@ -937,12 +934,9 @@ static int km_dsa_sign_data(const void* params, const uint8_t* keyBlob,
 
     *signedDataLength = DSA_SIG_MAX_SIZE;
 
-    /* binder gives us read-only mappings we can't use with mobicore */
-    void *tmpData = malloc(dataLength);
-    memcpy(tmpData, data, dataLength);
-    ret = TEE_DSASign(keyBlob, keyBlobLength, (const uint8_t *)tmpData,
+    /* the TLC stages read-only binder input into WSM itself */
+    ret = TEE_DSASign(keyBlob, keyBlobLength, data,
 		dataLength, signedDataPtr.get(), (uint32_t *)signedDataLength);
-    free(tmpData);
     if (ret != TEE_ERR_NONE) {
         ALOGE("TEE_DSASign() is failed: %d", ret);
         return -1;
@@ -1014,12 +1008,9 @@ static int km_ecdsa_sign_data(const void* params, const uint8_t* keyBlob,
 
     *signedDataLength = ECDSA_SIG_MAX_SIZE;
 
-    /* binder gives us read-only mappings we can't use with mobicore */
-    void *tmpData = malloc(dataLength);
-    memcpy(tmpData, data, dataLength);
-    ret = TEE_ECDSASign(keyBlob, (uint32_t)keyBlobLength, (const uint8_t *)tmpData,
+    /* the TLC stages read-only binder input into WSM itself */
+    ret = TEE_ECDSASign(keyBlob, (uint32_t)keyBlobLength, data,
 			dataLength, signedDataPtr.get(), (uint32_t *)signedDataLength);
-    free(tmpData);
     if (ret != TEE_ERR_NONE) {
         ALOGE("TEE_ECDSASign() is failed: %d", ret);
         return -1;
@@ -1117,18 +1108,9 @@ static int km_rsa_verify_data(const void* params, const uint8_t* keyBlob,
         return -1;
     }
 
-    /* binder gives us read-only mappings we can't use with mobicore */
-    void *tmpSignedData = malloc(signedDataLength);
-    void *tmpSig = malloc(signatureLength);
-
-    memcpy(tmpSignedData, signedData, signedDataLength);
-    memcpy(tmpSig, signature, signatureLength);
-
-    ret = TEE_RSAVerify(keyBlob, keyBlobLength, (const uint8_t*)tmpSignedData, signedDataLength, (const uint8_t *)tmpSig,
+    /* the TLC maps read-only binder input itself */
+    ret = TEE_RSAVerify(keyBlob, keyBlobLength, signedData, signedDataLength, signature,
 			signatureLength, TEE_RSA_NODIGEST_NOPADDING, result);
-
-    free(tmpSignedData);
-    free(tmpSig);
     if (ret != TEE_ERR_NONE) {
         ALOGE("TEE_RSAVerify() is failed: %d", ret);
         return -1;
@@ -1149,20 +1131,6 @@ static int km_dsa_verify_data(const void* params, const uint8_t* keyBlob,
         return -1;
     }
 
-    UniquePtr<uint8_t, Malloc_Free> tmpData(reinterpret_cast<uint8_t*>(malloc(signedDataLength)));
-    if (tmpData.get() == NULL) {
-        ALOGE("memory allocation is failed");
-        return -1;
-    }
-    memcpy(tmpData.get(), signedData, signedDataLength);
-
-    UniquePtr<uint8_t, Malloc_Free> encSig(reinterpret_cast<uint8_t*>(malloc(signatureLength)));
-    if (encSig.get() == NULL) {
-        ALOGE("memory allocation is failed");
-        return -1;
-    }
-    memcpy(encSig.get(), signature, signatureLength);
-
     /* Decodes a DER encoded signature */
     DSA_SIG *s = DSA_SIG_new();
     if (!s) {
@@ -1170,8 +1138,8 @@ static int km_dsa_verify_data(const void* params, const uint8_t* keyBlob,
 	return -1;
     }
 
-    uint8_t *tmpEncSig = encSig.get();
-    if (!d2i_DSA_SIG(&s, (const unsigned char**)&tmpEncSig, signatureLength)) {
+    const unsigned char *encSig = signature;
+    if (!d2i_DSA_SIG(&s, &encSig, signatureLength)) {
 	ALOGE("failed to decodes a signature");
 	return -1;
     }
@@ -1186,7 +1154,8 @@ static int km_dsa_verify_data(const void* params, const uint8_t* keyBlob,
     rlen = BN_bn2bin(s->r, sig.get());
     slen = BN_bn2bin(s->s, sig.get() + rlen);
 
-    ret = TEE_DSAVerify(keyBlob, keyBlobLength, (const uint8_t*)tmpData.get(),
+    /* the TLC maps read-only binder input itself */
+    ret = TEE_DSAVerify(keyBlob, keyBlobLength, signedData,
 			signedDataLength, (const uint8_t *)sig.get(),
 			rlen + slen, result);
     if (ret != TEE_ERR_NONE) {
@@ -1209,20 +1178,6 @@ static int km_ecdsa_verify_data(const void* params, const uint8_t* keyBlob,
         return -1;
     }
 
-    UniquePtr<uint8_t, Malloc_Free> tmpData(reinterpret_cast<uint8_t*>(malloc(signedDataLength)));
-    if (tmpData.get() == NULL) {
-        ALOGE("memory allocation is failed");
-        return -1;
-    }
-    memcpy(tmpData.get(), signedData, signedDataLength);
-
-    UniquePtr<uint8_t, Malloc_Free> encSig(reinterpret_cast<uint8_t*>(malloc(signatureLength)));
-    if (encSig.get() == NULL) {
-        ALOGE("memory allocation is failed");
-        return -1;
-    }
-    memcpy(encSig.get(), signature, signatureLength);
-
     /* Decodes a DER encoded signature */
     ECDSA_SIG *s = ECDSA_SIG_new();
     if (!s) {
@@ -1230,8 +1185,8 @@ static int km_ecdsa_verify_data(const void* params, const uint8_t* keyBlob,
 	return -1;
     }
 
-    uint8_t *tmpEncSig = encSig.get();
-    if (!d2i_ECDSA_SIG(&s, (const unsigned char**)&tmpEncSig, signatureLength)) {
+    const unsigned char *encSig = signature;
+    if (!d2i_ECDSA_SIG(&s, &encSig, signatureLength)) {
 	ALOGE("failed to decodes a signature");
 	return -1;
     }
@@ -1246,7 +1201,8 @@ static int km_ecdsa_verify_data(const void* params, const uint8_t* keyBlob,
     rlen = BN_bn2bin(s->r, sig.get());
     slen = BN_bn2bin(s->s, sig.get() + rlen);
 
-    ret = TEE_ECDSAVerify(keyBlob, keyBlobLength, (const uint8_t*)tmpData.get(),
+    /* the TLC maps read-only binder input itself */
+    ret = TEE_ECDSAVerify(keyBlob, keyBlobLength, signedData,
 			signedDataLength, (const uint8_t *)sig.get(),
 			rlen + slen, result);
     if (ret != TEE_ERR_NONE) {
@@ -29,8 +29,10 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "MobiCoreDriverApi.h"
 #include "tlTeeKeymaster_Api.h"
@@ -45,30 +47,112 @@ static const __attribute__((used)) char* buildtag = MOBICORE_COMPONENT_BUILD_TAG
 static const uint32_t gDeviceId = MC_DEVICE_ID_DEFAULT;
 static const mcUuid_t gUuid = TEE_KEYMASTER_TL_UUID;
 
+/* Size of the WSM staging area small bulk buffers are copied into */
+#define TEE_STAGING_SIZE        (16 * 1024)
+#define TEE_STAGING_ALIGN       8
+/* Maximum number of bulk buffers a single command passes */
+#define TEE_MAX_BULK_BUFFERS    4
+
+/* Input buffer copied to a writable heap buffer before it is mapped */
+typedef struct {
+    const void* orig;
+    void*       copy;
+} teeBounce_t;
+
+/*
+ * The session to the trusted application is opened on first use and kept
+ * for the lifetime of the process. gSessionLock serialises commands and is
+ * held from TEE_Open() until the matching TEE_Close().
+ */
+static pthread_mutex_t      gSessionLock = PTHREAD_MUTEX_INITIALIZER;
+static mcSessionHandle_t    gSessionHandle;
+static tciMessage_ptr       gTci = NULL;
+static uint8_t*             gStaging = NULL;
+static mcBulkMap_t          gStagingMapInfo;
+static uint32_t             gStagingUsed = 0;
+static teeBounce_t          gBounce[TEE_MAX_BULK_BUFFERS];
+/* Cleared once the kernel module turns out not to know mcMapInput() registrations */
+static bool                 gMapInput = true;
+
+
 /**
- * TEE_Open
+ * TEE_WipeStagingLocked
  *
- * Open session to the TEE Keymaster trusted application
+ * Clear the part of the staging area the last command used. It held key
+ * blobs and plain data in the clear, and the WSM outlives the command.
+ * Called with gSessionLock held.
+ */
+static void TEE_WipeStagingLocked(void)
+{
+    if (gStaging != NULL)
+    {
+        memset(gStaging, 0, gStagingUsed);
+    }
+    gStagingUsed = 0;
+}
+
+
+/**
+ * TEE_CloseSessionLocked
  *
- * @param  pSessionHandle  [out] Return pointer to the session handle
+ * Tear down the cached session, TCI and staging buffer. Called with
+ * gSessionLock held.
  */
-static tciMessage_ptr TEE_Open(
-    mcSessionHandle_t *pSessionHandle
-){
-    tciMessage_ptr pTci = NULL;
-    mcResult_t     mcRet;
+static void TEE_CloseSessionLocked(void)
+{
+    mcResult_t    mcRet;
 
-    do
+    TEE_WipeStagingLocked();
+
+    if (gStagingMapInfo.sVirtualAddr != 0)
     {
-        /* Validate session handle */
-        if (pSessionHandle == NULL)
+        mcRet = mcUnmap(&gSessionHandle, gStaging, &gStagingMapInfo);
+        if (MC_DRV_OK != mcRet)
         {
-            LOG_E("TEE_Open(): Invalid session handle\n");
-            break;
+            LOG_E("TEE_CloseSessionLocked(): mcUnmap returned: %d\n", mcRet);
         }
+    }
 
-        /* Initialize session handle data */
-        memset(pSessionHandle, 0, sizeof(mcSessionHandle_t));
+    if (gTci != NULL)
+    {
+        mcRet = mcCloseSession(&gSessionHandle);
+        if (MC_DRV_OK != mcRet)
+        {
+            LOG_E("TEE_CloseSessionLocked(): mcCloseSession returned: %d\n", mcRet);
+        }
+    }
+
+    /* Closing the device also releases any WSM still allocated */
+    mcRet = mcCloseDevice(gDeviceId);
+    if (MC_DRV_OK != mcRet)
+    {
+        LOG_E("TEE_CloseSessionLocked(): mcCloseDevice returned: %d\n", mcRet);
+    }
+
+    memset(&gSessionHandle, 0, sizeof(gSessionHandle));
+    memset(&gStagingMapInfo, 0, sizeof(gStagingMapInfo));
+    gTci = NULL;
+    gStaging = NULL;
+}
+
+
+/**
+ * TEE_OpenSessionLocked
+ *
+ * Open the device, allocate TCI and staging WSM, open the session and map
+ * the staging buffer once. Called with gSessionLock held.
+ *
+ * @return MC_DRV_OK on success
+ */
+static mcResult_t TEE_OpenSessionLocked(void)
+{
+    tciMessage_ptr pTci = NULL;
+    mcResult_t     mcRet;
+
+    do
+    {
+        memset(&gSessionHandle, 0, sizeof(gSessionHandle));
+        memset(&gStagingMapInfo, 0, sizeof(gStagingMapInfo));
 
         /* Open MobiCore device */
         mcRet = mcOpenDevice(gDeviceId);
@@ -76,7 +160,7 @@ static tciMessage_ptr TEE_Open(
             (MC_DRV_ERR_DEVICE_ALREADY_OPEN != mcRet))
         {
             LOG_E("TEE_Open(): mcOpenDevice returned: %d\n", mcRet);
-            break;
+            return mcRet;
         }
 
         /* Allocating WSM for TCI */
@@ -87,9 +171,18 @@ static tciMessage_ptr TEE_Open(
             break;
         }
 
+        /* Allocating WSM for the bulk staging area */
+        mcRet = mcMallocWsm(gDeviceId, 0, TEE_STAGING_SIZE, &gStaging, 0);
+        if (MC_DRV_OK != mcRet)
+        {
+            LOG_E("TEE_Open(): mcMallocWsm (staging) returned: %d\n", mcRet);
+            gStaging = NULL;
+            break;
+        }
+
         /* Open session the TEE Keymaster trusted application */
-        pSessionHandle->deviceId = gDeviceId;
-        mcRet = mcOpenSession(pSessionHandle,
+        gSessionHandle.deviceId = gDeviceId;
+        mcRet = mcOpenSession(&gSessionHandle,
                               &gUuid,
                               (uint8_t *) pTci,
                               (uint32_t) sizeof(tciMessage_t));
@@ -98,52 +191,233 @@ static tciMessage_ptr TEE_Open(
             LOG_E("TEE_Open(): mcOpenSession returned: %d\n", mcRet);
             break;
         }
+        gTci = pTci;
+
+        /* Map the staging area once for the lifetime of the session */
+        mcRet = mcMap(&gSessionHandle, gStaging, TEE_STAGING_SIZE, &gStagingMapInfo);
+        if (MC_DRV_OK != mcRet)
+        {
+            LOG_E("TEE_Open(): mcMap (staging) returned: %d\n", mcRet);
+            memset(&gStagingMapInfo, 0, sizeof(gStagingMapInfo));
+            break;
+        }
+
+        return MC_DRV_OK;
 
     } while (false);
 
-    LOG_I("TEE_Open(): returning pointer to TCI buffer: 0x%p\n", pTci);
+    TEE_CloseSessionLocked();
 
-    return pTci;
+    return mcRet;
+}
+
+
+/**
+ * TEE_Open
+ *
+ * Acquire the session to the TEE Keymaster trusted application, opening it
+ * if needed. On success the session lock is held until TEE_Close().
+ *
+ * @param  pSessionHandle  [out] Return pointer to the session handle
+ */
+static tciMessage_ptr TEE_Open(
+    mcSessionHandle_t *pSessionHandle
+){
+    /* Validate session handle */
+    if (pSessionHandle == NULL)
+    {
+        LOG_E("TEE_Open(): Invalid session handle\n");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&gSessionLock);
+
+    if ((gTci == NULL) && (MC_DRV_OK != TEE_OpenSessionLocked()))
+    {
+        pthread_mutex_unlock(&gSessionLock);
+        memset(pSessionHandle, 0, sizeof(mcSessionHandle_t));
+        return NULL;
+    }
+
+    *pSessionHandle = gSessionHandle;
+    memset(gBounce, 0, sizeof(gBounce));
+
+    return gTci;
 }
 
 
 /**
  * TEE_Close
  *
- * Close session to the TEE Keymaster trusted application
+ * Release the session acquired by TEE_Open(). The staging area is wiped,
+ * and the session stays open for the next command unless the notification
+ * path failed, in which case it is torn down and reopened on next use.
  *
- * @param  sessionHandle  [in] Session handle
+ * @param  pTci    [in] TCI buffer returned by TEE_Open(), may be NULL
+ * @param  result  [in] Result of the command; unmap failures never replace
+ *                      an earlier error, so a notification failure gets here
  */
 static void TEE_Close(
-    mcSessionHandle_t *pSessionHandle
+    tciMessage_ptr pTci,
+    teeResult_t    result
 ){
-    mcResult_t    mcRet;
+    if (pTci == NULL)
+    {
+        return;
+    }
 
-    do
+    if (result == TEE_ERR_NOTIFICATION)
+    {
+        LOG_E("TEE_Close(): dropping session after notification failure\n");
+        TEE_CloseSessionLocked();
+    }
+    else
+    {
+        TEE_WipeStagingLocked();
+    }
+
+    pthread_mutex_unlock(&gSessionLock);
+}
+
+
+/**
+ * TEE_MapBulk
+ *
+ * Make a buffer visible to the trusted application. Buffers that fit in the
+ * remaining staging area are copied into it and need no mcMap(). Larger
+ * input buffers are mapped in place with mcMapInput(), which accepts the
+ * read-only memory callers may hand in. If that fails they are copied to
+ * a heap buffer first, for the rest of the process if the kernel module
+ * does not know the request and for this buffer only otherwise. Larger
+ * output buffers are mapped directly.
+ *
+ * @param  pSessionHandle  [in]  Session handle
+ * @param  buf             [in]  Buffer
+ * @param  len             [in]  Buffer length
+ * @param  pMapInfo        [out] Secure world mapping of the buffer
+ * @param  output          [in]  The trusted application writes to the buffer
+ */
+static mcResult_t TEE_MapBulk(
+    mcSessionHandle_t *pSessionHandle,
+    const void*        buf,
+    uint32_t           len,
+    mcBulkMap_t*       pMapInfo,
+    bool               output
+){
+    uint32_t     aligned = (len + TEE_STAGING_ALIGN - 1) & ~(TEE_STAGING_ALIGN - 1);
+    mcResult_t   mcRet;
+    int          i;
+
+    if ((aligned >= len) && (aligned <= TEE_STAGING_SIZE - gStagingUsed))
+    {
+        memcpy(gStaging + gStagingUsed, buf, len);
+        pMapInfo->sVirtualAddr = (uint8_t*)gStagingMapInfo.sVirtualAddr + gStagingUsed;
+        pMapInfo->sVirtualLen  = len;
+        gStagingUsed += aligned;
+        return MC_DRV_OK;
+    }
+
+    if (output)
+    {
+        return mcMap(pSessionHandle, (void*)buf, len, pMapInfo);
+    }
+
+    if (gMapInput)
     {
-        /* Validate session handle */
-        if (pSessionHandle == NULL)
+        mcRet = mcMapInput(pSessionHandle, buf, len, pMapInfo);
+        if (MC_DRV_OK == mcRet)
         {
-            LOG_E("TEE_Close(): Invalid session handle\n");
-            break;
+            return MC_DRV_OK;
+        }
+        if ((MC_DRV_ERROR_MAJOR(mcRet) == MC_DRV_ERR_KERNEL_MODULE) &&
+            (MC_DRV_ERROR_DETAIL(mcRet) == ENOTTY))
+        {
+            LOG_I("TEE_MapBulk(): input mappings unavailable (%x), copying input buffers\n", mcRet);
+            gMapInput = false;
         }
+        else
+        {
+            LOG_W("TEE_MapBulk(): mcMapInput returned: %x, copying this buffer\n", mcRet);
+        }
+    }
 
-        /* Close session */
-        mcRet = mcCloseSession(pSessionHandle);
-        if (MC_DRV_OK != mcRet)
+    for (i = 0; i < TEE_MAX_BULK_BUFFERS; i++)
+    {
+        if (gBounce[i].copy == NULL)
         {
-            LOG_E("TEE_Close(): mcCloseSession returned: %d\n", mcRet);
             break;
         }
+    }
+    if (i == TEE_MAX_BULK_BUFFERS)
+    {
+        return MC_DRV_ERR_NO_FREE_MEMORY;
+    }
 
-        /* Close MobiCore device */
-        mcRet = mcCloseDevice(gDeviceId);
-        if (MC_DRV_OK != mcRet)
+    gBounce[i].copy = malloc(len);
+    if (gBounce[i].copy == NULL)
+    {
+        return MC_DRV_ERR_NO_FREE_MEMORY;
+    }
+    memcpy(gBounce[i].copy, buf, len);
+
+    mcRet = mcMap(pSessionHandle, gBounce[i].copy, len, pMapInfo);
+    if (MC_DRV_OK != mcRet)
+    {
+        memset(gBounce[i].copy, 0, len);
+        free(gBounce[i].copy);
+        gBounce[i].copy = NULL;
+        return mcRet;
+    }
+    gBounce[i].orig = buf;
+
+    return MC_DRV_OK;
+}
+
+
+/**
+ * TEE_UnmapBulk
+ *
+ * Undo TEE_MapBulk(), copying staged output back to the caller's buffer.
+ *
+ * @param  pSessionHandle  [in] Session handle
+ * @param  buf             [in] Buffer passed to TEE_MapBulk()
+ * @param  pMapInfo        [in] Secure world mapping of the buffer
+ * @param  output          [in] The trusted application writes to the buffer
+ */
+static mcResult_t TEE_UnmapBulk(
+    mcSessionHandle_t *pSessionHandle,
+    void*              buf,
+    mcBulkMap_t*       pMapInfo,
+    bool               output
+){
+    uint8_t*     base = (uint8_t*)gStagingMapInfo.sVirtualAddr;
+    uint8_t*     addr = (uint8_t*)pMapInfo->sVirtualAddr;
+    mcResult_t   mcRet;
+    int          i;
+
+    if ((base != NULL) && (addr >= base) && (addr < base + TEE_STAGING_SIZE))
+    {
+        if (output)
         {
-            LOG_E("TEE_Close(): mcCloseDevice returned: %d\n", mcRet);
+            memcpy(buf, gStaging + (addr - base), pMapInfo->sVirtualLen);
         }
+        return MC_DRV_OK;
+    }
 
-    } while (false);
+    for (i = 0; i < TEE_MAX_BULK_BUFFERS; i++)
+    {
+        if ((gBounce[i].copy != NULL) && (gBounce[i].orig == buf))
+        {
+            mcRet = mcUnmap(pSessionHandle, gBounce[i].copy, pMapInfo);
+            memset(gBounce[i].copy, 0, pMapInfo->sVirtualLen);
+            free(gBounce[i].copy);
+            gBounce[i].copy = NULL;
+            gBounce[i].orig = NULL;
+            return mcRet;
+        }
+    }
+
+    return mcUnmap(pSessionHandle, buf, pMapInfo);
 }
 
 
@@ -198,7 +472,7 @@ teeResult_t TEE_RSAGenerateKeyPair(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, keyData, keyDataLength, &mapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &mapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -247,15 +521,15 @@ teeResult_t TEE_RSAGenerateKeyPair(
     /* Unmap memory */
     if (mapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, keyData, &mapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, keyData, &mapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -311,21 +585,21 @@ teeResult_t TEE_RSASign(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)plainData, plainDataLength, &plainMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, plainData, plainDataLength, &plainMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, *signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, *signatureDataLength, &signatureMapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -373,8 +647,8 @@ teeResult_t TEE_RSASign(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -382,8 +656,8 @@ teeResult_t TEE_RSASign(
 
     if (plainMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)plainData, &plainMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)plainData, &plainMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -391,15 +665,15 @@ teeResult_t TEE_RSASign(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -457,21 +731,21 @@ teeResult_t TEE_RSAVerify(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)plainData, plainDataLength, &plainMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, plainData, plainDataLength, &plainMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, signatureDataLength, &signatureMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -520,8 +794,8 @@ teeResult_t TEE_RSAVerify(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -529,8 +803,8 @@ teeResult_t TEE_RSAVerify(
 
     if (plainMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)plainData, &plainMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)plainData, &plainMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -538,15 +812,15 @@ teeResult_t TEE_RSAVerify(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -626,14 +900,14 @@ teeResult_t TEE_KeyImport(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)soData, *soDataLength, &soMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, soData, *soDataLength, &soMapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -678,8 +952,8 @@ teeResult_t TEE_KeyImport(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -687,15 +961,15 @@ teeResult_t TEE_KeyImport(
 
     if (soMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)soData, &soMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)soData, &soMapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -752,14 +1026,14 @@ teeResult_t TEE_GetPubKey(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)pubKeyData, *pubKeyDataLength, &pubKeyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, pubKeyData, *pubKeyDataLength, &pubKeyMapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -805,8 +1079,8 @@ teeResult_t TEE_GetPubKey(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -814,15 +1088,15 @@ teeResult_t TEE_GetPubKey(
 
     if (pubKeyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)pubKeyData, &pubKeyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)pubKeyData, &pubKeyMapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -877,7 +1151,7 @@ teeResult_t TEE_DSAGenerateKeyPair(
         }
 
         /* Map key data buffer to the secure world */
-        mcRet = mcMap(&sessionHandle, keyData, keyDataLength, &keyDataInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyDataInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -885,7 +1159,7 @@ teeResult_t TEE_DSAGenerateKeyPair(
         }
 
         /* Map p buffer to the secure world */
-        mcRet = mcMap(&sessionHandle, params->p, params->pLen, &pInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, params->p, params->pLen, &pInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -893,7 +1167,7 @@ teeResult_t TEE_DSAGenerateKeyPair(
         }
 
         /* Map q buffer to the secure world */
-        mcRet = mcMap(&sessionHandle, params->q, params->qLen, &qInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, params->q, params->qLen, &qInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -901,7 +1175,7 @@ teeResult_t TEE_DSAGenerateKeyPair(
         }
 
         /* Map g buffer to the secure world */
-        mcRet = mcMap(&sessionHandle, params->g, params->gLen, &gInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, params->g, params->gLen, &gInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -952,8 +1226,8 @@ teeResult_t TEE_DSAGenerateKeyPair(
     /* Unmap key data buffer memory */
     if (keyDataInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, keyData, &keyDataInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, keyData, &keyDataInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -961,8 +1235,8 @@ teeResult_t TEE_DSAGenerateKeyPair(
     /* Unmap p buffer */
     if (pInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, params->p, &pInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, params->p, &pInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -971,8 +1245,8 @@ teeResult_t TEE_DSAGenerateKeyPair(
     /* Unmap q buffer */
     if (qInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, params->q, &qInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, params->q, &qInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -981,15 +1255,15 @@ teeResult_t TEE_DSAGenerateKeyPair(
     /* Unmap g buffer */
     if (gInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, params->g, &gInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, params->g, &gInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -1043,21 +1317,21 @@ teeResult_t TEE_DSASign(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)digest, digestLength, &digestMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, digest, digestLength, &digestMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, *signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, *signatureDataLength, &signatureMapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1104,8 +1378,8 @@ teeResult_t TEE_DSASign(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1113,8 +1387,8 @@ teeResult_t TEE_DSASign(
 
     if (digestMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)digest, &digestMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)digest, &digestMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1122,15 +1396,15 @@ teeResult_t TEE_DSASign(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -1186,21 +1460,21 @@ teeResult_t TEE_DSAVerify(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)digest, digestLen, &digestMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, digest, digestLen, &digestMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, signatureDataLength, &signatureMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1247,8 +1521,8 @@ teeResult_t TEE_DSAVerify(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1256,8 +1530,8 @@ teeResult_t TEE_DSAVerify(
 
     if (digestMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)digest, &digestMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)digest, &digestMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1265,15 +1539,15 @@ teeResult_t TEE_DSAVerify(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -1318,7 +1592,7 @@ teeResult_t TEE_ECDSAGenerateKeyPair(
         }
 
         /* Map key data buffer to the secure world */
-        mcRet = mcMap(&sessionHandle, keyData, keyDataLength, &keyDataInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyDataInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1361,15 +1635,15 @@ teeResult_t TEE_ECDSAGenerateKeyPair(
     /* Unmap key data buffer */
     if (keyDataInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, keyData, &keyDataInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, keyData, &keyDataInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 
@@ -1424,21 +1698,21 @@ teeResult_t TEE_ECDSASign(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)digest, digestLength, &digestMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, digest, digestLength, &digestMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, *signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, *signatureDataLength, &signatureMapInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1487,8 +1761,8 @@ teeResult_t TEE_ECDSASign(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1496,8 +1770,8 @@ teeResult_t TEE_ECDSASign(
 
     if (digestMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)digest, &digestMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)digest, &digestMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1505,15 +1779,15 @@ teeResult_t TEE_ECDSASign(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -1569,21 +1843,21 @@ teeResult_t TEE_ECDSAVerify(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyData, keyDataLength, &keyMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyData, keyDataLength, &keyMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)digest, digestLen, &digestMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, digest, digestLen, &digestMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)signatureData, signatureDataLength, &signatureMapInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, signatureData, signatureDataLength, &signatureMapInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1630,8 +1904,8 @@ teeResult_t TEE_ECDSAVerify(
     /* Unmap memory */
     if (keyMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyData, &keyMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyData, &keyMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1639,8 +1913,8 @@ teeResult_t TEE_ECDSAVerify(
 
     if (digestMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)digest, &digestMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)digest, &digestMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1648,15 +1922,15 @@ teeResult_t TEE_ECDSAVerify(
 
     if (signatureMapInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)signatureData, &signatureMapInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)signatureData, &signatureMapInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
@@ -1701,14 +1975,14 @@ teeResult_t TEE_GetKeyInfo(
         }
 
         /* Map memory to the secure world */
-        mcRet = mcMap(&sessionHandle, (void*)keyBlob, keyBlobLength, &keyBlobInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, keyBlob, keyBlobLength, &keyBlobInfo, false);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
             break;
         }
 
-        mcRet = mcMap(&sessionHandle, (void*)metadata, sizeof(teeKeyMeta_t), &keyDataInfo);
+        mcRet = TEE_MapBulk(&sessionHandle, metadata, sizeof(teeKeyMeta_t), &keyDataInfo, true);
         if (MC_DRV_OK != mcRet)
         {
             ret = TEE_ERR_MAP;
@@ -1748,8 +2022,8 @@ teeResult_t TEE_GetKeyInfo(
 
     if (keyBlobInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)keyBlob, &keyBlobInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)keyBlob, &keyBlobInfo, false);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
@@ -1757,15 +2031,15 @@ teeResult_t TEE_GetKeyInfo(
 
     if (keyDataInfo.sVirtualAddr != 0)
     {
-        mcRet = mcUnmap(&sessionHandle, (void*)metadata, &keyDataInfo);
-        if (MC_DRV_OK != mcRet)
+        mcRet = TEE_UnmapBulk(&sessionHandle, (void*)metadata, &keyDataInfo, true);
+        if ((MC_DRV_OK != mcRet) && (TEE_ERR_NONE == ret))
         {
             ret = TEE_ERR_UNMAP;
         }
     }
 
     /* Close session to the trusted application */
-    TEE_Close(&sessionHandle);
+    TEE_Close(pTci, ret);
 
     return ret;
 }
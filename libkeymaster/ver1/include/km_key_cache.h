@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __KM_KEY_CACHE_H__
+#define __KM_KEY_CACHE_H__
+
+#include <pthread.h>
+#include <hardware/keymaster_defs.h>
+
+/* Maximum number of cached keys */
+#define KM_KEY_CACHE_ENTRIES    32
+/* Maximum number of bytes held by the cache */
+#define KM_KEY_CACHE_MAX_BYTES  (64 * 1024)
+
+#define KM_KEY_CACHE_DIGEST_SIZE 32
+
+/**
+ * Cache of key characteristics and X.509 public key exports.
+ *
+ * Entries are keyed by a SHA-256 digest over (key blob, client_id,
+ * app_data), so no application secrets are kept in memory. Lookups return
+ * deep copies owned by the caller; the least recently used entry is evicted
+ * when either limit is reached.
+ */
+class TeeKeyCache {
+  public:
+    TeeKeyCache();
+
+    ~TeeKeyCache();
+
+    bool get_characteristics(
+                        const keymaster_key_blob_t*     key_blob,
+                        const keymaster_blob_t*         client_id,
+                        const keymaster_blob_t*         app_data,
+                        keymaster_key_characteristics_t** characteristics);
+
+    void put_characteristics(
+                        const keymaster_key_blob_t*     key_blob,
+                        const keymaster_blob_t*         client_id,
+                        const keymaster_blob_t*         app_data,
+                        const keymaster_key_characteristics_t* characteristics);
+
+    bool get_export(
+                        const keymaster_key_blob_t*     key_blob,
+                        const keymaster_blob_t*         client_id,
+                        const keymaster_blob_t*         app_data,
+                        keymaster_blob_t*               export_data);
+
+    void put_export(
+                        const keymaster_key_blob_t*     key_blob,
+                        const keymaster_blob_t*         client_id,
+                        const keymaster_blob_t*         app_data,
+                        const keymaster_blob_t*         export_data);
+
+    /**
+     * Drop every entry derived from \p key_blob, whatever the client_id and
+     * app_data it was looked up with.
+     */
+    void invalidate(
+                        const keymaster_key_blob_t*     key_blob);
+
+    /**
+     * Drop all entries.
+     */
+    void invalidate_all();
+
+  private:
+    struct entry_t {
+        uint8_t                         digest[KM_KEY_CACHE_DIGEST_SIZE];
+        uint8_t                         blob_digest[KM_KEY_CACHE_DIGEST_SIZE];
+        bool                            used;
+        keymaster_key_characteristics_t* characteristics;
+        size_t                          characteristics_bytes;
+        keymaster_blob_t                export_data;
+        uint64_t                        last_use;
+    };
+
+    entry_t* find_locked(const uint8_t* digest);
+    entry_t* insert_locked(const uint8_t* digest, const uint8_t* blob_digest);
+    void clear_locked(entry_t* entry);
+    void trim_locked(entry_t* keep);
+
+    // Class is non-copyable
+    TeeKeyCache(const TeeKeyCache&);
+    TeeKeyCache& operator=(const TeeKeyCache&);
+
+    entry_t         entries_[KM_KEY_CACHE_ENTRIES];
+    size_t          bytes_;
+    uint64_t        clock_;
+    pthread_mutex_t lock_;
+};
+
+#endif /* __KM_KEY_CACHE_H__ */
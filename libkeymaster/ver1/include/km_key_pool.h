@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __KM_KEY_POOL_H__
+#define __KM_KEY_POOL_H__
+
+#include <pthread.h>
+#include <hardware/keymaster_defs.h>
+
+/* Maximum number of (algorithm, key size, exponent) shapes in the pool */
+#define KM_KEY_POOL_SHAPES      8
+/* Maximum number of keys held per shape */
+#define KM_KEY_POOL_MAX_DEPTH   8
+/* Wait before retrying when the TA is busy with callers */
+#define KM_KEY_POOL_RETRY_MS    200
+/* Wait before retrying after the TA failed to generate a key */
+#define KM_KEY_POOL_ERROR_MS    5000
+
+typedef struct {
+    uint32_t hits;          /* generate_key() served from the pool */
+    uint32_t misses;        /* generate_key() of a pooled shape that found it empty */
+    uint64_t hit_us;        /* total latency of hits */
+    uint64_t miss_us;       /* total latency of misses */
+    uint32_t available;     /* unbound keys ready now */
+    uint32_t capacity;      /* sum of the configured depths */
+} km_key_pool_stats_t;
+
+/**
+ * Pool of unbound RSA and EC keys generated ahead of need.
+ *
+ * A background thread keeps up to a configured number of unbound key blobs
+ * per shape, calling the fill function whenever a shape is below its depth.
+ * take() hands a blob over to exactly one caller and forgets it, so key
+ * material is never given out twice.
+ */
+class TeeKeyPool {
+  public:
+    /**
+     * Generate one unbound key. Return KM_ERROR_SECURE_HW_BUSY to have the
+     * pool retry later without logging an error.
+     */
+    typedef keymaster_error_t (*fill_fn_t)(
+                        void*                           context,
+                        keymaster_algorithm_t           algorithm,
+                        uint32_t                        key_size,
+                        uint64_t                        rsa_pubexp,
+                        keymaster_key_blob_t*           unbound_blob);
+
+    TeeKeyPool();
+
+    ~TeeKeyPool();
+
+    /**
+     * Configure the pool from a comma separated list of shapes and start
+     * the fill thread. Each shape is algorithm-size[-exponent]:depth, e.g.
+     * "rsa-2048-65537:2,rsa-3072-65537:1,ec-256:2". The pool stays off if
+     * \p spec is empty or malformed.
+     *
+     * @return true if the pool was started
+     */
+    bool start(
+                        const char*                     spec,
+                        fill_fn_t                       fill,
+                        void*                           context);
+
+    /**
+     * Stop the fill thread and wipe the pooled keys. Called by the
+     * destructor; must run before the fill function becomes unusable.
+     */
+    void stop();
+
+    /**
+     * Whether keys of this shape are pooled at all.
+     */
+    bool pooled(
+                        keymaster_algorithm_t           algorithm,
+                        uint32_t                        key_size,
+                        uint64_t                        rsa_pubexp);
+
+    /**
+     * Remove one unbound key of this shape from the pool, and wake the fill
+     * thread to replace it. The caller owns the blob and must release it
+     * with discard().
+     *
+     * @return false if none is ready
+     */
+    bool take(
+                        keymaster_algorithm_t           algorithm,
+                        uint32_t                        key_size,
+                        uint64_t                        rsa_pubexp,
+                        keymaster_key_blob_t*           unbound_blob);
+
+    /**
+     * Count a generate_key() of a pooled shape.
+     */
+    void record(
+                        bool                            hit,
+                        uint64_t                        elapsed_us);
+
+    void get_stats(
+                        km_key_pool_stats_t*            stats);
+
+    /**
+     * Wipe and free an unbound key blob.
+     */
+    static void discard(
+                        keymaster_key_blob_t*           unbound_blob);
+
+  private:
+    struct shape_t {
+        keymaster_algorithm_t   algorithm;
+        uint32_t                key_size;
+        uint64_t                rsa_pubexp;
+        uint32_t                depth;
+        uint32_t                count;
+        keymaster_key_blob_t    blobs[KM_KEY_POOL_MAX_DEPTH];
+    };
+
+    bool parse(const char* spec);
+    shape_t* find_locked(keymaster_algorithm_t algorithm, uint32_t key_size,
+                         uint64_t rsa_pubexp);
+    void fill_loop();
+    static void* fill_thread(void* arg);
+
+    // Class is non-copyable
+    TeeKeyPool(const TeeKeyPool&);
+    TeeKeyPool& operator=(const TeeKeyPool&);
+
+    shape_t         shapes_[KM_KEY_POOL_SHAPES];
+    size_t          shape_count_;
+    fill_fn_t       fill_;
+    void*           context_;
+    bool            running_;
+    bool            stopping_;
+    pthread_t       thread_;
+    km_key_pool_stats_t stats_;
+    pthread_mutex_t lock_;
+    pthread_cond_t  cond_;
+};
+
+#endif /* __KM_KEY_POOL_H__ */
@@ -35,6 +35,37 @@
 #include <hardware/keymaster_defs.h>
 #include "km_shared_util.h"
 
+/**
+ * Bump-pointer arena over a caller-supplied buffer, such as a mapped WSM
+ * buffer. Allocations are only released together, by re-initializing it.
+ */
+typedef struct {
+    uint8_t *base;
+    uint32_t size;
+    uint32_t used;
+} km_arena_t;
+
+/**
+ * Start an empty arena over \p base.
+ *
+ * \param arena arena
+ * \param base buffer
+ * \param size length of \p base
+ */
+void km_arena_init(
+    km_arena_t *arena,
+    uint8_t *base,
+    uint32_t size);
+
+/**
+ * Take \p len bytes from an arena.
+ *
+ * \return start of the allocation, or NULL if the arena is exhausted
+ */
+uint8_t *km_arena_alloc(
+    km_arena_t *arena,
+    uint32_t len);
+
 /**
  * Serialize key parameters.
  *
@@ -76,13 +107,55 @@ keymaster_error_t km_serialize_params(
     uint32_t key_size,
     uint64_t rsa_pubexp);
 
+/**
+ * Length of the serialization of \p params, with the same arguments as for
+ * km_serialize_params().
+ *
+ * \param[out] size serialized length in bytes
+ *
+ * \return KM_ERROR_OK or error
+ */
+keymaster_error_t km_serialized_params_size(
+    const keymaster_key_param_set_t *params,
+    bool add_time,
+    uint32_t key_size,
+    uint64_t rsa_pubexp,
+    uint32_t *size);
+
+/**
+ * Serialize key parameters in one pass into an arena.
+ *
+ * The format and the remaining arguments are as for km_serialize_params().
+ *
+ * \param arena arena to write to
+ * \param[out] buf start of the serialized parameters within the arena
+ * \param[out] buflen length of \p buf
+ *
+ * \post On error nothing is taken from the arena and *buf == NULL.
+ *
+ * \return KM_ERROR_OK, KM_ERROR_INSUFFICIENT_BUFFER_SPACE or other error
+ */
+keymaster_error_t km_serialize_params_arena(
+    km_arena_t *arena,
+    const keymaster_key_param_set_t *params,
+    bool add_time,
+    uint32_t key_size,
+    uint64_t rsa_pubexp,
+    uint8_t **buf,
+    uint32_t *buflen);
+
 /**
  * Deserialize a parameter set.
  *
+ * This function allocates memory in \p param_set, which the caller should
+ * free using keymaster_free_param_set().
+ *
  * @param[out] param_set patameter set
  * @param[in,out] pos pointer to current position in buffer
  * @param[in,out] remain length of buffer remaining
  *
+ * @post On error, no memory is allocated and param_set is empty.
+ *
  * @return KM_ERROR_OK or error
  */
 keymaster_error_t deserialize_param_set(
@@ -23,6 +23,8 @@
 
 #include <UniquePtr.h>
 
+#include "km_key_pool.h"
+
 
 class TrustonicTeeKeymasterImpl;
 
@@ -120,6 +122,13 @@ class TeeKeymasterDevice {
                         const keymaster_blob_t*         app_data,
                         keymaster_blob_t*               export_data);
 
+    static keymaster_error_t delete_key(
+                        const keymaster1_device_t*      dev,
+                        const keymaster_key_blob_t*     key);
+
+    static keymaster_error_t delete_all_keys(
+                        const keymaster1_device_t*      dev);
+
     static keymaster_error_t begin(
                         const keymaster1_device_t*      dev,
                         keymaster_purpose_t             purpose,
@@ -149,6 +158,13 @@ class TeeKeymasterDevice {
                         const keymaster1_device_t*      dev,
                         keymaster_operation_handle_t    operation_handle);
 
+    /*
+     * Not part of keymaster1: key pool counters for tests and benchmarks.
+     */
+    static void get_key_pool_stats(
+                        const keymaster1_device_t*      dev,
+                        km_key_pool_stats_t*            stats);
+
   private:
 
     // Class is non-copyable and not default-constructible
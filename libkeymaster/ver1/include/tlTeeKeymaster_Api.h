@@ -49,11 +49,21 @@
 #define CMD_ID_TEE_UPDATE                  0x07
 #define CMD_ID_TEE_FINISH                  0x08
 #define CMD_ID_TEE_ABORT                   0x09
+#define CMD_ID_TEE_UPDATE_FINISH           0x0A
+#define CMD_ID_TEE_PREGENERATE_KEY         0x0B
+#define CMD_ID_TEE_FINALIZE_KEY            0x0C
 // for internal use:
 #define CMD_ID_TEE_GET_KEY_INFO          0x0101
 #define CMD_ID_TEE_GET_OPERATION_INFO    0x0102
+#define CMD_ID_TEE_GET_CAPABILITIES      0x0103
 /* ... add more command ids when needed */
 
+/**
+ * Capability flags returned by CMD_ID_TEE_GET_CAPABILITIES
+ */
+#define TEE_CAP_UPDATE_FINISH   0x00000001 /**< CMD_ID_TEE_UPDATE_FINISH */
+#define TEE_CAP_KEY_POOL        0x00000002 /**< CMD_ID_TEE_PREGENERATE_KEY and CMD_ID_TEE_FINALIZE_KEY */
+
 /*
 + KEY FORMATS
 
@@ -269,6 +279,21 @@ typedef struct {
 } finish_t;
 
 
+/**
+ * update_finish data structure
+ *
+ * Combined update() and finish() on an operation. All buffers lie in one
+ * contiguous bulk mapping; the whole input must be consumed.
+ */
+typedef struct {
+    keymaster_operation_handle_t handle; /**< [in] */
+    data_blob_t params; /**< [in] serialized finish() params */
+    data_blob_t input; /**< [in] */
+    data_blob_t signature; /**< [in] */
+    data_blob_t output; /**< [in,out] capacity in, length out */
+} update_finish_t;
+
+
 /**
  * abort structure
  */
@@ -297,6 +322,43 @@ typedef struct {
 } get_operation_info_t;
 
 
+/**
+ * pregenerate_key data structure
+ *
+ * The TA generates key material from KM_TAG_ALGORITHM, KM_TAG_KEY_SIZE and
+ * (RSA) KM_TAG_RSA_PUBLIC_EXPONENT only, and wraps it as an unbound blob that
+ * no command other than CMD_ID_TEE_FINALIZE_KEY accepts.
+ */
+typedef struct {
+    data_blob_t params; /**< [in] serialized */
+    data_blob_t key_blob; /**< [out] unbound key blob */
+} pregenerate_key_t;
+
+
+/**
+ * finalize_key data structure
+ *
+ * The TA checks that params name the same algorithm, key size and exponent
+ * as the unbound blob, then rewraps its key material with params as for
+ * CMD_ID_TEE_GENERATE_KEY. The result is indistinguishable from a freshly
+ * generated key.
+ */
+typedef struct {
+    data_blob_t params; /**< [in] serialized */
+    data_blob_t unbound_blob; /**< [in] from CMD_ID_TEE_PREGENERATE_KEY */
+    data_blob_t key_blob; /**< [out] keymaster_key_blob_t */
+    data_blob_t characteristics; /**< [out] serialized */
+} finalize_key_t;
+
+
+/**
+ * get_capabilities data structure
+ */
+typedef struct {
+    uint32_t flags; /**< [out] TEE_CAP_* */
+} get_capabilities_t;
+
+
 /**
  * TCI message data.
  */
@@ -316,9 +378,13 @@ typedef struct {
         begin_t             begin;
         update_t            update;
         finish_t            finish;
+        update_finish_t     update_finish;
+        pregenerate_key_t   pregenerate_key;
+        finalize_key_t      finalize_key;
         abort_t             abort;
         get_key_info_t      get_key_info;
         get_operation_info_t get_operation_info;
+        get_capabilities_t  get_capabilities;
     };
 } tciMessage_t, *tciMessage_ptr;
 
@@ -68,6 +68,58 @@ keymaster_error_t TEE_GenerateKey(
     keymaster_key_blob_t*             key_blob,
     keymaster_key_characteristics_t** characteristics);
 
+/**
+ * Algorithm, key size and RSA public exponent requested by a key creation
+ * parameter set. The exponent defaults to 65537 for RSA and is 0 otherwise.
+ */
+keymaster_error_t TEE_GetCreationParams(
+    const keymaster_key_param_set_t*  params,
+    keymaster_algorithm_t*            algorithm,
+    uint32_t*                         key_size,
+    uint64_t*                         rsa_pubexp);
+
+/**
+ * Whether the TA behind this session implements TEE_PregenerateKey() and
+ * TEE_FinalizeKey().
+ *
+ * @param  session_handle  [in] Session handle
+ */
+bool TEE_SupportsKeyPool(
+    TEE_SessionHandle                 session_handle);
+
+/**
+ * Generate key material ahead of a TEE_GenerateKey() request, as an unbound
+ * blob that the TA only accepts in TEE_FinalizeKey().
+ *
+ * @param  session_handle  [in] Session handle
+ * @param  algorithm       [in] KM_ALGORITHM_RSA or KM_ALGORITHM_EC
+ * @param  key_size        [in] key size in bits
+ * @param  rsa_pubexp      [in] RSA public exponent, ignored for EC
+ * @param  unbound_blob    [out] blob to pass to TEE_FinalizeKey(); the
+ *                         caller frees it
+ */
+keymaster_error_t TEE_PregenerateKey(
+    TEE_SessionHandle                 session_handle,
+    keymaster_algorithm_t             algorithm,
+    uint32_t                          key_size,
+    uint64_t                          rsa_pubexp,
+    keymaster_key_blob_t*             unbound_blob);
+
+/**
+ * Bind an unbound blob to the parameters of a key generation request. The
+ * outputs are those of TEE_GenerateKey() for the same params. Fails if the
+ * params ask for a different algorithm, key size or exponent.
+ *
+ * The caller must discard the unbound blob whatever the outcome, so that its
+ * key material is used for one key only.
+ */
+keymaster_error_t TEE_FinalizeKey(
+    TEE_SessionHandle                 session_handle,
+    const keymaster_key_param_set_t*  params,
+    const keymaster_key_blob_t*       unbound_blob,
+    keymaster_key_blob_t*             key_blob,
+    keymaster_key_characteristics_t** characteristics);
+
 keymaster_error_t TEE_GetKeyCharacteristics(
     TEE_SessionHandle                 session_handle,
     const keymaster_key_blob_t*       key_blob,
@@ -116,6 +168,41 @@ keymaster_error_t TEE_Finish(
     keymaster_key_param_set_t*        out_params,
     keymaster_blob_t*                 output);
 
+/**
+ * Largest total input accepted by TEE_UpdateFinish().
+ */
+#define TEE_FUSED_INPUT_MAX 2048
+
+/**
+ * Size of the per-session buffer that carries params, input, signature and
+ * output of TEE_UpdateFinish() in a single bulk mapping.
+ */
+#define TEE_FUSED_BUFFER_SIZE (4 * TEE_FUSED_INPUT_MAX)
+
+/**
+ * Whether the TA behind this session implements TEE_UpdateFinish().
+ *
+ * @param  session_handle  [in] Session handle
+ */
+bool TEE_SupportsUpdateFinish(
+    TEE_SessionHandle                 session_handle);
+
+/**
+ * Feed the remaining input to an operation and finish it in one TA call.
+ *
+ * Returns KM_ERROR_UNIMPLEMENTED, without touching the operation, if the TA
+ * lacks the command or the data does not fit the fused buffer; the caller
+ * then uses TEE_Update() and TEE_Finish() instead.
+ */
+keymaster_error_t TEE_UpdateFinish(
+    TEE_SessionHandle                 session_handle,
+    keymaster_operation_handle_t      operation_handle,
+    const keymaster_key_param_set_t*  params,
+    const keymaster_blob_t*           input,
+    const keymaster_blob_t*           signature,
+    keymaster_key_param_set_t*        out_params,
+    keymaster_blob_t*                 output);
+
 keymaster_error_t TEE_Abort(
     TEE_SessionHandle                 session_handle,
     keymaster_operation_handle_t      operation_handle);
@@ -32,7 +32,21 @@
 #ifndef TRUSTONIC_TEE_KEYMASTER_IMPL_H_
 #define TRUSTONIC_TEE_KEYMASTER_IMPL_H_
 
+#include <pthread.h>
+
 #include "tlcTeeKeymasterM_if.h"
+#include "km_key_cache.h"
+#include "km_key_pool.h"
+
+/* Number of TA sessions opened to serve concurrent callers */
+#define KM_SESSION_POOL_SIZE    4
+/* Maximum number of operations in flight across all sessions */
+#define KM_MAX_OPERATIONS       16
+/* TEE_Begin() attempts before a TA handle that is live on another session
+ * is given up on */
+#define KM_BEGIN_ATTEMPTS       3
+/* Key pool configuration, see TeeKeyPool::start(); empty disables the pool */
+#define KM_KEY_POOL_PROPERTY    "ro.hardware.keymaster.key_pool"
 
 class TrustonicTeeKeymasterImpl {
   public:
@@ -101,6 +115,11 @@ class TrustonicTeeKeymasterImpl {
                         const keymaster_blob_t*         app_data,
                         keymaster_blob_t*               export_data);
 
+    keymaster_error_t delete_key(
+                        const keymaster_key_blob_t*     key);
+
+    keymaster_error_t delete_all_keys();
+
     keymaster_error_t begin(
                         keymaster_purpose_t             purpose,
                         const keymaster_key_blob_t*     key,
@@ -126,8 +145,55 @@ class TrustonicTeeKeymasterImpl {
     keymaster_error_t abort(
                         keymaster_operation_handle_t    operation_handle);
 
-    TEE_SessionHandle session_handle_;
-
+    void get_key_pool_stats(
+                        km_key_pool_stats_t*            stats);
+
+  private:
+    struct km_session_t {
+        TEE_SessionHandle   handle;
+        pthread_mutex_t     lock;
+        /* calls in flight plus operations begun on this session */
+        uint32_t            load;
+        /* calls in flight alone */
+        uint32_t            calls;
+    };
+
+    struct km_operation_t {
+        keymaster_operation_handle_t handle;     /* handle returned by the TA, 0 if free */
+        km_session_t*                session;
+        keymaster_purpose_t          purpose;
+        /* sign/verify input held back for TEE_UpdateFinish(), or NULL */
+        uint8_t*                     held;
+        size_t                       held_length;
+    };
+
+    km_session_t* acquire_session();
+    void release_session(km_session_t* session, bool keep_load);
+    void lock_operation_session(km_session_t* session);
+    void unlock_operation_session(km_session_t* session);
+    km_session_t* acquire_idle_session();
+    void release_idle_session(km_session_t* session);
+    static keymaster_error_t pregenerate_key(void* context,
+                                             keymaster_algorithm_t algorithm,
+                                             uint32_t key_size,
+                                             uint64_t rsa_pubexp,
+                                             keymaster_key_blob_t* unbound_blob);
+    keymaster_error_t add_operation(km_session_t* session,
+                                    keymaster_operation_handle_t operation_handle,
+                                    keymaster_purpose_t purpose);
+    bool lookup_operation(keymaster_operation_handle_t operation_handle, km_operation_t* op);
+    void drop_operation(keymaster_operation_handle_t operation_handle);
+    keymaster_error_t hold_input(keymaster_operation_handle_t operation_handle,
+                                 const keymaster_blob_t* input);
+    void take_held_input(keymaster_operation_handle_t operation_handle,
+                         keymaster_blob_t* held);
+
+    km_session_t sessions_[KM_SESSION_POOL_SIZE];
+    size_t session_count_;
+    km_operation_t operations_[KM_MAX_OPERATIONS];
+    pthread_mutex_t pool_lock_;
+    TeeKeyCache key_cache_;
+    TeeKeyPool key_pool_;
 };
 
 
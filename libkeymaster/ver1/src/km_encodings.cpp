@@ -337,12 +337,13 @@ keymaster_error_t decode_pkcs8(
     keymaster_error_t ret = KM_ERROR_OK;
     PKCS8_PRIV_KEY_INFO *p8inf = NULL;
     EVP_PKEY *pkey = NULL;
+    const unsigned char *pos;
 
     CHECK_NOT_NULL(key_size);
 
-    /* Parse key data */
-    p8inf = d2i_PKCS8_PRIV_KEY_INFO(NULL,
-        (const unsigned char**)&pkcs8_data->data, pkcs8_data->data_length);
+    /* Parse key data; d2i moves pos, the caller's blob must stay as it is */
+    pos = pkcs8_data->data;
+    p8inf = d2i_PKCS8_PRIV_KEY_INFO(NULL, &pos, pkcs8_data->data_length);
     CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB,
         p8inf != NULL);
     pkey = EVP_PKCS82PKEY(p8inf);
@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/sha.h>
+#include <hardware/keymaster_defs.h>
+#include "km_key_cache.h"
+#include "km_util.h"
+
+/**
+ * Digest the key blob alone (\p blob_digest) and together with the
+ * optional client_id and app_data (\p digest). Each field is length
+ * prefixed so different splits of the same bytes do not collide.
+ */
+static void key_digest(
+    const keymaster_key_blob_t *key_blob,
+    const keymaster_blob_t *client_id,
+    const keymaster_blob_t *app_data,
+    uint8_t *digest,
+    uint8_t *blob_digest)
+{
+    SHA256_CTX ctx;
+    uint64_t len;
+
+    SHA256_Init(&ctx);
+    len = key_blob->key_material_size;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    SHA256_Update(&ctx, key_blob->key_material, key_blob->key_material_size);
+    if (blob_digest != NULL) {
+        SHA256_CTX blob_ctx = ctx;
+        SHA256_Final(blob_digest, &blob_ctx);
+    }
+
+    len = (client_id != NULL) ? client_id->data_length : 0;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    if (len != 0) {
+        SHA256_Update(&ctx, client_id->data, client_id->data_length);
+    }
+    len = (app_data != NULL) ? app_data->data_length : 0;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    if (len != 0) {
+        SHA256_Update(&ctx, app_data->data, app_data->data_length);
+    }
+    SHA256_Final(digest, &ctx);
+}
+
+static size_t param_set_size(
+    const keymaster_key_param_set_t *set)
+{
+    size_t size = set->length * sizeof(keymaster_key_param_t);
+
+    for (size_t i = 0; i < set->length; i++) {
+        keymaster_tag_type_t type = keymaster_tag_get_type(set->params[i].tag);
+        if ((type == KM_BYTES) || (type == KM_BIGNUM)) {
+            size += set->params[i].blob.data_length;
+        }
+    }
+    return size;
+}
+
+static keymaster_error_t copy_param_set(
+    keymaster_key_param_set_t *dst,
+    const keymaster_key_param_set_t *src)
+{
+    dst->params = NULL;
+    dst->length = 0;
+    if (src->length == 0) {
+        return KM_ERROR_OK;
+    }
+
+    dst->params = (keymaster_key_param_t*)malloc(src->length * sizeof(keymaster_key_param_t));
+    if (dst->params == NULL) {
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    for (size_t i = 0; i < src->length; i++) {
+        keymaster_tag_type_t type = keymaster_tag_get_type(src->params[i].tag);
+
+        dst->params[i] = src->params[i];
+        if (((type == KM_BYTES) || (type == KM_BIGNUM)) &&
+            (src->params[i].blob.data_length != 0))
+        {
+            uint8_t *data = (uint8_t*)malloc(src->params[i].blob.data_length);
+            if (data == NULL) {
+                dst->length = i;
+                keymaster_free_param_set(dst);
+                return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+            }
+            memcpy(data, src->params[i].blob.data, src->params[i].blob.data_length);
+            dst->params[i].blob.data = data;
+        } else if ((type == KM_BYTES) || (type == KM_BIGNUM)) {
+            dst->params[i].blob.data = NULL;
+        }
+    }
+    dst->length = src->length;
+
+    return KM_ERROR_OK;
+}
+
+static keymaster_key_characteristics_t *copy_characteristics(
+    const keymaster_key_characteristics_t *src)
+{
+    keymaster_key_characteristics_t *dst =
+        (keymaster_key_characteristics_t*)malloc(sizeof(keymaster_key_characteristics_t));
+    if (dst == NULL) {
+        return NULL;
+    }
+
+    if (copy_param_set(&dst->hw_enforced, &src->hw_enforced) != KM_ERROR_OK) {
+        free(dst);
+        return NULL;
+    }
+    if (copy_param_set(&dst->sw_enforced, &src->sw_enforced) != KM_ERROR_OK) {
+        keymaster_free_param_set(&dst->hw_enforced);
+        free(dst);
+        return NULL;
+    }
+
+    return dst;
+}
+
+static bool copy_blob(
+    keymaster_blob_t *dst,
+    const keymaster_blob_t *src)
+{
+    uint8_t *data = (uint8_t*)malloc(src->data_length);
+
+    if (data == NULL) {
+        return false;
+    }
+    memcpy(data, src->data, src->data_length);
+    dst->data = data;
+    dst->data_length = src->data_length;
+
+    return true;
+}
+
+TeeKeyCache::TeeKeyCache()
+    : bytes_(0), clock_(0)
+{
+    memset(entries_, 0, sizeof(entries_));
+    pthread_mutex_init(&lock_, NULL);
+}
+
+TeeKeyCache::~TeeKeyCache()
+{
+    invalidate_all();
+    pthread_mutex_destroy(&lock_);
+}
+
+TeeKeyCache::entry_t* TeeKeyCache::find_locked(
+    const uint8_t* digest)
+{
+    for (size_t i = 0; i < KM_KEY_CACHE_ENTRIES; i++) {
+        if (entries_[i].used &&
+            (memcmp(entries_[i].digest, digest, KM_KEY_CACHE_DIGEST_SIZE) == 0))
+        {
+            entries_[i].last_use = ++clock_;
+            return &entries_[i];
+        }
+    }
+    return NULL;
+}
+
+TeeKeyCache::entry_t* TeeKeyCache::insert_locked(
+    const uint8_t* digest,
+    const uint8_t* blob_digest)
+{
+    entry_t *entry = find_locked(digest);
+    if (entry != NULL) {
+        return entry;
+    }
+
+    /* Take a free slot, or evict the least recently used one */
+    entry = &entries_[0];
+    for (size_t i = 0; i < KM_KEY_CACHE_ENTRIES; i++) {
+        if (!entries_[i].used) {
+            entry = &entries_[i];
+            break;
+        }
+        if (entries_[i].last_use < entry->last_use) {
+            entry = &entries_[i];
+        }
+    }
+    clear_locked(entry);
+
+    memcpy(entry->digest, digest, KM_KEY_CACHE_DIGEST_SIZE);
+    memcpy(entry->blob_digest, blob_digest, KM_KEY_CACHE_DIGEST_SIZE);
+    entry->used = true;
+    entry->last_use = ++clock_;
+
+    return entry;
+}
+
+void TeeKeyCache::clear_locked(
+    entry_t* entry)
+{
+    if (entry->characteristics != NULL) {
+        keymaster_free_characteristics(entry->characteristics);
+        free(entry->characteristics);
+    }
+    free((void*)entry->export_data.data);
+    bytes_ -= entry->characteristics_bytes + entry->export_data.data_length;
+    memset(entry, 0, sizeof(*entry));
+}
+
+/**
+ * Evict least recently used entries other than \p keep until the byte
+ * limit is met.
+ */
+void TeeKeyCache::trim_locked(
+    entry_t* keep)
+{
+    while (bytes_ > KM_KEY_CACHE_MAX_BYTES) {
+        entry_t *victim = NULL;
+        for (size_t i = 0; i < KM_KEY_CACHE_ENTRIES; i++) {
+            if (entries_[i].used && (&entries_[i] != keep) &&
+                ((victim == NULL) || (entries_[i].last_use < victim->last_use)))
+            {
+                victim = &entries_[i];
+            }
+        }
+        if (victim == NULL) {
+            /* A single entry larger than the whole cache is not kept */
+            clear_locked(keep);
+            break;
+        }
+        clear_locked(victim);
+    }
+}
+
+bool TeeKeyCache::get_characteristics(
+    const keymaster_key_blob_t*     key_blob,
+    const keymaster_blob_t*         client_id,
+    const keymaster_blob_t*         app_data,
+    keymaster_key_characteristics_t** characteristics)
+{
+    uint8_t digest[KM_KEY_CACHE_DIGEST_SIZE];
+    bool hit = false;
+
+    if ((key_blob == NULL) || (characteristics == NULL)) {
+        return false;
+    }
+    key_digest(key_blob, client_id, app_data, digest, NULL);
+
+    pthread_mutex_lock(&lock_);
+    entry_t *entry = find_locked(digest);
+    if ((entry != NULL) && (entry->characteristics != NULL)) {
+        *characteristics = copy_characteristics(entry->characteristics);
+        hit = (*characteristics != NULL);
+    }
+    pthread_mutex_unlock(&lock_);
+
+    return hit;
+}
+
+void TeeKeyCache::put_characteristics(
+    const keymaster_key_blob_t*     key_blob,
+    const keymaster_blob_t*         client_id,
+    const keymaster_blob_t*         app_data,
+    const keymaster_key_characteristics_t* characteristics)
+{
+    uint8_t digest[KM_KEY_CACHE_DIGEST_SIZE];
+    uint8_t blob_digest[KM_KEY_CACHE_DIGEST_SIZE];
+
+    if ((key_blob == NULL) || (characteristics == NULL)) {
+        return;
+    }
+    key_digest(key_blob, client_id, app_data, digest, blob_digest);
+
+    keymaster_key_characteristics_t *copy = copy_characteristics(characteristics);
+    if (copy == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock_);
+    entry_t *entry = insert_locked(digest, blob_digest);
+    if (entry->characteristics == NULL) {
+        entry->characteristics = copy;
+        entry->characteristics_bytes = sizeof(*copy) +
+            param_set_size(&copy->hw_enforced) + param_set_size(&copy->sw_enforced);
+        bytes_ += entry->characteristics_bytes;
+        copy = NULL;
+        trim_locked(entry);
+    }
+    pthread_mutex_unlock(&lock_);
+
+    if (copy != NULL) {
+        /* Another thread cached the same key first */
+        keymaster_free_characteristics(copy);
+        free(copy);
+    }
+}
+
+bool TeeKeyCache::get_export(
+    const keymaster_key_blob_t*     key_blob,
+    const keymaster_blob_t*         client_id,
+    const keymaster_blob_t*         app_data,
+    keymaster_blob_t*               export_data)
+{
+    uint8_t digest[KM_KEY_CACHE_DIGEST_SIZE];
+    bool hit = false;
+
+    if ((key_blob == NULL) || (export_data == NULL)) {
+        return false;
+    }
+    key_digest(key_blob, client_id, app_data, digest, NULL);
+
+    pthread_mutex_lock(&lock_);
+    entry_t *entry = find_locked(digest);
+    if ((entry != NULL) && (entry->export_data.data != NULL)) {
+        hit = copy_blob(export_data, &entry->export_data);
+    }
+    pthread_mutex_unlock(&lock_);
+
+    return hit;
+}
+
+void TeeKeyCache::put_export(
+    const keymaster_key_blob_t*     key_blob,
+    const keymaster_blob_t*         client_id,
+    const keymaster_blob_t*         app_data,
+    const keymaster_blob_t*         export_data)
+{
+    uint8_t digest[KM_KEY_CACHE_DIGEST_SIZE];
+    uint8_t blob_digest[KM_KEY_CACHE_DIGEST_SIZE];
+    keymaster_blob_t copy;
+
+    if ((key_blob == NULL) || (export_data == NULL) ||
+        (export_data->data == NULL) || (export_data->data_length == 0))
+    {
+        return;
+    }
+    key_digest(key_blob, client_id, app_data, digest, blob_digest);
+
+    if (!copy_blob(&copy, export_data)) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock_);
+    entry_t *entry = insert_locked(digest, blob_digest);
+    if (entry->export_data.data == NULL) {
+        entry->export_data = copy;
+        bytes_ += copy.data_length;
+        copy.data = NULL;
+        trim_locked(entry);
+    }
+    pthread_mutex_unlock(&lock_);
+
+    free((void*)copy.data);
+}
+
+void TeeKeyCache::invalidate(
+    const keymaster_key_blob_t*     key_blob)
+{
+    uint8_t digest[KM_KEY_CACHE_DIGEST_SIZE];
+    uint8_t blob_digest[KM_KEY_CACHE_DIGEST_SIZE];
+
+    if (key_blob == NULL) {
+        return;
+    }
+    key_digest(key_blob, NULL, NULL, digest, blob_digest);
+
+    pthread_mutex_lock(&lock_);
+    for (size_t i = 0; i < KM_KEY_CACHE_ENTRIES; i++) {
+        if (entries_[i].used &&
+            (memcmp(entries_[i].blob_digest, blob_digest, KM_KEY_CACHE_DIGEST_SIZE) == 0))
+        {
+            clear_locked(&entries_[i]);
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+void TeeKeyCache::invalidate_all()
+{
+    pthread_mutex_lock(&lock_);
+    for (size_t i = 0; i < KM_KEY_CACHE_ENTRIES; i++) {
+        if (entries_[i].used) {
+            clear_locked(&entries_[i]);
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+}
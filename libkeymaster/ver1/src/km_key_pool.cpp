@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <hardware/keymaster_defs.h>
+#include "km_key_pool.h"
+#include "km_util.h"
+
+TeeKeyPool::TeeKeyPool()
+    : shape_count_(0), fill_(NULL), context_(NULL),
+      running_(false), stopping_(false)
+{
+    memset(shapes_, 0, sizeof(shapes_));
+    memset(&stats_, 0, sizeof(stats_));
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&cond_, NULL);
+}
+
+TeeKeyPool::~TeeKeyPool()
+{
+    stop();
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+}
+
+void TeeKeyPool::discard(
+    keymaster_key_blob_t* unbound_blob)
+{
+    if (unbound_blob->key_material != NULL) {
+        memset((uint8_t*)unbound_blob->key_material, 0, unbound_blob->key_material_size);
+        free((uint8_t*)unbound_blob->key_material);
+    }
+    unbound_blob->key_material = NULL;
+    unbound_blob->key_material_size = 0;
+}
+
+/**
+ * Parse "alg-size[-exponent]:depth[,...]" into shapes_.
+ */
+bool TeeKeyPool::parse(
+    const char* spec)
+{
+    const char* p = spec;
+
+    shape_count_ = 0;
+    while (*p != '\0') {
+        shape_t* shape;
+        char* next;
+
+        if (shape_count_ == KM_KEY_POOL_SHAPES) {
+            LOG_E("%s: more than %d shapes", __func__, KM_KEY_POOL_SHAPES);
+            return false;
+        }
+        shape = &shapes_[shape_count_];
+        memset(shape, 0, sizeof(*shape));
+
+        if (strncmp(p, "rsa-", 4) == 0) {
+            shape->algorithm = KM_ALGORITHM_RSA;
+            p += 4;
+        } else if (strncmp(p, "ec-", 3) == 0) {
+            shape->algorithm = KM_ALGORITHM_EC;
+            p += 3;
+        } else {
+            break;
+        }
+
+        shape->key_size = strtoul(p, &next, 10);
+        if ((next == p) || (shape->key_size == 0)) {
+            break;
+        }
+        p = next;
+        if (shape->algorithm == KM_ALGORITHM_RSA) {
+            shape->rsa_pubexp = 65537;
+            if (*p == '-') {
+                shape->rsa_pubexp = strtoull(p + 1, &next, 10);
+                if ((next == p + 1) || (shape->rsa_pubexp % 2 != 1) || (shape->rsa_pubexp == 1)) {
+                    break;
+                }
+                p = next;
+            }
+        }
+
+        if (*p != ':') {
+            break;
+        }
+        shape->depth = strtoul(p + 1, &next, 10);
+        if ((next == p + 1) || (shape->depth == 0) || (shape->depth > KM_KEY_POOL_MAX_DEPTH)) {
+            break;
+        }
+        p = next;
+        shape_count_++;
+
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            break;
+        }
+    }
+
+    if (*p != '\0') {
+        LOG_E("%s: cannot parse '%s' at '%s'", __func__, spec, p);
+        shape_count_ = 0;
+        return false;
+    }
+    return shape_count_ != 0;
+}
+
+bool TeeKeyPool::start(
+    const char* spec,
+    fill_fn_t fill,
+    void* context)
+{
+    if (running_ || (spec == NULL) || !parse(spec)) {
+        return false;
+    }
+
+    fill_ = fill;
+    context_ = context;
+    stopping_ = false;
+    stats_.capacity = 0;
+    for (size_t i = 0; i < shape_count_; i++) {
+        stats_.capacity += shapes_[i].depth;
+    }
+
+    if (pthread_create(&thread_, NULL, fill_thread, this) != 0) {
+        LOG_E("%s: cannot start fill thread", __func__);
+        shape_count_ = 0;
+        return false;
+    }
+    running_ = true;
+    LOG_I("%s: pooling %zu key shape(s), %u key(s)", __func__, shape_count_, stats_.capacity);
+    return true;
+}
+
+void TeeKeyPool::stop()
+{
+    if (running_) {
+        pthread_mutex_lock(&lock_);
+        stopping_ = true;
+        pthread_cond_signal(&cond_);
+        pthread_mutex_unlock(&lock_);
+        pthread_join(thread_, NULL);
+        running_ = false;
+    }
+
+    pthread_mutex_lock(&lock_);
+    for (size_t i = 0; i < shape_count_; i++) {
+        for (uint32_t j = 0; j < shapes_[i].count; j++) {
+            discard(&shapes_[i].blobs[j]);
+        }
+        shapes_[i].count = 0;
+    }
+    shape_count_ = 0;
+    stats_.available = 0;
+    pthread_mutex_unlock(&lock_);
+}
+
+TeeKeyPool::shape_t* TeeKeyPool::find_locked(
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size,
+    uint64_t rsa_pubexp)
+{
+    for (size_t i = 0; i < shape_count_; i++) {
+        shape_t* shape = &shapes_[i];
+        if ((shape->algorithm == algorithm) && (shape->key_size == key_size) &&
+            ((algorithm != KM_ALGORITHM_RSA) || (shape->rsa_pubexp == rsa_pubexp)))
+        {
+            return shape;
+        }
+    }
+    return NULL;
+}
+
+bool TeeKeyPool::pooled(
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size,
+    uint64_t rsa_pubexp)
+{
+    pthread_mutex_lock(&lock_);
+    bool found = (find_locked(algorithm, key_size, rsa_pubexp) != NULL);
+    pthread_mutex_unlock(&lock_);
+    return found;
+}
+
+bool TeeKeyPool::take(
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size,
+    uint64_t rsa_pubexp,
+    keymaster_key_blob_t* unbound_blob)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&lock_);
+    shape_t* shape = find_locked(algorithm, key_size, rsa_pubexp);
+    if ((shape != NULL) && (shape->count > 0)) {
+        /* Move the blob out so that no other caller can get it */
+        shape->count--;
+        *unbound_blob = shape->blobs[shape->count];
+        shape->blobs[shape->count].key_material = NULL;
+        shape->blobs[shape->count].key_material_size = 0;
+        stats_.available--;
+        found = true;
+    }
+    if (shape != NULL) {
+        pthread_cond_signal(&cond_);
+    }
+    pthread_mutex_unlock(&lock_);
+
+    return found;
+}
+
+void TeeKeyPool::record(
+    bool hit,
+    uint64_t elapsed_us)
+{
+    pthread_mutex_lock(&lock_);
+    if (hit) {
+        stats_.hits++;
+        stats_.hit_us += elapsed_us;
+    } else {
+        stats_.misses++;
+        stats_.miss_us += elapsed_us;
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+void TeeKeyPool::get_stats(
+    km_key_pool_stats_t* stats)
+{
+    pthread_mutex_lock(&lock_);
+    *stats = stats_;
+    pthread_mutex_unlock(&lock_);
+}
+
+void* TeeKeyPool::fill_thread(
+    void* arg)
+{
+    static_cast<TeeKeyPool*>(arg)->fill_loop();
+    return NULL;
+}
+
+/**
+ * Top up the emptiest shape, one key at a time, until every shape is at
+ * its depth; then sleep until take() or stop() signals.
+ */
+void TeeKeyPool::fill_loop()
+{
+    pthread_mutex_lock(&lock_);
+    while (!stopping_) {
+        shape_t* shape = NULL;
+        for (size_t i = 0; i < shape_count_; i++) {
+            if ((shapes_[i].count < shapes_[i].depth) &&
+                ((shape == NULL) || (shapes_[i].count < shape->count)))
+            {
+                shape = &shapes_[i];
+            }
+        }
+        if (shape == NULL) {
+            pthread_cond_wait(&cond_, &lock_);
+            continue;
+        }
+
+        keymaster_algorithm_t algorithm = shape->algorithm;
+        uint32_t key_size = shape->key_size;
+        uint64_t rsa_pubexp = shape->rsa_pubexp;
+        keymaster_key_blob_t unbound_blob = {NULL, 0};
+        pthread_mutex_unlock(&lock_);
+
+        keymaster_error_t ret = fill_(context_, algorithm, key_size, rsa_pubexp, &unbound_blob);
+
+        pthread_mutex_lock(&lock_);
+        if ((ret == KM_ERROR_OK) && !stopping_ && (shape->count < shape->depth)) {
+            shape->blobs[shape->count++] = unbound_blob;
+            stats_.available++;
+            continue;
+        }
+        discard(&unbound_blob);
+        if (ret != KM_ERROR_OK) {
+            struct timespec ts;
+            uint32_t wait_ms = (ret == KM_ERROR_SECURE_HW_BUSY) ?
+                KM_KEY_POOL_RETRY_MS : KM_KEY_POOL_ERROR_MS;
+            if (ret != KM_ERROR_SECURE_HW_BUSY) {
+                LOG_E("%s: pre-generation failed with %d", __func__, ret);
+            }
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += wait_ms / 1000;
+            ts.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            while (!stopping_ &&
+                (pthread_cond_timedwait(&cond_, &lock_, &ts) != ETIMEDOUT))
+            {
+                /* take() signals too; keep waiting out the back-off */
+            }
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+}
@@ -32,166 +32,338 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <time.h>
+#include <sys/time.h>
 #include <hardware/keymaster_defs.h>
 #include "serialization.h"
 #include "km_util.h"
 
 #define MAX_DYNAMIC_PARAM_BUFFERS 20
 
-keymaster_error_t km_serialize_params(
-    uint8_t **buf,
-    uint32_t *buflen,
+void km_arena_init(
+    km_arena_t *arena,
+    uint8_t *base,
+    uint32_t size)
+{
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+}
+
+uint8_t *km_arena_alloc(
+    km_arena_t *arena,
+    uint32_t len)
+{
+    uint8_t *p;
+
+    if (arena->size - arena->used < len) {
+        return NULL;
+    }
+    p = arena->base + arena->used;
+    arena->used += len;
+    return p;
+}
+
+/**
+ * Length of the serialized value of a parameter, or 0 for a bad tag.
+ */
+static uint32_t param_value_size(
+    const keymaster_key_param_t *param)
+{
+    switch (keymaster_tag_get_type(param->tag)) {
+        case KM_ENUM:
+        case KM_ENUM_REP:
+        case KM_UINT:
+        case KM_UINT_REP:
+        case KM_BOOL:
+            return 4; // uint32_t
+        case KM_ULONG:
+        case KM_DATE:
+        case KM_ULONG_REP:
+            return 8; // uint64_t
+        case KM_BIGNUM:
+        case KM_BYTES:
+            return 4 + param->blob.data_length; // uint32_t + data
+        default: // bad tag
+            return 0;
+    }
+}
+
+keymaster_error_t km_serialized_params_size(
     const keymaster_key_param_set_t *params,
     bool add_time,
     uint32_t key_size,
-    uint64_t rsa_pubexp)
+    uint64_t rsa_pubexp,
+    uint32_t *size)
 {
     keymaster_error_t ret = KM_ERROR_OK;
-    uint8_t* pos = NULL;
-    uint32_t size;
-    uint32_t n_params;
+    uint32_t n_params = (params != NULL) ? params->length : 0;
     bool key_size_present = false;
     bool rsa_pubexp_present = false;
-    bool add_key_size = false;
-    bool add_rsa_pubexp = false;
-    keymaster_tag_t tag;
-
-    CHECK_NOT_NULL(buf);
-    CHECK_NOT_NULL(buflen);
+    uint32_t total = 4; // uint32_t (number of parameters)
 
-    n_params = (params != NULL) ? params->length : 0;
-    *buf = NULL;
-    size = 4; // uint32_t (number of parameters)
+    CHECK_NOT_NULL(size);
 
-   /* First calculate the required buffer size */
     for (size_t i = 0; i < n_params; i++) {
-        tag = params->params[i].tag;
+        const keymaster_key_param_t *param = &params->params[i];
+        uint32_t value_size = param_value_size(param);
 
-        if (tag == KM_TAG_KEY_SIZE) {
+        CHECK_TRUE(KM_ERROR_INVALID_TAG, value_size != 0);
+        if (param->tag == KM_TAG_KEY_SIZE) {
             key_size_present = true;
-        } else if (tag == KM_TAG_RSA_PUBLIC_EXPONENT) {
+        } else if (param->tag == KM_TAG_RSA_PUBLIC_EXPONENT) {
             rsa_pubexp_present = true;
         }
-
-        /* length of tag */
-        size += 4; // uint32_t <= keymaster_tag_t
-
-        /* length of value */
-        switch (keymaster_tag_get_type(tag)) {
-            case KM_ENUM:
-            case KM_ENUM_REP:
-            case KM_UINT:
-            case KM_UINT_REP:
-            case KM_BOOL:
-                size += 4; // uint32_t
-                break;
-            case KM_ULONG:
-            case KM_DATE:
-            case KM_ULONG_REP:
-                size += 8; // uint64_t
-                break;
-            case KM_BIGNUM:
-            case KM_BYTES:
-                size += 4; // uint32_t
-                size += params->params[i].blob.data_length;
-                break;
-            default: // bad tag
-                ret = KM_ERROR_INVALID_TAG;
-                goto end;
-        }
+        total += 4 + value_size; // uint32_t <= keymaster_tag_t, value
     }
 
-    add_key_size = (key_size != 0) && !key_size_present;
-    add_rsa_pubexp = (rsa_pubexp != 0) && !rsa_pubexp_present;
-
     if (add_time) {
-        size += 4 + 8;
+        total += 4 + 8;
     }
-    if (add_key_size) {
-        size += 4 + 4;
+    if ((key_size != 0) && !key_size_present) {
+        total += 4 + 4;
     }
-    if (add_rsa_pubexp) {
-        size += 4 + 8;
+    if ((rsa_pubexp != 0) && !rsa_pubexp_present) {
+        total += 4 + 8;
     }
+    *size = total;
 
-    /* Allocate memory for the buffer */
-    *buf = (uint8_t*)malloc(size);
-    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
-        *buf != NULL);
+end:
+    return ret;
+}
+
+keymaster_error_t km_serialize_params_arena(
+    km_arena_t *arena,
+    const keymaster_key_param_set_t *params,
+    bool add_time,
+    uint32_t key_size,
+    uint64_t rsa_pubexp,
+    uint8_t **buf,
+    uint32_t *buflen)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t *start = NULL;
+    uint8_t *pos = NULL;
+    uint32_t room;
+    uint32_t n_params;
+    uint32_t count;
+    bool key_size_present = false;
+    bool rsa_pubexp_present = false;
 
-    /* Position to the beginning of the buffer */
-    pos = *buf;
+    CHECK_NOT_NULL(arena);
+    CHECK_NOT_NULL(buf);
+    CHECK_NOT_NULL(buflen);
+
+    n_params = (params != NULL) ? params->length : 0;
+    count = n_params;
+    start = pos = arena->base + arena->used;
+    room = arena->size - arena->used;
 
-    /* Copy parameter count */
-    set_u32_increment_pos(&pos, n_params + (add_time       ? 1 : 0)
-                                         + (add_key_size   ? 1 : 0)
-                                         + (add_rsa_pubexp ? 1 : 0));
+#define ARENA_RESERVE(n) \
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, room >= (n)); \
+    room -= (n)
+
+    /* Parameter count, patched once the optional extras are known */
+    ARENA_RESERVE(4);
+    pos += 4;
 
-    /* Copy data */
     for (size_t i = 0; i < n_params; i++) {
-        keymaster_tag_t tag = params->params[i].tag;
+        const keymaster_key_param_t *param = &params->params[i];
+        keymaster_tag_t tag = param->tag;
 
+        ARENA_RESERVE(4);
         set_u32_increment_pos(&pos, tag);
 
         switch (keymaster_tag_get_type(tag)) {
             case KM_ENUM:
             case KM_ENUM_REP:
-                set_u32_increment_pos(&pos, params->params[i].enumerated);
+                ARENA_RESERVE(4);
+                set_u32_increment_pos(&pos, param->enumerated);
                 break;
             case KM_UINT:
             case KM_UINT_REP:
-                set_u32_increment_pos(&pos, params->params[i].integer);
+                ARENA_RESERVE(4);
+                set_u32_increment_pos(&pos, param->integer);
                 break;
             case KM_BOOL:
-                set_u32_increment_pos(&pos, params->params[i].boolean ? 1 : 0);
+                ARENA_RESERVE(4);
+                set_u32_increment_pos(&pos, param->boolean ? 1 : 0);
                 break;
             case KM_ULONG:
             case KM_ULONG_REP:
-                set_u64_increment_pos(&pos, params->params[i].long_integer);
+                ARENA_RESERVE(8);
+                set_u64_increment_pos(&pos, param->long_integer);
                 break;
             case KM_DATE:
-                set_u64_increment_pos(&pos, params->params[i].date_time);
+                ARENA_RESERVE(8);
+                set_u64_increment_pos(&pos, param->date_time);
                 break;
             case KM_BIGNUM:
             case KM_BYTES:
-                set_u32_increment_pos(&pos, params->params[i].blob.data_length);
-                set_data_increment_pos(&pos, params->params[i].blob.data, params->params[i].blob.data_length);
+                ARENA_RESERVE(4);
+                ARENA_RESERVE(param->blob.data_length);
+                set_u32_increment_pos(&pos, param->blob.data_length);
+                set_data_increment_pos(&pos, param->blob.data, param->blob.data_length);
                 break;
             default: // bad tag
                 ret = KM_ERROR_INVALID_TAG;
                 goto end;
         }
+
+        if (tag == KM_TAG_KEY_SIZE) {
+            key_size_present = true;
+        } else if (tag == KM_TAG_RSA_PUBLIC_EXPONENT) {
+            rsa_pubexp_present = true;
+        }
     }
+
     if (add_time) {
         struct timeval tv;
         gettimeofday(&tv, NULL);
+        ARENA_RESERVE(4 + 8);
         set_u32_increment_pos(&pos, KM_TAG_CREATION_DATETIME);
         set_u64_increment_pos(&pos, (uint64_t)tv.tv_usec + 1000000ull*(uint64_t)tv.tv_sec);
+        count++;
     }
-    if (add_key_size) {
+    if ((key_size != 0) && !key_size_present) {
+        ARENA_RESERVE(4 + 4);
         set_u32_increment_pos(&pos, KM_TAG_KEY_SIZE);
         set_u32_increment_pos(&pos, key_size);
+        count++;
     }
-    if (add_rsa_pubexp) {
+    if ((rsa_pubexp != 0) && !rsa_pubexp_present) {
+        ARENA_RESERVE(4 + 8);
         set_u32_increment_pos(&pos, KM_TAG_RSA_PUBLIC_EXPONENT);
         set_u64_increment_pos(&pos, rsa_pubexp);
+        count++;
     }
 
+#undef ARENA_RESERVE
+
+    set_u32(start, count);
+    *buf = start;
+    *buflen = (uint32_t)(pos - start);
+    arena->used += *buflen;
+
 end:
     if (ret != KM_ERROR_OK) {
         if (buf != NULL) {
-            free(*buf);
             *buf = NULL;
         }
         if (buflen != NULL) {
             *buflen = 0;
         }
-    } else {
-        *buflen = size;
     }
     return ret;
 }
 
+keymaster_error_t km_serialize_params(
+    uint8_t **buf,
+    uint32_t *buflen,
+    const keymaster_key_param_set_t *params,
+    bool add_time,
+    uint32_t key_size,
+    uint64_t rsa_pubexp)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t *mem = NULL;
+    uint32_t size = 0;
+    km_arena_t arena;
+
+    CHECK_NOT_NULL(buf);
+    CHECK_NOT_NULL(buflen);
+    *buf = NULL;
+    *buflen = 0;
+
+    CHECK_RESULT_OK(km_serialized_params_size(
+        params, add_time, key_size, rsa_pubexp, &size));
+
+    /* Allocate memory for the buffer */
+    mem = (uint8_t*)malloc(size);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
+        mem != NULL);
+
+    km_arena_init(&arena, mem, size);
+    CHECK_RESULT_OK(km_serialize_params_arena(
+        &arena, params, add_time, key_size, rsa_pubexp, buf, buflen));
+    mem = NULL;
+
+end:
+    free(mem);
+    return ret;
+}
+
+/**
+ * Read the value of a parameter whose tag has been read. BYTES and BIGNUM
+ * values are copied to an allocation of their own.
+ */
+static keymaster_error_t read_param_value(
+    keymaster_key_param_t *param,
+    uint8_t **pos,
+    uint32_t *remain)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint32_t data_length;
+    uint8_t *data;
+
+    switch (keymaster_tag_get_type(param->tag)) {
+        case KM_ENUM:
+        case KM_ENUM_REP:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 4);
+            param->enumerated = get_u32(*pos);
+            *pos += 4; *remain -= 4;
+            break;
+        case KM_UINT:
+        case KM_UINT_REP:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 4);
+            param->integer = get_u32(*pos);
+            *pos += 4; *remain -= 4;
+            break;
+        case KM_BOOL:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 4);
+            param->boolean = (get_u32(*pos) != 0);
+            *pos += 4; *remain -= 4;
+            break;
+        case KM_ULONG:
+        case KM_ULONG_REP:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 8);
+            param->long_integer = get_u64(*pos);
+            *pos += 8; *remain -= 8;
+            break;
+        case KM_DATE:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 8);
+            param->date_time = get_u64(*pos);
+            *pos += 8; *remain -= 8;
+            break;
+        case KM_BIGNUM:
+        case KM_BYTES:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= 4);
+            data_length = get_u32(*pos);
+            *pos += 4; *remain -= 4;
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                *remain >= data_length);
+            data = (uint8_t*)malloc(data_length);
+            CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
+                data != NULL);
+            memcpy(data, *pos, data_length);
+            param->blob.data = data;
+            param->blob.data_length = data_length;
+            *pos += data_length; *remain -= data_length;
+            break;
+        default:
+            ret = KM_ERROR_INVALID_TAG;
+            goto end;
+    }
+
+end:
+    return ret;
+}
+
 keymaster_error_t deserialize_param_set(
     keymaster_key_param_set_t *param_set,
     uint8_t **pos,
@@ -199,25 +371,28 @@ keymaster_error_t deserialize_param_set(
 {
     keymaster_error_t ret = KM_ERROR_OK;
     uint32_t n;
-    uint32_t data_length;
 
     CHECK_NOT_NULL(param_set);
     CHECK_NOT_NULL(pos);
     CHECK_NOT_NULL(remain);
 
+    param_set->params = NULL;
+    param_set->length = 0;
+
     CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
         *remain >= 4);
     n = get_u32(*pos);
     *pos += 4; *remain -= 4;
-    param_set->length = n;
 
-    if (n == 0) {
-        param_set->params = NULL;
-    } else {
+    if (n != 0) {
+        /* Every parameter takes at least 8 bytes on the wire */
+        CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+            n <= *remain / 8);
         param_set->params = (keymaster_key_param_t*)calloc(sizeof(keymaster_key_param_t), n);
         CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
             param_set->params != NULL);
         memset(param_set->params, 0, n * sizeof(keymaster_key_param_t));
+        param_set->length = n;
 
         for (uint32_t i = 0; i < n; i++) {
             keymaster_key_param_t *param = param_set->params + i;
@@ -229,63 +404,15 @@ keymaster_error_t deserialize_param_set(
             *pos += 4; *remain -= 4;
 
             // read value
-            switch (keymaster_tag_get_type(param->tag)) {
-                case KM_ENUM:
-                case KM_ENUM_REP:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 4);
-                    param->enumerated = get_u32(*pos);
-                    *pos += 4; *remain -= 4;
-                    break;
-                case KM_UINT:
-                case KM_UINT_REP:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 4);
-                    param->integer = get_u32(*pos);
-                    *pos += 4; *remain -= 4;
-                    break;
-                case KM_BOOL:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 4);
-                    param->boolean = (get_u32(*pos) != 0);
-                    *pos += 4; *remain -= 4;
-                    break;
-                case KM_ULONG:
-                case KM_ULONG_REP:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 8);
-                    param->long_integer = get_u64(*pos);
-                    *pos += 8; *remain -= 8;
-                    break;
-                case KM_DATE:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 8);
-                    param->date_time = get_u64(*pos);
-                    *pos += 8; *remain -= 8;
-                    break;
-                case KM_BIGNUM:
-                case KM_BYTES:
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= 4);
-                    data_length = get_u32(*pos);
-                    *pos += 4; *remain -= 4;
-                    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
-                        *remain >= data_length);
-                    param->blob.data = (const uint8_t*)malloc(data_length);
-                    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
-                        param->blob.data != NULL);
-                    memcpy((void*)param->blob.data, *pos, data_length);
-                    param->blob.data_length = data_length;
-                    *pos += data_length; *remain -= data_length;
-                    break;
-                default:
-                    ret = KM_ERROR_INVALID_TAG;
-                    goto end;
-            }
+            CHECK_RESULT_OK(read_param_value(param, pos, remain));
         }
     }
 
 end:
+    if ((ret != KM_ERROR_OK) && (param_set != NULL)) {
+        keymaster_free_param_set(param_set);
+        param_set->length = 0;
+    }
     return ret;
 }
 
@@ -108,8 +108,8 @@ TeeKeymasterDevice::TeeKeymasterDevice(hw_module_t* module) :
     device_.get_key_characteristics = get_key_characteristics;
     device_.import_key = import_key;
     device_.export_key = export_key;
-    device_.delete_key = NULL;
-    device_.delete_all_keys = NULL;
+    device_.delete_key = delete_key;
+    device_.delete_all_keys = delete_all_keys;
     device_.begin = begin;
     device_.update = update;
     device_.finish = finish;
@@ -326,6 +326,33 @@ keymaster_error_t TeeKeymasterDevice::export_key(
 }
 
 
+/* Static */
+keymaster_error_t TeeKeymasterDevice::delete_key(
+    const keymaster1_device_t*      dev,
+    const keymaster_key_blob_t*     key)
+{
+    if (dev == NULL)
+    {
+        return KM_ERROR_UNEXPECTED_NULL_POINTER;
+    }
+
+    return convert_device(dev)->impl_->delete_key(key);
+}
+
+
+/* Static */
+keymaster_error_t TeeKeymasterDevice::delete_all_keys(
+    const keymaster1_device_t*      dev)
+{
+    if (dev == NULL)
+    {
+        return KM_ERROR_UNEXPECTED_NULL_POINTER;
+    }
+
+    return convert_device(dev)->impl_->delete_all_keys();
+}
+
+
 /* Static */
 keymaster_error_t TeeKeymasterDevice::begin(
     const keymaster1_device_t*      dev,
@@ -398,3 +425,14 @@ keymaster_error_t TeeKeymasterDevice::abort(
         operation_handle);
 }
 
+
+/* Static */
+void TeeKeymasterDevice::get_key_pool_stats(
+    const keymaster1_device_t*      dev,
+    km_key_pool_stats_t*            stats)
+{
+    if ((dev == NULL) || (stats == NULL)) {
+        return;
+    }
+    convert_device(dev)->impl_->get_key_pool_stats(stats);
+}
@@ -221,6 +221,9 @@ extern inline void keymaster_free_characteristics(keymaster_key_characteristics_
 struct TEE_Session {
     tciMessage_ptr      pTci;
     mcSessionHandle_t   sessionHandle;
+    uint32_t            capabilities; /* TEE_CAP_* advertised by the TA */
+    uint8_t             *pFused; /* WSM for CMD_ID_TEE_UPDATE_FINISH */
+    mcBulkMap_t         fusedInfo;
 };
 
 #define SECURE_OS_TIMEOUT	10000
@@ -522,6 +525,50 @@ end:
     return ret;
 }
 
+/**
+ * Ask the TA which optional commands it implements.
+ *
+ * TAs predating CMD_ID_TEE_GET_CAPABILITIES fail the command, which leaves
+ * the capability mask empty. The fused update/finish buffer is only set up
+ * when the TA advertises that command.
+ */
+static void probe_capabilities(
+    struct TEE_Session *session)
+{
+    mcResult_t mcRet;
+    tciMessage_ptr tci = session->pTci;
+
+    session->capabilities = 0;
+    tci->command.header.commandId = CMD_ID_TEE_GET_CAPABILITIES;
+    tci->get_capabilities.flags = 0;
+    if (transact(&session->sessionHandle, tci) != KM_ERROR_OK) {
+        LOG_I("%s: TA has no optional capabilities", __func__);
+        return;
+    }
+
+    if (tci->get_capabilities.flags & TEE_CAP_KEY_POOL) {
+        session->capabilities |= TEE_CAP_KEY_POOL;
+    }
+
+    if (tci->get_capabilities.flags & TEE_CAP_UPDATE_FINISH) {
+        mcRet = mcMallocWsm(gDeviceId, 0, TEE_FUSED_BUFFER_SIZE, &session->pFused, 0);
+        if (MC_DRV_OK != mcRet) {
+            LOG_E("%s: mcMallocWsm() returned %d", __func__, mcRet);
+            session->pFused = NULL;
+            return;
+        }
+        mcRet = mcMap(&session->sessionHandle, session->pFused,
+            TEE_FUSED_BUFFER_SIZE, &session->fusedInfo);
+        if (MC_DRV_OK != mcRet) {
+            LOG_E("%s: mcMap() returned %d", __func__, mcRet);
+            mcFreeWsm(gDeviceId, session->pFused);
+            session->pFused = NULL;
+            return;
+        }
+        session->capabilities |= TEE_CAP_UPDATE_FINISH;
+    }
+}
+
 keymaster_error_t TEE_Open(TEE_SessionHandle *pSessionHandle)
 {
     struct TEE_Session *session;
@@ -579,6 +626,9 @@ keymaster_error_t TEE_Open(TEE_SessionHandle *pSessionHandle)
         goto end_device;
     }
     *pSessionHandle = (TEE_SessionHandle)session;
+
+    /* Optional features; a TA without them just keeps the basic protocol */
+    probe_capabilities(session);
     goto end;
 
 end_device:
@@ -603,6 +653,14 @@ void TEE_Close(TEE_SessionHandle sessionHandle)
     }
     struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
 
+    if (session->pFused != NULL) {
+        mcRet = mcUnmap(&session->sessionHandle, session->pFused, &session->fusedInfo);
+        if (MC_DRV_OK != mcRet) {
+            LOG_E("%s: mcUnmap() returned %d", __func__, mcRet);
+        }
+        mcFreeWsm(gDeviceId, session->pFused);
+    }
+
     /* Close session */
     mcRet = mcCloseSession(&session->sessionHandle);
     if (MC_DRV_OK != mcRet) {
@@ -651,7 +709,7 @@ keymaster_error_t TEE_AddRngEntropy(
 
     /* Update TCI buffer */
     tci->command.header.commandId = CMD_ID_TEE_ADD_RNG_ENTROPY;
-    tci->add_rng_entropy.rng_data.data = (uint32_t)dataInfo.sVirtualAddr;
+    tci->add_rng_entropy.rng_data.data = (uint32_t)(uintptr_t)dataInfo.sVirtualAddr;
     tci->add_rng_entropy.rng_data.data_length = dataLength;
 
     CHECK_RESULT_OK( transact(session_handle, tci) );
@@ -668,6 +726,36 @@ end:
 }
 
 
+keymaster_error_t TEE_GetCreationParams(
+    const keymaster_key_param_set_t*    params,
+    keymaster_algorithm_t*              algorithm,
+    uint32_t*                           keySizeInBits,
+    uint64_t*                           rsa_pubexp)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    CHECK_NOT_NULL(params);
+    *rsa_pubexp = 0;
+    CHECK_RESULT_OK( get_enumerated_tag(params,
+        KM_TAG_ALGORITHM, (uint32_t*)algorithm) );
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_KEY_SIZE,
+        KM_ERROR_OK == get_integer_tag(params,
+            KM_TAG_KEY_SIZE, keySizeInBits));
+    if (*algorithm == KM_ALGORITHM_RSA) {
+        if (KM_ERROR_OK == get_long_integer_tag(params,
+            KM_TAG_RSA_PUBLIC_EXPONENT, rsa_pubexp))
+        {
+            CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT,
+                (*rsa_pubexp % 2 == 1) && (*rsa_pubexp != 1));
+        } else {
+            *rsa_pubexp = 65537; // default
+        }
+    }
+
+end:
+    return ret;
+}
+
 keymaster_error_t TEE_GenerateKey(
     TEE_SessionHandle                   sessionHandle,
     const keymaster_key_param_set_t*    params,
@@ -705,21 +793,8 @@ keymaster_error_t TEE_GenerateKey(
         sizeof(key_creation_allowed_params) / sizeof(keymaster_tag_t)) );
 
     /* Find algorithm, key size and RSA public exponent */
-    CHECK_RESULT_OK( get_enumerated_tag(params,
-        KM_TAG_ALGORITHM, (uint32_t*)&algorithm) );
-    CHECK_TRUE(KM_ERROR_UNSUPPORTED_KEY_SIZE,
-        KM_ERROR_OK == get_integer_tag(params,
-            KM_TAG_KEY_SIZE, &keySizeInBits));
-    if (algorithm == KM_ALGORITHM_RSA) {
-        if (KM_ERROR_OK == get_long_integer_tag(params,
-            KM_TAG_RSA_PUBLIC_EXPONENT, &rsa_pubexp))
-        {
-            CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT,
-                (rsa_pubexp % 2 == 1) && (rsa_pubexp != 1));
-        } else {
-            rsa_pubexp = 65537; // default
-        }
-    }
+    CHECK_RESULT_OK( TEE_GetCreationParams(params,
+        &algorithm, &keySizeInBits, &rsa_pubexp) );
 
     /* Serialize key parameters */
     CHECK_RESULT_OK(km_serialize_params(
@@ -747,11 +822,11 @@ keymaster_error_t TEE_GenerateKey(
 
     /* Update TCI buffer */
     tci->command.header.commandId = CMD_ID_TEE_GENERATE_KEY;
-    tci->generate_key.params.data = (uint32_t)paramsInfo.sVirtualAddr;
+    tci->generate_key.params.data = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
     tci->generate_key.params.data_length = serializedDataLen;
-    tci->generate_key.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->generate_key.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->generate_key.key_blob.data_length = key_blob->key_material_size;
-    tci->generate_key.characteristics.data = (uint32_t)characteristicsInfo.sVirtualAddr;
+    tci->generate_key.characteristics.data = (uint32_t)(uintptr_t)characteristicsInfo.sVirtualAddr;
     tci->generate_key.characteristics.data_length =
         (characteristics != NULL) ? KM_CHARACTERISTICS_SIZE : 0;
 
@@ -793,6 +868,200 @@ end:
     return ret;
 }
 
+bool TEE_SupportsKeyPool(
+    TEE_SessionHandle                   sessionHandle)
+{
+    struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
+
+    return (session != NULL) &&
+        ((session->capabilities & TEE_CAP_KEY_POOL) != 0);
+}
+
+keymaster_error_t TEE_PregenerateKey(
+    TEE_SessionHandle                   sessionHandle,
+    keymaster_algorithm_t               algorithm,
+    uint32_t                            keySizeInBits,
+    uint64_t                            rsa_pubexp,
+    keymaster_key_blob_t*               unbound_blob)
+{
+    LOG_D("TEE_PregenerateKey");
+
+    keymaster_error_t ret = KM_ERROR_OK;
+    mcBulkMap_t paramsInfo = {0, 0};
+    mcBulkMap_t keyBlobInfo = {0, 0};
+    uint32_t serializedDataLen = 0;
+    uint8_t *pSerializedData = NULL;
+    keymaster_key_param_t key_params[3];
+    keymaster_key_param_set_t paramset = {key_params, 2};
+    struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
+    tciMessage_ptr tci = session->pTci;
+    mcSessionHandle_t* session_handle = &session->sessionHandle;
+
+    CHECK_NOT_NULL(unbound_blob);
+    unbound_blob->key_material = NULL;
+    unbound_blob->key_material_size = 0;
+    CHECK_TRUE(KM_ERROR_UNIMPLEMENTED, TEE_SupportsKeyPool(sessionHandle));
+
+    /* Only the parameters that determine the key material */
+    key_params[0].tag = KM_TAG_ALGORITHM;
+    key_params[0].enumerated = algorithm;
+    key_params[1].tag = KM_TAG_KEY_SIZE;
+    key_params[1].integer = keySizeInBits;
+    if (algorithm == KM_ALGORITHM_RSA) {
+        key_params[2].tag = KM_TAG_RSA_PUBLIC_EXPONENT;
+        key_params[2].long_integer = rsa_pubexp;
+        paramset.length = 3;
+    }
+
+    CHECK_RESULT_OK(km_serialize_params(
+        &pSerializedData, &serializedDataLen, &paramset, false, 0, 0));
+    CHECK_RESULT_OK( map_buffer(session_handle, pSerializedData, serializedDataLen, &paramsInfo) );
+
+    unbound_blob->key_material_size = key_blob_max_size(
+        algorithm, keySizeInBits, serializedDataLen);
+    CHECK_RESULT_OK(km_alloc((uint8_t**)&unbound_blob->key_material,
+        unbound_blob->key_material_size));
+    CHECK_RESULT_OK( map_buffer(session_handle,
+        unbound_blob->key_material, unbound_blob->key_material_size, &keyBlobInfo) );
+
+    tci->command.header.commandId = CMD_ID_TEE_PREGENERATE_KEY;
+    tci->pregenerate_key.params.data = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
+    tci->pregenerate_key.params.data_length = serializedDataLen;
+    tci->pregenerate_key.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
+    tci->pregenerate_key.key_blob.data_length = unbound_blob->key_material_size;
+
+    CHECK_RESULT_OK( transact(session_handle, tci) );
+
+    unbound_blob->key_material_size = tci->pregenerate_key.key_blob.data_length;
+
+end:
+    unmap_buffer(session_handle, pSerializedData, &paramsInfo);
+    if (unbound_blob != NULL) {
+        unmap_buffer(session_handle, unbound_blob->key_material, &keyBlobInfo);
+    }
+    free(pSerializedData);
+
+    if ((ret != KM_ERROR_OK) && (unbound_blob != NULL)) {
+        free((void*)unbound_blob->key_material);
+        unbound_blob->key_material = NULL;
+        unbound_blob->key_material_size = 0;
+    }
+
+    LOG_D("TEE_PregenerateKey exiting with %d", ret);
+    return ret;
+}
+
+keymaster_error_t TEE_FinalizeKey(
+    TEE_SessionHandle                   sessionHandle,
+    const keymaster_key_param_set_t*    params,
+    const keymaster_key_blob_t*         unbound_blob,
+    keymaster_key_blob_t*               key_blob,
+    keymaster_key_characteristics_t**   characteristics)
+{
+    LOG_D("TEE_FinalizeKey");
+    PRINT_PARAM_SET(params);
+
+    keymaster_error_t ret = KM_ERROR_OK;
+    mcBulkMap_t paramsInfo = {0, 0};
+    mcBulkMap_t unboundInfo = {0, 0};
+    mcBulkMap_t keyBlobInfo = {0, 0};
+    mcBulkMap_t characteristicsInfo = {0, 0};
+    uint32_t serializedDataLen = 0;
+    uint32_t keySizeInBits = 0;
+    uint64_t rsa_pubexp = 0;
+    keymaster_algorithm_t algorithm;
+    uint8_t *pSerializedData = NULL;
+    uint8_t *key_chars = NULL;
+    struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
+    tciMessage_ptr tci = session->pTci;
+    mcSessionHandle_t* session_handle = &session->sessionHandle;
+
+    if (characteristics != NULL) {
+        CHECK_RESULT_OK(km_alloc((uint8_t**)characteristics, sizeof(keymaster_key_characteristics_t)));
+    }
+
+    CHECK_NOT_NULL(params);
+    CHECK_NOT_NULL(unbound_blob);
+    CHECK_NOT_NULL(key_blob);
+
+    key_blob->key_material = NULL;
+    CHECK_TRUE(KM_ERROR_UNIMPLEMENTED, TEE_SupportsKeyPool(sessionHandle));
+
+    /* Same checks and serialization as TEE_GenerateKey() */
+    CHECK_RESULT_OK( check_params(params, key_creation_allowed_params,
+        sizeof(key_creation_allowed_params) / sizeof(keymaster_tag_t)) );
+    CHECK_RESULT_OK( TEE_GetCreationParams(params,
+        &algorithm, &keySizeInBits, &rsa_pubexp) );
+    CHECK_RESULT_OK(km_serialize_params(
+        &pSerializedData, &serializedDataLen, params, true, 0, rsa_pubexp));
+
+    CHECK_RESULT_OK( map_buffer(session_handle, pSerializedData, serializedDataLen, &paramsInfo) );
+    CHECK_RESULT_OK( map_buffer(session_handle,
+        unbound_blob->key_material, unbound_blob->key_material_size, &unboundInfo) );
+
+    key_blob->key_material_size = key_blob_max_size(
+        algorithm, keySizeInBits, serializedDataLen);
+    CHECK_RESULT_OK(km_alloc((uint8_t**)&key_blob->key_material, key_blob->key_material_size));
+    CHECK_RESULT_OK( map_buffer(session_handle,
+        key_blob->key_material, key_blob->key_material_size, &keyBlobInfo) );
+
+    if (characteristics != NULL) {
+        CHECK_RESULT_OK(km_alloc(&key_chars, KM_CHARACTERISTICS_SIZE));
+        CHECK_RESULT_OK( map_buffer(session_handle,
+            key_chars, KM_CHARACTERISTICS_SIZE, &characteristicsInfo) );
+    }
+
+    tci->command.header.commandId = CMD_ID_TEE_FINALIZE_KEY;
+    tci->finalize_key.params.data = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
+    tci->finalize_key.params.data_length = serializedDataLen;
+    tci->finalize_key.unbound_blob.data = (uint32_t)(uintptr_t)unboundInfo.sVirtualAddr;
+    tci->finalize_key.unbound_blob.data_length = unbound_blob->key_material_size;
+    tci->finalize_key.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
+    tci->finalize_key.key_blob.data_length = key_blob->key_material_size;
+    tci->finalize_key.characteristics.data = (uint32_t)(uintptr_t)characteristicsInfo.sVirtualAddr;
+    tci->finalize_key.characteristics.data_length =
+        (characteristics != NULL) ? KM_CHARACTERISTICS_SIZE : 0;
+
+    CHECK_RESULT_OK( transact(session_handle, tci) );
+
+    key_blob->key_material_size = tci->finalize_key.key_blob.data_length;
+
+    if (characteristics != NULL) {
+        CHECK_RESULT_OK(km_deserialize_characteristics(
+            *characteristics, key_chars, KM_CHARACTERISTICS_SIZE));
+    }
+end:
+    unmap_buffer(session_handle, pSerializedData, &paramsInfo);
+    if (unbound_blob != NULL) {
+        unmap_buffer(session_handle, unbound_blob->key_material, &unboundInfo);
+    }
+    if (key_blob != NULL) {
+        unmap_buffer(session_handle, key_blob->key_material, &keyBlobInfo);
+    }
+    if (characteristics != NULL) {
+        unmap_buffer(session_handle, key_chars, &characteristicsInfo);
+    }
+
+    free(pSerializedData);
+    free(key_chars);
+
+    if (ret != KM_ERROR_OK) {
+        if (key_blob != NULL) {
+            free((void*)key_blob->key_material);
+            key_blob->key_material = NULL;
+            key_blob->key_material_size = 0;
+        }
+        if (characteristics != NULL) {
+            keymaster_free_characteristics(*characteristics);
+            free(*characteristics);
+            *characteristics = NULL;
+        }
+    }
+
+    LOG_D("TEE_FinalizeKey exiting with %d", ret);
+    return ret;
+}
+
 keymaster_error_t TEE_GetKeyCharacteristics(
     TEE_SessionHandle                 sessionHandle,
     const keymaster_key_blob_t*       key_blob,
@@ -847,15 +1116,15 @@ keymaster_error_t TEE_GetKeyCharacteristics(
 
     /* Now the get_key_characteristics command */
     tci->command.header.commandId = CMD_ID_TEE_GET_KEY_CHARACTERISTICS;
-    tci->get_key_characteristics.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->get_key_characteristics.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->get_key_characteristics.key_blob.data_length = key_blob->key_material_size;
-    tci->get_key_characteristics.client_id.data = (uint32_t)clientIdInfo.sVirtualAddr;
+    tci->get_key_characteristics.client_id.data = (uint32_t)(uintptr_t)clientIdInfo.sVirtualAddr;
     tci->get_key_characteristics.client_id.data_length =
         (client_id != NULL) ? client_id->data_length : 0;
-    tci->get_key_characteristics.app_data.data = (uint32_t)appDataInfo.sVirtualAddr;
+    tci->get_key_characteristics.app_data.data = (uint32_t)(uintptr_t)appDataInfo.sVirtualAddr;
     tci->get_key_characteristics.app_data.data_length =
         (app_data != NULL) ? app_data->data_length : 0;
-    tci->get_key_characteristics.characteristics.data = (uint32_t)characteristicsInfo.sVirtualAddr;
+    tci->get_key_characteristics.characteristics.data = (uint32_t)(uintptr_t)characteristicsInfo.sVirtualAddr;
     tci->get_key_characteristics.characteristics.data_length = KM_CHARACTERISTICS_SIZE;
 
     CHECK_RESULT_OK( transact(session_handle, tci) );
@@ -1165,13 +1434,13 @@ keymaster_error_t TEE_ImportKey(
 
     /* Update TCI buffer */
     tci->command.header.commandId = CMD_ID_TEE_IMPORT_KEY;
-    tci->import_key.params.data = (uint32_t)paramsInfo.sVirtualAddr;
+    tci->import_key.params.data = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
     tci->import_key.params.data_length = serializedDataLen;
-    tci->import_key.key_data.data = (uint32_t)keyDataInfo.sVirtualAddr;
+    tci->import_key.key_data.data = (uint32_t)(uintptr_t)keyDataInfo.sVirtualAddr;
     tci->import_key.key_data.data_length = km_key_data_len;
-    tci->import_key.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->import_key.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->import_key.key_blob.data_length = key_blob->key_material_size;
-    tci->import_key.characteristics.data = (uint32_t)characteristicsInfo.sVirtualAddr;
+    tci->import_key.characteristics.data = (uint32_t)(uintptr_t)characteristicsInfo.sVirtualAddr;
     tci->import_key.characteristics.data_length =
         (characteristics != NULL) ? KM_CHARACTERISTICS_SIZE : 0;
 
@@ -1268,7 +1537,7 @@ keymaster_error_t TEE_ExportKey(
 
     /* First need to determine required length of key data. */
     tci->command.header.commandId = CMD_ID_TEE_GET_KEY_INFO;
-    tci->get_key_info.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->get_key_info.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->get_key_info.key_blob.data_length = key_to_export->key_material_size;
     CHECK_RESULT_OK( transact(session_handle, tci) );
     key_type = tci->get_key_info.key_type;
@@ -1285,15 +1554,15 @@ keymaster_error_t TEE_ExportKey(
 
     /* Now the export_key command */
     tci->command.header.commandId = CMD_ID_TEE_EXPORT_KEY;
-    tci->export_key.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->export_key.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->export_key.key_blob.data_length = key_to_export->key_material_size;
-    tci->export_key.client_id.data = (uint32_t)clientIdInfo.sVirtualAddr;
+    tci->export_key.client_id.data = (uint32_t)(uintptr_t)clientIdInfo.sVirtualAddr;
     tci->export_key.client_id.data_length =
         (client_id != NULL) ? client_id->data_length : 0;
-    tci->export_key.app_data.data = (uint32_t)appDataInfo.sVirtualAddr;
+    tci->export_key.app_data.data = (uint32_t)(uintptr_t)appDataInfo.sVirtualAddr;
     tci->export_key.app_data.data_length =
         (app_data != NULL) ? app_data->data_length : 0;
-    tci->export_key.key_data.data = (uint32_t)keyDataInfo.sVirtualAddr;
+    tci->export_key.key_data.data = (uint32_t)(uintptr_t)keyDataInfo.sVirtualAddr;
     tci->export_key.key_data.data_length = core_pub_data_len;
     CHECK_RESULT_OK( transact(session_handle, tci) );
 
@@ -1388,12 +1657,12 @@ keymaster_error_t TEE_Begin(
     /* Update TCI buffer */
     tci->command.header.commandId = CMD_ID_TEE_BEGIN;
     tci->begin.purpose = purpose;
-    tci->begin.params.data = (uint32_t)paramsInfo.sVirtualAddr;
+    tci->begin.params.data = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
     tci->begin.params.data_length = serializedDataLen;
-    tci->begin.key_blob.data = (uint32_t)keyBlobInfo.sVirtualAddr;
+    tci->begin.key_blob.data = (uint32_t)(uintptr_t)keyBlobInfo.sVirtualAddr;
     tci->begin.key_blob.data_length = key->key_material_size;
     if (out_params != NULL) {
-        tci->begin.out_params.data = (uint32_t)outParamsInfo.sVirtualAddr;
+        tci->begin.out_params.data = (uint32_t)(uintptr_t)outParamsInfo.sVirtualAddr;
         tci->begin.out_params.data_length = TEE_BEGIN_OUT_PARAMS_SIZE;
     } else {
         tci->begin.out_params.data = 0;
@@ -1492,11 +1761,11 @@ static keymaster_error_t update_chunk(
     /* Update TCI buffer */
     tci->command.header.commandId = CMD_ID_TEE_UPDATE;
     tci->update.handle = operation_handle;
-    tci->update.params.data = (uint32_t)paramsInfo->sVirtualAddr;
+    tci->update.params.data = (uint32_t)(uintptr_t)paramsInfo->sVirtualAddr;
     tci->update.params.data_length = paramsInfo->sVirtualLen;
-    tci->update.input.data = (uint32_t)inputInfo.sVirtualAddr;
+    tci->update.input.data = (uint32_t)(uintptr_t)inputInfo.sVirtualAddr;
     tci->update.input.data_length = inputInfo.sVirtualLen;
-    tci->update.output.data = (uint32_t)outputInfo.sVirtualAddr;
+    tci->update.output.data = (uint32_t)(uintptr_t)outputInfo.sVirtualAddr;
     tci->update.output.data_length = outputInfo.sVirtualLen;
 
     CHECK_RESULT_OK( transact(session_handle, tci) );
@@ -1694,11 +1963,11 @@ keymaster_error_t TEE_Finish(
     /* Update TCI buffer */
     tci->command.header.commandId     = CMD_ID_TEE_FINISH;
     tci->finish.handle                = operation_handle;
-    tci->finish.params.data           = (uint32_t)paramsInfo.sVirtualAddr;
+    tci->finish.params.data           = (uint32_t)(uintptr_t)paramsInfo.sVirtualAddr;
     tci->finish.params.data_length    = serializedDataLen;
-    tci->finish.signature.data        = (uint32_t)signatureInfo.sVirtualAddr;
+    tci->finish.signature.data        = (uint32_t)(uintptr_t)signatureInfo.sVirtualAddr;
     tci->finish.signature.data_length = signatureInfo.sVirtualLen;
-    tci->finish.output.data           = (uint32_t)outputInfo.sVirtualAddr;
+    tci->finish.output.data           = (uint32_t)(uintptr_t)outputInfo.sVirtualAddr;
     tci->finish.output.data_length    = outputInfo.sVirtualLen;
 
     CHECK_RESULT_OK( transact(session_handle, tci) );
@@ -1732,6 +2001,142 @@ end:
     return ret;
 }
 
+/** Round an offset in the fused buffer up to the TA's preferred alignment */
+#define FUSED_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+bool TEE_SupportsUpdateFinish(
+    TEE_SessionHandle               sessionHandle)
+{
+    struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
+
+    return (session != NULL) &&
+        ((session->capabilities & TEE_CAP_UPDATE_FINISH) != 0);
+}
+
+keymaster_error_t TEE_UpdateFinish(
+    TEE_SessionHandle               sessionHandle,
+    keymaster_operation_handle_t    operation_handle,
+    const keymaster_key_param_set_t* params,
+    const keymaster_blob_t*         input,
+    const keymaster_blob_t*         signature,
+    keymaster_key_param_set_t*      out_params,
+    keymaster_blob_t*               output)
+{
+    LOG_D("TEE_UpdateFinish");
+    PRINT_PARAM_SET(params);
+    PRINT_BLOB(input);
+    PRINT_BLOB(signature);
+
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint32_t serializedDataLen = 0;
+    uint8_t *pSerializedData = NULL;
+    km_arena_t arena;
+    struct TEE_Session *session = (struct TEE_Session *)sessionHandle;
+    tciMessage_ptr tci;
+    mcSessionHandle_t *session_handle;
+    size_t input_length = (input != NULL) ? input->data_length : 0;
+    size_t signature_length = (signature != NULL) ? signature->data_length : 0;
+    size_t input_offset, signature_offset, output_offset, used = 0;
+    uint32_t base;
+
+    if (output != NULL) {
+        output->data = NULL;
+        output->data_length = 0;
+    }
+
+    /* No output parameters */
+    if (out_params != NULL) {
+        out_params->params = NULL;
+        out_params->length = 0;
+    }
+
+    /* Nothing is sent to the TA before this point, so the caller can still
+     * fall back to TEE_Update() and TEE_Finish().
+     */
+    if (!TEE_SupportsUpdateFinish(sessionHandle) ||
+        (input_length > TEE_FUSED_INPUT_MAX))
+    {
+        return KM_ERROR_UNIMPLEMENTED;
+    }
+    tci = session->pTci;
+    session_handle = &session->sessionHandle;
+
+    /* Check parameters are valid for finish */
+    CHECK_RESULT_OK( check_params(params, op_allowed_params,
+        sizeof(op_allowed_params) / sizeof(keymaster_tag_t)) );
+
+    /* Serialize params straight into the fused buffer */
+    km_arena_init(&arena, session->pFused, TEE_FUSED_BUFFER_SIZE);
+    ret = km_serialize_params_arena(&arena,
+        params, false, 0, 0, &pSerializedData, &serializedDataLen);
+    if (ret == KM_ERROR_INSUFFICIENT_BUFFER_SPACE) {
+        ret = KM_ERROR_UNIMPLEMENTED;
+    }
+    CHECK_RESULT_OK(ret);
+    used = serializedDataLen;
+
+    /* Lay out params | input | signature | output in the fused buffer */
+    input_offset = FUSED_ALIGN(serializedDataLen);
+    signature_offset = FUSED_ALIGN(input_offset + input_length);
+    output_offset = FUSED_ALIGN(signature_offset + signature_length);
+    if (output_offset >= TEE_FUSED_BUFFER_SIZE) {
+        ret = KM_ERROR_UNIMPLEMENTED;
+        goto end;
+    }
+    used = output_offset;
+
+    if (input_length != 0) {
+        memcpy(session->pFused + input_offset, input->data, input_length);
+    }
+    if (signature_length != 0) {
+        memcpy(session->pFused + signature_offset, signature->data, signature_length);
+    }
+
+    /* Update TCI buffer */
+    base = (uint32_t)(uintptr_t)session->fusedInfo.sVirtualAddr;
+    tci->command.header.commandId            = CMD_ID_TEE_UPDATE_FINISH;
+    tci->update_finish.handle                = operation_handle;
+    tci->update_finish.params.data           = base;
+    tci->update_finish.params.data_length    = serializedDataLen;
+    tci->update_finish.input.data            = base + input_offset;
+    tci->update_finish.input.data_length     = input_length;
+    tci->update_finish.signature.data        = base + signature_offset;
+    tci->update_finish.signature.data_length = signature_length;
+    tci->update_finish.output.data           = base + output_offset;
+    tci->update_finish.output.data_length    = TEE_FUSED_BUFFER_SIZE - output_offset;
+
+    CHECK_RESULT_OK( transact(session_handle, tci) );
+
+    /* Copy out the output. The caller must free this. */
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+        tci->update_finish.output.data_length <= TEE_FUSED_BUFFER_SIZE - output_offset);
+    used = output_offset + tci->update_finish.output.data_length;
+    if ((output != NULL) && (tci->update_finish.output.data_length != 0)) {
+        CHECK_RESULT_OK(km_alloc((uint8_t**)&output->data,
+            tci->update_finish.output.data_length));
+        memcpy((uint8_t*)output->data, session->pFused + output_offset,
+            tci->update_finish.output.data_length);
+        output->data_length = tci->update_finish.output.data_length;
+    }
+
+end:
+    /* Plaintext must not linger in shared memory */
+    if (used != 0) {
+        memset(session->pFused, 0, used);
+    }
+
+    if (ret != KM_ERROR_OK) {
+        if (output != NULL) {
+            free((void*)output->data);
+            output->data = NULL;
+            output->data_length = 0;
+        }
+    }
+
+    LOG_D("TEE_UpdateFinish exiting with %d", ret);
+    return ret;
+}
+
 keymaster_error_t TEE_Abort(
     TEE_SessionHandle               sessionHandle,
     keymaster_operation_handle_t    operation_handle)
@@ -29,7 +29,9 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <time.h>
 #include <hardware/keymaster_common.h>
+#include <cutils/properties.h>
 #include <tee_keymaster_device.h>
 #include <trustonic_tee_keymaster_impl.h>
 #include <tlcTeeKeymasterM_if.h>
@@ -113,13 +115,43 @@ static const keymaster_key_format_t symmetric_key_import_formats[]  = { KM_KEY_F
 
 /**
  * Constructor
+ *
+ * Open up to KM_SESSION_POOL_SIZE sessions to the Keymaster TA. Each session
+ * has its own TCI, so calls on different sessions can run concurrently.
  */
-TrustonicTeeKeymasterImpl::TrustonicTeeKeymasterImpl() : session_handle_(NULL)
+TrustonicTeeKeymasterImpl::TrustonicTeeKeymasterImpl()
+    : session_count_(0)
 {
-    keymaster_error_t err = TEE_Open(&session_handle_);
-    if (err != KM_ERROR_OK) {
+    pthread_mutex_init(&pool_lock_, NULL);
+    memset(operations_, 0, sizeof(operations_));
+
+    for (size_t i = 0; i < KM_SESSION_POOL_SIZE; i++) {
+        TEE_SessionHandle handle = NULL;
+        keymaster_error_t err = TEE_Open(&handle);
+        if (err != KM_ERROR_OK) {
+            break;
+        }
+        sessions_[session_count_].handle = handle;
+        sessions_[session_count_].load = 0;
+        sessions_[session_count_].calls = 0;
+        pthread_mutex_init(&sessions_[session_count_].lock, NULL);
+        session_count_++;
+    }
+
+    if (session_count_ == 0) {
         LOG_E("Failed to open session to Keymaster TA.");
-        session_handle_ = NULL;
+    } else if (session_count_ < KM_SESSION_POOL_SIZE) {
+        LOG_I("Opened %zu of %d sessions to Keymaster TA.",
+              session_count_, KM_SESSION_POOL_SIZE);
+    }
+
+    /* Pre-generation ties up a session for up to seconds, so it needs a
+     * second one to leave to callers.
+     */
+    if ((session_count_ > 1) && TEE_SupportsKeyPool(sessions_[0].handle)) {
+        char spec[PROPERTY_VALUE_MAX];
+        property_get(KM_KEY_POOL_PROPERTY, spec, "");
+        key_pool_.start(spec, &pregenerate_key, this);
     }
 }
 
@@ -129,7 +161,318 @@ TrustonicTeeKeymasterImpl::TrustonicTeeKeymasterImpl() : session_handle_(NULL)
  */
 TrustonicTeeKeymasterImpl::~TrustonicTeeKeymasterImpl()
 {
-    TEE_Close(session_handle_);
+    key_pool_.stop();
+    for (size_t i = 0; i < session_count_; i++) {
+        TEE_Close(sessions_[i].handle);
+        pthread_mutex_destroy(&sessions_[i].lock);
+    }
+    pthread_mutex_destroy(&pool_lock_);
+}
+
+/**
+ * Pick the least loaded session and lock it for a call.
+ */
+TrustonicTeeKeymasterImpl::km_session_t* TrustonicTeeKeymasterImpl::acquire_session()
+{
+    km_session_t* session = NULL;
+
+    if (session_count_ == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool_lock_);
+    session = &sessions_[0];
+    for (size_t i = 1; i < session_count_; i++) {
+        if (sessions_[i].load < session->load) {
+            session = &sessions_[i];
+        }
+    }
+    session->load++;
+    session->calls++;
+    pthread_mutex_unlock(&pool_lock_);
+
+    pthread_mutex_lock(&session->lock);
+    return session;
+}
+
+/**
+ * Lock a session for key pre-generation: the least loaded one that has no
+ * call in flight. Operations begun on a session do not keep it from being
+ * picked, since an operation that is never finished or aborted would
+ * otherwise hold off pre-generation until it is evicted. The session is
+ * charged as if it ran more operations than can exist, so that
+ * acquire_session() only picks it when it must.
+ */
+TrustonicTeeKeymasterImpl::km_session_t* TrustonicTeeKeymasterImpl::acquire_idle_session()
+{
+    km_session_t* session = NULL;
+
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < session_count_; i++) {
+        if ((sessions_[i].calls == 0) &&
+                ((session == NULL) || (sessions_[i].load < session->load))) {
+            session = &sessions_[i];
+        }
+    }
+    if ((session == NULL) || (session->load >= KM_MAX_OPERATIONS)) {
+        pthread_mutex_unlock(&pool_lock_);
+        return NULL;
+    }
+    session->load += KM_MAX_OPERATIONS + 1;
+    pthread_mutex_unlock(&pool_lock_);
+
+    pthread_mutex_lock(&session->lock);
+    return session;
+}
+
+void TrustonicTeeKeymasterImpl::release_idle_session(
+    km_session_t* session)
+{
+    pthread_mutex_unlock(&session->lock);
+
+    pthread_mutex_lock(&pool_lock_);
+    session->load -= KM_MAX_OPERATIONS + 1;
+    pthread_mutex_unlock(&pool_lock_);
+}
+
+/**
+ * Fill function of the key pool, run on its thread.
+ */
+keymaster_error_t TrustonicTeeKeymasterImpl::pregenerate_key(
+    void*                           context,
+    keymaster_algorithm_t           algorithm,
+    uint32_t                        key_size,
+    uint64_t                        rsa_pubexp,
+    keymaster_key_blob_t*           unbound_blob)
+{
+    TrustonicTeeKeymasterImpl* impl = static_cast<TrustonicTeeKeymasterImpl*>(context);
+    km_session_t* session = impl->acquire_idle_session();
+    if (session == NULL) {
+        return KM_ERROR_SECURE_HW_BUSY;
+    }
+    keymaster_error_t ret = TEE_PregenerateKey(session->handle,
+        algorithm, key_size, rsa_pubexp, unbound_blob);
+    impl->release_idle_session(session);
+    return ret;
+}
+
+/**
+ * Unlock a session taken with acquire_session(). With keep_load set the
+ * session stays charged for an operation that was begun on it.
+ */
+void TrustonicTeeKeymasterImpl::release_session(
+    km_session_t* session,
+    bool keep_load)
+{
+    pthread_mutex_unlock(&session->lock);
+
+    pthread_mutex_lock(&pool_lock_);
+    session->calls--;
+    if (!keep_load) {
+        session->load--;
+    }
+    pthread_mutex_unlock(&pool_lock_);
+}
+
+/**
+ * Lock the session of a begun operation for a call on it. The call counts
+ * as in flight, so that acquire_idle_session() leaves the session alone.
+ */
+void TrustonicTeeKeymasterImpl::lock_operation_session(
+    km_session_t* session)
+{
+    pthread_mutex_lock(&pool_lock_);
+    session->calls++;
+    pthread_mutex_unlock(&pool_lock_);
+
+    pthread_mutex_lock(&session->lock);
+}
+
+void TrustonicTeeKeymasterImpl::unlock_operation_session(
+    km_session_t* session)
+{
+    pthread_mutex_unlock(&session->lock);
+
+    pthread_mutex_lock(&pool_lock_);
+    session->calls--;
+    pthread_mutex_unlock(&pool_lock_);
+}
+
+/**
+ * Record an operation begun on a session under the TA's handle. The TA
+ * only keeps its handles unique per session, so a handle already live on
+ * another session is refused; so is 0, which marks a free entry.
+ *
+ * @return KM_ERROR_INVALID_OPERATION_HANDLE if the handle is refused,
+ *         KM_ERROR_TOO_MANY_OPERATIONS if the table is full
+ */
+keymaster_error_t TrustonicTeeKeymasterImpl::add_operation(
+    km_session_t*                   session,
+    keymaster_operation_handle_t    operation_handle,
+    keymaster_purpose_t             purpose)
+{
+    km_operation_t* op = NULL;
+
+    if (operation_handle == 0) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < KM_MAX_OPERATIONS; i++) {
+        if (operations_[i].handle == operation_handle) {
+            pthread_mutex_unlock(&pool_lock_);
+            return KM_ERROR_INVALID_OPERATION_HANDLE;
+        }
+        if ((op == NULL) && (operations_[i].handle == 0)) {
+            op = &operations_[i];
+        }
+    }
+    if (op != NULL) {
+        op->handle = operation_handle;
+        op->session = session;
+        op->purpose = purpose;
+    }
+    pthread_mutex_unlock(&pool_lock_);
+
+    return (op != NULL) ? KM_ERROR_OK : KM_ERROR_TOO_MANY_OPERATIONS;
+}
+
+bool TrustonicTeeKeymasterImpl::lookup_operation(
+    keymaster_operation_handle_t    operation_handle,
+    km_operation_t*                 op)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < KM_MAX_OPERATIONS; i++) {
+        if ((operation_handle != 0) && (operations_[i].handle == operation_handle)) {
+            *op = operations_[i];
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock_);
+
+    return found;
+}
+
+void TrustonicTeeKeymasterImpl::drop_operation(
+    keymaster_operation_handle_t    operation_handle)
+{
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < KM_MAX_OPERATIONS; i++) {
+        if ((operation_handle != 0) && (operations_[i].handle == operation_handle)) {
+            operations_[i].session->load--;
+            if (operations_[i].held != NULL) {
+                memset(operations_[i].held, 0, operations_[i].held_length);
+                free(operations_[i].held);
+            }
+            memset(&operations_[i], 0, sizeof(operations_[i]));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock_);
+}
+
+/**
+ * Append update() input to what is held back for an operation.
+ */
+keymaster_error_t TrustonicTeeKeymasterImpl::hold_input(
+    keymaster_operation_handle_t    operation_handle,
+    const keymaster_blob_t*         input)
+{
+    keymaster_error_t ret = KM_ERROR_INVALID_OPERATION_HANDLE;
+
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < KM_MAX_OPERATIONS; i++) {
+        km_operation_t* op = &operations_[i];
+        if ((operation_handle != 0) && (op->handle == operation_handle)) {
+            if (op->held_length + input->data_length > TEE_FUSED_INPUT_MAX) {
+                ret = KM_ERROR_INVALID_INPUT_LENGTH;
+                break;
+            }
+            if (op->held == NULL) {
+                op->held = (uint8_t*)malloc(TEE_FUSED_INPUT_MAX);
+                if (op->held == NULL) {
+                    ret = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+                    break;
+                }
+            }
+            memcpy(op->held + op->held_length, input->data, input->data_length);
+            op->held_length += input->data_length;
+            ret = KM_ERROR_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock_);
+
+    return ret;
+}
+
+/**
+ * Detach the held-back input of an operation. The caller owns held->data.
+ */
+void TrustonicTeeKeymasterImpl::take_held_input(
+    keymaster_operation_handle_t    operation_handle,
+    keymaster_blob_t*               held)
+{
+    held->data = NULL;
+    held->data_length = 0;
+
+    pthread_mutex_lock(&pool_lock_);
+    for (size_t i = 0; i < KM_MAX_OPERATIONS; i++) {
+        km_operation_t* op = &operations_[i];
+        if ((operation_handle != 0) && (op->handle == operation_handle)) {
+            held->data = op->held;
+            held->data_length = op->held_length;
+            op->held = NULL;
+            op->held_length = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock_);
+}
+
+static void free_held_input(
+    keymaster_blob_t*               held)
+{
+    if (held->data != NULL) {
+        memset((uint8_t*)held->data, 0, held->data_length);
+        free((uint8_t*)held->data);
+    }
+    held->data = NULL;
+    held->data_length = 0;
+}
+
+/**
+ * Make output = head | output. Takes ownership of head->data.
+ */
+static keymaster_error_t prepend_output(
+    keymaster_blob_t*               head,
+    keymaster_blob_t*               output)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    if ((output != NULL) && (head->data_length != 0)) {
+        size_t length = head->data_length + output->data_length;
+        uint8_t* data = (uint8_t*)malloc(length);
+        if (data == NULL) {
+            ret = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        } else {
+            memcpy(data, head->data, head->data_length);
+            if (output->data_length != 0) {
+                memcpy(data + head->data_length, output->data, output->data_length);
+            }
+            free((uint8_t*)output->data);
+            output->data = data;
+            output->data_length = length;
+        }
+    }
+    free((uint8_t*)head->data);
+    head->data = NULL;
+    head->data_length = 0;
+
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::get_supported_algorithms(
@@ -376,8 +719,8 @@ keymaster_error_t TrustonicTeeKeymasterImpl::get_supported_export_formats(
     return KM_ERROR_OK;
 }
 
-#define CHECK_SESSION(handle) \
-        if (handle == NULL) { \
+#define CHECK_SESSION(session) \
+        if (session == NULL) { \
             LOG_E("%s: Invalid session handle", __func__); \
             return KM_ERROR_SECURE_HW_COMMUNICATION_FAILED; \
         }\
@@ -386,18 +729,62 @@ keymaster_error_t TrustonicTeeKeymasterImpl::add_rng_entropy(
     const uint8_t*                  data,
     size_t                          data_length)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_AddRngEntropy(session_handle_, data, data_length);
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    keymaster_error_t ret = TEE_AddRngEntropy(session->handle, data, data_length);
+    release_session(session, false);
+    return ret;
 }
 
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Shapes held by the key pool are served by binding a pre-generated key to
+ * params. Each pooled key is discarded after one attempt; if binding fails,
+ * or the pool is empty, the key is generated as before.
+ */
 keymaster_error_t TrustonicTeeKeymasterImpl::generate_key(
     const keymaster_key_param_set_t*    params,
     keymaster_key_blob_t*               key_blob,
     keymaster_key_characteristics_t**   characteristics)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_GenerateKey(session_handle_,
-        params, key_blob, characteristics);
+    uint64_t start = now_us();
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size = 0;
+    uint64_t rsa_pubexp = 0;
+    keymaster_key_blob_t unbound_blob = {NULL, 0};
+    keymaster_error_t ret = KM_ERROR_UNIMPLEMENTED;
+    bool pooled = (params != NULL) &&
+        ((params->length == 0) || (params->params != NULL)) &&
+        (TEE_GetCreationParams(params, &algorithm, &key_size, &rsa_pubexp) == KM_ERROR_OK) &&
+        key_pool_.pooled(algorithm, key_size, rsa_pubexp);
+
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    if (pooled && key_pool_.take(algorithm, key_size, rsa_pubexp, &unbound_blob)) {
+        ret = TEE_FinalizeKey(session->handle,
+            params, &unbound_blob, key_blob, characteristics);
+        TeeKeyPool::discard(&unbound_blob);
+        if (ret != KM_ERROR_OK) {
+            LOG_W("%s: binding a pooled key failed with %d", __func__, ret);
+        }
+    }
+    bool hit = (ret == KM_ERROR_OK);
+    if (!hit) {
+        ret = TEE_GenerateKey(session->handle,
+            params, key_blob, characteristics);
+    }
+    release_session(session, false);
+
+    if (pooled && (ret == KM_ERROR_OK)) {
+        key_pool_.record(hit, now_us() - start);
+    }
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::get_key_characteristics(
@@ -406,9 +793,19 @@ keymaster_error_t TrustonicTeeKeymasterImpl::get_key_characteristics(
     const keymaster_blob_t*         app_data,
     keymaster_key_characteristics_t** characteristics)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_GetKeyCharacteristics(session_handle_,
+    if (key_cache_.get_characteristics(key_blob, client_id, app_data, characteristics)) {
+        return KM_ERROR_OK;
+    }
+
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    keymaster_error_t ret = TEE_GetKeyCharacteristics(session->handle,
         key_blob, client_id, app_data, characteristics);
+    release_session(session, false);
+    if (ret == KM_ERROR_OK) {
+        key_cache_.put_characteristics(key_blob, client_id, app_data, *characteristics);
+    }
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::import_key(
@@ -418,9 +815,12 @@ keymaster_error_t TrustonicTeeKeymasterImpl::import_key(
     keymaster_key_blob_t*           key_blob,
     keymaster_key_characteristics_t** characteristics)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_ImportKey(session_handle_,
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    keymaster_error_t ret = TEE_ImportKey(session->handle,
         params, key_format, key_data, key_blob, characteristics);
+    release_session(session, false);
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::export_key(
@@ -430,11 +830,58 @@ keymaster_error_t TrustonicTeeKeymasterImpl::export_key(
     const keymaster_blob_t*         app_data,
     keymaster_blob_t*               export_data)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_ExportKey(session_handle_,
+    bool cacheable = (export_format == KM_KEY_FORMAT_X509);
+
+    if (cacheable &&
+        key_cache_.get_export(key_to_export, client_id, app_data, export_data))
+    {
+        return KM_ERROR_OK;
+    }
+
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    keymaster_error_t ret = TEE_ExportKey(session->handle,
         export_format, key_to_export, client_id, app_data, export_data);
+    release_session(session, false);
+    if (cacheable && (ret == KM_ERROR_OK)) {
+        key_cache_.put_export(key_to_export, client_id, app_data, export_data);
+    }
+    return ret;
+}
+
+void TrustonicTeeKeymasterImpl::get_key_pool_stats(
+    km_key_pool_stats_t*            stats)
+{
+    key_pool_.get_stats(stats);
 }
 
+/*
+ * Key blobs are self-contained, so there is nothing to delete in the TA;
+ * these only drop what the key cache holds for the blob.
+ */
+keymaster_error_t TrustonicTeeKeymasterImpl::delete_key(
+    const keymaster_key_blob_t*     key)
+{
+    if (key == NULL) {
+        return KM_ERROR_UNEXPECTED_NULL_POINTER;
+    }
+    key_cache_.invalidate(key);
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t TrustonicTeeKeymasterImpl::delete_all_keys()
+{
+    key_cache_.invalidate_all();
+    return KM_ERROR_OK;
+}
+
+/*
+ * Operation state lives in the TA instance behind one session, so begin()
+ * records which session served it and the remaining calls go there. The
+ * caller gets the TA's handle unchanged, since it is the challenge of the
+ * auth tokens the operation checks. Should the TA of another session have
+ * the same handle live, the operation is aborted and begun again.
+ */
 keymaster_error_t TrustonicTeeKeymasterImpl::begin(
     keymaster_purpose_t             purpose,
     const keymaster_key_blob_t*     key,
@@ -442,11 +889,53 @@ keymaster_error_t TrustonicTeeKeymasterImpl::begin(
     keymaster_key_param_set_t*      out_params,
     keymaster_operation_handle_t*   operation_handle)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_Begin(session_handle_,
-        purpose, key, params, out_params, operation_handle);
+    keymaster_operation_handle_t ta_handle = 0;
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    if (operation_handle == NULL) {
+        return KM_ERROR_OUTPUT_PARAMETER_NULL;
+    }
+
+    km_session_t* session = acquire_session();
+    CHECK_SESSION(session);
+    for (int attempt = 0; attempt < KM_BEGIN_ATTEMPTS; attempt++) {
+        ret = TEE_Begin(session->handle,
+            purpose, key, params, out_params, &ta_handle);
+        if (ret != KM_ERROR_OK) {
+            release_session(session, false);
+            return ret;
+        }
+
+        ret = add_operation(session, ta_handle, purpose);
+        if (ret == KM_ERROR_OK) {
+            *operation_handle = ta_handle;
+            release_session(session, true);
+            return KM_ERROR_OK;
+        }
+
+        TEE_Abort(session->handle, ta_handle);
+        if (out_params != NULL) {
+            keymaster_free_param_set(out_params);
+        }
+        if (ret == KM_ERROR_TOO_MANY_OPERATIONS) {
+            LOG_E("%s: Too many operations", __func__);
+            release_session(session, false);
+            return ret;
+        }
+        LOG_I("%s: TA handle is live on another session, beginning again", __func__);
+    }
+
+    LOG_E("%s: No unique TA handle in %d attempts", __func__, KM_BEGIN_ATTEMPTS);
+    release_session(session, false);
+    return KM_ERROR_SECURE_HW_BUSY;
 }
 
+/*
+ * Small sign/verify messages are held back here rather than sent to the TA,
+ * so that finish() can pass them with TEE_UpdateFinish() in one round trip.
+ * Only sign/verify qualify: they produce no output until finish(), whereas
+ * callers expect AES ciphertext back from update().
+ */
 keymaster_error_t TrustonicTeeKeymasterImpl::update(
     keymaster_operation_handle_t    operation_handle,
     const keymaster_key_param_set_t* params,
@@ -455,9 +944,54 @@ keymaster_error_t TrustonicTeeKeymasterImpl::update(
     keymaster_key_param_set_t*      out_params,
     keymaster_blob_t*               output)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_Update(session_handle_,
-        operation_handle, params, input, input_consumed, out_params, output);
+    km_operation_t op;
+    keymaster_error_t ret = KM_ERROR_OK;
+    keymaster_blob_t held = {NULL, 0};
+    keymaster_key_param_set_t no_params = {NULL, 0};
+
+    if (!lookup_operation(operation_handle, &op)) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+
+    lock_operation_session(op.session);
+    if (((op.purpose == KM_PURPOSE_SIGN) || (op.purpose == KM_PURPOSE_VERIFY)) &&
+        ((params == NULL) || (params->length == 0)) &&
+        (input != NULL) && (input_consumed != NULL) &&
+        (op.held_length + input->data_length <= TEE_FUSED_INPUT_MAX) &&
+        TEE_SupportsUpdateFinish(op.session->handle))
+    {
+        ret = hold_input(operation_handle, input);
+        if (ret == KM_ERROR_OK) {
+            *input_consumed = input->data_length;
+            if (out_params != NULL) {
+                out_params->params = NULL;
+                out_params->length = 0;
+            }
+            if (output != NULL) {
+                output->data = NULL;
+                output->data_length = 0;
+            }
+        }
+    } else {
+        /* Too much for the fused path: send what was held back first */
+        take_held_input(operation_handle, &held);
+        if (held.data_length != 0) {
+            size_t held_consumed = 0;
+            ret = TEE_Update(op.session->handle, op.handle,
+                &no_params, &held, &held_consumed, NULL, NULL);
+        }
+        if (ret == KM_ERROR_OK) {
+            ret = TEE_Update(op.session->handle,
+                op.handle, params, input, input_consumed, out_params, output);
+        }
+        free_held_input(&held);
+    }
+    unlock_operation_session(op.session);
+    if (ret != KM_ERROR_OK) {
+        /* The TA invalidates the operation on error */
+        drop_operation(operation_handle);
+    }
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::finish(
@@ -467,14 +1001,57 @@ keymaster_error_t TrustonicTeeKeymasterImpl::finish(
     keymaster_key_param_set_t*      out_params,
     keymaster_blob_t*               output)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_Finish(session_handle_,
-        operation_handle, params, signature, out_params, output);
+    km_operation_t op;
+    keymaster_error_t ret;
+    keymaster_blob_t held = {NULL, 0};
+    keymaster_key_param_set_t no_params = {NULL, 0};
+
+    if (!lookup_operation(operation_handle, &op)) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+
+    take_held_input(operation_handle, &held);
+
+    lock_operation_session(op.session);
+    /* Also saves TEE_Finish() its output-size query when nothing is held */
+    ret = TEE_UpdateFinish(op.session->handle,
+        op.handle, params, &held, signature, out_params, output);
+    if (ret == KM_ERROR_UNIMPLEMENTED) {
+        keymaster_blob_t head = {NULL, 0};
+        ret = KM_ERROR_OK;
+        if (held.data_length != 0) {
+            size_t held_consumed = 0;
+            ret = TEE_Update(op.session->handle, op.handle,
+                &no_params, &held, &held_consumed, NULL, &head);
+        }
+        if (ret == KM_ERROR_OK) {
+            ret = TEE_Finish(op.session->handle,
+                op.handle, params, signature, out_params, output);
+        }
+        if (ret == KM_ERROR_OK) {
+            ret = prepend_output(&head, output);
+        } else {
+            free((uint8_t*)head.data);
+        }
+    }
+    unlock_operation_session(op.session);
+    free_held_input(&held);
+    drop_operation(operation_handle);
+    return ret;
 }
 
 keymaster_error_t TrustonicTeeKeymasterImpl::abort(
     keymaster_operation_handle_t    operation_handle)
 {
-    CHECK_SESSION(session_handle_);
-    return TEE_Abort(session_handle_, operation_handle);
+    km_operation_t op;
+
+    if (!lookup_operation(operation_handle, &op)) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+
+    lock_operation_session(op.session);
+    keymaster_error_t ret = TEE_Abort(op.session->handle, op.handle);
+    unlock_operation_session(op.session);
+    drop_operation(operation_handle);
+    return ret;
 }
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013-2015 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tee_keymaster_device.h"
+#include "test_km_bench.h"
+#ifdef KM_TA_MOCK
+#include "test_km_ta_mock.h"
+#endif
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterBench"
+#include "log.h"
+
+extern struct keystore_module HAL_MODULE_INFO_SYM;
+
+#ifdef KM_TA_MOCK
+#define BENCH_OPTIONS   "w:n:t:s:S:f:T:j:l:h"
+#define BENCH_TRANSPORT "mock"
+#define BENCH_MOCK_USAGE \
+        "  -l <us>     simulated world switch time per TA command (default 200)\n"
+#else
+#define BENCH_OPTIONS   "w:n:t:s:S:f:T:j:h"
+#define BENCH_TRANSPORT "tee"
+#define BENCH_MOCK_USAGE ""
+#endif
+
+static void usage(
+    const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -w <n>      warm-up runs before each measurement (default 3)\n"
+        "  -n <n>      timed runs per client (default 20)\n"
+        "  -t <n>      concurrent clients, 1..%d (default 1)\n"
+        "  -s <bytes>  smallest message size (default %d)\n"
+        "  -S <bytes>  largest message size (default %d)\n"
+        "  -f <text>   only run measurements whose op/case contains text,\n"
+        "              e.g. stream/aes-128 or keygen/\n"
+        "  -T <label>  transport label written to the report (default "
+            BENCH_TRANSPORT ")\n"
+        BENCH_MOCK_USAGE
+        "  -j <file>   write a JSON report to file, - for stdout\n",
+        prog, KM_BENCH_MAX_THREADS, KM_BENCH_MIN_SIZE, KM_BENCH_MAX_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    km_bench_config_t config;
+    const char *json_path = NULL;
+#ifdef KM_TA_MOCK
+    uint32_t latency_us = 200;
+#endif
+    int opt;
+
+    km_bench_default_config(&config);
+    config.transport = BENCH_TRANSPORT;
+    while ((opt = getopt(argc, argv, BENCH_OPTIONS)) != -1) {
+        switch (opt) {
+            case 'w':
+                config.warmup = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                config.threads = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                config.min_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                config.max_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                config.filter = optarg;
+                break;
+            case 'T':
+                config.transport = optarg;
+                break;
+            case 'j':
+                json_path = optarg;
+                break;
+#ifdef KM_TA_MOCK
+            case 'l':
+                latency_us = strtoul(optarg, NULL, 0);
+                break;
+#endif
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if (json_path != NULL) {
+        config.json = (strcmp(json_path, "-") == 0) ? stdout : fopen(json_path, "w");
+        if (config.json == NULL) {
+            fprintf(stderr, "cannot open %s\n", json_path);
+            return 1;
+        }
+    }
+
+#ifdef KM_TA_MOCK
+    /* Host build: the HAL opens its sessions with the TA model */
+    km_ta_mock_register(latency_us);
+#endif
+    TeeKeymasterDevice *device = new TeeKeymasterDevice(&HAL_MODULE_INFO_SYM.common);
+    keymaster1_device_t *keymaster_device = device->keymaster_device();
+
+    LOG_I("Keymaster benchmark: %u warm-up, %u runs x %u client(s), %zu..%zu bytes",
+        config.warmup, config.iterations, config.threads, config.min_size, config.max_size);
+    res = test_km_bench(keymaster_device, &config);
+    if (res != KM_ERROR_OK) {
+        LOG_E("Benchmark finished with error %d", res);
+    }
+
+    if ((config.json != NULL) && (config.json != stdout)) {
+        fclose(config.json);
+    }
+    keymaster_device->common.close(&keymaster_device->common);
+
+    return (res == KM_ERROR_OK) ? 0 : 1;
+}
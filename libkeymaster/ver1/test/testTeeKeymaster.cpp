@@ -37,7 +37,15 @@
 #include "test_km_rsa.h"
 #include "test_km_ec.h"
 #include "test_km_restrictions.h"
+#include "test_km_concurrency.h"
+#include "test_km_key_cache.h"
+#include "test_km_key_pool.h"
+#include "test_km_oneshot.h"
+#include "test_km_serialization.h"
 #include "test_km_util.h"
+#ifdef KM_TA_MOCK
+#include "test_km_ta_mock.h"
+#endif
 
 #undef  LOG_ANDROID
 #undef  LOG_TAG
@@ -397,6 +405,10 @@ end:
 int main(void)
 {
     keymaster_error_t res = KM_ERROR_OK;
+#ifdef KM_TA_MOCK
+    /* Host build: the HAL opens its sessions with the TA model */
+    km_ta_mock_register(0);
+#endif
     TeeKeymasterDevice *device = new TeeKeymasterDevice(&HAL_MODULE_INFO_SYM.common);
     keymaster1_device_t *keymaster_device = device->keymaster_device();
     uint32_t rsa_key_sizes_to_test[] = {512, 1024, 4096};
@@ -410,6 +422,11 @@ int main(void)
     LOG_I("Author: %s", keymaster_device->common.module->author);
     LOG_I("API version: %d" ,keymaster_device->common.module->module_api_version);
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LOG_I("Testing parameter serialization...");
+    CHECK_RESULT_OK(test_km_serialization(200));
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     LOG_I("API smoke test...");
@@ -485,6 +502,26 @@ int main(void)
     //--------------------------------------------------------------------------
     LOG_I("Testing key restrictions...");
     CHECK_RESULT_OK(test_km_restrictions(keymaster_device));
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LOG_I("Testing key cache...");
+    CHECK_RESULT_OK(test_km_key_cache(keymaster_device, 20));
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LOG_I("Testing key pool...");
+    CHECK_RESULT_OK(test_km_key_pool(keymaster_device, 8));
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LOG_I("Testing short operations...");
+    CHECK_RESULT_OK(test_km_oneshot(keymaster_device, 50));
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LOG_I("Testing concurrent clients...");
+    CHECK_RESULT_OK(test_km_concurrency(keymaster_device, 8, 50));
 end:
     return res;
 }
@@ -0,0 +1,814 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <hardware/keymaster1.h>
+
+#include "tee_keymaster_device.h"
+#include "test_km_bench.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterBench"
+#include "log.h"
+
+#define BENCH_HAS_MODE      0x1
+#define BENCH_HAS_PADDING   0x2
+#define BENCH_HAS_DIGEST    0x4
+
+#define BENCH_NAME_MAX      64
+
+/**
+ * One algorithm/padding/block mode/digest combination. Consecutive cases
+ * sharing a key_name also share the keygen and import measurements.
+ */
+typedef struct {
+    const char *key_name;
+    const char *name;
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    keymaster_purpose_t purpose;
+    uint32_t flags;
+    keymaster_block_mode_t block_mode;
+    keymaster_padding_t padding;
+    keymaster_digest_t digest;
+} bench_case_t;
+
+#define AES_CASE(bits, mode, pad, name) \
+    { "aes-" #bits, "aes-" #bits "-" name, KM_ALGORITHM_AES, bits, \
+      KM_PURPOSE_ENCRYPT, BENCH_HAS_MODE | BENCH_HAS_PADDING, \
+      mode, pad, KM_DIGEST_NONE }
+#define HMAC_CASE(digest, name) \
+    { "hmac-" name, "hmac-" name, KM_ALGORITHM_HMAC, 256, \
+      KM_PURPOSE_SIGN, BENCH_HAS_DIGEST, \
+      KM_MODE_ECB, KM_PAD_NONE, digest }
+#define RSA_CASE(pad, digest, name) \
+    { "rsa-2048", "rsa-2048-" name, KM_ALGORITHM_RSA, 2048, \
+      KM_PURPOSE_SIGN, BENCH_HAS_PADDING | BENCH_HAS_DIGEST, \
+      KM_MODE_ECB, pad, digest }
+#define EC_CASE(digest, name) \
+    { "ec-p256", "ec-p256-" name, KM_ALGORITHM_EC, 256, \
+      KM_PURPOSE_SIGN, BENCH_HAS_DIGEST, \
+      KM_MODE_ECB, KM_PAD_NONE, digest }
+
+static const bench_case_t bench_cases[] = {
+    AES_CASE(128, KM_MODE_ECB, KM_PAD_NONE,  "ecb-none"),
+    AES_CASE(128, KM_MODE_ECB, KM_PAD_PKCS7, "ecb-pkcs7"),
+    AES_CASE(128, KM_MODE_CBC, KM_PAD_NONE,  "cbc-none"),
+    AES_CASE(128, KM_MODE_CBC, KM_PAD_PKCS7, "cbc-pkcs7"),
+    AES_CASE(128, KM_MODE_CTR, KM_PAD_NONE,  "ctr-none"),
+    AES_CASE(128, KM_MODE_GCM, KM_PAD_NONE,  "gcm-none"),
+    AES_CASE(256, KM_MODE_ECB, KM_PAD_NONE,  "ecb-none"),
+    AES_CASE(256, KM_MODE_ECB, KM_PAD_PKCS7, "ecb-pkcs7"),
+    AES_CASE(256, KM_MODE_CBC, KM_PAD_NONE,  "cbc-none"),
+    AES_CASE(256, KM_MODE_CBC, KM_PAD_PKCS7, "cbc-pkcs7"),
+    AES_CASE(256, KM_MODE_CTR, KM_PAD_NONE,  "ctr-none"),
+    AES_CASE(256, KM_MODE_GCM, KM_PAD_NONE,  "gcm-none"),
+    HMAC_CASE(KM_DIGEST_SHA1,       "sha1"),
+    HMAC_CASE(KM_DIGEST_SHA_2_224,  "sha224"),
+    HMAC_CASE(KM_DIGEST_SHA_2_256,  "sha256"),
+    HMAC_CASE(KM_DIGEST_SHA_2_384,  "sha384"),
+    HMAC_CASE(KM_DIGEST_SHA_2_512,  "sha512"),
+    RSA_CASE(KM_PAD_RSA_PSS, KM_DIGEST_SHA1,      "pss-sha1"),
+    RSA_CASE(KM_PAD_RSA_PSS, KM_DIGEST_SHA_2_224, "pss-sha224"),
+    RSA_CASE(KM_PAD_RSA_PSS, KM_DIGEST_SHA_2_256, "pss-sha256"),
+    RSA_CASE(KM_PAD_RSA_PSS, KM_DIGEST_SHA_2_384, "pss-sha384"),
+    RSA_CASE(KM_PAD_RSA_PSS, KM_DIGEST_SHA_2_512, "pss-sha512"),
+    RSA_CASE(KM_PAD_RSA_PKCS1_1_5_SIGN, KM_DIGEST_SHA1,      "pkcs1-sha1"),
+    RSA_CASE(KM_PAD_RSA_PKCS1_1_5_SIGN, KM_DIGEST_SHA_2_224, "pkcs1-sha224"),
+    RSA_CASE(KM_PAD_RSA_PKCS1_1_5_SIGN, KM_DIGEST_SHA_2_256, "pkcs1-sha256"),
+    RSA_CASE(KM_PAD_RSA_PKCS1_1_5_SIGN, KM_DIGEST_SHA_2_384, "pkcs1-sha384"),
+    RSA_CASE(KM_PAD_RSA_PKCS1_1_5_SIGN, KM_DIGEST_SHA_2_512, "pkcs1-sha512"),
+    EC_CASE(KM_DIGEST_SHA1,       "sha1"),
+    EC_CASE(KM_DIGEST_SHA_2_224,  "sha224"),
+    EC_CASE(KM_DIGEST_SHA_2_256,  "sha256"),
+    EC_CASE(KM_DIGEST_SHA_2_384,  "sha384"),
+    EC_CASE(KM_DIGEST_SHA_2_512,  "sha512"),
+};
+
+/** What a client measures: one operation is one sample */
+typedef struct {
+    keymaster1_device_t *device;
+    const bench_case_t *bcase;
+    const keymaster_key_blob_t *key_blob;   /**< stream: key to use */
+    const keymaster_blob_t *key_data;       /**< import: key material */
+    keymaster_key_format_t key_format;      /**< import: format of key_data */
+    const uint8_t *message;                 /**< stream: input */
+    size_t message_size;                    /**< stream: bytes per operation */
+} bench_job_t;
+
+typedef keymaster_error_t (*bench_op_t)(
+    const bench_job_t *job);
+
+typedef struct {
+    const bench_job_t *job;
+    bench_op_t op;
+    uint32_t iterations;
+    uint64_t *latency_us;
+    keymaster_error_t res;
+} bench_client_t;
+
+typedef struct {
+    uint32_t samples;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t min_us;
+    uint64_t max_us;
+    uint64_t mean_us;
+    double ops_per_s;
+    double bytes_per_s;
+} bench_stats_t;
+
+typedef struct {
+    keymaster1_device_t *device;
+    const km_bench_config_t *config;
+    bool first_result;
+    keymaster_error_t first_error;
+} bench_run_t;
+
+static bool is_unsupported(
+    keymaster_error_t res)
+{
+    switch (res) {
+        case KM_ERROR_UNSUPPORTED_PURPOSE:
+        case KM_ERROR_INCOMPATIBLE_PURPOSE:
+        case KM_ERROR_UNSUPPORTED_ALGORITHM:
+        case KM_ERROR_INCOMPATIBLE_ALGORITHM:
+        case KM_ERROR_UNSUPPORTED_KEY_SIZE:
+        case KM_ERROR_UNSUPPORTED_BLOCK_MODE:
+        case KM_ERROR_INCOMPATIBLE_BLOCK_MODE:
+        case KM_ERROR_UNSUPPORTED_MAC_LENGTH:
+        case KM_ERROR_UNSUPPORTED_PADDING_MODE:
+        case KM_ERROR_INCOMPATIBLE_PADDING_MODE:
+        case KM_ERROR_UNSUPPORTED_DIGEST:
+        case KM_ERROR_INCOMPATIBLE_DIGEST:
+        case KM_ERROR_UNSUPPORTED_KEY_FORMAT:
+        case KM_ERROR_UNIMPLEMENTED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t digest_bits(
+    keymaster_digest_t digest)
+{
+    switch (digest) {
+        case KM_DIGEST_SHA1:
+            return 160;
+        case KM_DIGEST_SHA_2_224:
+            return 224;
+        case KM_DIGEST_SHA_2_256:
+            return 256;
+        case KM_DIGEST_SHA_2_384:
+            return 384;
+        case KM_DIGEST_SHA_2_512:
+            return 512;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Key authorizations for a case
+ *
+ * @param bcase case
+ * @param[out] params array of at least 8 elements
+ *
+ * @return number of parameters written
+ */
+static size_t key_params(
+    const bench_case_t *bcase,
+    keymaster_key_param_t *params)
+{
+    size_t n = 0;
+
+    params[n].tag = KM_TAG_ALGORITHM;
+    params[n++].enumerated = bcase->algorithm;
+    params[n].tag = KM_TAG_KEY_SIZE;
+    params[n++].integer = bcase->key_size;
+    params[n].tag = KM_TAG_NO_AUTH_REQUIRED;
+    params[n++].boolean = true;
+    params[n].tag = KM_TAG_PURPOSE;
+    params[n++].enumerated = bcase->purpose;
+    if (bcase->algorithm == KM_ALGORITHM_RSA) {
+        params[n].tag = KM_TAG_RSA_PUBLIC_EXPONENT;
+        params[n++].long_integer = 65537;
+    }
+    if (bcase->flags & BENCH_HAS_MODE) {
+        params[n].tag = KM_TAG_BLOCK_MODE;
+        params[n++].enumerated = bcase->block_mode;
+    }
+    if (bcase->flags & BENCH_HAS_PADDING) {
+        params[n].tag = KM_TAG_PADDING;
+        params[n++].enumerated = bcase->padding;
+    }
+    if (bcase->flags & BENCH_HAS_DIGEST) {
+        params[n].tag = KM_TAG_DIGEST;
+        params[n++].enumerated = bcase->digest;
+    }
+    if (bcase->algorithm == KM_ALGORITHM_HMAC) {
+        params[n].tag = KM_TAG_MIN_MAC_LENGTH;
+        params[n++].integer = digest_bits(bcase->digest);
+    } else if ((bcase->flags & BENCH_HAS_MODE) && (bcase->block_mode == KM_MODE_GCM)) {
+        params[n].tag = KM_TAG_MIN_MAC_LENGTH;
+        params[n++].integer = 128;
+    }
+
+    return n;
+}
+
+/**
+ * Operation parameters for a case
+ *
+ * @param bcase case
+ * @param[out] params array of at least 4 elements
+ *
+ * @return number of parameters written
+ */
+static size_t op_params(
+    const bench_case_t *bcase,
+    keymaster_key_param_t *params)
+{
+    size_t n = 0;
+
+    if (bcase->flags & BENCH_HAS_MODE) {
+        params[n].tag = KM_TAG_BLOCK_MODE;
+        params[n++].enumerated = bcase->block_mode;
+    }
+    if (bcase->flags & BENCH_HAS_PADDING) {
+        params[n].tag = KM_TAG_PADDING;
+        params[n++].enumerated = bcase->padding;
+    }
+    if (bcase->flags & BENCH_HAS_DIGEST) {
+        params[n].tag = KM_TAG_DIGEST;
+        params[n++].enumerated = bcase->digest;
+    }
+    if (bcase->algorithm == KM_ALGORITHM_HMAC) {
+        params[n].tag = KM_TAG_MAC_LENGTH;
+        params[n++].integer = digest_bits(bcase->digest);
+    } else if ((bcase->flags & BENCH_HAS_MODE) && (bcase->block_mode == KM_MODE_GCM)) {
+        params[n].tag = KM_TAG_MAC_LENGTH;
+        params[n++].integer = 128;
+    }
+
+    return n;
+}
+
+static keymaster_error_t bench_keygen(
+    const bench_job_t *job)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t params[8];
+    keymaster_key_param_set_t paramset = {params, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+
+    paramset.length = key_params(job->bcase, params);
+    res = job->device->generate_key(job->device, &paramset, &key_blob, NULL);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
+
+static keymaster_error_t bench_import(
+    const bench_job_t *job)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t params[8];
+    keymaster_key_param_set_t paramset = {params, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+
+    paramset.length = key_params(job->bcase, params);
+    res = job->device->import_key(job->device,
+        &paramset, job->key_format, job->key_data, &key_blob, NULL);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
+
+/**
+ * One begin/update/finish sequence over the whole message. update() may
+ * consume less than it is given, so feed it until the message is gone.
+ */
+static keymaster_error_t bench_stream(
+    const bench_job_t *job)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster1_device_t *device = job->device;
+    keymaster_key_param_t params[4];
+    keymaster_key_param_set_t paramset = {params, 0};
+    keymaster_key_param_set_t out_params = {NULL, 0};
+    keymaster_operation_handle_t handle = 0;
+    bool begun = false;
+    keymaster_blob_t output = {0, 0};
+    size_t offset = 0;
+
+    paramset.length = op_params(job->bcase, params);
+    CHECK_RESULT_OK(device->begin(device,
+        job->bcase->purpose, job->key_blob, &paramset, &out_params, &handle));
+    begun = true;
+
+    while (offset < job->message_size) {
+        keymaster_blob_t input = {job->message + offset, job->message_size - offset};
+        size_t input_consumed = 0;
+
+        CHECK_RESULT_OK(device->update(device,
+            handle, NULL, &input, &input_consumed, NULL, &output));
+        km_free_blob(&output);
+        CHECK_TRUE(input_consumed > 0);
+        offset += input_consumed;
+    }
+
+    begun = false;
+    CHECK_RESULT_OK(device->finish(device,
+        handle, NULL, NULL, NULL, &output));
+
+end:
+    if (begun) {
+        device->abort(device, handle);
+    }
+    km_free_blob(&output);
+    keymaster_free_param_set(&out_params);
+
+    return res;
+}
+
+static void *bench_client(
+    void *arg)
+{
+    bench_client_t *client = (bench_client_t *)arg;
+
+    client->res = KM_ERROR_OK;
+    for (uint32_t i = 0; i < client->iterations; i++) {
+        uint64_t start = km_time_us();
+        client->res = client->op(client->job);
+        client->latency_us[i] = km_time_us() - start;
+        if (client->res != KM_ERROR_OK) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_u64(
+    const void *a,
+    const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Nearest-rank percentile of a sorted sample
+ */
+static uint64_t percentile(
+    const uint64_t *sorted,
+    uint32_t n,
+    uint32_t pct)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)pct * n + 99) / 100);
+
+    return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+static void json_string(
+    FILE *f,
+    const char *s)
+{
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if ((*s == '"') || (*s == '\\')) {
+            fprintf(f, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/**
+ * Log one measurement and append it to the JSON report
+ *
+ * @param stats NULL when the measurement was skipped or failed
+ */
+static void report(
+    bench_run_t *run,
+    const char *op,
+    const char *name,
+    size_t size,
+    keymaster_error_t status,
+    const bench_stats_t *stats)
+{
+    FILE *json = run->config->json;
+
+    if (stats != NULL) {
+        LOG_I("%-7s %-22s %9zu B: p50 %8llu us, p99 %8llu us, %10.1f ops/s, %8.2f MB/s",
+            op, name, size,
+            (unsigned long long)stats->p50_us, (unsigned long long)stats->p99_us,
+            stats->ops_per_s, stats->bytes_per_s / (1024 * 1024));
+    } else if (is_unsupported(status)) {
+        LOG_I("%-7s %-22s %9zu B: skipped (%d)", op, name, size, status);
+    } else {
+        LOG_E("%-7s %-22s %9zu B: failed (%d)", op, name, size, status);
+    }
+
+    if (json == NULL) {
+        return;
+    }
+    fprintf(json, "%s\n    {\"op\": \"%s\", \"case\": \"%s\", \"bytes\": %zu, ",
+        run->first_result ? "" : ",", op, name, size);
+    run->first_result = false;
+    if (stats != NULL) {
+        fprintf(json, "\"status\": \"ok\", \"samples\": %u, "
+            "\"p50_us\": %llu, \"p99_us\": %llu, \"min_us\": %llu, \"max_us\": %llu, "
+            "\"mean_us\": %llu, \"ops_per_s\": %.3f, \"bytes_per_s\": %.1f}",
+            stats->samples,
+            (unsigned long long)stats->p50_us, (unsigned long long)stats->p99_us,
+            (unsigned long long)stats->min_us, (unsigned long long)stats->max_us,
+            (unsigned long long)stats->mean_us, stats->ops_per_s, stats->bytes_per_s);
+    } else {
+        fprintf(json, "\"status\": \"%s\", \"error\": %d}",
+            is_unsupported(status) ? "skipped" : "failed", status);
+    }
+    fflush(json);
+}
+
+static bool selected(
+    const km_bench_config_t *config,
+    const char *op,
+    const char *name)
+{
+    char label[BENCH_NAME_MAX];
+
+    if (config->filter == NULL) {
+        return true;
+    }
+    snprintf(label, sizeof(label), "%s/%s", op, name);
+    return strstr(label, config->filter) != NULL;
+}
+
+/**
+ * Warm up on the calling thread, then run the configured number of clients
+ * concurrently and report the merged latencies. Only a failure that is not
+ * an unsupported combination is returned; it is also remembered in run so
+ * that the remaining cases still run.
+ */
+static keymaster_error_t measure(
+    bench_run_t *run,
+    const char *op_name,
+    const char *name,
+    const bench_job_t *job,
+    bench_op_t op)
+{
+    const km_bench_config_t *config = run->config;
+    keymaster_error_t res = KM_ERROR_OK;
+    uint32_t threads = config->threads;
+    uint32_t total = threads * config->iterations;
+    bench_client_t clients[KM_BENCH_MAX_THREADS];
+    pthread_t tids[KM_BENCH_MAX_THREADS];
+    uint32_t started = 0;
+    uint64_t *latency_us = NULL;
+    uint64_t sum = 0, start, elapsed;
+    bench_stats_t stats;
+
+    /* Not CHECK_RESULT_OK: unsupported combinations are expected here */
+    for (uint32_t i = 0; (i < config->warmup) && (res == KM_ERROR_OK); i++) {
+        res = op(job);
+    }
+    if (res != KM_ERROR_OK) {
+        goto end;
+    }
+
+    latency_us = (uint64_t *)malloc(total * sizeof(*latency_us));
+    CHECK_TRUE(latency_us != NULL);
+
+    start = km_time_us();
+    for (uint32_t i = 0; i < threads; i++) {
+        clients[i].job = job;
+        clients[i].op = op;
+        clients[i].iterations = config->iterations;
+        clients[i].latency_us = latency_us + i * config->iterations;
+        clients[i].res = KM_ERROR_OK;
+        if (pthread_create(&tids[i], NULL, bench_client, &clients[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    elapsed = km_time_us() - start;
+
+    CHECK_TRUE(started == threads);
+    for (uint32_t i = 0; i < threads; i++) {
+        CHECK_RESULT_OK(clients[i].res);
+    }
+
+    qsort(latency_us, total, sizeof(*latency_us), compare_u64);
+    for (uint32_t i = 0; i < total; i++) {
+        sum += latency_us[i];
+    }
+    stats.samples = total;
+    stats.p50_us = percentile(latency_us, total, 50);
+    stats.p99_us = percentile(latency_us, total, 99);
+    stats.min_us = latency_us[0];
+    stats.max_us = latency_us[total - 1];
+    stats.mean_us = sum / total;
+    stats.ops_per_s = elapsed ? (double)total * 1000000 / elapsed : 0;
+    stats.bytes_per_s = stats.ops_per_s * job->message_size;
+    report(run, op_name, name, job->message_size, KM_ERROR_OK, &stats);
+
+end:
+    free(latency_us);
+    if (res != KM_ERROR_OK) {
+        report(run, op_name, name, job->message_size, res, NULL);
+        if (is_unsupported(res)) {
+            res = KM_ERROR_OK;
+        } else if (run->first_error == KM_ERROR_OK) {
+            run->first_error = res;
+        }
+    }
+
+    return res;
+}
+
+/**
+ * PKCS#8 encoding of a fresh RSA or EC private key, for the import
+ * measurements. The key is generated once per key_name, outside the timing.
+ */
+static keymaster_error_t make_pkcs8(
+    const bench_case_t *bcase,
+    keymaster_blob_t *key_data)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    EVP_PKEY *pkey = EVP_PKEY_new();
+    RSA *rsa = NULL;
+    BIGNUM *e = NULL;
+    EC_KEY *ec = NULL;
+    PKCS8_PRIV_KEY_INFO *p8 = NULL;
+    uint8_t *buf = NULL, *p;
+    int len;
+
+    CHECK_TRUE(pkey != NULL);
+    if (bcase->algorithm == KM_ALGORITHM_RSA) {
+        rsa = RSA_new();
+        e = BN_new();
+        CHECK_TRUE((rsa != NULL) && (e != NULL) && BN_set_word(e, 65537));
+        CHECK_TRUE(RSA_generate_key_ex(rsa, bcase->key_size, e, NULL));
+        CHECK_TRUE(EVP_PKEY_assign_RSA(pkey, rsa));
+        rsa = NULL; // owned by pkey
+    } else {
+        CHECK_TRUE(bcase->key_size == 256);
+        ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+        CHECK_TRUE((ec != NULL) && EC_KEY_generate_key(ec));
+        CHECK_TRUE(EVP_PKEY_assign_EC_KEY(pkey, ec));
+        ec = NULL; // owned by pkey
+    }
+
+    p8 = EVP_PKEY2PKCS8(pkey);
+    CHECK_TRUE(p8 != NULL);
+    len = i2d_PKCS8_PRIV_KEY_INFO(p8, NULL);
+    CHECK_TRUE(len > 0);
+    buf = (uint8_t *)malloc(len);
+    CHECK_TRUE(buf != NULL);
+    p = buf;
+    CHECK_TRUE(i2d_PKCS8_PRIV_KEY_INFO(p8, &p) == len);
+
+    key_data->data = buf;
+    key_data->data_length = len;
+    buf = NULL;
+
+end:
+    free(buf);
+    PKCS8_PRIV_KEY_INFO_free(p8);
+    EC_KEY_free(ec);
+    RSA_free(rsa);
+    BN_free(e);
+    EVP_PKEY_free(pkey);
+
+    return res;
+}
+
+static keymaster_error_t make_key_data(
+    const bench_case_t *bcase,
+    keymaster_blob_t *key_data,
+    keymaster_key_format_t *key_format)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    uint8_t *buf = NULL;
+
+    if ((bcase->algorithm == KM_ALGORITHM_RSA) || (bcase->algorithm == KM_ALGORITHM_EC)) {
+        *key_format = KM_KEY_FORMAT_PKCS8;
+        return make_pkcs8(bcase, key_data);
+    }
+
+    *key_format = KM_KEY_FORMAT_RAW;
+    buf = (uint8_t *)malloc(BYTES_PER_BITS(bcase->key_size));
+    CHECK_TRUE(buf != NULL);
+    CHECK_TRUE(RAND_bytes(buf, BYTES_PER_BITS(bcase->key_size)) == 1);
+    key_data->data = buf;
+    key_data->data_length = BYTES_PER_BITS(bcase->key_size);
+    buf = NULL;
+
+end:
+    free(buf);
+
+    return res;
+}
+
+static keymaster_error_t bench_key_ops(
+    bench_run_t *run,
+    const bench_case_t *bcase)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_blob_t key_data = {NULL, 0};
+    bench_job_t job;
+
+    memset(&job, 0, sizeof(job));
+    job.device = run->device;
+    job.bcase = bcase;
+
+    if (selected(run->config, "keygen", bcase->key_name)) {
+        measure(run, "keygen", bcase->key_name, &job, bench_keygen);
+    }
+
+    if (selected(run->config, "import", bcase->key_name)) {
+        CHECK_RESULT_OK(make_key_data(bcase, &key_data, &job.key_format));
+        job.key_data = &key_data;
+        measure(run, "import", bcase->key_name, &job, bench_import);
+    }
+
+end:
+    km_free_blob(&key_data);
+    if ((res != KM_ERROR_OK) && (run->first_error == KM_ERROR_OK)) {
+        run->first_error = res;
+    }
+
+    return res;
+}
+
+static keymaster_error_t bench_stream_sizes(
+    bench_run_t *run,
+    const bench_case_t *bcase,
+    const uint8_t *message)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    const km_bench_config_t *config = run->config;
+    keymaster_key_param_t params[8];
+    keymaster_key_param_set_t paramset = {params, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    bench_job_t job;
+
+    if (!selected(config, "stream", bcase->name)) {
+        return KM_ERROR_OK;
+    }
+
+    paramset.length = key_params(bcase, params);
+    res = run->device->generate_key(run->device, &paramset, &key_blob, NULL);
+    if (res != KM_ERROR_OK) {
+        report(run, "stream", bcase->name, 0, res, NULL);
+        if (is_unsupported(res)) {
+            res = KM_ERROR_OK;
+        } else if (run->first_error == KM_ERROR_OK) {
+            run->first_error = res;
+        }
+        return res;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.device = run->device;
+    job.bcase = bcase;
+    job.key_blob = &key_blob;
+    job.message = message;
+    for (size_t size = config->min_size; size <= config->max_size; size *= 4) {
+        job.message_size = size;
+        if ((measure(run, "stream", bcase->name, &job, bench_stream) != KM_ERROR_OK) ||
+            (size > config->max_size / 4)) {
+            break;
+        }
+    }
+
+    km_free_key_blob(&key_blob);
+
+    return KM_ERROR_OK;
+}
+
+void km_bench_default_config(
+    km_bench_config_t *config)
+{
+    config->warmup = 3;
+    config->iterations = 20;
+    config->threads = 1;
+    config->min_size = KM_BENCH_MIN_SIZE;
+    config->max_size = KM_BENCH_MAX_SIZE;
+    config->filter = NULL;
+    config->transport = "tee";
+    config->json = NULL;
+}
+
+keymaster_error_t test_km_bench(
+    keymaster1_device_t *device,
+    const km_bench_config_t *config)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    uint8_t *message = NULL;
+    bench_run_t run = {device, config, true, KM_ERROR_OK};
+    const char *prev_key = NULL;
+    km_key_pool_stats_t pool;
+
+    CHECK_TRUE((config->iterations > 0) &&
+        (config->threads > 0) && (config->threads <= KM_BENCH_MAX_THREADS) &&
+        (config->min_size > 0) && (config->min_size <= config->max_size));
+
+    message = (uint8_t *)malloc(config->max_size);
+    CHECK_TRUE(message != NULL);
+    for (size_t i = 0; i < config->max_size; i++) {
+        message[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    if (config->json != NULL) {
+        fprintf(config->json, "{\n  \"benchmark\": \"keymaster1\",\n  \"transport\": ");
+        json_string(config->json, config->transport);
+        fprintf(config->json, ",\n  \"warmup\": %u,\n  \"iterations\": %u,\n"
+            "  \"threads\": %u,\n  \"results\": [",
+            config->warmup, config->iterations, config->threads);
+    }
+
+    for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        const bench_case_t *bcase = &bench_cases[i];
+
+        if ((prev_key == NULL) || (strcmp(prev_key, bcase->key_name) != 0)) {
+            bench_key_ops(&run, bcase);
+            prev_key = bcase->key_name;
+        }
+        bench_stream_sizes(&run, bcase, message);
+    }
+
+    /* keygen of pooled shapes above is a mix of pool hits and misses */
+    TeeKeymasterDevice::get_key_pool_stats(device, &pool);
+    if (pool.capacity != 0) {
+        LOG_I("key pool: %u hit(s), avg %llu us; %u miss(es), avg %llu us",
+            pool.hits, (unsigned long long)(pool.hits ? pool.hit_us / pool.hits : 0),
+            pool.misses, (unsigned long long)(pool.misses ? pool.miss_us / pool.misses : 0));
+    }
+
+    if (config->json != NULL) {
+        fprintf(config->json, "\n  ],\n  \"key_pool\": {\"capacity\": %u, "
+            "\"hits\": %u, \"hit_avg_us\": %llu, \"misses\": %u, \"miss_avg_us\": %llu}",
+            pool.capacity,
+            pool.hits, (unsigned long long)(pool.hits ? pool.hit_us / pool.hits : 0),
+            pool.misses, (unsigned long long)(pool.misses ? pool.miss_us / pool.misses : 0));
+        fprintf(config->json, "\n}\n");
+        fflush(config->json);
+    }
+    res = run.first_error;
+
+end:
+    free(message);
+
+    return res;
+}
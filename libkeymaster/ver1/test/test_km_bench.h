@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __TEST_KM_BENCH_H__
+#define __TEST_KM_BENCH_H__
+
+#include <stdio.h>
+#include <hardware/keymaster1.h>
+
+/** Smallest and largest message sizes streamed through begin/update/finish */
+#define KM_BENCH_MIN_SIZE   16
+#define KM_BENCH_MAX_SIZE   (16 * 1024 * 1024)
+
+/** Concurrent clients are bounded by the operation table of the HAL */
+#define KM_BENCH_MAX_THREADS 16
+
+typedef struct {
+    uint32_t warmup;        /**< untimed runs before each measurement */
+    uint32_t iterations;    /**< timed runs per client */
+    uint32_t threads;       /**< concurrent clients, 1..KM_BENCH_MAX_THREADS */
+    size_t min_size;        /**< first message size, multiplied by 4 up to max_size */
+    size_t max_size;        /**< last message size */
+    const char *filter;     /**< only run cases whose name contains this, or NULL */
+    const char *transport;  /**< label copied to the report, e.g. "tee" or "mock" */
+    FILE *json;             /**< JSON report destination, or NULL */
+} km_bench_config_t;
+
+/**
+ * Fill in the defaults: 3 warm-up runs, 20 iterations, one client, sizes
+ * from KM_BENCH_MIN_SIZE to KM_BENCH_MAX_SIZE, no filter, no JSON.
+ */
+void km_bench_default_config(
+    km_bench_config_t *config);
+
+/**
+ * Measure key generation and import for every algorithm, and complete
+ * begin/update/finish sequences for every supported algorithm, padding,
+ * block mode and digest combination over the configured message sizes.
+ *
+ * Each measurement reports p50 and p99 latency and throughput through the
+ * log, and as one element of the "results" array when a JSON destination is
+ * configured. Combinations the device does not support are reported as
+ * skipped rather than failing the run.
+ *
+ * @param device device
+ * @param config run parameters
+ *
+ * @return KM_ERROR_OK or error
+ */
+keymaster_error_t test_km_bench(
+    keymaster1_device_t *device,
+    const km_bench_config_t *config);
+
+#endif /* __TEST_KM_BENCH_H__ */
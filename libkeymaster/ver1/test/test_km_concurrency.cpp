@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hardware/keymaster1.h>
+
+#include "test_km_concurrency.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterTest"
+#include "log.h"
+
+#define CONCURRENCY_MESSAGE_SIZE 32
+
+struct concurrency_client_t {
+    keymaster1_device_t *device;
+    const keymaster_key_blob_t *key_blob;
+    uint32_t ops;
+    keymaster_error_t res;
+};
+
+static void *concurrency_client(
+    void *arg)
+{
+    struct concurrency_client_t *client = (struct concurrency_client_t *)arg;
+    keymaster1_device_t *device = client->device;
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[2];
+    keymaster_key_param_set_t paramset = {key_param, 2};
+    keymaster_operation_handle_t handle;
+    uint8_t message[CONCURRENCY_MESSAGE_SIZE];
+    keymaster_blob_t message_blob = {message, sizeof(message)};
+    keymaster_blob_t tag = {0, 0};
+    size_t message_consumed = 0;
+
+    memset(message, 7, sizeof(message));
+
+    key_param[0].tag = KM_TAG_DIGEST;
+    key_param[0].enumerated = KM_DIGEST_SHA_2_256;
+    key_param[1].tag = KM_TAG_MAC_LENGTH;
+    key_param[1].integer = 256;
+
+    for (uint32_t i = 0; i < client->ops; i++) {
+        CHECK_RESULT_OK(device->begin(device,
+            KM_PURPOSE_SIGN,
+            client->key_blob,
+            &paramset,
+            NULL, // no out_params
+            &handle));
+
+        CHECK_RESULT_OK(device->update(device,
+            handle,
+            NULL, // no params
+            &message_blob,
+            &message_consumed,
+            NULL, // no out_params
+            NULL));
+        CHECK_TRUE(message_consumed == sizeof(message));
+
+        CHECK_RESULT_OK(device->finish(device,
+            handle,
+            NULL, // no params
+            NULL, // no signature
+            NULL, // no out_params
+            &tag));
+        CHECK_TRUE(tag.data_length == BYTES_PER_BITS(256));
+        km_free_blob(&tag);
+    }
+
+end:
+    km_free_blob(&tag);
+    client->res = res;
+
+    return NULL;
+}
+
+keymaster_error_t test_km_concurrency(
+    keymaster1_device_t *device,
+    uint32_t max_threads,
+    uint32_t ops_per_thread)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[6];
+    keymaster_key_param_set_t paramset = {key_param, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    pthread_t *threads = NULL;
+    struct concurrency_client_t *clients = NULL;
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = KM_ALGORITHM_HMAC;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = 256;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_SIGN;
+    key_param[4].tag = KM_TAG_DIGEST;
+    key_param[4].enumerated = KM_DIGEST_SHA_2_256;
+    key_param[5].tag = KM_TAG_MIN_MAC_LENGTH;
+    key_param[5].integer = 64;
+    paramset.length = 6;
+    CHECK_RESULT_OK(device->generate_key(device,
+        &paramset,
+        &key_blob,
+        NULL));
+
+    threads = (pthread_t *)malloc(max_threads * sizeof(*threads));
+    clients = (struct concurrency_client_t *)malloc(max_threads * sizeof(*clients));
+    CHECK_TRUE((threads != NULL) && (clients != NULL));
+
+    for (uint32_t n = 1; n <= max_threads; n++) {
+        uint64_t start = km_time_us();
+        uint32_t started = 0;
+
+        for (uint32_t i = 0; i < n; i++) {
+            clients[i].device = device;
+            clients[i].key_blob = &key_blob;
+            clients[i].ops = ops_per_thread;
+            clients[i].res = KM_ERROR_OK;
+            if (pthread_create(&threads[i], NULL, concurrency_client, &clients[i]) != 0) {
+                break;
+            }
+            started++;
+        }
+        for (uint32_t i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        uint64_t elapsed = km_time_us() - start;
+        CHECK_TRUE(started == n);
+        for (uint32_t i = 0; i < n; i++) {
+            CHECK_RESULT_OK(clients[i].res);
+        }
+
+        LOG_I("%u client(s): %u ops in %llu us, %llu ops/s", n, n * ops_per_thread,
+            (unsigned long long)elapsed,
+            (unsigned long long)(elapsed ? (uint64_t)n * ops_per_thread * 1000000 / elapsed : 0));
+    }
+
+end:
+    free(threads);
+    free(clients);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
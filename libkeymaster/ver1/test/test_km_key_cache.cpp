@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <hardware/keymaster1.h>
+
+#include "test_km_key_cache.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterTest"
+#include "log.h"
+
+static bool param_sets_equal(
+    const keymaster_key_param_set_t *a,
+    const keymaster_key_param_set_t *b)
+{
+    if (a->length != b->length) {
+        return false;
+    }
+    for (size_t i = 0; i < a->length; i++) {
+        keymaster_tag_type_t type = keymaster_tag_get_type(a->params[i].tag);
+        if (a->params[i].tag != b->params[i].tag) {
+            return false;
+        }
+        if ((type == KM_BYTES) || (type == KM_BIGNUM)) {
+            if ((a->params[i].blob.data_length != b->params[i].blob.data_length) ||
+                (memcmp(a->params[i].blob.data, b->params[i].blob.data,
+                    a->params[i].blob.data_length) != 0))
+            {
+                return false;
+            }
+        } else if (a->params[i].long_integer != b->params[i].long_integer) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void free_characteristics(
+    keymaster_key_characteristics_t **characteristics)
+{
+    keymaster_free_characteristics(*characteristics);
+    free(*characteristics);
+    *characteristics = NULL;
+}
+
+keymaster_error_t test_km_key_cache(
+    keymaster1_device_t *device,
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[5];
+    keymaster_key_param_set_t paramset = {key_param, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    keymaster_key_characteristics_t *tee_chars = NULL;
+    keymaster_key_characteristics_t *cached_chars = NULL;
+    keymaster_blob_t tee_export = {0, 0};
+    keymaster_blob_t cached_export = {0, 0};
+    uint64_t start, tee_us = 0, cached_us = 0;
+
+    CHECK_TRUE((device->delete_key != NULL) && (iterations > 0));
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = KM_ALGORITHM_EC;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = 256;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_SIGN;
+    key_param[4].tag = KM_TAG_DIGEST;
+    key_param[4].enumerated = KM_DIGEST_SHA_2_256;
+    paramset.length = 5;
+    CHECK_RESULT_OK(device->generate_key(device,
+        &paramset, &key_blob, NULL));
+
+    /* TA path: drop the cached entry before every lookup */
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (tee_chars != NULL) {
+            free_characteristics(&tee_chars);
+        }
+        km_free_blob(&tee_export);
+        CHECK_RESULT_OK(device->delete_key(device, &key_blob));
+
+        start = km_time_us();
+        CHECK_RESULT_OK(device->get_key_characteristics(device,
+            &key_blob, NULL, NULL, &tee_chars));
+        CHECK_RESULT_OK(device->export_key(device,
+            KM_KEY_FORMAT_X509, &key_blob, NULL, NULL, &tee_export));
+        tee_us += km_time_us() - start;
+    }
+
+    /* Cache hits: the last TA lookup above populated the cache */
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (cached_chars != NULL) {
+            free_characteristics(&cached_chars);
+        }
+        km_free_blob(&cached_export);
+
+        start = km_time_us();
+        CHECK_RESULT_OK(device->get_key_characteristics(device,
+            &key_blob, NULL, NULL, &cached_chars));
+        CHECK_RESULT_OK(device->export_key(device,
+            KM_KEY_FORMAT_X509, &key_blob, NULL, NULL, &cached_export));
+        cached_us += km_time_us() - start;
+    }
+
+    CHECK_TRUE(param_sets_equal(&tee_chars->hw_enforced, &cached_chars->hw_enforced));
+    CHECK_TRUE(param_sets_equal(&tee_chars->sw_enforced, &cached_chars->sw_enforced));
+    CHECK_TRUE(tee_export.data_length == cached_export.data_length);
+    CHECK_TRUE(memcmp(tee_export.data, cached_export.data, tee_export.data_length) == 0);
+    /* Each hit must hand out its own copy */
+    CHECK_TRUE(tee_export.data != cached_export.data);
+
+    LOG_I("characteristics+export: TA path %llu us, cache hit %llu us (avg of %u)",
+        (unsigned long long)(tee_us / iterations),
+        (unsigned long long)(cached_us / iterations), iterations);
+
+end:
+    if (tee_chars != NULL) {
+        free_characteristics(&tee_chars);
+    }
+    if (cached_chars != NULL) {
+        free_characteristics(&cached_chars);
+    }
+    km_free_blob(&tee_export);
+    km_free_blob(&cached_export);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
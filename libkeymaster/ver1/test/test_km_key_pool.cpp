@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <hardware/keymaster1.h>
+
+#include "tee_keymaster_device.h"
+#include "test_km_key_pool.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterTest"
+#include "log.h"
+
+/* How long to wait for the pool to fill before the burst */
+#define KEY_POOL_FILL_TIMEOUT_MS    (120 * 1000)
+
+static void wait_for_fill(
+    keymaster1_device_t *device)
+{
+    km_key_pool_stats_t stats;
+
+    for (uint32_t waited = 0; waited < KEY_POOL_FILL_TIMEOUT_MS; waited += 100) {
+        TeeKeymasterDevice::get_key_pool_stats(device, &stats);
+        if (stats.available == stats.capacity) {
+            return;
+        }
+        usleep(100 * 1000);
+    }
+    LOG_I("Key pool holds %u of %u keys after %u ms", stats.available, stats.capacity,
+        KEY_POOL_FILL_TIMEOUT_MS);
+}
+
+static keymaster_error_t test_km_key_pool_burst(
+    keymaster1_device_t *device,
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size,
+    uint32_t keys)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[6];
+    keymaster_key_param_set_t paramset = {key_param, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    keymaster_blob_t *exports = NULL;
+    km_key_pool_stats_t before, after;
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = algorithm;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = key_size;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_SIGN;
+    key_param[4].tag = KM_TAG_DIGEST;
+    key_param[4].enumerated = KM_DIGEST_SHA_2_256;
+    paramset.length = 5;
+    if (algorithm == KM_ALGORITHM_RSA) {
+        key_param[5].tag = KM_TAG_RSA_PUBLIC_EXPONENT;
+        key_param[5].long_integer = 65537;
+        paramset.length = 6;
+    }
+
+    exports = (keymaster_blob_t *)calloc(keys, sizeof(*exports));
+    CHECK_TRUE(exports != NULL);
+
+    wait_for_fill(device);
+    TeeKeymasterDevice::get_key_pool_stats(device, &before);
+
+    for (uint32_t i = 0; i < keys; i++) {
+        CHECK_RESULT_OK(device->generate_key(device,
+            &paramset, &key_blob, NULL));
+        CHECK_RESULT_OK(device->export_key(device,
+            KM_KEY_FORMAT_X509, &key_blob, NULL, NULL, &exports[i]));
+        km_free_key_blob(&key_blob);
+
+        /* Pooled key material must never be handed out twice */
+        for (uint32_t j = 0; j < i; j++) {
+            CHECK_TRUE((exports[j].data_length != exports[i].data_length) ||
+                (memcmp(exports[j].data, exports[i].data, exports[i].data_length) != 0));
+        }
+    }
+
+    TeeKeymasterDevice::get_key_pool_stats(device, &after);
+    after.hits -= before.hits;
+    after.misses -= before.misses;
+    after.hit_us -= before.hit_us;
+    after.miss_us -= before.miss_us;
+    CHECK_TRUE(after.hits + after.misses <= keys);
+
+    LOG_I("%s-%u: %u pool hit(s), avg %llu us; %u pool miss(es), avg %llu us",
+        (algorithm == KM_ALGORITHM_RSA) ? "RSA" : "EC", key_size,
+        after.hits, (unsigned long long)(after.hits ? after.hit_us / after.hits : 0),
+        after.misses, (unsigned long long)(after.misses ? after.miss_us / after.misses : 0));
+
+end:
+    km_free_key_blob(&key_blob);
+    if (exports != NULL) {
+        for (uint32_t i = 0; i < keys; i++) {
+            km_free_blob(&exports[i]);
+        }
+        free(exports);
+    }
+
+    return res;
+}
+
+/* Begin an HMAC operation that is only aborted at the end of the test */
+static keymaster_error_t begin_open_operation(
+    keymaster1_device_t *device,
+    keymaster_key_blob_t *key_blob,
+    keymaster_operation_handle_t *handle)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[6];
+    keymaster_key_param_set_t paramset = {key_param, 6};
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = KM_ALGORITHM_HMAC;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = 256;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_SIGN;
+    key_param[4].tag = KM_TAG_DIGEST;
+    key_param[4].enumerated = KM_DIGEST_SHA_2_256;
+    key_param[5].tag = KM_TAG_MIN_MAC_LENGTH;
+    key_param[5].integer = 256;
+    CHECK_RESULT_OK(device->generate_key(device,
+        &paramset, key_blob, NULL));
+
+    key_param[0].tag = KM_TAG_DIGEST;
+    key_param[0].enumerated = KM_DIGEST_SHA_2_256;
+    key_param[1].tag = KM_TAG_MAC_LENGTH;
+    key_param[1].integer = 256;
+    paramset.length = 2;
+    CHECK_RESULT_OK(device->begin(device,
+        KM_PURPOSE_SIGN, key_blob, &paramset, NULL, handle));
+
+end:
+    return res;
+}
+
+keymaster_error_t test_km_key_pool(
+    keymaster1_device_t *device,
+    uint32_t keys)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_blob_t key_blob = {0, 0};
+    keymaster_operation_handle_t handle = 0;
+    km_key_pool_stats_t stats, drained;
+
+    TeeKeymasterDevice::get_key_pool_stats(device, &stats);
+    if (stats.capacity == 0) {
+        LOG_I("No key pool configured, skipping");
+        return KM_ERROR_OK;
+    }
+
+    /* An operation left open must not hold off pre-generation */
+    CHECK_RESULT_OK(begin_open_operation(device, &key_blob, &handle));
+
+    CHECK_RESULT_OK(test_km_key_pool_burst(device, KM_ALGORITHM_RSA, 2048, keys));
+    CHECK_RESULT_OK(test_km_key_pool_burst(device, KM_ALGORITHM_EC, 256, keys));
+
+    TeeKeymasterDevice::get_key_pool_stats(device, &drained);
+    wait_for_fill(device);
+    TeeKeymasterDevice::get_key_pool_stats(device, &stats);
+    CHECK_TRUE((drained.available == drained.capacity) ||
+        (stats.available > drained.available));
+
+end:
+    if (handle != 0) {
+        device->abort(device, handle);
+    }
+    km_free_key_blob(&key_blob);
+    return res;
+}
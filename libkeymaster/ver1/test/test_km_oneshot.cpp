@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <hardware/keymaster1.h>
+
+#include "test_km_oneshot.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterTest"
+#include "log.h"
+
+#define ONESHOT_MESSAGE_SIZE 256
+
+static keymaster_error_t test_km_oneshot_ec(
+    keymaster1_device_t *device,
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[5];
+    keymaster_key_param_set_t paramset = {key_param, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    keymaster_operation_handle_t handle;
+    uint8_t message[ONESHOT_MESSAGE_SIZE];
+    keymaster_blob_t message_blob = {message, sizeof(message)};
+    keymaster_blob_t sig_output = {0, 0};
+    size_t message_consumed = 0;
+    uint64_t start, total_us = 0;
+
+    memset(message, 0x5a, sizeof(message));
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = KM_ALGORITHM_EC;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = 256;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_SIGN;
+    key_param[4].tag = KM_TAG_DIGEST;
+    key_param[4].enumerated = KM_DIGEST_SHA_2_256;
+    paramset.length = 5;
+    CHECK_RESULT_OK(device->generate_key(device,
+        &paramset, &key_blob, NULL));
+
+    paramset.params = &key_param[4]; // digest only
+    paramset.length = 1;
+    for (uint32_t i = 0; i < iterations; i++) {
+        km_free_blob(&sig_output);
+
+        start = km_time_us();
+        CHECK_RESULT_OK(device->begin(device,
+            KM_PURPOSE_SIGN, &key_blob, &paramset, NULL, &handle));
+        CHECK_RESULT_OK(device->update(device,
+            handle, NULL, &message_blob, &message_consumed, NULL, NULL));
+        CHECK_TRUE(message_consumed == sizeof(message));
+        CHECK_RESULT_OK(device->finish(device,
+            handle, NULL, NULL, NULL, &sig_output));
+        total_us += km_time_us() - start;
+    }
+
+    /* The last signature must verify */
+    CHECK_RESULT_OK(device->begin(device,
+        KM_PURPOSE_VERIFY, &key_blob, &paramset, NULL, &handle));
+    CHECK_RESULT_OK(device->update(device,
+        handle, NULL, &message_blob, &message_consumed, NULL, NULL));
+    CHECK_TRUE(message_consumed == sizeof(message));
+    CHECK_RESULT_OK(device->finish(device,
+        handle, NULL, &sig_output, NULL, NULL));
+
+    LOG_I("ECDSA-P256 sign of %d bytes: %llu us (avg of %u)",
+        ONESHOT_MESSAGE_SIZE, (unsigned long long)(total_us / iterations), iterations);
+
+end:
+    km_free_blob(&sig_output);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
+
+static keymaster_error_t test_km_oneshot_aes_gcm(
+    keymaster1_device_t *device,
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t key_param[8];
+    keymaster_key_param_set_t paramset = {key_param, 0};
+    keymaster_key_param_t param[3];
+    keymaster_key_param_set_t op_paramset = {param, 0};
+    keymaster_key_param_set_t out_paramset = {NULL, 0};
+    keymaster_key_blob_t key_blob = {0, 0};
+    keymaster_operation_handle_t handle;
+    uint8_t message[ONESHOT_MESSAGE_SIZE];
+    keymaster_blob_t message_blob = {message, sizeof(message)};
+    keymaster_blob_t enc_output = {0, 0};
+    keymaster_blob_t enc_final_output = {0, 0};
+    keymaster_blob_t ciphertext = {0, 0};
+    keymaster_blob_t dec_output = {0, 0};
+    keymaster_blob_t dec_final_output = {0, 0};
+    uint8_t *buf = NULL;
+    size_t input_consumed = 0;
+    uint64_t start, total_us = 0;
+
+    memset(message, 0xa5, sizeof(message));
+
+    key_param[0].tag = KM_TAG_ALGORITHM;
+    key_param[0].enumerated = KM_ALGORITHM_AES;
+    key_param[1].tag = KM_TAG_KEY_SIZE;
+    key_param[1].integer = 128;
+    key_param[2].tag = KM_TAG_NO_AUTH_REQUIRED;
+    key_param[2].boolean = true;
+    key_param[3].tag = KM_TAG_PURPOSE;
+    key_param[3].enumerated = KM_PURPOSE_ENCRYPT;
+    key_param[4].tag = KM_TAG_PURPOSE;
+    key_param[4].enumerated = KM_PURPOSE_DECRYPT;
+    key_param[5].tag = KM_TAG_BLOCK_MODE;
+    key_param[5].enumerated = KM_MODE_GCM;
+    key_param[6].tag = KM_TAG_PADDING;
+    key_param[6].enumerated = KM_PAD_NONE;
+    key_param[7].tag = KM_TAG_MIN_MAC_LENGTH;
+    key_param[7].integer = 128;
+    paramset.length = 8;
+    CHECK_RESULT_OK(device->generate_key(device,
+        &paramset, &key_blob, NULL));
+
+    param[0].tag = KM_TAG_BLOCK_MODE;
+    param[0].enumerated = KM_MODE_GCM;
+    param[1].tag = KM_TAG_MAC_LENGTH;
+    param[1].integer = 128;
+    param[2].tag = KM_TAG_PADDING;
+    param[2].enumerated = KM_PAD_NONE;
+    op_paramset.length = 3;
+    for (uint32_t i = 0; i < iterations; i++) {
+        keymaster_free_param_set(&out_paramset);
+        km_free_blob(&enc_output);
+        km_free_blob(&enc_final_output);
+
+        start = km_time_us();
+        CHECK_RESULT_OK(device->begin(device,
+            KM_PURPOSE_ENCRYPT, &key_blob, &op_paramset, &out_paramset, &handle));
+        CHECK_RESULT_OK(device->update(device,
+            handle, NULL, &message_blob, &input_consumed, NULL, &enc_output));
+        CHECK_TRUE(input_consumed == sizeof(message));
+        CHECK_RESULT_OK(device->finish(device,
+            handle, NULL, NULL, NULL, &enc_final_output));
+        total_us += km_time_us() - start;
+    }
+
+    /* Decrypt the last message with the nonce the TA chose for it */
+    CHECK_TRUE((out_paramset.length == 1) && (out_paramset.params[0].tag == KM_TAG_NONCE));
+    buf = (uint8_t*)malloc(enc_output.data_length + enc_final_output.data_length);
+    CHECK_TRUE(buf != NULL);
+    memcpy(buf, enc_output.data, enc_output.data_length);
+    memcpy(buf + enc_output.data_length, enc_final_output.data, enc_final_output.data_length);
+    ciphertext.data = buf;
+    ciphertext.data_length = enc_output.data_length + enc_final_output.data_length;
+    CHECK_TRUE(ciphertext.data_length == sizeof(message) + 16);
+
+    param[2].tag = KM_TAG_NONCE;
+    param[2].blob = out_paramset.params[0].blob;
+    CHECK_RESULT_OK(device->begin(device,
+        KM_PURPOSE_DECRYPT, &key_blob, &op_paramset, NULL, &handle));
+    CHECK_RESULT_OK(device->update(device,
+        handle, NULL, &ciphertext, &input_consumed, NULL, &dec_output));
+    CHECK_TRUE(input_consumed == ciphertext.data_length);
+    CHECK_RESULT_OK(device->finish(device,
+        handle, NULL, NULL, NULL, &dec_final_output));
+    CHECK_TRUE(
+        (dec_output.data_length + dec_final_output.data_length == sizeof(message)) &&
+        (memcmp(message, dec_output.data, dec_output.data_length) == 0) &&
+        (memcmp(message + dec_output.data_length, dec_final_output.data,
+            dec_final_output.data_length) == 0));
+
+    LOG_I("AES-GCM encrypt of %d bytes: %llu us (avg of %u)",
+        ONESHOT_MESSAGE_SIZE, (unsigned long long)(total_us / iterations), iterations);
+
+end:
+    keymaster_free_param_set(&out_paramset);
+    km_free_blob(&enc_output);
+    km_free_blob(&enc_final_output);
+    km_free_blob(&dec_output);
+    km_free_blob(&dec_final_output);
+    free(buf);
+    km_free_key_blob(&key_blob);
+
+    return res;
+}
+
+keymaster_error_t test_km_oneshot(
+    keymaster1_device_t *device,
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+
+    CHECK_TRUE(iterations > 0);
+    CHECK_RESULT_OK(test_km_oneshot_ec(device, iterations));
+    CHECK_RESULT_OK(test_km_oneshot_aes_gcm(device, iterations));
+
+end:
+    return res;
+}
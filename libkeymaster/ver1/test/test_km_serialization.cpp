@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <hardware/keymaster_defs.h>
+
+#include "serialization.h"
+#include "test_km_serialization.h"
+#include "test_km_util.h"
+
+#undef  LOG_ANDROID
+#undef  LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterTest"
+#include "log.h"
+
+#define FUZZ_MAX_PARAMS     12
+#define FUZZ_MAX_BLOB       64
+#define FUZZ_BUFFER_SIZE    (4 + FUZZ_MAX_PARAMS * (8 + FUZZ_MAX_BLOB) + 3 * 12)
+
+/* One tag of each serialized type */
+static const keymaster_tag_t fuzz_tags[] = {
+    KM_TAG_ALGORITHM,           // KM_ENUM
+    KM_TAG_PURPOSE,             // KM_ENUM_REP
+    KM_TAG_KEY_SIZE,            // KM_UINT
+    KM_TAG_NO_AUTH_REQUIRED,    // KM_BOOL
+    KM_TAG_RSA_PUBLIC_EXPONENT, // KM_ULONG
+    KM_TAG_USER_SECURE_ID,      // KM_ULONG_REP
+    KM_TAG_ACTIVE_DATETIME,     // KM_DATE
+    KM_TAG_APPLICATION_ID,      // KM_BYTES
+};
+
+/* Deterministic, so that a failure can be reproduced */
+static uint32_t fuzz_state = 1;
+
+static uint32_t fuzz_rand(void)
+{
+    fuzz_state = fuzz_state * 1103515245 + 12345;
+    return fuzz_state >> 8;
+}
+
+static void random_param_set(
+    keymaster_key_param_set_t *params,
+    keymaster_key_param_t *param,
+    uint8_t blobs[][FUZZ_MAX_BLOB])
+{
+    params->params = param;
+    params->length = fuzz_rand() % (FUZZ_MAX_PARAMS + 1);
+
+    for (size_t i = 0; i < params->length; i++) {
+        param[i].tag = fuzz_tags[fuzz_rand() % (sizeof(fuzz_tags) / sizeof(fuzz_tags[0]))];
+        switch (keymaster_tag_get_type(param[i].tag)) {
+            case KM_BOOL:
+                param[i].boolean = true;
+                break;
+            case KM_BYTES:
+                param[i].blob.data_length = fuzz_rand() % (FUZZ_MAX_BLOB + 1);
+                for (size_t j = 0; j < param[i].blob.data_length; j++) {
+                    blobs[i][j] = (uint8_t)fuzz_rand();
+                }
+                param[i].blob.data = blobs[i];
+                break;
+            default:
+                param[i].long_integer = ((uint64_t)fuzz_rand() << 32) | fuzz_rand();
+                if (keymaster_tag_get_type(param[i].tag) != KM_ULONG &&
+                    keymaster_tag_get_type(param[i].tag) != KM_ULONG_REP &&
+                    keymaster_tag_get_type(param[i].tag) != KM_DATE)
+                {
+                    param[i].long_integer &= 0xFFFFFFFF;
+                }
+                break;
+        }
+    }
+}
+
+static bool param_sets_equal(
+    const keymaster_key_param_set_t *a,
+    const keymaster_key_param_set_t *b)
+{
+    if (a->length != b->length) {
+        return false;
+    }
+    for (size_t i = 0; i < a->length; i++) {
+        keymaster_tag_type_t type = keymaster_tag_get_type(a->params[i].tag);
+        if (a->params[i].tag != b->params[i].tag) {
+            return false;
+        }
+        if ((type == KM_BYTES) || (type == KM_BIGNUM)) {
+            if ((a->params[i].blob.data_length != b->params[i].blob.data_length) ||
+                (memcmp(a->params[i].blob.data, b->params[i].blob.data,
+                    a->params[i].blob.data_length) != 0))
+            {
+                return false;
+            }
+        } else if (type == KM_BOOL) {
+            if (a->params[i].boolean != b->params[i].boolean) {
+                return false;
+            }
+        } else if (a->params[i].long_integer != b->params[i].long_integer) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static keymaster_error_t test_km_serialization_fuzz(
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t param[FUZZ_MAX_PARAMS];
+    uint8_t blobs[FUZZ_MAX_PARAMS][FUZZ_MAX_BLOB];
+    keymaster_key_param_set_t params = {NULL, 0};
+    keymaster_key_param_set_t decoded = {NULL, 0};
+    uint8_t arena_buf[FUZZ_BUFFER_SIZE];
+    uint8_t corrupt[FUZZ_BUFFER_SIZE];
+    uint8_t *serialized = NULL;
+    uint32_t serialized_len = 0;
+    uint8_t *arena_out;
+    uint32_t arena_len;
+    uint32_t size;
+    km_arena_t arena;
+    uint8_t *pos;
+    uint32_t remain;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t key_size = (fuzz_rand() & 1) ? 256 : 0;
+        uint64_t rsa_pubexp = (fuzz_rand() & 1) ? 65537 : 0;
+
+        memset(param, 0, sizeof(param));
+        random_param_set(&params, param, blobs);
+
+        /* Both serializers agree with each other and with the size pass */
+        CHECK_RESULT_OK(km_serialize_params(&serialized, &serialized_len,
+            &params, false, key_size, rsa_pubexp));
+        CHECK_RESULT_OK(km_serialized_params_size(&params,
+            false, key_size, rsa_pubexp, &size));
+        CHECK_TRUE(size == serialized_len);
+        km_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        CHECK_RESULT_OK(km_serialize_params_arena(&arena,
+            &params, false, key_size, rsa_pubexp, &arena_out, &arena_len));
+        CHECK_TRUE(arena_out == arena_buf);
+        CHECK_TRUE(arena.used == arena_len);
+        CHECK_TRUE(arena_len == serialized_len);
+        CHECK_TRUE(memcmp(arena_out, serialized, serialized_len) == 0);
+
+        /* An arena one byte short is left untouched */
+        km_arena_init(&arena, arena_buf, serialized_len - 1);
+        CHECK_RESULT(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, km_serialize_params_arena(&arena,
+            &params, false, key_size, rsa_pubexp, &arena_out, &arena_len));
+        CHECK_TRUE((arena.used == 0) && (arena_out == NULL) && (arena_len == 0));
+
+        /* The deserializer gives back the extended set */
+        pos = serialized;
+        remain = serialized_len;
+        CHECK_RESULT_OK(deserialize_param_set(&decoded, &pos, &remain));
+        CHECK_TRUE(remain == 0);
+        CHECK_TRUE(decoded.length >= params.length);
+        size = decoded.length;
+        decoded.length = params.length; // drop the extras for the comparison
+        CHECK_TRUE(param_sets_equal(&decoded, &params));
+        decoded.length = size;
+        keymaster_free_param_set(&decoded);
+        decoded.length = 0;
+
+        /* Every strict prefix is rejected */
+        for (uint32_t len = 0; len < serialized_len; len++) {
+            pos = serialized;
+            remain = len;
+            CHECK_TRUE(deserialize_param_set(&decoded, &pos, &remain) != KM_ERROR_OK);
+            CHECK_TRUE((decoded.params == NULL) && (decoded.length == 0));
+        }
+
+        /* Corrupted input must not crash or overrun */
+        memcpy(corrupt, serialized, serialized_len);
+        corrupt[fuzz_rand() % serialized_len] ^= (uint8_t)(1 + fuzz_rand() % 255);
+        pos = corrupt;
+        remain = serialized_len;
+        if (deserialize_param_set(&decoded, &pos, &remain) == KM_ERROR_OK) {
+            CHECK_TRUE(pos <= corrupt + serialized_len);
+            keymaster_free_param_set(&decoded);
+            decoded.length = 0;
+        }
+
+        FREE(serialized);
+    }
+
+end:
+    keymaster_free_param_set(&decoded);
+    free(serialized);
+
+    return res;
+}
+
+static keymaster_error_t test_km_serialization_benchmark(
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+    keymaster_key_param_t param[FUZZ_MAX_PARAMS];
+    uint8_t blobs[FUZZ_MAX_PARAMS][FUZZ_MAX_BLOB];
+    keymaster_key_param_set_t params = {param, 0};
+    keymaster_key_param_set_t decoded = {NULL, 0};
+    uint8_t arena_buf[FUZZ_BUFFER_SIZE];
+    uint8_t *serialized = NULL;
+    uint32_t serialized_len = 0;
+    uint8_t *arena_out;
+    uint32_t arena_len;
+    km_arena_t arena;
+    uint8_t *pos;
+    uint32_t remain;
+    uint64_t start, malloc_us, arena_us, deserialize_us;
+
+    /* A typical begin() parameter set */
+    memset(blobs, 0x11, sizeof(blobs));
+    param[0].tag = KM_TAG_BLOCK_MODE;
+    param[0].enumerated = KM_MODE_GCM;
+    param[1].tag = KM_TAG_PADDING;
+    param[1].enumerated = KM_PAD_NONE;
+    param[2].tag = KM_TAG_MAC_LENGTH;
+    param[2].integer = 128;
+    param[3].tag = KM_TAG_NONCE;
+    param[3].blob.data = blobs[0];
+    param[3].blob.data_length = 12;
+    param[4].tag = KM_TAG_APPLICATION_ID;
+    param[4].blob.data = blobs[1];
+    param[4].blob.data_length = 32;
+    params.length = 5;
+
+    start = km_time_us();
+    for (uint32_t i = 0; i < iterations; i++) {
+        CHECK_RESULT_OK(km_serialize_params(&serialized, &serialized_len,
+            &params, false, 0, 0));
+        FREE(serialized);
+    }
+    malloc_us = km_time_us() - start;
+
+    start = km_time_us();
+    for (uint32_t i = 0; i < iterations; i++) {
+        km_arena_init(&arena, arena_buf, sizeof(arena_buf));
+        CHECK_RESULT_OK(km_serialize_params_arena(&arena,
+            &params, false, 0, 0, &arena_out, &arena_len));
+    }
+    arena_us = km_time_us() - start;
+
+    start = km_time_us();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pos = arena_buf;
+        remain = arena_len;
+        CHECK_RESULT_OK(deserialize_param_set(&decoded, &pos, &remain));
+        keymaster_free_param_set(&decoded);
+        decoded.length = 0;
+    }
+    deserialize_us = km_time_us() - start;
+
+    LOG_I("serialize %u bytes: malloc %llu ns, arena %llu ns",
+        arena_len,
+        (unsigned long long)(malloc_us * 1000 / iterations),
+        (unsigned long long)(arena_us * 1000 / iterations));
+    LOG_I("deserialize %u bytes: %llu ns",
+        arena_len,
+        (unsigned long long)(deserialize_us * 1000 / iterations));
+
+end:
+    free(serialized);
+
+    return res;
+}
+
+keymaster_error_t test_km_serialization(
+    uint32_t iterations)
+{
+    keymaster_error_t res = KM_ERROR_OK;
+
+    CHECK_TRUE(iterations > 0);
+    CHECK_RESULT_OK(test_km_serialization_fuzz(iterations));
+    CHECK_RESULT_OK(test_km_serialization_benchmark(100 * iterations));
+
+end:
+    return res;
+}
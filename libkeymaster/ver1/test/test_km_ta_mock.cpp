@@ -0,0 +1,2264 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Model of the Keymaster TA, for host builds over libMcClientMock.
+ *
+ * Commands are answered from the TCI and from the buffers the TLC mapped,
+ * which the model reaches through mcMockResolve(). Key material is kept in
+ * the key blob format of tlTeeKeymaster_Api.h, wrapped with AES-256-GCM under
+ * a fixed key. Operations live in one table for all sessions, so the limit
+ * on concurrent RSA operations applies across sessions as it does on the TA.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+
+#include <hardware/keymaster_defs.h>
+#include <cutils/properties.h>
+
+#include "McClientMock.h"
+#include "tlTeeKeymaster_Api.h"
+#include "km_shared_util.h"
+#include "serialization.h"
+#include "km_util.h"
+#include "test_km_ta_mock.h"
+
+#undef LOG_TAG
+#define LOG_TAG "TlcTeeKeyMasterMock"
+
+#define KM_MOCK_MAX_OPERATIONS      16  /* per session */
+#define KM_MOCK_MAX_RSA_OPERATIONS  3   /* across sessions */
+#define KM_MOCK_OPERATION_SLOTS     128
+
+#define KM_MOCK_BLOB_IV_SIZE        16
+#define KM_MOCK_BLOB_TAG_SIZE       16
+#define KM_MOCK_AES_BLOCK_SIZE      16
+#define KM_MOCK_GCM_NONCE_SIZE      12
+#define KM_MOCK_MAX_MD_BLOCK_SIZE   128 /* SHA-512 */
+
+/* EC curve identifiers of the key data, as in km_encodings.cpp */
+#define ECC_CURVE_NIST_P192 1
+#define ECC_CURVE_NIST_P224 2
+#define ECC_CURVE_NIST_P256 3
+#define ECC_CURVE_NIST_P384 4
+#define ECC_CURVE_NIST_P521 5
+
+/* RSA key components, in the order of the key data */
+#define RSA_N       0
+#define RSA_E       1
+#define RSA_D       2
+#define RSA_P       3
+#define RSA_Q       4
+#define RSA_DP      5
+#define RSA_DQ      6
+#define RSA_QINV    7
+#define RSA_PARTS   8
+
+/**
+ * An opened key blob.
+ */
+typedef struct {
+    uint8_t *material; /**< params_len | params | key_data */
+    uint32_t material_len;
+    keymaster_key_param_set_t params;
+    const uint8_t *key_data; /**< key_type | key_size | core_key_data */
+    uint32_t key_data_len;
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size; /**< bits */
+    const uint8_t *core;
+    uint32_t core_len;
+} km_mock_key_t;
+
+/**
+ * An operation between begin and finish or abort.
+ */
+typedef struct {
+    bool in_use;
+    uint32_t session_id;
+    keymaster_operation_handle_t handle;
+    keymaster_algorithm_t algorithm;
+    keymaster_purpose_t purpose;
+    keymaster_block_mode_t mode;
+    keymaster_padding_t padding;
+    keymaster_digest_t digest;
+    uint32_t mac_length; /**< bytes of HMAC output or GCM tag */
+    EVP_CIPHER_CTX *cipher; /**< AES */
+    EVP_MD_CTX *md; /**< message digest, or inner hash of HMAC */
+    const EVP_MD *md_type;
+    uint8_t hmac_opad[KM_MOCK_MAX_MD_BLOCK_SIZE];
+    RSA *rsa;
+    EVP_PKEY *pkey; /**< RSA */
+    EC_KEY *ec;
+    uint8_t *data; /**< buffered input, or GCM tag held back on decrypt */
+    uint32_t data_len;
+    uint32_t data_max;
+} km_mock_op_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static km_mock_op_t g_ops[KM_MOCK_OPERATION_SLOTS];
+static mcMockTa_t g_ta;
+
+static const uint8_t g_wrap_key[32] = {
+    0x6b, 0x6d, 0x2d, 0x6d, 0x6f, 0x63, 0x6b, 0x2d,
+    0x77, 0x72, 0x61, 0x70, 0x2d, 0x6b, 0x65, 0x79,
+    0x2d, 0x6e, 0x6f, 0x74, 0x2d, 0x61, 0x2d, 0x73,
+    0x65, 0x63, 0x72, 0x65, 0x74, 0x2e, 0x2e, 0x2e };
+/* Keeps unbound blobs from passing as key blobs and vice versa */
+static const uint8_t g_bound_aad[] = "key blob";
+static const uint8_t g_unbound_aad[] = "unbound key blob";
+
+#if defined(OPENSSL_IS_BORINGSSL) || (OPENSSL_VERSION_NUMBER < 0x10100000L)
+static void km_mock_rsa_get(
+    const RSA *rsa,
+    const BIGNUM *bn[RSA_PARTS])
+{
+    bn[RSA_N] = rsa->n;
+    bn[RSA_E] = rsa->e;
+    bn[RSA_D] = rsa->d;
+    bn[RSA_P] = rsa->p;
+    bn[RSA_Q] = rsa->q;
+    bn[RSA_DP] = rsa->dmp1;
+    bn[RSA_DQ] = rsa->dmq1;
+    bn[RSA_QINV] = rsa->iqmp;
+}
+
+static void km_mock_rsa_set(
+    RSA *rsa,
+    BIGNUM *bn[RSA_PARTS])
+{
+    rsa->n = bn[RSA_N];
+    rsa->e = bn[RSA_E];
+    rsa->d = bn[RSA_D];
+    rsa->p = bn[RSA_P];
+    rsa->q = bn[RSA_Q];
+    rsa->dmp1 = bn[RSA_DP];
+    rsa->dmq1 = bn[RSA_DQ];
+    rsa->iqmp = bn[RSA_QINV];
+}
+#else
+static void km_mock_rsa_get(
+    const RSA *rsa,
+    const BIGNUM *bn[RSA_PARTS])
+{
+    RSA_get0_key(rsa, &bn[RSA_N], &bn[RSA_E], &bn[RSA_D]);
+    RSA_get0_factors(rsa, &bn[RSA_P], &bn[RSA_Q]);
+    RSA_get0_crt_params(rsa, &bn[RSA_DP], &bn[RSA_DQ], &bn[RSA_QINV]);
+}
+
+static void km_mock_rsa_set(
+    RSA *rsa,
+    BIGNUM *bn[RSA_PARTS])
+{
+    RSA_set0_key(rsa, bn[RSA_N], bn[RSA_E], bn[RSA_D]);
+    RSA_set0_factors(rsa, bn[RSA_P], bn[RSA_Q]);
+    RSA_set0_crt_params(rsa, bn[RSA_DP], bn[RSA_DQ], bn[RSA_QINV]);
+}
+#endif
+
+static void free_secret(
+    uint8_t *data,
+    uint32_t len)
+{
+    if (data != NULL) {
+        OPENSSL_cleanse(data, len);
+        free(data);
+    }
+}
+
+/**
+ * Client memory of a data blob of the TCI.
+ *
+ * @param session_id session the TLC mapped the buffer in
+ * @param blob data blob
+ * @param[out] ptr client address, or NULL if the blob is empty
+ *
+ * @return KM_ERROR_OK, or KM_ERROR_INVALID_ARGUMENT if the blob is not mapped
+ */
+static keymaster_error_t resolve(
+    uint32_t session_id,
+    const data_blob_t *blob,
+    uint8_t **ptr)
+{
+    *ptr = NULL;
+    if (blob->data_length == 0) {
+        return KM_ERROR_OK;
+    }
+    *ptr = (uint8_t*)mcMockResolve(session_id, blob->data, blob->data_length);
+    return (*ptr != NULL) ? KM_ERROR_OK : KM_ERROR_INVALID_ARGUMENT;
+}
+
+static keymaster_error_t read_params(
+    uint8_t *params,
+    uint32_t params_len,
+    keymaster_key_param_set_t *set)
+{
+    uint8_t *pos = params;
+    uint32_t remain = params_len;
+
+    set->params = NULL;
+    set->length = 0;
+    if (params == NULL) {
+        return KM_ERROR_OK;
+    }
+    return deserialize_param_set(set, &pos, &remain);
+}
+
+static const keymaster_key_param_t *find_param(
+    const keymaster_key_param_set_t *set,
+    keymaster_tag_t tag)
+{
+    for (size_t i = 0; i < set->length; i++) {
+        if (set->params[i].tag == tag) {
+            return &set->params[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Value of an enumerated tag: the one in \p request if there is one, else the
+ * first one of \p key, else \p dflt.
+ */
+static uint32_t request_or_key_enum(
+    const keymaster_key_param_set_t *request,
+    const keymaster_key_param_set_t *key,
+    keymaster_tag_t tag,
+    uint32_t dflt)
+{
+    const keymaster_key_param_t *param = find_param(request, tag);
+
+    if (param == NULL) {
+        param = find_param(key, tag);
+    }
+    return (param != NULL) ? param->enumerated : dflt;
+}
+
+static const EVP_MD *digest_md(
+    keymaster_digest_t digest)
+{
+    switch (digest) {
+        case KM_DIGEST_MD5:
+            return EVP_md5();
+        case KM_DIGEST_SHA1:
+            return EVP_sha1();
+        case KM_DIGEST_SHA_2_224:
+            return EVP_sha224();
+        case KM_DIGEST_SHA_2_256:
+            return EVP_sha256();
+        case KM_DIGEST_SHA_2_384:
+            return EVP_sha384();
+        case KM_DIGEST_SHA_2_512:
+            return EVP_sha512();
+        default:
+            return NULL;
+    }
+}
+
+static uint32_t ec_curve(
+    uint32_t key_size)
+{
+    switch (key_size) {
+        case 192:
+            return ECC_CURVE_NIST_P192;
+        case 224:
+            return ECC_CURVE_NIST_P224;
+        case 256:
+            return ECC_CURVE_NIST_P256;
+        case 384:
+            return ECC_CURVE_NIST_P384;
+        case 521:
+            return ECC_CURVE_NIST_P521;
+        default:
+            return 0;
+    }
+}
+
+static int ec_curve_nid(
+    uint32_t curve)
+{
+    switch (curve) {
+        case ECC_CURVE_NIST_P192:
+            return NID_X9_62_prime192v1;
+        case ECC_CURVE_NIST_P224:
+            return NID_secp224r1;
+        case ECC_CURVE_NIST_P256:
+            return NID_X9_62_prime256v1;
+        case ECC_CURVE_NIST_P384:
+            return NID_secp384r1;
+        case ECC_CURVE_NIST_P521:
+            return NID_secp521r1;
+        default:
+            return NID_undef;
+    }
+}
+
+static bool key_size_supported(
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size)
+{
+    switch (algorithm) {
+        case KM_ALGORITHM_RSA:
+            return (key_size >= 256) && (key_size <= 4096) && (key_size % 8 == 0);
+        case KM_ALGORITHM_EC:
+            return ec_curve(key_size) != 0;
+        case KM_ALGORITHM_AES:
+            return (key_size == 128) || (key_size == 192) || (key_size == 256);
+        case KM_ALGORITHM_HMAC:
+            return (key_size >= 64) && (key_size <= 1024);
+        default:
+            return false;
+    }
+}
+
+/**
+ * Algorithm, key size and RSA public exponent asked for in key parameters.
+ */
+static keymaster_error_t read_key_spec(
+    const keymaster_key_param_set_t *params,
+    keymaster_algorithm_t *algorithm,
+    uint32_t *key_size,
+    uint64_t *rsa_pubexp)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_ALGORITHM,
+        get_enumerated_tag(params, KM_TAG_ALGORITHM, (uint32_t*)algorithm) == KM_ERROR_OK);
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_KEY_SIZE,
+        get_integer_tag(params, KM_TAG_KEY_SIZE, key_size) == KM_ERROR_OK);
+    *rsa_pubexp = 0;
+    if (*algorithm == KM_ALGORITHM_RSA) {
+        if (get_long_integer_tag(params, KM_TAG_RSA_PUBLIC_EXPONENT, rsa_pubexp) != KM_ERROR_OK) {
+            *rsa_pubexp = 65537;
+        }
+        CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, (*rsa_pubexp & 1) && (*rsa_pubexp > 1));
+    }
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_KEY_SIZE, key_size_supported(*algorithm, *key_size));
+
+end:
+    return ret;
+}
+
+static void bn_write_padded(
+    const BIGNUM *bn,
+    uint8_t *out,
+    uint32_t len)
+{
+    uint32_t bn_len = BN_num_bytes(bn);
+
+    memset(out, 0, len - bn_len);
+    BN_bn2bin(bn, out + len - bn_len);
+}
+
+/**
+ * Generate new key data: key_type | key_size | core_key_data.
+ *
+ * @param[out] key_data allocated, to be freed by the caller with free_secret()
+ */
+static keymaster_error_t generate_key_data(
+    keymaster_algorithm_t algorithm,
+    uint32_t key_size,
+    uint64_t rsa_pubexp,
+    uint8_t **key_data,
+    uint32_t *key_data_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    RSA *rsa = NULL;
+    BIGNUM *e = NULL;
+    EC_KEY *ec = NULL;
+    BIGNUM *x = NULL;
+    BIGNUM *y = NULL;
+    const BIGNUM *bn[RSA_PARTS];
+    uint32_t keylen = BITS_TO_BYTES(key_size);
+    uint32_t len = 8;
+    uint8_t *pos;
+
+    *key_data = NULL;
+    switch (algorithm) {
+        case KM_ALGORITHM_RSA:
+            rsa = RSA_new();
+            e = BN_new();
+            CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, (rsa != NULL) && (e != NULL));
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+                BN_set_word(e, rsa_pubexp) &&
+                RSA_generate_key_ex(rsa, key_size, e, NULL));
+            km_mock_rsa_get(rsa, bn);
+            len += KM_RSA_METADATA_SIZE;
+            for (int i = 0; i < RSA_PARTS; i++) {
+                len += BN_num_bytes(bn[i]);
+            }
+            break;
+        case KM_ALGORITHM_EC:
+            ec = EC_KEY_new_by_curve_name(ec_curve_nid(ec_curve(key_size)));
+            x = BN_new();
+            y = BN_new();
+            CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED,
+                (ec != NULL) && (x != NULL) && (y != NULL));
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+                EC_KEY_generate_key(ec) &&
+                EC_POINT_get_affine_coordinates_GFp(EC_KEY_get0_group(ec),
+                    EC_KEY_get0_public_key(ec), x, y, NULL));
+            len += KM_EC_METADATA_SIZE + 3 * keylen;
+            break;
+        default:
+            len += keylen;
+            break;
+    }
+
+    *key_data = (uint8_t*)malloc(len);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, *key_data != NULL);
+    pos = *key_data;
+    set_u32_increment_pos(&pos, algorithm);
+    set_u32_increment_pos(&pos, key_size);
+    switch (algorithm) {
+        case KM_ALGORITHM_RSA:
+            set_u32_increment_pos(&pos, key_size);
+            for (int i = 0; i < RSA_PARTS; i++) {
+                set_u32_increment_pos(&pos, BN_num_bytes(bn[i]));
+            }
+            for (int i = 0; i < RSA_PARTS; i++) {
+                pos += BN_bn2bin(bn[i], pos);
+            }
+            break;
+        case KM_ALGORITHM_EC:
+            set_u32_increment_pos(&pos, ec_curve(key_size));
+            set_u32_increment_pos(&pos, keylen);
+            set_u32_increment_pos(&pos, keylen);
+            set_u32_increment_pos(&pos, keylen);
+            bn_write_padded(x, pos, keylen);
+            bn_write_padded(y, pos + keylen, keylen);
+            bn_write_padded(EC_KEY_get0_private_key(ec), pos + 2 * keylen, keylen);
+            break;
+        default:
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, RAND_bytes(pos, keylen) == 1);
+            break;
+    }
+    *key_data_len = len;
+
+end:
+    if (ret != KM_ERROR_OK) {
+        free(*key_data);
+        *key_data = NULL;
+    }
+    RSA_free(rsa);
+    BN_free(e);
+    EC_KEY_free(ec);
+    BN_free(x);
+    BN_free(y);
+    return ret;
+}
+
+static RSA *load_rsa(
+    const uint8_t *core,
+    uint32_t core_len)
+{
+    RSA *rsa = NULL;
+    BIGNUM *bn[RSA_PARTS];
+    uint32_t len[RSA_PARTS];
+    uint32_t total = KM_RSA_METADATA_SIZE;
+    const uint8_t *pos = core + KM_RSA_METADATA_SIZE;
+    bool ok = core_len >= KM_RSA_METADATA_SIZE;
+
+    for (int i = 0; ok && (i < RSA_PARTS); i++) {
+        len[i] = get_u32(core + 4 + 4 * i);
+        ok = len[i] <= core_len - total;
+        total += ok ? len[i] : 0;
+    }
+    for (int i = 0; i < RSA_PARTS; i++) {
+        bn[i] = ok ? BN_bin2bn(pos, len[i], NULL) : NULL;
+        ok = ok && (bn[i] != NULL);
+        pos += ok ? len[i] : 0;
+    }
+    if (ok) {
+        rsa = RSA_new();
+    }
+    if (rsa != NULL) {
+        km_mock_rsa_set(rsa, bn);
+        return rsa;
+    }
+    for (int i = 0; i < RSA_PARTS; i++) {
+        BN_free(ok ? bn[i] : NULL);
+    }
+    return NULL;
+}
+
+static EC_KEY *load_ec(
+    const uint8_t *core,
+    uint32_t core_len)
+{
+    EC_KEY *ec = NULL;
+    BIGNUM *x = NULL;
+    BIGNUM *y = NULL;
+    BIGNUM *d = NULL;
+    uint32_t x_len, y_len, d_len;
+    bool ok = false;
+
+    if (core_len < KM_EC_METADATA_SIZE) {
+        return NULL;
+    }
+    x_len = get_u32(core + 4);
+    y_len = get_u32(core + 8);
+    d_len = get_u32(core + 12);
+    if ((x_len > core_len) || (y_len > core_len) || (d_len > core_len) ||
+        (KM_EC_METADATA_SIZE + x_len + y_len + d_len > core_len))
+    {
+        return NULL;
+    }
+    core += KM_EC_METADATA_SIZE;
+    ec = EC_KEY_new_by_curve_name(ec_curve_nid(get_u32(core - KM_EC_METADATA_SIZE)));
+    x = BN_bin2bn(core, x_len, NULL);
+    y = BN_bin2bn(core + x_len, y_len, NULL);
+    d = BN_bin2bn(core + x_len + y_len, d_len, NULL);
+    ok = (ec != NULL) && (x != NULL) && (y != NULL) && (d != NULL) &&
+        EC_KEY_set_public_key_affine_coordinates(ec, x, y) &&
+        EC_KEY_set_private_key(ec, d);
+    BN_free(x);
+    BN_free(y);
+    BN_clear_free(d);
+    if (!ok) {
+        EC_KEY_free(ec);
+        return NULL;
+    }
+    return ec;
+}
+
+/**
+ * Check the key data of an import and find its length.
+ */
+static keymaster_error_t check_key_data(
+    const uint8_t *key_data,
+    uint32_t max_len,
+    uint32_t *key_data_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    uint32_t len;
+    RSA *rsa = NULL;
+    EC_KEY *ec = NULL;
+
+    CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, max_len >= 8);
+    algorithm = (keymaster_algorithm_t)get_u32(key_data);
+    key_size = get_u32(key_data + 4);
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_KEY_SIZE, key_size_supported(algorithm, key_size));
+    switch (algorithm) {
+        case KM_ALGORITHM_RSA:
+            rsa = load_rsa(key_data + 8, max_len - 8);
+            CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, rsa != NULL);
+            len = KM_RSA_METADATA_SIZE;
+            for (int i = 0; i < RSA_PARTS; i++) {
+                len += get_u32(key_data + 12 + 4 * i);
+            }
+            break;
+        case KM_ALGORITHM_EC:
+            ec = load_ec(key_data + 8, max_len - 8);
+            CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, (ec != NULL) && EC_KEY_check_key(ec));
+            len = KM_EC_METADATA_SIZE + get_u32(key_data + 12) +
+                get_u32(key_data + 16) + get_u32(key_data + 20);
+            break;
+        default:
+            len = BITS_TO_BYTES(key_size);
+            CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, len <= max_len - 8);
+            break;
+    }
+    *key_data_len = 8 + len;
+
+end:
+    RSA_free(rsa);
+    EC_KEY_free(ec);
+    return ret;
+}
+
+/**
+ * Wrap key material: IV | AES-GCM ciphertext | tag.
+ *
+ * @param[in,out] blob_len capacity in, length out
+ */
+static keymaster_error_t wrap_blob(
+    bool unbound,
+    const uint8_t *plain,
+    uint32_t plain_len,
+    uint8_t *blob,
+    uint32_t *blob_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    EVP_CIPHER_CTX *ctx = NULL;
+    const uint8_t *aad = unbound ? g_unbound_aad : g_bound_aad;
+    int aad_len = unbound ? sizeof(g_unbound_aad) : sizeof(g_bound_aad);
+    int outl;
+
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, (blob != NULL) &&
+        (*blob_len >= KM_MOCK_BLOB_IV_SIZE + plain_len + KM_MOCK_BLOB_TAG_SIZE));
+    ctx = EVP_CIPHER_CTX_new();
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, ctx != NULL);
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+        (RAND_bytes(blob, KM_MOCK_BLOB_IV_SIZE) == 1) &&
+        EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, KM_MOCK_BLOB_IV_SIZE, NULL) &&
+        EVP_EncryptInit_ex(ctx, NULL, NULL, g_wrap_key, blob) &&
+        EVP_EncryptUpdate(ctx, NULL, &outl, aad, aad_len) &&
+        EVP_EncryptUpdate(ctx, blob + KM_MOCK_BLOB_IV_SIZE, &outl, plain, plain_len) &&
+        EVP_EncryptFinal_ex(ctx, blob + KM_MOCK_BLOB_IV_SIZE + plain_len, &outl) &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, KM_MOCK_BLOB_TAG_SIZE,
+            blob + KM_MOCK_BLOB_IV_SIZE + plain_len));
+    *blob_len = KM_MOCK_BLOB_IV_SIZE + plain_len + KM_MOCK_BLOB_TAG_SIZE;
+
+end:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/**
+ * Unwrap and parse a key blob.
+ *
+ * @param[out] key to be released with close_key(), also on error
+ *
+ * @return KM_ERROR_OK, or KM_ERROR_INVALID_KEY_BLOB if the blob was not
+ *         wrapped by the model as the kind asked for
+ */
+static keymaster_error_t open_key(
+    bool unbound,
+    const uint8_t *blob,
+    uint32_t blob_len,
+    km_mock_key_t *key)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    EVP_CIPHER_CTX *ctx = NULL;
+    const uint8_t *aad = unbound ? g_unbound_aad : g_bound_aad;
+    int aad_len = unbound ? sizeof(g_unbound_aad) : sizeof(g_bound_aad);
+    uint8_t *pos;
+    uint32_t remain;
+    uint32_t params_len;
+    int outl;
+
+    memset(key, 0, sizeof(*key));
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, (blob != NULL) &&
+        (blob_len > KM_MOCK_BLOB_IV_SIZE + KM_MOCK_BLOB_TAG_SIZE));
+    key->material_len = blob_len - KM_MOCK_BLOB_IV_SIZE - KM_MOCK_BLOB_TAG_SIZE;
+    key->material = (uint8_t*)malloc(key->material_len);
+    ctx = EVP_CIPHER_CTX_new();
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, (key->material != NULL) && (ctx != NULL));
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB,
+        EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, KM_MOCK_BLOB_IV_SIZE, NULL) &&
+        EVP_DecryptInit_ex(ctx, NULL, NULL, g_wrap_key, blob) &&
+        EVP_DecryptUpdate(ctx, NULL, &outl, aad, aad_len) &&
+        EVP_DecryptUpdate(ctx, key->material, &outl, blob + KM_MOCK_BLOB_IV_SIZE,
+            key->material_len) &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, KM_MOCK_BLOB_TAG_SIZE,
+            (void*)(blob + blob_len - KM_MOCK_BLOB_TAG_SIZE)) &&
+        (EVP_DecryptFinal_ex(ctx, key->material + outl, &outl) > 0));
+
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, key->material_len >= 4);
+    params_len = get_u32(key->material);
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, params_len <= key->material_len - 4 - 8);
+    pos = key->material + 4;
+    remain = params_len;
+    CHECK_RESULT_OK(deserialize_param_set(&key->params, &pos, &remain));
+
+    key->key_data = key->material + 4 + params_len;
+    key->key_data_len = key->material_len - 4 - params_len;
+    key->algorithm = (keymaster_algorithm_t)get_u32(key->key_data);
+    key->key_size = get_u32(key->key_data + 4);
+    key->core = key->key_data + 8;
+    key->core_len = key->key_data_len - 8;
+
+end:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+static void close_key(
+    km_mock_key_t *key)
+{
+    keymaster_free_param_set(&key->params);
+    free_secret(key->material, key->material_len);
+    key->material = NULL;
+}
+
+static bool sw_enforced(
+    keymaster_tag_t tag)
+{
+    switch (tag) {
+        case KM_TAG_ACTIVE_DATETIME:
+        case KM_TAG_ORIGINATION_EXPIRE_DATETIME:
+        case KM_TAG_USAGE_EXPIRE_DATETIME:
+        case KM_TAG_CREATION_DATETIME:
+        case KM_TAG_MAX_USES_PER_BOOT:
+        case KM_TAG_MIN_SECONDS_BETWEEN_OPS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Write characteristics: hw_enforced (params) | sw_enforced (params).
+ *
+ * Blobs such as the application id are not part of them.
+ *
+ * @param out buffer, or NULL if they are not wanted
+ * @param[in,out] out_len capacity in, length out
+ */
+static keymaster_error_t write_characteristics(
+    const keymaster_key_param_set_t *params,
+    uint8_t *out,
+    uint32_t *out_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    keymaster_key_param_set_t hw = {NULL, 0};
+    keymaster_key_param_set_t sw = {NULL, 0};
+    uint8_t *hw_buf = NULL;
+    uint8_t *sw_buf = NULL;
+    uint32_t hw_len = 0;
+    uint32_t sw_len = 0;
+
+    if (out == NULL) {
+        *out_len = 0;
+        return KM_ERROR_OK;
+    }
+    hw.params = (keymaster_key_param_t*)calloc(params->length + 1, sizeof(keymaster_key_param_t));
+    sw.params = (keymaster_key_param_t*)calloc(params->length + 1, sizeof(keymaster_key_param_t));
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, (hw.params != NULL) && (sw.params != NULL));
+    for (size_t i = 0; i < params->length; i++) {
+        keymaster_tag_type_t type = keymaster_tag_get_type(params->params[i].tag);
+        if ((type == KM_BYTES) || (type == KM_BIGNUM)) {
+            continue;
+        }
+        if (sw_enforced(params->params[i].tag)) {
+            sw.params[sw.length++] = params->params[i];
+        } else {
+            hw.params[hw.length++] = params->params[i];
+        }
+    }
+    CHECK_RESULT_OK(km_serialize_params(&hw_buf, &hw_len, &hw, false, 0, 0));
+    CHECK_RESULT_OK(km_serialize_params(&sw_buf, &sw_len, &sw, false, 0, 0));
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, hw_len + sw_len <= *out_len);
+    memcpy(out, hw_buf, hw_len);
+    memcpy(out + hw_len, sw_buf, sw_len);
+    *out_len = hw_len + sw_len;
+
+end:
+    free(hw.params);
+    free(sw.params);
+    free(hw_buf);
+    free(sw_buf);
+    return ret;
+}
+
+/**
+ * Wrap key data with the parameters it was made with, adding KM_TAG_ORIGIN,
+ * and write the characteristics of the new key.
+ */
+static keymaster_error_t store_key(
+    const uint8_t *params,
+    uint32_t params_len,
+    keymaster_key_origin_t origin,
+    const uint8_t *key_data,
+    uint32_t key_data_len,
+    uint8_t *blob,
+    uint32_t *blob_len,
+    uint8_t *characteristics,
+    uint32_t *characteristics_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    keymaster_key_param_set_t set = {NULL, 0};
+    uint32_t material_len = 4 + params_len + 8 + key_data_len;
+    uint8_t *material = NULL;
+    uint8_t *pos;
+    uint32_t remain;
+
+    CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, params_len >= 4);
+    material = (uint8_t*)malloc(material_len);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, material != NULL);
+    pos = material;
+    set_u32_increment_pos(&pos, params_len + 8);
+    set_u32_increment_pos(&pos, get_u32(params) + 1);
+    set_data_increment_pos(&pos, params + 4, params_len - 4);
+    set_u32_increment_pos(&pos, KM_TAG_ORIGIN);
+    set_u32_increment_pos(&pos, origin);
+    set_data_increment_pos(&pos, key_data, key_data_len);
+
+    pos = material + 4;
+    remain = params_len + 8;
+    CHECK_RESULT_OK(deserialize_param_set(&set, &pos, &remain));
+    CHECK_RESULT_OK(wrap_blob(false, material, material_len, blob, blob_len));
+    CHECK_RESULT_OK(write_characteristics(&set, characteristics, characteristics_len));
+
+end:
+    keymaster_free_param_set(&set);
+    free_secret(material, material_len);
+    return ret;
+}
+
+static bool blob_equal(
+    const keymaster_key_param_t *param,
+    const uint8_t *data,
+    uint32_t data_len)
+{
+    if (param == NULL) {
+        return data_len == 0;
+    }
+    return (param->blob.data_length == data_len) &&
+        ((data_len == 0) || (memcmp(param->blob.data, data, data_len) == 0));
+}
+
+/**
+ * Check the application id and data a caller gave against the ones the key
+ * is bound to.
+ */
+static keymaster_error_t check_binding(
+    const km_mock_key_t *key,
+    const uint8_t *client_id,
+    uint32_t client_id_len,
+    const uint8_t *app_data,
+    uint32_t app_data_len)
+{
+    const keymaster_key_param_t *id = find_param(&key->params, KM_TAG_APPLICATION_ID);
+    const keymaster_key_param_t *data = find_param(&key->params, KM_TAG_APPLICATION_DATA);
+
+    if (((id != NULL) && !blob_equal(id, client_id, client_id_len)) ||
+        ((data != NULL) && !blob_equal(data, app_data, app_data_len)))
+    {
+        return KM_ERROR_KEY_USER_NOT_AUTHENTICATED;
+    }
+    return KM_ERROR_OK;
+}
+
+static bool key_allows_purpose(
+    const km_mock_key_t *key,
+    keymaster_purpose_t purpose)
+{
+    bool restricted = false;
+
+    /* anyone with the public key can do these */
+    if (((key->algorithm == KM_ALGORITHM_RSA) || (key->algorithm == KM_ALGORITHM_EC)) &&
+        ((purpose == KM_PURPOSE_VERIFY) || (purpose == KM_PURPOSE_ENCRYPT)))
+    {
+        return true;
+    }
+    for (size_t i = 0; i < key->params.length; i++) {
+        if (key->params.params[i].tag == KM_TAG_PURPOSE) {
+            if (key->params.params[i].enumerated == (uint32_t)purpose) {
+                return true;
+            }
+            restricted = true;
+        }
+    }
+    return !restricted;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Operation table                                                          */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * Take a free slot for a new operation, with a fresh handle.
+ *
+ * @return the operation, or NULL if the session or the TA has too many
+ */
+static km_mock_op_t *op_alloc(
+    uint32_t session_id,
+    keymaster_algorithm_t algorithm)
+{
+    km_mock_op_t *op = NULL;
+    keymaster_operation_handle_t handle;
+    uint32_t session_ops = 0;
+    uint32_t rsa_ops = 0;
+    bool clash;
+
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < KM_MOCK_OPERATION_SLOTS; i++) {
+        if (!g_ops[i].in_use) {
+            op = (op == NULL) ? &g_ops[i] : op;
+            continue;
+        }
+        session_ops += (g_ops[i].session_id == session_id) ? 1 : 0;
+        rsa_ops += (g_ops[i].algorithm == KM_ALGORITHM_RSA) ? 1 : 0;
+    }
+    if ((session_ops >= KM_MOCK_MAX_OPERATIONS) ||
+        ((algorithm == KM_ALGORITHM_RSA) && (rsa_ops >= KM_MOCK_MAX_RSA_OPERATIONS)))
+    {
+        op = NULL;
+    }
+    if (op != NULL) {
+        do {
+            RAND_bytes((uint8_t*)&handle, sizeof(handle));
+            clash = (handle == 0);
+            for (int i = 0; !clash && (i < KM_MOCK_OPERATION_SLOTS); i++) {
+                clash = g_ops[i].in_use && (g_ops[i].handle == handle);
+            }
+        } while (clash);
+        memset(op, 0, sizeof(*op));
+        op->in_use = true;
+        op->session_id = session_id;
+        op->handle = handle;
+        op->algorithm = algorithm;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return op;
+}
+
+static km_mock_op_t *op_find(
+    uint32_t session_id,
+    keymaster_operation_handle_t handle)
+{
+    km_mock_op_t *op = NULL;
+
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; (op == NULL) && (i < KM_MOCK_OPERATION_SLOTS); i++) {
+        if (g_ops[i].in_use && (g_ops[i].session_id == session_id) &&
+            (g_ops[i].handle == handle))
+        {
+            op = &g_ops[i];
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return op;
+}
+
+static void op_free(
+    km_mock_op_t *op)
+{
+    EVP_CIPHER_CTX_free(op->cipher);
+    if (op->md != NULL) {
+        EVP_MD_CTX_destroy(op->md);
+    }
+    EVP_PKEY_free(op->pkey);
+    RSA_free(op->rsa);
+    EC_KEY_free(op->ec);
+    free_secret(op->data, op->data_max);
+    OPENSSL_cleanse(op->hmac_opad, sizeof(op->hmac_opad));
+
+    pthread_mutex_lock(&g_lock);
+    op->in_use = false;
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Operations                                                               */
+/* ------------------------------------------------------------------------ */
+
+static keymaster_error_t op_buffer(
+    km_mock_op_t *op,
+    uint32_t max)
+{
+    op->data = (uint8_t*)malloc((max > 0) ? max : 1);
+    op->data_max = max;
+    return (op->data != NULL) ? KM_ERROR_OK : KM_ERROR_MEMORY_ALLOCATION_FAILED;
+}
+
+static keymaster_error_t op_digest_init(
+    km_mock_op_t *op)
+{
+    op->md_type = digest_md(op->digest);
+    if (op->md_type == NULL) {
+        return KM_ERROR_UNSUPPORTED_DIGEST;
+    }
+    op->md = EVP_MD_CTX_create();
+    if (op->md == NULL) {
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    }
+    return EVP_DigestInit_ex(op->md, op->md_type, NULL) ? KM_ERROR_OK : KM_ERROR_UNKNOWN_ERROR;
+}
+
+/**
+ * Write the nonce generated for an operation as out_params.
+ */
+static keymaster_error_t write_nonce(
+    const uint8_t *nonce,
+    uint32_t nonce_len,
+    uint8_t *out,
+    uint32_t *out_len)
+{
+    uint8_t *pos = out;
+
+    if (out == NULL) {
+        *out_len = 0;
+        return KM_ERROR_OK;
+    }
+    if (*out_len < 12 + nonce_len) {
+        return KM_ERROR_INSUFFICIENT_BUFFER_SPACE;
+    }
+    set_u32_increment_pos(&pos, 1);
+    set_u32_increment_pos(&pos, KM_TAG_NONCE);
+    set_u32_increment_pos(&pos, nonce_len);
+    set_data_increment_pos(&pos, nonce, nonce_len);
+    *out_len = 12 + nonce_len;
+    return KM_ERROR_OK;
+}
+
+static const EVP_CIPHER *aes_cipher(
+    uint32_t key_size,
+    keymaster_block_mode_t mode)
+{
+    switch (mode) {
+        case KM_MODE_ECB:
+            return (key_size == 128) ? EVP_aes_128_ecb() :
+                (key_size == 192) ? EVP_aes_192_ecb() : EVP_aes_256_ecb();
+        case KM_MODE_CBC:
+            return (key_size == 128) ? EVP_aes_128_cbc() :
+                (key_size == 192) ? EVP_aes_192_cbc() : EVP_aes_256_cbc();
+        case KM_MODE_CTR:
+            return (key_size == 128) ? EVP_aes_128_ctr() :
+                (key_size == 192) ? EVP_aes_192_ctr() : EVP_aes_256_ctr();
+        case KM_MODE_GCM:
+            return (key_size == 128) ? EVP_aes_128_gcm() :
+                (key_size == 192) ? EVP_aes_192_gcm() : EVP_aes_256_gcm();
+        default:
+            return NULL;
+    }
+}
+
+static keymaster_error_t begin_aes(
+    km_mock_op_t *op,
+    const km_mock_key_t *key,
+    const keymaster_key_param_set_t *params,
+    uint8_t *out_params,
+    uint32_t *out_params_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    const keymaster_key_param_t *nonce_param = find_param(params, KM_TAG_NONCE);
+    const EVP_CIPHER *cipher;
+    uint8_t nonce[KM_MOCK_AES_BLOCK_SIZE];
+    uint32_t nonce_len;
+    uint32_t mac_bits = 128;
+    bool encrypt = (op->purpose == KM_PURPOSE_ENCRYPT);
+    uint32_t capacity = *out_params_len;
+
+    *out_params_len = 0;
+    op->mode = (keymaster_block_mode_t)request_or_key_enum(params, &key->params,
+        KM_TAG_BLOCK_MODE, KM_MODE_ECB);
+    /* unlike the block mode, padding is not taken from the key */
+    if (get_enumerated_tag(params, KM_TAG_PADDING, (uint32_t*)&op->padding) != KM_ERROR_OK) {
+        op->padding = KM_PAD_NONE;
+    }
+    cipher = aes_cipher(key->key_size, op->mode);
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_BLOCK_MODE, cipher != NULL);
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_PADDING_MODE,
+        (op->padding == KM_PAD_NONE) || (op->padding == KM_PAD_PKCS7));
+    CHECK_TRUE(KM_ERROR_INCOMPATIBLE_PADDING_MODE, (op->padding == KM_PAD_NONE) ||
+        (op->mode == KM_MODE_ECB) || (op->mode == KM_MODE_CBC));
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, key->core_len >= BITS_TO_BYTES(key->key_size));
+
+    if (op->mode == KM_MODE_GCM) {
+        get_integer_tag(params, KM_TAG_MAC_LENGTH, &mac_bits);
+        CHECK_TRUE(KM_ERROR_UNSUPPORTED_MAC_LENGTH,
+            (mac_bits >= 96) && (mac_bits <= 128) && (mac_bits % 8 == 0));
+        op->mac_length = mac_bits / 8;
+    }
+
+    nonce_len = (op->mode == KM_MODE_GCM) ? KM_MOCK_GCM_NONCE_SIZE :
+        (op->mode == KM_MODE_ECB) ? 0 : KM_MOCK_AES_BLOCK_SIZE;
+    if ((nonce_len > 0) && (nonce_param != NULL)) {
+        CHECK_TRUE(KM_ERROR_INVALID_NONCE, nonce_param->blob.data_length == nonce_len);
+        memcpy(nonce, nonce_param->blob.data, nonce_len);
+    } else if (nonce_len > 0) {
+        CHECK_TRUE(KM_ERROR_MISSING_NONCE, encrypt);
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, RAND_bytes(nonce, nonce_len) == 1);
+        CHECK_RESULT_OK(write_nonce(nonce, nonce_len, out_params, &capacity));
+        *out_params_len = capacity;
+    }
+
+    op->cipher = EVP_CIPHER_CTX_new();
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, op->cipher != NULL);
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+        EVP_CipherInit_ex(op->cipher, cipher, NULL, NULL, NULL, encrypt ? 1 : 0) &&
+        ((op->mode != KM_MODE_GCM) ||
+            EVP_CIPHER_CTX_ctrl(op->cipher, EVP_CTRL_GCM_SET_IVLEN, nonce_len, NULL)) &&
+        EVP_CipherInit_ex(op->cipher, NULL, NULL, key->core,
+            (nonce_len > 0) ? nonce : NULL, encrypt ? 1 : 0) &&
+        EVP_CIPHER_CTX_set_padding(op->cipher, (op->padding == KM_PAD_PKCS7) ? 1 : 0));
+    if ((op->mode == KM_MODE_GCM) && !encrypt) {
+        CHECK_RESULT_OK(op_buffer(op, op->mac_length));
+    }
+
+end:
+    return ret;
+}
+
+static keymaster_error_t begin_hmac(
+    km_mock_op_t *op,
+    const km_mock_key_t *key,
+    const keymaster_key_param_set_t *params)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t k[KM_MOCK_MAX_MD_BLOCK_SIZE];
+    uint8_t ipad[KM_MOCK_MAX_MD_BLOCK_SIZE];
+    uint32_t key_len = BITS_TO_BYTES(key->key_size);
+    uint32_t mac_bits;
+    unsigned int k_len;
+    int block;
+
+    memset(k, 0, sizeof(k));
+    op->digest = (keymaster_digest_t)request_or_key_enum(params, &key->params,
+        KM_TAG_DIGEST, KM_DIGEST_NONE);
+    CHECK_RESULT_OK(op_digest_init(op));
+    block = EVP_MD_block_size(op->md_type);
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, key->core_len >= key_len);
+
+    op->mac_length = EVP_MD_size(op->md_type);
+    if (get_integer_tag(params, KM_TAG_MAC_LENGTH, &mac_bits) == KM_ERROR_OK) {
+        CHECK_TRUE(KM_ERROR_UNSUPPORTED_MAC_LENGTH, (mac_bits % 8 == 0) &&
+            (mac_bits >= 64) && (mac_bits / 8 <= op->mac_length));
+        op->mac_length = mac_bits / 8;
+    }
+
+    /* HMAC(K, m) = H((K ^ opad) | H((K ^ ipad) | m)) */
+    if (key_len > (uint32_t)block) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+            EVP_Digest(key->core, key_len, k, &k_len, op->md_type, NULL));
+    } else {
+        memcpy(k, key->core, key_len);
+    }
+    for (int i = 0; i < block; i++) {
+        ipad[i] = k[i] ^ 0x36;
+        op->hmac_opad[i] = k[i] ^ 0x5c;
+    }
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_DigestUpdate(op->md, ipad, block));
+
+end:
+    OPENSSL_cleanse(k, sizeof(k));
+    OPENSSL_cleanse(ipad, sizeof(ipad));
+    return ret;
+}
+
+static keymaster_error_t begin_rsa(
+    km_mock_op_t *op,
+    const km_mock_key_t *key,
+    const keymaster_key_param_set_t *params)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    bool signing = (op->purpose == KM_PURPOSE_SIGN) || (op->purpose == KM_PURPOSE_VERIFY);
+    uint32_t keybytes;
+
+    op->digest = (keymaster_digest_t)request_or_key_enum(params, &key->params,
+        KM_TAG_DIGEST, KM_DIGEST_NONE);
+    op->padding = (keymaster_padding_t)request_or_key_enum(params, &key->params,
+        KM_TAG_PADDING, KM_PAD_NONE);
+    if (signing) {
+        CHECK_TRUE(KM_ERROR_UNSUPPORTED_PADDING_MODE, (op->padding == KM_PAD_NONE) ||
+            (op->padding == KM_PAD_RSA_PKCS1_1_5_SIGN) || (op->padding == KM_PAD_RSA_PSS));
+        CHECK_TRUE(KM_ERROR_INCOMPATIBLE_DIGEST,
+            (op->padding != KM_PAD_RSA_PSS) || (op->digest != KM_DIGEST_NONE));
+    } else {
+        CHECK_TRUE(KM_ERROR_UNSUPPORTED_PADDING_MODE, (op->padding == KM_PAD_NONE) ||
+            (op->padding == KM_PAD_RSA_PKCS1_1_5_ENCRYPT) || (op->padding == KM_PAD_RSA_OAEP));
+        CHECK_TRUE(KM_ERROR_INCOMPATIBLE_DIGEST,
+            (op->padding != KM_PAD_RSA_OAEP) || (op->digest != KM_DIGEST_NONE));
+    }
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_DIGEST,
+        (op->digest == KM_DIGEST_NONE) || (digest_md(op->digest) != NULL));
+
+    op->rsa = load_rsa(key->core, key->core_len);
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, op->rsa != NULL);
+    op->pkey = EVP_PKEY_new();
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, op->pkey != NULL);
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_PKEY_set1_RSA(op->pkey, op->rsa));
+    keybytes = RSA_size(op->rsa);
+
+    op->md_type = digest_md(op->digest);
+    /* room for the digest and the padding around it */
+    if (op->padding == KM_PAD_RSA_PSS) {
+        CHECK_TRUE(KM_ERROR_INCOMPATIBLE_DIGEST,
+            keybytes >= (uint32_t)EVP_MD_size(op->md_type) + 2);
+    } else if (op->padding == KM_PAD_RSA_OAEP) {
+        CHECK_TRUE(KM_ERROR_INCOMPATIBLE_DIGEST,
+            keybytes >= 2 * (uint32_t)EVP_MD_size(op->md_type) + 2);
+    }
+    if (signing && (op->digest != KM_DIGEST_NONE)) {
+        CHECK_RESULT_OK(op_digest_init(op));
+    } else {
+        CHECK_RESULT_OK(op_buffer(op, keybytes));
+    }
+
+end:
+    return ret;
+}
+
+static keymaster_error_t begin_ec(
+    km_mock_op_t *op,
+    const km_mock_key_t *key,
+    const keymaster_key_param_set_t *params)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    op->digest = (keymaster_digest_t)request_or_key_enum(params, &key->params,
+        KM_TAG_DIGEST, KM_DIGEST_NONE);
+    op->ec = load_ec(key->core, key->core_len);
+    CHECK_TRUE(KM_ERROR_INVALID_KEY_BLOB, op->ec != NULL);
+    if (op->digest != KM_DIGEST_NONE) {
+        CHECK_RESULT_OK(op_digest_init(op));
+    } else {
+        /* the message is truncated to the size of the curve */
+        CHECK_RESULT_OK(op_buffer(op, BITS_TO_BYTES(key->key_size)));
+    }
+
+end:
+    return ret;
+}
+
+/**
+ * Upper bound on the output of finish().
+ */
+static uint32_t op_finish_length(
+    const km_mock_op_t *op)
+{
+    switch (op->algorithm) {
+        case KM_ALGORITHM_AES:
+            return 2 * KM_MOCK_AES_BLOCK_SIZE;
+        case KM_ALGORITHM_HMAC:
+            return (op->purpose == KM_PURPOSE_SIGN) ? op->mac_length : 0;
+        case KM_ALGORITHM_RSA:
+            return (op->purpose == KM_PURPOSE_VERIFY) ? 0 : RSA_size(op->rsa);
+        case KM_ALGORITHM_EC:
+            return (op->purpose == KM_PURPOSE_SIGN) ? ECDSA_size(op->ec) : 0;
+        default:
+            return 0;
+    }
+}
+
+static keymaster_error_t aes_aad(
+    km_mock_op_t *op,
+    const keymaster_key_param_set_t *params)
+{
+    int outl;
+
+    if ((params == NULL) || (op->mode != KM_MODE_GCM)) {
+        return KM_ERROR_OK;
+    }
+    for (size_t i = 0; i < params->length; i++) {
+        const keymaster_key_param_t *param = &params->params[i];
+        if ((param->tag == KM_TAG_ASSOCIATED_DATA) &&
+            !EVP_CipherUpdate(op->cipher, NULL, &outl, param->blob.data,
+                param->blob.data_length))
+        {
+            return KM_ERROR_UNKNOWN_ERROR;
+        }
+    }
+    return KM_ERROR_OK;
+}
+
+static keymaster_error_t aes_update(
+    km_mock_op_t *op,
+    const uint8_t *input,
+    uint32_t input_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t *joined = NULL;
+    uint32_t total;
+    int outl = 0;
+
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, (input_len == 0) ||
+        ((output != NULL) && (*output_len >= input_len + KM_MOCK_AES_BLOCK_SIZE)));
+    if ((op->mode == KM_MODE_GCM) && (op->purpose == KM_PURPOSE_DECRYPT)) {
+        /* the last mac_length bytes seen are the tag, keep them back */
+        total = op->data_len + input_len;
+        if (total <= op->mac_length) {
+            memcpy(op->data + op->data_len, input, input_len);
+            op->data_len = total;
+            *output_len = 0;
+            goto end;
+        }
+        joined = (uint8_t*)malloc(total);
+        CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, joined != NULL);
+        memcpy(joined, op->data, op->data_len);
+        memcpy(joined + op->data_len, input, input_len);
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_CipherUpdate(op->cipher, output, &outl,
+            joined, total - op->mac_length));
+        memcpy(op->data, joined + total - op->mac_length, op->mac_length);
+        op->data_len = op->mac_length;
+    } else if (input_len > 0) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_CipherUpdate(op->cipher, output, &outl,
+            input, input_len));
+    }
+    *output_len = outl;
+
+end:
+    free(joined);
+    return ret;
+}
+
+static keymaster_error_t aes_finish(
+    km_mock_op_t *op,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t last[2 * KM_MOCK_AES_BLOCK_SIZE];
+    int outl = 0;
+    uint32_t len;
+
+    if ((op->mode == KM_MODE_GCM) && (op->purpose == KM_PURPOSE_DECRYPT)) {
+        CHECK_TRUE(KM_ERROR_VERIFICATION_FAILED,
+            (op->data_len == op->mac_length) &&
+            EVP_CIPHER_CTX_ctrl(op->cipher, EVP_CTRL_GCM_SET_TAG, op->mac_length, op->data) &&
+            (EVP_CipherFinal_ex(op->cipher, last, &outl) > 0));
+    } else {
+        CHECK_TRUE((op->padding == KM_PAD_PKCS7) && (op->purpose == KM_PURPOSE_DECRYPT) ?
+                KM_ERROR_INVALID_ARGUMENT : KM_ERROR_INVALID_INPUT_LENGTH,
+            EVP_CipherFinal_ex(op->cipher, last, &outl) > 0);
+    }
+    len = outl;
+    if ((op->mode == KM_MODE_GCM) && (op->purpose == KM_PURPOSE_ENCRYPT)) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_CIPHER_CTX_ctrl(op->cipher,
+            EVP_CTRL_GCM_GET_TAG, op->mac_length, last + len));
+        len += op->mac_length;
+    }
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+        (len == 0) || ((output != NULL) && (*output_len >= len)));
+    if (len > 0) {
+        memcpy(output, last, len);
+    }
+    *output_len = len;
+
+end:
+    return ret;
+}
+
+static keymaster_error_t hmac_finish(
+    km_mock_op_t *op,
+    const uint8_t *signature,
+    uint32_t signature_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len;
+    int block = EVP_MD_block_size(op->md_type);
+
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+        EVP_DigestFinal_ex(op->md, mac, &mac_len) &&
+        EVP_DigestInit_ex(op->md, op->md_type, NULL) &&
+        EVP_DigestUpdate(op->md, op->hmac_opad, block) &&
+        EVP_DigestUpdate(op->md, mac, mac_len) &&
+        EVP_DigestFinal_ex(op->md, mac, &mac_len));
+    if (op->purpose == KM_PURPOSE_SIGN) {
+        CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+            (output != NULL) && (*output_len >= op->mac_length));
+        memcpy(output, mac, op->mac_length);
+        *output_len = op->mac_length;
+    } else {
+        CHECK_TRUE(KM_ERROR_VERIFICATION_FAILED,
+            (signature_len > 0) && (signature_len <= mac_len) &&
+            (CRYPTO_memcmp(mac, signature, signature_len) == 0));
+        *output_len = 0;
+    }
+
+end:
+    OPENSSL_cleanse(mac, sizeof(mac));
+    return ret;
+}
+
+/**
+ * RSA without padding: the input is left-padded to the size of the modulus
+ * and must be smaller than it.
+ */
+static keymaster_error_t rsa_raw(
+    km_mock_op_t *op,
+    const uint8_t *input,
+    uint32_t input_len,
+    const uint8_t *signature,
+    uint32_t signature_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint32_t keybytes = RSA_size(op->rsa);
+    const BIGNUM *bn[RSA_PARTS];
+    uint8_t *block = NULL;
+    uint8_t *recovered = NULL;
+    BIGNUM *m = NULL;
+    int len;
+
+    CHECK_TRUE(KM_ERROR_INVALID_INPUT_LENGTH, input_len <= keybytes);
+    block = (uint8_t*)calloc(keybytes, 1);
+    recovered = (uint8_t*)malloc(keybytes);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, (block != NULL) && (recovered != NULL));
+    memcpy(block + keybytes - input_len, input, input_len);
+    m = BN_bin2bn(block, keybytes, NULL);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, m != NULL);
+    km_mock_rsa_get(op->rsa, bn);
+    CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, BN_cmp(m, bn[RSA_N]) < 0);
+
+    switch (op->purpose) {
+        case KM_PURPOSE_SIGN:
+        case KM_PURPOSE_DECRYPT:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                (output != NULL) && (*output_len >= keybytes));
+            len = RSA_private_decrypt(keybytes, block, recovered, op->rsa, RSA_NO_PADDING);
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, len >= 0);
+            /* keep the leading zeros */
+            memset(output, 0, keybytes - len);
+            memcpy(output + keybytes - len, recovered, len);
+            *output_len = keybytes;
+            break;
+        case KM_PURPOSE_ENCRYPT:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+                (output != NULL) && (*output_len >= keybytes));
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, RSA_public_encrypt(keybytes, block, output,
+                op->rsa, RSA_NO_PADDING) == (int)keybytes);
+            *output_len = keybytes;
+            break;
+        default:
+            CHECK_TRUE(KM_ERROR_VERIFICATION_FAILED,
+                (signature_len == keybytes) &&
+                (RSA_public_decrypt(keybytes, signature, recovered, op->rsa,
+                    RSA_NO_PADDING) == (int)keybytes) &&
+                (memcmp(recovered, block, keybytes) == 0));
+            *output_len = 0;
+            break;
+    }
+
+end:
+    free(block);
+    free_secret(recovered, keybytes);
+    BN_free(m);
+    return ret;
+}
+
+static keymaster_error_t rsa_finish(
+    km_mock_op_t *op,
+    const uint8_t *signature,
+    uint32_t signature_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint32_t keybytes = RSA_size(op->rsa);
+    EVP_PKEY_CTX *ctx = NULL;
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len;
+    const uint8_t *input = op->data;
+    uint32_t input_len = op->data_len;
+    uint32_t overhead = 0;
+    size_t len = (output != NULL) ? *output_len : 0;
+    int ok = 0;
+
+    if (op->md != NULL) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_DigestFinal_ex(op->md, digest, &digest_len));
+        input = digest;
+        input_len = digest_len;
+    }
+    if (op->padding == KM_PAD_NONE) {
+        CHECK_RESULT_OK(rsa_raw(op, input, input_len, signature, signature_len,
+            output, output_len));
+        goto end;
+    }
+
+    ctx = EVP_PKEY_CTX_new(op->pkey, NULL);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, ctx != NULL);
+    switch (op->purpose) {
+        case KM_PURPOSE_SIGN:
+            ok = EVP_PKEY_sign_init(ctx);
+            break;
+        case KM_PURPOSE_VERIFY:
+            ok = EVP_PKEY_verify_init(ctx);
+            break;
+        case KM_PURPOSE_ENCRYPT:
+            ok = EVP_PKEY_encrypt_init(ctx);
+            break;
+        default:
+            ok = EVP_PKEY_decrypt_init(ctx);
+            break;
+    }
+    switch (op->padding) {
+        case KM_PAD_RSA_PSS:
+            ok = ok &&
+                EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PSS_PADDING) &&
+                EVP_PKEY_CTX_set_signature_md(ctx, op->md_type) &&
+                EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, op->md_type) &&
+                EVP_PKEY_CTX_set_rsa_pss_saltlen(ctx, -2);
+            break;
+        case KM_PAD_RSA_PKCS1_1_5_SIGN:
+            ok = ok &&
+                EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) &&
+                ((op->md_type == NULL) || EVP_PKEY_CTX_set_signature_md(ctx, op->md_type));
+            overhead = (op->md_type == NULL) ? 11 : 0;
+            break;
+        case KM_PAD_RSA_OAEP:
+            ok = ok &&
+                EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) &&
+                EVP_PKEY_CTX_set_rsa_oaep_md(ctx, op->md_type) &&
+                EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, op->md_type);
+            overhead = 2 * EVP_MD_size(op->md_type) + 2;
+            break;
+        default:
+            ok = ok && EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING);
+            overhead = 11;
+            break;
+    }
+    CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, ok);
+    if (op->purpose != KM_PURPOSE_DECRYPT) {
+        CHECK_TRUE(KM_ERROR_INVALID_INPUT_LENGTH, input_len + overhead <= keybytes);
+    }
+
+    switch (op->purpose) {
+        case KM_PURPOSE_SIGN:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, len >= keybytes);
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+                EVP_PKEY_sign(ctx, output, &len, input, input_len) > 0);
+            break;
+        case KM_PURPOSE_VERIFY:
+            CHECK_TRUE(KM_ERROR_VERIFICATION_FAILED, (signature_len > 0) &&
+                (EVP_PKEY_verify(ctx, signature, signature_len, input, input_len) == 1));
+            len = 0;
+            break;
+        case KM_PURPOSE_ENCRYPT:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, len >= keybytes);
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+                EVP_PKEY_encrypt(ctx, output, &len, input, input_len) > 0);
+            break;
+        default:
+            CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE, len >= keybytes);
+            CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+                EVP_PKEY_decrypt(ctx, output, &len, input, input_len) > 0);
+            break;
+    }
+    *output_len = len;
+
+end:
+    EVP_PKEY_CTX_free(ctx);
+    return ret;
+}
+
+static keymaster_error_t ec_finish(
+    km_mock_op_t *op,
+    const uint8_t *signature,
+    uint32_t signature_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len;
+    const uint8_t *input = op->data;
+    uint32_t input_len = op->data_len;
+    unsigned int sig_len = ECDSA_size(op->ec);
+
+    if (op->md != NULL) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_DigestFinal_ex(op->md, digest, &digest_len));
+        input = digest;
+        input_len = digest_len;
+    }
+    if (op->purpose == KM_PURPOSE_SIGN) {
+        CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+            (output != NULL) && (*output_len >= sig_len));
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR,
+            ECDSA_sign(0, input, input_len, output, &sig_len, op->ec));
+        *output_len = sig_len;
+    } else {
+        CHECK_TRUE(KM_ERROR_VERIFICATION_FAILED,
+            ECDSA_verify(0, input, input_len, signature, signature_len, op->ec) == 1);
+        *output_len = 0;
+    }
+
+end:
+    return ret;
+}
+
+/**
+ * Feed input to an operation.
+ *
+ * @param params parameters of the call, or NULL
+ * @param[in,out] output_len capacity in, length out
+ */
+static keymaster_error_t op_update(
+    km_mock_op_t *op,
+    const keymaster_key_param_set_t *params,
+    const uint8_t *input,
+    uint32_t input_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint32_t take;
+
+    switch (op->algorithm) {
+        case KM_ALGORITHM_AES:
+            CHECK_RESULT_OK(aes_aad(op, params));
+            CHECK_RESULT_OK(aes_update(op, input, input_len, output, output_len));
+            goto end;
+        case KM_ALGORITHM_EC:
+            if (op->md == NULL) {
+                take = MIN(input_len, op->data_max - op->data_len);
+                memcpy(op->data + op->data_len, input, take);
+                op->data_len += take;
+            }
+            break;
+        default:
+            if (op->md == NULL) {
+                CHECK_TRUE(KM_ERROR_INVALID_INPUT_LENGTH,
+                    input_len <= op->data_max - op->data_len);
+                memcpy(op->data + op->data_len, input, input_len);
+                op->data_len += input_len;
+            }
+            break;
+    }
+    if ((op->md != NULL) && (input_len > 0)) {
+        CHECK_TRUE(KM_ERROR_UNKNOWN_ERROR, EVP_DigestUpdate(op->md, input, input_len));
+    }
+    *output_len = 0;
+
+end:
+    return ret;
+}
+
+static keymaster_error_t op_finish(
+    km_mock_op_t *op,
+    const keymaster_key_param_set_t *params,
+    const uint8_t *signature,
+    uint32_t signature_len,
+    uint8_t *output,
+    uint32_t *output_len)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+
+    switch (op->algorithm) {
+        case KM_ALGORITHM_AES:
+            CHECK_RESULT_OK(aes_aad(op, params));
+            CHECK_RESULT_OK(aes_finish(op, output, output_len));
+            break;
+        case KM_ALGORITHM_HMAC:
+            CHECK_RESULT_OK(hmac_finish(op, signature, signature_len, output, output_len));
+            break;
+        case KM_ALGORITHM_RSA:
+            CHECK_RESULT_OK(rsa_finish(op, signature, signature_len, output, output_len));
+            break;
+        default:
+            CHECK_RESULT_OK(ec_finish(op, signature, signature_len, output, output_len));
+            break;
+    }
+
+end:
+    return ret;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Commands                                                                 */
+/* ------------------------------------------------------------------------ */
+
+static keymaster_error_t cmd_add_rng_entropy(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    uint8_t *data;
+
+    CHECK_RESULT_OK(resolve(session_id, &msg->add_rng_entropy.rng_data, &data));
+    if (data != NULL) {
+        RAND_seed(data, msg->add_rng_entropy.rng_data.data_length);
+    }
+
+end:
+    return ret;
+}
+
+static keymaster_error_t cmd_generate_key(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    generate_key_t *cmd = &msg->generate_key;
+    keymaster_key_param_set_t set = {NULL, 0};
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    uint64_t rsa_pubexp;
+    uint8_t *params, *blob, *characteristics;
+    uint8_t *key_data = NULL;
+    uint32_t key_data_len = 0;
+
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->characteristics, &characteristics));
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(read_key_spec(&set, &algorithm, &key_size, &rsa_pubexp));
+    CHECK_RESULT_OK(generate_key_data(algorithm, key_size, rsa_pubexp,
+        &key_data, &key_data_len));
+    CHECK_RESULT_OK(store_key(params, cmd->params.data_length, KM_ORIGIN_GENERATED,
+        key_data, key_data_len, blob, &cmd->key_blob.data_length,
+        characteristics, &cmd->characteristics.data_length));
+
+end:
+    keymaster_free_param_set(&set);
+    free_secret(key_data, key_data_len);
+    return ret;
+}
+
+static keymaster_error_t cmd_get_key_characteristics(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    get_key_characteristics_t *cmd = &msg->get_key_characteristics;
+    km_mock_key_t key;
+    uint8_t *blob, *client_id, *app_data, *characteristics;
+
+    memset(&key, 0, sizeof(key));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->client_id, &client_id));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->app_data, &app_data));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->characteristics, &characteristics));
+    CHECK_RESULT_OK(open_key(false, blob, cmd->key_blob.data_length, &key));
+    CHECK_RESULT_OK(check_binding(&key, client_id, cmd->client_id.data_length,
+        app_data, cmd->app_data.data_length));
+    CHECK_RESULT_OK(write_characteristics(&key.params, characteristics,
+        &cmd->characteristics.data_length));
+
+end:
+    close_key(&key);
+    return ret;
+}
+
+static keymaster_error_t cmd_import_key(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    import_key_t *cmd = &msg->import_key;
+    keymaster_key_param_set_t set = {NULL, 0};
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    uint8_t *params, *key_data, *blob, *characteristics;
+    uint32_t key_data_len;
+
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_data, &key_data));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->characteristics, &characteristics));
+    CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, key_data != NULL);
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(check_key_data(key_data, cmd->key_data.data_length, &key_data_len));
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_ALGORITHM,
+        get_enumerated_tag(&set, KM_TAG_ALGORITHM, (uint32_t*)&algorithm) == KM_ERROR_OK);
+    CHECK_TRUE(KM_ERROR_IMPORT_PARAMETER_MISMATCH, algorithm == get_u32(key_data));
+    if (get_integer_tag(&set, KM_TAG_KEY_SIZE, &key_size) == KM_ERROR_OK) {
+        CHECK_TRUE(KM_ERROR_IMPORT_PARAMETER_MISMATCH, key_size == get_u32(key_data + 4));
+    }
+    CHECK_RESULT_OK(store_key(params, cmd->params.data_length, KM_ORIGIN_IMPORTED,
+        key_data, key_data_len, blob, &cmd->key_blob.data_length,
+        characteristics, &cmd->characteristics.data_length));
+
+end:
+    keymaster_free_param_set(&set);
+    return ret;
+}
+
+static keymaster_error_t cmd_export_key(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    export_key_t *cmd = &msg->export_key;
+    km_mock_key_t key;
+    uint8_t *blob, *client_id, *app_data, *out;
+    uint8_t *pos;
+    uint32_t len_a, len_b;
+    uint32_t skip;
+
+    memset(&key, 0, sizeof(key));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->client_id, &client_id));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->app_data, &app_data));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_data, &out));
+    CHECK_RESULT_OK(open_key(false, blob, cmd->key_blob.data_length, &key));
+    CHECK_RESULT_OK(check_binding(&key, client_id, cmd->client_id.data_length,
+        app_data, cmd->app_data.data_length));
+
+    /* RSA: keysize | n_len | e_len | n | e, EC: curve | x_len | y_len | x | y */
+    switch (key.algorithm) {
+        case KM_ALGORITHM_RSA:
+            len_a = get_u32(key.core + 4);
+            len_b = get_u32(key.core + 8);
+            skip = KM_RSA_METADATA_SIZE - 12;
+            break;
+        case KM_ALGORITHM_EC:
+            len_a = get_u32(key.core + 4);
+            len_b = get_u32(key.core + 8);
+            skip = KM_EC_METADATA_SIZE - 12;
+            break;
+        default:
+            ret = KM_ERROR_UNSUPPORTED_KEY_FORMAT;
+            goto end;
+    }
+    CHECK_TRUE(KM_ERROR_INSUFFICIENT_BUFFER_SPACE,
+        (out != NULL) && (cmd->key_data.data_length >= 12 + len_a + len_b));
+    pos = out;
+    set_data_increment_pos(&pos, key.core, 12);
+    set_data_increment_pos(&pos, key.core + 12 + skip, len_a + len_b);
+    cmd->key_data.data_length = 12 + len_a + len_b;
+
+end:
+    close_key(&key);
+    return ret;
+}
+
+static keymaster_error_t cmd_begin(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    begin_t *cmd = &msg->begin;
+    keymaster_key_param_set_t set = {NULL, 0};
+    const keymaster_key_param_t *client_id;
+    const keymaster_key_param_t *app_data;
+    km_mock_key_t key;
+    km_mock_op_t *op = NULL;
+    uint8_t *params, *blob, *out_params;
+    uint32_t out_params_len = cmd->out_params.data_length;
+
+    memset(&key, 0, sizeof(key));
+    cmd->out_params.data_length = 0;
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    out_params = (out_params_len > 0) ?
+        (uint8_t*)mcMockResolve(session_id, cmd->out_params.data, out_params_len) : NULL;
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(open_key(false, blob, cmd->key_blob.data_length, &key));
+
+    client_id = find_param(&set, KM_TAG_APPLICATION_ID);
+    app_data = find_param(&set, KM_TAG_APPLICATION_DATA);
+    CHECK_RESULT_OK(check_binding(&key,
+        (client_id != NULL) ? client_id->blob.data : NULL,
+        (client_id != NULL) ? client_id->blob.data_length : 0,
+        (app_data != NULL) ? app_data->blob.data : NULL,
+        (app_data != NULL) ? app_data->blob.data_length : 0));
+    CHECK_TRUE(KM_ERROR_UNSUPPORTED_PURPOSE, check_algorithm_purpose(key.algorithm, cmd->purpose));
+    CHECK_TRUE(KM_ERROR_INCOMPATIBLE_PURPOSE, key_allows_purpose(&key, cmd->purpose));
+
+    op = op_alloc(session_id, key.algorithm);
+    CHECK_TRUE(KM_ERROR_TOO_MANY_OPERATIONS, op != NULL);
+    op->purpose = cmd->purpose;
+    switch (key.algorithm) {
+        case KM_ALGORITHM_AES:
+            CHECK_RESULT_OK(begin_aes(op, &key, &set, out_params, &out_params_len));
+            cmd->out_params.data_length = out_params_len;
+            break;
+        case KM_ALGORITHM_HMAC:
+            CHECK_RESULT_OK(begin_hmac(op, &key, &set));
+            break;
+        case KM_ALGORITHM_RSA:
+            CHECK_RESULT_OK(begin_rsa(op, &key, &set));
+            break;
+        case KM_ALGORITHM_EC:
+            CHECK_RESULT_OK(begin_ec(op, &key, &set));
+            break;
+        default:
+            ret = KM_ERROR_UNSUPPORTED_ALGORITHM;
+            goto end;
+    }
+    cmd->handle = op->handle;
+
+end:
+    if ((ret != KM_ERROR_OK) && (op != NULL)) {
+        op_free(op);
+    }
+    keymaster_free_param_set(&set);
+    close_key(&key);
+    return ret;
+}
+
+static keymaster_error_t cmd_update(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    update_t *cmd = &msg->update;
+    keymaster_key_param_set_t set = {NULL, 0};
+    km_mock_op_t *op;
+    uint8_t *params, *input, *output;
+    uint32_t output_len = cmd->output.data_length;
+
+    cmd->input_consumed = 0;
+    cmd->output.data_length = 0;
+    op = op_find(session_id, cmd->handle);
+    CHECK_TRUE(KM_ERROR_INVALID_OPERATION_HANDLE, op != NULL);
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->input, &input));
+    output = (output_len > 0) ?
+        (uint8_t*)mcMockResolve(session_id, cmd->output.data, output_len) : NULL;
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(op_update(op, &set, input, cmd->input.data_length, output, &output_len));
+    cmd->input_consumed = cmd->input.data_length;
+    cmd->output.data_length = output_len;
+
+end:
+    if ((ret != KM_ERROR_OK) && (op != NULL)) {
+        op_free(op);
+    }
+    keymaster_free_param_set(&set);
+    return ret;
+}
+
+static keymaster_error_t cmd_finish(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    finish_t *cmd = &msg->finish;
+    keymaster_key_param_set_t set = {NULL, 0};
+    km_mock_op_t *op;
+    uint8_t *params, *signature, *output;
+    uint32_t output_len = cmd->output.data_length;
+
+    cmd->output.data_length = 0;
+    op = op_find(session_id, cmd->handle);
+    CHECK_TRUE(KM_ERROR_INVALID_OPERATION_HANDLE, op != NULL);
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->signature, &signature));
+    output = (output_len > 0) ?
+        (uint8_t*)mcMockResolve(session_id, cmd->output.data, output_len) : NULL;
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(op_finish(op, &set, signature, cmd->signature.data_length,
+        output, &output_len));
+    cmd->output.data_length = output_len;
+
+end:
+    if (op != NULL) {
+        op_free(op);
+    }
+    keymaster_free_param_set(&set);
+    return ret;
+}
+
+static keymaster_error_t cmd_update_finish(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    update_finish_t *cmd = &msg->update_finish;
+    keymaster_key_param_set_t set = {NULL, 0};
+    km_mock_op_t *op;
+    uint8_t *params, *input, *signature, *output;
+    uint32_t capacity = cmd->output.data_length;
+    uint32_t update_len;
+    uint32_t finish_len;
+
+    cmd->output.data_length = 0;
+    op = op_find(session_id, cmd->handle);
+    if (op == NULL) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+    /* the HAL falls back to update() and finish(), with the operation intact */
+    update_len = (op->algorithm == KM_ALGORITHM_AES) ?
+        cmd->input.data_length + KM_MOCK_AES_BLOCK_SIZE : 0;
+    if (capacity < update_len + op_finish_length(op)) {
+        return KM_ERROR_UNIMPLEMENTED;
+    }
+
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->input, &input));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->signature, &signature));
+    output = (capacity > 0) ?
+        (uint8_t*)mcMockResolve(session_id, cmd->output.data, capacity) : NULL;
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    /* associated data has to come before the input */
+    update_len = capacity;
+    CHECK_RESULT_OK(op_update(op, &set, input, cmd->input.data_length, output, &update_len));
+    finish_len = capacity - update_len;
+    CHECK_RESULT_OK(op_finish(op, NULL, signature, cmd->signature.data_length,
+        (output != NULL) ? output + update_len : NULL, &finish_len));
+    cmd->output.data_length = update_len + finish_len;
+
+end:
+    op_free(op);
+    keymaster_free_param_set(&set);
+    return ret;
+}
+
+static keymaster_error_t cmd_abort(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    km_mock_op_t *op = op_find(session_id, msg->abort.handle);
+
+    if (op == NULL) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+    op_free(op);
+    return KM_ERROR_OK;
+}
+
+static keymaster_error_t cmd_pregenerate_key(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    pregenerate_key_t *cmd = &msg->pregenerate_key;
+    keymaster_key_param_set_t set = {NULL, 0};
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    uint64_t rsa_pubexp;
+    uint8_t *params, *blob;
+    uint8_t *key_data = NULL;
+    uint32_t key_data_len = 0;
+    uint8_t *material = NULL;
+    uint32_t material_len = 0;
+    uint8_t *pos;
+
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(read_key_spec(&set, &algorithm, &key_size, &rsa_pubexp));
+    CHECK_RESULT_OK(generate_key_data(algorithm, key_size, rsa_pubexp,
+        &key_data, &key_data_len));
+
+    material_len = 4 + cmd->params.data_length + key_data_len;
+    material = (uint8_t*)malloc(material_len);
+    CHECK_TRUE(KM_ERROR_MEMORY_ALLOCATION_FAILED, material != NULL);
+    pos = material;
+    set_u32_increment_pos(&pos, cmd->params.data_length);
+    set_data_increment_pos(&pos, params, cmd->params.data_length);
+    set_data_increment_pos(&pos, key_data, key_data_len);
+    CHECK_RESULT_OK(wrap_blob(true, material, material_len, blob, &cmd->key_blob.data_length));
+
+end:
+    keymaster_free_param_set(&set);
+    free_secret(key_data, key_data_len);
+    free_secret(material, material_len);
+    return ret;
+}
+
+static keymaster_error_t cmd_finalize_key(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    finalize_key_t *cmd = &msg->finalize_key;
+    keymaster_key_param_set_t set = {NULL, 0};
+    keymaster_algorithm_t algorithm;
+    uint32_t key_size;
+    uint64_t rsa_pubexp;
+    uint64_t unbound_pubexp = 0;
+    km_mock_key_t unbound;
+    uint8_t *params, *unbound_blob, *blob, *characteristics;
+
+    memset(&unbound, 0, sizeof(unbound));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->params, &params));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->unbound_blob, &unbound_blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->characteristics, &characteristics));
+    CHECK_RESULT_OK(read_params(params, cmd->params.data_length, &set));
+    CHECK_RESULT_OK(read_key_spec(&set, &algorithm, &key_size, &rsa_pubexp));
+    CHECK_RESULT_OK(open_key(true, unbound_blob, cmd->unbound_blob.data_length, &unbound));
+    if (algorithm == KM_ALGORITHM_RSA) {
+        unbound_pubexp = 65537;
+        get_long_integer_tag(&unbound.params, KM_TAG_RSA_PUBLIC_EXPONENT, &unbound_pubexp);
+    }
+    CHECK_TRUE(KM_ERROR_INVALID_ARGUMENT, (algorithm == unbound.algorithm) &&
+        (key_size == unbound.key_size) && (rsa_pubexp == unbound_pubexp));
+    CHECK_RESULT_OK(store_key(params, cmd->params.data_length, KM_ORIGIN_GENERATED,
+        unbound.key_data, unbound.key_data_len, blob, &cmd->key_blob.data_length,
+        characteristics, &cmd->characteristics.data_length));
+
+end:
+    keymaster_free_param_set(&set);
+    close_key(&unbound);
+    return ret;
+}
+
+static keymaster_error_t cmd_get_key_info(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    keymaster_error_t ret = KM_ERROR_OK;
+    get_key_info_t *cmd = &msg->get_key_info;
+    km_mock_key_t key;
+    uint8_t *blob;
+
+    memset(&key, 0, sizeof(key));
+    CHECK_RESULT_OK(resolve(session_id, &cmd->key_blob, &blob));
+    CHECK_RESULT_OK(open_key(false, blob, cmd->key_blob.data_length, &key));
+    cmd->key_type = key.algorithm;
+    cmd->key_size = key.key_size;
+
+end:
+    close_key(&key);
+    return ret;
+}
+
+static keymaster_error_t cmd_get_operation_info(
+    uint32_t session_id,
+    tciMessage_ptr msg)
+{
+    km_mock_op_t *op = op_find(session_id, msg->get_operation_info.handle);
+
+    if (op == NULL) {
+        return KM_ERROR_INVALID_OPERATION_HANDLE;
+    }
+    msg->get_operation_info.algorithm = op->algorithm;
+    msg->get_operation_info.data_length = op_finish_length(op);
+    return KM_ERROR_OK;
+}
+
+static mcResult_t km_mock_notify(
+    void *ctx,
+    uint32_t session_id,
+    uint8_t *tci,
+    uint32_t tci_len)
+{
+    tciMessage_ptr msg = (tciMessage_ptr)tci;
+    tciCommandId_t command_id;
+    keymaster_error_t ret;
+
+    (void)ctx;
+    if (tci_len < sizeof(tciMessage_t)) {
+        return MC_DRV_ERR_INVALID_PARAMETER;
+    }
+    /* the response overwrites the command header */
+    command_id = msg->command.header.commandId;
+    switch (command_id) {
+        case CMD_ID_TEE_ADD_RNG_ENTROPY:
+            ret = cmd_add_rng_entropy(session_id, msg);
+            break;
+        case CMD_ID_TEE_GENERATE_KEY:
+            ret = cmd_generate_key(session_id, msg);
+            break;
+        case CMD_ID_TEE_GET_KEY_CHARACTERISTICS:
+            ret = cmd_get_key_characteristics(session_id, msg);
+            break;
+        case CMD_ID_TEE_IMPORT_KEY:
+            ret = cmd_import_key(session_id, msg);
+            break;
+        case CMD_ID_TEE_EXPORT_KEY:
+            ret = cmd_export_key(session_id, msg);
+            break;
+        case CMD_ID_TEE_BEGIN:
+            ret = cmd_begin(session_id, msg);
+            break;
+        case CMD_ID_TEE_UPDATE:
+            ret = cmd_update(session_id, msg);
+            break;
+        case CMD_ID_TEE_FINISH:
+            ret = cmd_finish(session_id, msg);
+            break;
+        case CMD_ID_TEE_ABORT:
+            ret = cmd_abort(session_id, msg);
+            break;
+        case CMD_ID_TEE_UPDATE_FINISH:
+            ret = cmd_update_finish(session_id, msg);
+            break;
+        case CMD_ID_TEE_PREGENERATE_KEY:
+            ret = cmd_pregenerate_key(session_id, msg);
+            break;
+        case CMD_ID_TEE_FINALIZE_KEY:
+            ret = cmd_finalize_key(session_id, msg);
+            break;
+        case CMD_ID_TEE_GET_KEY_INFO:
+            ret = cmd_get_key_info(session_id, msg);
+            break;
+        case CMD_ID_TEE_GET_OPERATION_INFO:
+            ret = cmd_get_operation_info(session_id, msg);
+            break;
+        case CMD_ID_TEE_GET_CAPABILITIES:
+            msg->get_capabilities.flags = TEE_CAP_UPDATE_FINISH | TEE_CAP_KEY_POOL;
+            ret = KM_ERROR_OK;
+            break;
+        default:
+            ret = KM_ERROR_UNIMPLEMENTED;
+            break;
+    }
+    msg->response.header.responseId = RSP_ID(command_id);
+    msg->response.header.returnCode = (uint32_t)ret;
+    return MC_DRV_OK;
+}
+
+static void km_mock_close(
+    void *ctx,
+    uint32_t session_id)
+{
+    bool mine;
+
+    (void)ctx;
+    for (int i = 0; i < KM_MOCK_OPERATION_SLOTS; i++) {
+        pthread_mutex_lock(&g_lock);
+        mine = g_ops[i].in_use && (g_ops[i].session_id == session_id);
+        pthread_mutex_unlock(&g_lock);
+        if (mine) {
+            op_free(&g_ops[i]);
+        }
+    }
+}
+
+/*
+ * The host build has no property service: secure_os.init reads as done and
+ * anything else comes from the environment, so that for instance
+ * ro.hardware.keymaster.key_pool=4 turns the key pool on.
+ */
+extern "C" int property_get(
+    const char *key,
+    char *value,
+    const char *default_value)
+{
+    const char *found = getenv(key);
+    size_t len;
+
+    if (strcmp(key, "secure_os.init") == 0) {
+        found = "done";
+    } else if (found == NULL) {
+        found = (default_value != NULL) ? default_value : "";
+    }
+    len = strlen(found);
+    if (len > PROPERTY_VALUE_MAX - 1) {
+        len = PROPERTY_VALUE_MAX - 1;
+    }
+    memcpy(value, found, len);
+    value[len] = '\0';
+    return len;
+}
+
+keymaster_error_t km_ta_mock_register(
+    uint32_t latency_us)
+{
+    const mcUuid_t uuid = TEE_KEYMASTER_M_TA_UUID;
+
+    memset(&g_ta, 0, sizeof(g_ta));
+    g_ta.onNotify = km_mock_notify;
+    g_ta.onClose = km_mock_close;
+    g_ta.latencyUs = latency_us;
+    if (mcMockRegisterTa(&uuid, &g_ta) != MC_DRV_OK) {
+        return KM_ERROR_SECURE_HW_COMMUNICATION_FAILED;
+    }
+    return KM_ERROR_OK;
+}
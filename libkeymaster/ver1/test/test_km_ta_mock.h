@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013-2016 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef __TEST_KM_TA_MOCK_H__
+#define __TEST_KM_TA_MOCK_H__
+
+#include <hardware/keymaster_defs.h>
+
+/**
+ * Register a model of the Keymaster TA with libMcClientMock, for host builds
+ * of the tests and the benchmark. Must be called before the HAL opens its
+ * sessions.
+ *
+ * The model answers every command of tlTeeKeymaster_Api.h with OpenSSL,
+ * using the key blob, key data and export formats documented there, and
+ * advertises TEE_CAP_UPDATE_FINISH and TEE_CAP_KEY_POOL. Key blobs are
+ * wrapped under a fixed key, so they mean nothing outside the process. Auth
+ * tokens and the time- and use-based restrictions are not enforced.
+ *
+ * @param latency_us simulated world switch time per command
+ *
+ * @return KM_ERROR_OK or error
+ */
+keymaster_error_t km_ta_mock_register(
+    uint32_t latency_us);
+
+#endif /* __TEST_KM_TA_MOCK_H__ */
@@ -29,6 +29,7 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <time.h>
 #include <hardware/keymaster_defs.h>
 #include <hardware/keymaster1.h>
 
@@ -199,3 +200,10 @@ void km_free_key_blob(
         key_blob->key_material_size = 0;
     }
 }
+
+uint64_t km_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -98,4 +98,9 @@ void km_free_blob(
 void km_free_key_blob(
     keymaster_key_blob_t *key_blob);
 
+/**
+ * Monotonic time in microseconds, for timing measurements
+ */
+uint64_t km_time_us(void);
+
 #endif /* __TEST_KM_UTIL_H__ */
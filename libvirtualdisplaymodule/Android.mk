@@ -19,4 +19,5 @@ LOCAL_C_INCLUDES += \
 endif
 
 LOCAL_SRC_FILES += \
-	./../../$(TARGET_SOC)/libvirtualdisplaymodule/ExynosVirtualDisplayModule.cpp
+	./../../$(TARGET_SOC)/libvirtualdisplaymodule/ExynosVirtualDisplayModule.cpp \
+	./../../$(TARGET_SOC)/libvirtualdisplaymodule/ExynosWfdBlendPlanner.cpp
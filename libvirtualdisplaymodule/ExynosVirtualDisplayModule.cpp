@@ -1,6 +1,8 @@
+#include <sync/sync.h>
 #include "ExynosVirtualDisplayModule.h"
 #include "ExynosHWCUtils.h"
 #include "ExynosMPPModule.h"
+#include "ExynosHWCTraceLayer.h"
 
 #ifdef EVD_DBUG
 #define DISPLAY_LOGD(msg, ...) ALOGD("[%s] " msg, mDisplayName.string(), ##__VA_ARGS__)
@@ -16,6 +18,8 @@
 #define DISPLAY_LOGE(msg, ...)
 #endif
 
+static const ExynosFenceOps syncFenceOps = { dup, close, sync_merge, sync_wait };
+
 ExynosVirtualDisplayModule::ExynosVirtualDisplayModule(struct exynos5_hwc_composer_device_1_t *pdev)
     : ExynosVirtualDisplay(pdev)
 {
@@ -41,6 +45,14 @@ void ExynosVirtualDisplayModule::determineYuvOverlay(hwc_display_contents_1_t *c
         DISPLAY_LOGD("BufferQueue is abandoned.");
     }
 
+    /* isOverlaySupported() of the same DRM layers as a recent frame says the same */
+    ExynosCompositionCache::Key key;
+    int32_t verdicts[COMPOSITION_CACHE_VALUE_WORDS];
+    int numWords, numVerdicts = 0;
+
+    overlayKey(contents, key);
+    numWords = mOverlayCache.lookup(key, verdicts);
+
     for (size_t i = 0; i < contents->numHwLayers; i++) {
         ExynosMPPModule* supportedExternalMPP = NULL;
         hwc_layer_1_t &layer = contents->hwLayers[i];
@@ -50,7 +62,8 @@ void ExynosVirtualDisplayModule::determineYuvOverlay(hwc_display_contents_1_t *c
 
             /* check yuv drm surface */
             if (!mForceFb && !isFormatRgb(handle->format) && (getDrmMode(handle->flags) != NO_DRM)) {
-                if (isOverlaySupported(contents->hwLayers[i], i, false, NULL, &supportedExternalMPP))
+                if (isOverlaySupportedCached(layer, i, verdicts, numWords, numVerdicts++,
+                            &supportedExternalMPP))
                 {
                         this->mYuvLayers++;
 
@@ -98,6 +111,86 @@ void ExynosVirtualDisplayModule::determineYuvOverlay(hwc_display_contents_1_t *c
             }
         }
     }
+
+    if (numWords < 0)
+        mOverlayCache.store(key, verdicts, numVerdicts * 3);
+}
+
+/*
+ * What determineYuvOverlay() asks isOverlaySupported() about: the sink
+ * format, and of every DRM layer what it reads and where, as windowKey()
+ * has it. Not the handles, a new buffer of the same size does not change
+ * the verdict.
+ */
+void ExynosVirtualDisplayModule::overlayKey(hwc_display_contents_1_t *contents,
+        ExynosCompositionCache::Key &key)
+{
+    key.add((int32_t)mExternalMPPDstFormat);
+
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        hwc_layer_1_t &layer = contents->hwLayers[i];
+
+        if (!layer.handle)
+            continue;
+
+        private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
+        if (isFormatRgb(handle->format) || getDrmMode(handle->flags) == NO_DRM)
+            continue;
+
+        key.add((uint32_t)i);
+        key.add((int32_t)handle->format);
+        key.add((int32_t)getDrmMode(handle->flags));
+        key.add((int32_t)handle->width);
+        key.add((int32_t)handle->height);
+        key.add((uint32_t)(layer.flags & HWC_SKIP_LAYER));
+        key.add((uint32_t)layer.transform);
+        key.add(layer.displayFrame.left, layer.displayFrame.top,
+                layer.displayFrame.right, layer.displayFrame.bottom);
+        key.add(layer.sourceCropf.left);
+        key.add(layer.sourceCropf.top);
+        key.add(layer.sourceCropf.right);
+        key.add(layer.sourceCropf.bottom);
+    }
+}
+
+/*
+ * isOverlaySupported() for the n-th DRM layer, or its verdict and flags
+ * from verdicts if numWords says they were cached. A cached yes still asks
+ * the MPP, and checks the layer again if the MPP says no. On a miss the
+ * verdict is added to verdicts: supported, then the overlay and MPP flags
+ * it set.
+ */
+bool ExynosVirtualDisplayModule::isOverlaySupportedCached(hwc_layer_1_t &layer, size_t index,
+        int32_t *verdicts, int numWords, int n, ExynosMPPModule **supportedExternalMPP)
+{
+    bool fits = n * 3 + 3 <= COMPOSITION_CACHE_VALUE_WORDS;
+    int32_t *verdict = fits ? &verdicts[n * 3] : NULL;
+
+    if (numWords >= 0) {
+        ExynosMPPModule *externalMPP = mExternalMPPs[WFD_EXT_MPP_IDX];
+
+        if (n * 3 + 3 > numWords ||
+                (verdict[0] && externalMPP->isFormatSupportedByMPP(mExternalMPPDstFormat) <= 0))
+            return isOverlaySupported(layer, index, false, NULL, supportedExternalMPP);
+
+        mLayerInfos[index]->mCheckOverlayFlag |= verdict[1];
+        mLayerInfos[index]->mCheckMPPFlag |= verdict[2];
+        if (!verdict[0])
+            return false;
+        *supportedExternalMPP = externalMPP;
+        return true;
+    }
+
+    int32_t overlayFlag = mLayerInfos[index]->mCheckOverlayFlag;
+    int32_t mppFlag = mLayerInfos[index]->mCheckMPPFlag;
+    bool supported = isOverlaySupported(layer, index, false, NULL, supportedExternalMPP);
+
+    if (fits) {
+        verdict[0] = supported;
+        verdict[1] = mLayerInfos[index]->mCheckOverlayFlag & ~overlayFlag;
+        verdict[2] = mLayerInfos[index]->mCheckMPPFlag & ~mppFlag;
+    }
+    return supported;
 }
 
 void ExynosVirtualDisplayModule::determineSupportedOverlays(hwc_display_contents_1_t *contents)
@@ -115,9 +208,7 @@ void ExynosVirtualDisplayModule::determineSupportedOverlays(hwc_display_contents
 
     if (contents->outbuf) {
         private_handle_t *h = private_handle_t::dynamicCast(contents->outbuf);
-        DISPLAY_LOGD("DSO: Outbuf layer f=%x, fds[%d](%d, %d, %d), sz(%d) wxh(%dx%d)m stride(%d) fence(%d) P(%d)",
-                    h->format, h->sNumFds, h->fd, h->fd1, h->fd2, h->size, h->width,
-                    h->height, h->stride, contents->outbufAcquireFenceFd, getDrmMode(h->flags));
+        HWC_TRACE(HWC_TRACE_OUTBUF, hwcTraceOutbuf(mTrace, contents));
         mExternalMPPDstFormat = h->format;
     }
 
@@ -125,19 +216,8 @@ void ExynosVirtualDisplayModule::determineSupportedOverlays(hwc_display_contents
     for (size_t i = 0; i < contents->numHwLayers; i++) {
         hwc_layer_1_t &layer = contents->hwLayers[i];
 
-        if (layer.handle) {
-            private_handle_t *h = private_handle_t::dynamicCast(layer.handle);
-            DISPLAY_LOGD("DSO: layer %d type=%d, f=%x, w=%d, h=%d, s=%d, vs=%d, "
-                  "{%.1f, %.1f, %.1f, %.1f}, {%d, %d, %d, %d}"
-                  "fl=%08x, hdl=%p, trf=%02x, bl=%04x, Af=%d, Rf=%d, P=%d",
-                    i, layer.compositionType, h->format, h->width, h->height, h->stride,
-                    h->vstride, layer.sourceCropf.left, layer.sourceCropf.top,
-                    layer.sourceCropf.right, layer.sourceCropf.bottom,
-                    layer.displayFrame.left, layer.displayFrame.top,
-                    layer.displayFrame.right, layer.displayFrame.bottom,
-                    layer.flags, layer.handle, layer.transform, layer.blending,
-                    layer.acquireFenceFd, layer.releaseFenceFd, getDrmMode(layer.flags));
-        }
+        if (layer.handle)
+            HWC_TRACE(HWC_TRACE_PREPARE, hwcTraceLayer(mTrace, HWC_TRACE_PREPARE, i, layer));
 
         if (!mFbNeeded) {
             mFirstFb = i;
@@ -213,6 +293,7 @@ bool ExynosVirtualDisplayModule::isOverlaySupported(hwc_layer_1_t &layer, size_t
 int ExynosVirtualDisplayModule::prepare(hwc_display_contents_1_t *contents)
 {
     int ret = 0;
+    mTrace.nextFrame();
     mIsRotationState = false;
     mCompositionType = COMPOSITION_GLES;
     mOverlayLayer = NULL;
@@ -361,38 +442,12 @@ int ExynosVirtualDisplayModule::set(hwc_display_contents_1_t *contents)
         }
 
 cont:
-        if (layer.handle) {
-            private_handle_t *h = private_handle_t::dynamicCast(layer.handle);
-            DISPLAY_LOGD("SET: layer %d type=%d, f=%x, w=%d, h=%d, s=%d, vs=%d, "
-                  "{%.1f, %.1f, %.1f, %.1f}, {%d, %d, %d, %d}"
-                  "fl=%08x, hdl=%p, trf=%02x, bl=%04x, Af=%d, Rf=%d, P=%d",
-                    i, layer.compositionType, h->format, h->width, h->height, h->stride,
-                    h->vstride, layer.sourceCropf.left, layer.sourceCropf.top,
-                    layer.sourceCropf.right, layer.sourceCropf.bottom,
-                    layer.displayFrame.left, layer.displayFrame.top,
-                    layer.displayFrame.right, layer.displayFrame.bottom,
-                    layer.flags, layer.handle, layer.transform, layer.blending,
-                    layer.acquireFenceFd, layer.releaseFenceFd, getDrmMode(layer.flags));
-        }
+        if (layer.handle)
+            HWC_TRACE(HWC_TRACE_SET, hwcTraceLayer(mTrace, HWC_TRACE_SET, i, layer));
     }
 
     if (mFBTargetLayer && IsNormalDRMWithSkipLayer) {
-        for (size_t i = 0; i < contents->numHwLayers; i++) {
-        hwc_layer_1_t &layer = contents->hwLayers[i];
-
-            if (layer.acquireFenceFd >= 0 && layer.compositionType != HWC_FRAMEBUFFER_TARGET) {
-                close(layer.acquireFenceFd);
-                layer.acquireFenceFd = -1;
-            }
-        }
-
-        if (mFBTargetLayer && mFBTargetLayer->acquireFenceFd >= 0)
-            contents->retireFenceFd = mFBTargetLayer->acquireFenceFd;
-
-        if (contents->outbufAcquireFenceFd >= 0) {
-            close(contents->outbufAcquireFenceFd);
-            contents->outbufAcquireFenceFd = -1;
-        }
+        skipFrame(contents);
     } else if (mFBTargetLayer && mCompositionType == COMPOSITION_GLES) {
         processGles(contents);
     } else if (mFBTargetLayer && mOverlayLayer && mCompositionType == COMPOSITION_MIXED) {
@@ -400,22 +455,7 @@ cont:
     } else if (mOverlayLayer) {
         processHwc(contents);
     } else {
-        for (size_t i = 0; i < contents->numHwLayers; i++) {
-        hwc_layer_1_t &layer = contents->hwLayers[i];
-
-            if (layer.acquireFenceFd >= 0 && layer.compositionType != HWC_FRAMEBUFFER_TARGET) {
-                close(layer.acquireFenceFd);
-                layer.acquireFenceFd = -1;
-            }
-        }
-
-        if (mFBTargetLayer && mFBTargetLayer->acquireFenceFd >= 0)
-            contents->retireFenceFd = mFBTargetLayer->acquireFenceFd;
-
-        if (contents->outbufAcquireFenceFd >= 0) {
-            close(contents->outbufAcquireFenceFd);
-            contents->outbufAcquireFenceFd = -1;
-        }
+        skipFrame(contents);
     }
 
     mPrevCompositionType = mCompositionType;
@@ -425,26 +465,87 @@ cont:
 
 void ExynosVirtualDisplayModule::processGles(hwc_display_contents_1_t *contents)
 {
+    /* GLES writes the whole outbuf */
+    mBlendPlanner.invalidate(contents->outbuf);
+    mBlendPlanner.fbTargetRendered();
+
     DISPLAY_LOGD("processGles, FBTgt->acqFence %d, FBTgt->relFence %d, outbufAcqFence %d",
         mFBTargetLayer->acquireFenceFd, mFBTargetLayer->releaseFenceFd,
         contents->outbufAcquireFenceFd);
 
-    if (mFBTargetLayer != NULL && mFBTargetLayer->acquireFenceFd >= 0)
+    ExynosFenceSet fences(&syncFenceOps);
+
+    fences.own(contents->outbufAcquireFenceFd);
+    contents->outbufAcquireFenceFd = -1;
+
+    /* GLES is done once the FB target is */
+    if (mFBTargetLayer != NULL && mFBTargetLayer->acquireFenceFd >= 0) {
+        contents->retireFenceFd = mFBTargetLayer->acquireFenceFd;
+        mFBTargetLayer->acquireFenceFd = -1;
+    }
+}
+
+void ExynosVirtualDisplayModule::skipFrame(hwc_display_contents_1_t *contents)
+{
+    ExynosFenceSet fences(&syncFenceOps);
+
+    /* Nothing is written to the outbuf, GLES may still have composed */
+    mBlendPlanner.invalidate(contents->outbuf);
+    if (mNumFB > 0)
+        mBlendPlanner.fbTargetRendered();
+
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        hwc_layer_1_t &layer = contents->hwLayers[i];
+
+        if (layer.compositionType != HWC_FRAMEBUFFER_TARGET) {
+            fences.own(layer.acquireFenceFd);
+            layer.acquireFenceFd = -1;
+        }
+    }
+    fences.own(contents->outbufAcquireFenceFd);
+    contents->outbufAcquireFenceFd = -1;
+
+    if (mFBTargetLayer && mFBTargetLayer->acquireFenceFd >= 0) {
         contents->retireFenceFd = mFBTargetLayer->acquireFenceFd;
+        mFBTargetLayer->acquireFenceFd = -1;
+    }
+}
+
+/*
+ * Every acquire fence of the frame goes into one ExynosFenceSet before
+ * anything is posted, so it is closed exactly once however posting ends.
+ * A layer skipped with HWC_SKIP_RENDERING hands its acquire fence back as
+ * its release fence instead.
+ */
+void ExynosVirtualDisplayModule::ownFences(hwc_display_contents_1_t *contents,
+        ExynosFenceSet &fences)
+{
+    for (size_t i = 0; i < contents->numHwLayers; i++) {
+        hwc_layer_1_t &layer = contents->hwLayers[i];
 
-    if (contents->outbufAcquireFenceFd >= 0) {
-        close(contents->outbufAcquireFenceFd);
-        contents->outbufAcquireFenceFd = -1;
+        /* A skipped layer's acquire fence becomes its release fence, unless
+         * it already has one; then it is closed with the rest */
+        if ((layer.flags & HWC_SKIP_RENDERING) && layer.releaseFenceFd < 0) {
+            layer.releaseFenceFd = layer.acquireFenceFd;
+            layer.acquireFenceFd = -1;
+        } else if (fences.own(layer.acquireFenceFd) < 0 && layer.acquireFenceFd >= 0) {
+            DISPLAY_LOGE("too many fences, layer %d acquire fence %d not owned",
+                    i, layer.acquireFenceFd);
+        }
     }
+    fences.own(contents->outbufAcquireFenceFd);
 }
 
 void ExynosVirtualDisplayModule::processHwc(hwc_display_contents_1_t *contents)
 {
     DISPLAY_LOGD("processHwc, outbufAcqFence %d", contents->outbufAcquireFenceFd);
 
-    int fence = postFrame(contents);
+    ExynosFenceSet fences(&syncFenceOps);
+    ownFences(contents, fences);
 
-    manageFences(contents, fence);
+    int fence = postFrame(contents, fences);
+
+    manageFences(contents, fences, fence);
 }
 
 void ExynosVirtualDisplayModule::processMixed(hwc_display_contents_1_t *contents)
@@ -453,12 +554,16 @@ void ExynosVirtualDisplayModule::processMixed(hwc_display_contents_1_t *contents
         mFBTargetLayer->acquireFenceFd, mFBTargetLayer->releaseFenceFd,
         contents->outbufAcquireFenceFd);
 
-    int fence = postFrame(contents);
+    ExynosFenceSet fences(&syncFenceOps);
+    ownFences(contents, fences);
+
+    int fence = postFrame(contents, fences);
 
-    manageFences(contents, fence);
+    manageFences(contents, fences, fence);
 }
 
-int ExynosVirtualDisplayModule::postFrame(hwc_display_contents_1_t *contents)
+int ExynosVirtualDisplayModule::postFrame(hwc_display_contents_1_t *contents,
+        ExynosFenceSet &fences)
 {
     int ret = -1;
     int win_map = 0;
@@ -481,10 +586,9 @@ int ExynosVirtualDisplayModule::postFrame(hwc_display_contents_1_t *contents)
         hwc_layer_1_t &layer = contents->hwLayers[i];
         size_t window_index = mLayerInfos[i]->mWindowIndex + 1;
 
-        if (layer.flags & HWC_SKIP_RENDERING) {
-            layer.releaseFenceFd = layer.acquireFenceFd;
+        /* its fences were handled by ownFences() */
+        if (layer.flags & HWC_SKIP_RENDERING)
             continue;
-        }
 
         if (layer.compositionType == HWC_OVERLAY) {
             mLastHandles[window_index] = layer.handle;
@@ -493,7 +597,7 @@ int ExynosVirtualDisplayModule::postFrame(hwc_display_contents_1_t *contents)
                 mLastMPPMap[window_index].external_mpp.type = mLayerInfos[i]->mExternalMPP->mType;
                 mLastMPPMap[window_index].external_mpp.index = mLayerInfos[i]->mExternalMPP->mIndex;
 
-                ret = postToMPP(layer, mFBTargetLayer, i, contents);
+                ret = postToMPP(layer, mFBTargetLayer, i, contents, fences);
                 if (ret < 0) {
                     DISPLAY_LOGE("postToMPP failed in extended/drm mode.");
                 }
@@ -508,7 +612,7 @@ int ExynosVirtualDisplayModule::postFrame(hwc_display_contents_1_t *contents)
 }
 
 int ExynosVirtualDisplayModule::postToMPP(hwc_layer_1_t &layer, hwc_layer_1_t *layerB,
-        int index, hwc_display_contents_1_t *contents)
+        int index, hwc_display_contents_1_t *contents, ExynosFenceSet &fences)
 {
     int dst_format = mExternalMPPDstFormat;
     private_handle_t *handle = private_handle_t::dynamicCast(layer.handle);
@@ -528,11 +632,35 @@ int ExynosVirtualDisplayModule::postToMPP(hwc_layer_1_t &layer, hwc_layer_1_t *l
         return -1;
     }
 
+    /* The fences stay in the set, the MPP only borrows them for the job */
     exynosMPP->mDstBuffers[exynosMPP->mCurrentBuf] = contents->outbuf;
     exynosMPP->mDstBufFence[exynosMPP->mCurrentBuf] = contents->outbufAcquireFenceFd;
 
+    /* The sink buffer is the destination, only the submit time is recorded */
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
     if (layerB) {
-        if (is2StepBlendingRequired(layer, contents->outbuf)) {
+        private_handle_t *outHandle = private_handle_t::dynamicCast(contents->outbuf);
+        ExynosWfdBlendPlanner::Frame frame;
+
+        frame.outbuf = contents->outbuf;
+        frame.outWidth = outHandle->width;
+        frame.outHeight = outHandle->height;
+        frame.fbTarget = layerB->handle;
+        frame.fbCrop.left = (int)layerB->sourceCropf.left;
+        frame.fbCrop.top = (int)layerB->sourceCropf.top;
+        frame.fbCrop.right = (int)layerB->sourceCropf.right;
+        frame.fbCrop.bottom = (int)layerB->sourceCropf.bottom;
+        frame.videoFrame.left = layer.displayFrame.left;
+        frame.videoFrame.top = layer.displayFrame.top;
+        frame.videoFrame.right = layer.displayFrame.right;
+        frame.videoFrame.bottom = layer.displayFrame.bottom;
+        frame.videoCovers = !is2StepBlendingRequired(layer, contents->outbuf);
+        frame.fbRendered = mNumFB > 0;
+
+        int plan = mBlendPlanner.plan(frame);
+
+        if (plan == ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND) {
             private_handle_t *handleB = private_handle_t::dynamicCast(layerB->handle);
             hwc_frect_t sourceCropB = { 0, 0,
                     (float)WIDTH(layerB->displayFrame), (float)HEIGHT(layerB->displayFrame) };
@@ -544,26 +672,35 @@ int ExynosVirtualDisplayModule::postToMPP(hwc_layer_1_t &layer, hwc_layer_1_t *l
             err = exynosMPP->processM2M(*layerB, dst_format, &sourceCropB, false);
             if (err < 0) {
                 DISPLAY_LOGE("2 step - failed to configure MPP, %d", err);
+                mBlendPlanner.invalidate(contents->outbuf);
+                exynosMPP->recordJob(systemTime(SYSTEM_TIME_MONOTONIC) - start, false);
+                exynosMPP->mDstBufFence[exynosMPP->mCurrentBuf] = -1;
                 return -1;
             }
+            mBlendPlanner.filled(frame);
 
+            /* The blend waits for the fill */
             exynosMPP->mDstBufFence[exynosMPP->mCurrentBuf] =
-                            exynosMPP->mDstConfig.releaseFenceFd;
+                            fences.own(exynosMPP->mDstConfig.releaseFenceFd);
             exynosMPP->mDstConfig.releaseFenceFd = -1;
         }else {
-            DISPLAY_LOGD("Performing 1-Step blending operation");
-            int tempFence = sync_merge("scaler_blend", layerB->acquireFenceFd,
-                    layer.acquireFenceFd);
+            DISPLAY_LOGD("Performing 1-Step blending operation (%s)",
+                    ExynosWfdBlendPlanner::planName(plan));
 
-            close(layerB->acquireFenceFd);
+            /* The outbuf outside the video still holds this FB target: blend as after a fill */
+            if (plan == ExynosWfdBlendPlanner::PLAN_BLEND_KEEP_FILL)
+                calcDisplayRect(*layerB);
+
+            layer.acquireFenceFd = fences.merge("scaler_blend", layerB->acquireFenceFd,
+                    layer.acquireFenceFd);
             layerB->acquireFenceFd = -1;
-            close(layer.acquireFenceFd);
-            layer.acquireFenceFd = tempFence;
         }
 
         calcDisplayRect(layer);
 
         err = exynosMPP->processM2MWithB(layer, *layerB, dst_format, &sourceCrop);
+        exynosMPP->recordJob(systemTime(SYSTEM_TIME_MONOTONIC) - start, err >= 0);
+        exynosMPP->mDstBufFence[exynosMPP->mCurrentBuf] = -1;
         if (err < 0) {
             DISPLAY_LOGE("failed to configure MPP for blending, %d", err);
             return -1;
@@ -572,6 +709,8 @@ int ExynosVirtualDisplayModule::postToMPP(hwc_layer_1_t &layer, hwc_layer_1_t *l
         DISPLAY_LOGD("Performing Only-Scaling operation");
 
         err = exynosMPP->processM2M(layer, dst_format, &sourceCrop, false);
+        exynosMPP->recordJob(systemTime(SYSTEM_TIME_MONOTONIC) - start, err >= 0);
+        exynosMPP->mDstBufFence[exynosMPP->mCurrentBuf] = -1;
         if (err < 0) {
             DISPLAY_LOGE("failed to configure MPP for scaling, %d", err);
             return -1;
@@ -581,7 +720,9 @@ int ExynosVirtualDisplayModule::postToMPP(hwc_layer_1_t &layer, hwc_layer_1_t *l
     /* Restore displayFrame*/
     layer.displayFrame = originalDisplayFrame;
 
-    return exynosMPP->mDstConfig.releaseFenceFd;
+    int fence = fences.own(exynosMPP->mDstConfig.releaseFenceFd);
+    exynosMPP->mDstConfig.releaseFenceFd = -1;
+    return fence;
 }
 
 bool ExynosVirtualDisplayModule::is2StepBlendingRequired(hwc_layer_1_t &layer,
@@ -595,60 +736,49 @@ bool ExynosVirtualDisplayModule::is2StepBlendingRequired(hwc_layer_1_t &layer,
     return false;
 }
 
-bool ExynosVirtualDisplayModule::manageFences(hwc_display_contents_1_t *contents, int fence)
+/*
+ * SurfaceFlinger closes every release fence it gets, so each layer the MPP
+ * read needs an fd of its own: a dup of the frame's fence. The fence
+ * itself becomes the retire fence.
+ */
+bool ExynosVirtualDisplayModule::manageFences(hwc_display_contents_1_t *contents,
+        ExynosFenceSet &fences, int fence)
 {
     for (size_t i = 0; i < contents->numHwLayers; i++) {
         hwc_layer_1_t &layer = contents->hwLayers[i];
 
-        if (layer.acquireFenceFd >= 0) {
-            close(layer.acquireFenceFd);
-            layer.acquireFenceFd = -1;
-        }
-
-        if (layer.flags & HWC_SKIP_RENDERING) {
-            layer.releaseFenceFd = layer.acquireFenceFd;
-        }
+        /* closed with the set */
+        layer.acquireFenceFd = -1;
 
         if (!(layer.flags & HWC_SKIP_RENDERING) &&
                 (layer.releaseFenceFd <= -1) &&
                 ((layer.compositionType == HWC_OVERLAY) ||
                 (mFbNeeded == true && layer.compositionType == HWC_FRAMEBUFFER_TARGET))) {
 
-            if (fence >= 0) {
-                int dup_fd = dup(fence);
-                if (dup_fd < 0)
-                    DISPLAY_LOGE("release fence dup failed: %s", strerror(errno));
-
-                layer.releaseFenceFd = dup_fd;
-            } else {
-                layer.releaseFenceFd = -1;
-            }
+            layer.releaseFenceFd = fences.dup(fence);
+            if (fence >= 0 && layer.releaseFenceFd < 0)
+                DISPLAY_LOGE("release fence dup failed: %s", strerror(errno));
         }
 
-        if (layer.handle) {
-            private_handle_t *h = private_handle_t::dynamicCast(layer.handle);
-            DISPLAY_LOGD("CLEAN: layer %d type=%d, f=%x, w=%d, h=%d, s=%d, vs=%d, "
-                  "{%.1f, %.1f, %.1f, %.1f}, {%d, %d, %d, %d}"
-                  "fl=%08x, hdl=%p, trf=%02x, bl=%04x, Af=%d, Rf=%d, P=%d",
-                    i, layer.compositionType, h->format, h->width, h->height, h->stride,
-                    h->vstride, layer.sourceCropf.left, layer.sourceCropf.top,
-                    layer.sourceCropf.right, layer.sourceCropf.bottom,
-                    layer.displayFrame.left, layer.displayFrame.top,
-                    layer.displayFrame.right, layer.displayFrame.bottom,
-                    layer.flags, layer.handle, layer.transform, layer.blending,
-                    layer.acquireFenceFd, layer.releaseFenceFd, getDrmMode(layer.flags));
-        }
-    }
-
-    if (contents->outbufAcquireFenceFd >= 0) {
-        close(contents->outbufAcquireFenceFd);
-        contents->outbufAcquireFenceFd = -1;
+        if (layer.handle)
+            HWC_TRACE(HWC_TRACE_FENCES, hwcTraceLayer(mTrace, HWC_TRACE_FENCES, i, layer));
     }
 
-    contents->retireFenceFd = fence;
+    contents->outbufAcquireFenceFd = -1;
+    contents->retireFenceFd = fences.release(fence);
     return true;
 }
 
+void ExynosVirtualDisplayModule::dump(android::String8& result)
+{
+    const ExynosCompositionCache::Stats &cache = mOverlayCache.stats();
+
+    ExynosVirtualDisplay::dump(result);
+    result.appendFormat("  DRM overlay check: %u frames, %u from the cache, %u evicted, %u uncacheable\n",
+            cache.lookups, cache.hits, cache.evictions, cache.uncacheable);
+    mTrace.dump(result);
+}
+
 void ExynosVirtualDisplayModule::deInit()
 {
 }
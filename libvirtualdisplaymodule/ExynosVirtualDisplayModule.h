@@ -2,20 +2,33 @@
 #define EXYNOS_VIRTUAL_DISPLAY_MODULE_H
 
 #include "ExynosVirtualDisplay.h"
+#include "ExynosWfdBlendPlanner.h"
+#include "ExynosHWCTrace.h"
+#include "ExynosFenceSet.h"
+#include "ExynosCompositionCache.h"
 
 class ExynosVirtualDisplayModule : public ExynosVirtualDisplay {
 	public:
 		ExynosVirtualDisplayModule(struct exynos5_hwc_composer_device_1_t *pdev);
 		~ExynosVirtualDisplayModule();
 
-		int postFrame(hwc_display_contents_1_t *contents);
+		int postFrame(hwc_display_contents_1_t *contents, ExynosFenceSet &fences);
 		int postToMPP(hwc_layer_1_t & layer, hwc_layer_1_t *layerB,
-						int index, hwc_display_contents_1_t *contents);
+						int index, hwc_display_contents_1_t *contents,
+						ExynosFenceSet &fences);
 		void processGles(hwc_display_contents_1_t *contents);
 		void processHwc(hwc_display_contents_1_t *contents);
 		void processMixed(hwc_display_contents_1_t *contents);
+		void skipFrame(hwc_display_contents_1_t *contents);
 		bool is2StepBlendingRequired(hwc_layer_1_t & layer, buffer_handle_t & outbuf);
-		bool manageFences(hwc_display_contents_1_t *contents, int fence);
+		void ownFences(hwc_display_contents_1_t *contents, ExynosFenceSet &fences);
+		bool manageFences(hwc_display_contents_1_t *contents,
+						ExynosFenceSet &fences, int fence);
+		void overlayKey(hwc_display_contents_1_t *contents,
+						ExynosCompositionCache::Key &key);
+		bool isOverlaySupportedCached(hwc_layer_1_t & layer, size_t index,
+						int32_t *verdicts, int numWords, int n,
+						ExynosMPPModule **supportedExternalMPP);
 
 		virtual int clearDisplay();
 		virtual int32_t getDisplayAttributes(const uint32_t attribute);
@@ -28,6 +41,15 @@ class ExynosVirtualDisplayModule : public ExynosVirtualDisplay {
 				ExynosMPPModule **supportedInternalMPP,
 				ExynosMPPModule **supportedExternalMPP);
 		virtual void deInit();
+		virtual void dump(android::String8& result);
+
+	private:
+		/* which sink buffers still hold a letterbox fill */
+		ExynosWfdBlendPlanner mBlendPlanner;
+		/* per layer prepare/set history, decoded by dump() */
+		ExynosHWCTrace mTrace;
+		/* isOverlaySupported() verdicts of the last few DRM layer stacks */
+		ExynosCompositionCache mOverlayCache;
 };
 
 #endif
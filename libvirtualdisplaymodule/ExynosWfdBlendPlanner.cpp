@@ -0,0 +1,112 @@
+#include <string.h>
+#include "ExynosWfdBlendPlanner.h"
+
+ExynosWfdBlendPlanner::ExynosWfdBlendPlanner() :
+    mNumFills(0),
+    mClock(0),
+    mFbGeneration(0)
+{
+    memset(mFills, 0, sizeof(mFills));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+const char *ExynosWfdBlendPlanner::planName(int plan)
+{
+    switch (plan) {
+    case PLAN_SCALE:
+        return "scale";
+    case PLAN_BLEND:
+        return "blend";
+    case PLAN_BLEND_KEEP_FILL:
+        return "blend, fill kept";
+    case PLAN_FILL_AND_BLEND:
+        return "fill + blend";
+    default:
+        return "?";
+    }
+}
+
+int ExynosWfdBlendPlanner::find(const void *outbuf) const
+{
+    for (size_t i = 0; i < mNumFills; i++) {
+        if (mFills[i].outbuf == outbuf)
+            return i;
+    }
+    return -1;
+}
+
+int ExynosWfdBlendPlanner::plan(const Frame &frame)
+{
+    int plan;
+
+    mClock++;
+    mStats.frames++;
+
+    if (frame.fbTarget != NULL && frame.fbRendered)
+        mFbGeneration++;
+
+    if (frame.fbTarget == NULL) {
+        plan = PLAN_SCALE;
+    } else if (frame.videoCovers) {
+        plan = PLAN_BLEND;
+    } else {
+        int i = find(frame.outbuf);
+
+        plan = PLAN_FILL_AND_BLEND;
+        if (i >= 0) {
+            const Fill &fill = mFills[i];
+
+            if (fill.outWidth == frame.outWidth && fill.outHeight == frame.outHeight &&
+                    fill.fbTarget == frame.fbTarget && fill.fbCrop == frame.fbCrop &&
+                    fill.videoFrame == frame.videoFrame &&
+                    fill.fbGeneration == mFbGeneration) {
+                plan = PLAN_BLEND_KEEP_FILL;
+                mFills[i].lastUse = mClock;
+                mStats.fillsKept++;
+            }
+        }
+    }
+
+    mStats.jobs += (plan == PLAN_FILL_AND_BLEND) ? 2 : 1;
+    return plan;
+}
+
+void ExynosWfdBlendPlanner::filled(const Frame &frame)
+{
+    int i = find(frame.outbuf);
+
+    if (i < 0) {
+        if (mNumFills < WFD_BLEND_MAX_OUTBUFS) {
+            i = mNumFills++;
+        } else {
+            /* More sink buffers than expected, forget the oldest */
+            i = 0;
+            for (size_t j = 1; j < mNumFills; j++) {
+                if (mFills[j].lastUse < mFills[i].lastUse)
+                    i = j;
+            }
+        }
+    }
+
+    Fill &fill = mFills[i];
+    fill.outbuf = frame.outbuf;
+    fill.outWidth = frame.outWidth;
+    fill.outHeight = frame.outHeight;
+    fill.fbTarget = frame.fbTarget;
+    fill.fbCrop = frame.fbCrop;
+    fill.videoFrame = frame.videoFrame;
+    fill.fbGeneration = mFbGeneration;
+    fill.lastUse = mClock;
+}
+
+void ExynosWfdBlendPlanner::invalidate(const void *outbuf)
+{
+    if (outbuf == NULL) {
+        mNumFills = 0;
+        return;
+    }
+
+    int i = find(outbuf);
+    if (i >= 0)
+        mFills[i] = mFills[--mNumFills];
+}
@@ -0,0 +1,106 @@
+#ifndef EXYNOS_WFD_BLEND_PLANNER_H
+#define EXYNOS_WFD_BLEND_PLANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Chooses the MSC jobs that put the video layer and the FB target into a
+ * WFD sink buffer.
+ *
+ * The MSC blends the video over the FB target only inside the rectangle
+ * it writes. When the video covers the whole sink buffer that is one job.
+ * When it is letterboxed, the rest of the buffer has to hold the scaled
+ * FB target as well, which takes a first job scaling the FB target into
+ * the whole buffer. That fill is what this caches: the sink buffers come
+ * back from the encoder untouched, so a buffer already filled from the
+ * same FB target with the video at the same place only needs the blend.
+ * The handle alone does not say that: SurfaceFlinger reuses its few FB
+ * target buffers and GLES redraws one on every frame with FB layers. So
+ * each fill records the FB target generation, which goes up on every frame
+ * GLES composed, and is only kept while nothing was composed since.
+ *
+ * Anything else writing a sink buffer, GLES in particular, must call
+ * invalidate() for it, and a GLES composition not passed to plan() must
+ * call fbTargetRendered(). No libhwc dependency, so the host benchmark drives
+ * it with WFD layer traces.
+ */
+
+#define WFD_BLEND_MAX_OUTBUFS   8
+
+class ExynosWfdBlendPlanner {
+    public:
+        enum {
+            PLAN_SCALE,             /* no FB target, scale the video only */
+            PLAN_BLEND,             /* video covers the buffer: one job */
+            PLAN_BLEND_KEEP_FILL,   /* letterboxed, fill still there: one job */
+            PLAN_FILL_AND_BLEND,    /* letterboxed: fill, then blend */
+        };
+
+        struct Rect {
+            int left;
+            int top;
+            int right;
+            int bottom;
+
+            bool operator==(const Rect &other) const {
+                return left == other.left && top == other.top &&
+                        right == other.right && bottom == other.bottom;
+            }
+        };
+
+        struct Frame {
+            const void *outbuf;
+            uint32_t outWidth;
+            uint32_t outHeight;
+            const void *fbTarget;   /* NULL without one */
+            Rect fbCrop;
+            Rect videoFrame;
+            bool videoCovers;       /* the video job writes the whole outbuf */
+            bool fbRendered;        /* GLES composed into fbTarget for this frame */
+        };
+
+        struct Stats {
+            uint32_t frames;
+            uint32_t jobs;
+            uint32_t fillsKept;
+        };
+
+        ExynosWfdBlendPlanner();
+
+        int plan(const Frame &frame);
+
+        /* The fill job of frame was queued */
+        void filled(const Frame &frame);
+
+        /* outbuf was written some other way; NULL for all of them */
+        void invalidate(const void *outbuf);
+
+        /* GLES composed a frame plan() does not see */
+        void fbTargetRendered() { mFbGeneration++; }
+
+        const Stats &stats() const { return mStats; }
+        static const char *planName(int plan);
+
+    private:
+        struct Fill {
+            const void *outbuf;
+            uint32_t outWidth;
+            uint32_t outHeight;
+            const void *fbTarget;
+            Rect fbCrop;
+            Rect videoFrame;
+            uint64_t fbGeneration;
+            uint64_t lastUse;
+        };
+
+        Fill mFills[WFD_BLEND_MAX_OUTBUFS];
+        size_t mNumFills;
+        uint64_t mClock;
+        uint64_t mFbGeneration;
+        Stats mStats;
+
+        int find(const void *outbuf) const;
+};
+
+#endif
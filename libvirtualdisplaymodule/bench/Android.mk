@@ -0,0 +1,34 @@
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Host benchmarks of the virtual display code that does not depend on the
+# rest of libhwc, see libdisplaymodule/bench/Android.mk.
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+# see benchWfdBlend.cpp for the trace format
+LOCAL_MODULE := hwc_wfd_blend_benchmark
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+	benchWfdBlend.cpp \
+	../ExynosWfdBlendPlanner.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
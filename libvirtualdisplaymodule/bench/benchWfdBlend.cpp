@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * MSC traffic and time of WFD frames, with every letterboxed frame done in
+ * two jobs as before and with ExynosWfdBlendPlanner.
+ *
+ * A trace has one line per frame:
+ *   <outbuf> <outW> <outH> <fb> <fbW> <fbH> <left> <top> <right> <bottom> <srcW> <srcH> <gles>
+ * outbuf and fb name the sink buffer and the FB target buffer (0 for no FB
+ * target, -1 for a frame composed by GLES), the rectangle is where the
+ * video goes and srcW x srcH its crop. gles is 1 when GLES drew FB layers
+ * into fb for the frame; traces without it count every FB target as
+ * drawn. Lines starting with # are comments. Without -f it runs built-in
+ * sessions in that form, written with -w.
+ *
+ * The model: the FB target and the sink buffers are 32bpp, the video NV12.
+ * A fill job reads the FB target and writes the whole sink buffer; a blend
+ * job reads the video and the FB target under it and writes the video
+ * rectangle. A job takes 300us plus its larger side in pixels at
+ * 533Mpix/s. The benchmark also keeps what every sink buffer holds, down
+ * to which drawing of which FB target, and fails if the planner ever skips
+ * a fill the buffer does not have.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#include "ExynosWfdBlendPlanner.h"
+
+#define JOB_OVERHEAD_US     300.0
+#define MSC_MPIX_PER_SEC    533.0
+
+struct TraceFrame {
+    int outbuf;
+    uint32_t outW, outH;
+    int fb;
+    uint32_t fbW, fbH;
+    ExynosWfdBlendPlanner::Rect video;
+    uint32_t srcW, srcH;
+    int gles;
+};
+
+struct Cost {
+    uint64_t frames;
+    uint64_t jobs;
+    double bytes;
+    double us;
+    double maxUs;
+
+    Cost() : frames(0), jobs(0), bytes(0), us(0), maxUs(0) {}
+};
+
+static int gErrors;
+
+static double area(const ExynosWfdBlendPlanner::Rect &r)
+{
+    return (double)(r.right - r.left) * (r.bottom - r.top);
+}
+
+static double jobUs(double srcPixels, double dstPixels)
+{
+    return JOB_OVERHEAD_US + (srcPixels > dstPixels ? srcPixels : dstPixels) / MSC_MPIX_PER_SEC;
+}
+
+/* Adds the jobs of one frame composed with plan */
+static void account(Cost &cost, const TraceFrame &f, int plan)
+{
+    double out = (double)f.outW * f.outH;
+    double rect = area(f.video);
+    double src = (double)f.srcW * f.srcH;
+    double fb = (double)f.fbW * f.fbH;
+    double bytes = 0, us = 0;
+
+    if (plan == ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND) {
+        bytes += fb * 4 + out * 4;
+        us += jobUs(fb, out);
+        cost.jobs++;
+    }
+
+    bytes += src * 3 / 2 + rect * 4;
+    if (plan != ExynosWfdBlendPlanner::PLAN_SCALE)
+        bytes += fb * rect / out * 4;
+    us += jobUs(src, rect);
+    cost.jobs++;
+
+    cost.frames++;
+    cost.bytes += bytes;
+    cost.us += us;
+    if (us > cost.maxUs)
+        cost.maxUs = us;
+}
+
+/* What the old postToMPP() did */
+static int legacyPlan(const TraceFrame &f)
+{
+    if (f.fb == 0)
+        return ExynosWfdBlendPlanner::PLAN_SCALE;
+    if ((uint32_t)(f.video.right - f.video.left) == f.outW &&
+            (uint32_t)(f.video.bottom - f.video.top) == f.outH)
+        return ExynosWfdBlendPlanner::PLAN_BLEND;
+    return ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND;
+}
+
+/* Handles for the planner, which only compares them */
+static const void *handle(int id)
+{
+    return (const void *)(intptr_t)(0x1000 + id * 16);
+}
+
+struct Content {
+    int fb;
+    int drawn;          /* how many times GLES had drawn fb */
+    ExynosWfdBlendPlanner::Rect video;
+    uint32_t outW, outH;
+};
+
+static void replay(const char *name, const std::vector<TraceFrame> &trace)
+{
+    ExynosWfdBlendPlanner planner;
+    std::map<int, Content> outbufs;     /* the fill each sink buffer holds, fb -1 if none */
+    std::map<int, int> drawn;           /* times GLES drew each FB target */
+    Cost before, after;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const TraceFrame &f = trace[i];
+
+        if (outbufs.find(f.outbuf) == outbufs.end())
+            outbufs[f.outbuf].fb = -1;
+        Content &content = outbufs[f.outbuf];
+
+        if (f.fb < 0) {
+            planner.invalidate(handle(f.outbuf));
+            planner.fbTargetRendered();
+            content.fb = -1;
+            continue;
+        }
+        if (f.fb > 0 && f.gles)
+            drawn[f.fb]++;
+
+        ExynosWfdBlendPlanner::Frame frame;
+        frame.outbuf = handle(f.outbuf);
+        frame.outWidth = f.outW;
+        frame.outHeight = f.outH;
+        frame.fbTarget = f.fb ? handle(f.fb) : NULL;
+        frame.fbCrop.left = frame.fbCrop.top = 0;
+        frame.fbCrop.right = f.fbW;
+        frame.fbCrop.bottom = f.fbH;
+        frame.videoFrame = f.video;
+        frame.videoCovers = legacyPlan(f) != ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND;
+        frame.fbRendered = f.gles != 0;
+
+        int plan = planner.plan(frame);
+
+        if (plan == ExynosWfdBlendPlanner::PLAN_BLEND_KEEP_FILL &&
+                !(content.fb == f.fb && content.drawn == drawn[f.fb] && content.video == f.video &&
+                  content.outW == f.outW && content.outH == f.outH)) {
+            if (gErrors++ < 5)
+                fprintf(stderr, "%s: frame %zu kept a fill sink buffer %d does not hold\n",
+                        name, i, f.outbuf);
+        }
+        if (plan == ExynosWfdBlendPlanner::PLAN_FILL_AND_BLEND) {
+            planner.filled(frame);
+            content.fb = f.fb;
+            content.drawn = drawn[f.fb];
+            content.video = f.video;
+            content.outW = f.outW;
+            content.outH = f.outH;
+        }
+
+        account(before, f, legacyPlan(f));
+        account(after, f, plan);
+    }
+
+    printf("%-28s %5llu frames  2-step: %5.2f jobs %6.1f MB %5.2f ms (max %5.2f)  "
+            "planned: %5.2f jobs %6.1f MB %5.2f ms (max %5.2f)  -%.0f%% bytes\n",
+            name, (unsigned long long)after.frames,
+            before.frames ? (double)before.jobs / before.frames : 0,
+            before.frames ? before.bytes / before.frames / 1e6 : 0,
+            before.frames ? before.us / before.frames / 1000 : 0, before.maxUs / 1000,
+            after.frames ? (double)after.jobs / after.frames : 0,
+            after.frames ? after.bytes / after.frames / 1e6 : 0,
+            after.frames ? after.us / after.frames / 1000 : 0, after.maxUs / 1000,
+            before.bytes ? 100.0 * (before.bytes - after.bytes) / before.bytes : 0);
+}
+
+/* Built-in sessions, 30s at 60fps, three sink buffers in turn */
+static void frameAt(std::vector<TraceFrame> &trace, int n, uint32_t outW, uint32_t outH, int fb,
+        bool gles, int left, int top, int right, int bottom, uint32_t srcW, uint32_t srcH)
+{
+    TraceFrame f;
+
+    f.outbuf = 1 + n % 3;
+    f.outW = outW;
+    f.outH = outH;
+    f.fb = fb;
+    f.fbW = outW;
+    f.fbH = outH;
+    f.video.left = left;
+    f.video.top = top;
+    f.video.right = right;
+    f.video.bottom = bottom;
+    f.srcW = srcW;
+    f.srcH = srcH;
+    f.gles = gles;
+    trace.push_back(f);
+}
+
+static std::vector<TraceFrame> session(int which)
+{
+    std::vector<TraceFrame> trace;
+    int fb = 10;        /* FB target buffers 10..12, GLES draws the next one each frame */
+    int top = 100;
+
+    for (int n = 0; n < 1800; n++) {
+        bool gles;      /* FB layers on screen */
+
+        switch (which) {
+        case 0:
+            /* 2.39:1 movie, the controls show for 3s every 20s */
+            gles = n % 1200 < 180;
+            break;
+        case 1:
+            /* 4:3 video, a subtitle shows for 1s every 2s */
+            gles = n % 120 < 60;
+            break;
+        case 2:
+            /* 16:9 video on a 16:9 sink, controls for 1s every 10s */
+            gles = n % 600 < 60;
+            break;
+        case 3:
+            /* inline video in a page, which scrolls for 2s out of 5 */
+            gles = true;
+            break;
+        default:
+            gles = false;
+            break;
+        }
+        if (gles)
+            fb = 10 + (fb - 9) % 3;
+
+        switch (which) {
+        case 0:
+            frameAt(trace, n, 1920, 1080, fb, gles, 0, 138, 1920, 942, 1920, 804);
+            break;
+        case 1:
+            /* and a notification falls back to GLES for 1s */
+            if (n >= 900 && n < 960)
+                frameAt(trace, n, 1280, 720, -1, true, 0, 0, 0, 0, 0, 0);
+            else
+                frameAt(trace, n, 1280, 720, fb, gles, 160, 0, 1120, 720, 640, 480);
+            break;
+        case 2:
+            frameAt(trace, n, 1280, 720, fb, gles, 0, 0, 1280, 720, 1920, 1080);
+            break;
+        case 3:
+            if (n % 300 < 120)
+                top = 100 + (n % 300) * 2;
+            frameAt(trace, n, 1280, 720, fb, gles, 320, top % 360, 960, top % 360 + 360, 640, 360);
+            break;
+        default:
+            /* no UI over the video, scaling only */
+            frameAt(trace, n, 1280, 720, 0, false, 0, 90, 1280, 630, 1920, 810);
+            break;
+        }
+    }
+    return trace;
+}
+
+static const char *sessionNames[] = {
+    "2.39:1 movie, controls",
+    "4:3 video, subtitles, GLES",
+    "16:9 video",
+    "scrolling inline video",
+    "video without FB target",
+};
+
+static bool load(const char *path, std::vector<TraceFrame> &trace)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256];
+
+    if (fp == NULL) {
+        perror(path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        TraceFrame f;
+        int n;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        f.gles = 1;
+        n = sscanf(line, "%d %u %u %d %u %u %d %d %d %d %u %u %d", &f.outbuf, &f.outW, &f.outH,
+                &f.fb, &f.fbW, &f.fbH, &f.video.left, &f.video.top, &f.video.right,
+                &f.video.bottom, &f.srcW, &f.srcH, &f.gles);
+        if (n != 12 && n != 13) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            fclose(fp);
+            return false;
+        }
+        trace.push_back(f);
+    }
+    fclose(fp);
+    return true;
+}
+
+static void save(FILE *fp, const char *name, const std::vector<TraceFrame> &trace)
+{
+    fprintf(fp, "# %s\n", name);
+    for (size_t i = 0; i < trace.size(); i++) {
+        const TraceFrame &f = trace[i];
+        fprintf(fp, "%d %u %u %d %u %u %d %d %d %d %u %u %d\n", f.outbuf, f.outW, f.outH,
+                f.fb, f.fbW, f.fbH, f.video.left, f.video.top, f.video.right,
+                f.video.bottom, f.srcW, f.srcH, f.gles);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-f trace] [-w trace]\n"
+            "  -f  replay a recorded trace instead of the built-in sessions\n"
+            "  -w  write the built-in sessions as a trace\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in = NULL, *out = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:w:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            in = optarg;
+            break;
+        case 'w':
+            out = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (in) {
+        std::vector<TraceFrame> trace;
+
+        if (!load(in, trace))
+            return 1;
+        replay(in, trace);
+    } else {
+        FILE *fp = NULL;
+
+        if (out && (fp = fopen(out, "w")) == NULL) {
+            perror(out);
+            return 1;
+        }
+        for (size_t s = 0; s < sizeof(sessionNames) / sizeof(sessionNames[0]); s++) {
+            std::vector<TraceFrame> trace = session(s);
+
+            replay(sessionNames[s], trace);
+            if (fp)
+                save(fp, sessionNames[s], trace);
+        }
+        if (fp)
+            fclose(fp);
+    }
+
+    if (gErrors)
+        printf("%d errors\n", gErrors);
+    return gErrors ? 1 : 0;
+}
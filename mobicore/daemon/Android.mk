@@ -27,6 +27,7 @@ LOCAL_SRC_FILES += \
 	ClientLib/Session.cpp \
 	Common/CMutex.cpp \
 	Common/Connection.cpp \
+	Common/McTrace.cpp \
 	ClientLib/GP/tee_client_api.cpp
 
 LOCAL_C_INCLUDES +=\
@@ -46,6 +47,69 @@ include $(LOCAL_PATH)/Kernel/Android.mk
 
 include $(BUILD_SHARED_LIBRARY)
 
+# Host mock of the Client Library, for running TLCs without a TEE
+# =============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := libMcClientMock
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_C_INCLUDES += $(GLOBAL_INCLUDES)
+LOCAL_SHARED_LIBRARIES += liblog
+
+LOCAL_CFLAGS := -fvisibility=hidden -fvisibility-inlines-hidden
+LOCAL_CFLAGS += -DLOG_TAG=\"McClientMock\"
+
+LOCAL_SRC_FILES += \
+	ClientLib/Mock/McClientMock.cpp
+
+LOCAL_C_INCLUDES +=\
+	$(LOCAL_PATH)/ClientLib/public \
+	$(LOCAL_PATH)/ClientLib/Mock \
+	$(LOCAL_PATH)/../common/LogWrapper
+
+LOCAL_EXPORT_C_INCLUDE_DIRS +=\
+	$(COMP_PATH_MobiCore)/inc \
+	$(LOCAL_PATH)/ClientLib/public \
+	$(LOCAL_PATH)/ClientLib/Mock
+
+LOCAL_LDLIBS += -lpthread
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# Offline decoder of McTrace dump files, see README.android
+# =============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := mctrace_decode
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := Common/McTraceDecode.cpp
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/Common
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := mctrace_decode
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := Common/McTraceDecode.cpp
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/Common
+include $(BUILD_HOST_EXECUTABLE)
+
+# Per-call cost of a trace point on and off, see Common/benchMcTrace.cpp
+# =============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := mctrace_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_CFLAGS := -DLOG_TAG=\"McTrace\"
+LOCAL_SRC_FILES := \
+	Common/McTrace.cpp \
+	Common/benchMcTrace.cpp
+LOCAL_C_INCLUDES +=\
+	$(LOCAL_PATH)/Common \
+	$(LOCAL_PATH)/../common/LogWrapper
+LOCAL_LDLIBS += -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
 # Daemon Application
 # =============================================================================
 include $(CLEAR_VARS)
@@ -64,6 +128,7 @@ include $(LOCAL_PATH)/Daemon/Android.mk
 # Common Source files required for building the daemon
 LOCAL_SRC_FILES += Common/CMutex.cpp \
 	Common/Connection.cpp \
+	Common/McTrace.cpp \
 	Common/NetlinkConnection.cpp \
 	Common/CSemaphore.cpp \
 	Common/CThread.cpp
@@ -1170,20 +1170,17 @@ __MC_CLIENT_LIB_API mcResult_t mcFreeWsm(
 }
 
 //------------------------------------------------------------------------------
-__MC_CLIENT_LIB_API mcResult_t mcMap(
+static mcResult_t mapBulkBuf(
     mcSessionHandle_t  *sessionHandle,
     void               *buf,
     uint32_t           bufLen,
-    mcBulkMap_t        *mapInfo
+    mcBulkMap_t        *mapInfo,
+    bool               input
 )
 {
     mcResult_t mcResult = MC_DRV_ERR_UNKNOWN;
 #ifndef WIN32
 
-    static CMutex mutex;
-
-    LOG_I("===%s()===", __FUNCTION__);
-
     devMutex.lock();
 
     do {
@@ -1205,11 +1202,12 @@ __MC_CLIENT_LIB_API mcResult_t mcMap(
         Session *session = device->resolveSessionId(sessionHandle->sessionId);
         CHECK_SESSION(session, sessionHandle->sessionId);
 
-        LOG_I(" Mapping %p to session %d.", buf, sessionHandle->sessionId);
+        LOG_I(" Mapping %p to session %d%s.", buf, sessionHandle->sessionId,
+              input ? " as input" : "");
 
         // Register mapped bulk buffer to Kernel Module and keep mapped bulk buffer in mind
         BulkBufferDescriptor *bulkBuf;
-        mcResult = session->addBulkBuf(buf, bufLen, &bulkBuf);
+        mcResult = session->addBulkBuf(buf, bufLen, &bulkBuf, input);
         if (mcResult != MC_DRV_OK) {
             LOG_E("Registering buffer failed. ret=%x", mcResult);
             break;
@@ -1263,6 +1261,32 @@ __MC_CLIENT_LIB_API mcResult_t mcMap(
     return mcResult;
 }
 
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMap(
+    mcSessionHandle_t  *sessionHandle,
+    void               *buf,
+    uint32_t           bufLen,
+    mcBulkMap_t        *mapInfo
+)
+{
+    LOG_I("===%s()===", __FUNCTION__);
+
+    return mapBulkBuf(sessionHandle, buf, bufLen, mapInfo, false);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMapInput(
+    mcSessionHandle_t  *sessionHandle,
+    const void         *buf,
+    uint32_t           bufLen,
+    mcBulkMap_t        *mapInfo
+)
+{
+    LOG_I("===%s()===", __FUNCTION__);
+
+    return mapBulkBuf(sessionHandle, (void *)buf, bufLen, mapInfo, true);
+}
+
 //------------------------------------------------------------------------------
 __MC_CLIENT_LIB_API mcResult_t mcUnmap(
     mcSessionHandle_t  *sessionHandle,
@@ -32,6 +32,7 @@
 #define LOG_TAG "GpClient"
 #include "tee_client_api.h"
 #include "log.h"
+#include "McTrace.h"
 #include "MobiCoreDriverApi.h"
 #include "Mci/mcinq.h"
 #include <sys/mman.h>
@@ -131,15 +132,15 @@ static TEEC_Result _TEEC_SetupOperation(
             imp = &tci->operation.params[i];
             ext = &operation->params[i];
 
+            MC_TRACE(MC_TRC_GP_PARAM, i, _TEEC_GET_PARAM_TYPE(operation->paramTypes, i));
+
             switch (_TEEC_GET_PARAM_TYPE(operation->paramTypes, i)) {
             case TEEC_VALUE_OUTPUT:
                 break;
             case TEEC_NONE:
-                LOG_I("  cycle %d, TEEC_NONE", i);
                 break;
             case TEEC_VALUE_INPUT:
             case TEEC_VALUE_INOUT: {
-                LOG_I("  cycle %d, TEEC_VALUE_IN*", i);
                 imp->value.a = ext->value.a;
                 imp->value.b = ext->value.b;
                 break;
@@ -149,7 +150,6 @@ static TEEC_Result _TEEC_SetupOperation(
             case TEEC_MEMREF_TEMP_INOUT: {
                 //TODO: A Temporary Memory Reference may be null, which can be used to denote a special case for the
                 //parameter. Output Memory References that are null are typically used to request the required output size.
-                LOG_I("  cycle %d, TEEC_TEMP_IN*", i);
                 imp->memref.mapInfo.sVirtualLen = 0;
                 if ((ext->tmpref.size) && (ext->tmpref.buffer)) {
                     mcRet = mcMap(handle, ext->tmpref.buffer, ext->tmpref.size, &imp->memref.mapInfo);
@@ -158,13 +158,10 @@ static TEEC_Result _TEEC_SetupOperation(
                         *returnOrigin = TEEC_ORIGIN_COMMS;
                         i = _TEEC_PARAMETER_NUMBER;
                     }
-                } else {
-                    LOG_I("  cycle %d, TEEC_TEMP_IN*  - zero pointer or size", i);
                 }
                 break;
             }
             case TEEC_MEMREF_WHOLE: {
-                LOG_I("  cycle %d, TEEC_MEMREF_WHOLE", i);
                 imp->memref.mapInfo.sVirtualLen = 0;
                 if (ext->memref.parent->size) {
                     mcRet = mcMap(handle, ext->memref.parent->buffer, ext->memref.parent->size, &imp->memref.mapInfo);
@@ -179,7 +176,6 @@ static TEEC_Result _TEEC_SetupOperation(
             case TEEC_MEMREF_PARTIAL_INPUT:
             case TEEC_MEMREF_PARTIAL_OUTPUT:
             case TEEC_MEMREF_PARTIAL_INOUT: {
-                LOG_I("  cycle %d, TEEC_PARTIAL_IN*", i);
                 //Check data flow consistency
                 if ((((ext->memref.parent->flags & (TEEC_MEM_INPUT | TEEC_MEM_OUTPUT)) == TEEC_MEM_INPUT) &&
                         (_TEEC_GET_PARAM_TYPE(operation->paramTypes, i) == TEEC_MEMREF_PARTIAL_OUTPUT)) ||
@@ -0,0 +1,750 @@
+/** @addtogroup MCD_IMPL_LIB
+ * @{
+ * @file
+ *
+ * Host-side mock of the <t-base Driver API, see McClientMock.h.
+ *
+ * There is a single device, MC_DEVICE_ID_DEFAULT. All state sits behind one
+ * mutex, which is never held while a TA callback runs, so that callbacks can
+ * use mcMockResolve() and sessions can be served in parallel.
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <list>
+
+#include "McClientMock.h"
+#include "mcVersionInfo.h"
+#include "mcLoadFormat.h"
+
+#include "log.h"
+
+using namespace std;
+
+/** Each bulk mapping slot of a session owns a window of secure addresses */
+#define MOCK_MAP_WINDOW_BASE    0x10000000U
+#define MOCK_MAP_WINDOW_SIZE    0x10000000U
+#define MOCK_PAGE_SIZE          4096U
+
+struct MockTa {
+    mcUuid_t    uuid;
+    mcMockTa_t  ta;
+};
+
+struct MockMap {
+    uint8_t     *buf;   /**< NULL if the slot is free */
+    uint32_t    len;
+    uint32_t    sva;
+    bool        input;  /**< mapped with mcMapInput() */
+};
+
+struct MockSession {
+    uint32_t    id;
+    mcMockTa_t  ta;
+    uint8_t     *tci;
+    uint32_t    tciLen;
+    bool        pending;    /**< notified, not yet waited for */
+    uint64_t    notifiedUs; /**< when it was notified, the TA runs from then on */
+    bool        exited;     /**< TA returned an error */
+    int32_t     lastErr;
+    MockMap     maps[MC_MOCK_MAX_MAPS];
+};
+
+struct MockWsm {
+    uint8_t     *buf;
+    uint32_t    len;
+};
+
+static pthread_mutex_t mockMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool deviceOpen = false;
+static uint32_t nextSessionId = 1;
+static list<MockTa> tas;
+static list<MockSession *> sessions;
+static list<MockWsm> wsms;
+static mcMockStats_t stats;
+static bool inputMaps = true;
+
+static uint64_t nowUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Look up a session, with mockMutex held */
+static MockSession *findSession(uint32_t sessionId)
+{
+    for (list<MockSession *>::iterator it = sessions.begin(); it != sessions.end(); ++it) {
+        if ((*it)->id == sessionId) {
+            return *it;
+        }
+    }
+    return NULL;
+}
+
+/** Length of the WSM block starting at buf, or 0, with mockMutex held */
+static uint32_t findWsm(const uint8_t *buf)
+{
+    for (list<MockWsm>::iterator it = wsms.begin(); it != wsms.end(); ++it) {
+        if (it->buf == buf) {
+            return it->len;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMockRegisterTa(
+    const mcUuid_t      *uuid,
+    const mcMockTa_t    *ta
+)
+{
+    if ((uuid == NULL) || (ta == NULL) || (ta->onNotify == NULL)) {
+        return MC_DRV_ERR_INVALID_PARAMETER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    for (list<MockTa>::iterator it = tas.begin(); it != tas.end(); ++it) {
+        if (memcmp(&it->uuid, uuid, sizeof(*uuid)) == 0) {
+            tas.erase(it);
+            break;
+        }
+    }
+    MockTa entry;
+    entry.uuid = *uuid;
+    entry.ta = *ta;
+    tas.push_back(entry);
+    pthread_mutex_unlock(&mockMutex);
+
+    return MC_DRV_OK;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API void mcMockUnregisterAll(void)
+{
+    pthread_mutex_lock(&mockMutex);
+    if (!sessions.empty()) {
+        LOG_W("%s: %zu sessions still open", __FUNCTION__, sessions.size());
+    }
+    tas.clear();
+    pthread_mutex_unlock(&mockMutex);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API void *mcMockResolve(
+    uint32_t            sessionId,
+    uint32_t            sVirtualAddr,
+    uint32_t            len
+)
+{
+    void *ptr = NULL;
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *session = findSession(sessionId);
+    for (int i = 0; (session != NULL) && (i < MC_MOCK_MAX_MAPS); i++) {
+        MockMap *map = &session->maps[i];
+        if ((map->buf != NULL) &&
+            (sVirtualAddr >= map->sva) &&
+            (sVirtualAddr - map->sva <= map->len) &&
+            (len <= map->len - (sVirtualAddr - map->sva)))
+        {
+            ptr = map->buf + (sVirtualAddr - map->sva);
+            stats.bytesCopied += len;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return ptr;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API void mcMockGetStats(
+    mcMockStats_t       *out
+)
+{
+    pthread_mutex_lock(&mockMutex);
+    *out = stats;
+    pthread_mutex_unlock(&mockMutex);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API void mcMockResetStats(void)
+{
+    pthread_mutex_lock(&mockMutex);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&mockMutex);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API void mcMockSetInputMaps(bool enable)
+{
+    pthread_mutex_lock(&mockMutex);
+    inputMaps = enable;
+    pthread_mutex_unlock(&mockMutex);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcOpenDevice(uint32_t deviceId)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+
+    pthread_mutex_lock(&mockMutex);
+    if (deviceId != MC_DEVICE_ID_DEFAULT) {
+        mcResult = MC_DRV_ERR_UNKNOWN_DEVICE;
+    } else if (deviceOpen) {
+        mcResult = MC_DRV_ERR_DEVICE_ALREADY_OPEN;
+    } else {
+        deviceOpen = true;
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcCloseDevice(
+    uint32_t deviceId
+)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+
+    pthread_mutex_lock(&mockMutex);
+    if ((deviceId != MC_DEVICE_ID_DEFAULT) || !deviceOpen) {
+        mcResult = MC_DRV_ERR_DAEMON_DEVICE_NOT_OPEN;
+    } else if (!sessions.empty()) {
+        mcResult = MC_DRV_ERR_SESSION_PENDING;
+    } else {
+        /* Like the real driver, closing the device releases its WSM */
+        for (list<MockWsm>::iterator it = wsms.begin(); it != wsms.end(); ++it) {
+            free(it->buf);
+        }
+        wsms.clear();
+        deviceOpen = false;
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+static mcResult_t openSession(
+    mcSessionHandle_t  *session,
+    const mcUuid_t     *uuid,
+    uint8_t            *tci,
+    uint32_t           tciLen,
+    bool               tciInWsm
+)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+    MockSession *s = NULL;
+
+    if ((session == NULL) || (uuid == NULL) || (tci == NULL)) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+    if (tciLen > MC_MAX_TCI_LEN) {
+        return MC_DRV_ERR_TCI_TOO_BIG;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    do {
+        if (!deviceOpen || (session->deviceId != MC_DEVICE_ID_DEFAULT)) {
+            mcResult = MC_DRV_ERR_UNKNOWN_DEVICE;
+            break;
+        }
+        uint32_t wsmLen = findWsm(tci);
+        if (tciInWsm && (wsmLen == 0)) {
+            mcResult = MC_DRV_ERR_WSM_NOT_FOUND;
+            break;
+        }
+        if ((wsmLen != 0) && (tciLen > wsmLen)) {
+            mcResult = MC_DRV_ERR_TCI_GREATER_THAN_WSM;
+            break;
+        }
+        const MockTa *ta = NULL;
+        for (list<MockTa>::iterator it = tas.begin(); it != tas.end(); ++it) {
+            if (memcmp(&it->uuid, uuid, sizeof(*uuid)) == 0) {
+                ta = &*it;
+                break;
+            }
+        }
+        if (ta == NULL) {
+            mcResult = MC_DRV_ERR_TRUSTLET_NOT_FOUND;
+            break;
+        }
+
+        s = new MockSession;
+        memset(s, 0, sizeof(*s));
+        s->id = nextSessionId++;
+        s->ta = ta->ta;
+        s->tci = tci;
+        s->tciLen = tciLen;
+        sessions.push_back(s);
+        stats.sessionsOpened++;
+    } while (false);
+    pthread_mutex_unlock(&mockMutex);
+
+    if (mcResult != MC_DRV_OK) {
+        return mcResult;
+    }
+
+    if (s->ta.onOpen != NULL) {
+        mcResult = s->ta.onOpen(s->ta.ctx, s->id, tci, tciLen);
+        if (mcResult != MC_DRV_OK) {
+            pthread_mutex_lock(&mockMutex);
+            sessions.remove(s);
+            pthread_mutex_unlock(&mockMutex);
+            delete s;
+            return mcResult;
+        }
+    }
+    session->sessionId = s->id;
+
+    return MC_DRV_OK;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcOpenSession(
+    mcSessionHandle_t  *session,
+    const mcUuid_t     *uuid,
+    uint8_t            *tci,
+    uint32_t           tciLen
+)
+{
+    return openSession(session, uuid, tci, tciLen, true);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcOpenGPTA(
+    mcSessionHandle_t  *session,
+    const mcUuid_t     *uuid,
+    uint8_t            *tci,
+    uint32_t           len
+)
+{
+    return mcOpenSession(session, uuid, tci, len);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcOpenTrustlet(
+    mcSessionHandle_t  *session,
+    mcSpid_t           spid,
+    uint8_t            *trustedapp,
+    uint32_t           tLen,
+    uint8_t            *tci,
+    uint32_t           tciLen
+)
+{
+    (void)spid;
+
+    if (trustedapp == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+    /* Only the UUID in the MCLF header is used, to find the simulated TA */
+    const mclfHeaderV2_t *header = (const mclfHeaderV2_t *)trustedapp;
+    if ((tLen < sizeof(*header)) ||
+        (header->intro.magic != MC_SERVICE_HEADER_MAGIC_BE)) {
+        LOG_E("%s: no MCLF header in TA blob of %u bytes", __FUNCTION__, tLen);
+        return MC_DRV_ERR_INVALID_PARAMETER;
+    }
+
+    /* Like the real Client Library, the TCI may be ordinary memory */
+    return openSession(session, &header->uuid, tci, tciLen, false);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcCloseSession(
+    mcSessionHandle_t *session
+)
+{
+    MockSession *s;
+
+    if (session == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    s = findSession(session->sessionId);
+    if (s != NULL) {
+        sessions.remove(s);
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    if (s == NULL) {
+        return MC_DRV_ERR_UNKNOWN_SESSION;
+    }
+    if (s->ta.onClose != NULL) {
+        s->ta.onClose(s->ta.ctx, s->id);
+    }
+    delete s;
+
+    return MC_DRV_OK;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcNotify(
+    mcSessionHandle_t *session
+)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+
+    if (session == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *s = findSession(session->sessionId);
+    if (s == NULL) {
+        mcResult = MC_DRV_ERR_UNKNOWN_SESSION;
+    } else if (s->exited) {
+        mcResult = MC_DRV_ERR_NOTIFICATION;
+    } else {
+        s->pending = true;
+        s->notifiedUs = nowUs();
+        stats.notifications++;
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcWaitNotification(
+    mcSessionHandle_t  *session,
+    int32_t            timeout
+)
+{
+    mcMockTa_t ta;
+    uint8_t *tci;
+    uint32_t tciLen;
+    uint32_t sessionId;
+    uint64_t readyUs;
+
+    if (session == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *s = findSession(session->sessionId);
+    if (s == NULL) {
+        pthread_mutex_unlock(&mockMutex);
+        return MC_DRV_ERR_UNKNOWN_SESSION;
+    }
+    if (s->exited) {
+        pthread_mutex_unlock(&mockMutex);
+        return MC_DRV_INFO_NOTIFICATION;
+    }
+    if (!s->pending) {
+        /* Nothing will ever arrive, so do not block even without a timeout */
+        pthread_mutex_unlock(&mockMutex);
+        if (timeout != MC_NO_TIMEOUT) {
+            LOG_W("%s: waiting on session %u without a notification",
+                  __FUNCTION__, session->sessionId);
+        }
+        return MC_DRV_ERR_TIMEOUT;
+    }
+    s->pending = false;
+    ta = s->ta;
+    tci = s->tci;
+    tciLen = s->tciLen;
+    sessionId = s->id;
+    readyUs = s->notifiedUs + ta.latencyUs;
+    pthread_mutex_unlock(&mockMutex);
+
+    /* Whatever the client did since mcNotify() ran alongside the TA */
+    uint64_t now = nowUs();
+    if (readyUs > now) {
+        usleep((useconds_t)(readyUs - now));
+    }
+    mcResult_t taResult = ta.onNotify(ta.ctx, sessionId, tci, tciLen);
+    if (taResult == MC_DRV_OK) {
+        return MC_DRV_OK;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    s = findSession(sessionId);
+    if (s != NULL) {
+        s->exited = true;
+        s->lastErr = (int32_t)taResult;
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return MC_DRV_INFO_NOTIFICATION;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMallocWsm(
+    uint32_t  deviceId,
+    uint32_t  align,
+    uint32_t  len,
+    uint8_t   **wsm,
+    uint32_t  wsmFlags
+)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+    void *buf = NULL;
+
+    (void)align; /* WSM is always page aligned */
+    (void)wsmFlags;
+
+    if (wsm == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+    if (len == 0) {
+        return MC_DRV_ERR_INVALID_LENGTH;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    do {
+        if (!deviceOpen || (deviceId != MC_DEVICE_ID_DEFAULT)) {
+            mcResult = MC_DRV_ERR_UNKNOWN_DEVICE;
+            break;
+        }
+        if (posix_memalign(&buf, MOCK_PAGE_SIZE, len) != 0) {
+            mcResult = MC_DRV_ERR_NO_FREE_MEMORY;
+            break;
+        }
+        memset(buf, 0, len);
+        MockWsm entry;
+        entry.buf = (uint8_t *)buf;
+        entry.len = len;
+        wsms.push_back(entry);
+        stats.wsmAllocs++;
+        *wsm = (uint8_t *)buf;
+    } while (false);
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcFreeWsm(
+    uint32_t  deviceId,
+    uint8_t   *wsm
+)
+{
+    mcResult_t mcResult = MC_DRV_ERR_FREE_MEMORY_FAILED;
+
+    pthread_mutex_lock(&mockMutex);
+    if (!deviceOpen || (deviceId != MC_DEVICE_ID_DEFAULT)) {
+        mcResult = MC_DRV_ERR_UNKNOWN_DEVICE;
+    } else {
+        for (list<MockWsm>::iterator it = wsms.begin(); it != wsms.end(); ++it) {
+            if (it->buf == wsm) {
+                free(it->buf);
+                wsms.erase(it);
+                mcResult = MC_DRV_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+static mcResult_t mockMap(
+    mcSessionHandle_t  *session,
+    void               *buf,
+    uint32_t           len,
+    mcBulkMap_t        *mapInfo,
+    bool               input
+)
+{
+    mcResult_t mcResult = MC_DRV_ERR_BULK_MAPPING;
+
+    if ((session == NULL) || (buf == NULL) || (mapInfo == NULL)) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+    uint32_t offset = (uint32_t)((uintptr_t)buf & (MOCK_PAGE_SIZE - 1));
+    if ((len == 0) || (len > MOCK_MAP_WINDOW_SIZE - offset)) {
+        return MC_DRV_ERR_INVALID_LENGTH;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *s = findSession(session->sessionId);
+    if (s == NULL) {
+        mcResult = MC_DRV_ERR_UNKNOWN_SESSION;
+    } else if (input && !inputMaps) {
+        mcResult = MAKE_MC_DRV_KMOD_WITH_ERRNO(ENOTTY);
+    } else {
+        for (uint32_t i = 0; i < MC_MOCK_MAX_MAPS; i++) {
+            MockMap *map = &s->maps[i];
+            if (map->buf == (uint8_t *)buf) {
+                mcResult = MC_DRV_ERR_BUFFER_ALREADY_MAPPED;
+                break;
+            }
+            if (map->buf == NULL) {
+                map->buf = (uint8_t *)buf;
+                map->len = len;
+                map->sva = MOCK_MAP_WINDOW_BASE + i * MOCK_MAP_WINDOW_SIZE + offset;
+                map->input = input;
+                mapInfo->sVirtualAddr = (void *)(uintptr_t)map->sva;
+                mapInfo->sVirtualLen = len;
+                stats.maps++;
+                stats.bytesMapped += len;
+                if (input) {
+                    stats.inputMaps++;
+                }
+                mcResult = MC_DRV_OK;
+                break;
+            }
+        }
+        if (mcResult == MC_DRV_ERR_BULK_MAPPING) {
+            LOG_E("%s: more than %d bulk buffers mapped in session %u",
+                  __FUNCTION__, MC_MOCK_MAX_MAPS, s->id);
+        }
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMap(
+    mcSessionHandle_t  *session,
+    void               *buf,
+    uint32_t           len,
+    mcBulkMap_t        *mapInfo
+)
+{
+    return mockMap(session, buf, len, mapInfo, false);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcMapInput(
+    mcSessionHandle_t  *session,
+    const void         *buf,
+    uint32_t           len,
+    mcBulkMap_t        *mapInfo
+)
+{
+    return mockMap(session, (void *)buf, len, mapInfo, true);
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcUnmap(
+    mcSessionHandle_t  *session,
+    void               *buf,
+    mcBulkMap_t        *mapInfo
+)
+{
+    mcResult_t mcResult = MC_DRV_ERR_BLK_BUFF_NOT_FOUND;
+
+    if ((session == NULL) || (buf == NULL) || (mapInfo == NULL)) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *s = findSession(session->sessionId);
+    if (s == NULL) {
+        mcResult = MC_DRV_ERR_UNKNOWN_SESSION;
+    } else {
+        for (int i = 0; i < MC_MOCK_MAX_MAPS; i++) {
+            MockMap *map = &s->maps[i];
+            if ((map->buf == (uint8_t *)buf) &&
+                (map->sva == (uint32_t)(uintptr_t)mapInfo->sVirtualAddr))
+            {
+                memset(map, 0, sizeof(*map));
+                stats.unmaps++;
+                mcResult = MC_DRV_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcDriverCtrl(
+    mcDriverCtrl_t  param,
+    uint8_t         *data,
+    uint32_t        len
+)
+{
+    (void)param; (void)data; (void)len;
+    return MC_DRV_ERR_NOT_IMPLEMENTED;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcGetSessionErrorCode(
+    mcSessionHandle_t   *session,
+    int32_t             *lastErr
+)
+{
+    mcResult_t mcResult = MC_DRV_OK;
+
+    if ((session == NULL) || (lastErr == NULL)) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&mockMutex);
+    MockSession *s = findSession(session->sessionId);
+    if (s == NULL) {
+        mcResult = MC_DRV_ERR_UNKNOWN_SESSION;
+    } else {
+        *lastErr = s->lastErr;
+        s->lastErr = 0;
+    }
+    pthread_mutex_unlock(&mockMutex);
+
+    return mcResult;
+}
+
+//------------------------------------------------------------------------------
+__MC_CLIENT_LIB_API mcResult_t mcGetMobiCoreVersion(
+    uint32_t  deviceId,
+    mcVersionInfo_t *versionInfo
+)
+{
+    if (versionInfo == NULL) {
+        return MC_DRV_ERR_NULL_POINTER;
+    }
+    if (deviceId != MC_DEVICE_ID_DEFAULT) {
+        return MC_DRV_ERR_UNKNOWN_DEVICE;
+    }
+
+    memset(versionInfo, 0, sizeof(*versionInfo));
+    strncpy(versionInfo->productId, "t-base-MOCK", MC_PRODUCT_ID_LEN - 1);
+
+    return MC_DRV_OK;
+}
+
+/** @} */
@@ -0,0 +1,140 @@
+/** @addtogroup MCD_IMPL_LIB
+ * @{
+ * @file
+ *
+ * Host-side mock of the <t-base Driver API.
+ *
+ * libMcClientMock exports the same functions as libMcClient, but instead of
+ * talking to the daemon and /dev/mobicore it runs Trusted Applications as
+ * callbacks inside the calling process. This lets TLCs such as the keymaster
+ * and gatekeeper HALs be exercised and benchmarked on a Linux host.
+ *
+ * A simulated TA is registered by UUID, which mcOpenTrustlet() takes from
+ * the MCLF header of the blob it is given. Its command handler runs when the
+ * client waits for the notification that follows mcNotify(), once the
+ * configured world switch latency has passed since mcNotify(), so work the
+ * client does in between overlaps the TA as on the device. Bulk buffers appear to the TA at 32-bit
+ * secure virtual addresses, as on the device, and are resolved back to
+ * client memory with mcMockResolve().
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MCCLIENTMOCK_H_
+#define MCCLIENTMOCK_H_
+
+#include "MobiCoreDriverApi.h"
+
+#ifndef WIN32
+/* Mark only the following functions for export */
+#pragma GCC visibility push(default)
+#endif
+
+/** Bulk buffers a TA can have mapped at once, as on the device */
+#define MC_MOCK_MAX_MAPS    6
+
+/** Simulated Trusted Application */
+typedef struct {
+    /**
+     * Handle one command in the TCI. Returning anything but MC_DRV_OK makes
+     * the TA exit with that error code, reported to the client through
+     * mcWaitNotification() and mcGetSessionErrorCode().
+     */
+    mcResult_t (*onNotify)(void *ctx, uint32_t sessionId, uint8_t *tci, uint32_t tciLen);
+    /** Optional, called when a session is opened */
+    mcResult_t (*onOpen)(void *ctx, uint32_t sessionId, uint8_t *tci, uint32_t tciLen);
+    /** Optional, called when a session is closed */
+    void (*onClose)(void *ctx, uint32_t sessionId);
+    void *ctx;
+    /** Simulated world switch latency per notification, in microseconds,
+     *  counted from mcNotify() */
+    uint32_t latencyUs;
+} mcMockTa_t;
+
+/** Transport counters, cumulative since the last mcMockResetStats() */
+typedef struct {
+    uint64_t sessionsOpened;
+    uint64_t notifications;
+    uint64_t maps;
+    uint64_t unmaps;
+    uint64_t wsmAllocs;
+    uint64_t inputMaps;     /**< maps done with mcMapInput(), included in maps */
+    uint64_t bytesMapped;   /**< total length of mcMap() and mcMapInput() buffers */
+    uint64_t bytesCopied;   /**< bulk bytes the TAs reached through mcMockResolve() */
+} mcMockStats_t;
+
+/**
+ * Register a simulated TA, replacing any previous one with the same UUID.
+ *
+ * @return MC_DRV_OK or MC_DRV_ERR_INVALID_PARAMETER
+ */
+__MC_CLIENT_LIB_API mcResult_t mcMockRegisterTa(
+    const mcUuid_t      *uuid,
+    const mcMockTa_t    *ta
+);
+
+/**
+ * Remove all simulated TAs. Sessions must have been closed.
+ */
+__MC_CLIENT_LIB_API void mcMockUnregisterAll(void);
+
+/**
+ * Translate a secure virtual address of a bulk buffer mapped in a session
+ * into the client address it stands for. For use by TA callbacks.
+ *
+ * @return pointer to len bytes of client memory, or NULL if the range is not
+ *         entirely within one mapping of the session
+ */
+__MC_CLIENT_LIB_API void *mcMockResolve(
+    uint32_t            sessionId,
+    uint32_t            sVirtualAddr,
+    uint32_t            len
+);
+
+__MC_CLIENT_LIB_API void mcMockGetStats(
+    mcMockStats_t       *stats
+);
+
+__MC_CLIENT_LIB_API void mcMockResetStats(void);
+
+/**
+ * Make mcMapInput() fail like a kernel module without MC_IO_REG_WSM_INPUT,
+ * to exercise the copying fallback of a TLC. Enabled by default.
+ */
+__MC_CLIENT_LIB_API void mcMockSetInputMaps(
+    bool                enable
+);
+
+#ifndef WIN32
+#pragma GCC visibility pop
+#endif
+
+#endif /** MCCLIENTMOCK_H_ */
+
+/** @} */
@@ -106,7 +106,7 @@ int32_t Session::getLastErr(
 
 
 //------------------------------------------------------------------------------
-mcResult_t Session::addBulkBuf(addr_t buf, uint32_t len, BulkBufferDescriptor **blkBuf)
+mcResult_t Session::addBulkBuf(addr_t buf, uint32_t len, BulkBufferDescriptor **blkBuf, bool input)
 {
     uint64_t pPhysWsmL2;
     uint32_t handle;
@@ -125,7 +125,7 @@ mcResult_t Session::addBulkBuf(addr_t buf, uint32_t len, BulkBufferDescriptor **
     }
 
     // Prepare the interface structure for memory registration in Kernel Module
-    mcResult_t ret = mcKMod->registerWsmL2(buf, len, 0, &handle, &pPhysWsmL2);
+    mcResult_t ret = mcKMod->registerWsmL2(buf, len, 0, &handle, &pPhysWsmL2, input);
 
     if (ret != MC_DRV_OK) {
         LOG_V(" mcKMod->registerWsmL2() failed with %x", ret);
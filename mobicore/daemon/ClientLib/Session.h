@@ -113,11 +113,12 @@ public:
      * @param buf The virtual address of bulk buffer.
      * @param len Length of bulk buffer.
      * @param blkBuf pointer of the actual Bulk buffer descriptor with all address information.
+     * @param input The Trusted Application only reads the buffer, which may be read-only memory.
      *
      * @return MC_DRV_OK on success
      * @return MC_DRV_ERR_BUFFER_ALREADY_MAPPED
      */
-    mcResult_t addBulkBuf(addr_t buf, uint32_t len, BulkBufferDescriptor **blkBuf);
+    mcResult_t addBulkBuf(addr_t buf, uint32_t len, BulkBufferDescriptor **blkBuf, bool input);
 
     /**
      * Just register the buffer previously created to the session
@@ -426,6 +426,31 @@ __MC_CLIENT_LIB_API mcResult_t mcMap(
     mcBulkMap_t        *mapInfo
 );
 
+/**
+ * Map a bulk buffer the Trusted Application only reads from.
+ * Same as mcMap(), except that the pages are registered without write access. The buffer may therefore
+ * be read-only memory of the CA, such as a binder transaction buffer, and does not have to be copied to
+ * writable memory first. The TA gets a read-only mapping. Remove the mapping with mcUnmap().
+ *
+ * @param [in] session Session handle with information of the deviceId and the sessionId.
+ * @param [in] buf Virtual address of a memory portion (relative to CA) to be read by the Trusted Application.
+ * @param [in] len length of buffer block in bytes.
+ * @param [out] mapInfo Information structure about the mapped Bulk buffer between the CA (NWd) and
+ * the TA (SWd).
+ *
+ * @return the values documented for mcMap().
+ * @return MC_DRV_ERR_KERNEL_MODULE with errno ENOTTY when the kernel module cannot register input buffers;
+ * the caller has to copy the buffer and use mcMap() instead.
+ *
+ * Uses a Mutex.
+ */
+__MC_CLIENT_LIB_API mcResult_t mcMapInput(
+    mcSessionHandle_t  *session,
+    const void         *buf,
+    uint32_t           len,
+    mcBulkMap_t        *mapInfo
+);
+
 /**
  * Remove additional mapped bulk buffer between Client Application (CA) and the Trusted Application (TA) for a session.
  *
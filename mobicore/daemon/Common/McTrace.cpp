@@ -0,0 +1,331 @@
+/** @addtogroup MCD_MCDIMPL_DAEMON_SRV
+ * @{
+ * @file
+ *
+ * Binary trace buffer implementation.
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "McTrace.h"
+#include "log.h"
+
+typedef struct mcTraceRing {
+    struct mcTraceRing  *next;      /**< list of all rings, never shrinks */
+    volatile int32_t    owned;      /**< 1 while a thread writes into it */
+    pid_t               tid;
+    uint32_t            head;       /**< total number of entries written */
+    mcTraceEntry_t      entries[MC_TRACE_RING_SIZE];
+} mcTraceRing_t;
+
+#define MC_TRACE_LEVEL(id, level, fmt) level,
+const uint32_t g_mcTraceLevel[MC_TRC_COUNT] = {
+    MC_TRACE_POINTS(MC_TRACE_LEVEL)
+};
+#undef MC_TRACE_LEVEL
+
+#define MC_TRACE_FORMAT(id, level, fmt) fmt,
+static const char *const mcTraceFormat[MC_TRC_COUNT] = {
+    MC_TRACE_POINTS(MC_TRACE_FORMAT)
+};
+#undef MC_TRACE_FORMAT
+
+volatile uint32_t g_mcTraceMask = MC_TRACE_LEVEL_DEFAULT;
+
+static mcTraceRing_t *volatile mcTraceRings = NULL;
+static __thread mcTraceRing_t *mcTraceThreadRing = NULL;
+static pthread_key_t mcTraceKey;
+static pthread_once_t mcTraceOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t mcTraceSignalOnce = PTHREAD_ONCE_INIT;
+static char mcTraceDumpDir[96] = MC_TRACE_DUMP_DIR;
+
+
+//------------------------------------------------------------------------------
+static void mcTraceThreadExit(
+    void *ring
+)
+{
+    // Hand the ring over to the next thread that starts tracing
+    __sync_lock_release(&((mcTraceRing_t *)ring)->owned);
+}
+
+
+//------------------------------------------------------------------------------
+static void mcTraceDumpSignal(
+    int signo
+)
+{
+    int savedErrno = errno;
+    char path[sizeof(mcTraceDumpDir) + 32];
+    char digits[12];
+    size_t len = strlen(mcTraceDumpDir);
+    size_t n = 0;
+    int pid = (int)getpid();
+    int fd;
+
+    (void)signo;
+
+    // <dir>/mctrace.<pid>.bin, built here so that a forked child names itself;
+    // snprintf is not async-signal-safe
+    memcpy(path, mcTraceDumpDir, len);
+    memcpy(path + len, "/mctrace.", 9);
+    len += 9;
+    do {
+        digits[n++] = (char)('0' + pid % 10);
+        pid /= 10;
+    } while (pid > 0);
+    while (n > 0) {
+        path[len++] = digits[--n];
+    }
+    memcpy(path + len, ".bin", 5);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        mcTraceWrite(fd);
+        close(fd);
+    }
+    errno = savedErrno;
+}
+
+
+//------------------------------------------------------------------------------
+static void mcTraceInstallSignal(
+    void
+)
+{
+    struct sigaction sa;
+
+    // Leave the signal alone if the process uses it
+    if ((sigaction(MC_TRACE_DUMP_SIGNAL, NULL, &sa) == 0) && (sa.sa_handler == SIG_DFL)) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = mcTraceDumpSignal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(MC_TRACE_DUMP_SIGNAL, &sa, NULL);
+    }
+}
+
+
+//------------------------------------------------------------------------------
+static void mcTraceInit(
+    void
+)
+{
+    const char *mask = getenv("MC_TRACE_MASK");
+    const char *dir = getenv("MC_TRACE_DIR");
+
+    if (mask != NULL) {
+        g_mcTraceMask = (uint32_t)strtoul(mask, NULL, 0);
+    }
+    if ((dir != NULL) && (dir[0] != '\0') && (strlen(dir) < sizeof(mcTraceDumpDir))) {
+        strcpy(mcTraceDumpDir, dir);
+    }
+    pthread_key_create(&mcTraceKey, mcTraceThreadExit);
+
+    // Clients of the library only get the dump signal when asked for it in
+    // their environment: many of them cannot write to MC_TRACE_DUMP_DIR.
+    if ((mask != NULL) || (dir != NULL)) {
+        pthread_once(&mcTraceSignalOnce, mcTraceInstallSignal);
+    }
+}
+
+
+//------------------------------------------------------------------------------
+void mcTraceEnableDumpSignal(
+    void
+)
+{
+    pthread_once(&mcTraceOnce, mcTraceInit);
+    pthread_once(&mcTraceSignalOnce, mcTraceInstallSignal);
+}
+
+
+//------------------------------------------------------------------------------
+static mcTraceRing_t *mcTraceAttach(
+    void
+)
+{
+    mcTraceRing_t *ring;
+
+    pthread_once(&mcTraceOnce, mcTraceInit);
+
+    // Reuse the ring of a thread that has exited, if there is one
+    for (ring = mcTraceRings; ring != NULL; ring = ring->next) {
+        if (__sync_lock_test_and_set(&ring->owned, 1) == 0) {
+            break;
+        }
+    }
+
+    if (ring == NULL) {
+        ring = (mcTraceRing_t *)calloc(1, sizeof(mcTraceRing_t));
+        if (ring == NULL) {
+            return NULL;
+        }
+        ring->owned = 1;
+        do {
+            ring->next = mcTraceRings;
+        } while (!__sync_bool_compare_and_swap(&mcTraceRings, ring->next, ring));
+    }
+
+    ring->tid = gettid();
+    ring->head = 0;
+    pthread_setspecific(mcTraceKey, ring);
+    mcTraceThreadRing = ring;
+    return ring;
+}
+
+
+//------------------------------------------------------------------------------
+void mcTraceRecord(
+    mcTracePoint_t  id,
+    uint32_t        arg0,
+    uint32_t        arg1
+)
+{
+    mcTraceRing_t *ring = mcTraceThreadRing;
+    struct timespec now;
+
+    if (ring == NULL) {
+        ring = mcTraceAttach();
+        if (ring == NULL) {
+            return;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    mcTraceEntry_t *entry = &ring->entries[ring->head & (MC_TRACE_RING_SIZE - 1)];
+    entry->timestamp = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    entry->id = id;
+    entry->arg0 = arg0;
+    entry->arg1 = arg1;
+    __sync_synchronize();
+    ring->head++;
+}
+
+
+//------------------------------------------------------------------------------
+void mcTraceDump(
+    void
+)
+{
+    char line[160];
+
+    for (mcTraceRing_t *ring = mcTraceRings; ring != NULL; ring = ring->next) {
+        uint32_t head = ring->head;
+        uint32_t first = (head > MC_TRACE_RING_SIZE) ? head - MC_TRACE_RING_SIZE : 0;
+
+        if (head == 0) {
+            continue;
+        }
+        LOG_w("trace of thread %d, %u entries (%u dropped)",
+              ring->tid, head - first, first);
+
+        for (uint32_t i = first; i < head; i++) {
+            const mcTraceEntry_t *entry = &ring->entries[i & (MC_TRACE_RING_SIZE - 1)];
+
+            if (entry->id >= MC_TRC_COUNT) {
+                continue;
+            }
+            snprintf(line, sizeof(line), mcTraceFormat[entry->id], entry->arg0, entry->arg1);
+            LOG_w("  [%" PRIu64 ".%06" PRIu64 "] %s",
+                  (uint64_t)(entry->timestamp / 1000000000ULL),
+                  (uint64_t)((entry->timestamp % 1000000000ULL) / 1000), line);
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+static int mcTraceWriteAll(
+    int         fd,
+    const void  *buf,
+    size_t      len
+)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+int mcTraceWrite(
+    int fd
+)
+{
+    mcTraceFileHeader_t header;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = MC_TRACE_FILE_MAGIC;
+    header.version = MC_TRACE_FILE_VERSION;
+    header.ringSize = MC_TRACE_RING_SIZE;
+    header.points = MC_TRC_COUNT;
+    header.pid = (int32_t)getpid();
+    if (mcTraceWriteAll(fd, &header, sizeof(header)) != 0) {
+        return -1;
+    }
+
+    for (mcTraceRing_t *ring = mcTraceRings; ring != NULL; ring = ring->next) {
+        mcTraceFileRing_t fileRing;
+
+        fileRing.tid = (int32_t)ring->tid;
+        fileRing.head = ring->head;
+        if (fileRing.head == 0) {
+            continue;
+        }
+        if ((mcTraceWriteAll(fd, &fileRing, sizeof(fileRing)) != 0) ||
+            (mcTraceWriteAll(fd, ring->entries, sizeof(ring->entries)) != 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** @} */
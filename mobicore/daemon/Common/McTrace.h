@@ -0,0 +1,152 @@
+/** @addtogroup MCD_MCDIMPL_DAEMON_SRV
+ * @{
+ * @file
+ *
+ * Binary trace buffer for hot paths of the daemon and the client library.
+ *
+ * Each thread records fixed size entries (trace point id, two 32 bit
+ * arguments, timestamp) into its own ring buffer, without locks and without
+ * any formatting. The format strings live in the MC_TRACE_POINTS table and
+ * are only applied when the buffers are decoded: by mcTraceDump() to the log
+ * when the daemon gives up on the secure world, or offline by mctrace_decode
+ * from the file a process writes when it receives MC_TRACE_DUMP_SIGNAL.
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MCTRACE_H_
+#define MCTRACE_H_
+
+#include <inttypes.h>
+#include <signal.h>
+
+/** Trace points: id, level, format of the two arguments. */
+#define MC_TRACE_POINTS(X) \
+    X(MC_TRC_DAEMON_CMD,       MC_TRACE_LEVEL_INFO,  "handleConnection: command %u on socket %d") \
+    X(MC_TRC_DAEMON_CMD_DONE,  MC_TRACE_LEVEL_INFO,  "handleConnection: command %u done, ret %u") \
+    X(MC_TRC_IRQ_MCP,          MC_TRACE_LEVEL_INFO,  "handleIrq: notification for MCP, payload=%d") \
+    X(MC_TRC_IRQ_SESSION,      MC_TRACE_LEVEL_INFO,  "handleIrq: notification for session %d, payload=%d") \
+    X(MC_TRC_IRQ_FORWARD,      MC_TRACE_LEVEL_VERBOSE, "handleIrq: forward notification for session %d") \
+    X(MC_TRC_GP_PARAM,         MC_TRACE_LEVEL_INFO,  "_TEEC_SetupOperation: param %u, type %#x") \
+    X(MC_TRC_FSD_CMD,          MC_TRACE_LEVEL_INFO,  "FSD: command %#x") \
+    X(MC_TRC_FSD_CMD_DONE,     MC_TRACE_LEVEL_INFO,  "FSD: command %#x done, status %#x")
+
+#define MC_TRACE_LEVEL_INFO     (1U << 0)
+#define MC_TRACE_LEVEL_VERBOSE  (1U << 1)
+
+/** Levels recorded unless overridden by the MC_TRACE_MASK environment variable.
+ * Every process has at least one trace point at this level. */
+#define MC_TRACE_LEVEL_DEFAULT  MC_TRACE_LEVEL_INFO
+
+/** Entries per thread, must be a power of two. */
+#define MC_TRACE_RING_SIZE      256
+
+/** Signal that makes a tracing process write its buffers to
+ * MC_TRACE_DUMP_DIR/mctrace.<pid>.bin, unless the process handles it itself.
+ * The directory can be overridden by the MC_TRACE_DIR environment variable.
+ * Only the daemon catches it by default, see mcTraceEnableDumpSignal(). */
+#define MC_TRACE_DUMP_SIGNAL    SIGUSR2
+#ifndef MC_TRACE_DUMP_DIR
+#define MC_TRACE_DUMP_DIR       "/data/local/tmp"
+#endif
+
+/** Dump file: a header, then per thread a ring header and its entries. */
+#define MC_TRACE_FILE_MAGIC     0x5254434DU     /* "MCTR" */
+#define MC_TRACE_FILE_VERSION   1
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    ringSize;   /**< entries per ring, MC_TRACE_RING_SIZE */
+    uint32_t    points;     /**< MC_TRC_COUNT of the writer */
+    int32_t     pid;
+    uint32_t    reserved;
+} mcTraceFileHeader_t;
+
+typedef struct {
+    int32_t     tid;
+    uint32_t    head;       /**< total number of entries written */
+} mcTraceFileRing_t;
+
+typedef struct {
+    uint64_t    timestamp;  /**< CLOCK_MONOTONIC, nanoseconds */
+    uint32_t    id;         /**< mcTracePoint_t */
+    uint32_t    arg0;
+    uint32_t    arg1;
+    uint32_t    reserved;
+} mcTraceEntry_t;
+
+#define MC_TRACE_ENUM(id, level, fmt) id,
+typedef enum {
+    MC_TRACE_POINTS(MC_TRACE_ENUM)
+    MC_TRC_COUNT
+} mcTracePoint_t;
+#undef MC_TRACE_ENUM
+
+/** Runtime level mask, one bit per MC_TRACE_LEVEL_*. */
+extern volatile uint32_t g_mcTraceMask;
+
+/** Level of each trace point, indexed by mcTracePoint_t. */
+extern const uint32_t g_mcTraceLevel[MC_TRC_COUNT];
+
+/** Append one entry to the ring buffer of the calling thread. */
+void mcTraceRecord(mcTracePoint_t id, uint32_t arg0, uint32_t arg1);
+
+/** Catch MC_TRACE_DUMP_SIGNAL in this process, unless it handles the signal
+ * itself. Other processes that trace catch it only when MC_TRACE_MASK or
+ * MC_TRACE_DIR is set in their environment. */
+void mcTraceEnableDumpSignal(void);
+
+/** Decode the ring buffers of all threads to the log, oldest entry first. */
+void mcTraceDump(void);
+
+/** Write the ring buffers of all threads to fd in the dump file format.
+ * Async-signal-safe.
+ *
+ * @return 0 or -1 if a write failed */
+int mcTraceWrite(int fd);
+
+/** MC_TRACE(id, arg0, arg1)
+ * Record a trace point if its level is enabled. Compiled out completely if
+ * MC_TRACE_DISABLE is defined.
+ */
+#ifdef MC_TRACE_DISABLE
+#define MC_TRACE(id, arg0, arg1) do{}while(0)
+#else
+#define MC_TRACE(id, arg0, arg1) \
+            do \
+            { \
+                if (g_mcTraceMask & g_mcTraceLevel[id]) \
+                    mcTraceRecord(id, (uint32_t)(arg0), (uint32_t)(arg1)); \
+            } while(1!=1)
+#endif
+
+#endif /* MCTRACE_H_ */
+
+/** @} */
@@ -0,0 +1,140 @@
+/** @addtogroup MCD_MCDIMPL_DAEMON_SRV
+ * @{
+ * @file
+ *
+ * mctrace_decode: offline decoder of McTrace dump files.
+ *
+ * A process that records trace points writes its ring buffers to
+ * MC_TRACE_DUMP_DIR/mctrace.<pid>.bin when it receives MC_TRACE_DUMP_SIGNAL.
+ * This tool formats them with the MC_TRACE_POINTS table it was built with,
+ * one thread after the other, oldest entry first.
+ *
+ *   mctrace_decode FILE...
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "McTrace.h"
+
+#define MC_TRACE_NAME(id, level, fmt) #id,
+static const char *const traceName[MC_TRC_COUNT] = {
+    MC_TRACE_POINTS(MC_TRACE_NAME)
+};
+#undef MC_TRACE_NAME
+
+#define MC_TRACE_FORMAT(id, level, fmt) fmt,
+static const char *const traceFormat[MC_TRC_COUNT] = {
+    MC_TRACE_POINTS(MC_TRACE_FORMAT)
+};
+#undef MC_TRACE_FORMAT
+
+//------------------------------------------------------------------------------
+static int decode(
+    const char  *path
+)
+{
+    FILE *f = fopen(path, "rb");
+    mcTraceFileHeader_t header;
+    mcTraceFileRing_t ring;
+    mcTraceEntry_t entries[MC_TRACE_RING_SIZE];
+    char line[160];
+
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+        (header.magic != MC_TRACE_FILE_MAGIC) ||
+        (header.version != MC_TRACE_FILE_VERSION) ||
+        (header.ringSize != MC_TRACE_RING_SIZE)) {
+        fprintf(stderr, "%s: not a trace dump of this version\n", path);
+        fclose(f);
+        return 1;
+    }
+    if (header.points != MC_TRC_COUNT) {
+        fprintf(stderr, "%s: written with %u trace points, decoding with %u\n",
+                path, header.points, (uint32_t)MC_TRC_COUNT);
+    }
+
+    printf("%s: process %d\n", path, header.pid);
+    while (fread(&ring, sizeof(ring), 1, f) == 1) {
+        if (fread(entries, sizeof(entries), 1, f) != 1) {
+            fprintf(stderr, "%s: truncated\n", path);
+            fclose(f);
+            return 1;
+        }
+
+        uint32_t first = (ring.head > MC_TRACE_RING_SIZE) ? ring.head - MC_TRACE_RING_SIZE : 0;
+        printf("thread %d, %u entries (%u dropped)\n", ring.tid, ring.head - first, first);
+
+        for (uint32_t i = first; i < ring.head; i++) {
+            const mcTraceEntry_t *entry = &entries[i & (MC_TRACE_RING_SIZE - 1)];
+
+            if (entry->id < MC_TRC_COUNT) {
+                snprintf(line, sizeof(line), traceFormat[entry->id], entry->arg0, entry->arg1);
+                printf("  [%" PRIu64 ".%06" PRIu64 "] %-24s %s\n",
+                       (uint64_t)(entry->timestamp / 1000000000ULL),
+                       (uint64_t)((entry->timestamp % 1000000000ULL) / 1000),
+                       traceName[entry->id], line);
+            } else {
+                printf("  [%" PRIu64 ".%06" PRIu64 "] trace point %u: %#x %#x\n",
+                       (uint64_t)(entry->timestamp / 1000000000ULL),
+                       (uint64_t)((entry->timestamp % 1000000000ULL) / 1000),
+                       entry->id, entry->arg0, entry->arg1);
+            }
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+int main(
+    int     argc,
+    char    *argv[]
+)
+{
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 1; i < argc; i++) {
+        ret |= decode(argv[i]);
+    }
+    return ret;
+}
+
+/** @} */
@@ -0,0 +1,128 @@
+/** @addtogroup MCD_MCDIMPL_DAEMON_SRV
+ * @{
+ * @file
+ *
+ * mctrace_benchmark: per-call cost of a trace point.
+ *
+ * Times MC_TRACE() with its level enabled and disabled in the runtime mask,
+ * against formatting the same message as a LOG_I would before handing it to
+ * the log, which is what a trace point saves on a hot path.
+ *
+ *   -n COUNT   calls per variant (default 10000000)
+ *
+ * Copyright (c) 2013 TRUSTONIC LIMITED
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the TRUSTONIC LIMITED nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "McTrace.h"
+
+/* volatile, so the formatting is not optimized out */
+static volatile char sink;
+
+//------------------------------------------------------------------------------
+static double nowNs(
+    void
+)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+//------------------------------------------------------------------------------
+static double traceCalls(
+    uint32_t    mask,
+    uint32_t    count
+)
+{
+    g_mcTraceMask = mask;
+    double start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        MC_TRACE(MC_TRC_GP_PARAM, i & 3, 0x5);
+    }
+    return (nowNs() - start) / count;
+}
+
+
+//------------------------------------------------------------------------------
+static double formatCalls(
+    uint32_t    count
+)
+{
+    char line[160];
+
+    double start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "_TEEC_SetupOperation: param %u, type %#x;%d", i & 3, 0x5, __LINE__);
+        sink = line[0];
+    }
+    return (nowNs() - start) / count;
+}
+
+
+//------------------------------------------------------------------------------
+int main(
+    int     argc,
+    char    *argv[]
+)
+{
+    uint32_t count = 10000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (count == 0) {
+        count = 1;
+    }
+
+    /* the first call attaches the thread's ring */
+    traceCalls(MC_TRACE_LEVEL_DEFAULT, 1);
+
+    printf("%u calls per variant\n", count);
+    printf("%-20s %6.1f ns/call\n", "trace point on", traceCalls(MC_TRACE_LEVEL_DEFAULT, count));
+    printf("%-20s %6.1f ns/call\n", "trace point off", traceCalls(0, count));
+    printf("%-20s %6.1f ns/call\n", "formatted message", formatCalls(count));
+    return 0;
+}
+
+/** @} */
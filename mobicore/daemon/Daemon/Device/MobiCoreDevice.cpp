@@ -46,6 +46,7 @@
 #include "TrustletSession.h"
 
 #include "MobiCoreDevice.h"
+#include "McTrace.h"
 #include "Mci/mci.h"
 #include "mcLoadFormat.h"
 
@@ -351,6 +352,7 @@ bool MobiCoreDevice::waitMcpNotification(void)
         if (getMobicoreStatus() == MC_STATUS_HALT)
 		{
             dumpMobicoreStatus();
+            mcTraceDump();
             mcFault = true;
             return false;
         }
@@ -358,6 +360,7 @@ bool MobiCoreDevice::waitMcpNotification(void)
         counter--;
         if (counter < 1)
 		{
+            mcTraceDump();
             mcFault = true;
             return false;
         }
@@ -53,6 +53,7 @@
 #include "NotificationQueue.h"
 
 #include "log.h"
+#include "McTrace.h"
 
 
 #define NQ_NUM_ELEMS      (16)
@@ -660,8 +661,7 @@ void TrustZoneDevice::handleIrq(
             // check if the notification belongs to the MCP session
             if (notification->sessionId == SID_MCP)
             {
-                LOG_I(" Notification for MCP, payload=%d",
-                      notification->payload);
+                MC_TRACE(MC_TRC_IRQ_MCP, notification->payload, 0);
 
                 // Signal main thread of the driver to continue after MCP
                 // command has been processed by the MC
@@ -670,8 +670,7 @@ void TrustZoneDevice::handleIrq(
                 continue;
             }
 
-            LOG_I(" Notification for session %d, payload=%d",
-                notification->sessionId, notification->payload);
+            MC_TRACE(MC_TRC_IRQ_SESSION, notification->sessionId, notification->payload);
 
             // Get the Trustlet session for the session ID
             TrustletSession *ts = NULL;
@@ -697,7 +696,7 @@ void TrustZoneDevice::handleIrq(
                         taExitNotification.signal();
                     }
                 } else {
-                    LOG_I(" Forward notification to McClient.");
+                    MC_TRACE(MC_TRC_IRQ_FORWARD, notification->sessionId, 0);
                     // Forward session ID and additional payload of
                     // notification to the TLC/Application layer
                     connection->writeData((void *)notification,
@@ -44,6 +44,7 @@
 
 //#define LOG_VERBOSE
 #include "log.h"
+#include "McTrace.h"
 
 extern string getTlRegistryPath();
 
@@ -224,8 +225,6 @@ void FSD::FSD_listenDci(void){
 
     for(;;)
     {
-        LOG_I("FSD_listenDci(): Waiting for notification\n");
-
         /* Wait for notification from SWd */
         if (MC_DRV_OK != mcWaitNotification(&sessionHandle, MC_INFINITE_TIMEOUT))
         {
@@ -234,10 +233,12 @@ void FSD::FSD_listenDci(void){
         }
 
 		/* Received exception. */
-		LOG_I("FSD_listenDci(): Received Command (0x%.8x) from STH\n", dci->sth_request.type);
+		MC_TRACE(MC_TRC_FSD_CMD, dci->sth_request.type, 0);
 
 		mcRet = FSD_ExecuteCommand();
 
+		MC_TRACE(MC_TRC_FSD_CMD_DONE, dci->sth_request.type, dci->sth_request.status);
+
 		/* notify the STH*/
 		mcRet = mcNotify(&sessionHandle);
 		if (MC_DRV_OK != mcRet)
@@ -287,27 +288,22 @@ mcResult_t FSD::FSD_ExecuteCommand(void){
 			{
 				//--------------------------------------
 				case STH_MESSAGE_TYPE_LOOK:
-					LOG_I("FSD_ExecuteCommand(): Looking for file\n");
 					dci->sth_request.status=FSD_LookFile();
 
 					break;
 				//--------------------------------------
 				case STH_MESSAGE_TYPE_READ:
-					LOG_I("FSD_ExecuteCommand(): Reading file\n");
 					dci->sth_request.status=FSD_ReadFile();
 
 					break;
 				//--------------------------------------
 				case STH_MESSAGE_TYPE_WRITE:
-					LOG_I("FSD_ExecuteCommand(): Writing file\n");
 					dci->sth_request.status=FSD_WriteFile();
 
 					break;
 				//--------------------------------------
 				case STH_MESSAGE_TYPE_DELETE:
-					LOG_I("FSD_ExecuteCommand(): Deleting file\n");
 					dci->sth_request.status=FSD_DeleteFile();
-					LOG_I("FSD_ExecuteCommand(): file deleted status is 0x%08x\n",dci->sth_request.status);
 
 					break;
 				//--------------------------------------
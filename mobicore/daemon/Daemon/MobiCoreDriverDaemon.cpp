@@ -45,6 +45,7 @@
 #include "mcVersionHelper.h"
 #include "mc_linux.h"
 #include "log.h"
+#include "McTrace.h"
 #include "Mci/mci.h"
 
 #include "MobiCoreDriverApi.h"
@@ -1123,7 +1124,6 @@ bool MobiCoreDriverDaemon::handleConnection(
     mutex.lock();
     mobiCoreDevice->mutex_mcp.lock();
 
-    LOG_I("handleConnection()==== %p", connection);
     do {
         // Read header
         mcDrvCommandHeader_t mcDrvCommandHeader;
@@ -1145,6 +1145,8 @@ bool MobiCoreDriverDaemon::handleConnection(
         }
         ret = true;
 
+        MC_TRACE(MC_TRC_DAEMON_CMD, mcDrvCommandHeader.commandId, connection->socketDescriptor);
+
         switch (mcDrvCommandHeader.commandId) {
             //-----------------------------------------
         case MC_DRV_CMD_OPEN_DEVICE:
@@ -1229,10 +1231,10 @@ bool MobiCoreDriverDaemon::handleConnection(
             ret = false;
             break;
         }
+        MC_TRACE(MC_TRC_DAEMON_CMD_DONE, mcDrvCommandHeader.commandId, ret);
     } while (0);
     mobiCoreDevice->mutex_mcp.unlock();
     mutex.unlock();
-    LOG_I("handleConnection()<-------");
 
     return ret;
 }
@@ -1368,6 +1370,7 @@ int main(int argc, char *args[])
     sigaction (SIGINT, &action, NULL);
     sigaction (SIGTERM, &action, NULL);
     signal(SIGPIPE, SIG_IGN);
+    mcTraceEnableDumpSignal();
 
     mobiCoreDriverDaemon = new MobiCoreDriverDaemon(
         /* Scheduler status */
@@ -336,9 +336,11 @@ mcResult_t CMcKMod::registerWsmL2(
     uint32_t    len,
     uint32_t    pid,
     uint32_t    *pHandle,
-    uint64_t      *pPhysWsmL2)
+    uint64_t      *pPhysWsmL2,
+    bool        input)
 {
-    LOG_I(" Registering virtual buffer at %p, len=%d as World Shared Memory", buffer, len);
+    LOG_I(" Registering virtual buffer at %p, len=%d as World Shared Memory%s",
+          buffer, len, input ? " (input only)" : "");
 
     if (!isOpen()) {
         LOG_E("no connection to kmod");
@@ -351,9 +353,9 @@ mcResult_t CMcKMod::registerWsmL2(
         .pid = pid
     };
 
-    int ret = ioctl(fdKMod, MC_IO_REG_WSM, &params);
+    int ret = ioctl(fdKMod, input ? MC_IO_REG_WSM_INPUT : MC_IO_REG_WSM, &params);
     if (ret != 0) {
-        LOG_ERRNO("ioctl MC_IO_REG_WSM");
+        LOG_ERRNO(input ? "ioctl MC_IO_REG_WSM_INPUT" : "ioctl MC_IO_REG_WSM");
         return MAKE_MC_DRV_KMOD_WITH_ERRNO(errno);
     }
 
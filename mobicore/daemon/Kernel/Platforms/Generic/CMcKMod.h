@@ -118,7 +118,8 @@ public:
         uint32_t    len,
         uint32_t    pid,
         uint32_t    *pHandle,
-        uint64_t      *pPhysWsmL2);
+        uint64_t      *pPhysWsmL2,
+        bool        input = false);
 
     mcResult_t unregisterWsmL2(uint32_t handle);
 
@@ -171,6 +171,15 @@ struct mc_ioctl_resolv_wsm {
 #define MC_COMPAT_REG_WSM	_IOWR(MC_IOC_MAGIC, 6, \
 			struct mc_compat_ioctl_reg_wsm)
 
+/*
+ * Same as MC_IO_REG_WSM for a buffer the secure world only reads from.
+ * The pages are pinned without requesting write access, so read-only
+ * mappings (e.g. binder transaction buffers) can be registered, and the
+ * MMU table entries are marked read-only so the SWd cannot write to them.
+ * Drivers without this command fail with ENOTTY.
+ */
+#define MC_IO_REG_WSM_INPUT	_IOWR(MC_IOC_MAGIC, 18, struct mc_ioctl_reg_wsm)
+
 #define MC_IO_UNREG_WSM		_IO(MC_IOC_MAGIC, 7)
 #define MC_IO_LOCK_WSM		_IO(MC_IOC_MAGIC, 8)
 #define MC_IO_UNLOCK_WSM	_IO(MC_IOC_MAGIC, 9)
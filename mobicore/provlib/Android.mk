@@ -14,3 +14,4 @@ $(call import-module,$(COMP_PATH_MobiCoreDriverLib))
 
 # Include the Scripts
 include $(PROJECT_PATH)/jni/Android.mk
+include $(PROJECT_PATH)/test/Android.mk
@@ -0,0 +1,32 @@
+///
+/// @file       gdmccrc32.h
+///
+/// CRC32 of the provisioning messages (reflected 0x04C11DB7, as in zlib).
+///
+
+#ifndef _INC_GDMCCRC32_H_
+#define _INC_GDMCCRC32_H_
+
+#include <gdmcprovlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// CRC32 of data, initial value 0xFFFFFFFF, final XOR 0xFFFFFFFF
+_u32 GDPROVAPI CalcCRC32 ( const _u8 *data, _u32 length );
+
+/// The paths behind CalcCRC32; crc is the running value, neither
+/// initialized nor inverted. Slice-by-8 tables, always built.
+_u32 GDPROVAPI CalcCRC32Sw ( _u32 crc, const _u8 *data, _u32 length );
+
+#if defined(__ARM_FEATURE_CRC32)
+/// ARMv8 CRC32B/CRC32W instructions, used by CalcCRC32 when built for them
+_u32 GDPROVAPI CalcCRC32Hw ( _u32 crc, const _u8 *data, _u32 length );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_GDMCCRC32_H_
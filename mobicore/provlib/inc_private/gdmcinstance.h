@@ -19,6 +19,12 @@ struct _gdmcinst
   _u8                   suid[SUID_LENGTH];            ///< SUID as retrieved from MobiCore
   _u8                   kSoCAuth[K_SOC_AUTH_LENGTH];  ///< the K.SoC.Auth delivered by KPH
   gdmc_so_authtok       authTok;                      ///< generated SO.AuthToken
+  bool                  submitted;                    ///< a step was submitted and not completed yet
+  const _u8            *msgin;                        ///< its input message (caller's buffer)
+  _u32                  msgin_size;                   ///< size of the input message in bytes
+  gderror               msgin_error;                  ///< result of validating the input message
+  void                 *mccm;                         ///< channel of its trustlet call in flight, or NULL
+  _u32                  mccmcmd;                      ///< CMP command of that call
 };
 
 #ifdef __cplusplus
@@ -3,6 +3,7 @@
 
 #include <gdmcprovlib.h>
 #include <mobicore.h>
+#include <gdmccrc32.h>
 
 #ifdef WIN32
 
@@ -112,16 +113,4 @@ struct _gdmc_actmsg_resp
 #pragma pack(pop)
 #endif
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-_u32 GDPROVAPI CalcCRC32 ( const _u8 *data, _u32 length );
-
-void GDPROVAPI InitCRCTable ( void );
-
-#ifdef __cplusplus
-}
-#endif
-
 #endif // _INC_GDMCPROVPROTOCOL_H_
@@ -265,6 +265,9 @@ GDPUBLIC gderror GDPROVAPI GDMCProvEndProvisioning ( gdhandle provhandle );
 /// error code GDERROR_PROVISIONING_DONE is returned (meaning successful
 /// provisioning). Please refer to the MobiCore Provisioning API documentation
 /// for details.
+/// Steps of different instances may be executed concurrently from several
+/// threads, each of them gets its own MobiCore session for the duration of
+/// the trustlet call. One instance must not be used by two threads at once.
 ///
 /// @param[in]      provhandle      the handle returned by 
 ///                                 GDMCProvBeginProvisioning
@@ -287,6 +290,52 @@ GDPUBLIC gderror GDPROVAPI GDMCProvExecuteProvisioningStep (
                   _u8        *msgout,
                   _u32       *msgout_size );
 
+/// Starts one provisioning step without waiting for it: validates the input
+/// message and, if the step needs the MobiCore trustlet, sends the command.
+/// GDMCProvCompleteProvisioningStep then waits for the trustlet and returns
+/// the output message GDMCProvExecuteProvisioningStep would have returned.
+/// In between, the caller may submit and complete steps of other instances,
+/// so that their message validation and CRC computation overlap the
+/// trustlet call of this one.
+/// A submitted step keeps a MobiCore session until it is completed; if none
+/// is free, the trustlet is called on completion instead. Steps should be
+/// completed in the order they were submitted so that a thread never waits
+/// for a session it holds itself.
+///
+/// @param[in]      provhandle      the handle returned by
+///                                 GDMCProvBeginProvisioning
+/// @param[in]      msgin           pointer to buffer containing the
+///                                 input message; must stay valid until
+///                                 the step is completed
+/// @param[in]      msgin_size      size of buffer pointed to by msgin in bytes
+///
+/// @return                         G&D error code; GDERROR_SYNCHRONIZATION
+///                                 if a step of this instance is already
+///                                 submitted
+GDPUBLIC gderror GDPROVAPI GDMCProvSubmitProvisioningStep (
+                  gdhandle    provhandle,
+                  const _u8  *msgin,
+                  _u32        msgin_size );
+
+/// Completes the step started by GDMCProvSubmitProvisioningStep.
+///
+/// @param[in]      provhandle      the handle returned by
+///                                 GDMCProvBeginProvisioning
+/// @param[in/out]  msgout          pointer to buffer receiving the output
+///                                 message (in); output message (out)
+/// @param[in/out]  msgout_size     size of buffer pointed to by msgout in
+///                                 bytes (in); number of bytes copied to msgout
+///                                 (out)
+///
+/// @return                         G&D error code as for
+///                                 GDMCProvExecuteProvisioningStep;
+///                                 GDERROR_SYNCHRONIZATION if no step is
+///                                 submitted
+GDPUBLIC gderror GDPROVAPI GDMCProvCompleteProvisioningStep (
+                  gdhandle    provhandle,
+                  _u8        *msgout,
+                  _u32       *msgout_size );
+
 /// [PRODUCTION STATION ONLY] Convenience function to format an SD.Receipt
 ///
 /// @param[in]      receipt           pointer to buffer containing the 
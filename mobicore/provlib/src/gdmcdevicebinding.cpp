@@ -14,7 +14,7 @@
 
 extern "C"
 {
-  gderror MCGetSUID ( _u8 *suid );
+  gderror MCGetSUID ( gdmcinst *inst, _u8 *suid );
 
   gderror MCGenerateAuthToken ( gdmcinst *inst, const gdmc_actmsg_req *req, gdmc_so_authtok *authtok );
 }
@@ -354,7 +354,7 @@ gderror GDPROVAPI GDMCHandleGetSUID ( gdmcinst *inst,
 
   if (inst->state<GDMC_STATE_HAVE_SUID) // request SUID from MobiCore
   {
-    error = MCGetSUID(inst->suid);
+    error = MCGetSUID(inst,inst->suid);
 
     if (GDERROR_OK!=error)
       return GDMCComposeErrorMessage(inst,error,msgout,msgout_size,initial_msgout_size,
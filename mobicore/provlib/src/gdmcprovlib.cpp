@@ -67,6 +67,9 @@ static HMODULE g_hInstance = NULL;
 extern "C" {
 extern bool mccmOpen ( void );
 extern void mccmClose ( void );
+extern bool MCSubmitGetSUID ( gdmcinst *inst );
+extern bool MCSubmitGenerateAuthToken ( gdmcinst *inst, const gdmc_actmsg_req *req );
+extern void MCCancel ( gdmcinst *inst );
 }
 
 authtok_writecb         g_authtok_writecb = NULL;
@@ -140,15 +143,73 @@ static gderror GDPROVAPI _GDMCProvEndProvisioning ( gdhandle provhandle )
   if (IsBadWritePtr(inst,sizeof(gdmcinst)))
     return GDERROR_PARAMETER;
 
+  MCCancel(inst);
+
   free(inst);
 
   return GDERROR_OK;
 }
 
-static gderror GDPROVAPI _GDMCProvExecuteProvisioningStep (
+static gderror GDPROVAPI _GDMCProvSubmitProvisioningStep (
                   gdhandle    provhandle,
                   const _u8  *msgin,
-                  _u32        msgin_size,
+                  _u32        msgin_size )
+{
+  gdmcinst         *inst        = (gdmcinst*)(uintptr_t)provhandle;
+  gdmc_msgheader   *header      = NULL;
+  _u8              *body        = NULL;
+  gdmc_msgtrailer  *trailer     = NULL;
+
+  // 1.) Prolog: Check parameters...
+
+  if (IsBadWritePtr(inst,sizeof(gdmcinst)))
+    return GDERROR_PARAMETER;
+
+  if ((0!=msgin_size) && (IsBadReadPtr(msgin,msgin_size)))
+    return GDERROR_PARAMETER;
+
+  if (inst->submitted) // the previous step has not been completed
+    return GDERROR_SYNCHRONIZATION;
+
+  // 2.) Evaluate the message that has been received; a broken message is
+  //     reported when the step is completed
+
+  inst->submitted   = true;
+  inst->msgin       = msgin;
+  inst->msgin_size  = msgin_size;
+  inst->msgin_error = GDMCValidateProvMessage(msgin,msgin_size,&header,&body,&trailer);
+
+  if (GDERROR_OK!=inst->msgin_error)
+    return GDERROR_OK;
+
+  // 3.) Start the trustlet call the message handler is going to need; it
+  //     picks up the response. If no call could be started, the handler
+  //     makes it itself.
+
+  switch(header->msg_type)
+  {
+    case MC_GETSUID_REQ:
+      if (inst->state<GDMC_STATE_HAVE_SUID)
+        MCSubmitGetSUID(inst);
+      break;
+
+    case MC_GENAUTHTOKEN_REQ:
+      if (GDMC_STATE_INITIAL==inst->state)
+        MCSubmitGetSUID(inst);
+      else if ((GDMC_STATE_HAVE_SUID==inst->state) ||
+               memcmp(inst->kSoCAuth,((gdmc_actmsg_req*)body)->kSoCAuth,sizeof(inst->kSoCAuth)))
+        MCSubmitGenerateAuthToken(inst,(gdmc_actmsg_req*)body);
+      break;
+
+    default:
+      break;
+  }
+
+  return GDERROR_OK;
+}
+
+static gderror GDPROVAPI _GDMCProvCompleteProvisioningStep (
+                  gdhandle    provhandle,
                   _u8        *msgout,
                   _u32       *msgout_size )
 {
@@ -156,7 +217,6 @@ static gderror GDPROVAPI _GDMCProvExecuteProvisioningStep (
   gdmcinst         *inst        = (gdmcinst*)(uintptr_t)provhandle;
   gdmc_msgheader   *header      = NULL;
   _u8              *body        = NULL;
-  gdmc_msgtrailer  *trailer     = NULL;
   _u32              initial_msgout_size;
 
   // 1.) Prolog: Check parameters...
@@ -164,8 +224,8 @@ static gderror GDPROVAPI _GDMCProvExecuteProvisioningStep (
   if (IsBadWritePtr(inst,sizeof(gdmcinst)))
     return GDERROR_PARAMETER;
 
-  if ((0!=msgin_size) && (IsBadReadPtr(msgin,msgin_size)))
-    return GDERROR_PARAMETER;
+  if (!inst->submitted) // nothing to complete
+    return GDERROR_SYNCHRONIZATION;
 
   if (IsBadWritePtr(msgout_size,sizeof(_u32)))
     return GDERROR_PARAMETER;
@@ -181,29 +241,70 @@ static gderror GDPROVAPI _GDMCProvExecuteProvisioningStep (
 
   *msgout_size = 0;
 
-  // 2.) Evaluate the message that has been received
+  inst->submitted = false;
 
-  error = GDMCValidateProvMessage(msgin,msgin_size,&header,&body,&trailer);
+  if (GDERROR_OK!=inst->msgin_error) // something is wrong with the received message
+    return GDMCComposeErrorMessage(inst,inst->msgin_error,msgout,msgout_size,initial_msgout_size,ERRMSG_0006);
 
-  if (GDERROR_OK!=error) // something is wrong with the received message
-    return GDMCComposeErrorMessage(inst,error,msgout,msgout_size,initial_msgout_size,ERRMSG_0006);
+  header = (gdmc_msgheader*)inst->msgin;
+  body   = (_u8*)(inst->msgin+sizeof(gdmc_msgheader));
 
-  // 3.) Check which message has been received
+  // 2.) Check which message has been received
 
   switch(header->msg_type)
   {
     case MC_GETSUID_REQ:
-      return GDMCHandleGetSUID(inst,msgout,msgout_size,initial_msgout_size);
+      error = GDMCHandleGetSUID(inst,msgout,msgout_size,initial_msgout_size);
+      break;
 
     case MC_GENAUTHTOKEN_REQ:
-      return GDMCHandleGenAuthToken(inst,(gdmc_actmsg_req*)body,msgout,msgout_size,initial_msgout_size);
+      error = GDMCHandleGenAuthToken(inst,(gdmc_actmsg_req*)body,msgout,msgout_size,initial_msgout_size);
+      break;
 
     case MC_VALIDATEAUTHTOKEN_REQ:
-      return GDMCHandleValidateAuthToken(inst,(gdmc_so_authtok*)body,msgout,msgout_size,initial_msgout_size);
+      error = GDMCHandleValidateAuthToken(inst,(gdmc_so_authtok*)body,msgout,msgout_size,initial_msgout_size);
+      break;
 
     default:
-      return GDMCComposeErrorMessage(inst,GDERROR_UNKNOWN,msgout,msgout_size,initial_msgout_size,ERRMSG_0007);
+      error = GDMCComposeErrorMessage(inst,GDERROR_UNKNOWN,msgout,msgout_size,initial_msgout_size,ERRMSG_0007);
+      break;
   }
+
+  // A handler that failed early leaves the trustlet call unclaimed.
+
+  MCCancel(inst);
+
+  return error;
+}
+
+static gderror GDPROVAPI _GDMCProvExecuteProvisioningStep (
+                  gdhandle    provhandle,
+                  const _u8  *msgin,
+                  _u32        msgin_size,
+                  _u8        *msgout,
+                  _u32       *msgout_size )
+{
+  gderror           error       = GDERROR_OK;
+  gdmcinst         *inst        = (gdmcinst*)(uintptr_t)provhandle;
+
+  // Check the output buffer first so that a bad one does not leave the step
+  // submitted.
+
+  if (IsBadWritePtr(inst,sizeof(gdmcinst)))
+    return GDERROR_PARAMETER;
+
+  if (IsBadWritePtr(msgout_size,sizeof(_u32)))
+    return GDERROR_PARAMETER;
+
+  if ((0!=*msgout_size) && (IsBadWritePtr(msgout,*msgout_size)))
+    return GDERROR_PARAMETER;
+
+  error = _GDMCProvSubmitProvisioningStep(provhandle,msgin,msgin_size);
+
+  if (GDERROR_OK!=error)
+    return error;
+
+  return _GDMCProvCompleteProvisioningStep(provhandle,msgout,msgout_size);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -311,6 +412,30 @@ extern "C" gderror GDPROVAPI GDMCProvExecuteProvisioningStep (
   SE_CATCH // MUST BE LAST INSTRUCTION ///////////////////////////////////////
 }
 
+extern "C" gderror GDPROVAPI GDMCProvSubmitProvisioningStep (
+                  gdhandle    provhandle,
+                  const _u8  *msgin,
+                  _u32        msgin_size )
+{
+  SE_TRY // MUST BE FIRST INSTRUCTION ////////////////////////////////////////
+
+  return _GDMCProvSubmitProvisioningStep(provhandle,msgin,msgin_size);
+
+  SE_CATCH // MUST BE LAST INSTRUCTION ///////////////////////////////////////
+}
+
+extern "C" gderror GDPROVAPI GDMCProvCompleteProvisioningStep (
+                  gdhandle    provhandle,
+                  _u8        *msgout,
+                  _u32       *msgout_size )
+{
+  SE_TRY // MUST BE FIRST INSTRUCTION ////////////////////////////////////////
+
+  return _GDMCProvCompleteProvisioningStep(provhandle,msgout,msgout_size);
+
+  SE_CATCH // MUST BE LAST INSTRUCTION ///////////////////////////////////////
+}
+
 extern "C" gderror GDPROVAPI GDMCProvFormatReceipt (
                   const _u8  *receipt __unused,
                   _u32        receipt_size __unused,
@@ -374,7 +499,6 @@ BOOL WINAPI DllMain ( HINSTANCE hinstDLL,
       // We don't need additional calls with DLL_THREAD_ATTACH.
       g_hInstance = (HMODULE)hinstDLL;
       DisableThreadLibraryCalls(hinstDLL);
-      InitCRCTable();
       return TRUE;
     case DLL_PROCESS_DETACH:  // fall through
     case DLL_THREAD_ATTACH:   // fall through
@@ -388,16 +512,8 @@ BOOL WINAPI DllMain ( HINSTANCE hinstDLL,
 
 #else // library initialization and cleanup (Linux/ARM)
 
-void gdmcprovlib_init ( void ) __attribute__((constructor));
 void gdmcprovlib_fini ( void ) __attribute__((destructor));
 
-/// shared object global initialization function; gets automatically
-/// called when library is loaded
-void gdmcprovlib_init ( void )
-{
-  InitCRCTable();
-}
-
 /// shared object global cleanup function; gets automatically
 /// called when library is unloaded
 void gdmcprovlib_fini ( void )
@@ -14,9 +14,34 @@ struct tagMCCM
   mcResult_t            lasterror;    ///< last MC driver error
   cmpReturnCode_t       lastcmperr;   ///< last Content Management Protocol error
   uint32_t              lastmccmerr;  ///< error code from MCCM (MobiCore Content Management) library
+  bool                  open;         ///< session (and WSM) are set up
+  bool                  busy;         ///< channel is checked out by a thread
 };
 
-static MCCM g_mccm;
+/// Number of CMTL sessions that may be open concurrently. Provisioning
+/// steps of different instances (gdhandles) are served by different
+/// channels, so they can be executed from several threads at once.
+#define MCCM_POOL_SIZE    4
+
+static MCCM g_mccm[MCCM_POOL_SIZE];
+
+#ifndef WIN32
+static pthread_mutex_t  g_mccm_lock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_mccm_avail = PTHREAD_COND_INITIALIZER;
+#define MCCM_LOCK()       pthread_mutex_lock(&g_mccm_lock)
+#define MCCM_UNLOCK()     pthread_mutex_unlock(&g_mccm_lock)
+#define MCCM_WAIT()       pthread_cond_wait(&g_mccm_avail,&g_mccm_lock)
+#define MCCM_SIGNAL()     pthread_cond_signal(&g_mccm_avail)
+#else
+// Slim reader/writer locks and condition variables (Vista and later) can
+// both be initialized statically, like their pthread counterparts.
+static SRWLOCK            g_mccm_lock  = SRWLOCK_INIT;
+static CONDITION_VARIABLE g_mccm_avail = CONDITION_VARIABLE_INIT;
+#define MCCM_LOCK()       AcquireSRWLockExclusive(&g_mccm_lock)
+#define MCCM_UNLOCK()     ReleaseSRWLockExclusive(&g_mccm_lock)
+#define MCCM_WAIT()       SleepConditionVariableSRW(&g_mccm_avail,&g_mccm_lock,INFINITE,0)
+#define MCCM_SIGNAL()     WakeConditionVariable(&g_mccm_avail)
+#endif
 
 #ifdef ARM
 
@@ -48,13 +73,13 @@ extern void GDMCHexDump ( const unsigned char *data, int size );
 
 #endif // ARM
 
-static void dumpErrorInformation ( const char *function, mcResult_t result )
+static void dumpErrorInformation ( MCCM *mccm, const char *function, mcResult_t result )
 {
   int32_t lastErr = -1;
 
   LOG_e("%s returned error %u (0x%08X)",function,result,result);
 
-  if (MC_DRV_OK==mcGetSessionErrorCode(&g_mccm.sess,&lastErr))
+  if (MC_DRV_OK==mcGetSessionErrorCode(&mccm->sess,&lastErr))
   {
     LOG_e("mcGetSessionErrorCode for %s returned %i (0x%08X)",function,lastErr,lastErr);
   }
@@ -66,193 +91,354 @@ static void dumpErrorInformation ( const char *function, mcResult_t result )
 
 // Copied from MCCM library not to have this additional dependency!
 
-// returns 1 if successful, 0 otherwise
-bool mccmOpen ( void )
+static bool mccmOpenChannel ( MCCM *mccm )
 {
   const mcUuid_t      UUID = TL_CM_UUID;
   mcResult_t          result;
 
-  LOG_d("++++ ENTERED mccmOpen.");
+  memset(mccm,0,sizeof(MCCM));
 
-  memset(&g_mccm,0,sizeof(MCCM));
+  result = mcMallocWsm(MC_DEVICE_ID_DEFAULT, 0, sizeof(cmp_t), (uint8_t **)&mccm->cmp, 0);
 
-  result = mcOpenDevice(MC_DEVICE_ID_DEFAULT);
+  if (MC_DRV_OK != result)
+  {
+    LOG_e("mcMallocWsm returned error %u",result);
+    return false;
+  }
+
+  result = mcOpenSession(&mccm->sess,(const mcUuid_t *)&UUID,(uint8_t *)mccm->cmp,(uint32_t)sizeof(cmp_t));
 
   if (MC_DRV_OK != result)
   {
-	  LOG_e("mcOpenDevice returned error %u",result);
-    LOG_d("++++ LEFT mccmOpen.");
+    LOG_e("mcOpenSession returned error %u",result);
+    mcFreeWsm(MC_DEVICE_ID_DEFAULT,(uint8_t*)mccm->cmp);
+    memset(mccm,0,sizeof(MCCM));
     return false;
   }
 
-  result = mcMallocWsm(MC_DEVICE_ID_DEFAULT, 0, sizeof(cmp_t), (uint8_t **)&g_mccm.cmp, 0);
+  mccm->open = true;
+
+  return true;
+}
+
+static void mccmCloseChannel ( MCCM *mccm )
+{
+  mcResult_t          result;
+
+  if (!mccm->open)
+    return;
+
+  result = mcCloseSession(&mccm->sess);
+
   if (MC_DRV_OK != result)
   {
-    LOG_e("mcMallocWsm returned error %u",result);
-    mcCloseDevice(MC_DEVICE_ID_DEFAULT);
+	  LOG_e("mcCloseSession returned error %u",result);
+  }
+
+  if (NULL!=mccm->cmp)
+    mcFreeWsm(MC_DEVICE_ID_DEFAULT,(uint8_t*)mccm->cmp);
+
+  memset(mccm,0,sizeof(MCCM));
+}
+
+// returns 1 if successful, 0 otherwise
+bool mccmOpen ( void )
+{
+  mcResult_t          result;
+
+  LOG_d("++++ ENTERED mccmOpen.");
+
+  memset(g_mccm,0,sizeof(g_mccm));
+
+  result = mcOpenDevice(MC_DEVICE_ID_DEFAULT);
+
+  if (MC_DRV_OK != result)
+  {
+	  LOG_e("mcOpenDevice returned error %u",result);
     LOG_d("++++ LEFT mccmOpen.");
     return false;
   }
 
-  result = mcOpenSession(&g_mccm.sess,(const mcUuid_t *)&UUID,(uint8_t *)g_mccm.cmp,(uint32_t)sizeof(cmp_t));
-  if (MC_DRV_OK != result)
+  // Open the first channel right away so that initialization still fails
+  // early; the remaining ones are opened on demand by mccmAcquire.
+
+  if (!mccmOpenChannel(&g_mccm[0]))
   {
-    LOG_e("mcOpenSession returned error %u",result);
-    mcFreeWsm(MC_DEVICE_ID_DEFAULT,(uint8_t*)g_mccm.cmp);
     mcCloseDevice(MC_DEVICE_ID_DEFAULT);
     LOG_d("++++ LEFT mccmOpen.");
     return false;
   }
 
   LOG_d("++++ LEFT mccmOpen.");
+
   return true;
 }
 
 void mccmClose ( void )
 {
-  mcResult_t          result;
+  int                 i;
+
   LOG_d("++++ ENTERED mccmClose.");
 
-  result = mcCloseSession(&g_mccm.sess);
-  if (MC_DRV_OK != result)
-  {
-	  LOG_e("mcCloseSession returned error %u",result);
-  }
+  MCCM_LOCK();
 
-  if (NULL!=g_mccm.cmp)
-    mcFreeWsm(MC_DEVICE_ID_DEFAULT,(uint8_t*)g_mccm.cmp);
+  for (i=0;i<MCCM_POOL_SIZE;i++)
+    mccmCloseChannel(&g_mccm[i]);
 
-  mcCloseDevice(MC_DEVICE_ID_DEFAULT);
+  MCCM_UNLOCK();
 
-  memset(&g_mccm,0,sizeof(MCCM));
+  mcCloseDevice(MC_DEVICE_ID_DEFAULT);
 
   LOG_d("++++ LEFT mccmClose.");
 }
 
-static bool mccmTransmit ( int32_t timeout )
+/// Checks out a channel for exclusive use by the calling thread. Prefers an
+/// already open idle channel, opens a new one if none is idle and the pool
+/// is not exhausted, and waits otherwise (unless wait is false).
+/// The new session is opened without holding the pool lock: loading the
+/// trustlet takes long, and other threads must be able to check channels
+/// out and back in meanwhile. The slot is reserved (busy) while it opens.
+static MCCM *mccmAcquire ( bool wait )
+{
+  MCCM               *mccm    = NULL;
+  bool                canopen = true;
+  int                 i;
+
+  MCCM_LOCK();
+
+  for (;;)
+  {
+    MCCM *closed = NULL;
+    bool  inuse  = false;
+
+    for (i=0;i<MCCM_POOL_SIZE;i++)
+    {
+      if (g_mccm[i].busy)
+      {
+        inuse = true;
+        continue;
+      }
+      if (g_mccm[i].open)
+      {
+        mccm = &g_mccm[i];
+        break;
+      }
+      if (NULL==closed)
+        closed = &g_mccm[i];
+    }
+
+    if (NULL!=mccm)
+    {
+      mccm->busy = true;
+      break;
+    }
+
+    if (canopen && (NULL!=closed))
+    {
+      MCCM    opened;
+      bool    ok;
+
+      closed->busy = true;
+
+      MCCM_UNLOCK();
+      ok = mccmOpenChannel(&opened);
+      MCCM_LOCK();
+
+      if (ok)
+      {
+        opened.busy = true;
+        *closed     = opened;
+        mccm        = closed;
+        break;
+      }
+
+      // No further session could be opened; do not try again but wait for
+      // one of the channels other threads hold, if any.
+
+      closed->busy = false;
+      canopen      = false;
+      MCCM_SIGNAL();
+      continue;
+    }
+
+    if (!wait || !inuse)
+      break;
+
+    MCCM_WAIT();
+  }
+
+  MCCM_UNLOCK();
+
+  return mccm;
+}
+
+static void mccmRelease ( MCCM *mccm )
+{
+  MCCM_LOCK();
+  mccm->busy = false;
+  MCCM_SIGNAL();
+  MCCM_UNLOCK();
+}
+
+static bool mccmSubmit ( MCCM *mccm )
 {
-  LOG_d("++++ ENTERED mccmTransmit.");
+  LOG_d("++++ ENTERED mccmSubmit.");
 
   // Send CMP message to content management trustlet.
 
-  g_mccm.lasterror = mcNotify(&g_mccm.sess);
+  mccm->lasterror = mcNotify(&mccm->sess);
 
-  if (unlikely( MC_DRV_OK!=g_mccm.lasterror ))
+  if (unlikely( MC_DRV_OK!=mccm->lasterror ))
   {
-    dumpErrorInformation("mcNotify",g_mccm.lasterror);
-    LOG_d("++++ LEFT mccmTransmit.");
+    dumpErrorInformation(mccm,"mcNotify",mccm->lasterror);
+    LOG_d("++++ LEFT mccmSubmit.");
     return false;
   }
 
+  LOG_d("++++ LEFT mccmSubmit.");
+
+  return true;
+}
+
+static bool mccmWait ( MCCM *mccm, int32_t timeout )
+{
+  LOG_d("++++ ENTERED mccmWait.");
+
   // Wait for trustlet response.
 
-  g_mccm.lasterror = mcWaitNotification(&g_mccm.sess, timeout);
+  mccm->lasterror = mcWaitNotification(&mccm->sess, timeout);
 
-  if (unlikely( MC_DRV_OK!=g_mccm.lasterror ))
+  if (unlikely( MC_DRV_OK!=mccm->lasterror ))
   {
-    dumpErrorInformation("mcWaitNotification",g_mccm.lasterror);
-    LOG_d("++++ LEFT mccmTransmit.");
+    dumpErrorInformation(mccm,"mcWaitNotification",mccm->lasterror);
+    LOG_d("++++ LEFT mccmWait.");
     return false;
   }
 
-  LOG_d("++++ LEFT mccmTransmit.");
+  LOG_d("++++ LEFT mccmWait.");
 
   return true;
 }
 
-static bool mccmGetSuid ( mcSuid_t *suid )
+static bool mccmSubmitGetSuid ( MCCM *mccm )
 {
-  LOG_d("++++ ENTERED mccmGetSuid.");
+  LOG_d("++++ ENTERED mccmSubmitGetSuid.");
 
-  g_mccm.lastcmperr = SUCCESSFUL;
+  mccm->lastcmperr = SUCCESSFUL;
 
-  memset(g_mccm.cmp,0,sizeof(cmp_t));
-  g_mccm.cmp->msg.cmpCmdGetSuid.cmdHeader.commandId = MC_CMP_CMD_GET_SUID;
+  memset(mccm->cmp,0,sizeof(cmp_t));
+  mccm->cmp->msg.cmpCmdGetSuid.cmdHeader.commandId = MC_CMP_CMD_GET_SUID;
 
-  if (unlikely( !mccmTransmit(MC_INFINITE_TIMEOUT) ))
+  if (unlikely( !mccmSubmit(mccm) ))
   {
-    LOG_d("++++ LEFT mccmGetSuid.");
+    LOG_d("++++ LEFT mccmSubmitGetSuid.");
     return false;
   }
 
-  if (unlikely( (MC_CMP_CMD_GET_SUID|RSP_ID_MASK)!=g_mccm.cmp->msg.cmpRspGetSuid.rspHeader.responseId ))
+  LOG_d("++++ LEFT mccmSubmitGetSuid.");
+  return true;
+}
+
+static bool mccmFinishGetSuid ( MCCM *mccm, mcSuid_t *suid )
+{
+  LOG_d("++++ ENTERED mccmFinishGetSuid.");
+
+  if (unlikely( !mccmWait(mccm,MC_INFINITE_TIMEOUT) ))
+  {
+    LOG_d("++++ LEFT mccmFinishGetSuid.");
+    return false;
+  }
+
+  if (unlikely( (MC_CMP_CMD_GET_SUID|RSP_ID_MASK)!=mccm->cmp->msg.cmpRspGetSuid.rspHeader.responseId ))
   {
     LOG_e("Bad response ID of GET_SUID response.");
-    g_mccm.lasterror = MC_DRV_ERR_UNKNOWN;
-    LOG_d("++++ LEFT mccmGetSuid.");
+    mccm->lasterror = MC_DRV_ERR_UNKNOWN;
+    LOG_d("++++ LEFT mccmFinishGetSuid.");
     return false;
   }
 
-  g_mccm.lastcmperr = g_mccm.cmp->msg.cmpRspGetSuid.rspHeader.returnCode;
+  mccm->lastcmperr = mccm->cmp->msg.cmpRspGetSuid.rspHeader.returnCode;
 
-  if (unlikely( SUCCESSFUL!=g_mccm.lastcmperr ))
+  if (unlikely( SUCCESSFUL!=mccm->lastcmperr ))
   {
-    LOG_e("CMP error occurred, code: %u (0x%08X).",g_mccm.lastcmperr,g_mccm.lastcmperr);
-    g_mccm.lasterror = MC_DRV_ERR_UNKNOWN;
-    LOG_d("++++ LEFT mccmGetSuid.");
+    LOG_e("CMP error occurred, code: %u (0x%08X).",mccm->lastcmperr,mccm->lastcmperr);
+    mccm->lasterror = MC_DRV_ERR_UNKNOWN;
+    LOG_d("++++ LEFT mccmFinishGetSuid.");
     return false;
   }
 
-  memcpy(suid,&g_mccm.cmp->msg.cmpRspGetSuid.suid,sizeof(mcSuid_t));
+  memcpy(suid,&mccm->cmp->msg.cmpRspGetSuid.suid,sizeof(mcSuid_t));
 
 #ifdef _DEBUG
   LOG_d("SUID returned is:");
   GDMCHexDump((const unsigned char*)suid,sizeof(*suid));
 #endif
 
-  LOG_d("++++ LEFT mccmGetSuid.");
+  LOG_d("++++ LEFT mccmFinishGetSuid.");
   return true;
 }
 
-static bool mccmGenerateAuthToken (
-                      const cmpCmdGenAuthToken_t *cmd,
-                      cmpRspGenAuthToken_t       *rsp )
+static bool mccmSubmitGenerateAuthToken ( MCCM *mccm, const cmpCmdGenAuthToken_t *cmd )
 {
-  LOG_d("++++ ENTERED mccmGenerateAuthToken.");
+  LOG_d("++++ ENTERED mccmSubmitGenerateAuthToken.");
 
 #ifdef _DEBUG
   LOG_d("CMP request is (hexdump):");
   GDMCHexDump((const unsigned char*)cmd,sizeof(*cmd));
 #endif
 
-  g_mccm.lastcmperr = SUCCESSFUL;
+  mccm->lastcmperr = SUCCESSFUL;
+
+  memset(mccm->cmp,0,sizeof(cmp_t));
+
+  memcpy(mccm->cmp,cmd,sizeof(*cmd));
+
+  if (unlikely( !mccmSubmit(mccm) ))
+  {
+    LOG_d("++++ LEFT mccmSubmitGenerateAuthToken.");
+    return false;
+  }
 
-  memset(g_mccm.cmp,0,sizeof(cmp_t));
+  LOG_d("++++ LEFT mccmSubmitGenerateAuthToken.");
+  return true;
+}
 
-  memcpy(g_mccm.cmp,cmd,sizeof(*cmd));
+static bool mccmFinishGenerateAuthToken ( MCCM *mccm, cmpRspGenAuthToken_t *rsp )
+{
+  LOG_d("++++ ENTERED mccmFinishGenerateAuthToken.");
 
-  if (unlikely( !mccmTransmit(MC_INFINITE_TIMEOUT) ))
+  if (unlikely( !mccmWait(mccm,MC_INFINITE_TIMEOUT) ))
   {
-    LOG_d("++++ LEFT mccmGenerateAuthToken.");
+    LOG_d("++++ LEFT mccmFinishGenerateAuthToken.");
     return false;
   }
 
-  if (unlikely( (cmd->cmd.sdata.cmdHeader.commandId|RSP_ID_MASK)!=g_mccm.cmp->msg.cmpRspGenAuthToken.rsp.rspHeader.responseId ))
+  if (unlikely( (MC_CMP_CMD_GENERATE_AUTH_TOKEN|RSP_ID_MASK)!=mccm->cmp->msg.cmpRspGenAuthToken.rsp.rspHeader.responseId ))
   {
     LOG_e("Bad response ID of GENERATE_AUTH_TOKEN response.");
-    g_mccm.lasterror = MC_DRV_ERR_UNKNOWN;
-    LOG_d("++++ LEFT mccmGenerateAuthToken.");
+    mccm->lasterror = MC_DRV_ERR_UNKNOWN;
+    LOG_d("++++ LEFT mccmFinishGenerateAuthToken.");
     return false;
   }
 
-  g_mccm.lastcmperr = g_mccm.cmp->msg.cmpRspGenAuthToken.rsp.rspHeader.returnCode;
+  mccm->lastcmperr = mccm->cmp->msg.cmpRspGenAuthToken.rsp.rspHeader.returnCode;
 
-  if (unlikely( SUCCESSFUL!=g_mccm.lastcmperr ))
+  if (unlikely( SUCCESSFUL!=mccm->lastcmperr ))
   {
-    LOG_e("CMP error occurred, code: %u (0x%08X).",g_mccm.lastcmperr,g_mccm.lastcmperr);
-    g_mccm.lasterror = MC_DRV_ERR_UNKNOWN;
-    LOG_d("++++ LEFT mccmGenerateAuthToken.");
+    LOG_e("CMP error occurred, code: %u (0x%08X).",mccm->lastcmperr,mccm->lastcmperr);
+    mccm->lasterror = MC_DRV_ERR_UNKNOWN;
+    LOG_d("++++ LEFT mccmFinishGenerateAuthToken.");
     return false;
   }
 
-  memcpy(rsp,g_mccm.cmp,sizeof(*rsp));
+  memcpy(rsp,mccm->cmp,sizeof(*rsp));
 
 #ifdef _DEBUG
   LOG_d("CMP response is (hexdump):");
   GDMCHexDump((const unsigned char*)rsp,sizeof(*rsp));
 #endif
 
-  LOG_d("++++ LEFT mccmGenerateAuthToken.");
+  LOG_d("++++ LEFT mccmFinishGenerateAuthToken.");
   return true;
 }
 
@@ -260,14 +446,114 @@ static bool mccmGenerateAuthToken (
 // Convenience functions
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-gderror MCGetSUID ( _u8 *suid )
+// A trustlet call started by MCSubmitGetSUID or MCSubmitGenerateAuthToken
+// keeps its channel in the instance until MCGetSUID or MCGenerateAuthToken
+// pick up the response, or MCCancel discards it.
+
+static MCCM *mccmTakeSubmitted ( gdmcinst *inst, uint32_t cmd )
+{
+  MCCM                   *mccm = (MCCM*)inst->mccm;
+
+  if (NULL==mccm)
+    return NULL;
+
+  inst->mccm = NULL;
+
+  if (cmd==inst->mccmcmd)
+    return mccm;
+
+  // Some other call is in flight; its response is of no use.
+
+  mccmWait(mccm,MC_INFINITE_TIMEOUT);
+  mccmRelease(mccm);
+
+  return NULL;
+}
+
+void MCCancel ( gdmcinst *inst )
 {
-  if (unlikely( NULL==suid ))
+  mccmTakeSubmitted(inst,0);
+}
+
+bool MCSubmitGetSUID ( gdmcinst *inst )
+{
+  MCCM                   *mccm;
+
+  MCCancel(inst);
+
+  // Never wait for a channel here: the caller may hold the others with
+  // calls of its own in flight. MCGetSUID makes the call if this did not.
+
+  mccm = mccmAcquire(false);
+
+  if (NULL==mccm)
+    return false;
+
+  if (!mccmSubmitGetSuid(mccm))
+  {
+    mccmRelease(mccm);
+    return false;
+  }
+
+  inst->mccm    = mccm;
+  inst->mccmcmd = MC_CMP_CMD_GET_SUID;
+
+  return true;
+}
+
+bool MCSubmitGenerateAuthToken ( gdmcinst *inst, const gdmc_actmsg_req *req )
+{
+  MCCM                   *mccm;
+
+  MCCancel(inst);
+
+  if (MC_CMP_CMD_GENERATE_AUTH_TOKEN!=req->msg_type)
+    return false;
+
+  mccm = mccmAcquire(false);
+
+  if (NULL==mccm)
+    return false;
+
+  if (!mccmSubmitGenerateAuthToken(mccm,(const cmpCmdGenAuthToken_t *)req))
+  {
+    mccmRelease(mccm);
+    return false;
+  }
+
+  inst->mccm    = mccm;
+  inst->mccmcmd = MC_CMP_CMD_GENERATE_AUTH_TOKEN;
+
+  return true;
+}
+
+gderror MCGetSUID ( gdmcinst *inst, _u8 *suid )
+{
+  MCCM                   *mccm;
+  bool                    ok;
+
+  if (unlikely( NULL==inst || NULL==suid ))
     return GDERROR_PARAMETER;
 
   memset(suid,0,SUID_LENGTH);
 
-  if (!mccmGetSuid((mcSuid_t*)suid))
+  mccm = mccmTakeSubmitted(inst,MC_CMP_CMD_GET_SUID);
+
+  if (NULL!=mccm)
+    ok = mccmFinishGetSuid(mccm,(mcSuid_t*)suid);
+  else
+  {
+    mccm = mccmAcquire(true);
+
+    if (unlikely( NULL==mccm ))
+      return GDERROR_MOBICORE_LIBRARY;
+
+    ok = mccmSubmitGetSuid(mccm) && mccmFinishGetSuid(mccm,(mcSuid_t*)suid);
+  }
+
+  mccmRelease(mccm);
+
+  if (!ok)
     return GDERROR_CANT_GET_SUID;
 
   return GDERROR_OK;
@@ -276,6 +562,8 @@ gderror MCGetSUID ( _u8 *suid )
 gderror MCGenerateAuthToken ( gdmcinst *inst, const gdmc_actmsg_req *req, gdmc_so_authtok *authtok )
 {
   cmpRspGenAuthToken_t    rsp;
+  MCCM                   *mccm;
+  bool                    ok;
 
   if (unlikely( NULL==inst || NULL==req || NULL==authtok ))
     return GDERROR_PARAMETER;
@@ -283,9 +571,29 @@ gderror MCGenerateAuthToken ( gdmcinst *inst, const gdmc_actmsg_req *req, gdmc_s
   memset(authtok,0,sizeof(gdmc_so_authtok));
 
   if (MC_CMP_CMD_GENERATE_AUTH_TOKEN!=req->msg_type)
+  {
+    MCCancel(inst);
     return GDERROR_MESSAGE_FORMAT;
+  }
+
+  mccm = mccmTakeSubmitted(inst,MC_CMP_CMD_GENERATE_AUTH_TOKEN);
+
+  if (NULL!=mccm)
+    ok = mccmFinishGenerateAuthToken(mccm,&rsp);
+  else
+  {
+    mccm = mccmAcquire(true);
+
+    if (unlikely( NULL==mccm ))
+      return GDERROR_MOBICORE_LIBRARY;
+
+    ok = mccmSubmitGenerateAuthToken(mccm,(const cmpCmdGenAuthToken_t *)req) &&
+         mccmFinishGenerateAuthToken(mccm,&rsp);
+  }
+
+  mccmRelease(mccm);
 
-  if (!mccmGenerateAuthToken((const cmpCmdGenAuthToken_t *)req,&rsp))
+  if (!ok)
     return GDERROR_CANT_BUILD_AUTHTOKEN;
 
   memcpy(authtok,&rsp.soAuthCont,sizeof(*authtok));
@@ -0,0 +1,110 @@
+# =============================================================================
+#
+# CRC32 test vectors and throughput benchmark. The host builds cover the
+# slice-by-8 tables, the arm64 builds the ARMv8 CRC32 instructions too.
+# Provisioning throughput benchmark over libMcClientMock (host only).
+#
+# =============================================================================
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+# table-driven, exits non-zero on a mismatch
+LOCAL_MODULE      := gdmcprov_crc32_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_C_INCLUDES  := $(LOCAL_PATH)/../inc_private \
+                     $(LOCAL_PATH)/../inc_public
+
+LOCAL_SRC_FILES   := testCrc32.c \
+                     ../src/crc32.c
+
+LOCAL_CFLAGS      := -O2 -Wall -Werror -DLINUX -D_LENDIAN -D_64BIT
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE      := gdmcprov_crc32_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_MULTILIB    := 64
+
+LOCAL_C_INCLUDES  := $(LOCAL_PATH)/../inc_private \
+                     $(LOCAL_PATH)/../inc_public
+
+LOCAL_SRC_FILES   := testCrc32.c \
+                     ../src/crc32.c
+
+LOCAL_CFLAGS      := -O2 -Wall -Werror -DARM -D_LENDIAN -D_64BIT
+LOCAL_CFLAGS_arm64 := -march=armv8-a+crc
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# see benchCrc32.c for options
+LOCAL_MODULE      := gdmcprov_crc32_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_C_INCLUDES  := $(LOCAL_PATH)/../inc_private \
+                     $(LOCAL_PATH)/../inc_public
+
+LOCAL_SRC_FILES   := benchCrc32.c \
+                     ../src/crc32.c
+
+LOCAL_CFLAGS      := -O2 -Wall -Werror -DLINUX -D_LENDIAN -D_64BIT
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE      := gdmcprov_crc32_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_MULTILIB    := 64
+
+LOCAL_C_INCLUDES  := $(LOCAL_PATH)/../inc_private \
+                     $(LOCAL_PATH)/../inc_public
+
+LOCAL_SRC_FILES   := benchCrc32.c \
+                     ../src/crc32.c
+
+LOCAL_CFLAGS      := -O2 -Wall -Werror -DARM -D_LENDIAN -D_64BIT
+LOCAL_CFLAGS_arm64 := -march=armv8-a+crc
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# Provisioning throughput over libMcClientMock, exits non-zero if a device
+# fails; see benchProvisioning.c for options
+LOCAL_MODULE      := gdmcprov_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+# gdhandle is a 32 bit integer holding the instance pointer
+LOCAL_MULTILIB    := 32
+
+LOCAL_C_INCLUDES  := $(LOCAL_PATH)/../inc_private \
+                     $(LOCAL_PATH)/../inc_public \
+                     $(LOCAL_PATH)/../../common/MobiCore/inc \
+                     $(LOCAL_PATH)/../../common/MobiCore/inc/TlCm \
+                     $(LOCAL_PATH)/../../common/MobiCore/inc/TlCm/2.0 \
+                     $(LOCAL_PATH)/../../daemon/ClientLib/public \
+                     $(LOCAL_PATH)/../../daemon/ClientLib/Mock \
+                     $(LOCAL_PATH)/../../daemon/Registry/Public
+
+LOCAL_SRC_FILES   := benchProvisioning.c \
+                     ../src/gdmcprovlib.cpp \
+                     ../src/crc32.c \
+                     ../src/mobicore.c \
+                     ../src/gdmcdevicebinding.cpp
+
+LOCAL_CFLAGS      := -O2 -Wall -DANDROID_ARM -DARM -D_LENDIAN -D_32BIT \
+                     -DGDMCPROVLIB_VERSION=0x01000001 -D_NO_OPENSSL_INCLUDES
+
+LOCAL_SHARED_LIBRARIES := libMcClientMock liblog
+LOCAL_LDLIBS      := -lpthread
+
+include $(BUILD_HOST_EXECUTABLE)
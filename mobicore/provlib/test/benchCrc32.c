@@ -0,0 +1,131 @@
+///
+/// @file       benchCrc32.c
+///
+/// Throughput of the provlib CRC32 paths against the byte-at-a-time
+/// reference, in MB/s, for message sizes from a provisioning trailer up
+/// to a large container.
+///
+///   -s SIZE   only this buffer size (default: 64, 1k, 16k, 1M)
+///   -m MS     time spent per path and size (default 200)
+///
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gdmccrc32.h>
+#include "crc32ref.h"
+
+typedef _u32 (GDPROVAPI *crcpath) ( _u32 crc, const _u8 *data, _u32 length );
+
+static _u32 GDPROVAPI CalcCRC32RefPath ( _u32 crc, const _u8 *data, _u32 length )
+{
+  (void)crc;
+  return CalcCRC32Ref(data,length);
+}
+
+static const struct
+{
+  const char *name;
+  crcpath     calc;
+} paths[] =
+{
+  { "bytewise",       CalcCRC32RefPath },
+  { "slice-by-8",     CalcCRC32Sw },
+#if defined(__ARM_FEATURE_CRC32)
+  { "ARMv8 CRC32",    CalcCRC32Hw },
+#endif
+};
+
+static double nowSec ( void )
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// volatile, so the calls are not optimized out
+static volatile _u32 sink;
+
+static double measure ( crcpath calc, const _u8 *data, _u32 size, double seconds )
+{
+  double  start = nowSec();
+  double  elapsed;
+  _u64    bytes = 0;
+
+  do
+  {
+    int i;
+
+    for (i = 0; i < 16; i++)
+      sink = calc(0xFFFFFFFF,data,size);
+    bytes  += (_u64)size * 16;
+    elapsed = nowSec() - start;
+  } while (elapsed < seconds);
+
+  return bytes / elapsed / (1024.0 * 1024.0);
+}
+
+int main ( int argc, char *argv[] )
+{
+  static const _u32 defaultSizes[] = { 64, 1024, 16 * 1024, 1024 * 1024 };
+  _u32    sizes[4];
+  size_t  numSizes = 4;
+  double  seconds = 0.2;
+  _u8    *buffer;
+  size_t  s,p;
+  int     opt;
+
+  memcpy(sizes,defaultSizes,sizeof(sizes));
+  while ((opt = getopt(argc,argv,"s:m:")) != -1)
+  {
+    switch (opt)
+    {
+      case 's':
+        sizes[0] = (_u32)strtoul(optarg,NULL,0);
+        numSizes = 1;
+        break;
+      case 'm':
+        seconds = atoi(optarg) / 1000.0;
+        break;
+      default:
+        fprintf(stderr,"usage: %s [-s size] [-m ms]\n",argv[0]);
+        return 1;
+    }
+  }
+
+  InitCRCRefTable();
+
+  buffer = (_u8 *)malloc(1024 * 1024 + 1);
+  if (buffer == NULL)
+    return 1;
+  for (s = 0; s < 1024 * 1024 + 1; s++)
+    buffer[s] = (_u8)(s * 131);
+
+  printf("%-14s","MB/s");
+  for (s = 0; s < numSizes; s++)
+    printf(" %10u",sizes[s]);
+  printf("\n");
+
+  for (p = 0; p < sizeof(paths)/sizeof(paths[0]); p++)
+  {
+    printf("%-14s",paths[p].name);
+    for (s = 0; s < numSizes; s++)
+    {
+      if (sizes[s] > 1024 * 1024)
+      {
+        printf(" %10s","-");
+        continue;
+      }
+      // odd offset: the messages are not aligned in the protocol buffers
+      printf(" %10.0f",measure(paths[p].calc,buffer+1,sizes[s],seconds));
+    }
+    printf("\n");
+  }
+
+  free(buffer);
+  return 0;
+}
@@ -0,0 +1,412 @@
+///
+/// @file       benchProvisioning.c
+///
+/// Provisioning throughput of many instances (devices) over libMcClientMock
+/// and a content management trustlet model that answers GET_SUID and
+/// GENERATE_AUTH_TOKEN. Every instance runs the full sequence
+/// GETSUID -> GENAUTHTOKEN -> VALIDATEAUTHTOKEN, and its messages are
+/// checked (CRC, type, SUID, SO.AuthToken) as a production station would.
+///
+/// The instances are run three ways:
+///   sequential  GDMCProvExecuteProvisioningStep, one instance after the other
+///   threads     GDMCProvExecuteProvisioningStep from several threads
+///   pipelined   one thread submitting the steps of a batch of instances,
+///               then completing them, so the trustlet calls of the batch
+///               and the message checks overlap
+///
+/// The trustlet time is the simulated one given below, not a measurement;
+/// the mock lets the calls of different sessions run side by side.
+///
+///   -n COUNT  instances (default 64)
+///   -t COUNT  threads of the threaded run (default 4)
+///   -l US     simulated trustlet time per command (default 2000)
+///
+/// Exits non-zero if an instance does not complete provisioning.
+///
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gdmcprovlib.h>
+#include <gdmcprovprotocol.h>
+#include <McClientMock.h>
+
+/// as many instances as the library has MobiCore sessions
+#define BATCH       4
+#define MAX_MSGSIZE 1024
+
+typedef struct
+{
+  gdhandle          handle;
+  int               step;           ///< 0: GETSUID, 1: GENAUTHTOKEN, 2: VALIDATEAUTHTOKEN, 3: done
+  _u8               kSoCAuth[K_SOC_AUTH_LENGTH];
+  _u8               suid[SUID_LENGTH];
+  gdmc_so_authtok   authtok;
+  _u8               msgin[MAX_MSGSIZE];
+  _u32              msgin_size;
+  _u8               msgout[MAX_MSGSIZE];
+  _u32              msgout_size;
+  bool              failed;
+} device;
+
+static const _u8 kSuid[SUID_LENGTH] = { 0x53, 0x55, 0x49, 0x44, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+//////////////////////////////////////////////////////////////////////////////
+// Content management trustlet model
+//////////////////////////////////////////////////////////////////////////////
+
+static mcResult_t cmNotify ( void *ctx, uint32_t sessionId, uint8_t *tci, uint32_t tciLen )
+{
+  cmp_t                      *cmp = (cmp_t*)tci;
+  cmpGenAuthTokenCmdSdata_t   sdata;
+  cmpRspGenAuthToken_t       *rsp;
+
+  (void)ctx;
+  (void)sessionId;
+
+  if (tciLen<sizeof(cmp_t))
+    return MC_DRV_ERR_INVALID_PARAMETER;
+
+  switch (cmp->msg.commandHeader.commandId)
+  {
+    case MC_CMP_CMD_GET_SUID:
+      memset(cmp,0,sizeof(cmp_t));
+      cmp->msg.cmpRspGetSuid.rspHeader.responseId = MC_CMP_CMD_GET_SUID|RSP_ID_MASK;
+      cmp->msg.cmpRspGetSuid.rspHeader.returnCode = SUCCESSFUL;
+      memcpy(&cmp->msg.cmpRspGetSuid.suid,kSuid,SUID_LENGTH);
+      break;
+
+    case MC_CMP_CMD_GENERATE_AUTH_TOKEN:
+      // the token carries the SUID and K.SoC.Auth it was made for
+      sdata = cmp->msg.cmpCmdGenAuthToken.cmd.sdata;
+      memset(cmp,0,sizeof(cmp_t));
+      rsp = &cmp->msg.cmpRspGenAuthToken;
+      rsp->rsp.rspHeader.responseId = MC_CMP_CMD_GENERATE_AUTH_TOKEN|RSP_ID_MASK;
+      rsp->rsp.rspHeader.returnCode = SUCCESSFUL;
+      rsp->soAuthCont.coSoc.type    = CONT_TYPE_SOC;
+      memcpy(&rsp->soAuthCont.coSoc.suid,&sdata.suid,sizeof(mcSuid_t));
+      memcpy(&rsp->soAuthCont.coSoc.co.kSocAuth,&sdata.kSocAuth,sizeof(mcSymmetricKey_t));
+      break;
+
+    default:
+      cmp->msg.responseHeader.responseId = cmp->msg.commandHeader.commandId|RSP_ID_MASK;
+      cmp->msg.responseHeader.returnCode = RET_ERR_EXT_UNKNOWN_COMMAND;
+      break;
+  }
+
+  return MC_DRV_OK;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Production station side
+//////////////////////////////////////////////////////////////////////////////
+
+static _u32 composeMessage ( _u8 *msg, _u32 type, const void *body, _u32 body_size )
+{
+  _u32              aligned = (body_size+3)&(~3);
+  gdmc_msgheader   *header  = (gdmc_msgheader*)msg;
+  gdmc_msgtrailer  *trailer = (gdmc_msgtrailer*)(msg+sizeof(gdmc_msgheader)+aligned);
+  _u32              size    = sizeof(gdmc_msgheader)+aligned+sizeof(gdmc_msgtrailer);
+
+  memset(msg,0,size);
+  header->msg_type  = type;
+  header->body_size = body_size;
+  if (0!=body_size)
+    memcpy(msg+sizeof(gdmc_msgheader),body,body_size);
+  trailer->magic = ~type;
+  trailer->crc32 = CalcCRC32(msg,size-sizeof(_u32));
+
+  return size;
+}
+
+/// Builds the input message of the device's next step.
+static void nextRequest ( device *dev )
+{
+  gdmc_actmsg_req   req;
+
+  switch (dev->step)
+  {
+    case 0:
+      dev->msgin_size = composeMessage(dev->msgin,MC_GETSUID_REQ,NULL,0);
+      break;
+
+    case 1:
+      memset(&req,0,sizeof(req));
+      req.msg_type = MC_CMP_CMD_GENERATE_AUTH_TOKEN;
+      memcpy(req.suid,dev->suid,SUID_LENGTH);
+      memcpy(req.kSoCAuth,dev->kSoCAuth,K_SOC_AUTH_LENGTH);
+      req.kid = 1;
+      dev->msgin_size = composeMessage(dev->msgin,MC_GENAUTHTOKEN_REQ,&req,sizeof(req));
+      break;
+
+    default:
+      dev->msgin_size = composeMessage(dev->msgin,MC_VALIDATEAUTHTOKEN_REQ,&dev->authtok,sizeof(dev->authtok));
+      break;
+  }
+
+  dev->msgout_size = sizeof(dev->msgout);
+}
+
+/// Checks the output message of the device's step and moves it on.
+static void checkResponse ( device *dev, gderror error )
+{
+  gdmc_msgheader   *header  = (gdmc_msgheader*)dev->msgout;
+  _u8              *body    = dev->msgout+sizeof(gdmc_msgheader);
+  gdmc_actmsg_resp *resp    = (gdmc_actmsg_resp*)body;
+  gdmc_error_msg   *errmsg  = (gdmc_error_msg*)body;
+  gdmc_msgtrailer  *trailer;
+
+  if ((dev->msgout_size<sizeof(gdmc_msgheader)+sizeof(gdmc_msgtrailer)) ||
+      (dev->msgout_size>sizeof(dev->msgout)))
+  {
+    dev->failed = true;
+    return;
+  }
+
+  trailer = (gdmc_msgtrailer*)(dev->msgout+dev->msgout_size-sizeof(gdmc_msgtrailer));
+  if ((trailer->magic!=~header->msg_type) ||
+      (trailer->crc32!=CalcCRC32(dev->msgout,dev->msgout_size-sizeof(_u32))))
+  {
+    dev->failed = true;
+    return;
+  }
+
+  switch (dev->step)
+  {
+    case 0:
+      if ((GDERROR_OK!=error) || (MC_GETSUID_RESP!=header->msg_type) || memcmp(body,kSuid,SUID_LENGTH))
+        dev->failed = true;
+      memcpy(dev->suid,body,SUID_LENGTH);
+      break;
+
+    case 1:
+      if ((GDERROR_OK!=error) || (MC_GENAUTHTOKEN_RESP!=header->msg_type) ||
+          memcmp(resp->authtok.suid,dev->suid,SUID_LENGTH) ||
+          memcmp(resp->authtok.kSoCAuth,dev->kSoCAuth,K_SOC_AUTH_LENGTH))
+        dev->failed = true;
+      memcpy(&dev->authtok,&resp->authtok,sizeof(dev->authtok));
+      break;
+
+    default:
+      if ((GDERROR_PROVISIONING_DONE!=error) || (MC_ERROR!=header->msg_type) ||
+          (GDERROR_PROVISIONING_DONE!=errmsg->errorcode))
+        dev->failed = true;
+      break;
+  }
+
+  dev->step++;
+}
+
+static bool beginDevice ( device *dev, int index )
+{
+  memset(dev,0,sizeof(*dev));
+  memset(dev->kSoCAuth,index&0xFF,K_SOC_AUTH_LENGTH);
+  dev->kSoCAuth[0] = (_u8)(index>>8);
+
+  dev->failed = (GDERROR_OK!=GDMCProvBeginProvisioning(&dev->handle));
+  return !dev->failed;
+}
+
+static void provisionDevice ( device *dev, int index )
+{
+  if (!beginDevice(dev,index))
+    return;
+
+  while (!dev->failed && (dev->step<3))
+  {
+    nextRequest(dev);
+    checkResponse(dev,GDMCProvExecuteProvisioningStep(dev->handle,dev->msgin,dev->msgin_size,
+                                                      dev->msgout,&dev->msgout_size));
+  }
+
+  GDMCProvEndProvisioning(dev->handle);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Runs
+//////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  device           *devices;
+  int               first;
+  int               count;
+} share;
+
+static void *provisionShare ( void *arg )
+{
+  share            *sh = (share*)arg;
+  int               i;
+
+  for (i=sh->first;i<sh->first+sh->count;i++)
+    provisionDevice(&sh->devices[i],i);
+
+  return NULL;
+}
+
+static void runSequential ( device *devices, int count, int threads )
+{
+  share             sh = { devices, 0, count };
+
+  (void)threads;
+  provisionShare(&sh);
+}
+
+static void runThreads ( device *devices, int count, int threads )
+{
+  pthread_t        *tids   = (pthread_t*)calloc(threads,sizeof(pthread_t));
+  share            *shares = (share*)calloc(threads,sizeof(share));
+  int               first  = 0;
+  int               t;
+
+  for (t=0;t<threads;t++)
+  {
+    shares[t].devices = devices;
+    shares[t].first   = first;
+    shares[t].count   = (count-first)/(threads-t);
+    first            += shares[t].count;
+    pthread_create(&tids[t],NULL,provisionShare,&shares[t]);
+  }
+
+  for (t=0;t<threads;t++)
+    pthread_join(tids[t],NULL);
+
+  free(shares);
+  free(tids);
+}
+
+static void runPipelined ( device *devices, int count, int threads )
+{
+  int               first, i, n, step;
+
+  (void)threads;
+
+  for (first=0;first<count;first+=BATCH)
+  {
+    n = (count-first<BATCH)?count-first:BATCH;
+
+    for (i=first;i<first+n;i++)
+      beginDevice(&devices[i],i);
+
+    for (step=0;step<3;step++)
+    {
+      for (i=first;i<first+n;i++)
+      {
+        if (devices[i].failed)
+          continue;
+        nextRequest(&devices[i]);
+        if (GDERROR_OK!=GDMCProvSubmitProvisioningStep(devices[i].handle,devices[i].msgin,devices[i].msgin_size))
+          devices[i].failed = true;
+      }
+
+      // while these wait, the trustlet calls of the later devices go on
+      for (i=first;i<first+n;i++)
+      {
+        if (devices[i].failed)
+          continue;
+        checkResponse(&devices[i],GDMCProvCompleteProvisioningStep(devices[i].handle,devices[i].msgout,
+                                                                   &devices[i].msgout_size));
+      }
+    }
+
+    for (i=first;i<first+n;i++)
+    {
+      if (0!=devices[i].handle)
+        GDMCProvEndProvisioning(devices[i].handle);
+    }
+  }
+}
+
+static double nowSec ( void )
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool run ( const char *name, void (*fn)( device *, int, int ), int count, int threads )
+{
+  device           *devices = (device*)calloc(count,sizeof(device));
+  mcMockStats_t     stats;
+  double            start, elapsed;
+  int               failed = 0;
+  int               i;
+
+  mcMockResetStats();
+  start   = nowSec();
+  fn(devices,count,threads);
+  elapsed = nowSec()-start;
+  mcMockGetStats(&stats);
+
+  for (i=0;i<count;i++)
+  {
+    if (devices[i].failed || (3!=devices[i].step))
+      failed++;
+  }
+
+  printf("%-12s %8.1f ms %8.1f devices/s %6llu trustlet calls %3llu sessions %d failed\n",
+         name,elapsed*1e3,count/elapsed,
+         (unsigned long long)stats.notifications,(unsigned long long)stats.sessionsOpened,failed);
+
+  free(devices);
+  return 0==failed;
+}
+
+int main ( int argc, char *argv[] )
+{
+  const mcUuid_t    uuid    = TL_CM_UUID;
+  mcMockTa_t        ta;
+  int               count   = 64;
+  int               threads = 4;
+  _u32              latency = 2000;
+  bool              ok;
+  int               opt;
+
+  while ((opt = getopt(argc,argv,"n:t:l:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 't':
+        threads = atoi(optarg);
+        break;
+      case 'l':
+        latency = (_u32)atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,"usage: %s [-n devices] [-t threads] [-l trustlet us]\n",argv[0]);
+        return 2;
+    }
+  }
+  if (count<=0)
+    count = 1;
+  if (threads<=0)
+    threads = 1;
+
+  memset(&ta,0,sizeof(ta));
+  ta.onNotify  = cmNotify;
+  ta.latencyUs = latency;
+  mcMockRegisterTa(&uuid,&ta);
+
+  if (GDERROR_OK!=GDMCProvInitializeLibrary())
+  {
+    fprintf(stderr,"GDMCProvInitializeLibrary failed\n");
+    return 1;
+  }
+
+  printf("%d devices, %u us per trustlet command, %d threads\n",count,latency,threads);
+
+  ok = run("sequential",runSequential,count,threads);
+  ok = run("threads",runThreads,count,threads) && ok;
+  ok = run("pipelined",runPipelined,count,threads) && ok;
+
+  GDMCProvShutdownLibrary();
+  return ok?0:1;
+}
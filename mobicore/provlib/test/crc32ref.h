@@ -0,0 +1,57 @@
+///
+/// @file       crc32ref.h
+///
+/// The byte-at-a-time CRC32 that provlib shipped before the slice-by-8
+/// tables, including its bit-by-bit table generation; the reference
+/// testCrc32.c and benchCrc32.c compare the library against.
+///
+
+#ifndef _INC_CRC32REF_H_
+#define _INC_CRC32REF_H_
+
+#include <gdmcprovlib.h>
+
+static _u32 crcreftable[256];
+
+static _u32 reflect ( _u32 refl, _u8 c )
+{
+  int     i;
+  _u32    value = 0;
+
+  for (i = 1; i < (c + 1); i++)
+  {
+    if (refl & 1)
+      value |= ((_u32)1 << (c - i));
+    refl >>= 1;
+  }
+
+  return value;
+}
+
+static void InitCRCRefTable ( void )
+{
+  int       i,j;
+
+  for (i = 0; i <= 0xFF; i++)
+  {
+    crcreftable[i] = reflect(i, 8) << 24;
+
+    for (j = 0; j < 8; j++)
+      crcreftable[i] = (crcreftable[i] << 1)
+                     ^ ((crcreftable[i] & (1U << 31)) ? 0x04C11DB7 : 0);
+
+    crcreftable[i] = reflect(crcreftable[i], 32);
+  }
+}
+
+static _u32 CalcCRC32Ref ( const _u8 *data, _u32 length )
+{
+  _u32 crc = 0xFFFFFFFF;
+
+  while (length--)
+    crc = (crc>>8) ^ crcreftable[(crc&0xFF) ^ *data++];
+
+  return crc ^ 0xFFFFFFFF;
+}
+
+#endif // _INC_CRC32REF_H_
@@ -0,0 +1,83 @@
+# =============================================================================
+#
+# Host tests and benchmarks of the RootPA Common code, run over libMcClientMock
+# with the content management trustlet model and the in-memory registry from
+# Test/Common.
+#
+# =============================================================================
+
+LOCAL_PATH := $(call my-dir)
+
+ROOTPA_HOST_TEST_SRC_FILES := \
+    ../../../../Common/contentmanager.c \
+    ../../../../Common/pacmp3.c \
+    ../../../../Common/pacmtl.c \
+    ../../../../Common/trustletchannel.c \
+    ../../../../Common/registry.c \
+    ../../../../../Test/Common/cmtlMock.c \
+    ../../../../../Test/Common/registryMock.c
+
+ROOTPA_HOST_TEST_C_INCLUDES := \
+    $(MOBICORE_DIR_INC) \
+    $(MOBICORE_PROJECT_PATH)/daemon/ClientLib/Mock \
+    $(LOCAL_PATH)/../../../../Common \
+    $(LOCAL_PATH)/../../../../Common/include \
+    $(LOCAL_PATH)/../../../../../Test/Common
+
+include $(CLEAR_VARS)
+
+# exits non-zero on a failed case
+LOCAL_MODULE      := rootpa_cmtl_session_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES   := $(ROOTPA_HOST_TEST_SRC_FILES) \
+                     ../../../../../Test/Common/testCmtlSession.c
+LOCAL_C_INCLUDES  := $(ROOTPA_HOST_TEST_C_INCLUDES)
+
+LOCAL_CFLAGS      := -DANDROID -Wall -Wno-unused-parameter -Wno-sign-compare
+# short enough for the test to watch the reaper close an idle session
+LOCAL_CFLAGS      += -DCMTL_IDLE_TIMEOUT_MS=300
+
+LOCAL_SHARED_LIBRARIES := libMcClientMock liblog
+LOCAL_LDLIBS      := -lpthread
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# exits non-zero on a failed case
+LOCAL_MODULE      := rootpa_registry_cache_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES   := ../../../../Common/registry.c \
+                     ../../../../../Test/Common/registryMock.c \
+                     ../../../../../Test/Common/testRegistryCache.c
+LOCAL_C_INCLUDES  := $(ROOTPA_HOST_TEST_C_INCLUDES)
+
+LOCAL_CFLAGS      := -DANDROID -Wall -Wno-unused-parameter -Wno-sign-compare
+# short enough for the test to watch a cached miss expire
+LOCAL_CFLAGS      += -DREG_CACHE_MISS_TTL_MS=200
+
+LOCAL_LDLIBS      := -lpthread
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# see benchStatusQueries.c for options
+LOCAL_MODULE      := rootpa_status_query_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES   := $(ROOTPA_HOST_TEST_SRC_FILES) \
+                     ../../../../../Test/Common/benchStatusQueries.c
+LOCAL_C_INCLUDES  := $(ROOTPA_HOST_TEST_C_INCLUDES)
+
+LOCAL_CFLAGS      := -DANDROID -O2 -Wall -Wno-unused-parameter -Wno-sign-compare
+
+LOCAL_SHARED_LIBRARIES := libMcClientMock liblog
+LOCAL_LDLIBS      := -lpthread
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -96,8 +96,12 @@ public abstract class BaseService extends Service {
 
             if(result==true && openSession==true && sessionOpened_==false){
                 Log.d(TAG,"BaseService.acquireLock, openingSession");
-                commonPAWrapper().openSession();
-                sessionOpened_=true;
+                int ret=commonPAWrapper().openSession();
+                if(ret==CommandResult.ROOTPA_OK){
+                    sessionOpened_=true;
+                }else{
+                    Log.e(TAG,"BaseService.acquireLock, openSession failed "+ret);
+                }
             }
 
             if(timer_!=null){
@@ -59,14 +59,17 @@ rootpaerror_t executeCmpCommands(int numberOfCommands, CmpMessage* commandsP, Cm
     LOGD("<<executeCmpCommands");
 }
 
+// the reference taken for the client lock, only released by closeSessionToCmtl
+static bool lockSession_=false;
+
 rootpaerror_t openSessionToCmtl()
 {
-    return openCmtlSession();
+    return openFreshCmtlSession(&lockSession_);
 }
 
 void closeSessionToCmtl()
 {
-    closeCmtlSession();
+    closeCmtlSession(&lockSession_);
 }
 
 rootpaerror_t getVersion(int* tag, mcVersionInfo_t* versionP)
@@ -255,54 +258,22 @@ rootpaerror_t getSpContainerState(mcSpid_t spid, mcContainerState_t* stateP)
     return ret;
 }
 
-bool containerExists(mcUuid_t uuid)
-{
-    return (memcmp(&uuid, &MC_UUID_FREE, sizeof(mcUuid_t))!=0);
-}
-
 rootpaerror_t  getSpContainerStructure(mcSpid_t spid, SpContainerStructure* spContainerStructure)
 {
     LOGD(">>getSpContainerStructure");
     rootpaerror_t ret=ROOTPA_OK;
 
     if(NULL==spContainerStructure) return ROOTPA_ERROR_ILLEGAL_ARGUMENT;
-    memset(spContainerStructure, 0xFF, sizeof(SpContainerStructure));
-    spContainerStructure->nbrOfTlts=0;
 
-    SPCONTAINERP spP=NULL;
-    uint32_t spContSize=0;
-    mcResult_t result=regReadSp(spid, &spP, &spContSize);
+    int tltResult=MC_DRV_OK;
+    mcResult_t result=regGetSpStructure(spid, spContainerStructure, &tltResult);
 
     if(MC_DRV_OK == result)
     {
-        spContainerStructure->state=spP->cont.attribs.state;
-
-        int i;
-
-        for(i=0; i<MC_CONT_CHILDREN_COUNT; i++)
+        if(tltResult != MC_DRV_OK)
         {
-            if(containerExists(spP->cont.children[i]))
-            {
-                memcpy(&spContainerStructure->tltContainers[spContainerStructure->nbrOfTlts].uuid, &(spP->cont.children[i]), sizeof(mcUuid_t));
-                TLTCONTAINERP tltP=NULL;
-                if(ROOTPA_OK == ret)
-                {
-                    uint32_t tltContSize=0;
-                    result=regReadTlt(&spP->cont.children[i], &tltP, &tltContSize, spid);
-                    if(MC_DRV_OK == result)
-                    {
-                        spContainerStructure->tltContainers[spContainerStructure->nbrOfTlts].state=((mcTltContCommon_t*)(((uint8_t*)tltP)+sizeof(mcSoHeader_t)))->attribs.state;
-                        spContainerStructure->nbrOfTlts++;
-                    }
-                    else
-                    {
-                        LOGE("getSpContainerStructure regReadTlt %d returned an error %d", i, result);
-                        ret=ROOTPA_ERROR_REGISTRY;
-                    }
-                    free(tltP);
-                    tltP=NULL;
-                }
-            }
+            LOGE("getSpContainerStructure regReadTlt %d returned an error %d", spContainerStructure->nbrOfTlts, tltResult);
+            ret=ROOTPA_ERROR_REGISTRY;
         }
     }
     else if(MC_DRV_ERR_INVALID_DEVICE_FILE == result)
@@ -314,7 +285,6 @@ rootpaerror_t  getSpContainerStructure(mcSpid_t spid, SpContainerStructure* spCo
         ret=ROOTPA_ERROR_REGISTRY;
     }
 
-    free(spP);
     LOGD("<<getSpContainerStructure nr: %d st: %d ret: %d",spContainerStructure->nbrOfTlts, spContainerStructure->state, ret );
     return ret;
 }
@@ -346,7 +316,8 @@ void* provisioningThreadFunction(void* paramsP)
     LOGD(">>provisioningThreadFunction %ld", (long int)((provisioningparams_t*)paramsP)->callbackP);
 
     rootpaerror_t ret=ROOTPA_OK;
-    if((ret=openCmtlSession())==ROOTPA_OK)
+    bool reference=false;
+    if((ret=openFreshCmtlSession(&reference))==ROOTPA_OK)
     {
         doProvisioningWithSe(((provisioningparams_t*)paramsP)->spid,
                              ((provisioningparams_t*)paramsP)->suid,
@@ -355,7 +326,7 @@ void* provisioningThreadFunction(void* paramsP)
                              getVersion,
                              ((provisioningparams_t*)paramsP)->initialRel,
 							 ((provisioningparams_t*)paramsP)->tltInstallationDataP);
-        closeCmtlSession();
+        closeCmtlSession(&reference);
     }
     else
     {
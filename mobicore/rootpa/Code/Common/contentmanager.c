@@ -31,6 +31,8 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
 #include <MobiCoreDriverApi.h>
 
 #include "tools.h"
@@ -41,114 +43,326 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "trustletchannel.h"
 #include "contentmanager.h"
 
-static CMTHANDLE handle_=NULL;
+/*
+The session to the content management trustlet is kept open across calls. openCmtlSession and
+closeCmtlSession only take and release a reference; when the last reference is released the
+session (and its WSM) stays open for CMTL_IDLE_TIMEOUT_MS so that bursts of status queries
+do not pay for mcOpenDevice/mcMallocWsm/mcOpenSession each time. A reaper thread closes the
+session once it has been idle for long enough.
+
+Commands that change the CMTL authentication state (the client lock and doProvisioning) must not
+inherit it from an earlier client, so openFreshCmtlSession waits for the session to be unused
+and opens a new one. Such a session, like one that failed to transmit, is closed rather than
+kept warm when its last reference is released.
+
+Every open sets the caller's reference flag only when it took a reference, and closeCmtlSession
+releases one only when that flag is set, clearing it. A caller whose open failed, or that closes
+twice, therefore cannot release a reference that someone else still uses. openCmtlSession with
+the flag set takes no second reference; openFreshCmtlSession drops it before waiting.
+*/
 
-void closeCmtlSession()
+static CMTHANDLE handle_=NULL;
+static int handleRefs_=0;
+static bool handleBroken_=false;
+static bool handleFresh_=false;
+static int freshWaiters_=0;
+static bool reaperRunning_=false;
+static struct timespec idleDeadline_;
+
+static pthread_mutex_t handleLock_=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t handleIdle_=PTHREAD_COND_INITIALIZER;
+static pthread_cond_t handleReleased_=PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t commandLock_=PTHREAD_MUTEX_INITIALIZER;
+
+static void closeChannelLocked()
 {
     tltChannelClose(handle_);
     handle_=NULL;
+    handleBroken_=false;
+    handleFresh_=false;
 }
 
-rootpaerror_t openCmtlSession()
+static bool idleDeadlinePassed()
 {
-    mcResult_t error=0;
-    rootpaerror_t ret=ROOTPA_OK;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (now.tv_sec > idleDeadline_.tv_sec ||
+           (now.tv_sec == idleDeadline_.tv_sec && now.tv_nsec >= idleDeadline_.tv_nsec));
+}
+
+static void* cmtlReaperThreadFunction(void* unusedP)
+{
+    (void) unusedP;
+    pthread_mutex_lock(&handleLock_);
+    while(handle_!=NULL && 0==handleRefs_)
+    {
+        if(idleDeadlinePassed())
+        {
+            LOGD("cmtl reaper: closing idle session");
+            closeChannelLocked();
+            break;
+        }
+        pthread_cond_timedwait(&handleIdle_, &handleLock_, &idleDeadline_);
+    }
+    reaperRunning_=false;
+    pthread_mutex_unlock(&handleLock_);
+    return NULL;
+}
+
+static void deadlineAfter(struct timespec* deadlineP, long timeoutMs)
+{
+    clock_gettime(CLOCK_REALTIME, deadlineP);
+    deadlineP->tv_sec += timeoutMs/1000;
+    deadlineP->tv_nsec += (timeoutMs%1000)*1000000L;
+    if(deadlineP->tv_nsec >= 1000000000L)
+    {
+        deadlineP->tv_sec++;
+        deadlineP->tv_nsec -= 1000000000L;
+    }
+}
+
+static void startIdleTimerLocked()
+{
+    deadlineAfter(&idleDeadline_, CMTL_IDLE_TIMEOUT_MS);
+
+    if(reaperRunning_)
+    {
+        pthread_cond_signal(&handleIdle_);
+        return;
+    }
+
+    pthread_t reaperThread;
+    pthread_attr_t attributes;
+    if(pthread_attr_init(&attributes)!=0)
+    {
+        closeChannelLocked();
+        return;
+    }
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if(pthread_create(&reaperThread, &attributes, cmtlReaperThreadFunction, NULL)!=0)
+    {
+        LOGE("unable to create cmtl reaper thread, closing session now");
+        closeChannelLocked();
+    }
+    else
+    {
+        reaperRunning_=true;
+    }
+    pthread_attr_destroy(&attributes);
+}
+
+static void releaseLocked(bool* referenceP)
+{
+    if(!*referenceP)
+    {
+        return;
+    }
+    *referenceP=false;
+    handleRefs_--;
 
-    if(handle_)
+    if(0==handleRefs_ && handle_!=NULL)
+    {
+        if(handleBroken_ || handleFresh_ || 0==CMTL_IDLE_TIMEOUT_MS)
+        {
+            closeChannelLocked();
+        }
+        else
+        {
+            startIdleTimerLocked();
+        }
+    }
+    if(0==handleRefs_)
     {
-        closeCmtlSession();
+        pthread_cond_broadcast(&handleReleased_);
     }
-    
+}
+
+void closeCmtlSession(bool* referenceP)
+{
+    pthread_mutex_lock(&handleLock_);
+    releaseLocked(referenceP);
+    pthread_mutex_unlock(&handleLock_);
+}
+
+static rootpaerror_t openChannelLocked()
+{
+    mcResult_t error=0;
+
     handle_=tltChannelOpen(sizeOfCmp(), &error);
     if(NULL==handle_)
     {
         if(MC_DRV_ERR_NO_FREE_MEMORY==error)
         {
-            ret=ROOTPA_ERROR_OUT_OF_MEMORY;
+            return ROOTPA_ERROR_OUT_OF_MEMORY;
         }
-        else
+        return ROOTPA_ERROR_MOBICORE_CONNECTION;
+    }
+    return ROOTPA_OK;
+}
+
+rootpaerror_t openCmtlSession(bool* referenceP)
+{
+    rootpaerror_t ret=ROOTPA_OK;
+
+    pthread_mutex_lock(&handleLock_);
+    if(*referenceP)
+    {
+        // already holds one
+        pthread_mutex_unlock(&handleLock_);
+        return ROOTPA_OK;
+    }
+    while(freshWaiters_>0)
+    {
+        // let a pending lock or doProvisioning get its fresh session first, then share it
+        pthread_cond_wait(&handleReleased_, &handleLock_);
+    }
+
+    if(handle_ && handleBroken_)
+    {
+        if(handleRefs_>0)
         {
-            ret=ROOTPA_ERROR_MOBICORE_CONNECTION;
+            // still in use by whoever saw it fail, it is replaced once they let go of it
+            pthread_mutex_unlock(&handleLock_);
+            return ROOTPA_ERROR_MOBICORE_CONNECTION;
+        }
+        closeChannelLocked();
+    }
+
+    if(NULL==handle_)
+    {
+        ret=openChannelLocked();
+    }
+
+    if(ROOTPA_OK==ret)
+    {
+        handleRefs_++;
+        *referenceP=true;
+    }
+    pthread_mutex_unlock(&handleLock_);
+    return ret;
+}
+
+rootpaerror_t openFreshCmtlSession(bool* referenceP)
+{
+    rootpaerror_t ret=ROOTPA_OK;
+    struct timespec deadline;
+
+    deadlineAfter(&deadline, NOTIFICATION_WAIT_TIMEOUT_MS);
+
+    pthread_mutex_lock(&handleLock_);
+    // a reference the caller still holds would keep it waiting for itself
+    releaseLocked(referenceP);
+    freshWaiters_++;
+    while(handleRefs_>0 && ROOTPA_OK==ret)
+    {
+        if(pthread_cond_timedwait(&handleReleased_, &handleLock_, &deadline)!=0 && handleRefs_>0)
+        {
+            LOGE("openFreshCmtlSession: cmtl session still in use");
+            ret=ROOTPA_ERROR_LOCK;
+        }
+    }
+
+    if(ROOTPA_OK==ret)
+    {
+        if(handle_)
+        {
+            closeChannelLocked();
+        }
+
+        ret=openChannelLocked();
+        if(ROOTPA_OK==ret)
+        {
+            handleFresh_=true;
+            handleRefs_++;
+            *referenceP=true;
         }
-    }    
+    }
+    freshWaiters_--;
+    pthread_cond_broadcast(&handleReleased_);
+    pthread_mutex_unlock(&handleLock_);
     return ret;
 }
 
 rootpaerror_t executeOneCmpCommand(CMTHANDLE handle, CmpMessage* commandP, CmpMessage* responseP);
 
 rootpaerror_t executeContentManagementCommands(int numberOfCommands, CmpMessage* commandsP, CmpMessage* responsesP, uint32_t* internalError)
-{    
+{
     LOGD(">>executeContentManagementCommands");
     rootpaerror_t ret=ROOTPA_OK ;
     rootpaerror_t iRet=ROOTPA_OK ;
-    bool selfOpened=false;
-    
+    bool reference=false;
+
     *internalError=0;
 
-    if(handle_==NULL)
+    // doProvisioning and the client lock hold a reference to their own fresh session already; for
+    // commands that do not require the lock this only takes another reference to the (possibly
+    // still warm) session.
+
+    if((ret=openCmtlSession(&reference))!=ROOTPA_OK)
     {
-        // doProvisioining opens session earlier. Lock opens and closes session when called by client
-        // this is for commands that do not require the client to call the lock.
+        LOGE("no handle %d", ret);
+        return ret;
+    }
+
+    pthread_mutex_lock(&commandLock_);
+    pthread_mutex_lock(&handleLock_);
+    CMTHANDLE handle=handleBroken_?NULL:handle_;
+    pthread_mutex_unlock(&handleLock_);
 
-        ret=openCmtlSession();
-        selfOpened=true;
+    if(NULL==handle)
+    {
+        // another command broke the session while this one was waiting for it
+        pthread_mutex_unlock(&commandLock_);
+        closeCmtlSession(&reference);
+        LOGE("<<executeContentManagementCommands, session broken");
+        return ROOTPA_ERROR_MOBICORE_CONNECTION;
     }
-    CMTHANDLE handle=handle_; 
-    
-    if (handle)
+
+    int i;
+    for(i=0; i<numberOfCommands;i++)
     {
-        int i;
-        for(i=0; i<numberOfCommands;i++)
+        responsesP[i].hdr.id=commandsP[i].hdr.id; // match the id;
+        responsesP[i].hdr.ignoreError=commandsP[i].hdr.ignoreError;
+
+        if(commandsP[i].length>0)
         {
-            responsesP[i].hdr.id=commandsP[i].hdr.id; // match the id;
-            responsesP[i].hdr.ignoreError=commandsP[i].hdr.ignoreError;
-            
-            if(commandsP[i].length>0)
+            if(((iRet=executeOneCmpCommand(handle, &commandsP[i], &responsesP[i]))!=ROOTPA_OK))
             {
-                if(((iRet=executeOneCmpCommand(handle, &commandsP[i], &responsesP[i]))!=ROOTPA_OK))
+                // returning actual error in case of the command failed
+                ret=iRet;
+                if(ROOTPA_OK==responsesP[i].hdr.ret)
                 {
-                    // returning actual error in case of the command failed
-                    ret=iRet;
-                    if(ROOTPA_OK==responsesP[i].hdr.ret)
-                    {
-                        responsesP[i].hdr.ret=ret;
-                    }
-                    
-                    if(commandsP[i].hdr.ignoreError==false)
-                    {
-                        LOGE("executeContentManagementCommands, ignoreError==false, returning %d", ret);
-                        return ret;
-                    }
+                    responsesP[i].hdr.ret=ret;
                 }
-            }
-            else
-            {
-                LOGE("executeContentManagementCommands, empty command");
-            }            
-        }
 
-        if(ret!=ROOTPA_OK)
-        {
-            *internalError = handle->lasterror;
-        }
-    }
-    else
-    {
-        LOGE("no handle %d", *internalError);
-        if(MC_DRV_ERR_NO_FREE_MEMORY == *internalError)
-        {
-            ret=ROOTPA_ERROR_OUT_OF_MEMORY;
+                if(ROOTPA_ERROR_MOBICORE_CONNECTION==iRet)
+                {
+                    // do not keep a session around that failed to transmit
+                    pthread_mutex_lock(&handleLock_);
+                    handleBroken_=true;
+                    pthread_mutex_unlock(&handleLock_);
+                }
+
+                if(commandsP[i].hdr.ignoreError==false)
+                {
+                    LOGE("executeContentManagementCommands, ignoreError==false, returning %d", ret);
+                    break;
+                }
+            }
         }
         else
         {
-            ret=ROOTPA_ERROR_MOBICORE_CONNECTION;
+            LOGE("executeContentManagementCommands, empty command");
         }
     }
 
-    if(selfOpened)
+    if(ret!=ROOTPA_OK)
     {
-        closeCmtlSession();
+        *internalError = handle->lasterror;
     }
+    pthread_mutex_unlock(&commandLock_);
+
+    closeCmtlSession(&reference);
 
     LOGD("<<executeContentManagementCommands %d", ret);
     return ret;
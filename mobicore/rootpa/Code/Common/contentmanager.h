@@ -35,11 +35,16 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rootpa.h"
 
 #define NOTIFICATION_WAIT_TIMEOUT_MS 3000 // wait for 3 seconds max
+#ifndef CMTL_IDLE_TIMEOUT_MS
+#define CMTL_IDLE_TIMEOUT_MS 5000 // keep an unused cmtl session open for 5 seconds, 0 closes it immediately
+#endif
 
 rootpaerror_t executeContentManagementCommands(int numberOfCommands, CmpMessage* commandsP, CmpMessage* responsesP, uint32_t* internalError);
 rootpaerror_t uploadSo(uint8_t* containerDataP, uint32_t containerLength, uint32_t* regRetP);
-rootpaerror_t openCmtlSession();
-void closeCmtlSession();
+// the open functions set *referenceP when they took a reference, close releases it only then
+rootpaerror_t openCmtlSession(bool* referenceP);
+rootpaerror_t openFreshCmtlSession(bool* referenceP);
+void closeCmtlSession(bool* referenceP);
 
 
 #endif // CONTENTMANAGER_H
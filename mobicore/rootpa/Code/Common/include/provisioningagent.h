@@ -46,7 +46,8 @@ extern "C" {
 /**
 since the CMP commands that require authentication need to be executed during
 the same session the actual authentication, the client needs to handle opening
-and closing the session before
+and closing the session before. closeSessionToCmtl only releases a session that
+openSessionToCmtl returned ROOTPA_OK for, and only once.
 */
 rootpaerror_t openSessionToCmtl();
 void closeSessionToCmtl();
@@ -30,68 +30,272 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include <MobiCoreRegistry.h>
 #include "registry.h"
 
+/*
+In-process cache of registry containers. The status queries coming from the Android service
+read the same few containers over and over, so the result of each mcRegistryRead* (including
+"no such container") is remembered here, keyed by container type, spid and uuid. Every write,
+cleanup or delete done through this file drops the whole cache once the registry call returns,
+so the cache never returns anything RootPA itself has changed. "No such container" is only
+remembered for REG_CACHE_MISS_TTL_MS, since containers may also appear through other processes.
+Callers still get their own malloc'ed copy.
+*/
+
+typedef enum {
+    REG_CACHE_AUTHTOKEN=1,
+    REG_CACHE_ROOT=2,
+    REG_CACHE_SP=3,
+    REG_CACHE_TLT=4
+} regCacheType_t;
+
+typedef struct
+{
+    regCacheType_t type;    // 0 for unused entries
+    mcSpid_t spid;
+    mcUuid_t uuid;
+    int result;             // result of the registry read
+    uint32_t size;          // size of the container, valid if result is MC_DRV_OK
+    uint8_t* dataP;         // copy of the container, valid if result is MC_DRV_OK and size>0
+    uint32_t lastUsed;
+    uint64_t expiresMs;     // when a failed read is tried again, valid if result is not MC_DRV_OK
+} regCacheEntry_t;
+
+#define REG_CACHE_ENTRIES (MC_CONT_CHILDREN_COUNT+4)
+#ifndef REG_CACHE_MISS_TTL_MS
+#define REG_CACHE_MISS_TTL_MS 1000
+#endif
+
+static regCacheEntry_t regCache_[REG_CACHE_ENTRIES];
+static uint32_t regCacheClock_=0;
+static pthread_mutex_t regCacheLock_=PTHREAD_MUTEX_INITIALIZER;
+
+static bool cacheKeyMatches(const regCacheEntry_t* entryP, regCacheType_t type, mcSpid_t spid, const mcUuid_t* uuidP)
+{
+    if(entryP->type!=type) return false;
+    if((REG_CACHE_SP==type || REG_CACHE_TLT==type) && entryP->spid!=spid) return false;
+    if(REG_CACHE_TLT==type && memcmp(&entryP->uuid, uuidP, sizeof(mcUuid_t))!=0) return false;
+    return true;
+}
+
+static void cacheDropEntry(regCacheEntry_t* entryP)
+{
+    free(entryP->dataP);
+    memset(entryP, 0, sizeof(regCacheEntry_t));
+}
+
+static uint64_t nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec*1000 + now.tv_nsec/1000000;
+}
+
+static regCacheEntry_t* cacheFind(regCacheType_t type, mcSpid_t spid, const mcUuid_t* uuidP)
+{
+    int i;
+    for(i=0; i<REG_CACHE_ENTRIES; i++)
+    {
+        if(cacheKeyMatches(&regCache_[i], type, spid, uuidP))
+        {
+            if(regCache_[i].result!=MC_DRV_OK && nowMs() >= regCache_[i].expiresMs)
+            {
+                cacheDropEntry(&regCache_[i]);
+                return NULL;
+            }
+            regCache_[i].lastUsed=++regCacheClock_;
+            return &regCache_[i];
+        }
+    }
+    return NULL;
+}
+
+static void cacheInvalidateAll(void)
+{
+    int i;
+    for(i=0; i<REG_CACHE_ENTRIES; i++)
+    {
+        cacheDropEntry(&regCache_[i]);
+    }
+}
+
+/*
+Read a container either from the cache or from the registry. On success *containerPP is either
+a pointer into the cache (if copy is false, only valid while the lock is held) or a malloc'ed copy.
+*/
+static int cacheRead(regCacheType_t type, mcSpid_t spid, const mcUuid_t* uuidP, bool copy, void** containerPP, uint32_t* containerSize)
+{
+    regCacheEntry_t* entryP=cacheFind(type, spid, uuidP);
+
+    if(NULL==entryP)
+    {
+        uint8_t* bufferP=malloc(CONTAINER_BUFFER_SIZE);
+        uint32_t size=CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
+        int result;
+
+        if(NULL==bufferP) return MC_DRV_ERR_NO_FREE_MEMORY;
+
+        switch(type)
+        {
+            case REG_CACHE_AUTHTOKEN:
+                result=mcRegistryReadAuthToken((mcSoAuthTokenCont_t*) bufferP, &size);
+                break;
+            case REG_CACHE_ROOT:
+                result=mcRegistryReadRoot((mcSoRootCont_t*) bufferP, &size);
+                break;
+            case REG_CACHE_SP:
+                result=mcRegistryReadSp(spid, (mcSoSpCont_t*) bufferP, &size);
+                break;
+            default:
+                result=mcRegistryReadTrustletCon(uuidP, spid, (mcSoTltCont_t*) bufferP, &size);
+                break;
+        }
+
+        if(result!=MC_DRV_OK && result!=MC_DRV_ERR_INVALID_DEVICE_FILE)
+        {
+            // transient error, do not remember it
+            free(bufferP);
+            return result;
+        }
+
+        // pick an unused entry, or the least recently used one
+
+        int i;
+        entryP=&regCache_[0];
+        for(i=0; i<REG_CACHE_ENTRIES; i++)
+        {
+            if(0==regCache_[i].type)
+            {
+                entryP=&regCache_[i];
+                break;
+            }
+            if(regCache_[i].lastUsed < entryP->lastUsed)
+            {
+                entryP=&regCache_[i];
+            }
+        }
+        cacheDropEntry(entryP);
+
+        entryP->type=type;
+        entryP->spid=spid;
+        if(uuidP) memcpy(&entryP->uuid, uuidP, sizeof(mcUuid_t));
+        entryP->result=result;
+        entryP->lastUsed=++regCacheClock_;
+        if(MC_DRV_OK==result && size>0)
+        {
+            entryP->dataP=realloc(bufferP, size);
+            if(NULL==entryP->dataP) entryP->dataP=bufferP;
+            entryP->size=size;
+        }
+        else
+        {
+            // an empty container is cached without data, dataP stays NULL
+            free(bufferP);
+            entryP->expiresMs=nowMs()+REG_CACHE_MISS_TTL_MS;
+        }
+    }
+
+    if(entryP->result!=MC_DRV_OK) return entryP->result;
+
+    if(!copy)
+    {
+        *containerPP=entryP->dataP;
+        *containerSize=entryP->size;
+        return MC_DRV_OK;
+    }
+
+    // keep handing out CONTAINER_BUFFER_SIZE buffers like the registry read used to do
+    if(*containerSize < entryP->size) return MC_DRV_ERR_INVALID_PARAMETER;
+    if(entryP->size>0) memcpy(*containerPP, entryP->dataP, entryP->size);
+    *containerSize=entryP->size;
+    return MC_DRV_OK;
+}
+
+static int cachedRead(regCacheType_t type, mcSpid_t spid, const mcUuid_t* uuidP, void** containerPP, uint32_t* containerSize)
+{
+    *containerSize = CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
+    *containerPP=malloc(CONTAINER_BUFFER_SIZE);
+    if(NULL==*containerPP) return MC_DRV_ERR_NO_FREE_MEMORY;
+
+    pthread_mutex_lock(&regCacheLock_);
+    int ret=cacheRead(type, spid, uuidP, true, containerPP, containerSize);
+    pthread_mutex_unlock(&regCacheLock_);
+    return ret;
+}
+
+void regInvalidateCache(void)
+{
+    pthread_mutex_lock(&regCacheLock_);
+    cacheInvalidateAll();
+    pthread_mutex_unlock(&regCacheLock_);
+}
+
 // AuthToken
 int regWriteAuthToken(const AUTHTOKENCONTAINERP atP, uint32_t containerSize)
 {
-    return mcRegistryStoreAuthToken(atP, containerSize);
+    int ret=mcRegistryStoreAuthToken(atP, containerSize);
+    regInvalidateCache();
+    return ret;
 }
 
 int regReadAuthToken(AUTHTOKENCONTAINERP* atP, uint32_t* containerSize)
 {
-    *containerSize = CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
-    *atP=malloc(CONTAINER_BUFFER_SIZE);
-    if(NULL==*atP) return MC_DRV_ERR_NO_FREE_MEMORY;
-    return mcRegistryReadAuthToken(*atP, containerSize);
+    return cachedRead(REG_CACHE_AUTHTOKEN, 0, NULL, (void**) atP, containerSize);
 }
 
 int regDeleteAuthToken(void)
 {
-    return mcRegistryDeleteAuthToken();
+    int ret=mcRegistryDeleteAuthToken();
+    regInvalidateCache();
+    return ret;
 }
 
 // Root
 
 int regReadRoot(ROOTCONTAINERP* rootP, uint32_t* containerSize)
 {
-    *containerSize = CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
-    *rootP=malloc(CONTAINER_BUFFER_SIZE);
-    if(NULL==*rootP) return MC_DRV_ERR_NO_FREE_MEMORY;
-    return mcRegistryReadRoot(*rootP, containerSize);
+    return cachedRead(REG_CACHE_ROOT, 0, NULL, (void**) rootP, containerSize);
 }
 
 
 int regWriteRoot(const ROOTCONTAINERP rootP, uint32_t containerSize)
 {
-    return mcRegistryStoreRoot(rootP, containerSize);
+    int ret=mcRegistryStoreRoot(rootP, containerSize);
+    regInvalidateCache();
+    return ret;
 }
 
 
 int regCleanupRoot(void)
 {
-    return mcRegistryCleanupRoot();
+    int ret=mcRegistryCleanupRoot();
+    regInvalidateCache();
+    return ret;
 }
 
 // sp
 
 int regReadSp(mcSpid_t spid, SPCONTAINERP* spP, uint32_t* containerSize)
 {
-    *containerSize = CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
-    *spP=malloc(CONTAINER_BUFFER_SIZE);
-    if(NULL==*spP) return MC_DRV_ERR_NO_FREE_MEMORY;
-    return mcRegistryReadSp(spid, *spP, containerSize);
+    return cachedRead(REG_CACHE_SP, spid, NULL, (void**) spP, containerSize);
 }
 
 int regWriteSp(mcSpid_t spid, const SPCONTAINERP spP, uint32_t containerSize)
 {
-    return mcRegistryStoreSp(spid, spP, containerSize);
+    int ret=mcRegistryStoreSp(spid, spP, containerSize);
+    regInvalidateCache();
+    return ret;
 }
 
 int regCleanupSp(mcSpid_t spid)
 {
-    return mcRegistryCleanupSp(spid);
+    int ret=mcRegistryCleanupSp(spid);
+    regInvalidateCache();
+    return ret;
 }
 
 
@@ -99,13 +303,65 @@ int regGetSpState(mcSpid_t spid, mcContainerState_t* stateP)
 {
     SPCONTAINERP spP=NULL;
     uint32_t containerSize=0;
-    containerSize = CONTAINER_BUFFER_SIZE; // this will be updated to actual size with the registry call
-    int ret=regReadSp(spid, &spP, &containerSize);
+
+    pthread_mutex_lock(&regCacheLock_);
+    int ret=cacheRead(REG_CACHE_SP, spid, NULL, false, (void**) &spP, &containerSize);
+    if(MC_DRV_OK==ret && containerSize < sizeof(mcSoHeader_t)+sizeof(mcSpCont_t))
+    {
+        ret=MC_DRV_ERR_INVALID_PARAMETER;
+    }
     if(MC_DRV_OK==ret)
     {
         *stateP=spP->cont.attribs.state;
     }
-    free(spP);
+    pthread_mutex_unlock(&regCacheLock_);
+    return ret;
+}
+
+int regGetSpStructure(mcSpid_t spid, SpContainerStructure* structureP, int* tltResultP)
+{
+    SPCONTAINERP spP=NULL;
+    uint32_t containerSize=0;
+
+    memset(structureP, 0xFF, sizeof(SpContainerStructure));
+    structureP->nbrOfTlts=0;
+    *tltResultP=MC_DRV_OK;
+
+    pthread_mutex_lock(&regCacheLock_);
+    int ret=cacheRead(REG_CACHE_SP, spid, NULL, false, (void**) &spP, &containerSize);
+    if(MC_DRV_OK==ret && containerSize < sizeof(mcSoHeader_t)+sizeof(mcSpCont_t))
+    {
+        ret=MC_DRV_ERR_INVALID_PARAMETER;
+    }
+    if(MC_DRV_OK==ret)
+    {
+        mcUuidChild_t children;
+        int i;
+
+        // the sp entry may get evicted while its trustlets are read
+        structureP->state=spP->cont.attribs.state;
+        memcpy(children, spP->cont.children, sizeof(children));
+
+        for(i=0; i<MC_CONT_CHILDREN_COUNT && MC_DRV_OK==*tltResultP; i++)
+        {
+            if(0==memcmp(&children[i], &MC_UUID_FREE, sizeof(mcUuid_t))) continue;
+
+            TltContainerData* tltDataP=&structureP->tltContainers[structureP->nbrOfTlts];
+            TLTCONTAINERP tltP=NULL;
+            memcpy(&tltDataP->uuid, &children[i], sizeof(mcUuid_t));
+            *tltResultP=cacheRead(REG_CACHE_TLT, spid, &children[i], false, (void**) &tltP, &containerSize);
+            if(MC_DRV_OK==*tltResultP && containerSize < sizeof(mcSoHeader_t)+sizeof(mcTltContCommon_t))
+            {
+                *tltResultP=MC_DRV_ERR_INVALID_PARAMETER;
+            }
+            if(MC_DRV_OK==*tltResultP)
+            {
+                tltDataP->state=((mcTltContCommon_t*)(((uint8_t*)tltP)+sizeof(mcSoHeader_t)))->attribs.state;
+                structureP->nbrOfTlts++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&regCacheLock_);
     return ret;
 }
 
@@ -114,18 +370,19 @@ int regGetSpState(mcSpid_t spid, mcContainerState_t* stateP)
 
 int regReadTlt(const mcUuid_t* uuidP, TLTCONTAINERP* tltP, uint32_t* containerSize, mcSpid_t spid)
 {
-    *containerSize = CONTAINER_BUFFER_SIZE; // this will be update to actual size with the registry call
-    *tltP=malloc(CONTAINER_BUFFER_SIZE);
-    if(NULL==*tltP) return MC_DRV_ERR_NO_FREE_MEMORY;
-    return mcRegistryReadTrustletCon(uuidP, spid, *tltP, containerSize);
+    return cachedRead(REG_CACHE_TLT, spid, uuidP, (void**) tltP, containerSize);
 }
 
 int regWriteTlt(const mcUuid_t* uuidP, const TLTCONTAINERP tltP, uint32_t containerSize, mcSpid_t spid)
 {
-    return mcRegistryStoreTrustletCon(uuidP, spid, tltP, containerSize);
+    int ret=mcRegistryStoreTrustletCon(uuidP, spid, tltP, containerSize);
+    regInvalidateCache();
+    return ret;
 }
 
 int regCleanupTlt(const mcUuid_t* uuidP, mcSpid_t spid)
 {
-    return mcRegistryCleanupTrustlet(uuidP, spid);
+    int ret=mcRegistryCleanupTrustlet(uuidP, spid);
+    regInvalidateCache();
+    return ret;
 }
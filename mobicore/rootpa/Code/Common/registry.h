@@ -30,6 +30,7 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <mcContainer.h>
+#include "rootpa.h"
 
 #define CONTAINER_BUFFER_SIZE 4096
 
@@ -59,6 +60,19 @@ int regCleanupSp(mcSpid_t spid);
 
 int regGetSpState(mcSpid_t spid, mcContainerState_t* stateP);
 
+/**
+Fills in the state of the sp container and of all of its trustlet containers in one pass over
+the registry cache. Returns the result of reading the sp container, *tltResultP is set to the
+result of the first trustlet container read that failed (MC_DRV_OK if none did).
+*/
+int regGetSpStructure(mcSpid_t spid, SpContainerStructure* structureP, int* tltResultP);
+
 int regReadTlt(const mcUuid_t* uuidP, TLTCONTAINERP* tltP, uint32_t* containerSize, mcSpid_t spid);
 int regWriteTlt(const mcUuid_t* uuidP, const TLTCONTAINERP tltP, uint32_t containerSize, mcSpid_t spid);
 int regCleanupTlt(const mcUuid_t* uuidP, mcSpid_t spid);
+
+/**
+Drops all containers cached by the reg* functions. Every write, cleanup and delete above calls it
+after the registry call; call it as well when the registry is modified by something else.
+*/
+void regInvalidateCache(void);
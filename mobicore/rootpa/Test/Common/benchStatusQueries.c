@@ -0,0 +1,244 @@
+/*
+Host benchmark of RootPA status queries over libMcClientMock and the CMTL model in cmtlMock.c.
+
+Runs a burst of MC_CMP_CMD_GET_VERSION queries through executeContentManagementCommands, once
+with a session opened and closed around every query (what RootPA did before the session was
+kept warm, and still does for the lock and doProvisioning) and once on the warm session.
+
+Then runs the same number of getSpContainerStructure style queries against an sp container with
+a few trustlet containers in the in-memory registry, once reading every container from the
+registry as RootPA did before registry.c cached them, and once through regGetSpStructure.
+
+The trustlet load, command and registry read costs are the simulated ones given below, not
+measurements.
+
+Options:
+  -n <count>    queries per run (default 1000)
+  -o <us>       simulated trustlet load time per session open (default 3000)
+  -l <us>       simulated world switch time per command (default 200)
+  -r <us>       simulated time per registry read (default 100)
+  -t <count>    trustlet containers of the sp (default 4)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <MobiCoreDriverApi.h>
+#include <MobiCoreRegistry.h>
+#include <TlCm/3.0/tlCmApi.h>
+
+#include "contentmanager.h"
+#include "registry.h"
+#include "cmtlMock.h"
+#include "registryMock.h"
+
+#define SPID 0x1234
+
+static double nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static rootpaerror_t statusQuery(void)
+{
+    uint32_t commandId=MC_CMP_CMD_GET_VERSION;
+    uint32_t internalError=0;
+    CmpMessage command;
+    CmpMessage response;
+
+    memset(&command, 0, sizeof(command));
+    memset(&response, 0, sizeof(response));
+    command.contentP=(uint8_t*) &commandId;
+    command.length=sizeof(commandId);
+
+    rootpaerror_t ret=executeContentManagementCommands(1, &command, &response, &internalError);
+    free(response.contentP);
+    return ret;
+}
+
+static bool runQueries(const char* name, int count, bool sessionPerQuery)
+{
+    cmtlMockStats_t stats;
+    bool reference=false;
+    int failed=0;
+    int i;
+
+    cmtlMockResetStats();
+    double start=nowSec();
+    for(i=0; i<count; i++)
+    {
+        if(sessionPerQuery && openFreshCmtlSession(&reference)!=ROOTPA_OK)
+        {
+            failed++;
+            continue;
+        }
+        if(statusQuery()!=ROOTPA_OK)
+        {
+            failed++;
+        }
+        if(sessionPerQuery)
+        {
+            closeCmtlSession(&reference);
+        }
+    }
+    double elapsed=nowSec()-start;
+    cmtlMockGetStats(&stats);
+
+    printf("%-20s %8.1f ms %8.1f us/query %6u sessions %d failed\n", name,
+           elapsed*1e3, elapsed*1e6/count, stats.sessionsOpened, failed);
+    return 0==failed;
+}
+
+/*
+What getSpContainerStructure did before registry.c cached the containers: a registry read for
+the sp container and one for each of its trustlet containers, into fresh buffers every time.
+*/
+static int uncachedSpStructure(mcSpid_t spid, SpContainerStructure* structureP)
+{
+    uint32_t size=CONTAINER_BUFFER_SIZE;
+    SPCONTAINERP spP=malloc(CONTAINER_BUFFER_SIZE);
+    int ret;
+    int i;
+
+    if(NULL==spP) return MC_DRV_ERR_NO_FREE_MEMORY;
+    memset(structureP, 0xFF, sizeof(SpContainerStructure));
+    structureP->nbrOfTlts=0;
+
+    ret=mcRegistryReadSp(spid, spP, &size);
+    if(MC_DRV_OK==ret)
+    {
+        structureP->state=spP->cont.attribs.state;
+        for(i=0; i<MC_CONT_CHILDREN_COUNT && MC_DRV_OK==ret; i++)
+        {
+            if(0==memcmp(&spP->cont.children[i], &MC_UUID_FREE, sizeof(mcUuid_t))) continue;
+
+            TLTCONTAINERP tltP=malloc(CONTAINER_BUFFER_SIZE);
+            if(NULL==tltP)
+            {
+                ret=MC_DRV_ERR_NO_FREE_MEMORY;
+                break;
+            }
+            size=CONTAINER_BUFFER_SIZE;
+            ret=mcRegistryReadTrustletCon(&spP->cont.children[i], spid, tltP, &size);
+            if(MC_DRV_OK==ret)
+            {
+                structureP->tltContainers[structureP->nbrOfTlts].state=((mcTltContCommon_t*)(((uint8_t*)tltP)+sizeof(mcSoHeader_t)))->attribs.state;
+                structureP->nbrOfTlts++;
+            }
+            free(tltP);
+        }
+    }
+    free(spP);
+    return ret;
+}
+
+static void storeSp(int numTlts)
+{
+    mcSoSpCont_t sp;
+    mcSoTltCont_2_1_t tlt;
+    int i;
+
+    memset(&sp, 0, sizeof(sp));
+    memset(&tlt, 0, sizeof(tlt));
+    sp.cont.attribs.state=MC_CONT_STATE_ACTIVATED;
+    for(i=0; i<MC_CONT_CHILDREN_COUNT; i++)
+    {
+        sp.cont.children[i]=MC_UUID_FREE;
+        if(i<numTlts)
+        {
+            memset(&sp.cont.children[i], 0, sizeof(mcUuid_t));
+            sp.cont.children[i].value[15]=(uint8_t) (i+1);
+            regWriteTlt(&sp.cont.children[i], (TLTCONTAINERP) &tlt, sizeof(tlt), SPID);
+        }
+    }
+    regWriteSp(SPID, &sp, sizeof(sp));
+}
+
+static bool runSpStructure(const char* name, int count, int numTlts, bool cached)
+{
+    SpContainerStructure structure;
+    int tltResult=MC_DRV_OK;
+    int failed=0;
+    int i;
+
+    regInvalidateCache();
+    uint32_t reads=registryMockReads();
+    double start=nowSec();
+    for(i=0; i<count; i++)
+    {
+        int ret=cached?regGetSpStructure(SPID, &structure, &tltResult):uncachedSpStructure(SPID, &structure);
+        if(ret!=MC_DRV_OK || tltResult!=MC_DRV_OK || structure.nbrOfTlts!=numTlts)
+        {
+            failed++;
+        }
+    }
+    double elapsed=nowSec()-start;
+
+    printf("%-20s %8.1f ms %8.1f us/query %6u reads %d failed\n", name,
+           elapsed*1e3, elapsed*1e6/count, registryMockReads()-reads, failed);
+    return 0==failed;
+}
+
+int main(int argc, char* argv[])
+{
+    int count=1000;
+    uint32_t openLatencyUs=3000;
+    uint32_t commandLatencyUs=200;
+    uint32_t readLatencyUs=100;
+    int numTlts=4;
+    int opt;
+
+    while((opt=getopt(argc, argv, "n:o:l:r:t:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                count=atoi(optarg);
+                break;
+            case 'o':
+                openLatencyUs=(uint32_t) atoi(optarg);
+                break;
+            case 'l':
+                commandLatencyUs=(uint32_t) atoi(optarg);
+                break;
+            case 'r':
+                readLatencyUs=(uint32_t) atoi(optarg);
+                break;
+            case 't':
+                numTlts=atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n queries] [-o open us] [-l command us] [-r read us] [-t trustlets]\n", argv[0]);
+                return 2;
+        }
+    }
+    if(count<=0)
+    {
+        count=1;
+    }
+    if(numTlts<0 || numTlts>MC_CONT_CHILDREN_COUNT)
+    {
+        numTlts=MC_CONT_CHILDREN_COUNT;
+    }
+
+    cmtlMockRegister(openLatencyUs, commandLatencyUs);
+    printf("%d GET_VERSION queries, %u us per session open, %u us per command\n",
+           count, openLatencyUs, commandLatencyUs);
+
+    bool ok=runQueries("session per query", count, true);
+    ok=runQueries("warm session", count, false) && ok;
+
+    storeSp(numTlts);
+    registryMockSetReadLatency(readLatencyUs);
+    printf("%d sp structure queries, %d trustlets, %u us per registry read\n",
+           count, numTlts, readLatencyUs);
+
+    ok=runSpStructure("registry reads", count, numTlts, false) && ok;
+    ok=runSpStructure("registry cache", count, numTlts, true) && ok;
+    return ok?0:1;
+}
@@ -0,0 +1,138 @@
+/*
+Host model of the content management trustlet, see cmtlMock.h.
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <MobiCoreDriverApi.h>
+#include <McClientMock.h>
+#include <TlCm/tlCmUuid.h>
+#include <TlCm/3.0/tlCmApi.h>
+#include <TlCm/tlCmError.h>
+#include "pacmtl.h"
+
+#include "cmtlMock.h"
+
+static cmtlMockStats_t stats_;
+static uint32_t openLatencyUs_=0;
+static bool fail_=false;
+static pthread_mutex_t statsLock_=PTHREAD_MUTEX_INITIALIZER;
+
+static mcResult_t cmtlOnOpen(void* ctx, uint32_t sessionId, uint8_t* tci, uint32_t tciLen)
+{
+    (void) ctx; (void) sessionId; (void) tci; (void) tciLen;
+
+    if(openLatencyUs_!=0)
+    {
+        usleep(openLatencyUs_);
+    }
+    pthread_mutex_lock(&statsLock_);
+    stats_.sessionsOpened++;
+    stats_.sessionsLive++;
+    pthread_mutex_unlock(&statsLock_);
+    return MC_DRV_OK;
+}
+
+static void cmtlOnClose(void* ctx, uint32_t sessionId)
+{
+    (void) ctx; (void) sessionId;
+
+    pthread_mutex_lock(&statsLock_);
+    stats_.sessionsLive--;
+    pthread_mutex_unlock(&statsLock_);
+}
+
+static mcResult_t cmtlOnNotify(void* ctx, uint32_t sessionId, uint8_t* tci, uint32_t tciLen)
+{
+    (void) ctx;
+
+    pthread_mutex_lock(&statsLock_);
+    stats_.commands++;
+    stats_.lastSessionId=sessionId;
+    bool fail=fail_;
+    pthread_mutex_unlock(&statsLock_);
+
+    if(fail)
+    {
+        return MC_DRV_ERR_UNKNOWN;
+    }
+    if(tciLen < sizeof(cmpResponseHeaderTci_t)+sizeof(cmpMapOffsetInfo_t))
+    {
+        return MC_DRV_ERR_INVALID_PARAMETER;
+    }
+
+    cmpCommandHeaderTci_t cmd;
+    memcpy(&cmd, tci, sizeof(cmd));
+
+    uint8_t* mappedP=mcMockResolve(sessionId, (uint32_t)(uintptr_t) cmd.mapInfo.addr, cmd.mapInfo.len);
+    if(NULL==mappedP || cmd.cmpCmdMapOffsetInfo.offset+sizeof(cmpRspGetVersion_t) > cmd.mapInfo.len)
+    {
+        return MC_DRV_ERR_INVALID_PARAMETER;
+    }
+
+    cmpResponseHeaderTci_t* rspHeaderP=(cmpResponseHeaderTci_t*) tci;
+    cmpMapOffsetInfo_t* elementP=(cmpMapOffsetInfo_t*)(tci+sizeof(cmpResponseHeaderTci_t));
+    uint8_t* rspP=mappedP+cmd.cmpCmdMapOffsetInfo.offset;
+
+    if(MC_CMP_CMD_GET_VERSION==cmd.commandId)
+    {
+        cmpRspGetVersion_t* versionP=(cmpRspGetVersion_t*) rspP;
+        memset(versionP, 0, sizeof(*versionP));
+        versionP->rspHeader.responseId=RSP_ID(cmd.commandId);
+        versionP->rspHeader.returnCode=SUCCESSFUL;
+        versionP->tag=CMP_VERSION_TAG2;
+        strncpy(versionP->data.versionData2.versionInfo.productId, "t-base-CMTL-MOCK", MC_PRODUCT_ID_LEN-1);
+        elementP->len=sizeof(*versionP);
+    }
+    else
+    {
+        cmpResponseHeader_t* headerP=(cmpResponseHeader_t*) rspP;
+        headerP->responseId=RSP_ID(cmd.commandId);
+        headerP->returnCode=RET_ERR_EXT_UNKNOWN_COMMAND;
+        elementP->len=sizeof(*headerP);
+    }
+    elementP->offset=cmd.cmpCmdMapOffsetInfo.offset;
+
+    rspHeaderP->version=CMP_VERSION;
+    rspHeaderP->responseId=RSP_ID(cmd.commandId);
+    rspHeaderP->len=0;
+    return MC_DRV_OK;
+}
+
+void cmtlMockRegister(uint32_t openLatencyUs, uint32_t commandLatencyUs)
+{
+    const mcUuid_t uuid=TL_CM_UUID;
+    mcMockTa_t ta;
+
+    memset(&ta, 0, sizeof(ta));
+    ta.onNotify=cmtlOnNotify;
+    ta.onOpen=cmtlOnOpen;
+    ta.onClose=cmtlOnClose;
+    ta.latencyUs=commandLatencyUs;
+    openLatencyUs_=openLatencyUs;
+    mcMockRegisterTa(&uuid, &ta);
+}
+
+void cmtlMockFail(bool fail)
+{
+    pthread_mutex_lock(&statsLock_);
+    fail_=fail;
+    pthread_mutex_unlock(&statsLock_);
+}
+
+void cmtlMockGetStats(cmtlMockStats_t* statsP)
+{
+    pthread_mutex_lock(&statsLock_);
+    *statsP=stats_;
+    pthread_mutex_unlock(&statsLock_);
+}
+
+void cmtlMockResetStats(void)
+{
+    pthread_mutex_lock(&statsLock_);
+    uint32_t live=stats_.sessionsLive;
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.sessionsLive=live;
+    pthread_mutex_unlock(&statsLock_);
+}
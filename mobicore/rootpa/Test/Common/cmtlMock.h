@@ -0,0 +1,35 @@
+/*
+Host model of the content management trustlet for the RootPA tests and benchmarks, registered
+with libMcClientMock under TL_CM_UUID. It answers MC_CMP_CMD_GET_VERSION like the real CMTL and
+fails every other command with a CMP error, which is all the status queries need.
+*/
+
+#ifndef CMTLMOCK_H
+#define CMTLMOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t sessionsOpened;
+    uint32_t sessionsLive;
+    uint32_t commands;
+    uint32_t lastSessionId;     // session the last command came in on
+} cmtlMockStats_t;
+
+/**
+Registers the model. openLatencyUs is slept in every session open (loading the trustlet),
+commandLatencyUs in every command on top of the mock's world switch.
+*/
+void cmtlMockRegister(uint32_t openLatencyUs, uint32_t commandLatencyUs);
+
+/**
+While set, every command makes the trustlet exit, as if it had crashed.
+*/
+void cmtlMockFail(bool fail);
+
+void cmtlMockGetStats(cmtlMockStats_t* statsP);
+void cmtlMockResetStats(void);
+
+#endif // CMTLMOCK_H
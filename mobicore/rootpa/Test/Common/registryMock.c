@@ -0,0 +1,204 @@
+/*
+In-memory stand-in for libMcRegistry, see registryMock.h.
+*/
+
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <MobiCoreRegistry.h>
+
+#include "registryMock.h"
+
+#define MOCK_CONTAINERS     64
+#define MOCK_CONTAINER_SIZE 4096
+
+typedef enum {
+    MOCK_AUTHTOKEN=1,
+    MOCK_ROOT,
+    MOCK_SP,
+    MOCK_TLT
+} mockType_t;
+
+typedef struct
+{
+    mockType_t type;    // 0 for unused slots
+    mcSpid_t spid;
+    mcUuid_t uuid;
+    uint32_t size;
+    uint8_t data[MOCK_CONTAINER_SIZE];
+} mockContainer_t;
+
+static mockContainer_t containers_[MOCK_CONTAINERS];
+static uint32_t readLatencyUs_=0;
+static uint32_t reads_=0;
+static pthread_mutex_t lock_=PTHREAD_MUTEX_INITIALIZER;
+
+static bool matches(const mockContainer_t* cP, mockType_t type, mcSpid_t spid, const mcUuid_t* uuidP)
+{
+    if(cP->type!=type) return false;
+    if((MOCK_SP==type || MOCK_TLT==type) && cP->spid!=spid) return false;
+    if(MOCK_TLT==type && memcmp(&cP->uuid, uuidP, sizeof(mcUuid_t))!=0) return false;
+    return true;
+}
+
+static mcResult_t storeContainer(mockType_t type, mcSpid_t spid, const mcUuid_t* uuidP, const void* soP, uint32_t size)
+{
+    mockContainer_t* freeP=NULL;
+    int i;
+
+    if(NULL==soP || size>MOCK_CONTAINER_SIZE) return MC_DRV_ERR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&lock_);
+    for(i=0; i<MOCK_CONTAINERS; i++)
+    {
+        if(matches(&containers_[i], type, spid, uuidP))
+        {
+            freeP=&containers_[i];
+            break;
+        }
+        if(NULL==freeP && 0==containers_[i].type)
+        {
+            freeP=&containers_[i];
+        }
+    }
+    if(freeP!=NULL)
+    {
+        freeP->type=type;
+        freeP->spid=spid;
+        if(uuidP) memcpy(&freeP->uuid, uuidP, sizeof(mcUuid_t));
+        freeP->size=size;
+        memcpy(freeP->data, soP, size);
+    }
+    pthread_mutex_unlock(&lock_);
+    return (freeP!=NULL)?MC_DRV_OK:MC_DRV_ERR_NO_FREE_MEMORY;
+}
+
+static mcResult_t readContainer(mockType_t type, mcSpid_t spid, const mcUuid_t* uuidP, void* soP, uint32_t* sizeP)
+{
+    mcResult_t ret=MC_DRV_ERR_INVALID_DEVICE_FILE;
+    int i;
+
+    if(NULL==soP || NULL==sizeP) return MC_DRV_ERR_INVALID_PARAMETER;
+    if(readLatencyUs_!=0) usleep(readLatencyUs_);
+
+    pthread_mutex_lock(&lock_);
+    reads_++;
+    for(i=0; i<MOCK_CONTAINERS; i++)
+    {
+        if(matches(&containers_[i], type, spid, uuidP))
+        {
+            if(*sizeP < containers_[i].size)
+            {
+                ret=MC_DRV_ERR_INVALID_PARAMETER;
+                break;
+            }
+            memcpy(soP, containers_[i].data, containers_[i].size);
+            *sizeP=containers_[i].size;
+            ret=MC_DRV_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+    return ret;
+}
+
+static mcResult_t cleanupContainers(mockType_t type, mcSpid_t spid, const mcUuid_t* uuidP)
+{
+    int i;
+
+    pthread_mutex_lock(&lock_);
+    for(i=0; i<MOCK_CONTAINERS; i++)
+    {
+        // like the real registry, removing a container removes everything below it
+        if(matches(&containers_[i], type, spid, uuidP) ||
+           (MOCK_SP==type && MOCK_TLT==containers_[i].type && containers_[i].spid==spid) ||
+           (MOCK_ROOT==type && (MOCK_SP==containers_[i].type || MOCK_TLT==containers_[i].type)))
+        {
+            memset(&containers_[i], 0, sizeof(containers_[i]));
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+    return MC_DRV_OK;
+}
+
+void registryMockSetReadLatency(uint32_t latencyUs)
+{
+    readLatencyUs_=latencyUs;
+}
+
+uint32_t registryMockReads(void)
+{
+    pthread_mutex_lock(&lock_);
+    uint32_t reads=reads_;
+    pthread_mutex_unlock(&lock_);
+    return reads;
+}
+
+void registryMockClear(void)
+{
+    pthread_mutex_lock(&lock_);
+    memset(containers_, 0, sizeof(containers_));
+    reads_=0;
+    pthread_mutex_unlock(&lock_);
+}
+
+mcResult_t mcRegistryStoreAuthToken(void* so, uint32_t size)
+{
+    return storeContainer(MOCK_AUTHTOKEN, 0, NULL, so, size);
+}
+
+mcResult_t mcRegistryReadAuthToken(void* so, uint32_t* size)
+{
+    return readContainer(MOCK_AUTHTOKEN, 0, NULL, so, size);
+}
+
+mcResult_t mcRegistryDeleteAuthToken(void)
+{
+    return cleanupContainers(MOCK_AUTHTOKEN, 0, NULL);
+}
+
+mcResult_t mcRegistryStoreRoot(void* so, uint32_t size)
+{
+    return storeContainer(MOCK_ROOT, 0, NULL, so, size);
+}
+
+mcResult_t mcRegistryReadRoot(void* so, uint32_t* size)
+{
+    return readContainer(MOCK_ROOT, 0, NULL, so, size);
+}
+
+mcResult_t mcRegistryCleanupRoot(void)
+{
+    return cleanupContainers(MOCK_ROOT, 0, NULL);
+}
+
+mcResult_t mcRegistryStoreSp(mcSpid_t spid, void* so, uint32_t size)
+{
+    return storeContainer(MOCK_SP, spid, NULL, so, size);
+}
+
+mcResult_t mcRegistryReadSp(mcSpid_t spid, void* so, uint32_t* size)
+{
+    return readContainer(MOCK_SP, spid, NULL, so, size);
+}
+
+mcResult_t mcRegistryCleanupSp(mcSpid_t spid)
+{
+    return cleanupContainers(MOCK_SP, spid, NULL);
+}
+
+mcResult_t mcRegistryStoreTrustletCon(const mcUuid_t* uuid, const mcSpid_t spid, void* so, uint32_t size)
+{
+    return storeContainer(MOCK_TLT, spid, uuid, so, size);
+}
+
+mcResult_t mcRegistryReadTrustletCon(const mcUuid_t* uuid, const mcSpid_t spid, void* so, uint32_t* size)
+{
+    return readContainer(MOCK_TLT, spid, uuid, so, size);
+}
+
+mcResult_t mcRegistryCleanupTrustlet(const mcUuid_t* uuid, const mcSpid_t spid)
+{
+    return cleanupContainers(MOCK_TLT, spid, uuid);
+}
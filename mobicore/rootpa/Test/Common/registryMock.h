@@ -0,0 +1,26 @@
+/*
+In-memory stand-in for libMcRegistry for the RootPA host tests and benchmarks. Missing containers
+read as MC_DRV_ERR_INVALID_DEVICE_FILE, like a missing file in the real registry.
+*/
+
+#ifndef REGISTRYMOCK_H
+#define REGISTRYMOCK_H
+
+#include <stdint.h>
+
+/**
+Simulated cost of every mcRegistryRead*, the real ones open and read a file each time.
+*/
+void registryMockSetReadLatency(uint32_t latencyUs);
+
+/**
+Number of mcRegistryRead* calls since the last registryMockClear.
+*/
+uint32_t registryMockReads(void);
+
+/**
+Forgets all containers and zeroes the read counter.
+*/
+void registryMockClear(void);
+
+#endif // REGISTRYMOCK_H
@@ -0,0 +1,233 @@
+/*
+Host test of the content management trustlet session handling in contentmanager.c, over
+libMcClientMock and the CMTL model in cmtlMock.c. Built with a short CMTL_IDLE_TIMEOUT_MS so the
+idle reaper can be seen at work. Each case starts with no session open and checks which trustlet
+sessions the status queries, the client lock and doProvisioning end up on. Exits non-zero if a
+case fails.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <MobiCoreDriverApi.h>
+#include <TlCm/3.0/tlCmApi.h>
+
+#include "contentmanager.h"
+#include "cmtlMock.h"
+
+#define CHECK(cond) \
+    do { if(!(cond)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); return false; } } while(0)
+
+static rootpaerror_t statusQuery(void)
+{
+    uint32_t commandId=MC_CMP_CMD_GET_VERSION;
+    uint32_t internalError=0;
+    CmpMessage command;
+    CmpMessage response;
+
+    memset(&command, 0, sizeof(command));
+    memset(&response, 0, sizeof(response));
+    command.contentP=(uint8_t*) &commandId;
+    command.length=sizeof(commandId);
+
+    rootpaerror_t ret=executeContentManagementCommands(1, &command, &response, &internalError);
+    if(ROOTPA_OK==ret && response.length!=sizeof(cmpRspGetVersion_t))
+    {
+        ret=ROOTPA_ERROR_INTERNAL;
+    }
+    free(response.contentP);
+    return ret;
+}
+
+// the reference the cases take themselves, as the client lock does
+static bool reference_=false;
+
+static cmtlMockStats_t stats(void)
+{
+    cmtlMockStats_t s;
+    cmtlMockGetStats(&s);
+    return s;
+}
+
+static bool sharedQueries(void)
+{
+    int i;
+    for(i=0; i<100; i++)
+    {
+        CHECK(statusQuery()==ROOTPA_OK);
+    }
+    CHECK(stats().sessionsOpened==1);
+    CHECK(stats().sessionsLive==1);
+    CHECK(stats().commands==100);
+    return true;
+}
+
+static bool idleReaped(void)
+{
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().sessionsLive==1);
+    usleep((CMTL_IDLE_TIMEOUT_MS+200)*1000);
+    CHECK(stats().sessionsLive==0);
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().sessionsOpened==2);
+    return true;
+}
+
+static bool lockGetsFreshSession(void)
+{
+    CHECK(statusQuery()==ROOTPA_OK);
+    uint32_t warmSession=stats().lastSessionId;
+
+    // the lock must not inherit whatever an earlier client did on the warm session
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+    CHECK(stats().sessionsOpened==2);
+    CHECK(stats().sessionsLive==1);
+
+    CHECK(statusQuery()==ROOTPA_OK);
+    uint32_t lockSession=stats().lastSessionId;
+    CHECK(lockSession!=warmSession);
+
+    // and the next client must not inherit what the lock holder did
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsLive==0);
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().lastSessionId!=lockSession);
+    CHECK(stats().sessionsOpened==3);
+    return true;
+}
+
+static bool provisioningAfterLock(void)
+{
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+    CHECK(statusQuery()==ROOTPA_OK);
+    uint32_t lockSession=stats().lastSessionId;
+    closeCmtlSession(&reference_);
+
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().lastSessionId!=lockSession);
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsOpened==2);
+    CHECK(stats().sessionsLive==0);
+    return true;
+}
+
+static bool brokenNotHandedOut(void)
+{
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+
+    cmtlMockFail(true);
+    CHECK(statusQuery()==ROOTPA_ERROR_MOBICORE_CONNECTION);
+    cmtlMockFail(false);
+
+    // while the lock holder keeps its reference nobody gets the broken session
+    uint32_t commands=stats().commands;
+    bool other=false;
+    CHECK(openCmtlSession(&other)==ROOTPA_ERROR_MOBICORE_CONNECTION);
+    CHECK(!other);
+    CHECK(statusQuery()==ROOTPA_ERROR_MOBICORE_CONNECTION);
+    CHECK(stats().commands==commands);
+
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsLive==0);
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().sessionsOpened==2);
+    return true;
+}
+
+static void* holdSession(void* referenceP)
+{
+    usleep(100*1000);
+    closeCmtlSession((bool*) referenceP);
+    return NULL;
+}
+
+static bool freshWaitsForQueries(void)
+{
+    pthread_t thread;
+    bool shared=false;
+
+    CHECK(openCmtlSession(&shared)==ROOTPA_OK);
+    uint32_t sharedSession;
+    CHECK(statusQuery()==ROOTPA_OK);
+    sharedSession=stats().lastSessionId;
+    CHECK(pthread_create(&thread, NULL, holdSession, &shared)==0);
+
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+    pthread_join(thread, NULL);
+    CHECK(statusQuery()==ROOTPA_OK);
+    CHECK(stats().lastSessionId!=sharedSession);
+    CHECK(stats().sessionsLive==1);
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsLive==0);
+    return true;
+}
+
+static bool failedOpenReleasesNothing(void)
+{
+    bool other=false;
+
+    CHECK(openCmtlSession(&other)==ROOTPA_OK);
+    CHECK(other);
+
+    // the session is in use, so the fresh open gives up without a reference
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_ERROR_LOCK);
+    CHECK(!reference_);
+    closeCmtlSession(&reference_);
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsLive==1);
+    CHECK(statusQuery()==ROOTPA_OK);
+
+    closeCmtlSession(&other);
+    CHECK(!other);
+    CHECK(openFreshCmtlSession(&reference_)==ROOTPA_OK);
+    CHECK(stats().sessionsOpened==2);
+    closeCmtlSession(&reference_);
+    CHECK(stats().sessionsLive==0);
+    return true;
+}
+
+static const struct
+{
+    const char* name;
+    bool (*run)(void);
+} cases[] = {
+    { "status queries share one session", sharedQueries },
+    { "idle session is reaped", idleReaped },
+    { "lock gets a fresh session", lockGetsFreshSession },
+    { "provisioning does not inherit the lock's session", provisioningAfterLock },
+    { "broken session is not handed out", brokenNotHandedOut },
+    { "fresh session waits for queries in flight", freshWaitsForQueries },
+    { "failed open releases nothing", failedOpenReleasesNothing },
+};
+
+int main(void)
+{
+    size_t total=sizeof(cases)/sizeof(cases[0]);
+    size_t failed=0;
+    size_t i;
+
+    cmtlMockRegister(0, 0);
+
+    for(i=0; i<total; i++)
+    {
+        // start without a session: a fresh one is closed on its last release
+        if(openFreshCmtlSession(&reference_)==ROOTPA_OK)
+        {
+            closeCmtlSession(&reference_);
+        }
+        cmtlMockResetStats();
+
+        bool ok=cases[i].run();
+        printf("%s %s\n", ok?"ok  ":"FAIL", cases[i].name);
+        if(!ok)
+        {
+            failed++;
+        }
+    }
+
+    printf("%zu/%zu passed\n", total-failed, total);
+    return failed?1:0;
+}
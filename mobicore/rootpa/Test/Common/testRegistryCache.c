@@ -0,0 +1,231 @@
+/*
+Host test of the registry cache in registry.c over the in-memory registry in registryMock.c.
+Built with a short REG_CACHE_MISS_TTL_MS so the expiry of "no such container" can be seen.
+Each case starts with an empty registry and cache. Exits non-zero if a case fails.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <MobiCoreRegistry.h>
+
+#include "registry.h"
+#include "registryMock.h"
+
+#define CHECK(cond) \
+    do { if(!(cond)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); return false; } } while(0)
+
+#define SPID        0x1234
+#define NUM_TLTS    3
+
+static mcUuid_t tltUuid(int i)
+{
+    mcUuid_t uuid;
+    memset(&uuid, 0, sizeof(uuid));
+    uuid.value[0]=0x07;
+    uuid.value[15]=(uint8_t) (i+1);
+    return uuid;
+}
+
+static void makeSp(mcSoSpCont_t* spP, mcContainerState_t state, int numTlts)
+{
+    int i;
+
+    memset(spP, 0, sizeof(*spP));
+    spP->cont.attribs.state=state;
+    for(i=0; i<MC_CONT_CHILDREN_COUNT; i++)
+    {
+        spP->cont.children[i]=(i<numTlts)?tltUuid(i):MC_UUID_FREE;
+    }
+}
+
+static void makeTlt(mcSoTltCont_2_1_t* tltP, mcContainerState_t state)
+{
+    memset(tltP, 0, sizeof(*tltP));
+    ((mcTltContCommon_t*)(((uint8_t*)tltP)+sizeof(mcSoHeader_t)))->attribs.state=state;
+}
+
+static void storeSp(mcContainerState_t state, int numTlts)
+{
+    mcSoSpCont_t sp;
+    mcSoTltCont_2_1_t tlt;
+    int i;
+
+    makeSp(&sp, state, numTlts);
+    regWriteSp(SPID, &sp, sizeof(sp));
+    for(i=0; i<numTlts; i++)
+    {
+        mcUuid_t uuid=tltUuid(i);
+        makeTlt(&tlt, MC_CONT_STATE_REGISTERED);
+        regWriteTlt(&uuid, (TLTCONTAINERP) &tlt, sizeof(tlt), SPID);
+    }
+}
+
+static mcContainerState_t spState(int* resultP)
+{
+    mcContainerState_t state=MC_CONT_STATE_UNREGISTERED;
+    *resultP=regGetSpState(SPID, &state);
+    return state;
+}
+
+static bool cachedQueries(void)
+{
+    SpContainerStructure structure;
+    int tltResult;
+    int i;
+
+    storeSp(MC_CONT_STATE_ACTIVATED, NUM_TLTS);
+    uint32_t reads=registryMockReads();
+    for(i=0; i<100; i++)
+    {
+        CHECK(regGetSpStructure(SPID, &structure, &tltResult)==MC_DRV_OK);
+        CHECK(tltResult==MC_DRV_OK);
+        CHECK(structure.nbrOfTlts==NUM_TLTS);
+        CHECK(structure.state==MC_CONT_STATE_ACTIVATED);
+    }
+    CHECK(registryMockReads()-reads==1+NUM_TLTS);
+    return true;
+}
+
+static bool writeInvalidates(void)
+{
+    SpContainerStructure structure;
+    mcSoTltCont_2_1_t tlt;
+    mcUuid_t uuid=tltUuid(1);
+    int result;
+    int tltResult;
+
+    storeSp(MC_CONT_STATE_REGISTERED, NUM_TLTS);
+    CHECK(spState(&result)==MC_CONT_STATE_REGISTERED && MC_DRV_OK==result);
+    CHECK(regGetSpStructure(SPID, &structure, &tltResult)==MC_DRV_OK);
+
+    storeSp(MC_CONT_STATE_ACTIVATED, NUM_TLTS);
+    CHECK(spState(&result)==MC_CONT_STATE_ACTIVATED && MC_DRV_OK==result);
+
+    makeTlt(&tlt, MC_CONT_STATE_SP_LOCKED);
+    CHECK(regWriteTlt(&uuid, (TLTCONTAINERP) &tlt, sizeof(tlt), SPID)==MC_DRV_OK);
+    CHECK(regGetSpStructure(SPID, &structure, &tltResult)==MC_DRV_OK);
+    CHECK(structure.tltContainers[1].state==MC_CONT_STATE_SP_LOCKED);
+    return true;
+}
+
+static bool cleanupInvalidates(void)
+{
+    TLTCONTAINERP tltP=NULL;
+    uint32_t size=0;
+    mcUuid_t uuid=tltUuid(0);
+    int result;
+
+    storeSp(MC_CONT_STATE_ACTIVATED, NUM_TLTS);
+    CHECK(spState(&result)==MC_CONT_STATE_ACTIVATED);
+    CHECK(regReadTlt(&uuid, &tltP, &size, SPID)==MC_DRV_OK);
+    free(tltP);
+
+    CHECK(regCleanupTlt(&uuid, SPID)==MC_DRV_OK);
+    tltP=NULL;
+    CHECK(regReadTlt(&uuid, &tltP, &size, SPID)==MC_DRV_ERR_INVALID_DEVICE_FILE);
+    free(tltP);
+
+    CHECK(regCleanupSp(SPID)==MC_DRV_OK);
+    spState(&result);
+    CHECK(MC_DRV_ERR_INVALID_DEVICE_FILE==result);
+
+    storeSp(MC_CONT_STATE_REGISTERED, 0);
+    CHECK(regCleanupRoot()==MC_DRV_OK);
+    spState(&result);
+    CHECK(MC_DRV_ERR_INVALID_DEVICE_FILE==result);
+    return true;
+}
+
+static bool missExpires(void)
+{
+    mcSoSpCont_t sp;
+    int result;
+
+    spState(&result);
+    CHECK(MC_DRV_ERR_INVALID_DEVICE_FILE==result);
+    uint32_t reads=registryMockReads();
+    spState(&result);
+    CHECK(MC_DRV_ERR_INVALID_DEVICE_FILE==result);
+    CHECK(registryMockReads()==reads);
+
+    // written by another process, RootPA only finds out once the miss expires
+    makeSp(&sp, MC_CONT_STATE_ACTIVATED, 0);
+    CHECK(mcRegistryStoreSp(SPID, &sp, sizeof(sp))==MC_DRV_OK);
+    usleep((REG_CACHE_MISS_TTL_MS+50)*1000);
+    CHECK(spState(&result)==MC_CONT_STATE_ACTIVATED);
+    CHECK(MC_DRV_OK==result);
+    return true;
+}
+
+static bool externalWrite(void)
+{
+    mcSoSpCont_t sp;
+    int result;
+
+    storeSp(MC_CONT_STATE_REGISTERED, 0);
+    CHECK(spState(&result)==MC_CONT_STATE_REGISTERED);
+
+    makeSp(&sp, MC_CONT_STATE_ACTIVATED, 0);
+    CHECK(mcRegistryStoreSp(SPID, &sp, sizeof(sp))==MC_DRV_OK);
+    regInvalidateCache();
+    CHECK(spState(&result)==MC_CONT_STATE_ACTIVATED);
+    return true;
+}
+
+static bool emptyContainer(void)
+{
+    SPCONTAINERP spP=NULL;
+    SpContainerStructure structure;
+    mcSoSpCont_t sp;
+    uint32_t size=0;
+    int tltResult;
+    int result;
+
+    CHECK(regWriteSp(SPID, &sp, 0)==MC_DRV_OK);
+    CHECK(regReadSp(SPID, &spP, &size)==MC_DRV_OK);
+    CHECK(0==size);
+    free(spP);
+
+    spState(&result);
+    CHECK(MC_DRV_ERR_INVALID_PARAMETER==result);
+    CHECK(regGetSpStructure(SPID, &structure, &tltResult)==MC_DRV_ERR_INVALID_PARAMETER);
+    return true;
+}
+
+static const struct
+{
+    const char* name;
+    bool (*run)(void);
+} cases[] = {
+    { "repeated queries read the registry once", cachedQueries },
+    { "writes are seen by the next read", writeInvalidates },
+    { "cleanups are seen by the next read", cleanupInvalidates },
+    { "missing containers are tried again", missExpires },
+    { "regInvalidateCache picks up outside writes", externalWrite },
+    { "empty container", emptyContainer },
+};
+
+int main(void)
+{
+    size_t total=sizeof(cases)/sizeof(cases[0]);
+    size_t failed=0;
+    size_t i;
+
+    for(i=0; i<total; i++)
+    {
+        registryMockClear();
+        regInvalidateCache();
+
+        bool ok=cases[i].run();
+        printf("%s %s\n", ok?"ok  ":"FAIL", cases[i].name);
+        if(!ok)
+        {
+            failed++;
+        }
+    }
+
+    printf("%zu/%zu passed\n", total-failed, total);
+    return failed?1:0;
+}